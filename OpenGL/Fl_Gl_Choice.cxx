@@ -36,10 +36,27 @@ using namespace fltk;
 
 static GlChoice* first;
 
+// Modes that could not be done, so asking again does not query the
+// server again:
+static int impossible[8];
+static int num_impossible;
+
+static GlChoice* not_found(int mode) {
+  if (num_impossible < 8) impossible[num_impossible++] = mode;
+  return 0;
+}
+
 GlChoice* GlChoice::find(int mode) {
   GlChoice* g;
-  
-  for (g = first; g; g = g->next) if (g->mode == mode) return g;
+  GlChoice** p;
+
+  for (p = &first; (g = *p); p = &g->next) if (g->mode == mode) {
+    // move it to the front, most programs only use one or two modes:
+    *p = g->next; g->next = first; first = g;
+    return g;
+  }
+  for (int i = 0; i < num_impossible; i++)
+    if (impossible[i] == mode) return 0;
 
 #ifdef _WIN32
 
@@ -71,7 +88,7 @@ GlChoice* GlChoice::find(int mode) {
     pixelFormat = i;
     chosen_pfd = pfd;
   }
-  if (!pixelFormat) return 0;
+  if (!pixelFormat) return not_found(mode);
 
 #elif defined(__APPLE__)
 
@@ -119,7 +136,7 @@ GlChoice* GlChoice::find(int mode) {
 
   open_display();
   AGLPixelFormat fmt = aglChoosePixelFormat(NULL, 0, (GLint*)blist);
-  if (!fmt) return 0;
+  if (!fmt) return not_found(mode);
 
 #else
 
@@ -177,9 +194,18 @@ GlChoice* GlChoice::find(int mode) {
 #endif
   if (!vis) {
 # if defined(GLX_VERSION_1_1) && defined(GLX_SGIS_multisample)
-    if (mode&MULTISAMPLE) return find(mode&~MULTISAMPLE);
+    if (mode&MULTISAMPLE) {
+      // remember the fallback under this mode too:
+      GlChoice* f = find(mode&~MULTISAMPLE);
+      if (!f) return not_found(mode);
+      g = new GlChoice(*f);
+      g->mode = mode;
+      g->next = first;
+      first = g;
+      return g;
+    }
 # endif
-    return 0;
+    return not_found(mode);
   }
 
 #endif
@@ -197,7 +223,13 @@ GlChoice* GlChoice::find(int mode) {
 #else
   g->vis = vis;
 
-  if (/*MaxCmapsOfScreen(ScreenOfDisplay(xdisplay,xscreen))==1 && */
+  // Different modes often get the same visual, share the colormap:
+  GlChoice* same;
+  for (same = g->next; same; same = same->next)
+    if (same->vis->visualid == vis->visualid) break;
+  if (same)
+    g->colormap = same->colormap;
+  else if (/*MaxCmapsOfScreen(ScreenOfDisplay(xdisplay,xscreen))==1 && */
       vis->visualid == xvisual->visualid &&
       !getenv("MESA_PRIVATE_CMAP"))
     g->colormap = xcolormap;
@@ -216,6 +248,50 @@ static GLContext first_context;
 // Define this to destroy all OpenGL contexts at exit to try to fix NVidia crashes
 #define DESTROY_ON_EXIT 0
 
+// Contexts given to delete_gl_context() are kept here, up to POOL_SIZE
+// of them, and handed to the next create_gl_context() for the same
+// visual. This avoids the cost of making a context, and everything
+// shared with first_context stays loaded, when windows are destroyed
+// and made again.
+#define POOL_SIZE 4
+struct PooledContext {
+  GLContext context;
+  VisualID visual;
+};
+static PooledContext pool[POOL_SIZE];
+static int pool_n;
+
+// The visual of every context made by create_gl_context():
+static PooledContext* live;
+static int live_n, live_size;
+
+static void live_add(GLContext context, VisualID visual) {
+  if (live_n >= live_size) {
+    live_size = live_size ? 2*live_size : 8;
+    live = (PooledContext*)realloc(live, live_size*sizeof(PooledContext));
+  }
+  live[live_n].context = context;
+  live[live_n].visual = visual;
+  live_n++;
+}
+
+// Return true if the context was put in the pool:
+static bool pool_add(GLContext context) {
+  if (pool_n >= POOL_SIZE) return false;
+  for (int i = 0; i < live_n; i++) if (live[i].context == context) {
+    pool[pool_n++] = live[i];
+    return true;
+  }
+  return false;
+}
+
+static void live_remove(GLContext context) {
+  for (int i = 0; i < live_n; i++) if (live[i].context == context) {
+    live[i] = live[--live_n];
+    return;
+  }
+}
+
 #if DESTROY_ON_EXIT
 static struct Contexts {
   GLContext context;
@@ -236,6 +312,11 @@ static void destructor() {
 
 GLContext fltk::create_gl_context(XVisualInfo* vis) {
   GLContext context;
+  for (int i = pool_n; i--;) if (pool[i].visual == vis->visualid) {
+    context = pool[i].context;
+    pool[i] = pool[--pool_n];
+    return context;
+  }
 #if 0 // enable OpenGL3 support if possible
   // This is disabled because it does not work on SUSE11 with NVidia cards.
   // I tried all the visuals and none worked. Error is returned when attempts
@@ -273,6 +354,8 @@ GLContext fltk::create_gl_context(XVisualInfo* vis) {
   } else
 #endif
     context = glXCreateContext(xdisplay, vis, first_context, 1);
+  if (!context) return 0;
+  live_add(context, vis->visualid);
 #if DESTROY_ON_EXIT
   Contexts* p = new Contexts;
   p->context = context;
@@ -374,10 +457,14 @@ void fltk::no_gl_context() {
 
 void fltk::delete_gl_context(GLContext context) {
   if (fl_current_glcontext == context) no_gl_context();
+#if USE_X11
+  if (pool_add(context)) return;
+#endif
   if (context != first_context) {
 #if USE_X11
     if (first_context) {
       glXDestroyContext(xdisplay, context);
+      live_remove(context);
 #if DESTROY_ON_EXIT
       Contexts** p = &context_list;
       Contexts* q = *p;
@@ -53,6 +53,13 @@ draw() can \e only use OpenGL calls.  Do not attempt to call any of
 the functions in &lt;fltk/draw.h&gt;, or X or GDI32 or any other
 drawing api.  Do not call glstart() or glfinish().
 
+The contexts of all GlWindows share display lists, textures and
+buffer objects, so these only need to be loaded once no matter how
+many windows draw them. On X the context of a destroyed window may be
+given to the next one made with the same mode(), so when valid() is
+false draw() should set up all the state it depends on rather than
+assume OpenGL's defaults.
+
 <h2>Double Buffering</h2>
 
 Normally double-buffering is enabled. You can disable it by chaning
@@ -84,7 +91,11 @@ is fast enough that the original purpose of them is moot)
 
 By default the emulation is to call draw_overlay() after draw() and
 before swapping the buffers, so the overlay is just part of the normal
-image and does not blink. You can get some of the advantages of
+image and does not blink. The image made by draw() is copied to a
+texture first, so if only the overlay changed the texture is drawn
+instead of calling draw() again, which makes a rubber-band selection
+atop a slow scene fast. This is not done if a shader program is
+current after draw() or NO_AUTO_SWAP is set in the mode(). You can get some of the advantages of
 overlay hardware by setting the GL_SWAP_TYPE environment variable,
 which will cause the front buffer to be used for the draw_overlay()
 method, and not call draw() each time the overlay changes. This
@@ -272,7 +283,7 @@ void GlWindow::ortho() {
 #if 1
   // simple version
   glLoadIdentity();
-  glViewport(0, 0, w(), h());
+  glViewport(0, 0, pixel_w(), pixel_h());
   glOrtho(0, w(), 0, h(), -1, 1);
 #else
   // this makes glRasterPos off the edge much less likely to clip,
@@ -294,6 +305,7 @@ void GlWindow::ortho() {
   flag is set in the mode().
 */
 void GlWindow::swap_buffers() {
+  if (capture_) capture_frame(GL_BACK);
 #ifdef _WIN32
 #if USE_GL_OVERLAY
   // Do not swap the overlay, to match GLX:
@@ -313,7 +325,84 @@ int fl_overlay_depth = 0;
 bool fl_overlay;
 #endif
 
+// When the overlay is emulated the image made by draw() is copied to
+// a texture before the overlay is drawn atop it, so if only the
+// overlay changes the texture can be drawn instead of calling draw():
+// for memory_report(), in memory_report.cxx:
+extern FL_API unsigned long fl_gl_textures, fl_gl_texture_bytes;
+
+void GlWindow::save_scene() {
+  int tw = 1; while (tw < w()) tw <<= 1;
+  int th = 1; while (th < h()) th <<= 1;
+  glPushAttrib(GL_TEXTURE_BIT | GL_PIXEL_MODE_BIT);
+  if (!scene_texture_) {glGenTextures(1, &scene_texture_); fl_gl_textures++;}
+  glBindTexture(GL_TEXTURE_2D, scene_texture_);
+  if (!scene_w_ || tw != scene_tw_ || th != scene_th_) {
+    fl_gl_texture_bytes -= (unsigned long)scene_tw_*scene_th_*3;
+    scene_tw_ = scene_th_ = 0;
+    glGetError();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, tw, th, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    if (glGetError() != GL_NO_ERROR) {glPopAttrib(); scene_w_ = 0; return;}
+    scene_tw_ = tw;
+    scene_th_ = th;
+    fl_gl_texture_bytes += (unsigned long)tw*th*3;
+  }
+  glReadBuffer(GL_BACK);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, w(), h());
+  glPopAttrib();
+  scene_w_ = w();
+  scene_h_ = h();
+}
+
+// Draw the texture made by save_scene() into the back buffer, leaving
+// all the OpenGL state as it was. Returns false if it can't:
+bool GlWindow::restore_scene() {
+  if (!scene_w_ || scene_w_ != w() || scene_h_ != h()) return false;
+  // a shader would be used to draw the texture, so give up:
+  GLint program = 0;
+  glGetIntegerv(0x8B8D /*GL_CURRENT_PROGRAM*/, &program);
+  glGetError();
+  if (program) return false;
+  glPushAttrib(GL_ALL_ATTRIB_BITS);
+  glMatrixMode(GL_TEXTURE); glPushMatrix(); glLoadIdentity();
+  glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+  glViewport(0, 0, w(), h());
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_ALPHA_TEST);
+  glDisable(GL_BLEND);
+  glDisable(GL_LIGHTING);
+  glDisable(GL_FOG);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_COLOR_LOGIC_OP);
+  glDisable(GL_TEXTURE_GEN_S);
+  glDisable(GL_TEXTURE_GEN_T);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, scene_texture_);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  GLfloat tx = GLfloat(w())/scene_tw_;
+  GLfloat ty = GLfloat(h())/scene_th_;
+  glBegin(GL_QUADS);
+  glTexCoord2f(0, 0); glVertex2f(-1, -1);
+  glTexCoord2f(tx, 0); glVertex2f(1, -1);
+  glTexCoord2f(tx, ty); glVertex2f(1, 1);
+  glTexCoord2f(0, ty); glVertex2f(-1, 1);
+  glEnd();
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION); glPopMatrix();
+  glMatrixMode(GL_TEXTURE); glPopMatrix();
+  glPopAttrib();
+  return true;
+}
+
 void GlWindow::flush() {
+  if (reduced_) reduced_start();
   uchar save_valid = valid_;
   uchar save_damage = damage();
 
@@ -343,7 +432,7 @@ void GlWindow::flush() {
 
       // don't draw if only overlay damage or expose events:
       if (save_damage != DAMAGE_OVERLAY || !save_valid) {
-	draw();
+	draw_scaled();
 	if (!(mode_ & NO_AUTO_SWAP)) swap_buffers();
       } else {
 	swap_buffers();
@@ -353,7 +442,7 @@ void GlWindow::flush() {
 
       // don't draw if only the overlay is damaged:
       if (save_damage != DAMAGE_OVERLAY || i->region || !save_valid) {
-	draw();
+	draw_scaled();
 	if (!(mode_ & NO_AUTO_SWAP)) swap_buffers();
       } else {
 	swap_buffers();
@@ -363,7 +452,7 @@ void GlWindow::flush() {
       // If we are faking the overlay, use CopyPixels to act like
       // SWAP_TYPE == COPY.  Otherwise overlay redraw is way too slow.
       // don't draw if only the overlay is damaged:
-      if (damage1_ || save_damage != DAMAGE_OVERLAY || i->region || !save_valid) draw();
+      if (damage1_ || save_damage != DAMAGE_OVERLAY || i->region || !save_valid) draw_scaled();
       // we use a seperate context for the copy because rasterpos must be 0
       // and depth test needs to be off:
       static GLContext ortho_context = 0;
@@ -389,9 +478,16 @@ void GlWindow::flush() {
 
     } else {
 
-      damage1_ = save_damage;
-      set_damage(DAMAGE_ALL);
-      draw();
+      if (overlay == this && save_valid && !(mode_ & NO_AUTO_SWAP) &&
+	  !(save_damage & ~(DAMAGE_OVERLAY|DAMAGE_EXPOSE)) &&
+	  restore_scene()) {
+	// only the overlay changed, put back what draw() made last time
+      } else {
+	damage1_ = save_damage;
+	set_damage(DAMAGE_ALL);
+	draw_scaled();
+	if (overlay == this && !(mode_ & NO_AUTO_SWAP)) save_scene();
+      }
       if (overlay == this) draw_overlay();
       if (!(mode_ & NO_AUTO_SWAP)) swap_buffers();
       goto NO_OVERLAY;
@@ -408,7 +504,8 @@ void GlWindow::flush() {
 
   } else {	// single-buffered context is simpler:
 
-    draw();
+    draw_scaled();
+    if (capture_) capture_frame(GL_FRONT);
     if (overlay == this) draw_overlay();
     glFlush();
   }
@@ -441,10 +538,12 @@ void GlWindow::flush() {
   }
 #endif
   valid(1);
+  if (reduced_) reduced_finish();
 }
 
 void GlWindow::layout() {
   if (layout_damage() & LAYOUT_WH) {
+    if (reduced_) reduced_resized();
     valid(0);
 #if USE_QUARTZ
     no_gl_context(); // because the BUFFER_RECT may change
@@ -490,6 +589,19 @@ void GlWindow::_context(void* v, bool destroy_flag) {
 /** Besides getting rid of the window, this will destroy the context
     if it belongs to the window. */
 void GlWindow::destroy() {
+  if ((capture_ || scene_texture_) && context_ && shown()) {
+    make_current();
+    if (capture_) capture_release();
+    if (scene_texture_) glDeleteTextures(1, &scene_texture_);
+  }
+  if (scene_texture_) fl_gl_textures--;
+  fl_gl_texture_bytes -= (unsigned long)scene_tw_*scene_th_*3;
+  scene_texture_ = 0;
+  scene_w_ = scene_tw_ = scene_th_ = 0;
+  if (reduced_) {
+    if (context_ && shown()) {make_current(); reduced_release();}
+    fltk::remove_timeout(reduced_settled, this);
+  }
   context(0);
 #if USE_GL_OVERLAY
   if (overlay && overlay != this) {
@@ -505,6 +617,8 @@ void GlWindow::destroy() {
 /** The destructor will destroy the context() if it belongs to the window. */
 GlWindow::~GlWindow() {
   destroy();
+  capture(0);
+  adaptive_resolution(0);
 }
 
 /** \fn GlWindow::GlWindow(int x, int y, int w, int h, const char *label=0);
@@ -515,6 +629,10 @@ which is probably all that is needed for most 3D OpenGL graphics.
 void GlWindow::init() {
   mode_ = DEPTH_BUFFER | DOUBLE_BUFFER;
   context_ = 0;
+  capture_ = 0;
+  reduced_ = 0;
+  scene_texture_ = 0;
+  scene_w_ = scene_h_ = scene_tw_ = scene_th_ = 0;
   gl_choice = 0;
   overlay = 0;
   damage1_ = 0;
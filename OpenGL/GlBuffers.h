@@ -0,0 +1,94 @@
+//
+// "$Id$"
+//
+// OpenGL buffer object functions for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Internal interface to the OpenGL functions that are newer than
+// the headers on some systems, such as pixel buffer objects. These
+// are looked up at runtime by fl_has_pbo(), which must be called with
+// a context current and returns false if they are not there.
+
+#ifndef fltk_GlBuffers_h
+#define fltk_GlBuffers_h
+
+#include <fltk/gl.h>
+#include <stddef.h>
+
+// Windows only has OpenGL 1.1 headers:
+#ifndef GL_BGRA
+# define GL_BGRA 0x80E1
+#endif
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+# define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+# define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+# define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+# define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_WRITE_ONLY
+# define GL_WRITE_ONLY 0x88B9
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+# define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+# define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+# define GL_READ_ONLY 0x88B8
+#endif
+
+////////////////////////////////////////////////////////////////
+// Pixel buffer objects, these are only in OpenGL 2.1 so must be
+// looked up at runtime:
+
+typedef void (APIENTRY *GenBuffers)(GLsizei, GLuint*);
+typedef void (APIENTRY *DeleteBuffers)(GLsizei, const GLuint*);
+typedef void (APIENTRY *BindBuffer)(GLenum, GLuint);
+typedef void (APIENTRY *BufferData)(GLenum, ptrdiff_t, const void*, GLenum);
+typedef void* (APIENTRY *MapBuffer)(GLenum, GLenum);
+typedef GLboolean (APIENTRY *UnmapBuffer)(GLenum);
+
+extern GenBuffers glGenBuffers_;
+extern DeleteBuffers glDeleteBuffers_;
+extern BindBuffer glBindBuffer_;
+extern BufferData glBufferData_;
+extern MapBuffer glMapBuffer_;
+extern UnmapBuffer glUnmapBuffer_;
+
+bool fl_has_pbo();
+bool fl_gl_has_extension(const char* name);
+void* fl_gl_getproc(const char* name);
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -33,7 +33,10 @@
 //
 // create_gl_context takes a window (necessary only on Win32) and an
 // GlChoice and returns a new OpenGL context. All contexts share
-// display lists with each other.
+// display lists, textures and buffer objects with each other, so
+// something loaded by one window does not have to be loaded again by
+// another. GlChoice::find() remembers the modes it could not do as
+// well as the ones it could.
 //
 // On X another create_gl_context is provided to create it for any
 // X visual.
@@ -47,7 +50,9 @@
 // no_gl_context clears that cache so the next fl_set_gl_context is
 // guaranteed to work.
 //
-// delete_gl_context destroys the context.
+// delete_gl_context destroys the context. On X a few of them are kept
+// instead and returned by the next create_gl_context for the same
+// visual, so windows that are destroyed and made again reuse them.
 //
 // This code is used by GlWindow, glStart(), and glVisual()
 
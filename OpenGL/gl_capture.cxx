@@ -0,0 +1,220 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Reading back what a GlWindow drew, for GlWindow::capture(). Each
+// frame is read into a pixel buffer object, which the card fills in
+// while the program goes on to the next frame, and is mapped and given
+// to the callback a frame or two later once a fence says it is done.
+// Without pixel buffer objects glReadPixels() is used directly, which
+// waits for the drawing to finish.
+
+#include <config.h>
+#if HAVE_GL
+
+#include <fltk/GlWindow.h>
+#include <string.h>
+#include <stdlib.h>
+#include "GlChoice.h"
+#include "GlBuffers.h"
+
+using namespace fltk;
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+# define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+# define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+# define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+// Fences are only in OpenGL 3.2 or ARB_sync:
+typedef void* Sync;
+typedef Sync (APIENTRY *FenceSync)(GLenum, GLbitfield);
+typedef GLenum (APIENTRY *ClientWaitSync)(Sync, GLbitfield, unsigned long long);
+typedef void (APIENTRY *DeleteSync)(Sync);
+
+static FenceSync glFenceSync_;
+static ClientWaitSync glClientWaitSync_;
+static DeleteSync glDeleteSync_;
+
+static bool has_sync() {
+  static int checked;
+  if (!checked) {
+    checked = 1;
+    if (atof((const char*)glGetString(GL_VERSION)) >= 3.2 ||
+	fl_gl_has_extension("GL_ARB_sync")) {
+      glFenceSync_ = (FenceSync)fl_gl_getproc("glFenceSync");
+      glClientWaitSync_ = (ClientWaitSync)fl_gl_getproc("glClientWaitSync");
+      glDeleteSync_ = (DeleteSync)fl_gl_getproc("glDeleteSync");
+      if (glFenceSync_ && glClientWaitSync_ && glDeleteSync_) checked = 2;
+    }
+  }
+  return checked == 2;
+}
+
+enum {SLOTS = 3}; // frames that can be waiting to be read
+
+namespace fltk {
+
+struct GlCapture {
+  GlWindow::CaptureCallback callback;
+  void* data;
+  GLuint pbo[SLOTS];
+  Sync fence[SLOTS];	// 0 if there is no ARB_sync
+  int w[SLOTS], h[SLOTS];
+  int size[SLOTS];	// bytes allocated in each pbo
+  int first;		// the oldest frame waiting
+  int count;		// how many frames are waiting
+  uchar* memory;	// used instead if there are no pbos
+  int memsize;
+};
+
+}
+
+// Return true if the frame in slot i can be mapped without waiting:
+static bool ready(GlCapture* c, int i) {
+  if (!c->fence[i]) return c->count >= SLOTS-1;
+  GLenum r = glClientWaitSync_(c->fence[i], 0, 0);
+  return r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED;
+}
+
+// Give the oldest waiting frame to the callback. OpenGL puts the
+// bottom row first, so the callback gets the top row and a negative
+// linedelta:
+static void deliver(GlCapture* c, GlWindow* window) {
+  int i = c->first;
+  if (c->fence[i]) {glDeleteSync_(c->fence[i]); c->fence[i] = 0;}
+  glBindBuffer_(GL_PIXEL_PACK_BUFFER, c->pbo[i]);
+  const uchar* p = (const uchar*)glMapBuffer_(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+  if (p) {
+    int ld = c->w[i]*4;
+    c->callback(window, p+(c->h[i]-1)*ld, c->w[i], c->h[i], -ld, c->data);
+    glUnmapBuffer_(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer_(GL_PIXEL_PACK_BUFFER, 0);
+  c->first = (c->first+1) % SLOTS;
+  c->count--;
+}
+
+// Called with the context current after draw(), before the buffers
+// are swapped, with \a buffer being GL_BACK or GL_FRONT:
+void GlWindow::capture_frame(unsigned buffer) {
+  GlCapture* c = capture_;
+  const int W = w();
+  const int H = h();
+  if (W <= 0 || H <= 0) return;
+  glReadBuffer(buffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  if (!fl_has_pbo()) {
+    if (c->memsize < W*H*4) {
+      free(c->memory);
+      c->memsize = W*H*4;
+      c->memory = (uchar*)malloc(c->memsize);
+    }
+    glReadPixels(0, 0, W, H, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, c->memory);
+    c->callback(this, c->memory+(H-1)*W*4, W, H, -W*4, c->data);
+    return;
+  }
+
+  // hand out the frames that are done, and the oldest if all are full:
+  while (c->count && (c->count == SLOTS || ready(c, c->first)))
+    deliver(c, this);
+
+  int i = (c->first+c->count) % SLOTS;
+  if (!c->pbo[i]) glGenBuffers_(1, &c->pbo[i]);
+  glBindBuffer_(GL_PIXEL_PACK_BUFFER, c->pbo[i]);
+  if (c->size[i] != W*H*4) {
+    c->size[i] = W*H*4;
+    glBufferData_(GL_PIXEL_PACK_BUFFER, c->size[i], 0, GL_STREAM_READ);
+  }
+  // this returns at once, the copy is done into the pbo later:
+  glReadPixels(0, 0, W, H, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+  glBindBuffer_(GL_PIXEL_PACK_BUFFER, 0);
+  c->w[i] = W;
+  c->h[i] = H;
+  if (has_sync()) c->fence[i] = glFenceSync_(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  c->count++;
+}
+
+// Give the rest of the frames to the callback and free the buffers,
+// the context must be current:
+void GlWindow::capture_release() {
+  GlCapture* c = capture_;
+  while (c->count) deliver(c, this);
+  for (int i = 0; i < SLOTS; i++) if (c->pbo[i]) {
+    glDeleteBuffers_(1, &c->pbo[i]);
+    c->pbo[i] = 0;
+    c->size[i] = 0;
+  }
+  free(c->memory);
+  c->memory = 0;
+  c->memsize = 0;
+}
+
+/**
+  Call \a callback with the pixels of every frame drawn from now on,
+  or stop if \a callback is null. This can be used to record what the
+  window shows to a video.
+
+  The callback is called as callback(window, pixels, w, h, linedelta,
+  \a data). \a pixels points at the top-left pixel of a w by h image
+  of fltk::RGB32 pixels, and the next row down is \a linedelta bytes
+  away (this is negative, as OpenGL stores the rows bottom to top).
+  This is memory mapped from the card and not a copy, it is only good
+  until the callback returns. Use Image::setimage() to copy it to an
+  Image if wanted.
+
+  If the card does pixel buffer objects, each frame is read into one
+  while the program goes on drawing, and the callback is called a
+  frame or two later from inside flush(), so it should not draw
+  anything with OpenGL. Otherwise the callback is called at once,
+  after waiting for the drawing to be done. The frames still waiting
+  are handed out when capturing is stopped or the window is destroyed.
+*/
+void GlWindow::capture(CaptureCallback callback, void* data) {
+  if (!callback) {
+    if (!capture_) return;
+    if (context_ && shown()) {make_current(); capture_release();}
+    free(capture_->memory);
+    delete capture_;
+    capture_ = 0;
+    return;
+  }
+  if (!capture_) {
+    capture_ = new GlCapture;
+    memset(capture_, 0, sizeof(GlCapture));
+  }
+  capture_->callback = callback;
+  capture_->data = data;
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
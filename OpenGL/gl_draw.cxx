@@ -41,7 +41,6 @@
 # include <X11/Xft/Xft.h>
 # include FT_GLYPH_H
 # undef Window
-static void glXUseXftFont(XftFont*, unsigned listbase);
 # define TEXTURES 1
 #else
 # define TEXTURES 0
@@ -50,15 +49,265 @@ static void glXUseXftFont(XftFont*, unsigned listbase);
 using namespace fltk;
 
 extern GLContext fl_current_glcontext;
+// for memory_report(), in memory_report.cxx:
+extern FL_API unsigned long fl_gl_textures, fl_gl_texture_bytes;
 FL_API unsigned fl_font_opengl_id();
 FL_API void fl_set_font_opengl_id(unsigned v);
 #if TEXTURES
 FL_API unsigned fl_font_opengl_texture();
 FL_API void fl_set_font_opengl_texture(unsigned);
-static unsigned texture; // current texture
 static float scalefactor = 1; // current scale factor
 #endif
 
+const char* fl_default_font_pathname;
+
+#if TEXTURES
+
+////////////////////////////////////////////////////////////////
+// Glyph atlas. Each font+size gets an atlas of glyphs, rendered by
+// Freetype as they are first used and packed into pages of a shared
+// set of textures. A string is drawn with one glDrawArrays() for each
+// page its glyphs are on, which is almost always one.
+
+enum {PAGESIZE = 512};	// width and height of each page texture
+enum {HASHSIZE = 64};	// buckets for characters past Latin-1
+
+struct GlyphAtlas;
+
+struct GlyphPage {
+  GLuint texture;
+  int curx, cury, maxy;	// lower-left corner of next bitmap and top of row
+  unsigned long last_used; // draw_count when last drawn
+  GlyphAtlas* atlas;
+  GlyphPage* next;	// list of all pages
+};
+
+struct TexGlyph {
+  unsigned ucs;
+  bool loaded;
+  GlyphPage* page;	// null if there is nothing to draw
+  short x, y, w, h;	// location of bitmap in page
+  short left, bottom;	// corner of bitmap relative to character origin
+  float advance;	// x advance value
+  TexGlyph* next;	// hash chain
+};
+
+struct GlyphAtlas {
+  XftFont* font;
+  GlyphPage* page;	// page new glyphs are put on
+  TexGlyph latin1[256];
+  TexGlyph* hash[HASHSIZE];
+};
+
+static GlyphAtlas** atlases;
+static unsigned num_atlases;
+static GlyphAtlas* atlas; // current one
+static GlyphPage* pages;
+static int num_pages;
+static unsigned long draw_count;
+
+static int max_pages = 32; // 8 megabytes
+
+// Create a new atlas and return 1+its index, for fl_set_font_opengl_texture():
+static unsigned new_atlas(XftFont* font) {
+  if (!(num_atlases & (num_atlases+1))) {
+    GlyphAtlas** n = new GlyphAtlas*[2*num_atlases+1];
+    memcpy(n, atlases, num_atlases*sizeof(GlyphAtlas*));
+    delete[] atlases;
+    atlases = n;
+  }
+  GlyphAtlas* a = new GlyphAtlas;
+  memset(a, 0, sizeof(GlyphAtlas));
+  a->font = font;
+  atlases[num_atlases++] = a;
+  return num_atlases;
+}
+
+// Throw away the least-recently drawn page that the current string
+// is not using, all glyphs on it will be rendered again if needed:
+static bool evict_page() {
+  GlyphPage** pp = 0;
+  for (GlyphPage** p = &pages; *p; p = &((*p)->next)) {
+    if ((*p)->last_used == draw_count) continue;
+    if (!pp || (*p)->last_used < (*pp)->last_used) pp = p;
+  }
+  if (!pp) return false;
+  GlyphPage* page = *pp;
+  *pp = page->next;
+  GlyphAtlas* a = page->atlas;
+  for (int i = 0; i < 256; i++)
+    if (a->latin1[i].page == page) a->latin1[i].loaded = false;
+  for (int i = 0; i < HASHSIZE; i++)
+    for (TexGlyph* g = a->hash[i]; g; g = g->next)
+      if (g->page == page) g->loaded = false;
+  if (a->page == page) a->page = 0;
+  glDeleteTextures(1, &page->texture);
+  fl_gl_textures--;
+  fl_gl_texture_bytes -= PAGESIZE*PAGESIZE;
+  delete page;
+  num_pages--;
+  return true;
+}
+
+static GlyphPage* new_page(GlyphAtlas* a) {
+  if (num_pages >= max_pages) evict_page();
+  GlyphPage* page = new GlyphPage;
+  page->curx = page->cury = page->maxy = 1;
+  page->last_used = draw_count;
+  page->atlas = a;
+  page->next = pages;
+  pages = page;
+  num_pages++;
+  uchar* zero = new uchar[PAGESIZE*PAGESIZE];
+  memset(zero, 0, PAGESIZE*PAGESIZE);
+  glGenTextures(1, &page->texture);
+  fl_gl_textures++;
+  fl_gl_texture_bytes += PAGESIZE*PAGESIZE;
+  glBindTexture(GL_TEXTURE_2D, page->texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_INTENSITY8, PAGESIZE, PAGESIZE, 0,
+	       GL_LUMINANCE, GL_UNSIGNED_BYTE, zero);
+  delete[] zero;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+  a->page = page;
+  return page;
+}
+
+// Find space on a page of the current atlas for a w*h bitmap:
+static GlyphPage* place(int w, int h, int& x, int& y) {
+  for (int tries = 0; tries < 2; tries++) {
+    GlyphPage* page = atlas->page;
+    if (!page) page = new_page(atlas);
+    if (page->curx+w+1 > PAGESIZE) { // start a new row
+      page->curx = 1; page->cury = page->maxy+1;
+    }
+    if (page->cury+h+1 <= PAGESIZE && w+2 <= PAGESIZE) {
+      if (page->cury+h > page->maxy) page->maxy = page->cury+h;
+      x = page->curx; page->curx = x+w+1;
+      y = page->cury;
+      return page;
+    }
+    if (w+2 > PAGESIZE || h+2 > PAGESIZE) break; // can never fit
+    atlas->page = 0; // this one is full
+  }
+  return 0;
+}
+
+// Render the glyph with Freetype and copy it to a page:
+static void load_glyph(TexGlyph& t) {
+  t.loaded = true;
+  t.page = 0;
+  t.w = t.h = 0;
+  FT_Face face = XftLockFace(atlas->font);
+
+  // hack so Nuke knows where to look for fonts...
+  if (!fl_default_font_pathname)
+    fl_default_font_pathname = (char*)(face->stream->pathname.pointer);
+
+  unsigned ch = t.ucs;
+  unsigned glyph_index = FT_Get_Char_Index(face, ch);
+  // This fixes a lot of decorative fonts:
+  if (!glyph_index && ch>0x1D && ch<256 && int(ch) < face->num_glyphs+0x1D)
+    glyph_index = ch-0x1D;
+  // otherwise this draws the undefined glyph in slot zero
+
+  FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER);
+  t.advance = face->glyph->advance.x >> 6; // /64.0 for non-integer
+  FT_Glyph glyph; FT_Get_Glyph(face->glyph, &glyph);
+
+  // This seems to be true for spaces in Microsoft fonts, rather than
+  // it generating a blank bitmap:
+  if (glyph->format != FT_GLYPH_FORMAT_BITMAP) {
+    FT_Done_Glyph(glyph);
+    XftUnlockFace(atlas->font);
+    return;
+  }
+  FT_BitmapGlyph bitmap_glyph = (FT_BitmapGlyph)glyph;
+  FT_Bitmap& bitmap = bitmap_glyph->bitmap;
+  const int w = bitmap.width;
+  const int h = bitmap.rows;
+  int x, y;
+  GlyphPage* page = (w > 0 && h > 0) ? place(w, h, x, y) : 0;
+  if (page) {
+    // Copy the bitmap, flipping it upside down:
+    uchar* data = new uchar[w*h];
+    static bool warned;
+    switch (bitmap.pixel_mode) {
+    case FT_PIXEL_MODE_MONO: {
+      for (int j = 0; j < h; j++)
+	for (int i = 0; i < w; i++)
+	  data[j*w+i] =
+	    (bitmap.buffer[(h-j-1)*bitmap.pitch+i/8]&(128>>(i%8))) ? 255 : 0;
+      break;}
+    default:
+      if (!warned) {
+	warned = true;
+	printf("unsupported pixel mode %d!\n", bitmap.pixel_mode);
+      } // then fall-through to the default case:
+    case FT_PIXEL_MODE_GRAY: {
+      for (int j = 0; j < h; j++)
+	for (int i = 0; i < w; i++)
+	  data[j*w+i] = bitmap.buffer[(h-j-1)*bitmap.pitch+i];
+      break;}
+    }
+    glBindTexture(GL_TEXTURE_2D, page->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h,
+		    GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
+    delete[] data;
+    t.page = page;
+    t.x = x; t.y = y; t.w = w; t.h = h;
+    t.left = bitmap_glyph->left;
+    t.bottom = bitmap_glyph->top-h;
+  }
+  FT_Done_Glyph(glyph);
+  XftUnlockFace(atlas->font);
+}
+
+static TexGlyph& find_glyph(unsigned ucs) {
+  TexGlyph* g;
+  if (ucs < 256) {
+    g = &atlas->latin1[ucs];
+  } else {
+    TexGlyph** p = &atlas->hash[ucs%HASHSIZE];
+    for (g = *p; g && g->ucs != ucs; g = g->next);
+    if (!g) {
+      g = new TexGlyph;
+      memset(g, 0, sizeof(TexGlyph));
+      g->next = *p;
+      *p = g;
+    }
+  }
+  g->ucs = ucs;
+  if (!g->loaded) load_glyph(*g);
+  if (g->page) g->page->last_used = draw_count;
+  return *g;
+}
+
+/**
+  Set how many 512x512 textures the glyphs drawn by gldrawtext() may
+  use on X, for all fonts combined. Each is 256K of texture memory.
+  When this is exceeded the least-recently drawn one is thrown away
+  and its glyphs are rendered again the next time they are drawn.
+  The default is 32.
+*/
+void fltk::glsetglyphcache(int pages) {
+  max_pages = pages;
+  while (num_pages > max_pages && evict_page());
+}
+
+#else
+
+void fltk::glsetglyphcache(int) {}
+
+#endif
+
+
 /**
   Make the current OpenGL font (as used by gldrawtext()) be as
   similar as possible to an FLTK Font. Currently the font is
@@ -80,13 +329,19 @@ void fltk::glsetfont(fltk::Font* font, float size) {
   float tsize = size;
 #endif
   setfont(font, tsize);
+#if TEXTURES
+  unsigned id = fl_font_opengl_texture();
+  if (!id) {
+    id = new_atlas(xftfont());
+    fl_set_font_opengl_texture(id);
+  }
+  atlas = atlases[id-1];
+#else
   unsigned listbase = fl_font_opengl_id();
   if (!listbase) {
     listbase = glGenLists(256);
     fl_set_font_opengl_id(listbase);
-#if USE_XFT
-    glXUseXftFont(xftfont(), listbase);
-#elif USE_X11
+#if USE_X11
     XFontStruct* current_xfont = xfont();
     int base = current_xfont->min_char_or_byte2;
     int last = current_xfont->max_char_or_byte2;
@@ -120,8 +375,6 @@ void fltk::glsetfont(fltk::Font* font, float size) {
 #endif
   }
   glListBase(listbase);
-#if TEXTURES
-  texture = fl_font_opengl_texture();
 #endif
   setfont(font, size); // necessary so measure() works when scalefactor!=1
 }
@@ -133,8 +386,9 @@ void fltk::glsetfont(fltk::Font* font, float size) {
   with fltk::glsetfont(). You can use glRasterPos2f() or similar calls
   to set the position before calling this.
 
-  The string is in UTF-8, although only characters in ISO-8859-1 are
-  drawn correctly, others draw as question marks.
+  The string is in UTF-8. On X with Xft any character in the font is
+  drawn, on other systems only characters in ISO-8859-1 are drawn
+  correctly, others draw as question marks.
 */
 void fltk::gldrawtext(const char* str) {
   gldrawtext(str, strlen(str));
@@ -146,26 +400,47 @@ void fltk::gldrawtext(const char* str) {
 void fltk::gldrawtext(const char* text, int n) {
 #if TEXTURES
   GLboolean v; glGetBooleanv(GL_CURRENT_RASTER_POSITION_VALID,&v);
-  if (!v) return;
-#endif
-  char localbuffer[WCBUFLEN];
-  char* buffer = localbuffer;
-  char* mallocbuffer = 0;
-  int count = utf8toa(text, n, buffer, WCBUFLEN);
-  if (count >= WCBUFLEN) {
-    if (count == n) {
-      // all ascii or errors, no conversion needed
-      buffer = (char*)text;
-    } else {
-      buffer = mallocbuffer = new char[count+1];
-      count = utf8toa(text, n, buffer, count+1);
+  if (!v || !atlas) return;
+  draw_count++;
+  glPushAttrib(GL_ENABLE_BIT|GL_TRANSFORM_BIT|GL_COLOR_BUFFER_BIT|GL_TEXTURE_BIT);
+  glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT|GL_CLIENT_VERTEX_ARRAY_BIT);
+
+  // Make a quad for each glyph, 4 texture coordinates and vertices:
+  enum {LOCALQUADS = 64};
+  GLfloat localbuffer[LOCALQUADS*16];
+  GlyphPage* localpages[LOCALQUADS];
+  GLfloat* buffer = localbuffer;
+  GlyphPage** quadpage = localpages;
+  if (n > LOCALQUADS) {
+    buffer = new GLfloat[n*16];
+    quadpage = new GlyphPage*[n];
+  }
+  int quads = 0;
+  float x = 0;
+  const char* e = text+n;
+  for (const char* p = text; p < e;) {
+    int len; unsigned ucs = utf8decode(p, e, &len); p += len;
+    const TexGlyph& t = find_glyph(ucs);
+    if (t.page) {
+      const float umul = 1.0f/PAGESIZE;
+      const float x0 = x+t.left, x1 = x0+t.w;
+      const float y0 = t.bottom, y1 = y0+t.h;
+      const float u0 = t.x*umul, u1 = (t.x+t.w)*umul;
+      const float v0 = t.y*umul, v1 = (t.y+t.h)*umul;
+      GLfloat* q = buffer+16*quads;
+      q[0] = u0; q[1] = v0; q[2] = x0; q[3] = y0;
+      q[4] = u1; q[5] = v0; q[6] = x1; q[7] = y0;
+      q[8] = u1; q[9] = v1; q[10]= x1; q[11]= y1;
+      q[12]= u0; q[13]= v1; q[14]= x0; q[15]= y1;
+      quadpage[quads++] = t.page;
     }
+    x += t.advance;
   }
-#if TEXTURES
-  glPushAttrib(GL_ENABLE_BIT|GL_TRANSFORM_BIT|GL_COLOR_BUFFER_BIT);
+
   // setup so the textures draw correctly:
   glDisable(GL_LIGHTING);
   glEnable(GL_TEXTURE_2D);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
   glEnable(GL_BLEND);
   glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
   // This is useful for making the letters transparent in 3D, but I'll
@@ -198,17 +473,60 @@ void fltk::gldrawtext(const char* text, int n) {
   glMatrixMode(GL_MODELVIEW);
   glPushMatrix();
   glLoadIdentity();
-  // now draw the display list:
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glCallLists(count, GL_UNSIGNED_BYTE, buffer);
+
+  // now draw all the quads on each page at once:
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glTexCoordPointer(2, GL_FLOAT, 4*sizeof(GLfloat), buffer);
+  glVertexPointer(2, GL_FLOAT, 4*sizeof(GLfloat), buffer+2);
+  for (int done = 0; done < quads;) {
+    GlyphPage* page = quadpage[done];
+    // move the rest of the quads on this page next to the first one:
+    int k = done+1;
+    for (int i = k; i < quads; i++) if (quadpage[i] == page) {
+      if (i != k) {
+	GLfloat temp[16];
+	memcpy(temp, buffer+16*k, sizeof(temp));
+	memcpy(buffer+16*k, buffer+16*i, sizeof(temp));
+	memcpy(buffer+16*i, temp, sizeof(temp));
+	quadpage[i] = quadpage[k];
+	quadpage[k] = page;
+      }
+      k++;
+    }
+    glBindTexture(GL_TEXTURE_2D, page->texture);
+    glDrawArrays(GL_QUADS, 4*done, 4*(k-done));
+    done = k;
+  }
   // set new rasterpos (we have translated 0,0 to the desired position):
   //glRasterPos2f(0,0);
   // and restore the previous state & transformation:
   glPopMatrix();
   glMatrixMode(GL_PROJECTION);
   glPopMatrix();
+  glPopClientAttrib();
   glPopAttrib();
-#elif defined(__APPLE__)
+  if (buffer != localbuffer) {
+    delete[] buffer;
+    delete[] quadpage;
+  }
+#else
+  char localbuffer[WCBUFLEN];
+  char* buffer = localbuffer;
+  char* mallocbuffer = 0;
+  int count = utf8toa(text, n, buffer, WCBUFLEN);
+  if (count >= WCBUFLEN) {
+    if (count == n) {
+      // all ascii or errors, no conversion needed
+      buffer = (char*)text;
+    } else {
+      buffer = mallocbuffer = new char[count+1];
+      count = utf8toa(text, n, buffer, count+1);
+    }
+  }
+#if defined(__APPLE__)
   // Work around an apparent OpenGL bug on our Intel Mac
   glPushMatrix();
   glCallLists(count, GL_UNSIGNED_BYTE, buffer);
@@ -217,6 +535,7 @@ void fltk::gldrawtext(const char* text, int n) {
   glCallLists(count, GL_UNSIGNED_BYTE, buffer);
 #endif
   delete[] mallocbuffer;
+#endif
 }
 
 /**
@@ -308,199 +627,6 @@ void fltk::gldrawimage(const uchar* b, int x, int y, int w, int h, int d, int ld
   glDrawPixels(w, h, d<4?GL_RGB:GL_RGBA, GL_UNSIGNED_BYTE, (const unsigned long*)b);
 }
 
-const char* fl_default_font_pathname;
-
-#if USE_XFT
-
-static int nextpow2(int a) {
-  int ret = 1;
-  while (ret < a) ret <<= 1;
-  return ret;
-}
-
-static void glXUseXftFont(XftFont* xftfont, unsigned listbase) {
-
-  struct TexGlyph {
-    int x,y,w,h; // location of bitmap in texture
-    int left, bottom; // corner of bitmap relative to character origin
-    float advance; // x advance value
-  } texglyphs[256];
-  // memory to build texture in:
-  const int TEXWIDTH = 512;
-  const int TEXHEIGHT = 512;
-  uchar* data = new uchar[TEXWIDTH*TEXHEIGHT];
-  memset(data, 0, TEXWIDTH*TEXHEIGHT);
-  // lower-left corner of next bitmap:
-  int curx = 1;
-  int cury = 1;
-  // when a new row is started it goes here:
-  int maxy = 1;
-
-  FT_Face face = XftLockFace(xftfont);
-
-  // hack so Nuke knows where to look for fonts...
-  if (!fl_default_font_pathname)
-    fl_default_font_pathname = (char*)(face->stream->pathname.pointer);
-
-//   if (!face->charmap && face->num_charmaps)
-//     FT_Set_Charmap(face, face->charmaps[0]);
-  int prev_pixel_mode = FT_PIXEL_MODE_GRAY;
-
-  int ch; for (ch = 0; ch < 256; ch++) {
-    TexGlyph& t = texglyphs[ch];
-
-    unsigned glyph_index;
-    if (ch) {
-      glyph_index = FT_Get_Char_Index(face, ch);
-      if (!glyph_index) {
-	// This fixes a lot of decorative fonts:
-	if (ch>0x1D && ch < face->num_glyphs+0x1D)
-	  glyph_index = ch-0x1D;
-	else {
-	  // undefined characters copy the undefined glyph in slot zero
-	  t = texglyphs[0];
-	  continue;
-	}
-      }
-    } else {
-      // make slot zero be the undefined glyph, no matter what font says:
-      glyph_index = 0;
-    }
-
-    // Get the bitmap from Freetype:
-    FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER);
-    t.advance = face->glyph->advance.x >> 6; // /64.0 for non-integer
-    FT_Glyph glyph; FT_Get_Glyph(face->glyph, &glyph);
-
-    // This seems to be true for spaces in Microsoft fonts, rather than
-    // it generating a blank bitmap:
-    if (glyph->format != FT_GLYPH_FORMAT_BITMAP) {
-      FT_Done_Glyph(glyph);
-      t.w = t.h = 0;
-      continue;
-      // This does not work:
-      // FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, 0, 1);
-    }
-    FT_BitmapGlyph bitmap_glyph = (FT_BitmapGlyph)glyph;
-    FT_Bitmap& bitmap = bitmap_glyph->bitmap;
-
-    const int w = t.w = bitmap.width;
-    const int h = t.h = bitmap.rows;
-
-    // Skip blank bitmaps:
-    if (w > 0 && h > 0) {
-
-      // figure out where we will put the bitmap
-      if (curx+w+1 > TEXWIDTH) { // start a new row
-	curx = 1; cury = maxy+1;
-      }
-      // figure out where next row must start
-      if (cury+h > maxy) {
-	// Ignore any that go out the top of the texture:
-	if (cury+h+1 > TEXHEIGHT) {
-	  FT_Done_Glyph(glyph);
-	  t = texglyphs[0];
-	  continue;
-	}
-	maxy = cury+h;
-      }
-      int x = t.x = curx; curx = x+w+1;
-      int y = t.y = cury;
-
-      // Copy the bitmap, flipping it upside down:
-      switch (bitmap.pixel_mode) {
-      case FT_PIXEL_MODE_MONO: {
-	for (int j = 0; j < h; j++)
-	  for (int i = 0; i < w; i++)
-	    data[(y+j)*TEXWIDTH+x+i] =
-	      (bitmap.buffer[(h-j-1)*bitmap.pitch+i/8]&(128>>(i%8))) ? 255 : 0;
-	break;}
-      default:
-	if (bitmap.pixel_mode != prev_pixel_mode) {
-	  prev_pixel_mode = bitmap.pixel_mode;
-	  printf("unsupported pixel mode %d!\n", bitmap.pixel_mode);
-	} // then fall-through to the default case:
-      case FT_PIXEL_MODE_GRAY: {
-	for (int j = 0; j < h; j++)
-	  for (int i = 0; i < w; i++)
-	    data[(y+j)*TEXWIDTH+x+i] =
-	      bitmap.buffer[(h-j-1)*bitmap.pitch+i];
-	break;}
-      }
-      t.left = bitmap_glyph->left;
-      t.bottom = bitmap_glyph->top-h;
-    }
-
-    FT_Done_Glyph(glyph);
-
-  }
-
-  XftUnlockFace(xftfont);
-
-  // Hey developers, the above portion can probably be replaced to reuse
-  // this texture code on systems other than Freetype!
-
-  glPushAttrib(GL_TEXTURE_BIT);
-  glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
-
-  // generate the OpenGL texture map we will use:
-
-  int height = nextpow2(maxy);
-  int width = TEXWIDTH; // I suppose we could check for < 256 wide...
-
-  GLuint texture;
-  glGenTextures(1, &texture);
-
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-  glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-  glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_INTENSITY8, width, height, 0,
-	       GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
-  delete[] data;
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-  // remember it:
-  fl_set_font_opengl_texture(texture);
-
-  // Now build the display lists
-  float umul = 1.0f/width;
-  float vmul = 1.0f/height;
-  for (ch = 0; ch < 256; ch++) {
-    const TexGlyph& t = texglyphs[ch];
-
-    // Create the display list for this character:
-    glNewList(listbase+ch, GL_COMPILE);
-
-    // Draw a texturemapped rectangle:
-    if (t.w > 0 && t.h > 0) {
-      glBegin(GL_QUADS);
-      glTexCoord2f(t.x*umul,t.y*vmul);
-      glVertex2i(t.left,t.bottom);
-      glTexCoord2f((t.x+t.w)*umul, t.y*vmul);
-      glVertex2i(t.left+t.w,t.bottom);
-      glTexCoord2f((t.x+t.w)*umul, (t.y+t.h)*vmul);
-      glVertex2i(t.left+t.w,t.bottom+t.h);
-      glTexCoord2f(t.x*umul, (t.y+t.h)*vmul);
-      glVertex2i(t.left,t.bottom+t.h);
-      glEnd();
-    }
-
-    // move the origin:
-    glTranslatef(t.advance, 0, 0);
-
-    glEndList();
-  }
-
-  glPopClientAttrib();
-  glPopAttrib();
-}
-#endif
-
 #endif
 
 //
@@ -0,0 +1,393 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Drawing fltk::Image objects in OpenGL. Each Image becomes a texture
+// that is kept until the Image changes. All the contexts created by
+// GlChoice share textures with each other, so one cache is used for
+// all of them.
+
+#include <config.h>
+#if HAVE_GL
+
+#include <fltk/gl.h>
+#include <fltk/Image.h>
+#include <string.h>
+#include <stdlib.h>
+#include "GlChoice.h"
+#include "GlBuffers.h"
+
+using namespace fltk;
+
+extern GLContext fl_current_glcontext;
+// for memory_report(), in memory_report.cxx:
+extern FL_API unsigned long fl_gl_textures, fl_gl_texture_bytes;
+
+////////////////////////////////////////////////////////////////
+// Pixel buffer objects, see GlBuffers.h:
+
+GenBuffers glGenBuffers_;
+DeleteBuffers glDeleteBuffers_;
+BindBuffer glBindBuffer_;
+BufferData glBufferData_;
+MapBuffer glMapBuffer_;
+UnmapBuffer glUnmapBuffer_;
+
+bool fl_gl_has_extension(const char* name) {
+  const char* e = (const char*)glGetString(GL_EXTENSIONS);
+  if (!e) return false;
+  int n = strlen(name);
+  for (;;) {
+    const char* p = strstr(e, name);
+    if (!p) return false;
+    if ((p == e || p[-1] == ' ') && (p[n] == ' ' || !p[n])) return true;
+    e = p+n;
+  }
+}
+
+void* fl_gl_getproc(const char* name) {
+#ifdef _WIN32
+  return (void*)wglGetProcAddress(name);
+#elif defined(__APPLE__)
+  return 0; // NYI, could use the OpenGL framework directly
+#else
+  return (void*)glXGetProcAddressARB((const GLubyte*)name);
+#endif
+}
+
+static bool npot_textures; // true if textures can be any size
+
+// Called once there is a context:
+bool fl_has_pbo() {
+  static int checked;
+  if (!checked) {
+    checked = 1;
+    npot_textures = atof((const char*)glGetString(GL_VERSION)) >= 2 ||
+      fl_gl_has_extension("GL_ARB_texture_non_power_of_two");
+    if (fl_gl_has_extension("GL_ARB_pixel_buffer_object")) {
+      glGenBuffers_ = (GenBuffers)fl_gl_getproc("glGenBuffersARB");
+      glDeleteBuffers_ = (DeleteBuffers)fl_gl_getproc("glDeleteBuffersARB");
+      glBindBuffer_ = (BindBuffer)fl_gl_getproc("glBindBufferARB");
+      glBufferData_ = (BufferData)fl_gl_getproc("glBufferDataARB");
+      glMapBuffer_ = (MapBuffer)fl_gl_getproc("glMapBufferARB");
+      glUnmapBuffer_ = (UnmapBuffer)fl_gl_getproc("glUnmapBufferARB");
+      if (glGenBuffers_ && glDeleteBuffers_ && glBindBuffer_ &&
+	  glBufferData_ && glMapBuffer_ && glUnmapBuffer_) checked = 2;
+    }
+  }
+  return checked == 2;
+}
+
+////////////////////////////////////////////////////////////////
+// The cache:
+
+struct GlTexture {
+  const Image* image;
+  unsigned long serial;	// image->serial() when last uploaded
+  GLuint texture;	// 0 if the image could not be made into one
+  GLuint pbo;		// used once the image changes often
+  int w, h;		// size of the image
+  int tw, th;		// size of the texture, bigger if it must be power of 2
+  GLint internalformat;
+  int changes;		// how many times it was uploaded again
+  unsigned long mem;	// bytes of texture + pbo memory
+  GlTexture* hash_next;
+  GlTexture* prev;	// LRU list, most recently drawn first
+  GlTexture* next;
+};
+
+enum {BUCKETS = 256};
+static GlTexture* buckets[BUCKETS];
+static GlTexture* lru_first;
+static GlTexture* lru_last;
+static unsigned long cache_limit = 64*1024*1024;
+static unsigned long cache_mem;
+
+static inline unsigned bucket(const Image* image) {
+  return (unsigned)(((unsigned long)image >> 4) % BUCKETS);
+}
+
+static void lru_unlink(GlTexture* t) {
+  if (t->prev) t->prev->next = t->next; else lru_first = t->next;
+  if (t->next) t->next->prev = t->prev; else lru_last = t->prev;
+}
+
+static void lru_push(GlTexture* t) {
+  t->prev = 0;
+  t->next = lru_first;
+  if (lru_first) lru_first->prev = t; else lru_last = t;
+  lru_first = t;
+}
+
+static void forget(GlTexture* t) {
+  GlTexture** p = &buckets[bucket(t->image)];
+  while (*p != t) p = &((*p)->hash_next);
+  *p = t->hash_next;
+  lru_unlink(t);
+  // the context may already be gone when the program exits:
+  if (fl_current_glcontext) {
+    if (t->texture) glDeleteTextures(1, &t->texture);
+    if (t->pbo) glDeleteBuffers_(1, &t->pbo);
+  }
+  if (t->texture) fl_gl_textures--;
+  cache_mem -= t->mem;
+  fl_gl_texture_bytes -= t->mem;
+  delete t;
+}
+
+// Delete least-recently drawn textures, but not keep:
+static void trim_cache(GlTexture* keep) {
+  while (cache_mem > cache_limit && lru_last && lru_last != keep)
+    forget(lru_last);
+}
+
+static GlTexture* find_texture(const Image& image) {
+  GlTexture** p = &buckets[bucket(&image)];
+  for (GlTexture* t = *p; t; t = t->hash_next) {
+    if (t->image == &image) {
+      if (t != lru_first) {lru_unlink(t); lru_push(t);}
+      return t;
+    }
+  }
+  GlTexture* t = new GlTexture;
+  memset(t, 0, sizeof(*t));
+  t->image = &image;
+  t->hash_next = *p;
+  *p = t;
+  lru_push(t);
+  return t;
+}
+
+static int nextpow2(int a) {
+  int ret = 1;
+  while (ret < a) ret <<= 1;
+  return ret;
+}
+
+static bool has_alpha(PixelType p) {
+  return p==MASK || p==RGBA || p==ARGB32 || p==RGBM || p==MRGB32;
+}
+
+// Figure out how OpenGL can read Image::buffer():
+static bool pixel_format(const Image& image, GLenum& format, GLenum& type,
+			 int& depth, GLint& internalformat) {
+  PixelType p = image.buffer_pixeltype();
+#if USE_X11
+  // The buffer is in the X server's format, which can only be read if
+  // it is XRender's ARGB32 or from a 24 or 32 bit visual:
+  if (image.buffer_depth() != 4) return false;
+  format = GL_BGRA; type = GL_UNSIGNED_INT_8_8_8_8_REV; depth = 4;
+  internalformat =
+    (p == ARGB32 && has_alpha(image.pixeltype())) ? GL_RGBA8 : GL_RGB8;
+#else
+  switch (p) {
+  case MONO:
+    format = GL_LUMINANCE; type = GL_UNSIGNED_BYTE; depth = 1; break;
+  case RGB:
+    format = GL_RGB; type = GL_UNSIGNED_BYTE; depth = 3; break;
+  case RGBx:
+  case RGBA:
+  case RGBM:
+    format = GL_RGBA; type = GL_UNSIGNED_BYTE; depth = 4; break;
+  case RGB32:
+  case ARGB32:
+  case MRGB32:
+    format = GL_BGRA; type = GL_UNSIGNED_INT_8_8_8_8_REV; depth = 4; break;
+  default: // MASK depends on the current color
+    return false;
+  }
+  internalformat =
+    (has_alpha(p) && has_alpha(image.pixeltype())) ? GL_RGBA8 : GL_RGB8;
+#endif
+  return true;
+}
+
+// Make the texture match the image:
+static void upload(GlTexture* t, const Image& image) {
+  t->serial = image.serial();
+  const uchar* data = image.buffer();
+  GLenum format, type; int depth; GLint internalformat;
+  if (!data || !pixel_format(image, format, type, depth, internalformat)) {
+    if (t->texture) {
+      glDeleteTextures(1, &t->texture); t->texture = 0;
+      fl_gl_textures--;
+    }
+    return;
+  }
+  const int w = image.w();
+  const int h = image.h();
+  const int linedelta = image.buffer_linedelta();
+
+  glPushAttrib(GL_TEXTURE_BIT);
+  glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, linedelta/depth);
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+  if (!t->texture || w != t->w || h != t->h || internalformat != t->internalformat) {
+    // (re)allocate the texture:
+    if (!t->texture) {glGenTextures(1, &t->texture); fl_gl_textures++;}
+    else t->changes++;
+    glBindTexture(GL_TEXTURE_2D, t->texture);
+    t->w = w; t->h = h; t->internalformat = internalformat;
+    t->tw = npot_textures ? w : nextpow2(w);
+    t->th = npot_textures ? h : nextpow2(h);
+    cache_mem -= t->mem;
+    fl_gl_texture_bytes -= t->mem;
+    t->mem = (unsigned long)t->tw*t->th*4;
+    if (t->pbo) t->mem += (unsigned long)linedelta*h;
+    cache_mem += t->mem;
+    fl_gl_texture_bytes += t->mem;
+    bool fits = t->tw == w && t->th == h;
+    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, t->tw, t->th, 0,
+		 format, type, fits ? data : 0);
+    if (!fits)
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  } else {
+    glBindTexture(GL_TEXTURE_2D, t->texture);
+    t->changes++;
+    // Images that change all the time are copied to a pixel buffer
+    // object, which lets the card read it while the program continues:
+    void* p = 0;
+    long size = long(linedelta)*(h-1) + w*depth;
+    if (t->changes > 1 && fl_has_pbo()) {
+      if (!t->pbo) {
+	glGenBuffers_(1, &t->pbo);
+	t->mem += (unsigned long)linedelta*h;
+	cache_mem += (unsigned long)linedelta*h;
+	fl_gl_texture_bytes += (unsigned long)linedelta*h;
+      }
+      glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, t->pbo);
+      // throw away the old contents so we don't wait for them to be used:
+      glBufferData_(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW);
+      p = glMapBuffer_(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    }
+    if (p) {
+      memcpy(p, data, size);
+      glUnmapBuffer_(GL_PIXEL_UNPACK_BUFFER);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type, 0);
+    } else {
+      if (t->pbo) glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, 0);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type, data);
+    }
+    if (t->pbo) glBindBuffer_(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  glPopClientAttrib();
+  glPopAttrib();
+}
+
+/**
+  Draw an fltk::Image in OpenGL as a texture-mapped rectangle with
+  corners at x,y and x+w,y+h in the current coordinate system, scaling
+  it to fit. As with the other gldrawimage, if you are in the normal
+  OpenGL coordinate system with 0,0 in the lower-left, the first line
+  of the image is at the bottom. Pass a negative \a h to flip it.
+
+  The first time an Image is drawn it is copied to a texture, and
+  later calls just draw that texture until Image::buffer_changed() or
+  setpixels() is called, so this is much faster than sending the
+  pixels every time. Images that change often are sent through a
+  pixel buffer object, if available, so the copy does not stall the
+  program. Images whose alpha would be used by Image::draw() are
+  blended with glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA).
+
+  On X the Image has to be in the server's format, so nothing is
+  drawn unless the display is 24 or 32 bits deep or XRender is being
+  used. MASK images are not drawn except on X.
+
+  The textures use up to glsetimagecache() bytes; when the limit is
+  hit the least recently drawn are deleted. Call glforgetimage()
+  before deleting an Image to free its texture immediately.
+*/
+void fltk::gldrawimage(const Image& image, int x, int y, int w, int h) {
+  if (!fl_current_glcontext) return;
+  fl_has_pbo(); // figure out what the card can do
+  image.fetch_if_needed();
+  GlTexture* t = find_texture(image);
+  if (t->serial != image.serial() ||
+      (t->texture && (image.w() != t->w || image.h() != t->h)))
+    upload(t, image);
+  trim_cache(t);
+  if (!t->texture) return;
+
+  glPushAttrib(GL_ENABLE_BIT|GL_TEXTURE_BIT|GL_COLOR_BUFFER_BIT);
+  glDisable(GL_LIGHTING);
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, t->texture);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  if (t->internalformat == GL_RGBA8) {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  } else {
+    glDisable(GL_BLEND);
+  }
+  const float u = float(t->w)/t->tw;
+  const float v = float(t->h)/t->th;
+  glBegin(GL_QUADS);
+  glTexCoord2f(0, 0); glVertex2i(x, y);
+  glTexCoord2f(u, 0); glVertex2i(x+w, y);
+  glTexCoord2f(u, v); glVertex2i(x+w, y+h);
+  glTexCoord2f(0, v); glVertex2i(x, y+h);
+  glEnd();
+  glPopAttrib();
+}
+
+/**
+  Set how many bytes of texture memory gldrawimage(const Image&,...)
+  may use. The default is 64 megabytes.
+*/
+void fltk::glsetimagecache(unsigned long bytes) {
+  cache_limit = bytes;
+  trim_cache(0);
+}
+
+/**
+  Return how many bytes of texture memory gldrawimage(const Image&,...)
+  is using.
+*/
+unsigned long fltk::glimagecachememused() {
+  return cache_mem;
+}
+
+/**
+  Delete the texture made for \a image by gldrawimage(), if any. Call
+  this before deleting an Image to free the memory right away, otherwise
+  it is freed when it becomes the least-recently drawn one.
+*/
+void fltk::glforgetimage(const Image& image) {
+  for (GlTexture* t = buckets[bucket(&image)]; t; t = t->hash_next)
+    if (t->image == &image) {forget(t); return;}
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,295 @@
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+// Drawing a GlWindow at a lower resolution while it is being resized
+// or is too slow to keep up, for GlWindow::adaptive_resolution(). The
+// draw() is done into a smaller framebuffer object, which is then
+// stretched into the window with glBlitFramebuffer(). Once nothing has
+// been drawn for a moment the window is drawn again at full size.
+
+#include <config.h>
+#if HAVE_GL
+
+#include <fltk/GlWindow.h>
+#include <fltk/run.h>
+#include <fltk/visual.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GlChoice.h"
+#include "GlBuffers.h"
+
+using namespace fltk;
+
+#ifndef GL_FRAMEBUFFER
+# define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_READ_FRAMEBUFFER
+# define GL_READ_FRAMEBUFFER 0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+# define GL_DRAW_FRAMEBUFFER 0x8CA9
+#endif
+#ifndef GL_RENDERBUFFER
+# define GL_RENDERBUFFER 0x8D41
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+# define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_DEPTH_STENCIL_ATTACHMENT
+# define GL_DEPTH_STENCIL_ATTACHMENT 0x821A
+#endif
+#ifndef GL_DEPTH24_STENCIL8
+# define GL_DEPTH24_STENCIL8 0x88F0
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+# define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+
+// Framebuffer objects are only in OpenGL 3.0 or ARB_framebuffer_object:
+typedef void (APIENTRY *GenFramebuffers)(GLsizei, GLuint*);
+typedef void (APIENTRY *DeleteFramebuffers)(GLsizei, const GLuint*);
+typedef void (APIENTRY *BindFramebuffer)(GLenum, GLuint);
+typedef void (APIENTRY *GenRenderbuffers)(GLsizei, GLuint*);
+typedef void (APIENTRY *DeleteRenderbuffers)(GLsizei, const GLuint*);
+typedef void (APIENTRY *BindRenderbuffer)(GLenum, GLuint);
+typedef void (APIENTRY *RenderbufferStorage)(GLenum, GLenum, GLsizei, GLsizei);
+typedef void (APIENTRY *FramebufferRenderbuffer)(GLenum, GLenum, GLenum, GLuint);
+typedef GLenum (APIENTRY *CheckFramebufferStatus)(GLenum);
+typedef void (APIENTRY *BlitFramebuffer)(GLint, GLint, GLint, GLint,
+					 GLint, GLint, GLint, GLint,
+					 GLbitfield, GLenum);
+
+static GenFramebuffers glGenFramebuffers_;
+static DeleteFramebuffers glDeleteFramebuffers_;
+static BindFramebuffer glBindFramebuffer_;
+static GenRenderbuffers glGenRenderbuffers_;
+static DeleteRenderbuffers glDeleteRenderbuffers_;
+static BindRenderbuffer glBindRenderbuffer_;
+static RenderbufferStorage glRenderbufferStorage_;
+static FramebufferRenderbuffer glFramebufferRenderbuffer_;
+static CheckFramebufferStatus glCheckFramebufferStatus_;
+static BlitFramebuffer glBlitFramebuffer_;
+
+static bool has_fbo() {
+  static int checked;
+  if (!checked) {
+    checked = 1;
+    if (atof((const char*)glGetString(GL_VERSION)) >= 3.0 ||
+	fl_gl_has_extension("GL_ARB_framebuffer_object")) {
+      glGenFramebuffers_ = (GenFramebuffers)fl_gl_getproc("glGenFramebuffers");
+      glDeleteFramebuffers_ = (DeleteFramebuffers)fl_gl_getproc("glDeleteFramebuffers");
+      glBindFramebuffer_ = (BindFramebuffer)fl_gl_getproc("glBindFramebuffer");
+      glGenRenderbuffers_ = (GenRenderbuffers)fl_gl_getproc("glGenRenderbuffers");
+      glDeleteRenderbuffers_ = (DeleteRenderbuffers)fl_gl_getproc("glDeleteRenderbuffers");
+      glBindRenderbuffer_ = (BindRenderbuffer)fl_gl_getproc("glBindRenderbuffer");
+      glRenderbufferStorage_ = (RenderbufferStorage)fl_gl_getproc("glRenderbufferStorage");
+      glFramebufferRenderbuffer_ = (FramebufferRenderbuffer)fl_gl_getproc("glFramebufferRenderbuffer");
+      glCheckFramebufferStatus_ = (CheckFramebufferStatus)fl_gl_getproc("glCheckFramebufferStatus");
+      glBlitFramebuffer_ = (BlitFramebuffer)fl_gl_getproc("glBlitFramebuffer");
+      if (glGenFramebuffers_ && glDeleteFramebuffers_ && glBindFramebuffer_ &&
+	  glGenRenderbuffers_ && glDeleteRenderbuffers_ && glBindRenderbuffer_ &&
+	  glRenderbufferStorage_ && glFramebufferRenderbuffer_ &&
+	  glCheckFramebufferStatus_ && glBlitFramebuffer_) checked = 2;
+    }
+  }
+  return checked == 2;
+}
+
+// How long nothing must be drawn before drawing at full size again:
+#define SETTLE_TIME .25f
+
+namespace fltk {
+
+struct GlReduced {
+  float scale;		// from adaptive_resolution()
+  float budget;		// seconds a full size frame may take
+  float current;	// scale of the frame being drawn
+  bool resizing;	// layout() changed the size
+  bool slow;		// the last full size frame took too long
+  bool failed;		// no framebuffer objects, don't try again
+  GLuint fbo, color, depth;
+  int fw, fh;		// size they are allocated
+  GLint draw_buffer;	// glDrawBuffer() to put back
+  double start;		// when flush() started
+};
+
+}
+
+// Timeout called when nothing has been drawn for SETTLE_TIME:
+void GlWindow::reduced_settled(void* v) {
+  GlWindow* window = (GlWindow*)v;
+  GlReduced* r = window->reduced_;
+  if (!r) return;
+  r->resizing = r->slow = false;
+  if (r->current < 1) window->redraw();
+}
+
+// Called by layout() when the size changes:
+void GlWindow::reduced_resized() {
+  // a window that was drawn is being resized by the user:
+  if (valid()) reduced_->resizing = true;
+}
+
+// Called by flush() before anything else, to pick the scale to draw at:
+void GlWindow::reduced_start() {
+  GlReduced* r = reduced_;
+  float scale = (r->resizing || r->slow) && !r->failed ? r->scale : 1;
+  if (scale != r->current) {
+    r->current = scale;
+    valid(0); // so draw() sets the viewport to pixel_w(), pixel_h()
+  }
+  r->start = get_time_secs();
+}
+
+// Called by flush() at the end:
+void GlWindow::reduced_finish() {
+  GlReduced* r = reduced_;
+  if (r->current >= 1)
+    r->slow = get_time_secs()-r->start > r->budget;
+  fltk::remove_timeout(reduced_settled, this);
+  if (r->current < 1 || r->slow || r->resizing)
+    fltk::add_timeout(SETTLE_TIME, reduced_settled, this);
+}
+
+// Call draw(), into the smaller framebuffer if the scale is not 1:
+void GlWindow::draw_scaled() {
+  GlReduced* r = reduced_;
+  if (!r || r->current >= 1) {draw(); return;}
+  const int W = pixel_w();
+  const int H = pixel_h();
+  if (!has_fbo()) {r->failed = true; r->current = 1; valid(0); draw(); return;}
+  if (!r->fbo) glGenFramebuffers_(1, &r->fbo);
+  glBindFramebuffer_(GL_FRAMEBUFFER, r->fbo);
+  if (W != r->fw || H != r->fh) {
+    if (!r->color) glGenRenderbuffers_(1, &r->color);
+    glBindRenderbuffer_(GL_RENDERBUFFER, r->color);
+    glRenderbufferStorage_(GL_RENDERBUFFER,
+			   (mode_ & ALPHA_BUFFER) ? GL_RGBA8 : GL_RGB8, W, H);
+    glFramebufferRenderbuffer_(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_RENDERBUFFER, r->color);
+    if (mode_ & (DEPTH_BUFFER|STENCIL_BUFFER)) {
+      if (!r->depth) glGenRenderbuffers_(1, &r->depth);
+      glBindRenderbuffer_(GL_RENDERBUFFER, r->depth);
+      glRenderbufferStorage_(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, W, H);
+      glFramebufferRenderbuffer_(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+				 GL_RENDERBUFFER, r->depth);
+    }
+    glBindRenderbuffer_(GL_RENDERBUFFER, 0);
+    r->fw = W;
+    r->fh = H;
+    if (glCheckFramebufferStatus_(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      glBindFramebuffer_(GL_FRAMEBUFFER, 0);
+      reduced_release();
+      r->failed = true; r->current = 1; valid(0);
+      draw();
+      return;
+    }
+  }
+  glGetIntegerv(GL_DRAW_BUFFER, &r->draw_buffer);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  draw();
+  // stretch it into the window:
+  glBindFramebuffer_(GL_READ_FRAMEBUFFER, r->fbo);
+  glBindFramebuffer_(GL_DRAW_FRAMEBUFFER, 0);
+  glDrawBuffer(r->draw_buffer);
+  glPushAttrib(GL_SCISSOR_BIT);
+  glDisable(GL_SCISSOR_TEST);
+  glBlitFramebuffer_(0, 0, W, H, 0, 0, w(), h(), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glPopAttrib();
+  glBindFramebuffer_(GL_FRAMEBUFFER, 0);
+}
+
+// Free the framebuffer, the context must be current:
+void GlWindow::reduced_release() {
+  GlReduced* r = reduced_;
+  if (r->fbo) glDeleteFramebuffers_(1, &r->fbo);
+  if (r->color) glDeleteRenderbuffers_(1, &r->color);
+  if (r->depth) glDeleteRenderbuffers_(1, &r->depth);
+  r->fbo = r->color = r->depth = 0;
+  r->fw = r->fh = 0;
+}
+
+/**
+  Draw the window at \a scale times its size, stretched to fill it,
+  while it is being resized or when drawing at full size takes longer
+  than \a budget seconds. Once nothing has been drawn for a quarter
+  second the window is redrawn at full size. This keeps slow scenes
+  interactive in large windows. A \a scale of 0 or 1 turns this off.
+
+  draw() is called with valid() off whenever the scale changes, and
+  must use pixel_w() and pixel_h() rather than w() and h() for
+  glViewport() (ortho() does this). If draw() binds its own
+  framebuffer objects it must bind back the one that was bound when
+  it was called, rather than 0. This needs OpenGL 3.0 or
+  ARB_framebuffer_object, without it the window is always drawn at
+  full size.
+*/
+void GlWindow::adaptive_resolution(float scale, float budget) {
+  if (scale <= 0 || scale >= 1) {
+    if (!reduced_) return;
+    if (context_ && shown()) {make_current(); reduced_release();}
+    fltk::remove_timeout(reduced_settled, this);
+    if (reduced_->current < 1) {valid(0); redraw();}
+    delete reduced_;
+    reduced_ = 0;
+    return;
+  }
+  if (!reduced_) {
+    reduced_ = new GlReduced;
+    memset(reduced_, 0, sizeof(GlReduced));
+    reduced_->current = 1;
+  }
+  reduced_->scale = scale;
+  reduced_->budget = budget;
+}
+
+/** Returns the scale set by adaptive_resolution(), or 1 if it is off. */
+float GlWindow::adaptive_resolution() const {
+  return reduced_ ? reduced_->scale : 1;
+}
+
+/**
+  The width of the area draw() draws. This is w() unless the window is
+  being drawn at a lower resolution, see adaptive_resolution().
+*/
+int GlWindow::pixel_w() const {
+  if (!reduced_ || reduced_->current >= 1) return w();
+  int W = int(w()*reduced_->current+.5f);
+  return W > 0 ? W : 1;
+}
+
+/**
+  The height of the area draw() draws. This is h() unless the window is
+  being drawn at a lower resolution, see adaptive_resolution().
+*/
+int GlWindow::pixel_h() const {
+  if (!reduced_ || reduced_->current >= 1) return h();
+  int H = int(h()*reduced_->current+.5f);
+  return H > 0 ? H : 1;
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
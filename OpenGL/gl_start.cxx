@@ -65,6 +65,24 @@ bool fltk::glVisual(int mode) {
 static GLContext context;
 //static int clip_state_number=-1;
 static int pw, ph;
+// glbeginbatch() nesting and the window that glstart() synchronized
+// with in the batch:
+static int batch_depth;
+static const Window* batch_window;
+// the scissor set by glstart(), only trusted in a batch:
+static bool scissor_on;
+static Rectangle scissor;
+
+static void wait_for_gl() {
+  glFlush();
+#ifdef _WIN32
+  ;
+#elif defined(__APPLE__)
+  ;
+#else
+  glXWaitGL();
+#endif
+}
 
 /**
   Set up an OpenGL context to draw into the current window being
@@ -89,37 +107,53 @@ static int pw, ph;
   Do \e not call glstart()/glfinish() when drawing into a GlWindow!
 */
 void fltk::glstart() {
+  const Window* window = Window::drawing_window();
+  // A different window in a batch gets its own synchronization:
+  if (batch_depth && batch_window && batch_window != window) {
+    wait_for_gl();
+    batch_window = 0;
+  }
   if (!context) {
 #ifdef _WIN32
     if (!gl_choice) glVisual(0);
-    context = create_gl_context(Window::drawing_window(), gl_choice);
+    context = create_gl_context(window, gl_choice);
 #elif defined(__APPLE__)
-    context = create_gl_context(Window::drawing_window(), gl_choice);
+    context = create_gl_context(window, gl_choice);
 #else
     context = create_gl_context(xvisual);
 #endif
   }
-  set_gl_context(Window::drawing_window(), context);
+  set_gl_context(window, context);
+  bool synced = batch_depth && batch_window == window;
 #ifdef _WIN32
   ;
 #elif defined(__APPLE__)
   ;
 #else
-  glXWaitX();
+  if (!synced) glXWaitX();
 #endif
-  if (pw != Window::drawing_window()->w() || ph != Window::drawing_window()->h()) {
-    pw = Window::drawing_window()->w();
-    ph = Window::drawing_window()->h();
+  if (batch_depth) batch_window = window;
+  if (pw != window->w() || ph != window->h()) {
+    pw = window->w();
+    ph = window->h();
     glLoadIdentity();
     glViewport(0, 0, pw, ph);
     glOrtho(0, pw, 0, ph, -1, 1);
     glDrawBuffer(GL_FRONT);
   }
   // obey the clipping. Only rectangles work:
-  Rectangle r(Window::drawing_window()->w(), Window::drawing_window()->h());
+  Rectangle r(window->w(), window->h());
   // 0 = all clipped, 1 = no change, 2 = partial clip:
-  if (intersect_with_clip(r) != 1) {
-    glScissor(r.x(), Window::drawing_window()->h()-r.b(), r.w(), r.h());
+  bool clip = intersect_with_clip(r) != 1;
+  // in a batch the scissor is left alone if it has not changed:
+  if (synced && clip == scissor_on && (!clip || (
+      r.x() == scissor.x() && r.y() == scissor.y() &&
+      r.w() == scissor.w() && r.h() == scissor.h())))
+    return;
+  scissor_on = clip;
+  scissor = r;
+  if (clip) {
+    glScissor(r.x(), window->h()-r.b(), r.w(), r.h());
     glEnable(GL_SCISSOR_TEST);
   } else {
     glDisable(GL_SCISSOR_TEST);
@@ -129,16 +163,43 @@ void fltk::glstart() {
 /**
   Turn off the effects of a previous glstart(). You must call this before
   using normal fltk drawing methods.
+
+  Inside glbeginbatch() this does nothing, the flush and wait are done
+  by glendbatch().
 */
 void fltk::glfinish() {
-  glFlush();
-#ifdef _WIN32
-  ;
-#elif defined(__APPLE__)
-  ;
-#else
-  glXWaitGL();
-#endif
+  if (!batch_depth) wait_for_gl();
+}
+
+/**
+  Start a batch of glstart()/glfinish() sections, such as all the GL
+  overlays drawn by the widgets of one window in one redraw. Only the
+  first glstart() in a window waits for the preceding fltk drawing,
+  and glfinish() does not wait for OpenGL until glendbatch() is
+  called. The clipping is only given to OpenGL again when it changes.
+
+  This means fltk drawing between two sections of a batch may be
+  done in either order with the OpenGL drawing, so it must not overlap
+  it. The OpenGL code must also leave the scissor test as glstart()
+  set it.
+
+  Calls may be nested, only the outermost glendbatch() ends the
+  batch.
+*/
+void fltk::glbeginbatch() {
+  batch_depth++;
+}
+
+/**
+  End a batch started by glbeginbatch(). If any OpenGL drawing was
+  done it is flushed and waited for once here, so normal fltk drawing
+  may be done after this.
+*/
+void fltk::glendbatch() {
+  if (!batch_depth || --batch_depth) return;
+  if (!batch_window) return;
+  batch_window = 0;
+  wait_for_gl();
 }
 
 #endif
@@ -76,8 +76,11 @@ class AnsiWidget : public Widget {
     void newLine();
     void reset();
     void setFont();
+    void addDirty(int x, int y, int width, int height);
+    void addRectDirty(int x1, int y1, int x2, int y2);
 
     Image* img;
+    Rectangle dirty; // part of img not yet copied to the window
     bool underline;
     bool invert;
     bool bold;
@@ -0,0 +1,72 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_AsyncList_h
+#define fltk_AsyncList_h
+
+#include "StringList.h"
+
+namespace fltk {
+
+struct AsyncListMenu;
+
+class FL_API AsyncList : public StringList {
+  AsyncListMenu* menus_;
+  const char* pending_label_;
+  bool pending_;
+  AsyncListMenu* find(const Menu*, bool create);
+  static void request_cb(void*);
+  static void arrived_cb(void*);
+  void do_arrived(const Menu*, int first, int n);
+public:
+  // overrides of List virtual functions:
+  virtual Widget* child(const Menu*, const int* indexes, int level);
+  virtual void visible_items(const Menu*, int n);
+  // override of StringList virtual function:
+  virtual const char* label(const Menu*, const int* indexes, int level);
+  using StringList::label;
+  // new virtual functions:
+  /** Start getting \a n rows starting at \a first, and call arrived()
+      when they are there. This must not wait for them. */
+  virtual void request(const Menu*, int first, int n) = 0;
+
+  void arrived(const Menu*, int first, int n);
+  bool ready(const Menu*, int row);
+  void reset(const Menu*);
+  void forget(const Menu*);
+
+  /** Set the label shown for rows that have not arrived yet */
+  void pending_label(const char* l) {pending_label_ = l;}
+  /** The label shown for rows that have not arrived yet */
+  const char* pending_label() const {return pending_label_;}
+
+  AsyncList();
+  ~AsyncList();
+};
+
+}
+#endif
+
+//
+// End of "$Id$".
+//
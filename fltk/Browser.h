@@ -26,9 +26,13 @@
 
 #include "Menu.h"
 #include "Scrollbar.h"
+#include "IntervalSet.h"
 
 namespace fltk {
 
+class MappedStringList;
+struct BrowserSubtrees;
+
 class FL_API Browser : public Menu {
 public:
   
@@ -141,6 +145,9 @@ public:
   bool item_is_parent() const;
   bool item_is_open() const;
   int item_h() const;
+  /** \return The height of every item if set by fixed_item_h(int) */
+  int fixed_item_h() const {return fixed_item_h_;}
+  void fixed_item_h(int h);
 
   bool set_focus();
   /** Set the browser's current Mark to the passed value
@@ -187,6 +194,12 @@ public:
   int value() const {return FOCUS.indexes[0];}
   bool select(int line, bool value = true);
   bool selected(int line);
+  bool select_rows(int from, int to, bool value = true, int do_callback = 0);
+  /** \return Whether a MultiBrowser keeps the selected rows in selected_rows() */
+  bool row_selection() const {return row_selection_;}
+  void row_selection(bool);
+  /** \return The selected top-level rows when row_selection() is on */
+  IntervalSet& selected_rows() {return selected_rows_;}
   int topline() const {return FIRST_VISIBLE.indexes[0];}
   void topline(int line) {goto_index(line); make_item_visible(TOP);}
   void bottomline(int line) {goto_index(line); make_item_visible(BOTTOM);}
@@ -198,6 +211,7 @@ public:
   void display_lines(bool display);
 
   int load(const char *filename);
+  int load(const char *filename, bool mapped);
   
   /** \return Whether or not this browser has its type() set to include MULTI */
   int multi() const {return type()&IS_MULTI;}
@@ -230,6 +244,13 @@ private:
       height_; //!< The height of all the visible items
   int scrolldx, //!< The amount the user has scrolled horizontally since the last redraw
       scrolldy; //!< The amount the user has scrolled vertically since the last redraw
+  int fixed_item_h_; //!< The height of every item, or 0 to measure them
+  int* heights_; //!< Fenwick tree of the height of each top-level item and its open children
+  int nheights_, //!< The number of top-level items in heights_
+      heights_size_; //!< The allocated size of heights_
+  bool heights_ok() const;
+  int toplevel_position(int i) const;
+  Widget* goto_toplevel(int i);
   static void hscrollbar_cb(Widget*, void*);
   static void scrollbar_cb(Widget*, void*);
   void draw_item(int);
@@ -265,6 +286,21 @@ private:
 
   const Symbol* leaf_symbol_; //!< The symbol used to draw child items.
   const Symbol* group_symbol_; //!< The symbol used to draw parent items
+
+  MappedStringList* mapped_list_; //!< Made by load(filename, true)
+  List* unmapped_list_; //!< The list() before load(filename, true)
+  void unload_mapped();
+
+  IntervalSet selected_rows_; //!< Selected top-level rows if row_selection_
+  bool row_selection_; //!< selected_rows_ is used rather than SELECTED flags
+  int nested_selected_; //!< Items below the top level selected with row_selection_
+  Widget* fetch_item(int level);
+
+  BrowserSubtrees* subtrees_; //!< Height of the open children of each open parent
+  int measured_width_; //!< width_ as measured by layout()
+  bool skip_measure_; //!< layout() can use the heights set by set_item_opened()
+  bool open_incrementally(bool open);
+  void shift_mark(Mark&, const Mark& node, int dy);
 };
 
 }
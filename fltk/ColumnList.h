@@ -0,0 +1,96 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_ColumnList_h
+#define fltk_ColumnList_h
+
+#include "Menu.h"
+
+namespace fltk {
+
+class Browser;
+class ColumnListItem;
+
+class FL_API ColumnList : public List {
+  int columns_;
+  int rows_;
+  int size_;		 // space allocated in each array
+  char*** cells_;	 // cells_[column][row]
+  float** widths_;	 // cached width of each cell, negative if unknown
+  Font* widthfont_;	 // font and size the widths were measured with
+  float widthsize_;
+  unsigned char* rowflags_; // SELECTED and STATE of each row
+  int* order_;		 // row shown at each position
+  ColumnListItem* item_;
+  // Sort in progress:
+  int* sortfrom_;
+  int* sortto_;
+  int sortwidth_, sortpos_;
+  Menu* sortmenu_;
+  int sortcolumn_;
+  bool descending_;
+  bool sorted_;
+  void grow(int n);
+  void stop_sort();
+  void sort_done();
+  bool sort_step(int budget);
+  static void sort_idle_cb(void*);
+public:
+  // overrides of List virtual functions:
+  virtual int children(const Menu*, const int* indexes, int level);
+  virtual Widget* child(const Menu*, const int* indexes, int level);
+  virtual void flags_changed(const Menu*, Widget*);
+  // new virtual functions:
+  virtual int compare(int column, int row1, int row2);
+
+  int columns() const {return columns_;}
+  int rows() const {return rows_;}
+  int add(const char* const* cells);
+  void set(int row, int column, const char* text);
+  /** Return the text in a cell, \a row is the order rows were added in */
+  const char* cell(int row, int column) const {return cells_[column][row];}
+  float cell_width(int row, int column);
+  void clear();
+
+  /** Return the row shown at a position in the browser */
+  int row(int position) const {return order_[position];}
+  void sort(Menu*, int column, bool descending = false);
+  bool column_clicked(Browser*);
+  void finish_sort();
+  /** Return true if a sort is being done in idle time */
+  bool sorting() const {return sortfrom_ != 0;}
+  /** Return the column the rows are sorted by, or -1 if not sorted */
+  int sort_column() const {return sorted_ ? sortcolumn_ : -1;}
+  /** Return true if the rows are sorted with the largest first */
+  bool sort_descending() const {return descending_;}
+
+  ColumnList(int columns);
+  ~ColumnList();
+};
+
+}
+#endif
+
+//
+// End of "$Id$".
+//
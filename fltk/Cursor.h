@@ -16,6 +16,7 @@ struct Cursor; // this is not public
 
 class Image;
 extern FL_API Cursor* cursor(Image*, int x, int y);
+extern FL_API Cursor* cursor(Image* const* frames, int n, int x, int y, float delay);
 extern FL_API Cursor* cursor(void *raw);
 
 extern FL_API Cursor* const CURSOR_DEFAULT; // == NULL
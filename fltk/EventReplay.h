@@ -0,0 +1,73 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#ifndef fltk_EventReplay_h
+#define fltk_EventReplay_h
+
+#include "FL_API.h"
+#include <stdio.h>
+
+namespace fltk {
+
+class Window;
+struct ReplayRecord;
+
+/*!
+  Plays back a session saved by fltk::start_recording(), and measures
+  how long each event takes.
+*/
+class FL_API EventReplay {
+  ReplayRecord* records;
+  int nrecords, next_;
+  char** windows;	// description of each window id in the file
+  int nwindows;
+  Window** found;	// the window each ones refers to now
+  float* latency_;
+  int replayed_, missing_;
+  Window* find_window(int id);
+  void clear();
+public:
+  EventReplay();
+  ~EventReplay();
+  bool load(FILE*);
+  bool load(const char* filename);
+
+  int records_loaded() const {return nrecords;}
+  bool done() const {return next_ >= nrecords;}
+  bool step();
+  void run(float speed = 0);
+
+  int replayed() const {return replayed_;}
+  int missing() const {return missing_;}
+  float latency(int i) const {return latency_[i];}
+  float percentile(float) const;
+};
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
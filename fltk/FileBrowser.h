@@ -38,6 +38,7 @@
 
 namespace fltk {
 
+struct FileBrowserJob;
 
 //
 // FileBrowser class...
@@ -49,6 +50,16 @@ class FL_API FileBrowser : public Browser
   const char	*directory_; /**< The current directory */
   float		icon_size_; /**< The FileBrowser's icon sizes */
   const char	*pattern_; /**< The filename glob pattern \todo regex! */
+  FilenamePatterns filter_patterns_; /**< pattern_ compiled for load() */
+  FileSortF	*sort_; /**< The sorting function passed to load() */
+  FileBrowserJob *job_; /**< The streaming load() that is still reading */
+  bool		streaming_; /**< Whether load() returns before reading the directory */
+
+  void		merge(dirent** list, const char* types, int n);
+  int		start_loading();
+  void		stop_loading();
+  static void	batch_cb(void*);
+  static void	idle_cb(void*);
 
 public:
   /** The types of items this browser can show */
@@ -58,6 +69,7 @@ public:
   };
 
   FileBrowser(int, int, int, int, const char * = 0);
+  ~FileBrowser();
 
   /** \returns The icon size as a float */
   float		icon_size() const { 
@@ -71,8 +83,18 @@ public:
   void	filter(const char *pattern);
   /** \returns The filter pattern */
   const char	*filter() const { return (pattern_); };
+  bool		shows(const char *name, bool isdir) const;
 
   int		load(const char *directory, FileSortF *sort = (FileSortF*) fltk::numericsort);
+
+  /** Makes load() return at once and add the files as they are read
+    \param v true to turn streaming on
+  */
+  void		streaming(bool v) { streaming_ = v; }
+  /** \returns Whether load() adds the files as they are read */
+  bool		streaming() const { return streaming_; }
+  /** \returns true if a streaming load() is still reading the directory */
+  bool		loading() const { return job_ != 0; }
   
   /** \returns the current Browser's textsize */
   float		textsize() const { return (Browser::textsize()); };
@@ -43,6 +43,8 @@
 
 namespace fltk  {
 
+class FL_API SharedImage;
+
 class FL_API FileChooser  {
 private:
   static fltk::Preferences prefs_;
@@ -61,6 +63,12 @@ private:
   void showChoiceCB();
   void update_favorites();
   void update_preview();
+  enum {PREVIEW_CACHE = 8};
+  SharedImage *preview_cache_[PREVIEW_CACHE]; // most recently shown first
+  SharedImage *preview_loading_; // being fetched for the preview
+  SharedImage *preview_image(const char *filename);
+  void show_preview_image(SharedImage *image);
+  static void preview_fetched(SharedImage *image, void *fc);
   void update_sort();
   int favorites_showing;
   void activate_okButton_if_file();
@@ -215,6 +223,7 @@ public:
   static const char *new_directory_label;
   static const char *new_directory_tooltip;
   static const char *preview_label;
+  static const char *preview_loading_label;
   static const char *save_label;
   static const char *show_label;
   static FileSortF *sort;
@@ -100,6 +100,7 @@ enum {
   RESIZE_NONE		  = 0,	//!< default behavior
   RESIZE_FIT		  = 0x01000000, //!< proportionnaly resize img in widget
   RESIZE_FILL		  = 0x00800000, //!< resize img to fill the widget
+  CACHED		  = 0x02000000, //!< Widget::set_cached()
   OPENED		  = STATE	//!< opened browser hierarchy parent
 };
 
@@ -56,6 +56,19 @@ struct FL_API Font {
 
   static const char* current_name();
 
+  static bool fast_metrics_;
+  static void fast_metrics(bool v) {fast_metrics_ = v;}
+  static bool fast_metrics() {return fast_metrics_;}
+
+  static int max_open_fonts_;
+  static void max_open_fonts(int n) {max_open_fonts_ = n;}
+  static int max_open_fonts() {return max_open_fonts_;}
+  static int open_fonts();
+
+  static float size_step_;
+  static void size_step(float v) {size_step_ = v;}
+  static float size_step() {return size_step_;}
+
 };
 
 // Find a Font from a name and attributes:
@@ -66,6 +79,9 @@ FL_API Font* font(int);
 
 // Find and return every font on the system.
 FL_API int list_fonts(Font**& arrayp);
+FL_API void prefetch_fonts();
+FL_API void prefetch_fonts(Font** fonts, const float* sizes, int n);
+FL_API void list_fonts(void (*done)(void*), void* arg = 0);
 
 }
 
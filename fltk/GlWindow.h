@@ -38,6 +38,8 @@ typedef void* GLContext; //!< Actually a GLXContext or HGLDC
 
 class GlChoice; // structure to hold result of glXChooseVisual
 class GlOverlay; // used by X version for the overlay
+struct GlCapture; // buffers used by capture()
+struct GlReduced; // framebuffer used by adaptive_resolution()
 
 enum {
   NO_AUTO_SWAP = 1024,
@@ -68,6 +70,15 @@ public:
   void make_current();
   void swap_buffers();
   void ortho();
+  int pixel_w() const;
+  int pixel_h() const;
+  void adaptive_resolution(float scale, float budget = 1.0f/30);
+  float adaptive_resolution() const;
+
+  typedef void (*CaptureCallback)(GlWindow*, const uchar* pixels,
+				  int w, int h, int linedelta, void* data);
+  void capture(CaptureCallback, void* data = 0);
+  bool capturing() const {return capture_ != 0;}
 
   bool can_do_overlay();
   void redraw_overlay();
@@ -90,6 +101,20 @@ private:
   GlChoice *gl_choice;
   GLContext context_;
   void _context(void*, bool destroy_flag);
+  GlCapture* capture_;
+  void capture_frame(unsigned buffer);
+  void capture_release();
+  unsigned scene_texture_; // copy of draw() for the emulated overlay
+  int scene_w_, scene_h_, scene_tw_, scene_th_;
+  void save_scene();
+  bool restore_scene();
+  GlReduced* reduced_;
+  void reduced_resized();
+  void reduced_start();
+  void reduced_finish();
+  void reduced_release();
+  void draw_scaled();
+  static void reduced_settled(void*);
   char valid_;
   char damage1_; // damage() of back buffer
   void init();
@@ -0,0 +1,65 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#ifndef fltk_GlyphRun_h
+#define fltk_GlyphRun_h
+
+#include "FL_API.h"
+
+namespace fltk {
+
+struct Font;
+
+class FL_API GlyphRun {
+  char* text_;
+  int n_;		// bytes in text_
+  Font* font_;
+  float size_;
+  int count_;		// characters
+  int* offset_;		// byte where each character starts, and n_
+  float* x_;		// position of each character, and the width
+  unsigned* glyph_;	// system's glyph numbers, or null
+public:
+  GlyphRun();
+  GlyphRun(const char* text, int n, Font*, float size);
+  ~GlyphRun();
+  void set(const char* text, int n, Font*, float size);
+  void draw(float x, float y) const;
+  const char* text() const {return text_;}
+  int length() const {return n_;}
+  Font* font() const {return font_;}
+  float size() const {return size_;}
+  int characters() const {return count_;}
+  float width() const {return count_ ? x_[count_] : 0;}
+  float position(int byte) const;
+  int offset(float x) const;
+};
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -35,6 +35,10 @@
 
 namespace fltk {
 
+class DisplayList;
+struct GroupIndex;
+struct GroupGrid;
+
 class FL_API Group : public Widget {
 public:
 
@@ -67,6 +71,7 @@ public:
   void replace(Widget& old, Widget& o) {replace(find(old),o);}
   void swap(int indexA, int indexB);
   void clear();
+  void reserve(int n);
 
   void resizable(Widget& o) {resizable_ = &o;}
   void resizable(Widget* o) {resizable_ = o;}
@@ -86,23 +91,36 @@ public:
   Flags resize_align() const {return resize_align_;}
   void resize_align(Flags f) {resize_align_ = f;}
 
+  void retained(bool);
+  bool retained() const {return display_list_ != 0;}
+
+  void spatial_index(bool);
+  bool spatial_index() const {return grid_ != 0;}
+
 protected:
 
   void draw_child(Widget&) const;
   void update_child(Widget&) const;
+  bool layout_child(Widget&, int extradamage = 0);
   void draw_outside_label(Widget&) const ;
   int initial_w, initial_h;
   int* sizes();
   void layout(const Rectangle&, int layout_damage);
+  const int* children_in(const Rectangle&, int& n) const;
+  void scroll_children(int dx, int dy);
 
 private:
 
   int children_;
+  int capacity_; // size of array_
   int focus_index_;
   Widget** array_;
   Widget* resizable_;
   Flags resize_align_;
   int *sizes_; // remembered initial sizes of children
+  DisplayList* display_list_; // recording of draw() if retained()
+  mutable GroupIndex* index_; // hash table used by find() if many children
+  mutable GroupGrid* grid_; // where children are, if spatial_index()
 
   static Group *current_;
 
@@ -59,6 +59,19 @@ struct HelpBlock {
   int line[32];                 /**< Left starting position for each line */
 };
 
+/** HelpTable structure, used internally in the HelpView.
+    Remembers the measured column widths of a table, so format()
+    only has to fit them to the width of the view */
+struct HelpTable {
+  const char *start;            /**< Start of the table in the text */
+  Font *font;                   /**< Font the table was measured in */
+  int fsize;                    /**< Size of that font */
+  int width;                    /**< WIDTH attribute, 0 if none */
+  int num_columns;              /**< Number of columns */
+  int *columns;                 /**< Widest text of each column */
+  int *minwidths;               /**< Widest word or image of each column */
+};
+
 /** HelpLink structure.
     This is what the HTML viewer considers a "link"
 	*/
@@ -165,10 +178,13 @@ class FL_API HelpView : public Group    //// Help viewer widget
   int nblocks_,                 /**< Number of blocks/paragraphs */
     ablocks_;                   /**< Allocated blocks */
   HelpBlock *blocks_;       	/**< Blocks */
+  int *blockbottom_,            /**< Lowest bottom of blocks_[0..i] */
+    *blocktop_;                 /**< Highest top of blocks_[i..] */
 
   int nfonts_;                  /**< Number of fonts in stack */
   Font *fonts_[100];         	/**< Font stack */
   int fontsizes_[100];
+  int maxfsize_;                /**< Largest font size pushed by format() */
 
   HelpFunc *link_;          	/**< Link transform function */
 
@@ -180,12 +196,23 @@ class FL_API HelpView : public Group    //// Help viewer widget
     atargets_;                  /**< Allocated targets */
   HelpTarget *targets_;     	/**< Targets */
 
+  int ntables_,                 /**< Number of measured tables */
+    atables_;                   /**< Allocated tables */
+  HelpTable *tables_;       	/**< Measured tables, in text order */
+
   char directory_[1024];        /**< Directory for current file */
   char filename_[1024];         /**< Current filename */
   int topline_,                 /**< Top line in document */
     leftline_,                  /**< Lefthand position */
     size_,                      /**< Total document length */
-    hsize_;                     /**< Maximum document width */
+    hsize_,                     /**< Maximum document width */
+    format_w_,                  /**< w() of the last format(), -1 if none */
+    scrolldx_,                  /**< Scrolling not drawn yet */
+    scrolldy_;
+  int loaded_,                  /**< Bytes of value_ formatted while loading */
+    loadlen_;                   /**< Length of value_ while loading, else 0 */
+  char loadchar_;               /**< Byte of value_ replaced by a nul at loaded_ */
+  bool streaming_;              /**< Whether load() formats the text in pieces */
   Scrollbar *scrollbar_,      	/**< Vertical scrollbar for document */
     *hscrollbar_;               /**< Horizontal scrollbar */
 
@@ -198,8 +225,16 @@ class FL_API HelpView : public Group    //// Help viewer widget
   int do_align (HelpBlock * block, int line, int xx, int a, int &l);
   void write_text (const char * buf, const char * ptr, int X, int Y, int X1, int underline);
   void draw ();
+  void draw_blocks (const Rectangle &r);
+  static void draw_clip_cb (void *v, const Rectangle &r);
+  void index_blocks ();
+  static bool load_job (void *v);
+  void load_more ();
+  void stop_loading ();
   void format ();
   void format_table (int *table_width, int *columns, const char *table);
+  const HelpTable *measure_table (const char *table);
+  void clear_tables ();
   int get_align (const char *p, int a);
   const char *get_attr (const char *p, const char *n, char *buf, int bufsize);
   Color get_color (const char *n, Color c);
@@ -258,6 +293,15 @@ public:
     link_ = fn;
   }
   int load (const char *f);
+  /** Makes load() show the start of large files at once, and format
+    the rest in idle time
+    \param v true to turn streaming on
+  */
+  void streaming (bool v) { streaming_ = v; }
+  /** \returns Whether load() formats large files in pieces */
+  bool streaming () const { return streaming_; }
+  /** \returns true if a streaming load() has more text to format */
+  bool loading () const { return loadlen_ != 0; }
   void layout();
   /** Gets the size of the HelpView */
   int size () const { return (size_); } 
@@ -288,6 +332,7 @@ public:
   /** \returns the current buffer contents */
   const char *value () const { return (value_); }
   int find (const char *s,int p);
+  int find_all (const char *s, int *positions, int n);
 };
 
 } // namespace fltk
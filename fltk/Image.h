@@ -37,24 +37,28 @@ class FL_API Image : public Symbol {
   PixelType pixeltype_; int w_, h_;
   Picture* picture;
   int flags; enum {COPIED=1, FETCHED=2, FORCEARGB32=4, MEASUREFETCH=8};
+  unsigned long serial_;
 
   static unsigned long memused_;
+  static unsigned long serials_;
+  static int atlas_size_;
+  static int scale_quality_;
 
 public:
 
   Image(const char* name=0) :
     Symbol(name), pixeltype_(fltk::RGB32), w_(12), h_(12),
-    picture(0), flags(MEASUREFETCH) {}
+    picture(0), flags(MEASUREFETCH), serial_(++serials_) {}
   Image(int w, int h, const char* name=0) :
     Symbol(name), pixeltype_(fltk::RGB32), w_(w), h_(h),
-    picture(0), flags(0) {}
+    picture(0), flags(0), serial_(++serials_) {}
   Image(PixelType p, int w, int h, const char* name=0) :
     Symbol(name), pixeltype_(p), w_(w), h_(h),
-    picture(0), flags(0) {}
+    picture(0), flags(0), serial_(++serials_) {}
   Image(const uchar* d, PixelType p, int w, int h) :
-    Symbol(), picture(0) {setimage(d,p,w,h);}
+    Symbol(), picture(0), serial_(++serials_) {setimage(d,p,w,h);}
   Image(const uchar* d, PixelType p, int w, int h, int linedelta) :
-    Symbol(), picture(0) {setimage(d,p,w,h,linedelta);}
+    Symbol(), picture(0), serial_(++serials_) {setimage(d,p,w,h,linedelta);}
   ~Image();
 
   PixelType pixeltype() const {return pixeltype_;}
@@ -84,13 +88,15 @@ public:
   int buffer_width() const;
   int buffer_height() const;
   int buffer_linedelta() const;
-  void buffer_changed() {flags &= ~COPIED;}
+  void buffer_changed() {flags &= ~COPIED; serial_ = ++serials_;}
+  unsigned long serial() const {return serial_;}
   void destroy();
 
   void draw(int x, int y) const;
   void draw(const Rectangle& r) const {_draw(r);}
   void draw(const Rectangle& from, const Rectangle& to) const;
   void draw_diced(const Rectangle& R);
+  bool draw_tiled(const Rectangle& r) const;
 
   void _draw(const Rectangle&) const; // Symbol virtual method
   void _measure(int& W, int& H) const; // Symbol virtual method
@@ -98,9 +104,16 @@ public:
   virtual bool fetch(); // for image file reading subclasses
   void fetch_if_needed() const;
   void refetch() {flags &= ~FETCHED;}
+  bool fetched() const {return (flags&FETCHED) != 0;}
+  void set_fetched() {flags |= FETCHED;}
 
   unsigned long mem_used() const;
   static unsigned long total_mem_used() {return memused_;}
+  static int atlas_size() {return atlas_size_;}
+  static void atlas_size(int n) {atlas_size_ = n;}
+  enum {NEAREST, BILINEAR, BOX}; // values for scale_quality()
+  static int scale_quality() {return scale_quality_;}
+  static void scale_quality(int q) {scale_quality_ = q;}
 
   // for back compatability with fltk1 only:
   void label(Widget* o);
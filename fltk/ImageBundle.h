@@ -0,0 +1,61 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#ifndef fltk_ImageBundle_h
+#define fltk_ImageBundle_h
+
+#include "Image.h"
+
+namespace fltk {
+
+struct ImageBundleJob;
+
+class FL_API ImageBundle : public Image {
+public:
+  ImageBundle(const uchar* data, unsigned length, const char* name = 0);
+  ~ImageBundle();
+
+  int icons() const {return icons_;}
+  const Symbol* icon(int i) const;
+  const Symbol* icon(const char* name) const;
+
+  void decode_in_background();
+  bool fetch();
+
+private:
+  struct Icon;
+  Icon** icon_;
+  int icons_;
+  const uchar* pixels_;	// the compressed pixels in data
+  const uchar* end_;	// end of data
+  ImageBundleJob* job_;		// decode_in_background() in progress
+};
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
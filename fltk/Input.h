@@ -59,6 +59,7 @@ public:
   bool text(const char*, int);
   bool static_text(const char*);
   bool static_text(const char*, int);
+  bool share_text(const Input*);
   const char* text() const {return text_;}
   char at(int i) const {return text_[i];}
 #ifdef FLTK_1_WIDGET  // back-compatability section:
@@ -109,15 +110,28 @@ private:
   int position_;
   int mark_;
   int xscroll_, yscroll_;
-  int mu_p;
+  int mu_p, mu_e;
   int label_width;
 
+  // where each line draw() shows starts, nlines_ is 0 if unknown:
+  mutable int* linestart_;
+  mutable int nlines_, linestartsize_;
+  mutable int lines_wordwrap_;
+  mutable Font* lines_font_;
+  mutable float lines_fontsize_;
+  mutable uchar lines_type_;
+
   const char* expand(const char*, char*, int) const;
   float expandpos(const char*, const char*, const char*, int*) const;
   void minimal_update(int, int);
   void minimal_update(int p);
   void erase_cursor_at(int p);
 
+  bool lines_ok(int wordwrap) const;
+  void build_lines(int wordwrap) const;
+  int find_line(int position) const;
+  int update_lines(int b, int olde, int newe);
+
   void setfont() const;
 
   void shift_position(int p);
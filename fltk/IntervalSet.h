@@ -0,0 +1,71 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#ifndef fltk_IntervalSet_h
+#define fltk_IntervalSet_h
+
+#include "FL_API.h"
+
+namespace fltk {
+
+class FL_API IntervalSet {
+public:
+  typedef void (*Callback)(IntervalSet*, int start, int end, bool added, void*);
+  IntervalSet() : ranges_(0), n_(0), size_(0), count_(0), callback_(0), arg_(0) {}
+  ~IntervalSet();
+  bool contains(int i) const;
+  int add(int start, int end);
+  int remove(int start, int end);
+  int add(int i) {return add(i, i+1);}
+  int remove(int i) {return remove(i, i+1);}
+  void clear();
+  /*! How many numbers are in the set. */
+  int count() const {return count_;}
+  /*! How many separate ranges there are. */
+  int ranges() const {return n_;}
+  /*! First number in range \a n, ranges are in increasing order. */
+  int start(int n) const {return ranges_[2*n];}
+  /*! One more than the last number in range \a n. */
+  int end(int n) const {return ranges_[2*n+1];}
+  int next(int i) const;
+  void callback(Callback c, void* a = 0) {callback_ = c; arg_ = a;}
+private:
+  int* ranges_; // start,end pairs
+  int n_, size_;
+  int count_;
+  Callback callback_;
+  void* arg_;
+  int find(int i) const;
+  void replace(int first, int last, const int* pairs, int n);
+  IntervalSet(const IntervalSet&);
+  IntervalSet& operator=(const IntervalSet&);
+};
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -44,8 +44,9 @@ public:
   const char* name;
   LabelType* next;
   static LabelType* first;
-  LabelType(const char* n) : name(n), next(first) {first = this;}
+  LabelType(const char* n);
   static LabelType* find(const char* name);
+  static LabelType* iterate(int& index);
   virtual ~LabelType(); // virtual to shut up C++ warnings
 };
 
@@ -0,0 +1,73 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#ifndef fltk_LazyGroup_h
+#define fltk_LazyGroup_h
+
+#include "Group.h"
+
+namespace fltk {
+
+class FL_API LazyGroup : public Group {
+public:
+  typedef void (*Builder)(LazyGroup*, void* data);
+
+  LazyGroup(int x, int y, int w, int h, const char* label = 0,
+	    Builder = 0, void* data = 0);
+  ~LazyGroup();
+
+  void builder(Builder b, void* d = 0) {builder_ = b; data_ = d;}
+  Builder builder() const {return builder_;}
+  void* builder_data() const {return data_;}
+
+  bool built() const {return built_;}
+  void build();
+  void unload();
+
+  float unload_delay() const {return unload_delay_;}
+  void unload_delay(float t) {unload_delay_ = t;}
+  bool prefetch() const {return prefetch_;}
+  void prefetch(bool v) {prefetch_ = v;}
+
+  int handle(int);
+  void draw();
+
+private:
+  Builder builder_;
+  void* data_;
+  bool built_;
+  bool prefetch_;
+  float unload_delay_;
+  LazyGroup* next_;	// list of all of them, to find the neighbors
+  static bool prefetch_job(void*);
+  static void unload_cb(void*);
+};
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -35,6 +35,8 @@ public:
   virtual int children(const Menu*, const int* indexes, int level);
   virtual Widget* child(const Menu*, const int* indexes, int level);
   virtual void flags_changed(const Menu*, Widget*);
+  virtual void visible_items(const Menu*, int n);
+  virtual int find_prefix(const Menu*, const char* prefix, int start);
   virtual ~List();
 };
 
@@ -79,6 +81,8 @@ public:
 
   int popup(const Rectangle&, const char* title=0,bool menubar=false);
   int handle_shortcut();
+  int find_prefix(const char* prefix, int start = 0) const;
+  int type_ahead(int current);
   static void default_callback(Widget*, void*);
   void execute(Widget*);
   void global();
@@ -0,0 +1,57 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_MenuBuilder_h
+#define fltk_MenuBuilder_h
+
+#include "Menu.h"
+
+namespace fltk {
+
+class FL_API MenuBuilder {
+  Menu* menu_;
+  Group** table_;	// hash table of the submenus
+  unsigned tablesize_;	// always a power of 2
+  unsigned count_;
+  void index(Group*);
+  void remember(Group*);
+public:
+  MenuBuilder(Menu*, int reserve = 0);
+  ~MenuBuilder();
+  /** The menu items are added to */
+  Menu* menu() const {return menu_;}
+
+  Group* submenu(Group* parent, const char* name, int flags = 0);
+  Widget* add(const char* const* path, int n, unsigned shortcut = 0,
+	      Callback* = 0, void* = 0, int flags = 0);
+  Widget* add(const char* label, unsigned shortcut = 0,
+	      Callback* = 0, void* = 0, int flags = 0);
+  void finish();
+};
+
+}
+#endif
+
+//
+// End of "$Id$".
+//
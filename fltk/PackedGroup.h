@@ -35,12 +35,17 @@
 
 namespace fltk {
 
+struct PackedCache;
+
 class FL_API PackedGroup : public Group {
   int spacing_;
   int margin_left_;
   int margin_right_;
   int margin_top_;
   int margin_bottom_;
+  PackedCache* cache_; // what the last layout() did
+  bool unchanged(int) const;
+  void placed(int);
 public:
   enum { // values for type(int), for back-compatability
     NORMAL	= GROUP_TYPE,
@@ -48,6 +53,7 @@ public:
   };
   void layout();
   PackedGroup(int x, int y, int w, int h, const char *l = 0, bool begin=false);
+  ~PackedGroup();
   int spacing() const {return spacing_;}
   void spacing(int i) {spacing_ = i;}
 
@@ -0,0 +1,56 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_Path_h
+#define fltk_Path_h
+
+#include "FL_API.h"
+
+namespace fltk {
+
+class FL_API Path {
+  void (*build_)(void*);
+  void* data_;
+  int* xy_;		// the points, followed by the loop sizes
+  int n_, loops_, size_;
+  int circle_[5];
+  float angles_[2];
+  float matrix_[6];	// the transform the points were made with
+  int* traps_;		// trapezoids fillpath() made from the points
+  int ntraps_;		// -1 if fillpath() has not made them
+  bool valid_;
+  friend FL_API void fillpath();
+public:
+  Path(void (*build)(void*), void* data = 0);
+  ~Path();
+  void load();
+  void changed() {valid_ = false;}
+};
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
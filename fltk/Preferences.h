@@ -37,6 +37,7 @@ class FL_API Preferences
 public:
 
   enum Root { SYSTEM=0, USER };
+  enum Format { TEXT=0, BINARY };
 
   Preferences( Root root, const char *vendor, const char *application );
   Preferences( const char *path, const char *vendor, const char *application );
@@ -73,6 +74,11 @@ public:
 
   void flush();
 
+  void format( Format );
+  Format format();
+
+  static unsigned long total_mem_used( unsigned long *groups = 0 );
+
   // bool export( const char *filename, Type fileFormat );
   // bool import( const char *filename );
 
@@ -0,0 +1,89 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_PyramidImage_h
+#define fltk_PyramidImage_h
+
+#include "Symbol.h"
+
+namespace fltk {
+
+class FL_API Window;
+struct PyramidTile;
+
+class FL_API TileSource {
+  int w_, h_, tile_size_, levels_;
+  PixelType pixeltype_;
+public:
+  TileSource(int w, int h, int tile_size = 256, PixelType = RGB32);
+  virtual ~TileSource() {}
+  int w() const {return w_;}
+  int h() const {return h_;}
+  int tile_size() const {return tile_size_;}
+  PixelType pixeltype() const {return pixeltype_;}
+  int levels() const {return levels_;}
+  int level_w(int level) const {return int(((unsigned)w_+(1u<<level)-1)>>level);}
+  int level_h(int level) const {return int(((unsigned)h_+(1u<<level)-1)>>level);}
+  int columns(int level) const {return (level_w(level)+tile_size_-1)/tile_size_;}
+  int rows(int level) const {return (level_h(level)+tile_size_-1)/tile_size_;}
+  virtual bool read_tile(int level, int column, int row,
+			 uchar* pixels, int linedelta);
+};
+
+class FL_API PyramidImage : public Symbol {
+  TileSource* source_;
+  PyramidTile** table_;	// hash of all the tiles
+  PyramidTile* first_;	// most recently used
+  PyramidTile* last_;
+  unsigned long cache_size_, mem_used_;
+  unsigned long drawn_;	// counts _draw() calls
+  const Window* window_; // where it was last drawn
+  Rectangle area_;	// transformed rectangle it was last drawn in
+  PyramidTile* find(int level, int column, int row) const;
+  PyramidTile* request(int level, int column, int row, int priority);
+  void touch(PyramidTile*);
+  void unlink(PyramidTile*);
+  void free_tile(PyramidTile*);
+  void check_mem_usage();
+  void draw_tile(const Rectangle&, int level, int column, int row);
+  static void read_tile(void*);
+  static void tile_done(void*);
+  PyramidImage(const PyramidImage&);
+  PyramidImage& operator=(const PyramidImage&);
+public:
+  PyramidImage(TileSource*, const char* name = 0);
+  ~PyramidImage();
+  TileSource* source() const {return source_;}
+  void cache_size(unsigned long bytes);
+  unsigned long cache_size() const {return cache_size_;}
+  unsigned long mem_used() const {return mem_used_;}
+  void _measure(int& w, int& h) const;
+  void _draw(const Rectangle&) const;
+};
+
+}
+#endif
+
+//
+// End of "$Id$"
+//
@@ -0,0 +1,64 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#ifndef fltk_ScrollAnimator_h
+#define fltk_ScrollAnimator_h
+
+#include "FL_API.h"
+
+namespace fltk {
+
+class FL_API ScrollAnimator {
+public:
+  typedef void (*MoveHandler)(double position, void* arg);
+
+  ScrollAnimator(MoveHandler, void* arg = 0);
+  ~ScrollAnimator();
+
+  void scroll(double from, double to);
+  double target(double from) const {return active_ ? target_ : from;}
+  bool active() const {return active_;}
+  void stop();
+
+  static float duration() {return duration_;}
+  static void duration(float t) {duration_ = t;}
+
+private:
+  MoveHandler move_;
+  void* arg_;
+  bool active_;
+  double position_, target_;
+  double time_;		// get_time_secs() at position_
+  static float duration_;
+  static void frame_cb(void*);
+  void step();
+};
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -30,6 +30,7 @@
 #define fltk_Scrollbar_h
 
 #include "Slider.h"
+#include "ScrollAnimator.h"
 
 namespace fltk {
 
@@ -52,6 +53,8 @@ protected:
 
 private:
   int pagesize_;
+  ScrollAnimator wheel_scroll_;
+  static void wheel_cb(double, void*);
   static void timeout_cb(void*);
   void increment_cb();
 
@@ -30,8 +30,11 @@
 
 namespace fltk {
 
+struct ShapeCache;
+
 class FL_API ShapedWindow : public Window {
-    void init() { shape_ = 0; lw = lh = 0; changed = 0; }
+    void init() { shape_ = 0; lw = lh = 0; changed = 0; cache_ = 0; }
+    ShapeCache* cache_;
   public:
     ShapedWindow(int W, int H, const char *l = 0)  : Window(W,H,l) {
       border(false);
@@ -41,6 +44,7 @@ class FL_API ShapedWindow : public Window {
       border(false);
       init();
     }
+    ~ShapedWindow();
     void shape(xbmImage* b) { shape_ = b; changed = 1; }
     void shape(xbmImage& b) { shape_ =&b; changed = 1; }
 
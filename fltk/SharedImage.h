@@ -34,7 +34,9 @@ so the file does not have to exist and you can link the image directly
 into your program.
 * You may set a memory usage limit. If Image::mem_used() goes above
 this limit, it will call destroy() on least-recently-used images until
-it goes below this limit.
+it goes below this limit. The pixels of those images are kept
+compressed, within a smaller limit, so drawing them again does not
+need the file to be read and decoded again.
 * The get() function can determine the type of the file or block of
 data and create the correct subclass.
 
@@ -48,13 +50,14 @@ data and create the correct subclass.
 namespace fltk {
 
 struct FL_IMAGES_API ImageType;
+struct SharedImageJob;
 
 
 class FL_API SharedImage : public Image {
 // fabien : introducing SharedImage handlers and uniform loading api inspired from 1.1.x
 public:
     /*! get an image of this name and dimensions , can be already loaded or not */
-  static SharedImage *get(const char *n); // future impl. should care about W,H dims
+  static SharedImage *get(const char *n, int w = 0, int h = 0);
 
     /*! a SharedImageHandler accepts handling a filename 
 	by analizing its extension and/or eventually its header,
@@ -70,11 +73,15 @@ public:
   static void add_handler(Handler f);
     /*! removes a concrete handler */
   static void remove_handler(Handler f);
+    /*! adds a handler that is loaded from a plugin the first time a file starting with \a magic is seen */
+  static void add_plugin(const char* magic, int magic_len,
+			 const char* module, const char* symbol);
 
 private:
   static Handler *handlers_;		// Additional format handlers
   static int	num_handlers_;		// Number of format handlers
   static int	alloc_handlers_;	// Allocated format handlers
+  static SharedImage* plugin_image(const char*, uchar*, int);
 
 protected:
   static const char* shared_image_root;
@@ -82,19 +89,43 @@ protected:
   static int image_used;
   static unsigned mem_usage_limit;
 
-  SharedImage* l1;    // Left leaf in the binary tree
-  SharedImage* l2;    // Right leaf in the binary tree
+  SharedImage* hash_next; // Next image in the same hash table bucket
+  SharedImage* lru_prev; // More recently used image
+  SharedImage* lru_next; // Less recently used image
   const char* 	   name;  // Used to indentify the image, and as filename
   const uchar* datas; // If non zero, pointers on inlined compressed datas
   unsigned int     used;  // Last time used, for cache handling purpose
   int              refcount; // Number of time this image has been get
+  int              pinned; // Number of pin() not matched by unpin()
+  int              want_w, want_h; // Size given to get(), 0 for full size
+  bool             in_lru; // It is in the list check_mem_usage() looks at
+  SharedImageJob*  job;    // Being fetched by another thread
+  const uchar*     mapped; // File mapped by get(), for map_file()
+  unsigned         mapped_size;
+  uchar*           packed; // Compressed pixels kept by check_mem_usage()
+  unsigned         packed_size;
+  SharedImage*     packed_prev; // Compressed earlier
+  SharedImage*     packed_next;
+
+  static bool async_fetch_;
+  static int requested_w_, requested_h_;
+  bool in_job() const;
+  /*! Return false if fetch() cannot be done by another thread */
+  virtual bool fetch_in_thread() const {return true;}
+  /*! Return true if fetch() reads the file with map_file() */
+  virtual bool reads_mapped_file() const {return false;}
+  const uchar* map_file(unsigned& size);
 
   SharedImage() { };  // Constructor is protected on purpose,
                           // use the get function rather
-  //~SharedImage();
+  ~SharedImage();
 
-  void find_less_used();
+  void touch();
+  void lru_unlink();
   static void check_mem_usage();
+  void pack();
+  bool unpack();
+  void discard_packed();
 
   /*! Return the filename obtained from the concatenation
     of the image root directory and this image name
@@ -104,19 +135,26 @@ protected:
 
   virtual bool fetch() = 0; // force fetch() to be defined by subclasses
 
-  static void insert(SharedImage*& p, SharedImage* image);
-  static SharedImage* find(SharedImage* image, const char* name);
-  void remove_from_tree(SharedImage*& p, SharedImage* image);
+  static void insert(SharedImage* image);
+  static SharedImage* find(const char* name, int w = 0, int h = 0);
+  void remove_from_table();
 
 public:
 
+  /*! The most recently used image, follow lru_next for the others */
   static SharedImage  *first_image;
 
   /*! Return an SharedImage, using the create function if an image with
     the given name doesn't already exist. Use datas, or read from the
-    file with filename name if datas==0. */
+    file with filename name if datas==0. See get(name,w,h) for what
+    w and h do. */
   static SharedImage* get(SharedImage* (*create)(),
-			  const char* name, const uchar* datas=0);
+			  const char* name, const uchar* datas=0,
+			  int w=0, int h=0);
+
+  /*! The w and h given to the get(name,w,h) that is calling a Handler */
+  static int requested_w() {return requested_w_;}
+  static int requested_h() {return requested_h_;}
 
   /*! Reload the image, useful if it has changed on disk, or if the datas
     / in memory have changed (you can also give a new pointer on datas) */
@@ -139,10 +177,59 @@ public:
   /*! Expand a name relative to root to see what file it will read */
   static const char* get_filename(const char*);
 
+  /*! Read-only access to a whole file without copying it */
+  static const uchar* map_file(const char* filename, unsigned& size);
+  static void unmap_file(const uchar*, unsigned size);
+
   /*! Set the size of the cache (0 = unlimited is the default) */
   static void set_cache_size(unsigned l);
+  /*! Set the size of the compressed copies of images removed from it */
+  static void set_compressed_cache_size(unsigned l);
+  static unsigned long compressed_mem_used();
+
+  /*! Keep the image in memory even if the cache is over its size */
+  void pin() {if (!pinned++) lru_unlink();}
+  void unpin() {if (pinned && !--pinned) touch();}
+  static bool pin(const char* name);
+  static bool unpin(const char* name);
+
+  /*! Counts of what the cache has done, see SharedImage::cache_stats() */
+  struct CacheStats {
+    unsigned long hits;		// get() found the image
+    unsigned long misses;	// get() had to make the image
+    unsigned long evictions;	// images destroyed by the size limit
+    unsigned long evicted_bytes; // mem_used() of those images
+    unsigned long compressed;	// of those, kept compressed
+    unsigned long uncompressed;	// drawn again from the compressed copy
+  };
+  static const CacheStats& cache_stats();
+
+  /*! Make draw() fetch images in another thread (default is false) */
+  static void async_fetch(bool v) {async_fetch_ = v;}
+  static bool async_fetch() {return async_fetch_;}
+  typedef void (*FetchCallback)(SharedImage*, void*);
+  bool fetch_in_background(FetchCallback, void* = 0);
+  void cancel_fetch();
+  static void job_done(void*); // fltk::post() by the decoding thread
+  static void job_progress(void*);
 
   void _draw(const Rectangle&) const;
+  void _measure(int& w, int& h) const;
+
+  // These are the Image functions that fetch() calls. They store the
+  // pixels elsewhere if fetch() is being run by another thread:
+  void setpixeltype(PixelType);
+  void setsize(int w, int h);
+  void setpixels(const uchar* d, const Rectangle&, int linedelta);
+  void setpixels(const uchar* d, const Rectangle& r) {setpixels(d,r,depth()*r.w());}
+  void setpixels(const uchar* d, int y);
+  uchar* linebuffer(int y);
+  PixelType pixeltype() const;
+  int depth() const {return fltk::depth(pixeltype());}
+  int w() const;
+  int width() const {return w();}
+  int h() const;
+  int height() const {return h();}
 
 };
 
@@ -169,15 +256,33 @@ FL_IMAGES_API ImageType* guess_image(const char* name, const uchar* datas=0);
 // bmp and gif classes are build in libfltk2 so they are FL_API
 //
 
+struct GifAnimation;
+
 class FL_API gifImage : public SharedImage {
-  gifImage() { }
+  gifImage() : anim(0), animate_(true) { }
   static SharedImage* create() { return new gifImage; }
+  GifAnimation* anim; // frames of an animated gif
+  bool animate_;
+  void stop_animation();
 public:
   static bool test(const uchar* datas, unsigned size=0);
   static SharedImage* get(const char* name, const uchar* datas = 0) {
     return SharedImage::get(create, name, datas);
   }
   bool fetch();
+  bool reads_mapped_file() const {return true;}
+  void _draw(const Rectangle&) const;
+  ~gifImage();
+
+  // Animated gif files:
+  int frames() const;
+  int frame() const;
+  void frame(int n);
+  float delay(int n) const;
+  /*! Set whether draw() starts the animation (default is true) */
+  void animate(bool v) {animate_ = v; if (!v) stop_animation();}
+  bool animate() const {return animate_;}
+  static void animation_timeout(void*); // add_timeout() for all gifImages
 };
 
 class FL_API bmpImage : public SharedImage {
@@ -200,6 +305,7 @@ public:
     return SharedImage::get(create, name, datas);
   }
   bool fetch();
+  bool fetch_in_thread() const {return false;} // xpmImage draws into Image
 };
 
 // 
@@ -214,7 +320,12 @@ public:
   static SharedImage* get(const char* name, const uchar* datas = 0) {
     return SharedImage::get(create, name, datas);
   }
+  static SharedImage* get(const char* name, const uchar* datas,
+			  int w, int h) {
+    return SharedImage::get(create, name, datas, w, h);
+  }
   bool fetch();
+  bool reads_mapped_file() const {return true;}
 };
 
 class FL_IMAGES_API pngImage : public SharedImage {
@@ -226,11 +337,17 @@ public:
   static SharedImage* get(const char* name, const uchar* datas = 0) {
     return SharedImage::get(create, name, datas);
   }
+  static SharedImage* get(const char* name, const uchar* datas,
+			  int w, int h) {
+    return SharedImage::get(create, name, datas, w, h);
+  }
   bool fetch();
+  bool reads_mapped_file() const {return true;}
 };
 
   extern FL_IMAGES_API void register_images(); // return always true only for automatic lib init purpose see images_core.cxx trick
   extern FL_IMAGES_API void unregister_images();
+  extern FL_API void register_image_plugins();
 }
 
 #endif
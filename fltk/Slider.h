@@ -36,10 +36,17 @@
 
 namespace fltk {
 
+struct SliderLayer;
+
 class FL_API Slider : public Valuator {
 
   unsigned short slider_size_;
   unsigned short tick_size_;
+  SliderLayer* layer_; // image of everything but the moving part
+  bool slider_area(Rectangle&, Rectangle* ticks, bool slot) const;
+  void draw_track(const Rectangle&, bool slot);
+  void knob_rect(const Rectangle&, Rectangle&, int& glyph);
+  void draw_knob(const Rectangle&, Flags);
 
 public:
 
@@ -65,6 +72,7 @@ public:
   int handle(int);
 
   Slider(int x,int y,int w,int h, const char *l = 0);
+  ~Slider();
   static NamedStyle* default_style;
 
   unsigned short slider_size() const {return slider_size_;}
@@ -86,6 +94,7 @@ public:
   int handle(int event, const Rectangle&);
   void draw_ticks(const Rectangle&, int min_spacing);
   bool draw(const Rectangle&, Flags flags, bool slot);
+  void draw_layered(const Rectangle&, Flags flags, Flags f2, bool slot, bool overlay);
 };
 
 }
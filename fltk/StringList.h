@@ -36,6 +36,7 @@ public:
   // virtual functions to return hierarchy of strings:
   virtual int children(const Menu*, const int* indexes, int level) = 0;
   virtual const char* label(const Menu*, const int* indexes, int level)=0;
+  virtual int find_prefix(const Menu*, const char* prefix, int start);
   // label() can mess with this item to change flags, font, etc:
   Widget* generated_item() {return generated_item_;}
   StringHierarchy() {generated_item_ = 0;}
@@ -55,20 +56,42 @@ public:
 class FL_API StringArray : public StringList {
   const char* const * array;
   int children_;
+  int* sorted_; // indexes in label order, made by find_prefix()
 public:
   // overrides of StringList virtual functions:
   virtual int children(const Menu*);
   virtual const char* label(const Menu*, int index);
+  virtual int find_prefix(const Menu*, const char* prefix, int start);
   // Constructors to use a constant array of strings:
-  StringArray(const char*const* a, int n) : array(a), children_(n) {}
-  StringArray(const char*const* a) {set(a);}
-  StringArray(const char* s) {set(s);}
-  StringArray() {children_ = 0;}
+  StringArray(const char*const* a, int n) : array(a), children_(n), sorted_(0) {}
+  StringArray(const char*const* a) : sorted_(0) {set(a);}
+  StringArray(const char* s) : sorted_(0) {set(s);}
+  StringArray() : array(0), children_(0), sorted_(0) {}
+  ~StringArray() {delete[] sorted_;}
   // change the array:
-  void set(const char*const* a, int n) {array=a; children_ = n;}
+  void set(const char*const* a, int n) {
+    array=a; children_ = n; delete[] sorted_; sorted_ = 0;}
   void set(const char*const* a);
   void set(const char* s); // nul-seperated list
 };
 
+class FL_API MappedStringList : public StringList {
+  const unsigned char* data_;
+  unsigned size_;
+  unsigned* lines_; // where each line starts, and one more at the end
+  int children_;
+  char* buffer_; // copy of the last label()
+  unsigned buffersize_;
+public:
+  // overrides of StringList virtual functions:
+  virtual int children(const Menu*);
+  virtual const char* label(const Menu*, int index);
+  MappedStringList() : data_(0), size_(0), lines_(0), children_(0),
+    buffer_(0), buffersize_(0) {}
+  ~MappedStringList() {clear();}
+  bool load(const char* filename);
+  void clear();
+};
+
 }
 #endif
@@ -121,11 +121,48 @@ class FL_API Style {
   unsigned char	scrollbar_align_;
   unsigned char	scrollbar_width_;
   bool		dynamic_;
+  bool		uncached_;	// a copy, always search the parents
+  unsigned	refcount_;	// widgets sharing this dynamic() style
+  unsigned	hash_;
+  Style*	next_shared_;	// hash table of dynamic() styles
   // global settings:
   static bool	hide_underscore_;
   static bool   draw_boxes_inactive_;
   static int	wheel_scroll_lines_;
 
+  // Values found by searching the parents, see resolved():
+  struct Resolved {
+    unsigned	generation;
+    Box*	box;
+    Box*	buttonbox;
+    Box*	focusbox;
+    Symbol*	glyph;
+    Font*	labelfont;
+    Font*	textfont;
+    LabelType*	labeltype;
+    Color	color;
+    Color	textcolor;
+    Color	selection_color;
+    Color	selection_textcolor;
+    Color	buttoncolor;
+    Color	labelcolor;
+    Color	highlight_color;
+    Color	highlight_textcolor;
+    float	labelsize;
+    float	textsize;
+    float	leading;
+    unsigned char scrollbar_align;
+    unsigned char scrollbar_width;
+  };
+  mutable Resolved* resolved_;
+  static unsigned generation_;
+  const Resolved& resolved() const {
+    if (resolved_ && resolved_->generation == generation_) return *resolved_;
+    return resolve();
+  }
+  const Resolved& resolve() const;
+  static void changed() {generation_++;}
+
   // Get functions, which search parents if value is zero:
   Box*		box()		const;
   Box*		buttonbox()	const;
@@ -154,34 +191,38 @@ class FL_API Style {
   int		wheel_scroll_lines() const {return wheel_scroll_lines_;}
 
   // Set functions:
-  void box		(Box* v)	{box_ = v;		}
-  void buttonbox	(Box* v)	{buttonbox_ = v;	}
-  void focusbox		(Box* v)	{focusbox_ = v;		}
-  void glyph		(Symbol* v)	{glyph_ = v; 		}
-  void labelfont	(Font* v)	{labelfont_ = v;	}
-  void textfont		(Font* v)	{textfont_ = v;		}
-  void labeltype	(LabelType* v)	{labeltype_ = v; 	}
-  void color		(Color v)	{color_ = v; 		}
-  void alt_color	(Color v)	{alt_color_ = v;	}
-  void textcolor	(Color v)	{textcolor_ = v; 	}
-  void selection_color	(Color v)	{selection_color_ = v;	}
-  void selection_textcolor(Color v)	{selection_textcolor_ = v;}
-  void buttoncolor	(Color v)	{buttoncolor_ = v; 	}
-  void labelcolor	(Color v)	{labelcolor_ = v; 	}
-  void highlight_color	(Color v)	{highlight_color_ = v; 	}
-  void highlight_textcolor(Color v)	{highlight_textcolor_ = v;}
-  void labelsize	(float v)	{labelsize_ = v;	}
-  void textsize		(float v)	{textsize_ = v;		}
-  void leading		(float v)	{leading_ = v;		}
-  void scrollbar_align	(unsigned char v) {scrollbar_align_ = v;}	
-  void scrollbar_width	(unsigned char v) {scrollbar_width_ = v;}	
+  void box		(Box* v)	{box_ = v; changed();}
+  void buttonbox	(Box* v)	{buttonbox_ = v; changed();}
+  void focusbox		(Box* v)	{focusbox_ = v; changed();}
+  void glyph		(Symbol* v)	{glyph_ = v; changed();}
+  void labelfont	(Font* v)	{labelfont_ = v; changed();}
+  void textfont		(Font* v)	{textfont_ = v; changed();}
+  void labeltype	(LabelType* v)	{labeltype_ = v; changed();}
+  void color		(Color v)	{color_ = v; changed();}
+  void alt_color	(Color v)	{alt_color_ = v; changed();}
+  void textcolor	(Color v)	{textcolor_ = v; changed();}
+  void selection_color	(Color v)	{selection_color_ = v; changed();}
+  void selection_textcolor(Color v)	{selection_textcolor_ = v; changed();}
+  void buttoncolor	(Color v)	{buttoncolor_ = v; changed();}
+  void labelcolor	(Color v)	{labelcolor_ = v; changed();}
+  void highlight_color	(Color v)	{highlight_color_ = v; changed();}
+  void highlight_textcolor(Color v)	{highlight_textcolor_ = v; changed();}
+  void labelsize	(float v)	{labelsize_ = v; changed();}
+  void textsize		(float v)	{textsize_ = v; changed();}
+  void leading		(float v)	{leading_ = v; changed();}
+  void scrollbar_align	(unsigned char v) {scrollbar_align_ = v; changed();}	
+  void scrollbar_width	(unsigned char v) {scrollbar_width_ = v; changed();}	
 
   void hide_underscore	(bool v)	{hide_underscore_ = v;	}
   void draw_boxes_inactive(bool v)	{draw_boxes_inactive_ = v;}
   void wheel_scroll_lines(int v)	{wheel_scroll_lines_ = v;}
 
   Style();
+  Style(const Style&);
+  Style& operator=(const Style&);
+  ~Style();
   bool dynamic() const {return dynamic_;}
+  static void release(const Style*);
 
   static Style* find(const char* name);
 };
@@ -193,6 +234,7 @@ struct FL_API NamedStyle : public Style {
   static NamedStyle* first;
   NamedStyle* next;
   NamedStyle(const char* name, void (*revert)(Style*), NamedStyle** backptr);
+  static NamedStyle* iterate(int& index);
 };
 
 extern "C" {typedef bool (*Theme)();}
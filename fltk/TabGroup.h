@@ -38,6 +38,7 @@
 namespace fltk {
 
 class TabGroup;
+struct TabCache;
 
 
 enum {TAB_LEFT, TAB_RIGHT, TAB_SELECTED};
@@ -100,7 +101,7 @@ public:
   int handle(int);
 
   TabGroup(int,int,int,int,const char * = 0, bool begin=false);
-  ~TabGroup() {delete pager_;}
+  ~TabGroup();
   static NamedStyle* default_style;
 
   int value() const;
@@ -121,6 +122,7 @@ public:
 
   int tab_height();
   int tab_positions(int*, int*);
+  int tab_positions(int*& p, int*& w, bool check_labels);
 
   void draw_tab(int x1, int x2, int W, int H, Widget* o, int sel=0);
   void draw_tab_background();
@@ -133,6 +135,7 @@ private:
   bool _drawOutline;
   TabGroupPager* pager_;
   static TabGroupPager* default_pager_;
+  TabCache* tabs_; // measured labels and positions
 };
 
 }
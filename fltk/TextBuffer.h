@@ -34,6 +34,13 @@
 
 namespace fltk {
 
+struct TextLineIndex;
+struct TextPiece;
+struct TextBlock;
+struct TextRegex;
+struct TextUndo;
+struct TextLoader;
+
 /* Maximum length in characters of a tab or control character expansion
    of a single buffer character */
 #define TEXT_MAX_EXP_CHAR_LEN 20
@@ -79,13 +86,28 @@ typedef void (*Text_Modify_Cb)(	int pos, int nInserted, int nDeleted,
 
 typedef void (*Text_Predelete_Cb)(int pos, int nDeleted, void* cbArg);
 
+class FL_API TextBuffer;
+typedef void (*Text_Load_Cb)(TextBuffer* buffer, int loaded, int total,
+			     int status, void* cbArg);
+
 /** TextBuffer */
 class FL_API TextBuffer {
 public:
   TextBuffer(int requestedsize = 0);
   ~TextBuffer();
 
+  enum Storage { GAP_BUFFER, PIECE_TABLE };
+  void storage(Storage);
+  Storage storage() const { return piecetable_ ? PIECE_TABLE : GAP_BUFFER; }
+
+  TextPiece* snapshot();
+  void restore(TextPiece* snapshot);
+  static void release(TextPiece* snapshot);
+
   int length() const { return length_; }
+  unsigned long mem_used() const;
+  /*! Bytes allocated after the text for inserting more, zero if storage() is PIECE_TABLE. */
+  int gap_size() const { return gapend_ - gapstart_; }
 
   const char *text();
   void text(const char* text);
@@ -101,6 +123,13 @@ public:
   void copy(TextBuffer *from_buf, int from_start, int from_end, int to_pos);
 
   int undo(int *cp = 0);
+  int redo(int *cp = 0);
+  bool undoable() const;
+  bool redoable() const;
+  void clear_undo();
+  void undo_limit(int bytes);
+  /** Return how many bytes the undo log may use */
+  int undo_limit() const { return undolimit_; }
   void canUndo(char flag = 1);
 
   int insertfile(const char *file, int pos, int buflen = 128*1024);
@@ -108,6 +137,12 @@ public:
         { return insertfile(file, length(), buflen); }
   int loadfile(const char *file, int buflen = 128*1024)
         { select(0, length()); remove_selection(); return appendfile(file, buflen); }
+  int mapfile(const char *file);
+  int insertfile_async(const char *file, int pos, Text_Load_Cb cb = 0,
+                       void* cbArg = 0, int buflen = 128*1024);
+  void cancel_load();
+  /*! True while insertfile_async() is reading a file into this buffer. */
+  bool loading() const { return loader_ != 0; }
   int outputfile(const char *file, int start, int end, int buflen = 128*1024);
   int savefile(const char *file, int buflen = 128*1024)
         { return outputfile(file, 0, length(), buflen); }
@@ -170,6 +205,10 @@ public:
 
   void call_predelete_callbacks() { call_predelete_callbacks(0, 0); }
 
+  void begin_batch();
+  void end_batch();
+  bool batching() const { return batchdepth_ > 0; }
+
   char* line_text(int pos);
   int line_start(int pos);
   int line_end(int pos);
@@ -188,6 +227,8 @@ public:
   int count_lines(int startPos, int endPos);
   int skip_lines(int startPos, int nLines);
   int rewind_lines(int startPos, int nLines);
+  int line_to_position(int line);
+  int position_to_line(int pos);
   
   bool findchar_forward(int startPos, char searchChar, int* foundPos);
   bool findchar_backward(int startPos, char searchChar, int* foundPos);
@@ -201,6 +242,14 @@ public:
   bool search_backward(int startPos, const char* searchString, int* foundPos,
                        bool matchCase = false);
 
+  enum { SEARCH_MATCH_CASE = 1, SEARCH_REGEX = 2 };
+  bool search_forward(int startPos, const char* pattern, int* foundPos,
+                      int* foundEnd, int flags);
+  bool search_backward(int startPos, const char* pattern, int* foundPos,
+                       int* foundEnd, int flags);
+  int search_all(const char* pattern, int** ranges, int flags = 0,
+                 int start = 0, int end = -1);
+
   char null_substitution_character() { return nullsubschar_; }
   TextSelection* primary_selection() { return &primary_; }
   TextSelection* secondary_selection() { return &secondary_; }
@@ -227,6 +276,17 @@ protected:
   void redisplay_selection(TextSelection* oldSelection,
                            TextSelection* newSelection);
 
+  const char* run_(int pos, int* start, int* end) const;
+  void copy_out_(char* dest, int start, int end) const;
+  bool text_match_(int pos, const char* s, int n, bool matchcase) const;
+  int text_find_(int start, int end, const char* s, int n, bool matchcase) const;
+  int text_rfind_(int start, int end, const char* s, int n, bool matchcase) const;
+  void regex_add_(TextRegex*, int list, int pc, int start, int pos) const;
+  int regex_search_(TextRegex*, int start, int end, bool anchored,
+                    int* matchend) const;
+  char* piece_reserve_(int n);
+  void piece_insert_(int pos, const char* text, int n);
+
   void move_gap(int pos);
   void reallocate_with_gap(int newGapStart, int newGapLen);
   char *selection_text_(TextSelection *sel);
@@ -238,6 +298,23 @@ protected:
                                         int* selEnd);
 
   void update_selections(int pos, int nDeleted, int nInserted);
+  static void insert_piece_(void* loader);
+  void batch_change_(int pos, int nDeleted, int nInserted,
+                     const char* deletedText);
+  void batch_deleted_(int at, int used, int start, int end, int pos,
+                      int nDeleted, int nInserted, const char* deletedText);
+
+  int count_newlines_(int start, int end) const;
+  int find_newline_(int start, int n) const;
+  void lineindex_build_();
+  void lineindex_free_();
+  void lineindex_fill_(int k, int start, int length);
+  void lineindex_inserted_(int pos, int n);
+  void lineindex_removed_(int start, int end);
+  TextUndo* undo_log_();
+  void undo_deleted_(int start, int end);
+  void undo_inserted_(int pos, int n);
+  int undo_apply_(bool redo, int *cursorPos);
 
   TextSelection primary_;		/* highlighted areas */
   TextSelection secondary_;
@@ -249,6 +326,18 @@ protected:
   char *buf_;     /*!< allocated memory where the text is stored */
   int gapstart_;  /*!< points to the first character of the gap */
   int gapend_;    /*!< points to the first char after the gap */
+  TextLineIndex* lineindex_; /*!< where lines start, built when needed */
+  bool piecetable_;	/*!< text is in pieces_ rather than buf_ */
+  TextPiece* pieces_;	/*!< tree of pieces for PIECE_TABLE storage */
+  TextBlock* addblock_;	/*!< where inserted text is put for PIECE_TABLE */
+
+  int batchdepth_;	/*!< number of begin_batch() without end_batch() */
+  bool batchchanged_;	/*!< text was changed during the batch */
+  int batchstart_, batcholdend_, batchnewend_; /*!< changed range */
+  bool batchrestyled_;	/*!< restyle callbacks happened in the batch */
+  int batchrestylestart_, batchrestyleend_;
+  char* batchtext_;	/*!< text that used to be in the changed range */
+  int batchtextsize_;
   
   int tabdist_;		/*!< equiv. number of characters in a tab */
   bool usetabs_;	/*!< True if buffer routines are allowed to use
@@ -273,6 +362,9 @@ protected:
 
   char mCanUndo;		  /*!< if this buffer is used for attributes, it must
 				                   not do any undo calls */
+  TextUndo* undo_;	/*!< changes that can be undone and redone */
+  int undolimit_;	/*!< bytes the undo log may use */
+  TextLoader* loader_;	/*!< insertfile_async() that is not done yet */
 };
 
 } /* namespace fltk */
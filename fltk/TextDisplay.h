@@ -104,6 +104,15 @@ public:
   /** Overstrike text from current cursor position */
   void overstrike(const char *text);
 
+  /** Turn on log mode, keeping at most maxlines, zero turns it off */
+  void log_mode(int maxlines);
+  /** Return the maxlines set by log_mode(), zero if it is off */
+  int log_mode() const { return log_maxlines_; }
+  /** Add text to the end, in log mode this waits for the next check */
+  void log_append(const char *text);
+  /** Append all the text given to log_append() now */
+  void log_flush();
+
   /** Set new cursor position */
   void insert_position(int newPos);
   /** Return current cursor position */
@@ -234,15 +243,44 @@ protected:
 			  int linesInserted, int linesDeleted, bool *scrolled);
 
   void calc_last_char();
+  void resync_all(int pos, int nInserted, int nDeleted);
 
   bool position_to_line(int pos, int* lineNum);
   int string_width(const char* string, int length, int style);
 
+  struct LineOffsets {
+    int start;                /* linestarts_ value measured, -2 if none */
+    int length;               /* vline_length() measured */
+    int count;                /* number of characters */
+    int size;                 /* allocated size of index and x */
+    int *index;               /* index of each character in the line */
+    int *x;                   /* and its x position from the start */
+  };
+  const LineOffsets* line_offsets(int visLineNum);
+  void clear_line_offsets(int startpos, int endpos);
+
+  void wrap_index_reset();
+  void wrap_index_clear();
+  void wrap_index_changed(int pos, int nInserted, int nDeleted,
+			  const char* deletedText);
+  int wrap_estimate(int line);
+  int wrap_count(int line);
+  int wrap_measure(int line);
+  void wrap_tree_build();
+  void wrap_tree_add(int line, int delta);
+  int wrap_rows_before(int line);
+  int wrap_find_row(int row, int* rowsBefore);
+  int wrap_top_line();
+  static bool wrap_idle_job(void* v);
+
   static void buffer_predelete_cb(int pos, int nDeleted, void* cbArg);
   static void buffer_modified_cb(int pos, int nInserted, int nDeleted,
 				 int nRestyled, const char* deletedText,
 				 void* cbArg);
 
+  static void log_flush_cb(void* v);
+  static void draw_scrolled_cb(void* v, const Rectangle& r);
+
   static void h_scrollbar_cb(Scrollbar* w, TextDisplay* d);
   static void v_scrollbar_cb( Scrollbar* w, TextDisplay* d);
   void update_v_scrollbar();
@@ -344,6 +382,25 @@ protected:
 
   Rectangle text_area;
 
+  int log_maxlines_;          /* Line limit for log_mode(), 0 if off */
+  char *log_text_;            /* Text waiting for log_flush() */
+  int log_length_, log_size_;
+  int scrolldy_;              /* Pixels to scroll by in the next draw() */
+
+  LineOffsets *lineoffsets_;  /* Cached x of characters of visible lines */
+  int nlineoffsets_;
+  Font *offsetsfont_;         /* textfont() and textsize() they are for */
+  float offsetssize_;
+
+  int *wraprows_;             /* Rows each line wraps into in continuous
+				 wrap mode, or -1-estimate if not measured */
+  int *wraptree_;             /* Fenwick tree summing wraprows_ */
+  int wrapnlines_, wrapsize_;
+  int wrapunknown_;           /* Number of lines not measured yet */
+  int wrapnext_;              /* Where wrap_idle_job() measures next */
+  float wrapchars_;           /* Estimated characters per row */
+  bool wrapidle_;             /* wrap_idle_job() is added */
+
   int dragpos_, dragtype_, dragging_;
   int linenumleft_, linenumwidth_; /* Line number margin and width */
 };
@@ -38,6 +38,8 @@ namespace fltk {
 // key will match in any state
 #define TEXT_EDITOR_ANY_STATE  (-1L)
 
+struct KeyBindingTable;
+
 /** TextEditor */
 class FL_API TextEditor : public TextDisplay {
 public:
@@ -100,6 +102,7 @@ public:
   static int kf_paste(int c, TextEditor* e);
   static int kf_select_all(int c, TextEditor* e);
   static int kf_undo(int c, TextEditor* e);
+  static int kf_redo(int c, TextEditor* e);
 
 protected:
   int handle_key();
@@ -109,6 +112,11 @@ protected:
   Key_Binding* key_bindings;
   static Key_Binding* global_key_bindings;
   Key_Func default_key_function_;
+
+private:
+  KeyBindingTable* key_table_; // hash of key_bindings
+  static KeyBindingTable* global_key_table_;
+  void key_bindings_changed(Key_Binding** list);
 };
 
 } /* namespace fltk */
@@ -0,0 +1,115 @@
+//
+// "$Id$"
+//
+// Header file for TextHighlighter class.
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#ifndef TEXT_HIGHLIGHTER_H
+#define TEXT_HIGHLIGHTER_H
+
+#include "TextDisplay.h"
+
+namespace fltk {
+
+struct TextHighlightJob;
+
+/** TextHighlighter */
+class FL_API TextHighlighter {
+public:
+  /**
+   * Function that styles one line. \a text is the \a n bytes of the
+   * line, including the newline at the end if there is one, and it
+   * must put a style letter for each byte into \a style. \a state is
+   * what it returned for the end of the line before (zero for the
+   * first line), and it returns the state at the end of this line.
+   * It may be called by another thread, so it must only use its
+   * arguments.
+   */
+  typedef int (*Lexer)(const char* text, int n, char* style, int state, void* arg);
+
+  TextHighlighter(Lexer lexer, void* arg = 0);
+  ~TextHighlighter();
+
+  void attach(TextDisplay* display, TextDisplay::StyleTableEntry* styleTable,
+              int nStyles);
+  void detach();
+  TextDisplay* display() const { return display_; }
+  TextBuffer* stylebuffer() const { return stylebuffer_; }
+
+  /** Set how many lines are restyled at once after a change */
+  void sync_lines(int n) { synclines_ = n; }
+  /** Return how many lines are restyled at once after a change */
+  int sync_lines() const { return synclines_; }
+  /** Set whether the rest is done by another thread or in idle time */
+  void threaded(bool t) { threaded_ = t; }
+  /** Return whether the rest is done by another thread */
+  bool threaded() const { return threaded_; }
+
+  void restyle(int startPos = 0, int endPos = -1);
+  void update();
+  /** Return true if some of the text has not been styled yet */
+  bool busy() const { return ndirty_ != 0; }
+
+protected:
+  static void modified_cb(int pos, int nInserted, int nDeleted,
+                          int nRestyled, const char* deletedText, void* arg);
+  static void idle_cb(void* arg);
+  static void job_done_cb(void* arg);
+
+  void modified(int pos, int nInserted, int nDeleted, const char* deletedText);
+  void mark_dirty(int first, int last);
+  void lines_changed(int line, int nDeleted, int nInserted);
+  int process(int maxlines, bool select);
+  int apply(int line, int nlines, const char* style, const int* states,
+            bool select);
+  void schedule();
+  void start_job();
+
+  Lexer lexer_;
+  void* arg_;
+  TextDisplay* display_;
+  TextBuffer* buffer_;
+  TextBuffer* stylebuffer_;
+
+  int* states_;     /* lexer state at the start of each line */
+  int nlines_;
+  int statessize_;
+  int* dirty_;      /* sorted first, last pairs of lines to restyle */
+  int ndirty_;
+  int dirtysize_;
+
+  int synclines_;
+  bool threaded_;
+  bool idle_;       /* idle_cb is added */
+  TextHighlightJob* job_; /* sent to the worker thread */
+  int edits_;       /* counts changes, so old jobs are ignored */
+};
+
+} /* namespace fltk */
+
+#endif
+
+//
+// End of "$Id$".
+//
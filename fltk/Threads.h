@@ -73,6 +73,28 @@ public:
   void wait() {pthread_cond_wait(&cond, &mutex);}
 };
 
+/**
+  "Readers/writer lock". Any number of threads can hold read_lock() at
+  the same time, but only one can hold lock(), and only when nobody
+  has a read_lock(). Use this to protect data that is read much more
+  often than it is changed. <i>Neither lock is recursive</i>, and a
+  thread holding read_lock() will deadlock if it calls lock().
+*/
+class RWMutex {
+  pthread_rwlock_t rwlock;
+  RWMutex(const RWMutex&);
+  RWMutex& operator=(const RWMutex&);
+public:
+  RWMutex() {pthread_rwlock_init(&rwlock, 0);}
+  void lock() {pthread_rwlock_wrlock(&rwlock);}
+  void unlock() {pthread_rwlock_unlock(&rwlock);}
+  bool trylock() {return pthread_rwlock_trywrlock(&rwlock) == 0;}
+  void read_lock() {pthread_rwlock_rdlock(&rwlock);}
+  void read_unlock() {pthread_rwlock_unlock(&rwlock);}
+  bool read_trylock() {return pthread_rwlock_tryrdlock(&rwlock) == 0;}
+  ~RWMutex() {pthread_rwlock_destroy(&rwlock);}
+};
+
 // Linux supports recursive locks, use them directly, with some cheating:
 #if defined(PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP) || defined(PTHREAD_MUTEX_RECURSIVE)
 
@@ -171,6 +193,40 @@ public:
 
 typedef Mutex RecursiveMutex;
 
+// Slim reader/writer locks need Vista, so this uses a critical section
+// that writers hold and readers only hold while they count themselves:
+class FL_API RWMutex {
+  CRITICAL_SECTION cs;
+  volatile LONG readers;
+  RWMutex(const RWMutex&);
+  RWMutex& operator=(const RWMutex&);
+public:
+  RWMutex() : readers(0) {InitializeCriticalSection(&cs);}
+  void lock() {
+    while (!TryEnterCriticalSection(&cs)) SwitchToThread();
+    while (readers) SwitchToThread();
+  }
+  void unlock() {LeaveCriticalSection(&cs);}
+  bool trylock() {
+    if (!TryEnterCriticalSection(&cs)) return false;
+    if (readers) {LeaveCriticalSection(&cs); return false;}
+    return true;
+  }
+  void read_lock() {
+    while (!TryEnterCriticalSection(&cs)) SwitchToThread();
+    InterlockedIncrement(&readers);
+    LeaveCriticalSection(&cs);
+  }
+  void read_unlock() {InterlockedDecrement(&readers);}
+  bool read_trylock() {
+    if (!TryEnterCriticalSection(&cs)) return false;
+    InterlockedIncrement(&readers);
+    LeaveCriticalSection(&cs);
+    return true;
+  }
+  ~RWMutex() {DeleteCriticalSection(&cs);}
+};
+
 #endif
 
 /**
@@ -199,6 +255,64 @@ class FL_API Guard {
   ~Guard() {lock.unlock();}
 };
 
+/**
+  Set by cancel() to tell ThreadPool tasks given it to stop. Tasks
+  that have not started yet are not run, and running ones should
+  check cancelled() now and then and return early.
+*/
+class FL_API CancelToken {
+  volatile bool cancelled_;
+public:
+  CancelToken() : cancelled_(false) {}
+  void cancel() {cancelled_ = true;}
+  void reset() {cancelled_ = false;}
+  bool cancelled() const {return cancelled_;}
+};
+
+struct ThreadPoolTask;
+
+/**
+  Runs functions on a set of threads. Use ThreadPool::shared() rather
+  than making your own so the whole program uses the same threads.
+*/
+class FL_API ThreadPool {
+public:
+  typedef void (*Function)(void*);
+  typedef unsigned long TaskId;
+  enum Priority {LOW, NORMAL, HIGH};
+
+  ThreadPool(int threads = 0);
+  ~ThreadPool();
+
+  TaskId add(Function work, void* arg, Priority = NORMAL,
+	     Function done = 0, CancelToken* = 0);
+  bool remove(TaskId);
+  bool done(TaskId);
+  void wait(TaskId);
+  void wait_all();
+
+  int threads() const {return max_threads_;}
+  int queued() const {return queued_;}
+
+  static ThreadPool* shared();
+  static int cpu_count();
+
+private:
+  SignalMutex mutex_;
+  ThreadPoolTask* head_[3];
+  ThreadPoolTask* tail_[3];
+  ThreadPoolTask* running_;
+  TaskId last_id_;
+  int max_threads_, thread_count_, idle_, queued_;
+  bool quit_;
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+  ThreadPoolTask* unlink(TaskId);
+  ThreadPoolTask* pop();
+  void run(ThreadPoolTask*);
+  static void* worker(void*);
+};
+
 //@}
 
 }
@@ -29,17 +29,20 @@
 #ifndef fltk_TiledImage_h
 #define fltk_TiledImage_h
 
-#include "Symbol.h"
+#include "Image.h"
 
 namespace fltk {
 
 class FL_API TiledImage : public Symbol {
 protected:
   const Symbol* image_;
+  const Image* tile_; // image_ if it is an Image
 public:
-  TiledImage(Symbol *i) : Symbol(0), image_(i) {}
+  TiledImage(Symbol *i) : Symbol(0), image_(i), tile_(0) {}
+  TiledImage(Image *i) : Symbol(0), image_(i), tile_(i) {}
   const Symbol* image() const {return image_;}
-  void image(const Symbol* i) {image_ = i;}
+  void image(const Symbol* i) {image_ = i; tile_ = 0;}
+  void image(const Image* i) {image_ = i; tile_ = i;}
   void _measure(int& w, int& h) const;
   void _draw(const Rectangle&) const;
 };
@@ -41,6 +41,8 @@ public:
   static void disable() { enabled_ = false; }
 
   typedef const char* (*Generator)(Widget*, void*);
+  static const char* const LATER;
+  static void ready(Widget*, void*, const char* text);
   static void enter(Widget*, const Rectangle&, Generator, void* = 0);
   static void enter(Widget*, const Rectangle&, const char* text);
   static void enter(Widget*);
@@ -77,6 +79,8 @@ private:
   static void* current_data_;
   static Tooltip* instance_;
   static void tooltip_timeout(void*);
+  static void ready_cb(void*);
+  static void popup(const char*);
 };
 
 }
@@ -54,6 +54,9 @@ public:
 
   virtual int format(char*);
 
+  bool throttle() const {return throttle_;}
+  void throttle(bool);
+
   int handle(int);
 
 #ifdef FLTK_1_SLIDER
@@ -69,6 +72,7 @@ public:
 //protected:
 
   Valuator(int X, int Y, int W, int H, const char* L);
+  ~Valuator();
   double previous_value() const {return previous_value_;}
   void handle_push() {previous_value_ = value_;}
   void handle_drag(double newvalue);
@@ -85,6 +89,9 @@ private:
   double maximum_;
   double step_;
   double linesize_;
+  bool throttle_;
+  bool damage_pending_; // value_damage() waiting for the next frame
+  static void damage_cb(void*);
 
 };
 
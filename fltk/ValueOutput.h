@@ -33,7 +33,13 @@ public:
   void draw();
   int handle(int);
   ValueOutput(int x,int y,int w,int h,const char *l = 0)
-    : Valuator(x, y, w, h, l) {align(ALIGN_LEFT);}
+    : Valuator(x, y, w, h, l) {align(ALIGN_LEFT); text_[0] = 0;}
+  void value_damage();
+private:
+  // the text last printed by format(), and what it was printed for:
+  char text_[40];
+  double text_value_;
+  double text_step_;
 };
 
 }
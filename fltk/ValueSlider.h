@@ -44,6 +44,8 @@ public:
 private:
   static void input_cb(Widget*,void*);
   void slider_rect(Rectangle&);
+  int slider_pixel();
+  int drawn_pixel_; // slider_pixel() when last drawn
 };
 
 }
@@ -26,6 +26,7 @@
 
 #include "Style.h"
 #include "Rectangle.h"
+#include <stddef.h> // size_t for operator new
 
 namespace fltk {
 
@@ -55,6 +56,8 @@ public:
 
   Widget(int,int,int,int,const char* =0);
   virtual ~Widget();
+  static void* operator new(size_t);
+  static void operator delete(void*);
 
   virtual void draw();
   virtual int handle(int);
@@ -65,12 +68,14 @@ public:
   void	style(const Style* s) { style_ = s; }
   void	style(const Style& s) { style_ = &s; }
   bool	copy_style(const Style* s);
+  void	set_style_fields(const Style& changes);
   static NamedStyle* default_style;
   static Symbol* default_glyph;
 
   Group* parent() const	{ return parent_; }
-  void	parent(Group* w)	{ parent_ = w; }
+  void	parent(Group* w)	{ parent_ = w; tree_changes_++; damage_clears_++; }
   Window* window() const	;
+  int	depth() const		;
 
   enum WidgetVisualType {
     // Values for type() shared by Button and menu Item, and for fake RTTI:
@@ -82,7 +87,7 @@ public:
   };
 
   uchar	type() const		{ return type_; }
-  void	type(uchar t)		{ type_ = t; }
+  void	type(uchar t)		{ type_ = t; tree_changes_++; }
   bool	is_group() const	{ return type_ >= GROUP_TYPE; }
   bool	is_window() const	{ return type_ >= WINDOW_TYPE; }
 
@@ -184,6 +189,12 @@ public:
   bool	vertical() const	{ return flag(LAYOUT_VERTICAL);}
   void	set_horizontal()	{ clear_flag(LAYOUT_VERTICAL); }
   void	set_vertical()		{ set_flag(LAYOUT_VERTICAL); }
+  bool	cached() const		{ return flag(CACHED); }
+  void	set_cached()		{ set_flag(CACHED); }
+  void	clear_cached()		;
+  static void set_cache_size(unsigned long);
+  static unsigned long cache_mem_used();
+  unsigned alloc_size() const	{ return alloc_size_; }
 
   bool	take_focus()		;
   void	throw_focus()		;
@@ -194,7 +205,7 @@ public:
   void	redraw_highlight()	;
   void	redraw(const Rectangle&);
   uchar	damage() const		{ return damage_; }
-  void	set_damage(uchar c)	{ damage_ = c; } // should be called damage(c)
+  void	set_damage(uchar c)	{ if (damage_&~c&0x10/*DAMAGE_CHILD*/) damage_clears_++; damage_ = c; } // should be called damage(c)
 
   void  relayout()		;
   void	relayout(uchar damage)	;
@@ -312,6 +323,16 @@ private:
   uchar			damage_;
   uchar			layout_damage_;
   uchar			when_;
+  unsigned		alloc_size_; // bytes from operator new, or 0
+  mutable Window*	window_;	// cached window()
+  mutable int		depth_;		// cached depth()
+  mutable unsigned	tree_cached_;	// tree_changes_ when those were found
+  unsigned		damage_marked_;	// damage_clears_ when DAMAGE_CHILD was set
+
+  // Counted so the caches above can tell if they are out of date:
+  static unsigned	tree_changes_;	// parent() or type() changed
+  static unsigned	damage_clears_;	// DAMAGE_CHILD turned off or parent() changed
+  void			update_tree_cache() const;
 
 };
 
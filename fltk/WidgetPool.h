@@ -0,0 +1,72 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_WidgetPool_h
+#define fltk_WidgetPool_h
+
+#include "Menu.h"
+
+namespace fltk {
+
+class FL_API WidgetPool {
+public:
+  /** Function that makes a new widget for rows of \a type */
+  typedef Widget* (*Maker)(int type, void* arg);
+
+  WidgetPool(Maker maker = 0, void* arg = 0);
+  ~WidgetPool();
+
+  Widget* get(const Menu*, const int* indexes, int level, int type = 0,
+	      bool* reused = 0);
+  void capacity(int n);
+  /** How many widgets of each type are kept */
+  int capacity() const {return capacity_;}
+  /** How many widgets there are now */
+  int size() const {return count_;}
+  void forget();
+  void clear();
+
+private:
+  struct Entry {
+    Widget* widget;
+    const Menu* menu;
+    int type;
+    int level;
+    int* indexes;
+    unsigned stamp;
+  };
+  Entry* entries_;
+  int count_, size_;
+  int capacity_;
+  unsigned clock_;
+  Maker maker_;
+  void* arg_;
+  bool trim(int type);
+};
+
+}
+#endif
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,91 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_WidgetTable_h
+#define fltk_WidgetTable_h
+
+#include "Widget.h"
+
+namespace fltk {
+
+/*!
+  One widget in a table passed to build_widgets(). Every field is a
+  constant, so a table is compiled into read-only data, and a zero
+  means the widget's default is kept. The fields are ordered so the
+  ones left off the end of an initializer are the ones used least.
+*/
+struct WidgetDescriptor {
+  Widget* (*make)(int x, int y, int w, int h, const char* label);
+  int x, y, w, h;
+  const char* label;
+  int descendants;	//!< rows after this one that are inside this group
+  Widget** pointer;	//!< set to the new widget
+  Callback* callback;
+  const char* tooltip;
+  unsigned flags;	//!< the enum values below
+  int type;
+  Flags align;
+  uchar when;
+  unsigned shortcut;
+  Box* const* box;
+  Box* const* buttonbox;
+  Font* const* labelfont;
+  Font* const* textfont;
+  LabelType* const* labeltype;
+  Color color;
+  Color textcolor;
+  Color selection_color;
+  Color selection_textcolor;
+  Color buttoncolor;
+  Color labelcolor;
+  Color highlight_color;
+  Color highlight_textcolor;
+  float labelsize;
+  float textsize;
+  enum {
+    TYPE	= 1,	//!< set type()
+    ALIGN	= 2,	//!< set align()
+    WHEN	= 4,	//!< set when()
+    STATE	= 8,	//!< set_flag(STATE)
+    VERTICAL	= 16,	//!< set_vertical()
+    HIDE	= 32,	//!< hide()
+    DEACTIVATE	= 64,	//!< deactivate()
+    RESIZABLE	= 128	//!< make it the resizable() of the current group
+  };
+};
+
+/*! For WidgetDescriptor::make, constructs a T. */
+template <class T>
+Widget* new_widget(int x, int y, int w, int h, const char* label) {
+  return new T(x, y, w, h, label);
+}
+
+FL_API void build_widgets(const WidgetDescriptor* table, int n);
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -36,6 +36,7 @@ const int USEDEFAULT = ((int)0x80000000); // same as Win32 value
 
 class CreatedWindow;
 class Monitor;
+struct WidgetArena;
 
 // implementations of methods of Window are in different files in src/
 
@@ -72,6 +73,12 @@ public:
   bool double_buffer() const {return flag(DOUBLE);}
   void set_double_buffer() {set_flag(DOUBLE);}
   void clear_double_buffer() {clear_flag(DOUBLE);}
+  bool sparse_update() const {return flag(SPARSE);}
+  void set_sparse_update() {set_flag(SPARSE);}
+  void clear_sparse_update() {clear_flag(SPARSE);}
+  enum {SERVER_DRAWING, CLIENT_DRAWING, AUTO_DRAWING};
+  int client_drawing() const {return client_drawing_;}
+  void client_drawing(int v) {client_drawing_ = (unsigned char)v;}
   void free_backbuffer();
 
   virtual void draw_overlay();
@@ -117,6 +124,9 @@ public:
 
   void borders( Rectangle *r ) const;
 
+  void begin_arena(int size = 0);
+  void end_arena();
+
   static const Window* drawing_window() {return drawing_window_;}
   static const Window* drawing_window_;
 
@@ -135,9 +145,11 @@ private:
   const Window* child_of_;
   const char* iconlabel_;
   const void* icon_;
+  WidgetArena* arena_;
   // size_range stuff:
   short minw, minh, maxw, maxh;
   unsigned char dw, dh, size_range_set;
+  unsigned char client_drawing_;
   void size_range_();
   // values for flags():
   enum {
@@ -145,7 +157,8 @@ private:
     NOBORDER 	    = 0x40000000,
     OVERRIDE	    = 0x20000000,
     NON_MODAL	    = 0x10000000,
-    DOUBLE	    = 0x08000000
+    DOUBLE	    = 0x08000000,
+    SPARSE	    = 0x04000000
   };
   static const char* xclass_;
   void _Window(); // constructor innards
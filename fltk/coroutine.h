@@ -0,0 +1,175 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#ifndef fltk_coroutine_h
+#define fltk_coroutine_h
+
+// Awaitable wrappers around the event loop for C++20 coroutines. This
+// header is empty unless the compiler supports them.
+
+#include "run.h"
+
+#if __cplusplus >= 202002L && defined(__has_include)
+# if __has_include(<coroutine>)
+#  include <coroutine>
+#  include <exception>
+#  define FLTK_HAVE_COROUTINES 1
+# endif
+#endif
+
+#if FLTK_HAVE_COROUTINES
+
+namespace fltk {
+
+/// \name fltk/coroutine.h
+//@{
+
+/*!
+  Return type for a coroutine started from a callback. It runs until
+  its first co_await that must wait, then the caller continues, and
+  fltk::wait() resumes it later. Nothing needs to be kept: the
+  coroutine frees itself when it returns.
+
+\code
+fltk::Async blink(fltk::Widget* w) {
+  for (int i = 0; i < 6; i++) {
+    co_await fltk::sleep(.25f);
+    if (i & 1) w->show(); else w->hide();
+  }
+}
+\endcode
+
+  The awaitables keep their state in the coroutine frame, so waiting
+  does not allocate anything. Only one coroutine at a time may wait
+  for each direction of a file descriptor, and a coroutine waiting on
+  a widget must not outlive it.
+*/
+struct Async {
+  struct promise_type {
+    Async get_return_object() {return Async();}
+    std::suspend_never initial_suspend() noexcept {return {};}
+    std::suspend_never final_suspend() noexcept {return {};}
+    void return_void() {}
+    void unhandled_exception() {std::terminate();}
+  };
+};
+
+/*! Awaitable returned by sleep(). */
+class Sleep {
+  float seconds_;
+  static void resume(void* h) {std::coroutine_handle<>::from_address(h).resume();}
+public:
+  explicit Sleep(float seconds) : seconds_(seconds) {}
+  bool await_ready() const noexcept {return false;}
+  void await_suspend(std::coroutine_handle<> h) {
+    add_timeout(seconds_, resume, h.address());
+  }
+  void await_resume() const noexcept {}
+};
+
+/*! co_await this to resume \a seconds later, from an add_timeout(). */
+inline Sleep sleep(float seconds) {return Sleep(seconds);}
+
+/*! Awaitable returned by readable() and writable(). */
+class FdReady {
+  int fd_, when_;
+  std::coroutine_handle<> h_;
+  static void resume(int fd, void* v) {
+    FdReady* a = (FdReady*)v;
+    remove_fd(fd, a->when_);
+    a->h_.resume();
+  }
+public:
+  FdReady(int fd, int when) : fd_(fd), when_(when) {}
+  bool await_ready() const noexcept {return false;}
+  void await_suspend(std::coroutine_handle<> h) {
+    h_ = h;
+    add_fd(fd_, when_, resume, this);
+  }
+  void await_resume() const noexcept {}
+};
+
+/*! co_await this to resume when \a fd can be read, as add_fd(fd, READ). */
+inline FdReady readable(int fd) {return FdReady(fd, READ);}
+
+/*! co_await this to resume when \a fd can be written, as add_fd(fd, WRITE). */
+inline FdReady writable(int fd) {return FdReady(fd, WRITE);}
+
+/*!
+  Awaitable returned by next_message(). The co_await returns the
+  message, taking it instead of fltk::thread_message(). Only non-zero
+  messages sent by awake() are seen.
+*/
+class ThreadMessage {
+  void* message_;
+  std::coroutine_handle<> h_;
+  static void check(void* v) {
+    ThreadMessage* a = (ThreadMessage*)v;
+    void* m = thread_message();
+    if (!m) return;
+    remove_check(check, a);
+    a->message_ = m;
+    a->h_.resume();
+  }
+public:
+  ThreadMessage() : message_(0) {}
+  bool await_ready() noexcept {return (message_ = thread_message()) != 0;}
+  void await_suspend(std::coroutine_handle<> h) {
+    h_ = h;
+    add_check(check, this);
+  }
+  void* await_resume() const noexcept {return message_;}
+};
+
+/*! co_await this to get the next message another thread sent with
+  fltk::awake(). */
+inline ThreadMessage next_message() {return ThreadMessage();}
+
+/*!
+  Awaitable returned by main_thread(). A coroutine running in another
+  thread continues in the main thread, through fltk::post(), with the
+  fltk lock held. It does not wait if it is already in the main thread.
+*/
+class MainThread {
+  static void resume(void* h) {std::coroutine_handle<>::from_address(h).resume();}
+public:
+  bool await_ready() const noexcept {return in_main_thread();}
+  void await_suspend(std::coroutine_handle<> h) {post(resume, h.address());}
+  void await_resume() const noexcept {}
+};
+
+/*! co_await this to move the rest of the coroutine to the main thread. */
+inline MainThread main_thread() {return MainThread();}
+
+//@}
+
+}
+
+#endif
+
+#endif
+
+//
+// End of "$Id$".
+//
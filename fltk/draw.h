@@ -73,6 +73,7 @@ FL_API void transform_distance(float& x, float& y);
 FL_API void transform(int& x, int& y);
 FL_API void transform(const Rectangle& from, Rectangle& to);
 FL_API void transform(int& x, int& y, int& w, int& h);
+FL_API void transform(int n, const float in[][2], float out[][2]);
 
 // Clipping
 FL_API void push_clip(const Rectangle&);
@@ -152,6 +153,9 @@ FL_API void drawline(int x0, int y0, int x1, int y1);
 FL_API void drawline(float x0, float y0, float x1, float y1);
 FL_API void drawpoint(int x, int y);
 FL_API void drawpoint(float x, float y);
+FL_API void fillrects(int n, const Rectangle* r, const Color* colors = 0);
+FL_API void drawlines(int n, const int v[][4], const Color* colors = 0);
+FL_API void drawpoints(int n, const int v[][2], const Color* colors = 0);
 
 // Text
 FL_API void setfont(Font*, float size);
@@ -172,6 +176,9 @@ inline float getsize() {return current_size_;}
 // measure things in the current font:
 FL_API float getwidth(const char*);
 FL_API float getwidth(const char*, int length);
+FL_API void set_width_cache_size(int entries);
+FL_API unsigned long width_cache_hits();
+FL_API unsigned long width_cache_misses();
 FL_API float getascent();
 FL_API float getdescent();
 
@@ -187,6 +194,7 @@ FL_API void drawtext(const char*, const Rectangle&, Flags);
 FL_API void drawtext(void (*textfunction)(const char*,int,float,float),
 		     float (*getwidth)(const char*, int),
 		     const char* str, const Rectangle& r, Flags flags);
+FL_API void set_text_layout_cache(int entries);
 
 // set where \t characters go in label text formatter:
 extern FL_API const int* column_widths_;
@@ -200,6 +208,7 @@ FL_API void drawimage(const uchar*, PixelType, const Rectangle&, int linedelta);
 
 typedef const uchar* (*DrawImageCallback)(void* data, int x, int y, int w, uchar* buffer);
 FL_API void drawimage(DrawImageCallback, void*, PixelType, const Rectangle&);
+FL_API void set_drawimage_threads(int n, bool concurrent_callbacks = false);
 
 FL_API uchar *readimage(uchar *p, PixelType, const Rectangle&);
 FL_API uchar *readimage(uchar *p, PixelType, const Rectangle&, int linedelta);
@@ -279,6 +279,18 @@ inline float event_x_tilt()     	{return e_x_tilt;}
 inline float event_y_tilt()     	{return e_y_tilt;}
 inline int  event_device()      	{return e_device;}
 
+/*! One of the mouse positions merged into a MOVE or DRAG event, see
+  fltk::event_motion_history(). */
+struct MotionSample {
+  int x, y;		//!< position relative to the window
+  int x_root, y_root;	//!< position relative to the screen
+  unsigned long time;	//!< system time stamp
+  float pressure;	//!< event_pressure()
+  float x_tilt, y_tilt; //!< event_x_tilt() and event_y_tilt()
+};
+FL_API void keep_motion_history(bool);
+FL_API int event_motion_history(const MotionSample*&);
+
 // tests on current event:
 FL_API bool event_inside(const Rectangle&);
 FL_API bool compose(int &del);
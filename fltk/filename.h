@@ -141,6 +141,33 @@ FL_API int filename_list(const char *d, dirent ***list); // uses numericsort
 
 //@}
 
+struct FilenamePatternKey;
+
+/**
+  A list of filename_match() patterns compiled so a name can be tested
+  against all of them at once. Patterns like "*.ext", "*.{a,b,c}" and
+  plain names are found with a hash table, the rest are tried in order.
+*/
+class FL_API FilenamePatterns {
+public:
+  FilenamePatterns();
+  ~FilenamePatterns();
+  int add(const char* pattern, unsigned mask = 1);
+  void clear();
+  /** \return How many patterns were add()ed */
+  int size() const {return count_;}
+  int match(const char* name, unsigned mask = ~0u) const;
+private:
+  struct Pattern {char* text; unsigned mask;};
+  Pattern* patterns_;
+  int count_, size_;
+  FilenamePatternKey** buckets_;
+  unsigned nbuckets_, nkeys_;
+  int* rest_;		// patterns that are not in the hash table
+  int nrest_;
+  void add_key(const char* key, int n, bool suffix, int index);
+};
+
 }
 
 #endif
@@ -81,12 +81,15 @@ FL_GL_API void glWindowPos2i(int x, int y);
 namespace fltk {
 
 struct Font;
+class Image;
 
 /// \name fltk/gl.h
 //@{
 
 FL_GL_API void glstart();
 FL_GL_API void glfinish();
+FL_GL_API void glbeginbatch();
+FL_GL_API void glendbatch();
 
 FL_GL_API void glsetcolor(Color);
 
@@ -103,8 +106,13 @@ FL_GL_API void gldrawtext(const char*);
 FL_GL_API void gldrawtext(const char*, int n);
 FL_GL_API void gldrawtext(const char*, float x, float y, float z = 0);
 FL_GL_API void gldrawtext(const char*, int n, float x, float y, float z = 0);
+FL_GL_API void glsetglyphcache(int pages);
 
 FL_GL_API void gldrawimage(const uchar *, int x,int y,int w,int h, int d=3, int ld=0);
+FL_GL_API void gldrawimage(const Image&, int x,int y,int w,int h);
+FL_GL_API void glforgetimage(const Image&);
+FL_GL_API void glsetimagecache(unsigned long bytes);
+FL_GL_API unsigned long glimagecachememused();
 
 //@}
 
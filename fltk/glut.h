@@ -253,6 +253,9 @@ enum {GLUT_NOT_VISIBLE, GLUT_VISIBLE};
 
 FL_GLUT_API void glutIdleFunc(void (*f)());
 
+// fltk extension, call the idle function once per frame:
+FL_GLUT_API void glutFramePacing(float interval);
+
 // Warning: this cast may not work on all machines:
 inline void glutTimerFunc(unsigned int msec, void (*f)(int), int value) {
   fltk::add_timeout(msec*.001f, (fltk::TimeoutHandler)f, (void *)value);
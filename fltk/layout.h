@@ -1,6 +1,8 @@
 #ifndef fltk_layout_h
 #define fltk_layout_h
 
+#include "FL_API.h"
+
 namespace fltk {
 
 /*!
@@ -33,9 +35,13 @@ enum {
   LAYOUT_XYWH	= 0x0F, /*!< Same as LAYOUT_XY|LAYOUT_WH */
   LAYOUT_CHILD	= 0x10, /*!< Widget::layout() needs to be called on a child of this group widget. */
   LAYOUT_USER   = 0x20, /*!< The moving/resizing is being caused by the user and not internal code. */
+  LAYOUT_CHILD_RESIZE = 0x40, /*!< LAYOUT_DAMAGE is only on because children were resized, so the other children do not need layout() */
   LAYOUT_DAMAGE	= 0x80	/*!< Widget::relayout() was called. */
 };
 
+FL_API unsigned long layouts_done();
+FL_API unsigned long layouts_skipped();
+
 }
 
 #endif
@@ -50,6 +50,10 @@ FL_API int ready();
 FL_API int run();
 FL_API void flush();
 FL_API void redraw();
+FL_API void resize_throttle(float);
+FL_API float resize_throttle();
+FL_API void frame_interval(float);
+FL_API float frame_interval();
 extern FL_API int damage_;
 inline void damage(int d) {damage_ = d;}
 inline int damage() {return damage_;}
@@ -59,10 +63,19 @@ typedef void (*TimeoutHandler)(void*);
 
 FL_API double get_time_secs();
 
-FL_API void add_timeout(float t, TimeoutHandler, void* v = 0);
-FL_API void repeat_timeout(float t, TimeoutHandler,void* = 0);
+/*! Identifies a timeout returned by add_timeout() and repeat_timeout() */
+typedef unsigned long TimeoutId;
+
+FL_API TimeoutId add_timeout(float t, TimeoutHandler, void* v = 0);
+FL_API TimeoutId repeat_timeout(float t, TimeoutHandler,void* = 0);
 FL_API bool has_timeout(TimeoutHandler, void* = 0);
+FL_API bool has_timeout(TimeoutId);
 FL_API void remove_timeout(TimeoutHandler, void* = 0);
+FL_API void remove_timeout(TimeoutId);
+
+FL_API void add_timer_group(float period, TimeoutHandler, void* = 0);
+FL_API bool has_timer_group(TimeoutHandler, void* = 0);
+FL_API void remove_timer_group(TimeoutHandler, void* = 0);
 
 FL_API void add_check(TimeoutHandler, void* = 0);
 FL_API bool has_check(TimeoutHandler, void* = 0);
@@ -72,6 +85,20 @@ FL_API void add_idle(TimeoutHandler, void* = 0);
 FL_API bool has_idle(TimeoutHandler, void* = 0);
 FL_API void remove_idle(TimeoutHandler, void* = 0);
 
+/*! Type of function passed to add_idle_job(). Return true to be
+  called again. */
+typedef bool (*IdleJob)(void*);
+FL_API void add_idle_job(IdleJob, void* = 0, int priority = 0);
+FL_API bool has_idle_job(IdleJob, void* = 0);
+FL_API void remove_idle_job(IdleJob, void* = 0);
+FL_API bool idle_slice_over();
+FL_API void idle_slice(float seconds);
+FL_API float idle_slice();
+
+FL_API void add_frame_callback(TimeoutHandler, void* = 0);
+FL_API bool has_frame_callback(TimeoutHandler, void* = 0);
+FL_API void remove_frame_callback(TimeoutHandler, void* = 0);
+
 // For back-compatability only:
 extern FL_API void (*idle)();
 inline void set_idle(void (*cb)()) {idle = cb;}
@@ -86,8 +113,16 @@ FL_API FILE* fltk_fopen(const char* name, const char* flags);
 
 FL_API void lock();
 FL_API void unlock();
+FL_API void lock_shared();
+FL_API void unlock_shared();
 FL_API void awake(void* message = 0);
 FL_API void* thread_message();
+
+/*! Identifies a call queued by post() */
+typedef unsigned long PostId;
+FL_API PostId post(TimeoutHandler, void* = 0);
+FL_API bool post_done(PostId);
+FL_API void wait_posted(PostId);
 FL_API bool in_main_thread();
 
 //@}
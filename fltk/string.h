@@ -64,6 +64,8 @@ extern "C" {
 #include "FL_API.h"
 
 FL_API extern char* newstring(const char *);
+FL_API extern const char* internstring(const char *);
+FL_API extern void releasestring(const char *);
 
 #if defined(DOXYGEN) || defined(__MWERKS__)
 FL_API extern int strcasecmp(const char *, const char *);
@@ -0,0 +1,213 @@
+// "$Id$"
+//
+// Optional recording of how long the parts of the fltk main loop take.
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#ifndef fltk_trace_h
+#define fltk_trace_h
+
+#include "FL_API.h"
+#include <stdio.h>
+
+namespace fltk {
+
+class FL_API Widget;
+
+/// \name fltk/trace.h
+//@{
+
+/*! What a TraceRecord measured. */
+enum TraceCategory {
+  TRACE_WAIT,	//!< Blocked in the system waiting for events
+  TRACE_EVENT,	//!< fltk::handle() of one event
+  TRACE_TIMEOUT,//!< One add_timeout() callback
+  TRACE_CHECK,	//!< One add_check() callback
+  TRACE_IDLE,	//!< The idle callbacks
+  TRACE_POST,	//!< A batch of fltk::post() calls
+  TRACE_LAYOUT,	//!< Window::layout() of one window
+  TRACE_DRAW,	//!< Window::flush() of one window
+  TRACE_FLUSH,	//!< Sending the drawing to the display (XFlush, etc)
+  TRACE_USER,	//!< Recorded by the program with trace()
+  TRACE_STARTUP,//!< Opening the display, loading the theme, finding fonts by name
+  TRACE_CATEGORIES
+};
+
+/*! One timed interval, see fltk::trace_record(). */
+struct TraceRecord {
+  double start;		//!< trace_time() when it started
+  float duration;	//!< seconds it took
+  unsigned char category; //!< a TraceCategory
+  const char* name;	//!< static string such as fltk::event_name()
+  const void* object;	//!< the Window, widget or callback involved
+};
+
+extern FL_API bool tracing_;
+inline bool tracing() {return tracing_;}
+FL_API void start_tracing(int records = 8192);
+FL_API void stop_tracing();
+FL_API void clear_trace();
+
+FL_API double trace_time();
+FL_API void trace(TraceCategory, const char* name, const void* object, double start);
+
+FL_API int trace_records();
+FL_API const TraceRecord* trace_record(int);
+FL_API unsigned long trace_count(TraceCategory);
+FL_API double trace_total(TraceCategory);
+FL_API float trace_max(TraceCategory);
+
+FL_API bool write_trace_json(FILE*);
+FL_API bool write_trace_json(const char* filename);
+FL_API void write_startup_report(FILE*);
+
+/*! Memory used by parts of fltk, see fltk::memory_report(). */
+struct MemoryReport {
+  unsigned long widgets;	//!< Widget objects that exist
+  unsigned long widget_bytes;	//!< size of the ones made with new
+  unsigned long styles;		//!< dynamic() styles shared by widgets
+  unsigned long style_bytes;
+  unsigned long labels;		//!< different strings given to Widget::copy_label()
+  unsigned long label_bytes;
+  unsigned long text_buffers;	//!< TextBuffer objects
+  unsigned long text_buffer_bytes; //!< text and gaps allocated by them
+  unsigned long text_buffer_gap_bytes; //!< the part of that which is gaps
+  unsigned long image_bytes;	//!< Image::total_mem_used()
+  unsigned long widget_cache_bytes; //!< Widget::cache_mem_used()
+  unsigned long pixmaps;	//!< back buffers and image atlases on the server
+  unsigned long pixmap_bytes;
+  unsigned long fonts;		//!< font+size combinations opened
+  unsigned long font_bytes;	//!< their structures and width caches
+  unsigned long gl_textures;	//!< textures made by the OpenGL drawing code
+  unsigned long gl_texture_bytes;
+  unsigned long preferences_nodes; //!< groups in all Preferences files
+  unsigned long preferences_bytes;
+};
+
+/*! Bytes used by one class of widget, see fltk::widget_class_memory(). */
+struct WidgetClassMemory {
+  const char* name;	//!< class name, or "Widget" without rtti
+  unsigned long count;	//!< how many are in shown windows
+  unsigned long bytes;	//!< size of the ones made with new
+};
+
+FL_API void memory_report(MemoryReport&);
+FL_API int widget_class_memory(WidgetClassMemory* array, int n);
+FL_API void write_memory_report(FILE*);
+
+FL_API bool start_recording(FILE*);
+FL_API bool start_recording(const char* filename);
+FL_API void stop_recording();
+FL_API bool recording();
+
+/*! Per-widget drawing statistics, see fltk::start_draw_profile(). */
+struct DrawProfile {
+  const Widget* widget; //!< the widget that was drawn
+  float average;	//!< moving average of seconds draw() took
+  float last;		//!< seconds the most recent draw() took
+  float max;		//!< the longest draw() has taken
+  unsigned long draws;	//!< times drawn because the parent redrew everything
+  unsigned long updates;//!< times drawn because the widget itself was damaged
+};
+
+extern FL_API bool profiling_draws_;
+inline bool profiling_draws() {return profiling_draws_;}
+extern FL_API int draw_profile_overlay_;
+inline int draw_profile_overlay() {return draw_profile_overlay_;}
+FL_API void start_draw_profile(int overlay = 0);
+FL_API void stop_draw_profile();
+FL_API void clear_draw_profile();
+FL_API void profile_draw(Widget*, double start, bool update);
+FL_API const DrawProfile* draw_profile(const Widget*);
+FL_API int draw_profiles(const DrawProfile** array, int n);
+
+/*! Work done between two frames, see fltk::frame_stats(). */
+struct FrameStats {
+  unsigned long frames;		//!< fltk::flush() calls that drew something
+  unsigned long windows;	//!< Window::flush() calls
+  unsigned long requests;	//!< X requests sent, from XNextRequest()
+  unsigned long round_trips;	//!< times fltk waited for the X server
+  unsigned long image_bytes;	//!< image data sent to the display
+  unsigned long glyphs;		//!< characters drawn by drawtext()
+};
+
+extern FL_API FrameStats frame_counts_;
+FL_API const FrameStats& frame_stats();
+FL_API const FrameStats& frame_stats_total();
+FL_API void clear_frame_stats();
+
+enum {
+  LATENCY_EVENTS = 25,	//!< event types measured, numbered like fltk::PUSH
+  LATENCY_BUCKETS = 12	//!< size of LatencyHistogram::bucket
+};
+
+/*! Input to display times of one type of event, see fltk::input_latency(). */
+struct LatencyHistogram {
+  unsigned long count;	//!< events that caused drawing
+  double total;		//!< sum of their latencies in seconds
+  float max;		//!< the longest latency
+  unsigned long bucket[LATENCY_BUCKETS]; //!< bucket[i] counts ones less than 2^i/2 ms, the last the rest
+};
+
+extern FL_API bool measuring_latency_;
+inline bool measuring_latency() {return measuring_latency_;}
+FL_API void start_latency_measure();
+FL_API void stop_latency_measure();
+FL_API void clear_latency_measure();
+FL_API const LatencyHistogram& input_latency(int event);
+FL_API float latency_percentile(const LatencyHistogram&, float fraction);
+FL_API void write_latency_report(FILE*);
+
+extern FL_API bool flashing_redraws_;
+inline bool flashing_redraws() {return flashing_redraws_;}
+FL_API void flash_redraws(bool on = true);
+
+/*!
+  Creating a local one of these records the time until it is
+  destroyed, if tracing() is on:
+\code
+  void MyWidget::draw() {
+    fltk::TraceScope t(fltk::TRACE_USER, "MyWidget::draw", this);
+    ...
+  }
+\endcode
+*/
+class TraceScope {
+  double start;
+  const char* name;
+  const void* object;
+  unsigned char category;
+  bool on;
+public:
+  TraceScope(TraceCategory c, const char* n, const void* o = 0)
+    : start(0), name(n), object(o), category(c), on(tracing_) {
+    if (on) start = trace_time();
+  }
+  ~TraceScope() {if (on) trace(TraceCategory(category), name, object, start);}
+};
+
+//@}
+
+}
+
+#endif
+
+// End of "$Id$".
@@ -149,6 +149,8 @@ extern FL_API HRGN	clip_region();
 extern FL_API void	draw_into(HBITMAP, int w, int h);
 extern FL_API void	stop_drawing(HBITMAP);
 extern FL_API void	stop_drawing(HWND);
+extern FL_API bool	direct2d();
+extern FL_API void	direct2d(bool);
 
 ////////////////////////////////////////////////////////////////
 #ifdef fltk_Window_h // only include this if <fltk/Fl_Window.h> was included
@@ -164,6 +166,8 @@ public:
   HDC dc;
   HBITMAP backbuffer;
   HDC bdc;
+  unsigned char* backbuffer_bits; // pixels of the backbuffer DIB section
+  int backbuffer_w, backbuffer_h;
   Window* window;
   HRGN region;
   void expose(const Rectangle&);
@@ -0,0 +1,55 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+/*! \file
+  Functions in the fltk_images library to write image files.
+*/
+
+#ifndef fltk_write_image_h
+#define fltk_write_image_h
+
+#include "FL_API.h"
+#include "PixelType.h"
+
+namespace fltk {
+
+class FL_API Image;
+class FL_API Rectangle;
+
+FL_IMAGES_API bool write_png(const char* filename, const uchar* pixels,
+			     PixelType, int w, int h, int linedelta = 0,
+			     int level = 1);
+FL_IMAGES_API bool write_png(const char* filename, const Image&, int level = 1);
+FL_IMAGES_API bool write_png(const char* filename, const Rectangle&, int level = 1);
+
+FL_IMAGES_API bool write_ppm(const char* filename, const uchar* pixels,
+			     PixelType, int w, int h, int linedelta = 0);
+FL_IMAGES_API bool write_ppm(const char* filename, const Rectangle&);
+
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -99,6 +99,7 @@ extern FL_API XWindow	message_window;
 extern FL_API int	xscreen;
 extern FL_API XVisualInfo* xvisual;
 extern FL_API Colormap	xcolormap;
+extern FL_API double	display_latency();
 
 ////////////////////////////////////////////////////////////////
 // event handling:
@@ -140,6 +141,8 @@ extern FL_API XftFont*  xftfont();
 // only include this if <fltk/Window.h> was included:
 #  if defined(fltk_Window_h) || defined(DOXYGEN)
 
+class Image;
+
 /**
   When fltk tells X about a window, one of these objects is created.
   Warning: this object is highly subject to change!  It's definition
@@ -150,6 +153,7 @@ public:
   XWindow xid; //!< The CreatedWindow's XWindow IDentifier
   XWindow backbuffer; //!< The CreatedWindow's secondary buffer
   XWindow frontbuffer; //!< The CreatedWindow's primary buffer
+  int backbuffer_w, backbuffer_h; //!< Size of a Pixmap backbuffer, it may be bigger than the window
   Window *window; //!< The Window (if any) this CreatedWindow refers to
   Region region; //!< The X Region this Window operates on
   void expose(const Rectangle&);
@@ -159,6 +163,7 @@ public:
   bool overlay; //!< Whether or not to redraw the overlay on the next redraw loop
   ::Cursor cursor; //!< The XCursor this window uses
   const Widget* cursor_for;
+  Image* client_buffer; //!< Back buffer in this program's memory, see Window::client_drawing()
   static CreatedWindow* first; //!< The first CreatedWindow of the linked list
   /** Finds a Window's corresponding CreatedWindow
       \param window the Window to find
@@ -95,14 +95,20 @@ static void Widget_Browser_callback(fltk::Widget * w,void *) {
     else if (fltk::event()==fltk::WHEN_ENTER_KEY || fltk::event_clicks()) { // double_click open the widget editor
 	if (FluidType::current) FluidType::current->open();
     }
-    if(fltk::event()!=fltk::RELEASE) refresh_browser_views();
+    // the browser redraws the rows it changed itself:
+    if(fltk::event()!=fltk::RELEASE) update_status_bar();
 }
 
-
+// Redraw the whole browser, only needed if many rows may have changed.
+// Use FluidType::changed() for one row:
 void refresh_browser_views() {
   if (compile_only) return;
-    widget_browser->redraw();
-    if (!status_bar) return;
+  widget_browser->redraw();
+  update_status_bar();
+}
+
+void update_status_bar() {
+    if (compile_only || !status_bar) return;
     int cnt = FluidType::selected_count();
     if (cnt <2) status_bar->set(0, StatusBarGroup::SBAR_RIGHT);
     if (cnt <1) status_bar->set(0, StatusBarGroup::SBAR_CENTER);
@@ -135,6 +141,45 @@ fltk::Widget *make_widget_browser(int x,int y,int w,int h) {
   return widget_browser;
 }
 
+// Rows are drawn in order, so child() remembers the last item it found
+// at each level and walks on from there rather than from the first
+// brother, which otherwise made drawing a row take time proportional
+// to the size of the design. This is cleared whenever the tree changes:
+enum {CACHED_LEVELS = 32};
+static struct {
+  FluidType* parent;	// whose child it is, null for the top level
+  int index;
+  FluidType* item;
+} child_cache[CACHED_LEVELS];
+
+static void clear_child_cache() {
+  for (int l = 0; l < CACHED_LEVELS; l++) child_cache[l].item = 0;
+}
+
+// Call this when items are added, removed, or moved:
+static void tree_changed() {
+  clear_child_cache();
+  if (widget_browser) widget_browser->relayout();
+}
+
+// Find the index'th child of parent, or of the top level if null:
+static FluidType* find_child(FluidType* parent, int index, int level) {
+  FluidType* item = parent ? parent->first_child : FluidType::first;
+  int i = 0;
+  if (level < CACHED_LEVELS && child_cache[level].item &&
+      child_cache[level].parent == parent && child_cache[level].index <= index) {
+    item = child_cache[level].item;
+    i = child_cache[level].index;
+  }
+  for (; item && i < index; i++) item = item->next_brother;
+  if (item && level < CACHED_LEVELS) {
+    child_cache[level].parent = parent;
+    child_cache[level].index = index;
+    child_cache[level].item = item;
+  }
+  return item;
+}
+
 int Widget_List::children(const fltk::Menu*, const int* indexes, int level) {
   FluidType* item = FluidType::first;
   if (!item) return 0;
@@ -147,26 +192,62 @@ int Widget_List::children(const fltk::Menu*, const int* indexes, int level) {
   return n;
 }
 
-static const char * get_item_fullname(FluidType* item) {
-    static char buffer[PATH_MAX];
-    if (strcmp(item->type_name(),"namespace") ==0) 
-	sprintf(buffer, "%s %s", "namespace", item->title());
-    else if (strcmp(item->type_name(),"class") ==0) 
-	sprintf(buffer, "%s %s", "class", item->title());
-    else 
-	return item->title();
+// The text shown in the browser, kept until changed() is called:
+const char* FluidType::browser_title() {
+  if (browser_title_) return browser_title_;
+  char buffer[PATH_MAX];
+  const char* t;
+  if (strcmp(type_name(),"namespace") ==0) 
+    {snprintf(buffer, PATH_MAX, "%s %s", "namespace", title()); t = buffer;}
+  else if (strcmp(type_name(),"class") ==0) 
+    {snprintf(buffer, PATH_MAX, "%s %s", "class", title()); t = buffer;}
+  else 
+    t = title();
+  browser_title_ = strdup(t);
+  return browser_title_;
+}
+
+// Put the path of indexes to item into the end of indexes[100],
+// return where it starts:
+static int browser_index(FluidType* i, int indexes[100]) {
+  int L = 100;
+  while (i && L > 0) {
+    FluidType* child = i->parent ? i->parent->first_child : FluidType::first;
+    int n; for (n = 0; child != i; child=child->next_brother) n++;
+    indexes[--L] = n;
+    i = i->parent;
+  }
+  return L;
+}
 
-    return buffer;
+// Redraw only the row showing this item:
+static void damage_row(FluidType* item) {
+  if (compile_only || !widget_browser) return;
+  for (FluidType* p = item->parent; p; p = p->parent)
+    if (!p->open_) return; // not shown
+  int indexes[100];
+  int L = browser_index(item, indexes);
+  if (widget_browser->goto_index(indexes+L, 99-L))
+    widget_browser->damage_item();
+}
+
+/**
+  Call this when something that title() uses has changed. The text in
+  the browser is made again and only this item's row is redrawn, so
+  the time an edit takes does not depend on how big the design is.
+*/
+void FluidType::changed() {
+  free((void*)browser_title_);
+  browser_title_ = 0;
+  damage_row(this);
 }
 
 fltk::Widget* Widget_List::child(const fltk::Menu*, const int* indexes, int level) {
-  FluidType* item = FluidType::first;
-  if (!item) return 0;
+  FluidType* item = 0;
   for (int l = 0;; l++) {
-    for (int i = indexes[l]; item && i; --i) item = item->next_brother;
+    item = find_child(item, indexes[l], l);
     if (!item) return 0;
     if (l >= level) break;
-    item = item->first_child;
   }
   static fltk::Widget* widget;
   if (!widget) {
@@ -179,7 +260,7 @@ fltk::Widget* Widget_List::child(const fltk::Menu*, const int* indexes, int leve
   // force the hierarchy to be open/closed:
   widget->state(item->is_parent() && item->open_);
 
-  widget->label(get_item_fullname(item));
+  widget->label(item->browser_title());
   //widget->w(0); widget->h(0);
   if (item->pixmapID()>0) 
       widget->image(fluid_pixmap[item->pixmapID()]);
@@ -199,7 +280,8 @@ void select(FluidType* it, int value) {
   if (it->new_selected != it->selected()) {
     selection_changed(it);
     widget_browser->goto_focus();
-    refresh_browser_views();
+    damage_row(it);
+    update_status_bar();
   }
 }
 
@@ -208,13 +290,7 @@ void select_only(FluidType* i) {
     select(item, item == i);
   if (!widget_browser || !i) return;
   int indexes[100];
-  int L = 100;
-  while (i) {
-    FluidType* child = i->parent ? i->parent->first_child : FluidType::first;
-    int n; for (n = 0; child != i; child=child->next_brother) n++;
-    indexes[--L] = n;
-    i = i->parent;
-  }
+  int L = browser_index(i, indexes);
   widget_browser->goto_index(indexes+L, 99-L);
   widget_browser->set_focus();
 }
@@ -260,9 +336,12 @@ const char* FluidType::title() {
   return buffer;
 }
 
-// Call this when the descriptive text changes:
+// Call this when the descriptive text of all the selected items may
+// have changed:
 void redraw_browser() {
-  refresh_browser_views();
+  for (FluidType* o = FluidType::first; o; o = o->walk())
+    if (o->selected()) o->changed();
+  update_status_bar();
 }
 
 FluidType::FluidType() {
@@ -329,7 +408,7 @@ void FluidType::add(FluidType *p) {
   if (p) p->add_child(this,0);
   open_ = true;
   modflag = 1;
-  widget_browser->relayout();
+  tree_changed();
 }
 
 // add to a parent before another widget:
@@ -342,7 +421,7 @@ void FluidType::insert(FluidType *g) {
   next_brother = g;
   g->previous_brother = this;
   if (parent) parent->add_child(this, g);
-  widget_browser->relayout();
+  tree_changed();
 }
 
 // delete from parent:
@@ -354,7 +433,7 @@ void FluidType::remove() {
   previous_brother = next_brother = 0;
   if (parent) parent->remove_child(this);
   parent = 0;
-  widget_browser->relayout();
+  tree_changed();
   selection_changed(0);
 }
 
@@ -386,13 +465,13 @@ int storestring(const char *n, const char * & p, int nostrip) {
 }
 
 void FluidType::name(const char *n) {
-  if (storestring(n,name_)) refresh_browser_views();
+  if (storestring(n,name_)) changed();
 }
 
 void FluidType::label(const char *n) {
   if (storestring(n,label_,1)) {
     setlabel(label_);
-    if (!name_) refresh_browser_views();
+    if (!name_) changed();
   }
 }
 
@@ -431,7 +510,8 @@ FluidType::~FluidType() {
   if (current == this) current = 0;
   modflag = 1;
   selected(false);
-  if (widget_browser) widget_browser->relayout();
+  free((void*)browser_title_);
+  tree_changed();
 }
 
 int FluidType::is_parent() const {return 0;}
@@ -504,6 +584,7 @@ void delete_all(int selected_only) {
   }
   if(!selected_only) {
     include_H_from_C = 1;
+    widget_tables = false;
     images_dir = ""; //"./";
   }
   selection_changed(0);
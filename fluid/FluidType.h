@@ -63,6 +63,7 @@ protected:
   const char *callback_;
   const char *user_data_;
   const char *user_data_type_;
+  const char *browser_title_; // cached for browser_title()
   fltk::Widget *live_widget;
 
 public:	// things that should not be public:
@@ -106,6 +107,8 @@ public:
   void move_before(FluidType*); // move before a sibling
 
   virtual const char *title(); // string for browser
+  const char *browser_title(); // title() as shown in the browser
+  void changed(); // call when title() changes, redraws this row
   virtual const char *type_name() const = 0; // type for code output
 
   const char *name() const {return name_;}
@@ -179,6 +182,7 @@ void selection_changed(FluidType* new_current);
 FLUID_API void write_word(const char *);
 FLUID_API void write_string(const char *,...);
 FLUID_API int write_file(const char *, int selected_only = 0);
+FLUID_API const char *write_memory(int *length);
 FLUID_API int write_code(const char *cfile, const char *hfile);
 
 FLUID_API int write_declare(const char *, ...);
@@ -195,11 +199,13 @@ FLUID_API void write_indent(int n);
 FLUID_API void write_open(int);
 FLUID_API void write_close(int n);
 FLUID_API extern int write_number;
+FLUID_API extern int write_changed_only; // leave files that would not change
 FLUID_API void write_public(int state); // writes pubic:/private: as needed
 FLUID_API extern int indentation;
 FLUID_API extern const char* indent();
 
 FLUID_API int read_file(const char *, int merge);
+FLUID_API int read_memory(const char *data, int length);
 FLUID_API const char *read_word(int wantbrace = 0);
 FLUID_API void read_error(const char *format, ...);
 
@@ -212,9 +218,11 @@ FLUID_API const char *c_check(const char *c, int type = 0);
 FLUID_API int storestring(const char *n, const char * & p, int nostrip=0);
 
 FLUID_API extern bool include_H_from_C;
+FLUID_API extern bool widget_tables; // write windows as fltk::WidgetDescriptor tables
 FLUID_API void select(FluidType* it, int value);
 FLUID_API void select_only(FluidType *);
 FLUID_API void refresh_browser_views();
+FLUID_API void update_status_bar();
 FLUID_API void initialize_tab_colors();
 
 extern int modflag;
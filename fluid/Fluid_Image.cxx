@@ -320,6 +320,14 @@ Fluid_Image* Fluid_Image::find(const char *name) {
   return ret;
 }
 
+int Fluid_Image::count() {
+  return numimages;
+}
+
+Fluid_Image* Fluid_Image::image(int i) {
+  return images[i];
+}
+
 Fluid_Image::Fluid_Image(const char *name) {
   name_ = strdup(name);
   written = 0;
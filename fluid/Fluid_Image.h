@@ -47,6 +47,8 @@ public:
   bool inlined;
   int written;
   static Fluid_Image* find(const char *);
+  static int count();		// number of images in use
+  static Fluid_Image* image(int i);	// one of them, sorted by name
   void decrement(); // reference counting & automatic free
   void increment();
   virtual const fltk::Symbol* symbol() = 0; // return the fltk Symbol object
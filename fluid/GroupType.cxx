@@ -199,7 +199,7 @@ void GroupType::write_code() {
   write_code1();
   if (first_child) {
     write_c("%so->begin();\n", indent());
-    for (FluidType* q = first_child; q; q = q->next_brother) q->write_code();
+    write_children_code();
     write_c("%so->end();\n", indent());
   }
   write_extra_code();
@@ -196,9 +196,8 @@ void WidgetType::extra_code(const char *n) {
   storestring(n,extra_code_);
 }
 
-extern void redraw_browser();
 void WidgetType::user_class(const char *n) {
-  if (storestring(n,user_class_)) redraw_browser();
+  if (storestring(n,user_class_)) changed();
 }
 
 void WidgetType::redraw() {
@@ -1290,6 +1289,7 @@ void subtype_cb(fltk::Choice* i, void* v) {
       if (q->subtypes()==table) {
         q->o->type(n);
         q->redraw();
+        q->changed(); // subclass() may be different
       }
     }
   }
@@ -1546,6 +1546,8 @@ void WidgetType::write_static() {
   if (!user_class() || !strncmp(subclass, "fltk::", 6)) 
     ::write_declare("#include <fltk/%s.h>", subclass+6);
   if (extra_code()) write_includes_from_code((char*)extra_code());
+  if (widget_tables && table_ok())
+    ::write_declare("#include <fltk/WidgetTable.h>");
   if (callback()) {
     if (is_name(callback()))
       ::write_declare("extern void %s(%s*, %s);", callback(), subclass,
@@ -1617,6 +1619,17 @@ const char *FluidType::callback_name() {
   return unique_id(this, "cb", name(), label());
 }
 
+// Declare the functions write_static() makes for a callback of a class member:
+void WidgetType::write_member_callback() {
+  if (callback() && !is_name(callback())) {
+    const char* cn = callback_name();
+    const char* ut = user_data_type() ? user_data_type() : "void*";
+    write_public(0);
+    write_h("%sinline void %s_i(%s*, %s);\n", indent(), cn, subclass(), ut);
+    write_h("%sstatic void %s(%s*, %s);\n", indent(), cn, subclass(), ut);
+  }
+}
+
 extern int varused_test, varused;
 extern WidgetType* last_group;
   
@@ -1630,13 +1643,7 @@ void WidgetType::write_code1() {
       write_h("%s%s *%s;\n", indent(), subclass, array_name);
     }
   }
-  if (member_of && callback() && !is_name(callback())) {
-    const char* cn = callback_name();
-    const char* ut = user_data_type() ? user_data_type() : "void*";
-    write_public(0);
-    write_h("%sinline void %s_i(%s*, %s);\n", indent(), cn, subclass, ut);
-    write_h("%sstatic void %s(%s*, %s);\n", indent(), cn, subclass, ut);
-  }
+  if (member_of) write_member_callback();
   // figure out if local variable will be used (prevent compiler warnings):
   if (is_parent() || extra_code())
     varused = 1;
@@ -1803,6 +1810,227 @@ void WidgetType::write_block_close() {
   if (is_parent() || varused) write_c("%s}\n", indent());
 }
 
+////////////////////////////////////////////////////////////////
+// With widget_tables on, the children of a group that only set the
+// things an fltk::WidgetDescriptor has room for are written as a table
+// and one call to fltk::build_widgets(), instead of code for each one.
+
+// Return true if this and everything inside it can be table rows:
+bool WidgetType::table_ok() {
+  if (is_window() || is_menu_item() || user_class() || extra_code() ||
+      image || user_data() || hotspot() || this == last_group)
+    return false;
+  // the table can only point at a variable that has a fixed address:
+  if (name() && (member_of() || !is_name(name()))) return false;
+  if (is_parent()) {
+    if (!is_group()) return false; // menus
+    for (FluidType* q = first_child; q; q = q->next_brother)
+      if (!q->is_widget() || !((WidgetType*)q)->table_ok()) return false;
+  }
+  fltk::Widget* tplate = ((WidgetType*)factory)->o;
+  if (is_valuator()) {
+    fltk::Valuator* v = (fltk::Valuator*)o;
+    fltk::Valuator* f = (fltk::Valuator*)(tplate);
+    if (v->minimum()!=f->minimum() || v->maximum()!=f->maximum() ||
+	v->step()!=f->step() ||
+	v->linesize_setting()!=f->linesize_setting() || v->value())
+      return false;
+    if (is_valuator()==2 &&
+	((fltk::Slider*)v)->slider_size() != ((fltk::Slider*)f)->slider_size())
+      return false;
+  }
+  // a zero in the table means the default, so it cannot set a zero:
+  if ((o->color() != tplate->color() && !o->color()) ||
+      (o->textcolor() != tplate->textcolor() && !o->textcolor()) ||
+      (o->selection_color() != tplate->selection_color() && !o->selection_color()) ||
+      (o->selection_textcolor() != tplate->selection_textcolor() && !o->selection_textcolor()) ||
+      (o->buttoncolor() != tplate->buttoncolor() && !o->buttoncolor()) ||
+      (o->labelcolor() != tplate->labelcolor() && !o->labelcolor()) ||
+      (o->highlight_color() != tplate->highlight_color() && !o->highlight_color()) ||
+      (o->highlight_textcolor() != tplate->highlight_textcolor() && !o->highlight_textcolor()) ||
+      (o->labelsize() != tplate->labelsize() && !o->labelsize()) ||
+      (o->textsize() != tplate->textsize() && !o->textsize()))
+    return false;
+  return true;
+}
+
+// How many rows this and its descendants take:
+int WidgetType::table_rows() {
+  int n = 1;
+  for (FluidType* q = first_child; q; q = q->next_brother)
+    n += ((WidgetType*)q)->table_rows();
+  return n;
+}
+
+enum {
+  ROW_MAKE, ROW_X, ROW_Y, ROW_W, ROW_H, ROW_LABEL, ROW_DESCENDANTS,
+  ROW_POINTER, ROW_CALLBACK, ROW_TOOLTIP, ROW_FLAGS, ROW_TYPE, ROW_ALIGN,
+  ROW_WHEN, ROW_SHORTCUT, ROW_BOX, ROW_BUTTONBOX, ROW_LABELFONT,
+  ROW_TEXTFONT, ROW_LABELTYPE, ROW_COLOR,
+  ROW_FIELDS = ROW_COLOR+10 // 8 colors, labelsize, textsize
+};
+
+static char row_text[ROW_FIELDS][128];
+static const char* row_field[ROW_FIELDS];
+
+static void row_color(int i, fltk::Color c, fltk::Color t) {
+  if (c == t) return;
+  if (c > 255) sprintf(row_text[i], "0x%x", c);
+  else sprintf(row_text[i], "%u", c);
+  row_field[i] = row_text[i];
+}
+
+// Write this as one line of the table, and then its descendants. The
+// fields are in the order of fltk::WidgetDescriptor, and the zeros at
+// the end are left off:
+void WidgetType::write_table_row() {
+  fltk::Widget* tplate = ((WidgetType*)factory)->o;
+  if (member_of()) write_member_callback();
+  int i;
+  for (i = 0; i < ROW_FIELDS; i++) row_field[i] = 0;
+  const char* label_mark = row_text[ROW_LABEL];
+  const char* tooltip_mark = row_text[ROW_TOOLTIP];
+
+  sprintf(row_text[ROW_MAKE], "fltk::new_widget<%s>", subclass());
+  row_field[ROW_MAKE] = row_text[ROW_MAKE];
+  sprintf(row_text[ROW_X], "%d", o->x()); row_field[ROW_X] = row_text[ROW_X];
+  sprintf(row_text[ROW_Y], "%d", o->y()); row_field[ROW_Y] = row_text[ROW_Y];
+  sprintf(row_text[ROW_W], "%d", o->w()); row_field[ROW_W] = row_text[ROW_W];
+  sprintf(row_text[ROW_H], "%d", o->h()); row_field[ROW_H] = row_text[ROW_H];
+  if (label() && *label()) row_field[ROW_LABEL] = label_mark;
+  int n = table_rows()-1;
+  if (n) {
+    sprintf(row_text[ROW_DESCENDANTS], "%d", n);
+    row_field[ROW_DESCENDANTS] = row_text[ROW_DESCENDANTS];
+  }
+  if (name()) {
+    snprintf(row_text[ROW_POINTER], 128, "(fltk::Widget**)&%s", name());
+    row_field[ROW_POINTER] = row_text[ROW_POINTER];
+  }
+  if (callback()) {
+    snprintf(row_text[ROW_CALLBACK], 128, "(fltk::Callback*)%s", callback_name());
+    row_field[ROW_CALLBACK] = row_text[ROW_CALLBACK];
+  }
+
+  char flags[256]; flags[0] = 0;
+#define add_flag(FLAG) strcat(flags, *flags ? "|fltk::WidgetDescriptor::" FLAG \
+			      : "fltk::WidgetDescriptor::" FLAG)
+  if (o->type() != tplate->type()) {
+    add_flag("TYPE");
+    const Enumeration* e = subtypes();
+    if (e) e = from_value(o->type(), e);
+    if (e && e->symbol)
+      snprintf(row_text[ROW_TYPE], 128, "%s::%s", subclass(), e->symbol);
+    else
+      sprintf(row_text[ROW_TYPE], "%d", o->type());
+    row_field[ROW_TYPE] = row_text[ROW_TYPE];
+  }
+  if ((o->flags()&fltk::ALIGN_MASK) != (tplate->flags()&fltk::ALIGN_MASK)) {
+    add_flag("ALIGN");
+    fltk::Flags a = o->flags() & fltk::ALIGN_MASK;
+    char* p = row_text[ROW_ALIGN]; *p = 0;
+    for (int b = 0; b < 8; b++) if (a & (1<<b)) {
+      if (*p) strcat(p, "|");
+      strcat(p, number_to_text(1<<b, alignmenu));
+    }
+    if (!*p) strcpy(p, "fltk::ALIGN_CENTER");
+    row_field[ROW_ALIGN] = p;
+  }
+  if (o->when() != tplate->when()) {
+    add_flag("WHEN");
+    sprintf(row_text[ROW_WHEN], "fltk::WHEN_%s", number_to_text(o->when(), whenmenu));
+    row_field[ROW_WHEN] = row_text[ROW_WHEN];
+  }
+  if (o->state() && !tplate->state()) add_flag("STATE");
+  if (o->vertical()) add_flag("VERTICAL");
+  if (!o->visible() && o->parent()) add_flag("HIDE");
+  if (!o->active()) add_flag("DEACTIVATE");
+  if (resizable()) add_flag("RESIZABLE");
+#undef add_flag
+  if (*flags) {
+    strcpy(row_text[ROW_FLAGS], flags);
+    row_field[ROW_FLAGS] = row_text[ROW_FLAGS];
+  }
+  if (o->shortcut()) {
+    sprintf(row_text[ROW_SHORTCUT], "0x%x", o->shortcut());
+    row_field[ROW_SHORTCUT] = row_text[ROW_SHORTCUT];
+  }
+  if (tooltip() && *tooltip()) row_field[ROW_TOOLTIP] = tooltip_mark;
+
+  if (o->box() != tplate->box()) {
+    sprintf(row_text[ROW_BOX], "&fltk::%s", to_text((void*)(o->box()),boxmenu));
+    row_field[ROW_BOX] = row_text[ROW_BOX];
+  }
+  if (o->buttonbox() != tplate->buttonbox()) {
+    sprintf(row_text[ROW_BUTTONBOX], "&fltk::%s", to_text((void*)(o->buttonbox()),boxmenu));
+    row_field[ROW_BUTTONBOX] = row_text[ROW_BUTTONBOX];
+  }
+  if (o->labelfont() != tplate->labelfont()) {
+    sprintf(row_text[ROW_LABELFONT], "&fltk::%s", fontmenu[fontnumber(o->labelfont())].symbol);
+    row_field[ROW_LABELFONT] = row_text[ROW_LABELFONT];
+  }
+  if (o->textfont() != tplate->textfont()) {
+    sprintf(row_text[ROW_TEXTFONT], "&fltk::%s", fontmenu[fontnumber(o->textfont())].symbol);
+    row_field[ROW_TEXTFONT] = row_text[ROW_TEXTFONT];
+  }
+  if (o->labeltype() != tplate->labeltype()) {
+    sprintf(row_text[ROW_LABELTYPE], "&fltk::%s", to_text((void*)(o->labeltype()),labelstylemenu));
+    row_field[ROW_LABELTYPE] = row_text[ROW_LABELTYPE];
+  }
+  row_color(ROW_COLOR+0, o->color(), tplate->color());
+  row_color(ROW_COLOR+1, o->textcolor(), tplate->textcolor());
+  row_color(ROW_COLOR+2, o->selection_color(), tplate->selection_color());
+  row_color(ROW_COLOR+3, o->selection_textcolor(), tplate->selection_textcolor());
+  row_color(ROW_COLOR+4, o->buttoncolor(), tplate->buttoncolor());
+  row_color(ROW_COLOR+5, o->labelcolor(), tplate->labelcolor());
+  row_color(ROW_COLOR+6, o->highlight_color(), tplate->highlight_color());
+  row_color(ROW_COLOR+7, o->highlight_textcolor(), tplate->highlight_textcolor());
+  if (o->labelsize() != tplate->labelsize()) {
+    sprintf(row_text[ROW_COLOR+8], "%g", o->labelsize());
+    row_field[ROW_COLOR+8] = row_text[ROW_COLOR+8];
+  }
+  if (o->textsize() != tplate->textsize()) {
+    sprintf(row_text[ROW_COLOR+9], "%g", o->textsize());
+    row_field[ROW_COLOR+9] = row_text[ROW_COLOR+9];
+  }
+
+  int last = ROW_FIELDS;
+  while (!row_field[last-1]) last--;
+  indentation += 4;
+  write_c("%s{", indent());
+  indentation -= 4;
+  for (i = 0; i < last; i++) {
+    if (i) write_c(", ");
+    if (!row_field[i]) write_c("0");
+    else if (row_field[i] == label_mark) write_cstring(label());
+    else if (row_field[i] == tooltip_mark) write_cstring(tooltip());
+    else write_c("%s", row_field[i]);
+  }
+  write_c("},\n");
+  for (FluidType* q = first_child; q; q = q->next_brother)
+    ((WidgetType*)q)->write_table_row();
+}
+
+void WidgetType::write_children_code() {
+  for (FluidType* q = first_child; q;) {
+    if (!widget_tables || !q->is_widget() || !((WidgetType*)q)->table_ok()) {
+      q->write_code();
+      q = q->next_brother;
+      continue;
+    }
+    write_c("%s%sstatic const fltk::WidgetDescriptor widgets[] = {\n",
+	    indent(), get_opening_brace(0));
+    for (; q && q->is_widget() && ((WidgetType*)q)->table_ok(); q = q->next_brother)
+      ((WidgetType*)q)->write_table_row();
+    indentation += 2;
+    write_c("%s};\n", indent());
+    write_c("%sfltk::build_widgets(widgets, sizeof(widgets)/sizeof(*widgets));\n",
+	    indent());
+    indentation -= 2;
+    write_c("%s}\n", indent());
+  }
+}
+
 void WidgetType::write_code() {
   write_code1();
   for (FluidType* q = first_child; q; q = q->next_brother) q->write_code();
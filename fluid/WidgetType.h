@@ -22,6 +22,11 @@ protected:
   void write_widget_code();
   void write_extra_code();
   void write_block_close();
+  void write_children_code();
+  bool table_ok();
+  int table_rows();
+  void write_table_row();
+  void write_member_callback();
 
 public:
 
@@ -54,6 +54,7 @@
 using namespace fltk;
 
 bool include_H_from_C = true;
+bool widget_tables = false;
 
 
 void alignment_cb(fltk::Input *i, long v) {
@@ -77,6 +78,7 @@ void set_preferences_window(){
     }
   read_alignment_prefs();
   include_H_from_C_button->value(include_H_from_C);
+  widget_tables_button->value(widget_tables);
   header_file_input->value(header_file_name);
   code_file_input->value(code_file_name);
   char buf[128];
@@ -111,6 +113,10 @@ void include_H_from_C_button_cb(fltk::CheckButton* b, void*) {
   include_H_from_C = b->value();
 }
 
+void widget_tables_button_cb(fltk::CheckButton* b, void*) {
+  widget_tables = b->value();
+}
+
 ////////////////////////////////////////////////////////////////
 
 const char* WindowType::type_name() const {return "fltk::Window";}
@@ -713,7 +719,7 @@ void WindowType::write_code() {
   WidgetType::write_code1();
   if (first_child) {
     write_c("%so->begin();\n", indent());
-    for (FluidType* q = first_child; q; q = q->next_brother) q->write_code();
+    write_children_code();
     write_c("%so->end();\n", indent());
   }
   write_extra_code();
@@ -56,6 +56,8 @@ fltk::Input *code_file_input=(fltk::Input *)0;
 
 fltk::CheckButton *include_H_from_C_button=(fltk::CheckButton *)0;
 
+fltk::CheckButton *widget_tables_button=(fltk::CheckButton *)0;
+
 fltk::Input *horizontal_input=(fltk::Input *)0;
 
 fltk::Input *vertical_input=(fltk::Input *)0;
@@ -129,6 +131,11 @@ fltk::Window* make_preferences_window() {
          {fltk::CheckButton* o = include_H_from_C_button = new fltk::CheckButton(16, 84, 170, 22, "#include \"header\" in code");
           o->set_flag(fltk::STATE);
           o->callback((fltk::Callback*)include_H_from_C_button_cb);
+        }
+         {fltk::CheckButton* o = widget_tables_button = new fltk::CheckButton(16, 108, 170, 22, "Write widgets as tables");
+          o->callback((fltk::Callback*)widget_tables_button_cb);
+          o->tooltip("Write plain widgets as tables for fltk::build_widgets(), which is smaller and\
+ faster for big windows");
         }
         o->end();
       }
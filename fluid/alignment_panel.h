@@ -28,6 +28,8 @@ extern void code_input_cb(fltk::Input*, void*);
 extern fltk::Input* code_file_input;
 extern void include_H_from_C_button_cb(fltk::CheckButton*, void*);
 extern fltk::CheckButton* include_H_from_C_button;
+extern void widget_tables_button_cb(fltk::CheckButton*, void*);
+extern fltk::CheckButton* widget_tables_button;
 extern void alignment_cb(fltk::Input*, long);
 extern fltk::Input* horizontal_input;
 extern fltk::Input* vertical_input;
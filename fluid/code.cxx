@@ -32,12 +32,59 @@
 #include <stdarg.h>
 
 #include <fltk/run.h>
+#include <fltk/string.h>
 #include "FluidType.h"
 #include "alignment_panel.h"
 #include "coding_style.h"
 
-static FILE *code_file;
-static FILE *header_file;
+// The code and header are generated into these buffers and each is
+// written to its file at once when done:
+struct OutBuffer {
+  char *data;
+  int length, size;
+};
+static OutBuffer code_buffer, header_buffer;
+static OutBuffer *code_file;
+static OutBuffer *header_file;	// same as code_file if both go to stdout
+
+static void out_reserve(OutBuffer *b, int n) {
+  if (b->length + n <= b->size) return;
+  do {b->size = b->size ? 2*b->size : 64*1024;} while (b->length + n > b->size);
+  b->data = (char*)realloc(b->data, b->size);
+}
+
+static inline void out_char(OutBuffer *b, int c) {
+  if (b->length >= b->size) out_reserve(b, 1);
+  b->data[b->length++] = c;
+}
+
+static void out_string(OutBuffer *b, const char *s) {
+  int n = strlen(s);
+  out_reserve(b, n);
+  memcpy(b->data+b->length, s, n);
+  b->length += n;
+}
+
+// Format into the buffer, or make it larger and return false if it
+// did not fit, so the caller can try again with a new va_list:
+static bool out_format(OutBuffer *b, const char *format, va_list args) {
+  out_reserve(b, 256);
+  int room = b->size - b->length;
+  int n = vsnprintf(b->data+b->length, room, format, args);
+  if (n >= 0 && n < room) {b->length += n; return true;}
+  out_reserve(b, n >= 0 ? n+1 : 2*room);
+  return false;
+}
+
+static void out_printf(OutBuffer *b, const char *format, ...) {
+  va_list args;
+  bool done;
+  do {
+    va_start(args, format);
+    done = out_format(b, format, args);
+    va_end(args);
+  } while (!done);
+}
 
 using namespace fltk;
 
@@ -141,7 +188,8 @@ int write_declare(const char *format, ...) {
     else if (i < 0) p = &((*p)->left);
     else p  = &((*p)->right);
   }
-  fprintf(header_file,"%s\n",buf);
+  out_string(header_file, buf);
+  out_char(header_file, '\n');
   *p = new included(buf);
   return 1;
 }
@@ -159,7 +207,7 @@ void write_cstring(const char *w, int length) {
   if (varused_test) return;
   const char *e = w+length;
   int linelength = 1;
-  putc('\"', code_file);
+  out_char(code_file, '\"');
   for (; w < e;) {
     int c = *w++;
     switch (c) {
@@ -172,9 +220,9 @@ void write_cstring(const char *w, int length) {
     //case '\'':
     case '\\':
     QUOTED:
-      if (linelength >= 77) {fputs("\\\n",code_file); linelength = 0;}
-      putc('\\', code_file);
-      putc(c, code_file);
+      if (linelength >= 77) {out_string(code_file, "\\\n"); linelength = 0;}
+      out_char(code_file, '\\');
+      out_char(code_file, c);
       linelength += 2;
       break;
     case '?': // prevent trigraphs by writing ?? as ?\?
@@ -183,24 +231,24 @@ void write_cstring(const char *w, int length) {
     default:
       if (c >= ' ' && c < 127) {
 	// a legal ASCII character
-	if (linelength >= 78) {fputs("\\\n",code_file); linelength = 0;}
-	putc(c, code_file);
+	if (linelength >= 78) {out_string(code_file, "\\\n"); linelength = 0;}
+	out_char(code_file, c);
 	linelength++;
 	break;
       }
       // otherwise we must print it as an octal constant:
       c &= 255;
       if (c < 8) {
-	if (linelength >= 76) {fputs("\\\n",code_file); linelength = 0;}
-	fprintf(code_file, "\\%o",c);
+	if (linelength >= 76) {out_string(code_file, "\\\n"); linelength = 0;}
+	out_printf(code_file, "\\%o",c);
 	linelength += 2;
       } else if (c < 64) {
-	if (linelength >= 75) {fputs("\\\n",code_file); linelength = 0;}
-	fprintf(code_file, "\\%o",c);
+	if (linelength >= 75) {out_string(code_file, "\\\n"); linelength = 0;}
+	out_printf(code_file, "\\%o",c);
 	linelength += 3;
       } else {
-	if (linelength >= 74) {fputs("\\\n",code_file); linelength = 0;}
-	fprintf(code_file, "\\%o",c);
+	if (linelength >= 74) {out_string(code_file, "\\\n"); linelength = 0;}
+	out_printf(code_file, "\\%o",c);
 	linelength += 4;
       }
       // We must not put more numbers after it, because some C compilers
@@ -208,14 +256,14 @@ void write_cstring(const char *w, int length) {
       // pasting to avoid this:
       c = *w;
       if (w < e && ((c>='0'&&c<='9') || (c>='a'&&c<='f') || (c>='A'&&c<='F'))) {
-	putc('\"', code_file); linelength++;
-	if (linelength >= 79) {fputs("\n",code_file); linelength = 0;}
-	putc('\"', code_file); linelength++;
+	out_char(code_file, '\"'); linelength++;
+	if (linelength >= 79) {out_string(code_file, "\n"); linelength = 0;}
+	out_char(code_file, '\"'); linelength++;
       }
       break;
     }
   }
-  putc('\"', code_file);
+  out_char(code_file, '\"');
 }
 
 // write an array of C characters in a decimal format
@@ -227,10 +275,10 @@ void write_carray(const char *w, int length) {
   const char *e = w+length;
   int linelength = 1;
   for (; w < e;) {
-    if (linelength >= 75) {fputs("\n",code_file); linelength = 0;}
+    if (linelength >= 75) {out_string(code_file, "\n"); linelength = 0;}
     int c = (uchar)*w++;
-    fprintf(code_file, "%d", c);
-    if (w < e) fputc(',',code_file);
+    out_printf(code_file, "%d", c);
+    if (w < e) out_char(code_file, ',');
     linelength+=2;
     if(c>=10) linelength++;
     if(c>=100) linelength++;
@@ -244,23 +292,29 @@ void write_carray(const char *w) {write_carray(w,strlen(w));}
 
 // write some raw data in the code file (used to write inlined XPM)
 void write_craw(const char* str) {
-  fputs(str, code_file);
+  out_string(code_file, str);
 }
 
 void write_c(const char* format,...) {
   if (varused_test) {varused = 1; return;}
   va_list args;
-  va_start(args, format);
-  vfprintf(code_file, format, args);
-  va_end(args);
+  bool done;
+  do {
+    va_start(args, format);
+    done = out_format(code_file, format, args);
+    va_end(args);
+  } while (!done);
 }
 
 void write_h(const char* format,...) {
   if (varused_test) return;
   va_list args;
-  va_start(args, format);
-  vfprintf(header_file, format, args);
-  va_end(args);
+  bool done;
+  do {
+    va_start(args, format);
+    done = out_format(header_file, format, args);
+    va_end(args);
+  } while (!done);
 }
 
 #include <fltk/filename.h>
@@ -269,6 +323,7 @@ void write_h(const char* format,...) {
 
 int write_number=0;
 int write_sourceview=0;
+int write_changed_only=0;
 
 /////////////////////////////////////////////////////////////////////
 // recursively dump code, putting children between the two parts
@@ -276,9 +331,9 @@ int write_sourceview=0;
 /////////////////////////////////////////////////////////////////////
 static FluidType* write_code(FluidType* p) {
   if (write_sourceview) {
-    p->code_line = (int)ftell(code_file);
+    p->code_line = code_file->length;
     if (p->header_line_end==-1)
-      p->header_line = (int)ftell(header_file);
+      p->header_line = header_file->length;
   }
   // write all code that come before the children code
   // (but don't write the last comment until the very end)
@@ -308,36 +363,57 @@ static FluidType* write_code(FluidType* p) {
     p->write_code();
   }
   if (write_sourceview) {
-    p->code_line_end = (int)ftell(code_file);
+    p->code_line_end = code_file->length;
     if (p->header_line_end==-1)
-      p->header_line_end = (int)ftell(header_file);
+      p->header_line_end = header_file->length;
   }
   return q;
 }
 /////////////////////////////////////////////////////////////////////
-int write_code(const char *s, const char *t) {
-  const char *filemode = write_sourceview ? "wb" : "w";
+// return true if the named file already contains exactly the buffer:
+static bool same_as_file(const OutBuffer *b, const char *name) {
+  FILE *f = fopen(name, write_sourceview ? "rb" : "r");
+  if (!f) return false;
+  char block[16*1024];
+  int at = 0;
+  bool same = true;
+  for (;;) {
+    int n = fread(block, 1, sizeof(block), f);
+    if (n <= 0) break;
+    if (at + n > b->length || memcmp(block, b->data+at, n)) {same = false; break;}
+    at += n;
+  }
+  if (ferror(f)) same = false;
+  fclose(f);
+  return same && at == b->length;
+}
 
+// write a buffer to the named file, or to stdout if name is null. With
+// write_changed_only a file that already has this text is not touched,
+// so its modification time stays and nothing that depends on it is
+// rebuilt:
+static int write_buffer(const OutBuffer *b, const char *name) {
+  if (!name) return fwrite(b->data, 1, b->length, stdout) == size_t(b->length);
+  if (write_changed_only && same_as_file(b, name)) return 1;
+  FILE *f = fopen(name, write_sourceview ? "wb" : "w");
+  if (!f) return 0;
+  int x = fwrite(b->data, 1, b->length, f) == size_t(b->length);
+  int y = fclose(f);
+  return x && y >= 0;
+}
+
+int write_code(const char *s, const char *t) {
   write_number++;
   delete id_root; id_root = 0;
   indentation = 0;
 
-  if (!s) code_file = stdout;
-  else {
-    FILE *f = fopen(s,filemode);	
-    if (!f) return 0;
-    code_file = f;
-  }
-  if (!t) header_file = stdout;
-  else {
-    FILE *f = fopen(t,filemode);
-    if (!f) {fclose(code_file); return 0;}
-    header_file = f;
-  }
+  code_file = &code_buffer;
+  header_file = (!s && !t) ? &code_buffer : &header_buffer;
+  code_buffer.length = header_buffer.length = 0;
   const char *hdr = "\
 // generated by Fast Light User Interface Designer (fluid) version %.4f\n\n";
-  fprintf(header_file, hdr, FL_VERSION);
-  fprintf(code_file, hdr, FL_VERSION);
+  out_printf(header_file, hdr, FL_VERSION);
+  out_printf(code_file, hdr, FL_VERSION);
 
   {char define_name[102];
   const char* a = filename_name(t);
@@ -345,8 +421,8 @@ int write_code(const char *s, const char *t) {
   if (!isalpha(*a)) {*b++ = '_';}
   while (*a) {*b++ = isalnum(*a) ? *a : '_'; a++;}
   *b = 0;
-  fprintf(header_file, "#ifndef %s\n", define_name);
-  fprintf(header_file, "#define %s\n", define_name);
+  out_printf(header_file, "#ifndef %s\n", define_name);
+  out_printf(header_file, "#define %s\n", define_name);
   }  
 
   if (t) {
@@ -358,14 +434,14 @@ int write_code(const char *s, const char *t) {
     // write all static data for this & all children first
     p->write_static();
     if (write_sourceview) {
-      p->header_line_end = (int)ftell(header_file);
+      p->header_line_end = header_file->length;
       if (p->header_line==p->header_line_end) p->header_line_end = -1;
     }
     for (FluidType* q = p->first_child; q; q = q->walk(p)) {
-      if (write_sourceview) q->header_line = (int)ftell(header_file);
+      if (write_sourceview) q->header_line = header_file->length;
       q->write_static();
       if (write_sourceview) {
-        q->header_line_end = (int)ftell(header_file);
+        q->header_line_end = header_file->length;
         if (q->header_line==q->header_line_end) q->header_line_end = -1;
       }
     }
@@ -375,13 +451,16 @@ int write_code(const char *s, const char *t) {
 
   delete included_root; included_root = 0;
 
-  if (!s) return 1;
-  int x = fclose(code_file);
-  code_file = 0;
-  fprintf(header_file, "#endif\n");
-  int y = fclose(header_file);
-  header_file = 0;
-  return x >= 0 && y >= 0;
+  if (!s) {
+    // as before, the header's #endif is left out when writing to stdout
+    int x = write_buffer(code_file, 0);
+    if (header_file != code_file) x = write_buffer(header_file, t) && x;
+    return x;
+  }
+  out_string(header_file, "#endif\n");
+  int x = write_buffer(code_file, s);
+  int y = write_buffer(header_file, t);
+  return x && y;
 }
 
 ////////////////////////////////////////////////////////////////
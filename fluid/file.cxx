@@ -36,6 +36,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <fltk/FL_VERSION.h>
+#include <fltk/string.h>
 
 #include "alignment_panel.h"
 #include "Fluid_Image.h"
@@ -46,6 +47,29 @@
 // BASIC FILE WRITING:
 
 static FILE *fout;
+static bool tomemory;	// write_memory() is putting the text in mout
+static char *mout;
+static int moutlen, moutsize;
+
+static void mout_reserve(int n) {
+  if (moutlen + n <= moutsize) return;
+  do {moutsize = moutsize ? 2*moutsize : 64*1024;} while (moutlen + n > moutsize);
+  mout = (char*)realloc(mout, moutsize);
+}
+
+static void out_char(int c) {
+  if (tomemory) {mout_reserve(1); mout[moutlen++] = c;}
+  else putc(c, fout);
+}
+
+static void out_string(const char *s) {
+  if (tomemory) {
+    int n = strlen(s);
+    mout_reserve(n);
+    memcpy(mout+moutlen, s, n);
+    moutlen += n;
+  } else fputs(s, fout);
+}
 
 #include <fltk/ask.h>
 int open_write(const char *s) {
@@ -70,13 +94,13 @@ int is_id(char); // in code.C
 
 // write a string, quoting characters if necessary:
 void write_word(const char *w) {
-  if (needspace) putc(' ', fout);
+  if (needspace) out_char(' ');
   needspace = 1;
-  if (!w || !*w) {fprintf(fout,"{}"); return;}
+  if (!w || !*w) {out_string("{}"); return;}
   const char *p;
   // see if it is a single word:
   for (p = w; is_id(*p); p++) ;
-  if (!*p) {fprintf(fout,"%s",w); return;}
+  if (!*p) {out_string(w); return;}
   // see if there are matching braces:
   int n = 0;
   for (p = w; *p; p++) {
@@ -85,7 +109,7 @@ void write_word(const char *w) {
   }
   int mismatched = (n != 0);
   // write out brace-quoted string:
-  putc('{', fout);
+  out_char('{');
   for (; *w; w++) {
     switch (*w) {
     case '{':
@@ -93,42 +117,52 @@ void write_word(const char *w) {
       if (!mismatched) break;
     case '\\':
     case '#':
-      putc('\\',fout);
+      out_char('\\');
       break;
     }
-    putc(*w,fout);
+    out_char(*w);
   }
-  putc('}', fout);
+  out_char('}');
 }
 
 // write an arbitrary formatted word, or a comment, etc:
 void write_string(const char *format, ...) {
   va_list args;
-  va_start(args, format);
-  if (needspace) fputc(' ',fout);
-  vfprintf(fout, format, args);
-  va_end(args);
+  if (needspace) out_char(' ');
+  if (tomemory) {
+    for (int room = 256;; room *= 2) {
+      mout_reserve(room);
+      va_start(args, format);
+      int n = vsnprintf(mout+moutlen, moutsize-moutlen, format, args);
+      va_end(args);
+      if (n >= 0 && n < moutsize-moutlen) {moutlen += n; break;}
+    }
+  } else {
+    va_start(args, format);
+    vfprintf(fout, format, args);
+    va_end(args);
+  }
   needspace = !isspace(format[strlen(format)-1]);
 }
 
 // start a new line and indent it for a given nesting level:
 void write_indent(int n) {
-  fputc('\n',fout);
-  while (n--) {fputc(' ',fout); fputc(' ',fout);}
+  out_char('\n');
+  while (n--) {out_char(' '); out_char(' ');}
   needspace = 0;
 }
 
 // write a '{' at the given indenting level:
 void write_open(int) {
-  if (needspace) fputc(' ',fout);
-  fputc('{',fout);
+  if (needspace) out_char(' ');
+  out_char('{');
   needspace = 0;
 }
 
 // write a '}' at the given indenting level:
 void write_close(int n) {
   if (needspace) write_indent(n);
-  fputc('}',fout);
+  out_char('}');
   needspace = 1;
 }
 
@@ -136,20 +170,50 @@ void write_close(int n) {
 // BASIC FILE READING:
 
 static FILE *fin;
+static const char *inptr, *inend;	// the bytes being read, unless from stdin
+static char *inbuffer;	// open_read() reads the whole file into this
+static int inbuffersize;
 static int lineno;
 static const char *fname;
 
+static int in_char() {
+  if (inptr) return inptr < inend ? (unsigned char)*inptr++ : -1;
+  return getc(fin);
+}
+
+static void in_unget(int c) {
+  if (inptr) {if (c >= 0) inptr--;}
+  else ungetc(c, fin);
+}
+
+// Files are read all at once, so the tokenizer does not have to go
+// through getc() for each character:
 int open_read(const char *s) {
   lineno = 1;
   if (!s) {fin = stdin; fname = "stdin"; return 1;}
   FILE *f = fopen(s,"r");
   if (!f) return 0;
-  fin = f;
+  int length = 0;
+  for (;;) {
+    if (length + 4096 > inbuffersize) {
+      inbuffersize = inbuffersize ? 2*inbuffersize : 64*1024;
+      inbuffer = (char*)realloc(inbuffer, inbuffersize);
+    }
+    int n = fread(inbuffer+length, 1, inbuffersize-length, f);
+    if (n <= 0) break;
+    length += n;
+  }
+  int error = ferror(f);
+  fclose(f);
+  if (error) return 0;
+  inptr = inbuffer;
+  inend = inbuffer+length;
   fname = s;
   return 1;
 }
 
 int close_read() {
+  if (inptr) {inptr = inend = 0; return 1;}
   if (fin != stdin) {
     int x = fclose(fin);
     fin = 0;
@@ -163,7 +227,7 @@ int close_read() {
 void read_error(const char *format, ...) {
   va_list args;
   va_start(args, format);
-  if (!fin) {
+  if (!fin && !inptr) {
     char buffer[1024];
     vsprintf(buffer, format, args);
     fltk::message(buffer);
@@ -185,7 +249,7 @@ static int hexdigit(int x) {
 
 static int read_quoted() {	// read whatever character is after a \ .
   int c,d,x;
-  switch(c = fgetc(fin)) {
+  switch(c = in_char()) {
   case '\n': lineno++; return -1;
   case 'a' : return('\a');
   case 'b' : return('\b');
@@ -196,9 +260,9 @@ static int read_quoted() {	// read whatever character is after a \ .
   case 'v' : return('\v');
   case 'x' :	/* read hex */
     for (c=x=0; x<3; x++) {
-      int ch = fgetc(fin);
+      int ch = in_char();
       d = hexdigit(ch);
-      if (d > 15) {ungetc(ch,fin); break;}
+      if (d > 15) {in_unget(ch); break;}
       c = (c<<4)+d;
     }
     break;
@@ -206,9 +270,9 @@ static int read_quoted() {	// read whatever character is after a \ .
     if (c<'0' || c>'7') break;
     c -= '0';
     for (x=0; x<2; x++) {
-      int ch = fgetc(fin);
+      int ch = in_char();
       d = hexdigit(ch);
-      if (d>7) {ungetc(ch,fin); break;}
+      if (d>7) {in_unget(ch); break;}
       c = (c<<3)+d;
     }
     break;
@@ -244,11 +308,11 @@ const char *read_word(int wantbrace) {
 
   // skip all the whitespace before it:
   for (;;) {
-    x = getc(fin);
+    x = in_char();
     if (x < 0) {	// eof
       return 0;
     } else if (x == '#') {	// comment
-      do x = getc(fin); while (x >= 0 && x != '\n');
+      do x = in_char(); while (x >= 0 && x != '\n');
       lineno++;
       continue;
     } else if (x == '\n') {
@@ -266,10 +330,10 @@ const char *read_word(int wantbrace) {
     int length = 0;
     int nesting = 0;
     for (;;) {
-      x = getc(fin);
+      x = in_char();
       if (x<0) {read_error("Missing '}'"); break;}
       else if (x == '#') { // embedded comment
-	do x = getc(fin); while (x >= 0 && x != '\n');
+	do x = in_char(); while (x >= 0 && x != '\n');
 	lineno++;
 	continue;
       } else if (x == '\n') lineno++;
@@ -297,9 +361,9 @@ const char *read_word(int wantbrace) {
       else if (x<0 || isspace(x) || x=='{' || x=='}' || x=='#') break;
       buffer[length++] = x;
       expand_buffer(length);
-      x = getc(fin);
+      x = in_char();
     }
-    ungetc(x, fin);
+    in_unget(x);
     buffer[length] = 0;
     return buffer;
 
@@ -321,13 +385,16 @@ extern const char* header_file_name;
 extern const char* code_file_name;
 extern char* theme;
 
-int write_file(const char *filename, int selected_only) {
-  if (!open_write(filename)) return 0;
+static void write_design(int selected_only) {
   write_string("# data file for the FLTK User Interface Designer (FLUID)\n"
 	       "version %.4f",FL_VERSION);
-  if (images_dir) write_string("\nimages_dir %s", images_dir);
+  if (images_dir && *images_dir) {
+    write_string("\nimages_dir"); write_word(images_dir);
+  }
   if(!include_H_from_C)
     write_string("\ndo_not_include_H_from_C");
+  if (widget_tables)
+    write_string("\nwidget_tables");
   if (!selected_only) {
     write_string("\nheader_name"); write_word(header_file_name);
     write_string("\ncode_name"); write_word(code_file_name);
@@ -345,9 +412,27 @@ int write_file(const char *filename, int selected_only) {
       p = p->walk();
     }
   }
+}
+
+int write_file(const char *filename, int selected_only) {
+  if (!open_write(filename)) return 0;
+  write_design(selected_only);
   return close_write();
 }
 
+// Write the whole design into memory instead of a file, as the undo
+// checkpoints do. Returns the bytes, which are only good until the
+// next call, and puts how many there are in length.
+const char *write_memory(int *length) {
+  tomemory = true;
+  moutlen = 0;
+  needspace = 0;
+  write_design(0);
+  tomemory = false;
+  *length = moutlen;
+  return mout;
+}
+
 ////////////////////////////////////////////////////////////////
 // read all the objects out of the input file:
 
@@ -401,6 +486,11 @@ static void read_children(FluidType *p, int paste) {
       include_H_from_C=0;
       goto CONTINUE;
     }
+    if (!strcmp(c,"widget_tables"))
+    {
+      widget_tables=true;
+      goto CONTINUE;
+    }
     if (!strcmp(c,"images_dir"))
     {
       images_dir = strdup(read_word()); // This will never get deleted ...
@@ -473,10 +563,8 @@ static void read_children(FluidType *p, int paste) {
 
 extern void deselect();
 
-int read_file(const char *filename, int merge) {
+static void read_design(int merge) {
   FluidType* parent = merge ? FluidType::current : 0;
-  read_version = 0.0;
-  if (!open_read(filename)) return 0;
   if (merge) deselect();
   else delete_all();
   read_children(parent, merge);
@@ -485,6 +573,24 @@ int read_file(const char *filename, int merge) {
     if (o->selected()) {
       FluidType::current = o; break;
     }
+}
+
+int read_file(const char *filename, int merge) {
+  read_version = 0.0;
+  if (!open_read(filename)) return 0;
+  read_design(merge);
+  return close_read();
+}
+
+// Replace the design with one written by write_memory().
+int read_memory(const char *data, int length) {
+  read_version = 0.0;
+  lineno = 1;
+  fname = "undo buffer";
+  if (!data) data = "";
+  inptr = data;
+  inend = data+length;
+  read_design(0);
   return close_read();
 }
 
@@ -497,7 +603,7 @@ int read_fdesign_line(const char*& name, const char*& value) {
   int x;
   // find a colon:
   for (;;) {
-    x = getc(fin);
+    x = in_char();
     if (x < 0) return 0;
     if (x == '\n') {length = 0; continue;} // no colon this line...
     if (!isspace(x)) {
@@ -511,7 +617,7 @@ int read_fdesign_line(const char*& name, const char*& value) {
 
   // skip to start of value:
   for (;;) {
-    x = getc(fin);
+    x = in_char();
     if (x < 0 || x == '\n' || !isspace(x)) break;
   }
 
@@ -521,7 +627,7 @@ int read_fdesign_line(const char*& name, const char*& value) {
     else if (x == '\n') break;
     buffer[length++] = x;
     expand_buffer(length);
-    x = getc(fin);
+    x = in_char();
   }
   buffer[length] = 0;
   name = buffer;
@@ -87,6 +87,7 @@ const char *copyright =
 #else
 # include <unistd.h>
 # include <sys/stat.h>
+# include <sys/wait.h>
 #endif
 
 #include "about_panel.h"
@@ -99,6 +100,7 @@ const char *copyright =
 #include "Fluid_Plugins.h"
 #include "FluidType.h"
 #include "WidgetType.h"
+#include "Fluid_Image.h"
 #include "coding_style.h"
 #include "fluid_menus.h"
 #include "undo.h"
@@ -672,6 +674,48 @@ int code_file_set = 0;
 const char* header_file_name = ".h";
 const char* code_file_name = ".cxx";
 
+int write_dependencies = 0;
+
+// write a name for a makefile, with spaces quoted:
+static void write_make_name(FILE* f, const char* name) {
+  for (; *name; name++) {
+    if (*name == ' ' || *name == '#') putc('\\', f);
+    else if (*name == '$') putc('$', f);
+    putc(*name, f);
+  }
+}
+
+// With -d, write name.d next to the code file saying that the code and
+// header depend on the .fl file and the image files it uses:
+static int write_depfile(const char* cname, const char* hname) {
+  char dname[1024];
+  strlcpy(dname, cname, 1024);
+  *filename_ext(dname) = 0;
+  strlcat(dname, ".d", 1024);
+  FILE* f = fopen(dname, "w");
+  if (!f) return 0;
+  write_make_name(f, cname); putc(' ', f);
+  write_make_name(f, hname); fputs(":", f);
+  fputs(" ", f); write_make_name(f, filename);
+  int n = Fluid_Image::count();
+  int i;
+  for (i = 0; i < n; i++) {
+    const char* realname =
+      SharedImage::get_filename(Fluid_Image::image(i)->name());
+    if (access(realname, 0)) continue;
+    fputs(" \\\n  ", f); write_make_name(f, realname);
+  }
+  fputs("\n", f);
+  // empty rules so make does not fail if an image is removed:
+  for (i = 0; i < n; i++) {
+    const char* realname =
+      SharedImage::get_filename(Fluid_Image::image(i)->name());
+    if (access(realname, 0)) continue;
+    fputs("\n", f); write_make_name(f, realname); fputs(":\n", f);
+  }
+  return fclose(f) >= 0;
+}
+
 void write_cb(Widget *, void *) {
     if (!filename) {
 	save_cb(0,0);
@@ -694,6 +738,7 @@ void write_cb(Widget *, void *) {
 	strcpy(hname, header_file_name);
     }
     int x = write_code(cname,hname);
+    if (x && compile_only && write_dependencies) x = write_depfile(cname,hname);
     strcat(cname, "/"); strcat(cname,header_file_name);
     if (compile_only) {
 	if (!x) {fprintf(stderr,"%s : %s\n",cname,strerror(errno)); exit(1);}
@@ -1330,8 +1375,17 @@ void update_history(const char *flname) {
 }
 ////////////////////////////////////////////////////////////////
 
+static int jobs = 1;
+
 static int arg(int argc, char** argv, int& i) {
     if (argv[i][1] == 'c' && !argv[i][2]) {compile_only = 1; i++; return 1;}
+    if (argv[i][1] == 'u' && !argv[i][2]) {write_changed_only = 1; i++; return 1;}
+    if (argv[i][1] == 'd' && !argv[i][2]) {write_dependencies = 1; i++; return 1;}
+    if (argv[i][1] == 'j' && !argv[i][2] && i+1 < argc) {
+	jobs = atoi(argv[i+1]);
+	i += 2;
+	return 2;
+    }
     if (argv[i][1] == 'o' && !argv[i][2] && i+1 < argc) {
 	code_file_name = argv[i+1];
 	code_file_set  = 1;
@@ -1368,11 +1422,64 @@ extern "C" {
 }
 #endif
 
+// Read one file and write its code, for compile_files():
+static int compile_file(const char* c) {
+  if (!header_file_set) header_file_name = ".h";
+  if (!code_file_set) code_file_name = ".cxx";
+  set_filename(c);
+  Undo::suspend();
+  int x = read_file(c,0);
+  Undo::resume();
+  if (!x) {
+    fprintf(stderr,"%s : %s\n", c, strerror(errno));
+    return 1;
+  }
+  write_cb(0,0);
+  return 0;
+}
+
+// Write the code for each of several files with -c. The designs are
+// in global variables, so instead of threads this forks a process for
+// each of the -j jobs, and each of them does every jobs'th file.
+static int compile_files(char** files, int n) {
+  int failed = 0;
+  int f;
+#if !defined(_WIN32) || defined(__CYGWIN__)
+  if (jobs > n) jobs = n;
+  if (jobs > 1) {
+    fflush(stdout); fflush(stderr);
+    int k;
+    for (k = 0; k < jobs; k++) {
+      pid_t pid = fork();
+      if (pid < 0) break;
+      if (!pid) {
+	for (f = k; f < n; f += jobs) failed |= compile_file(files[f]);
+	exit(failed);
+      }
+    }
+    // if fork() failed, do the files of the jobs that did not start here:
+    for (int j = k; j < jobs; j++)
+      for (f = j; f < n; f += jobs) failed |= compile_file(files[f]);
+    while (k--) {
+      int status;
+      if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+	failed = 1;
+    }
+    return failed;
+  }
+#endif
+  for (f = 0; f < n; f++) failed |= compile_file(files[f]);
+  return failed;
+}
+
 int main(int argc,char **argv) {
   int i = 1;
-  if (!args(argc,argv,i,::arg) || i < argc-1) {
-    fprintf(stderr,"usage: %s <switches> name.fl\n"
-	    " -c : write .cxx and .h and exit\n"
+  if (!args(argc,argv,i,::arg) || (i < argc-1 && !compile_only)) {
+    fprintf(stderr,"usage: %s <switches> name.fl ...\n"
+	    " -c : write .cxx and .h and exit, for each name.fl\n"
+	    " -j <n> : with -c, compile the files in n processes\n"
+	    " -u : with -c, don't rewrite .cxx and .h files that would not change\n"
+	    " -d : with -c, also write a makefile dependency list name.d\n"
 	    " -o <name> : .cxx output filename, or extension if <name> starts with '.'\n"
 	    " -h <name> : .h output filename, or extension if <name> starts with '.'\n"
 	    "%s\n", argv[0], help);
@@ -1393,6 +1500,8 @@ int main(int argc,char **argv) {
   make_main_window();
   load_coding_style();
 
+  if (compile_only && i < argc-1) return compile_files(argv+i, argc-i);
+
   if (c) set_filename(c);
   if (!compile_only) {
     visual(DOUBLE_BUFFER|INDEXED_COLOR);
@@ -26,50 +26,114 @@
 //
 
 //#include <fltk/run.h>
-#include <fltk/Preferences.h>
-#include <fltk/string.h>
 #include <fltk/MenuBar.h>
 #include <fltk/Item.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "PrefsData.h"
 #include "FluidType.h"
 #include "undo.h"
 
-#if defined(WIN32) && !defined(__CYGWIN__)
-#  include <io.h>
-#  include <windows.h>
-#  define getpid (int)GetCurrentProcessId
-// Visual C++ 2005 incorrectly displays a warning about the use of POSIX APIs
-// on Windows, which is supposed to be POSIX compliant...
-#  define unlink _unlink
-#else
-#  include <unistd.h>
-#endif // WIN32 && !__CYGWIN__
-
-
 extern fltk::Item*  undo_item[2];
 const int UNDO_ITEM=0;
 const int REDO_ITEM=1;
 
 //
-// This file implements an undo system using temporary files; ideally
-// we'd like to do this in memory, however the current data structures
-// and design aren't well-suited...  Instead, we save and restore
-// checkpoint files.
+// This file implements an undo system using checkpoints of the whole
+// design, written with write_memory() and read back with read_memory().
+// Only the text of one level, the one last written or read, is kept
+// whole. Every other level is stored as the bytes that differ from the
+// level before it, between the start and end they have in common, in
+// both versions, so it can be applied in either direction. A change to
+// one widget of a large design only stores that widget's lines.
 //
 int Undo::current = 0;
 int Undo::last = 0;
-int Undo::max = 0;
 int Undo::save = -1;			// Last undo level that was saved
-char Undo::path[1024]="";
 bool Undo::paused=false;
 
-// Return the undo filename
-const char *Undo::filename(int level, char *buf, int bufsize) {
+// Most bytes kept for the differences before the oldest levels are lost:
+#define UNDO_MEMORY (32*1024*1024)
+
+struct UndoStep {
+  int prefix;		// bytes at the start that are the same
+  int nold, nnew;	// bytes that differ in the level before and this one
+  char *data;		// nold bytes then nnew bytes
+};
+
+static UndoStep *steps;		// steps[i] turns level i-1 into level i
+static int nsteps, stepsize;	// levels 0..nsteps-1 are stored
+static int stepbytes;		// memory used by the steps
+static char *text;		// the whole text of level at
+static int textlen, textsize;
+static int at = -1;
+
+// replace nremove bytes of text at pos with n bytes from s:
+static void splice(int pos, int nremove, const char *s, int n) {
+  if (textlen - nremove + n > textsize) {
+    do {textsize = textsize ? 2*textsize : 64*1024;}
+    while (textlen - nremove + n > textsize);
+    text = (char*)realloc(text, textsize);
+  }
+  memmove(text+pos+n, text+pos+nremove, textlen-pos-nremove);
+  memcpy(text+pos, s, n);
+  textlen += n - nremove;
+}
+
+// change text to level n:
+static void seek(int n) {
+  while (at > n) {
+    UndoStep &s = steps[at--];
+    splice(s.prefix, s.nnew, s.data, s.nold);
+  }
+  while (at < n) {
+    UndoStep &s = steps[++at];
+    splice(s.prefix, s.nold, s.data+s.nold, s.nnew);
+  }
+}
+
+// throw away levels n and up:
+static void truncate(int n) {
+  for (int i = n > 1 ? n : 1; i < nsteps; i++) {
+    stepbytes -= steps[i].nold + steps[i].nnew;
+    free(steps[i].data);
+  }
+  if (n < nsteps) nsteps = n;
+  if (at >= nsteps) at = -1;
+}
 
-  if (!path[0]) prefs.getUserdataPath(path, sizeof(path));
-  snprintf(buf, bufsize, "%sundo_%d_%d.fl", path, getpid(), level);
-  return buf;
+// make the design in d be level n, throwing away the ones after it:
+static void store(int n, const char *d, int length) {
+  if (n > nsteps) n = nsteps;
+  if (n > 0) {
+    seek(n-1);
+    int e = textlen < length ? textlen : length;
+    int prefix = 0;
+    while (prefix < e && text[prefix] == d[prefix]) prefix++;
+    int suffix = 0;
+    while (suffix < e-prefix &&
+	   text[textlen-1-suffix] == d[length-1-suffix]) suffix++;
+    truncate(n);
+    if (n >= stepsize) {
+      stepsize = stepsize ? 2*stepsize : 32;
+      steps = (UndoStep*)realloc(steps, stepsize*sizeof(UndoStep));
+    }
+    UndoStep &s = steps[n];
+    s.prefix = prefix;
+    s.nold = textlen-prefix-suffix;
+    s.nnew = length-prefix-suffix;
+    s.data = (char*)malloc(s.nold + s.nnew + 1);
+    memcpy(s.data, text+prefix, s.nold);
+    memcpy(s.data+s.nold, d+prefix, s.nnew);
+    stepbytes += s.nold + s.nnew;
+    splice(prefix, s.nold, d+prefix, s.nnew);
+  } else {
+    truncate(0);
+    textlen = 0;
+    splice(0, 0, d, length);
+  }
+  nsteps = n+1;
+  at = n;
 }
 
 void Undo::update_saved() {
@@ -79,12 +143,12 @@ void Undo::update_saved() {
 
 // Redo menu callback
 void Undo::redo_cb(fltk::Widget *, void *) {
-  char	fname[1024];			// Undo checkpoint file
-  if (current >= last) return;
+  if (current >= last || current+1 >= nsteps) return;
 
   suspend();
-  if (!read_file(filename(current + 1, fname, sizeof(fname)), 0)) {
-    // Unable to read checkpoint file, don't redo...
+  seek(current + 1);
+  if (!read_memory(text, textlen)) {
+    // Unable to read checkpoint, don't redo...
     resume();
     return;
   }
@@ -97,21 +161,23 @@ void Undo::redo_cb(fltk::Widget *, void *) {
   // Update undo/redo menu items...
   if (current >= last) undo_item[REDO_ITEM]->deactivate();
   undo_item[UNDO_ITEM]->activate();
+  resume();
 }
 
 // Undo menu callback
 void Undo::undo_cb(fltk::Widget *, void *) {
-  char	fname[1024];			// Undo checkpoint file
-  
   if (current <= 0) return;
 
   if (current == last) {
-    write_file(filename(current, fname, sizeof(fname)));
+    int length;
+    const char *d = write_memory(&length);
+    store(current, d, length);
   }
 
   suspend();
-  if (!read_file(filename(current - 1, fname, sizeof(fname)), 0)) {
-    // Unable to read checkpoint file, don't undo...
+  seek(current - 1);
+  if (!read_memory(text, textlen)) {
+    // Unable to read checkpoint, don't undo...
     resume();
     return;
   }
@@ -127,22 +193,18 @@ void Undo::undo_cb(fltk::Widget *, void *) {
   resume();
 }
 
-// Save current file to undo buffer
+// Save current design to undo buffer
 void Undo::checkpoint() {
-  char	fname[1024];			// Undo checkpoint filename
-
 //  printf("undo_checkpoint(): current=%d, undo_paused=%d, modflag=%d\n",
 //         current, undo_paused, modflag);
 
   // Don't checkpoint if undo_suspend() has been called...
   if (paused) return;
 
-  // Save the current UI to a checkpoint file...
-  if (!write_file(filename (current, fname, sizeof(fname)))) {
-    // Don't attempt to do undo stuff if we can't write a checkpoint file...
-    perror(fname);
-    return;
-  }
+  // Save the current UI to a checkpoint...
+  int length;
+  const char *d = write_memory(&length);
+  store(current, d, length);
 
   // Update the saved level...
   if (modflag && current <= save) save = -1;
@@ -151,7 +213,18 @@ void Undo::checkpoint() {
   // Update the current undo level...
   current ++;
   last = current;
-  if (current > max) max = current;
+
+  // Forget the oldest levels if the differences use too much memory...
+  while (stepbytes > UNDO_MEMORY && nsteps > 2) {
+    stepbytes -= steps[1].nold + steps[1].nnew;
+    free(steps[1].data);
+    nsteps--;
+    memmove(steps+1, steps+2, (nsteps-1)*sizeof(UndoStep));
+    at--;
+    current--;
+    last--;
+    if (save >= 0) save--;
+  }
 
   // Enable the Undo and disable the Redo menu items...
   undo_item[UNDO_ITEM]->activate();
@@ -160,15 +233,12 @@ void Undo::checkpoint() {
 
 // Clear undo buffer
 void Undo::clear() {
-  char	fname[1024];			// Undo checkpoint filename
-
-  // Remove old checkpoint files...
-  for (int i = 0; i <= max; i ++) {
-    unlink(filename (i, fname, sizeof(fname)));
-  }
+  // Free the old checkpoints...
+  truncate(0);
+  textlen = 0;
 
   // Reset current, last, and save indices...
-  current = last = max = 0;
+  current = last = 0;
   if (modflag) save = -1;
   else save = 0;
 }
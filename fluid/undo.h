@@ -34,20 +34,17 @@ class Undo {
   static int  current;  	// Current undo level in buffer
   static int  last;		// Last undo level in buffer
   static int  save;		// Last undo level that was saved
-  static int  max;		// Maximum undo level used
   static bool paused;		// Undo checkpointing paused?
-  static char path[1024];	// Undo path
 
  public:
 
-  static void checkpoint();	// Save current file to undo buffer
+  static void checkpoint();	// Save current design to undo buffer
   static void clear();		// Clear undo buffer
 
   static void resume()  {  paused = 0;}	// Resume undo checkpoints
   static void suspend() {  paused = 1;}	// Suspend undo checkpoints
   static void update_saved();	// Update the undo pos when saved
 
-  static const char *filename(int level, char *buf, int bufsize);
   static void remove_last();
 
   static void redo_cb(fltk::Widget *, void *);  // Redo menu callback
@@ -43,6 +43,7 @@
 #include <fltk/Item.h>
 #include <fltk/ItemGroup.h>
 #include <fltk/Monitor.h>
+#include <stdlib.h>
 
 using namespace fltk;
 
@@ -235,6 +236,8 @@ void glutInit(int *argc, char **argv) {
   }
   argv[j] = 0;
   *argc = j;
+  const char* c = getenv("GLUT_FRAME_INTERVAL");
+  if (c) glutFramePacing(float(atof(c)));
 }
 
 void glutInitDisplayMode(unsigned int mode) {
@@ -375,12 +378,53 @@ void glutRemoveMenuItem(int item) {
   delete m->child(item-1);
 }
 
+static float frame_pacing;
+
+// The idle function when glutFramePacing() is on:
+static void idle_frame(void*) {
+  fltk::add_frame_callback(idle_frame);
+  if (glut_idle_function) glut_idle_function();
+}
+
+static void stop_idle() {
+  if (!glut_idle_function) return;
+  if (frame_pacing) fltk::remove_frame_callback(idle_frame);
+  else fltk::remove_idle((void (*)(void *))glut_idle_function);
+}
+
+static void start_idle() {
+  if (!glut_idle_function) return;
+  if (frame_pacing) fltk::add_frame_callback(idle_frame);
+  else fltk::add_idle((void (*)(void *))glut_idle_function);
+}
+
 void glutIdleFunc(void (*f)())
 {
   if (glut_idle_function == f) return;  // no change
-  if (glut_idle_function) fltk::remove_idle((void (*)(void *))glut_idle_function);
-  if (f) fltk::add_idle((void (*)(void *))f);
+  stop_idle();
   glut_idle_function = f;
+  start_idle();
+}
+
+/*!
+  Call the glutIdleFunc() once per frame of the fltk frame clock,
+  \a interval seconds apart, rather than over and over as fast as
+  possible. glutPostRedisplay() of all the windows is then drawn
+  together once per frame as well, so an animating program uses only
+  the time it needs to draw each frame rather than all of a
+  processor. This sets fltk::frame_interval(). Zero turns it off,
+  which is the default. It can also be turned on by setting the
+  GLUT_FRAME_INTERVAL environment variable (for instance to .016)
+  before glutInit() is called.
+*/
+void glutFramePacing(float interval)
+{
+  if (interval < 0) interval = 0;
+  if (interval == frame_pacing) return;
+  stop_idle();
+  frame_pacing = interval;
+  fltk::frame_interval(interval);
+  start_idle();
 }
 
 ////////////////////////////////////////////////////////////////
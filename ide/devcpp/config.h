@@ -206,6 +206,9 @@ extern int vsnprintf(char* str, size_t size, const char* fmt, va_list ap);
  */
 #define HAVE_EXCEPTIONS 1
 
+/* Is typeid() available? Only used by the memory report. */
+#define HAVE_RTTI 1
+
 /*
  * CONFIGDIR
  *
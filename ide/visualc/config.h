@@ -207,6 +207,9 @@
 /* Do we have exceptions in the compiler? Only used by test programs. */
 #define HAVE_EXCEPTIONS 1
 
+/* Is typeid() available? Only used by the memory report. */
+#define HAVE_RTTI 1
+
 /**** MRS: THESE TWO ARE GOING AWAY! ****/
 /* Enables fl_load_plugin() on Unix */
 #define HAVE_DLOPEN		0
@@ -47,6 +47,7 @@
 #include <fltk/SharedImage.h>
 #include <fltk/Color.h>
 #include <fltk/run.h>
+#include <fltk/Preferences.h>
 #include <config.h>
 
 #include <stdio.h>
@@ -54,12 +55,15 @@
 #include <fltk/string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #if defined(_WIN32) && !defined(__CYGWIN__)
 # undef _POSIX_
 # include <io.h>
+# include <process.h>
 # define access(a,b) _access(a,b)
+# define getpid _getpid
 # ifndef F_OK
 #  define F_OK 04
 # endif
@@ -73,6 +77,7 @@ using namespace fltk;
 // Local functions...
 //
 
+static void	load_cached_kde_icons(const char *directory, const char *icondir);
 static void	load_kde_icons(const char *directory, const char *icondir);
 static void	load_kde_mimelnk(const char *filename, const char *icondir);
 static void	load_gnome_icons(const char *directory, const char *icondir);
@@ -402,6 +407,8 @@ FileIcon::load_system_icons(void)
   // Add symbols if they haven't been added already...
   if (!init)
   {
+    // Set this first, as FileIcon::load() calls this function again:
+    init = 1;
     fltk::register_images();
     if (getenv("KDE_FULL_SESSION")) {
       if (!kdedir) {
@@ -443,7 +450,7 @@ FileIcon::load_system_icons(void)
         if (!access(filename, F_OK)) icon->load(filename);
 
         snprintf(filename, sizeof(filename), "%s/share/mimelnk", kdedir);
-        load_kde_icons(filename, icondir);
+        load_cached_kde_icons(filename, icondir);
       }
     } else if (getenv("DESKTOP_SESSION") != NULL && !access("/usr/share/icons/gnome/32x32", F_OK)) {
       // Load GNOME icons...
@@ -522,10 +529,271 @@ FileIcon::load_system_icons(void)
       new FileIcon("*", FileIcon::DIRECTORY, sizeof(dir) / sizeof(dir[0]), dir);
 #endif
     }
+  }
+}
 
-    // Mark things as initialized...
-    init = 1;
+static const char * const kde_icon_paths[] = { // Subdirs to look in...
+  "16x16/actions",
+  "16x16/apps",
+  "16x16/devices",
+  "16x16/filesystems",
+  "16x16/mimetypes",
+/*
+  "20x20/actions",
+  "20x20/apps",
+  "20x20/devices",
+  "20x20/filesystems",
+  "20x20/mimetypes",
+
+  "22x22/actions",
+  "22x22/apps",
+  "22x22/devices",
+  "22x22/filesystems",
+  "22x22/mimetypes",
+
+  "24x24/actions",
+  "24x24/apps",
+  "24x24/devices",
+  "24x24/filesystems",
+  "24x24/mimetypes",
+*/
+  "32x32/actions",
+  "32x32/apps",
+  "32x32/devices",
+  "32x32/filesystems",
+  "32x32/mimetypes",
+/*
+  "36x36/actions",
+  "36x36/apps",
+  "36x36/devices",
+  "36x36/filesystems",
+  "36x36/mimetypes",
+
+  "48x48/actions",
+  "48x48/apps",
+  "48x48/devices",
+  "48x48/filesystems",
+  "48x48/mimetypes",
+
+  "64x64/actions",
+  "64x64/apps",
+  "64x64/devices",
+  "64x64/filesystems",
+  "64x64/mimetypes",
+
+  "96x96/actions",
+  "96x96/apps",
+  "96x96/devices",
+  "96x96/filesystems",
+  "96x96/mimetypes",
+*/
+  NULL
+};
+
+//
+// Cache of the icons found by load_kde_icons()...
+//
+// Reading all the mimelnk files and looking for the icons they name
+// takes hundreds of milliseconds, so the icons that are made are
+// written to a file in the Preferences userdata directory, along with
+// the modification times of the directories that were looked in. Later
+// programs map that file, and if none of the directories have changed
+// make the same icons, with their patterns pointing into the mapping.
+//
+
+static const char icon_cache_magic[8] = {'f','l','t','k','i','c','n','1'};
+
+struct IconCacheHeader {
+  char	magic[8];		// icon_cache_magic
+  U32	key;			// offset of the directory names
+  U32	ndirs;			// IconCacheDir records after the header
+  U32	nicons;			// IconCacheIcon records after those
+};
+
+struct IconCacheDir {
+  U32	name;			// offset of the directory name
+  U32	mtime;			// its modification time, or 0 if missing
+};
+
+struct IconCacheIcon {
+  U32	type;			// FileIcon type
+  U32	pattern;		// offset of the pattern
+  U32	file;			// offset of the icon file name
+};
+
+// What load_kde_icons() did, if it is being recorded:
+static struct {
+  bool		on;
+  char		*strings;
+  U32		nstrings, sstrings;
+  IconCacheDir	*dirs;
+  U32		ndirs, sdirs;
+  IconCacheIcon	*icons;
+  U32		nicons, sicons;
+} icon_cache;
+
+static U32 dir_mtime(const char *name) {
+  struct stat	fileinfo;
+  if (fltk_stat(name, &fileinfo)) return 0;
+  return (U32)fileinfo.st_mtime;
+}
+
+// Returns the offset of the string counting from the start of strings:
+static U32 cache_string(const char *s) {
+  U32 n = (U32)strlen(s) + 1;
+  if (icon_cache.nstrings + n > icon_cache.sstrings) {
+    icon_cache.sstrings = 2 * (icon_cache.nstrings + n);
+    icon_cache.strings = (char *)realloc(icon_cache.strings, icon_cache.sstrings);
+  }
+  memcpy(icon_cache.strings + icon_cache.nstrings, s, n);
+  icon_cache.nstrings += n;
+  return icon_cache.nstrings - n;
+}
+
+static void cache_dir(const char *name) {
+  if (!icon_cache.on) return;
+  if (icon_cache.ndirs >= icon_cache.sdirs) {
+    icon_cache.sdirs = icon_cache.sdirs ? 2 * icon_cache.sdirs : 64;
+    icon_cache.dirs = (IconCacheDir *)
+      realloc(icon_cache.dirs, icon_cache.sdirs * sizeof(IconCacheDir));
   }
+  IconCacheDir *d = &icon_cache.dirs[icon_cache.ndirs ++];
+  d->name  = cache_string(name);
+  d->mtime = dir_mtime(name);
+}
+
+// Make an icon for load_kde_mimelnk():
+static void add_kde_icon(const char *pattern, int type, const char *file) {
+  FileIcon *icon = new FileIcon(pattern, type);
+  icon->load(file);
+  if (!icon_cache.on) return;
+  if (icon_cache.nicons >= icon_cache.sicons) {
+    icon_cache.sicons = icon_cache.sicons ? 2 * icon_cache.sicons : 256;
+    icon_cache.icons = (IconCacheIcon *)
+      realloc(icon_cache.icons, icon_cache.sicons * sizeof(IconCacheIcon));
+  }
+  IconCacheIcon *i = &icon_cache.icons[icon_cache.nicons ++];
+  i->type    = type;
+  i->pattern = cache_string(pattern);
+  i->file    = cache_string(file);
+}
+
+// Make the icons in the cache file, or return false if it is missing,
+// damaged, or any directory has changed:
+static bool read_icon_cache(const char *cachefile, const char *key) {
+  unsigned size;
+  const uchar *p = SharedImage::map_file(cachefile, size);
+  if (!p) return false;
+  const IconCacheHeader *h = (const IconCacheHeader *)p;
+  const IconCacheDir *dirs = (const IconCacheDir *)(h + 1);
+  const IconCacheIcon *icons;
+  U32 i;
+  // every string must end before the last byte, which is a nul:
+  if (size < sizeof(IconCacheHeader) + 1 || p[size - 1] ||
+      memcmp(h->magic, icon_cache_magic, sizeof(h->magic)) ||
+      h->ndirs > size / sizeof(IconCacheDir) ||
+      h->nicons > size / sizeof(IconCacheIcon) ||
+      sizeof(IconCacheHeader) + h->ndirs * sizeof(IconCacheDir) +
+      h->nicons * sizeof(IconCacheIcon) > size ||
+      h->key >= size || strcmp((const char *)p + h->key, key))
+    goto BAD;
+  for (i = 0; i < h->ndirs; i ++)
+    if (dirs[i].name >= size ||
+        dir_mtime((const char *)p + dirs[i].name) != dirs[i].mtime)
+      goto BAD;
+  icons = (const IconCacheIcon *)(dirs + h->ndirs);
+  for (i = 0; i < h->nicons; i ++)
+    if (icons[i].pattern >= size || icons[i].file >= size)
+      goto BAD;
+  // The patterns point into the mapping, so it is never unmapped:
+  for (i = 0; i < h->nicons; i ++) {
+    FileIcon *icon = new FileIcon((const char *)p + icons[i].pattern,
+                                  icons[i].type);
+    icon->load((const char *)p + icons[i].file);
+  }
+  return true;
+BAD:
+  SharedImage::unmap_file(p, size);
+  return false;
+}
+
+static void write_icon_cache(const char *cachefile, U32 key, U32 start) {
+  char tempfile[1024];
+  U32 i;
+  // A directory changed in the same second as it was read may change
+  // again without its time changing, so it is read again next time:
+  for (i = 0; i < icon_cache.ndirs; i ++)
+    if (icon_cache.dirs[i].mtime >= start) return;
+
+  if (snprintf(tempfile, sizeof(tempfile), "%s.%d", cachefile, (int)getpid())
+      >= (int)sizeof(tempfile)) return; // too long, it would be a different file
+  FILE *fp = fltk_fopen(tempfile, "wb");
+  if (!fp) return;
+  IconCacheHeader h;
+  U32 base = sizeof(h) + icon_cache.ndirs * sizeof(IconCacheDir) +
+             icon_cache.nicons * sizeof(IconCacheIcon);
+  memcpy(h.magic, icon_cache_magic, sizeof(h.magic));
+  h.key    = base + key;
+  h.ndirs  = icon_cache.ndirs;
+  h.nicons = icon_cache.nicons;
+  for (i = 0; i < icon_cache.ndirs; i ++)
+    icon_cache.dirs[i].name += base;
+  for (i = 0; i < icon_cache.nicons; i ++) {
+    icon_cache.icons[i].pattern += base;
+    icon_cache.icons[i].file    += base;
+  }
+  cache_string(""); // so the file ends with a nul
+  bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+    fwrite(icon_cache.dirs, sizeof(IconCacheDir), icon_cache.ndirs, fp) == icon_cache.ndirs &&
+    fwrite(icon_cache.icons, sizeof(IconCacheIcon), icon_cache.nicons, fp) == icon_cache.nicons &&
+    fwrite(icon_cache.strings, 1, icon_cache.nstrings, fp) == icon_cache.nstrings;
+  if (fclose(fp)) ok = false;
+  if (ok && rename(tempfile, cachefile)) {
+    // WIN32 will not rename over an existing file:
+    unlink(cachefile);
+    if (rename(tempfile, cachefile)) ok = false;
+  }
+  if (!ok) unlink(tempfile);
+}
+
+//
+// 'load_cached_kde_icons()' - Load KDE icons from the cache or the files.
+//
+
+static void
+load_cached_kde_icons(const char *directory,	// I - Directory to load
+                      const char *icondir) {	// I - Location of icons
+  char		cachefile[1024];	// Name of cache file
+  char		key[2048];		// Directories it must be for
+  char		full[1024];		// Full name of icon directory
+  int		i;			// Looping var
+
+
+  Preferences prefs(Preferences::USER, "fltk.org", "fileicons");
+  if (!prefs.getUserdataPath(cachefile, sizeof(cachefile))) {
+    load_kde_icons(directory, icondir);
+    return;
+  }
+  strlcat(cachefile, "kde-icons.cache", sizeof(cachefile));
+  snprintf(key, sizeof(key), "%s\n%s", directory, icondir);
+  if (read_icon_cache(cachefile, key)) return;
+
+  // Read the files, and write what was found to the cache...
+  icon_cache.on = true;
+  U32 start = (U32)time(0);
+  U32 k = cache_string(key);
+  for (i = 0; kde_icon_paths[i]; i ++) {
+    if (snprintf(full, sizeof(full), "%s/%s", icondir, kde_icon_paths[i])
+        >= (int)sizeof(full)) continue; // too long to be a real directory
+    cache_dir(full);
+  }
+  load_kde_icons(directory, icondir);
+  write_icon_cache(cachefile, k, start);
+  icon_cache.on = false;
+  free(icon_cache.strings);
+  free(icon_cache.dirs);
+  free(icon_cache.icons);
+  memset(&icon_cache, 0, sizeof(icon_cache));
 }
 
 //
@@ -541,6 +809,7 @@ load_kde_icons(const char *directory,	// I - Directory to load
   char		full[1024];		// Full name of file
 
 
+  cache_dir(directory);
   entries = (dirent **)0;
   n       = filename_list(directory, &entries);
 
@@ -572,7 +841,6 @@ load_kde_mimelnk(const char *filename,	// I - mimelnk filename
   char		mimetype[1024];
   char		*val;
   char		full_iconfilename[1024];
-  FileIcon	*icon;
 
 
   mimetype[0]     = '\0';
@@ -604,70 +872,15 @@ load_kde_mimelnk(const char *filename,	// I - mimelnk filename
       } else if (!access(icondir, F_OK)) {
         // KDE 3.x and 2.x icons
 	int		i;		// Looping var
-	static const char *paths[] = {	// Subdirs to look in...
-	  "16x16/actions",
-	  "16x16/apps",
-	  "16x16/devices",
-	  "16x16/filesystems",
-	  "16x16/mimetypes",
-/*
-	  "20x20/actions",
-	  "20x20/apps",
-	  "20x20/devices",
-	  "20x20/filesystems",
-	  "20x20/mimetypes",
-
-	  "22x22/actions",
-	  "22x22/apps",
-	  "22x22/devices",
-	  "22x22/filesystems",
-	  "22x22/mimetypes",
-
-	  "24x24/actions",
-	  "24x24/apps",
-	  "24x24/devices",
-	  "24x24/filesystems",
-	  "24x24/mimetypes",
-*/
-	  "32x32/actions",
-	  "32x32/apps",
-	  "32x32/devices",
-	  "32x32/filesystems",
-	  "32x32/mimetypes",
-/*
-	  "36x36/actions",
-	  "36x36/apps",
-	  "36x36/devices",
-	  "36x36/filesystems",
-	  "36x36/mimetypes",
-
-	  "48x48/actions",
-	  "48x48/apps",
-	  "48x48/devices",
-	  "48x48/filesystems",
-	  "48x48/mimetypes",
-
-	  "64x64/actions",
-	  "64x64/apps",
-	  "64x64/devices",
-	  "64x64/filesystems",
-	  "64x64/mimetypes",
-
-	  "96x96/actions",
-	  "96x96/apps",
-	  "96x96/devices",
-	  "96x96/filesystems",
-	  "96x96/mimetypes"
-*/	};
-
-        for (i = 0; i < (int)(sizeof(paths) / sizeof(paths[0])); i ++) {
+
+        for (i = 0; kde_icon_paths[i]; i ++) {
           snprintf(full_iconfilename, sizeof(full_iconfilename),
-	           "%s/%s/%s.png", icondir, paths[i], iconfilename);
+	           "%s/%s/%s.png", icondir, kde_icon_paths[i], iconfilename);
 
           if (!access(full_iconfilename, F_OK)) break;
 	}
 
-        if (i >= (int)(sizeof(paths) / sizeof(paths[0]))) return;
+        if (!kde_icon_paths[i]) return;
       } else {
         // KDE 1.x icons
         snprintf(full_iconfilename, sizeof(full_iconfilename),
@@ -678,18 +891,15 @@ load_kde_mimelnk(const char *filename,	// I - mimelnk filename
 
       if (strncmp(mimetype, "inode/", 6) == 0) {
 	if (!strcmp(mimetype + 6, "directory"))
-	  icon = new FileIcon("*", FileIcon::DIRECTORY);
+	  add_kde_icon("*", FileIcon::DIRECTORY, full_iconfilename);
 	else if (!strcmp(mimetype + 6, "blockdevice"))
-	  icon = new FileIcon("*", FileIcon::DEVICE);
+	  add_kde_icon("*", FileIcon::DEVICE, full_iconfilename);
 	else if (!strcmp(mimetype + 6, "fifo"))
-	  icon = new FileIcon("*", FileIcon::FIFO);
-	else return;
+	  add_kde_icon("*", FileIcon::FIFO, full_iconfilename);
       } else {
-        icon = new FileIcon(kde_to_fltk_pattern(pattern),
-                                FileIcon::PLAIN);
+        add_kde_icon(kde_to_fltk_pattern(pattern), FileIcon::PLAIN,
+		     full_iconfilename);
       }
-
-      icon->load(full_iconfilename);
     }
   }
 }
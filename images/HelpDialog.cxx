@@ -138,6 +138,7 @@ HelpDialog::HelpDialog() {
       o->box(fltk::DOWN_BOX);
       o->selection_color((fltk::Color)15);
       o->callback((fltk::Callback*)cb_view_);
+      o->streaming(true);
     }
      {fltk::Group* o = new fltk::Group(10, 348, 510, 27);
       o->begin();
@@ -43,173 +43,65 @@ extern "C" {
 #include <setjmp.h>
 #include <string.h>
 
-typedef struct {
-  struct jpeg_source_mgr pub;	/* public fields */
-
-  JOCTET * buffer;		/* start of buffer */
-
-  JOCTET * start_datas, * datas;
-} my_source_mgr;
-
-static int INPUT_BUF_SIZE;
-
-typedef my_source_mgr * my_src_ptr;
-
 /*
- * Initialize source --- called by jpeg_read_header
- * before any data is actually read.
+ * Data source that reads the inline datas or a file mapped into memory.
+ * libjpeg reads straight out of it, so nothing is copied.
  */
 
 METHODDEF(void)
-init_source (j_decompress_ptr cinfo)
+init_source (j_decompress_ptr /*cinfo*/)
 {
-  my_src_ptr src = (my_src_ptr) cinfo->src;
-
-  /* We reset the empty-input-file flag for each image,
-   * but we don't clear the input buffer.
-   * This is correct behavior for reading a series of images from one source.
-   */
-  src->datas = src->start_datas;
 }
 
-
 /*
- * Fill the input buffer --- called whenever buffer is emptied.
- *
- * In typical applications, this should read fresh data into the buffer
- * (ignoring the current state of next_input_byte & bytes_in_buffer),
- * reset the pointer & count to the start of the buffer, and return TRUE
- * indicating that the buffer has been reloaded.  It is not necessary to
- * fill the buffer entirely, only to obtain at least one more byte.
- *
- * There is no such thing as an EOF return.  If the end of the file has been
- * reached, the routine has a choice of ERREXIT() or inserting fake data into
- * the buffer.  In most cases, generating a warning message and inserting a
- * fake EOI marker is the best course of action --- this will allow the
- * decompressor to output however much of the image is there.  However,
- * the resulting error message is misleading if the real problem is an empty
- * input file, so we handle that case specially.
- *
- * In applications that need to be able to suspend compression due to input
- * not being available yet, a FALSE return indicates that no more data can be
- * obtained right now, but more may be forthcoming later.  In this situation,
- * the decompressor will return to its caller (with an indication of the
- * number of scanlines it has read, if any).  The application should resume
- * decompression after it has loaded more data into the input buffer.  Note
- * that there are substantial restrictions on the use of suspension --- see
- * the documentation.
- *
- * When suspending, the decompressor will back up to a convenient restart point
- * (typically the start of the current MCU). next_input_byte & bytes_in_buffer
- * indicate where the restart point will be if the current call returns FALSE.
- * Data beyond this point must be rescanned after resumption, so move it to
- * the front of the buffer rather than discarding it.
+ * Called if libjpeg wants more than there is. As libjpeg does for a
+ * file that is too short, insert a fake EOI marker so it outputs
+ * however much of the image is there.
  */
 
+static const JOCTET fake_eoi[2] = {0xFF, JPEG_EOI};
+
 METHODDEF(boolean)
 fill_input_buffer (j_decompress_ptr cinfo)
 {
-  my_src_ptr src = (my_src_ptr) cinfo->src;
-  unsigned nbytes = INPUT_BUF_SIZE;
-
-  memcpy(src->buffer, src->datas, INPUT_BUF_SIZE);
-  src->datas += INPUT_BUF_SIZE;
-
-  src->pub.next_input_byte = src->buffer;
-  src->pub.bytes_in_buffer = nbytes;
-
+  cinfo->src->next_input_byte = fake_eoi;
+  cinfo->src->bytes_in_buffer = 2;
   return TRUE;
 }
 
-
-/*
- * Skip data --- used to skip over a potentially large amount of
- * uninteresting data (such as an APPn marker).
- *
- * Writers of suspendable-input applications must note that skip_input_data
- * is not granted the right to give a suspension return.  If the skip extends
- * beyond the data currently in the buffer, the buffer can be marked empty so
- * that the next read will cause a fill_input_buffer call that can suspend.
- * Arranging for additional bytes to be discarded before reloading the input
- * buffer is the application writer's problem.
- */
-
 METHODDEF(void)
 skip_input_data (j_decompress_ptr cinfo, long num_bytes)
 {
-  my_src_ptr src = (my_src_ptr) cinfo->src;
-
-  /* Just a dumb implementation for now.  Could use fseek() except
-   * it doesn't work on pipes.  Not clear that being smart is worth
-   * any trouble anyway --- large skips are infrequent.
-   */
-  if (num_bytes > 0) {
-    while (num_bytes > (long) src->pub.bytes_in_buffer) {
-      num_bytes -= (long) src->pub.bytes_in_buffer;
-      (void) fill_input_buffer(cinfo);
-      /* note we assume that fill_input_buffer will never return FALSE,
-       * so suspension need not be handled.
-       */
-    }
-    src->pub.next_input_byte += (unsigned) num_bytes;
-    src->pub.bytes_in_buffer -= (unsigned) num_bytes;
+  if (num_bytes <= 0) return;
+  if ((size_t)num_bytes > cinfo->src->bytes_in_buffer) {
+    fill_input_buffer(cinfo);
+  } else {
+    cinfo->src->next_input_byte += num_bytes;
+    cinfo->src->bytes_in_buffer -= num_bytes;
   }
 }
 
-
-/*
- * An additional method that can be provided by data source modules is the
- * resync_to_restart method for error recovery in the presence of RST markers.
- * For the moment, this source module just uses the default resync method
- * provided by the JPEG library.  That method assumes that no backtracking
- * is possible.
- */
-
-
-/*
- * Terminate source --- called by jpeg_finish_decompress
- * after all data has been read.  Often a no-op.
- *
- * NB: *not* called by jpeg_abort or jpeg_destroy; surrounding
- * application must deal with any cleanup that should happen even
- * for error exit.
- */
-
 METHODDEF(void)
 term_source (j_decompress_ptr /*cinfo*/)
 {
-  /* no work necessary here */
 }
 
-
-/*
- * Prepare for input from memory.
- */
-
-METHODDEF(void)
-jpeg_rawdatas_src (j_decompress_ptr cinfo, JOCTET * datas)
+static void
+jpeg_memory_src (j_decompress_ptr cinfo, const JOCTET * datas, size_t size)
 {
-  my_src_ptr src;
-
   if (cinfo->src == NULL) {	/* first time for this JPEG object? */
     cinfo->src = (struct jpeg_source_mgr *)
       (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
-				  sizeof(my_source_mgr));
-    src = (my_src_ptr) cinfo->src;
-    src->buffer = (JOCTET *)
-      (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
-				  INPUT_BUF_SIZE * sizeof(JOCTET));
+				  sizeof(struct jpeg_source_mgr));
   }
-
-  src = (my_src_ptr) cinfo->src;
-  src->pub.init_source = init_source;
-  src->pub.fill_input_buffer = fill_input_buffer;
-  src->pub.skip_input_data = skip_input_data;
-  src->pub.resync_to_restart = jpeg_resync_to_restart; /* use default method */
-  src->pub.term_source = term_source;
-  src->start_datas = datas;
-  src->pub.bytes_in_buffer = 0; /* forces fill_input_buffer on first read */
-  src->pub.next_input_byte = NULL; /* until buffer loaded */
+  struct jpeg_source_mgr* src = cinfo->src;
+  src->init_source = init_source;
+  src->fill_input_buffer = fill_input_buffer;
+  src->skip_input_data = skip_input_data;
+  src->resync_to_restart = jpeg_resync_to_restart; /* use default method */
+  src->term_source = term_source;
+  src->next_input_byte = datas;
+  src->bytes_in_buffer = size;
 }
 
 struct my_error_mgr {
@@ -259,8 +151,9 @@ bool jpegImage::fetch()
   struct my_error_mgr jerr;
   FILE* infile = 0;
   declare_now(&infile);
-
-  INPUT_BUF_SIZE = 4096;
+  unsigned mapsize = 0;
+  const uchar* map = 0;
+  declare_now(&map);
 
   cinfo.err = jpeg_std_error(&jerr.pub);
   jerr.pub.error_exit = my_error_exit;
@@ -273,13 +166,16 @@ bool jpegImage::fetch()
      */
     jpeg_destroy_decompress(&cinfo);
     if (infile) fclose(infile);
+    unmap_file(map, mapsize);
     return false;
   }
 
   jpeg_create_decompress(&cinfo);
 
   if (datas) {
-    jpeg_rawdatas_src(&cinfo, (JOCTET*) datas);
+    jpeg_memory_src(&cinfo, (const JOCTET*)datas, ~size_t(0)>>1); // size unknown
+  } else if ((map = map_file(mapsize))) {
+    jpeg_memory_src(&cinfo, (const JOCTET*)map, mapsize);
   } else {
     if ((infile = fopen(get_filename(), "rb")) == NULL)
       return false;
@@ -287,6 +183,16 @@ bool jpegImage::fetch()
   }
 
   jpeg_read_header(&cinfo, TRUE);
+  // If get() was given a size, have libjpeg scale by 1/2, 1/4 or 1/8
+  // while it is still at least that big, which is much faster:
+  if (want_w) {
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 1;
+    while (cinfo.scale_denom < 8 &&
+	   int(cinfo.image_width/(2*cinfo.scale_denom)) >= want_w &&
+	   int(cinfo.image_height/(2*cinfo.scale_denom)) >= want_h)
+      cinfo.scale_denom *= 2;
+  }
   jpeg_start_decompress(&cinfo);
   setsize(cinfo.output_width, cinfo.output_height);
   setpixeltype((PixelType)cinfo.output_components);
@@ -302,6 +208,7 @@ bool jpegImage::fetch()
   jpeg_destroy_decompress(&cinfo);
 
   if (infile) fclose(infile);
+  unmap_file(map, mapsize);
   return true;
 #else
   return false;
@@ -42,12 +42,19 @@ extern "C"
 
 # include <stdlib.h>
 
-static png_bytep cur_datas;
+// Reads from the inline datas or the file mapped into memory:
+struct png_source {
+  const unsigned char* p;
+  png_size_t left;
+};
 
-static void read_data_fn(png_structp /*png_ptr*/,png_bytep d,png_size_t length)
+static void read_data_fn(png_structp png_ptr,png_bytep d,png_size_t length)
 {
-  memcpy(d, cur_datas, length);
-  cur_datas += length;
+  png_source* src = (png_source*)png_get_io_ptr(png_ptr);
+  if (length > src->left) png_error(png_ptr, "Read past end of data");
+  memcpy(d, src->p, length);
+  src->p += length;
+  src->left -= length;
 }
 
 // Dummy function to remove gcc's nasty warning about longjmp:
@@ -86,24 +93,35 @@ bool pngImage::fetch()
 
   FILE *fp=0;
   declare_now(&fp);
+  unsigned mapsize = 0;
+  const uchar* map = 0;
+  png_source src;
   if (datas) {
-    cur_datas=(png_bytep)datas;
-    png_set_read_fn(png_ptr, cur_datas, read_data_fn);
+    src.p = datas;
+    src.left = ~png_size_t(0); // size is unknown
+  } else if ((map = map_file(mapsize))) {
+    src.p = map;
+    src.left = mapsize;
   } else {
+    src.p = 0;
     fp = fopen(get_filename(), "rb");
   }
-  if (info_ptr == NULL || (datas == NULL && fp == NULL)) {
+  if (src.p) png_set_read_fn(png_ptr, &src, read_data_fn);
+  if (info_ptr == NULL || (src.p == NULL && fp == NULL)) {
     png_destroy_read_struct(&png_ptr, (png_infopp)NULL, (png_infopp)NULL);
+    unmap_file(map, mapsize);
     return false;
   }
 
   uchar* buffer=0;
   declare_now(&buffer);
+  unsigned* sums=0;
+  declare_now(&sums);
   bool ret = false;
   bool alpha = false;
 
-  if (datas) {
-    if (png_sig_cmp((uchar*)datas, (png_size_t)0, 8))
+  if (src.p) {
+    if (src.left < 8 || png_sig_cmp((uchar*)src.p, (png_size_t)0, 8))
       goto error;
   } else {
     uchar buf[8];
@@ -153,14 +171,49 @@ bool pngImage::fetch()
   if (color_type & PNG_COLOR_MASK_ALPHA) alpha = true;
   // png_set_strip_alpha doesn't seem to work ... too bad
 
-  setsize(width, height);
-  setpixeltype(alpha ? RGBM : RGB);
-
   { // avoid y initialization error in VC6 because of 'goto error' code
-  for (unsigned y=0; y<height; y++) {
-    uchar* b = linebuffer(y);
-    png_read_row(png_ptr, b, NULL);
-    setpixels(b, y);
+  // If get() was given a size, average each n by n box of pixels as the
+  // rows are read, with n as big as possible while it is still at least
+  // that big. Interlaced images are read at full size.
+  unsigned n = 1;
+  if (want_w && png_get_interlace_type(png_ptr, info_ptr) == PNG_INTERLACE_NONE) {
+    n = width/want_w;
+    if (height/want_h < n) n = height/want_h;
+    if (n < 1) n = 1;
+  }
+  if (n == 1) {
+    setsize(width, height);
+    setpixeltype(alpha ? RGBM : RGB);
+    for (unsigned y=0; y<height; y++) {
+      uchar* b = linebuffer(y);
+      png_read_row(png_ptr, b, NULL);
+      setpixels(b, y);
+    }
+  } else {
+    unsigned d = alpha ? 4 : 3;
+    unsigned w = (width+n-1)/n;
+    unsigned h = (height+n-1)/n;
+    setsize(w, h);
+    setpixeltype(alpha ? RGBM : RGB);
+    buffer = (uchar*)malloc(width*d);
+    sums = (unsigned*)malloc(w*d*sizeof(unsigned));
+    for (unsigned y=0; y<h; y++) {
+      memset(sums, 0, w*d*sizeof(unsigned));
+      unsigned rows = height-y*n; if (rows > n) rows = n;
+      for (unsigned r=0; r<rows; r++) {
+	png_read_row(png_ptr, buffer, NULL);
+	for (unsigned x=0; x<width; x++)
+	  for (unsigned c=0; c<d; c++) sums[x/n*d+c] += buffer[x*d+c];
+      }
+      uchar* b = linebuffer(y);
+      for (unsigned x=0; x<w; x++) {
+	unsigned cols = width-x*n; if (cols > n) cols = n;
+	unsigned count = cols*rows;
+	for (unsigned c=0; c<d; c++)
+	  b[x*d+c] = (sums[x*d+c]+count/2)/count;
+      }
+      setpixels(b, y);
+    }
   }
   }
 
@@ -170,7 +223,9 @@ bool pngImage::fetch()
  error:
   png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
   if (fp) fclose(fp);
+  unmap_file(map, mapsize);
   if (buffer) free(buffer);
+  if (sums) free(sums);
   return ret;
 #else
   return false;
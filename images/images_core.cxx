@@ -37,11 +37,13 @@ static SharedImage *check(const char *name, uchar *header, int headerlen) {
 //  return new Fl_PNM_Image(name);
 
   if (memcmp(header, "\211PNG", 4) == 0)// PNG file
-    return pngImage::get(name);
+    return pngImage::get(name, 0, SharedImage::requested_w(),
+			 SharedImage::requested_h());
 
   if (memcmp(header, "\377\330\377", 3) == 0 && // Start-of-Image
       header[3] >= 0xe0 && header[3] <= 0xef)	// APPn for JPEG file
-    return jpegImage::get(name);
+    return jpegImage::get(name, 0, SharedImage::requested_w(),
+			  SharedImage::requested_h());
 
   return 0;
 }
@@ -0,0 +1,43 @@
+//
+// "$Id$"
+//
+// Jpeg handler loaded as a plugin by fltk::register_image_plugins().
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+
+#include <fltk/SharedImage.h>
+#include <fltk/string.h>
+
+using namespace fltk;
+
+extern "C" FL_IMAGES_API
+SharedImage* fltk_jpeg_plugin(const char* name, uchar* header, int) {
+  if (memcmp(header, "\377\330\377", 3) != 0 || // Start-of-Image
+      header[3] < 0xe0 || header[3] > 0xef)	// APPn for JPEG file
+    return 0;
+  return jpegImage::get(name, 0, SharedImage::requested_w(),
+			SharedImage::requested_h());
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,421 @@
+//
+// "$Id$"
+//
+// PNG and PPM file writing for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+
+// The image is cut into bands of rows, and each band is filtered and
+// compressed by ThreadPool::shared() into a piece of deflate data that
+// ends on a byte boundary (Z_SYNC_FLUSH), so the pieces can simply be
+// written one after another as a single zlib stream. The adler32 of
+// the whole is made by combining those of the bands. The main thread
+// reads the next band with readimage() while the others compress.
+// The PNG chunks are written directly rather than through libpng, as
+// libpng can only compress in one thread.
+
+#include <config.h>
+#include <fltk/write_image.h>
+#include <fltk/Image.h>
+#include <fltk/Rectangle.h>
+#include <fltk/Threads.h>
+#include <fltk/draw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+// Bytes per pixel written for each PixelType:
+static int channels(PixelType type) {
+  switch (type) {
+  case MASK:
+  case MONO: return 1;
+  case RGBA:
+  case ARGB32:
+  case RGBM:
+  case MRGB32: return 4;
+  default: return 3;
+  }
+}
+
+static inline uchar unpremultiply(int c, int a) {
+  if (!a) return 0;
+  c = (c*255+a/2)/a;
+  return uchar(c > 255 ? 255 : c);
+}
+
+// Convert a row to gray, r,g,b, or unpremultiplied r,g,b,a bytes:
+static void convert_row(const uchar* s, PixelType type, int w, uchar* d) {
+  int x;
+  switch (type) {
+  case MASK:
+  case MONO:
+  case RGB:
+  case RGBM:
+    memcpy(d, s, w*channels(type));
+    break;
+  case RGBx:
+    for (x = 0; x < w; x++, s += 4, d += 3) {d[0] = s[0]; d[1] = s[1]; d[2] = s[2];}
+    break;
+  case RGBA:
+    for (x = 0; x < w; x++, s += 4, d += 4) {
+      int a = s[3];
+      d[0] = unpremultiply(s[0], a);
+      d[1] = unpremultiply(s[1], a);
+      d[2] = unpremultiply(s[2], a);
+      d[3] = uchar(a);
+    }
+    break;
+  case RGB32:
+    for (x = 0; x < w; x++, d += 3) {
+      unsigned p = ((const unsigned*)s)[x];
+      d[0] = uchar(p>>16); d[1] = uchar(p>>8); d[2] = uchar(p);
+    }
+    break;
+  case ARGB32:
+    for (x = 0; x < w; x++, d += 4) {
+      unsigned p = ((const unsigned*)s)[x];
+      int a = p>>24;
+      d[0] = unpremultiply((p>>16)&255, a);
+      d[1] = unpremultiply((p>>8)&255, a);
+      d[2] = unpremultiply(p&255, a);
+      d[3] = uchar(a);
+    }
+    break;
+  case MRGB32:
+    for (x = 0; x < w; x++, d += 4) {
+      unsigned p = ((const unsigned*)s)[x];
+      d[0] = uchar(p>>16); d[1] = uchar(p>>8); d[2] = uchar(p); d[3] = uchar(p>>24);
+    }
+    break;
+  }
+}
+
+// Rows to read and compress at once, about a megabyte of pixels:
+static int band_rows(int w, int h) {
+  int n = (1<<20)/(w*4+1);
+  if (n < 16) n = 16;
+  return n < h ? n : h;
+}
+
+// Read a band of the current window, as readimage() can do RGB and
+// MONO directly, for both writers:
+static uchar* read_band(const Rectangle& r, int y, int rows) {
+  uchar* p = (uchar*)malloc(r.w()*3*rows);
+  if (p) readimage(p, RGB, Rectangle(r.x(), r.y()+y, r.w(), rows), r.w()*3);
+  return p;
+}
+
+////////////////////////////////////////////////////////////////
+
+#if HAVE_LIBZ
+#include <zlib.h>
+
+struct PngBand {
+  const uchar* pixels;	// first row
+  uchar* own;		// free this when done
+  PixelType type;
+  int w, rows, linedelta;
+  int level;
+  bool last;		// ends the zlib stream
+  uchar* out;		// deflate data
+  unsigned long out_size;
+  uLong adler;		// of the filtered rows
+  unsigned long raw_size; // bytes of filtered rows
+  bool ok;
+  ThreadPool::TaskId task;
+};
+
+// Called by a pool thread. Each row gets the Sub filter, which makes
+// flat areas, the most common thing in a screenshot, all zeros:
+static void compress_band(void* v) {
+  PngBand* b = (PngBand*)v;
+  const int c = channels(b->type);
+  const int rowbytes = b->w*c;
+  b->raw_size = (unsigned long)(rowbytes+1)*b->rows;
+  uchar* raw = (uchar*)malloc(b->raw_size);
+  uchar* row = (uchar*)malloc(rowbytes);
+  b->ok = false;
+  if (raw && row) {
+    uchar* d = raw;
+    const uchar* s = b->pixels;
+    for (int y = 0; y < b->rows; y++, s += b->linedelta) {
+      convert_row(s, b->type, b->w, row);
+      *d++ = b->level ? 1 : 0;
+      if (b->level) {
+	for (int i = 0; i < c; i++) *d++ = row[i];
+	for (int i = c; i < rowbytes; i++) *d++ = uchar(row[i]-row[i-c]);
+      } else {
+	memcpy(d, row, rowbytes); d += rowbytes;
+      }
+    }
+    b->adler = adler32(adler32(0, 0, 0), raw, b->raw_size);
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, b->level, Z_DEFLATED, -15, 8,
+		     b->level <= 1 ? Z_RLE : Z_DEFAULT_STRATEGY) == Z_OK) {
+      unsigned long size = deflateBound(&z, b->raw_size)+64;
+      b->out = (uchar*)malloc(size);
+      if (b->out) {
+	z.next_in = raw;
+	z.avail_in = uInt(b->raw_size);
+	z.next_out = b->out;
+	z.avail_out = uInt(size);
+	int r = deflate(&z, b->last ? Z_FINISH : Z_SYNC_FLUSH);
+	b->ok = b->last ? r == Z_STREAM_END : (r == Z_OK && !z.avail_in);
+	b->out_size = size-z.avail_out;
+      }
+      deflateEnd(&z);
+    }
+  }
+  free(row);
+  free(raw);
+  free(b->own);
+  b->own = 0;
+}
+
+static void put32(uchar* p, unsigned long n) {
+  p[0] = uchar(n>>24); p[1] = uchar(n>>16); p[2] = uchar(n>>8); p[3] = uchar(n);
+}
+
+static bool write_chunk(FILE* f, const char* type, const uchar* data, unsigned long n) {
+  uchar b[8];
+  put32(b, n);
+  memcpy(b+4, type, 4);
+  uLong crc = crc32(crc32(0, 0, 0), b+4, 4);
+  if (n) crc = crc32(crc, data, uInt(n));
+  if (fwrite(b, 1, 8, f) != 8) return false;
+  if (n && fwrite(data, 1, n, f) != n) return false;
+  put32(b, crc);
+  return fwrite(b, 1, 4, f) == 4;
+}
+
+// Writes the bands in order as they are compressed:
+struct PngWriter {
+  FILE* f;
+  bool ok;
+  uLong adler;
+  enum {QUEUE = 32};
+  PngBand band[QUEUE];
+  int first, count, limit;
+
+  bool begin(const char* filename, int w, int h, int c) {
+    f = fopen(filename, "wb");
+    if (!f) return false;
+    ok = true;
+    adler = adler32(0, 0, 0);
+    first = count = 0;
+    limit = 2*ThreadPool::shared()->threads()+1;
+    if (limit > QUEUE) limit = QUEUE;
+    static const uchar signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    ok = fwrite(signature, 1, 8, f) == 8;
+    uchar ihdr[13];
+    put32(ihdr, w);
+    put32(ihdr+4, h);
+    ihdr[8] = 8; // bits per channel
+    ihdr[9] = c == 1 ? 0 : c == 3 ? 2 : 6;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    if (ok) ok = write_chunk(f, "IHDR", ihdr, 13);
+    static const uchar zlib_header[2] = {0x78, 0x01};
+    if (ok) ok = write_chunk(f, "IDAT", zlib_header, 2);
+    return true;
+  }
+
+  // Wait for the oldest band and write it:
+  void write_one() {
+    PngBand& b = band[first];
+    ThreadPool::shared()->wait(b.task);
+    if (ok && !b.ok) ok = false;
+    if (ok) ok = write_chunk(f, "IDAT", b.out, b.out_size);
+    adler = adler32_combine(adler, b.adler, b.raw_size);
+    free(b.out);
+    first = (first+1)%QUEUE;
+    count--;
+  }
+
+  void add(const uchar* pixels, uchar* own, PixelType type, int w, int rows,
+	   int linedelta, int level, bool last) {
+    if (count >= limit) write_one();
+    PngBand& b = band[(first+count)%QUEUE];
+    memset(&b, 0, sizeof(b));
+    b.pixels = pixels;
+    b.own = own;
+    b.type = type;
+    b.w = w;
+    b.rows = rows;
+    b.linedelta = linedelta;
+    b.level = level;
+    b.last = last;
+    count++;
+    b.task = ThreadPool::shared()->add(compress_band, &b, ThreadPool::HIGH);
+  }
+
+  bool end() {
+    while (count) write_one();
+    uchar b[4];
+    put32(b, adler);
+    if (ok) ok = write_chunk(f, "IDAT", b, 4);
+    if (ok) ok = write_chunk(f, "IEND", 0, 0);
+    if (fclose(f)) ok = false;
+    return ok;
+  }
+};
+
+static inline int clamp_level(int level) {
+  return level < 0 ? 0 : level > 9 ? 9 : level;
+}
+
+/*!
+  Write \a w by \a h \a pixels of \a type to a PNG file, returning
+  false if it can't. \a linedelta is the bytes from one row to the
+  next, 0 means they are packed together. Premultiplied types are
+  unpremultiplied, as PNG requires.
+
+  \a level is the zlib compression level, 0 (no compression) through
+  9. The default, 1, is many times faster than 9 and makes files a
+  little larger. The rows are compressed in bands by the threads of
+  ThreadPool::shared(), so a large image uses all the processors.
+*/
+bool fltk::write_png(const char* filename, const uchar* pixels,
+		     PixelType type, int w, int h, int linedelta, int level)
+{
+  if (!pixels || w <= 0 || h <= 0) return false;
+  if (!linedelta) linedelta = w*depth(type);
+  level = clamp_level(level);
+  PngWriter* p = new PngWriter;
+  bool ok = p->begin(filename, w, h, channels(type));
+  if (ok) {
+    int n = band_rows(w, h);
+    for (int y = 0; y < h; y += n) {
+      int rows = y+n < h ? n : h-y;
+      p->add(pixels+y*linedelta, 0, type, w, rows, linedelta, level, y+rows >= h);
+    }
+    ok = p->end();
+  }
+  delete p;
+  return ok;
+}
+
+/*!
+  Write the buffer() of \a image to a PNG file. The image is fetched
+  first if it has not been. Returns false if it has no buffer or if
+  the file can't be written.
+*/
+bool fltk::write_png(const char* filename, const Image& image, int level) {
+  image.fetch_if_needed();
+  const uchar* p = image.buffer();
+  if (!p) return false;
+  return write_png(filename, p, image.buffer_pixeltype(), image.buffer_width(),
+		   image.buffer_height(), image.buffer_linedelta(), level);
+}
+
+/*!
+  Write the area \a r of the current window (see readimage()) to a
+  PNG file. Each band of rows is read while the earlier ones are
+  being compressed, so a whole window takes about as long as
+  reading it.
+*/
+bool fltk::write_png(const char* filename, const Rectangle& r, int level) {
+  if (r.w() <= 0 || r.h() <= 0) return false;
+  level = clamp_level(level);
+  PngWriter* p = new PngWriter;
+  bool ok = p->begin(filename, r.w(), r.h(), 3);
+  if (ok) {
+    int n = band_rows(r.w(), r.h());
+    for (int y = 0; y < r.h(); y += n) {
+      int rows = y+n < r.h() ? n : r.h()-y;
+      uchar* band = read_band(r, y, rows);
+      if (!band) {p->ok = false; break;}
+      p->add(band, band, RGB, r.w(), rows, r.w()*3, level, y+rows >= r.h());
+    }
+    if (!p->ok && !p->count) fclose(p->f);
+    else ok = p->end();
+    ok = ok && p->ok;
+  }
+  delete p;
+  return ok;
+}
+
+#else
+
+bool fltk::write_png(const char*, const uchar*, PixelType, int, int, int, int) {
+  return false;
+}
+bool fltk::write_png(const char*, const Image&, int) {return false;}
+bool fltk::write_png(const char*, const Rectangle&, int) {return false;}
+
+#endif
+
+////////////////////////////////////////////////////////////////
+
+/*!
+  Write \a w by \a h \a pixels of \a type to a binary PPM file (PGM if
+  the type is MONO or MASK), returning false if it can't. Alpha is
+  thrown away. This does no compression and is the fastest way to
+  save an image if the file size does not matter.
+*/
+bool fltk::write_ppm(const char* filename, const uchar* pixels,
+		     PixelType type, int w, int h, int linedelta)
+{
+  if (!pixels || w <= 0 || h <= 0) return false;
+  if (!linedelta) linedelta = w*depth(type);
+  FILE* f = fopen(filename, "wb");
+  if (!f) return false;
+  const int c = channels(type);
+  bool gray = c == 1;
+  bool ok = fprintf(f, "P%d\n%d %d\n255\n", gray ? 5 : 6, w, h) > 0;
+  uchar* row = (uchar*)malloc(w*4);
+  for (int y = 0; ok && y < h; y++) {
+    convert_row(pixels+y*linedelta, type, w, row);
+    if (c == 4) // remove the alpha
+      for (int x = 0; x < w; x++) memmove(row+3*x, row+4*x, 3);
+    ok = fwrite(row, gray ? 1 : 3, w, f) == (size_t)w;
+  }
+  free(row);
+  if (fclose(f)) ok = false;
+  return ok;
+}
+
+/*!
+  Write the area \a r of the current window (see readimage()) to a
+  binary PPM file.
+*/
+bool fltk::write_ppm(const char* filename, const Rectangle& r) {
+  if (r.w() <= 0 || r.h() <= 0) return false;
+  FILE* f = fopen(filename, "wb");
+  if (!f) return false;
+  bool ok = fprintf(f, "P6\n%d %d\n255\n", r.w(), r.h()) > 0;
+  int n = band_rows(r.w(), r.h());
+  for (int y = 0; ok && y < r.h(); y += n) {
+    int rows = y+n < r.h() ? n : r.h()-y;
+    uchar* band = read_band(r, y, rows);
+    ok = band && fwrite(band, r.w()*3, rows, f) == (size_t)rows;
+    free(band);
+  }
+  if (fclose(f)) ok = false;
+  return ok;
+}
+
+//
+// End of "$Id$".
+//
@@ -81,7 +81,7 @@ void AlignGroup::layout() {
 
     o->resize(X,Y,W,H);
     o->align(align());
-    o->layout();
+    layout_child(*o);
 
     if (++u == n_to_break()) {
       u = 0; v++;
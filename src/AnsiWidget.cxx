@@ -33,6 +33,7 @@
 #include <fltk/Image.h>
 #include <fltk/rgbImage.h>
 #include <fltk/events.h>
+#include <fltk/damage.h>
 #include <fltk/draw.h>
 #include <fltk/Font.h>
 #include <fltk/Rectangle.h>
@@ -116,6 +117,7 @@ AnsiWidget::AnsiWidget(int x, int y, int w, int h, int defsize) :
   init();
   reset();
   img = 0;
+  dirty.set(0, 0, 0, 0);
   resized = false;
 }
 
@@ -183,15 +185,38 @@ void AnsiWidget::layout() {
   Widget::layout();
 }
 
+/*! Adds the given area of the offscreen buffer to the part that
+  draw() copies to the window. Any number of calls before the window
+  is next drawn are copied at once.
+ */
+void AnsiWidget::addDirty(int x, int y, int width, int height) {
+  dirty.merge(Rectangle(x, y, width, height));
+  redraw(DAMAGE_VALUE);
+}
+
 /*! output the offscreen buffer 
  */
 void AnsiWidget::draw() {
+  // when only the offscreen buffer changed, only copy that part:
+  Rectangle r(w(), h());
+  if (img && !resized && !(damage() & ~DAMAGE_VALUE)) {
+    r.intersect(dirty);
+  }
+  dirty.set(0, 0, 0, 0);
+  if (r.empty()) {
+    return;
+  }
+
   // ensure this widget has lowest z-order
   int siblings = parent()->children();
   for (int n = 0; n < siblings; n++) {
     Widget* w = parent()->child(n);
     if (w != this) {
-      w->redraw();
+      Rectangle o(w->x()-x(), w->y()-y(), w->w(), w->h());
+      o.intersect(r);
+      if (!o.empty()) {
+        w->redraw();
+      }
     }
   }
   if (img) {
@@ -216,7 +241,7 @@ void AnsiWidget::draw() {
       delete old;
       resized = false;
     }
-    push_clip(Rectangle(w(), h()));
+    push_clip(r);
     img->draw(Rectangle(img->w(), img->h()));
     pop_clip();
   } else {
@@ -250,13 +275,26 @@ void AnsiWidget::setColor(long fg) {
   labelcolor(ansiToFltk(fg));
 }
 
+/*! Adds the area of a line or rectangle outline between the given
+  corners to the dirty area, allowing for the line width.
+ */
+void AnsiWidget::addRectDirty(int x1, int y1, int x2, int y2) {
+  if (x2 < x1) {
+    int t = x1; x1 = x2; x2 = t;
+  }
+  if (y2 < y1) {
+    int t = y1; y1 = y2; y2 = t;
+  }
+  addDirty(x1-1, y1-1, x2-x1+3, y2-y1+3);
+}
+
 /*! draw a line onto the offscreen buffer
  */
 void AnsiWidget::drawLine(int x1, int y1, int x2, int y2) {
   begin_offscreen();
   setcolor(labelcolor());
   drawline(x1, y1, x2, y2);
-  redraw();
+  addRectDirty(x1, y1, x2, y2);
 }
 
 /*! draw a filled rectangle onto the offscreen buffer
@@ -265,7 +303,7 @@ void AnsiWidget::drawRectFilled(int x1, int y1, int x2, int y2) {
   begin_offscreen();
   setcolor(labelcolor());
   fillrect(Rectangle(x1, y1, x2-x1, y2-y1));
-  redraw();
+  addDirty(x1, y1, x2-x1, y2-y1);
 }
 
 /*! draw a rectangle onto the offscreen buffer
@@ -277,7 +315,7 @@ void AnsiWidget::drawRect(int x1, int y1, int x2, int y2) {
   drawline(x1, y2, x2, y2);
   drawline(x2, y2, x2, y1);
   drawline(x2, y1, x1, y1);
-  redraw();
+  addRectDirty(x1, y1, x2, y2);
 }
 
 /*! draws the given image onto the offscreen buffer
@@ -287,7 +325,7 @@ void AnsiWidget::drawImage(Image* image, int x, int y, int sx, int sy,
   begin_offscreen();
   image->draw(Rectangle(sx, sy, width, height), // from
               Rectangle(x, y, width, height)); // to
-  redraw();
+  addDirty(x, y, width, height);
 }
 
 /*! save the offscreen buffer to the given filename
@@ -324,7 +362,7 @@ void AnsiWidget::setPixel(int x, int y, int c) {
   setcolor(ansiToFltk(c));
   drawpoint(x,y);
 #endif
-  redraw();
+  addDirty(x, y, 1, 1);
 }
 
 /*! returns the color of the pixel at the given xy location
@@ -388,6 +426,7 @@ void AnsiWidget::newLine() {
   curX = INITXY;
   if (curY+(fontHeight*2) >= height) {
     scrollrect(Rectangle(w(), height), 0, -fontHeight, eraseBottomLine, this);
+    redraw();
   } else {
     curY += fontHeight;
   }
@@ -427,6 +466,7 @@ bool AnsiWidget::setGraphicsRendition(char c, int escValue) {
   case 'K': // \e[K - clear to eol
     setcolor(color());
     fillrect(Rectangle(curX, curY, w()-curX, (int)(getascent()+getdescent())));
+    addDirty(curX, curY, w()-curX, (int)(getascent()+getdescent()));
     break;
   case 'G': // move to column
     curX = escValue;
@@ -608,6 +648,7 @@ void AnsiWidget::print(const char *str) {
       init();
       setcolor(color());
       fillrect(Rectangle(w(), h()));
+      redraw();
       break;
     case '\033':  // ESC ctrl chars
       if (*(p+1) == '[' ) {
@@ -624,24 +665,34 @@ void AnsiWidget::print(const char *str) {
       curX = INITXY;
       setcolor(color());
       fillrect(Rectangle(0, curY, w(), fontHeight));
+      addDirty(0, curY, w(), fontHeight);
       break;
     default:
-      int numChars = 1; // print minimum of one character
-      int cx = (int)getwidth((const char*)p, 1);
+      // measure all the non-control, non-null characters at once,
+      // which is enough unless they run past the end of the line
+      int numChars = 1;
+      while (p[numChars] > 31) {
+        numChars++;
+      }
+      int cx = (int)getwidth((const char*)p, numChars);
       int width = w()-1;
 
       if (curX + cx >= width) {
-        newLine();
-      }
+        numChars = 1; // print minimum of one character
+        cx = (int)getwidth((const char*)p, 1);
 
-      // print further non-control, non-null characters 
-      // up to the width of the line
-      while (p[numChars] > 31) {
-        cx += (int)getwidth((const char*)p+numChars, 1);
-        if (curX + cx < width) {
-          numChars++;
-        } else {
-          break;
+        if (curX + cx >= width) {
+          newLine();
+        }
+
+        // print further characters up to the width of the line
+        while (p[numChars] > 31) {
+          cx += (int)getwidth((const char*)p+numChars, 1);
+          if (curX + cx < width) {
+            numChars++;
+          } else {
+            break;
+          }
         }
       }
             
@@ -660,6 +711,7 @@ void AnsiWidget::print(const char *str) {
       if (underline) {
         drawline(curX, curY+ascent+1, curX+cx, curY+ascent+1);
       }
+      addDirty(curX, curY, cx+1, fontHeight > ascent+2 ? fontHeight : ascent+2);
             
       // advance
       p += numChars-1; // allow for p++ 
@@ -671,8 +723,6 @@ void AnsiWidget::print(const char *str) {
     }
     p++;
   }
-
-  redraw();
 }
 
 /*! 
@@ -0,0 +1,288 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+#include <fltk/AsyncList.h>
+#include <fltk/Browser.h>
+#include <fltk/damage.h>
+#include <fltk/run.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+/*! \class fltk::AsyncList
+
+  A StringList for rows that take a while to get, such as ones from a
+  remote database. Rows that are not there yet are shown with
+  pending_label(), and the ones the browser wants, plus about a
+  screenful before and after, are asked for in bulk by calling
+  request(). That must not wait for them; another thread (or a later
+  callback) calls arrived() when they are there, and then only the
+  rows that are shown are redrawn. arrived() may be called by any
+  thread, once the main thread has called fltk::lock(). label() is
+  only called for rows that have arrived.
+
+  Browser::layout() looks at every row unless Browser::fixed_item_h()
+  is set, which would request all of them, so set that on a browser
+  using this.
+
+\code
+class MyList : public fltk::AsyncList {
+  int children(const fltk::Menu*) {return number_of_rows;}
+  const char* label(const fltk::Menu*, int row) {return cache[row];}
+  void request(const fltk::Menu* menu, int first, int n) {
+    start_query(menu, first, n); // calls arrived(menu, first, n) when done
+  }
+};
+\endcode
+
+  Call reset() when the data changes so everything is asked for again,
+  and forget() before a menu using this is destroyed.
+*/
+
+// Sorted [first,last) pairs of rows:
+struct Ranges {
+  int* r;
+  int n;
+  int size;
+};
+
+struct fltk::AsyncListMenu {
+  AsyncListMenu* next;
+  const Menu* menu;
+  Ranges arrived;	// rows that are here
+  Ranges requested;	// rows that are here or asked for
+  int wantfirst, wantlast; // missing rows drawn since the last request
+  int visible;		// from visible_items(), zero if not a Browser
+};
+
+// Return the first pair that ends after x:
+static int ranges_index(const Ranges& r, int x) {
+  int a = 0, b = r.n;
+  while (a < b) {
+    int m = (a+b)/2;
+    if (r.r[2*m+1] <= x) a = m+1; else b = m;
+  }
+  return a;
+}
+
+static bool ranges_contain(const Ranges& r, int x) {
+  int i = ranges_index(r, x);
+  return i < r.n && r.r[2*i] <= x;
+}
+
+static void ranges_add(Ranges& r, int first, int last) {
+  if (first >= last) return;
+  // pairs i..j-1 touch or overlap the new one and are merged into it:
+  int i = ranges_index(r, first-1);
+  int j = i;
+  while (j < r.n && r.r[2*j] <= last) j++;
+  if (j > i) {
+    if (r.r[2*i] < first) first = r.r[2*i];
+    if (r.r[2*j-1] > last) last = r.r[2*j-1];
+  }
+  int n = r.n - (j-i) + 1;
+  if (n > r.size) {
+    r.size = 2*n;
+    r.r = (int*)realloc(r.r, 2*r.size*sizeof(int));
+  }
+  memmove(r.r+2*(i+1), r.r+2*j, 2*(r.n-j)*sizeof(int));
+  r.r[2*i] = first;
+  r.r[2*i+1] = last;
+  r.n = n;
+}
+
+AsyncList::AsyncList() {
+  menus_ = 0;
+  pending_label_ = "...";
+  pending_ = false;
+}
+
+AsyncList::~AsyncList() {
+  remove_check(request_cb, this);
+  while (menus_) forget(menus_->menu);
+}
+
+AsyncListMenu* AsyncList::find(const Menu* menu, bool create) {
+  AsyncListMenu* m;
+  for (m = menus_; m; m = m->next) if (m->menu == menu) return m;
+  if (!create) return 0;
+  m = (AsyncListMenu*)calloc(1, sizeof(AsyncListMenu));
+  m->menu = menu;
+  m->next = menus_;
+  menus_ = m;
+  return m;
+}
+
+/*!
+  Returns the generated item labelled by label(), or by pending_label()
+  if the row has not arrived, in which case it is also remembered so
+  it gets requested.
+*/
+Widget* AsyncList::child(const Menu* menu, const int* indexes, int level) {
+  if (level) return 0;
+  int row = indexes[0];
+  AsyncListMenu* m = find(menu, true);
+  pending_ = !ranges_contain(m->arrived, row);
+  if (pending_ && !ranges_contain(m->requested, row)) {
+    if (m->wantfirst >= m->wantlast) {
+      m->wantfirst = row;
+      m->wantlast = row+1;
+    } else {
+      if (row < m->wantfirst) m->wantfirst = row;
+      if (row >= m->wantlast) m->wantlast = row+1;
+    }
+    if (!has_check(request_cb, this)) add_check(request_cb, this);
+  }
+  return StringHierarchy::child(menu, indexes, level);
+}
+
+const char* AsyncList::label(const Menu* menu, const int* indexes, int level) {
+  if (pending_) return pending_label_;
+  return label(menu, indexes[0]);
+}
+
+/*! Remembers how many rows a Browser shows, to choose how many more
+  to request before and after the ones it wants. */
+void AsyncList::visible_items(const Menu* menu, int n) {
+  find(menu, true)->visible = n;
+}
+
+// Ask for the wanted rows plus a margin, leaving out the ones that were
+// asked for already. This is done once all the drawing is finished:
+void AsyncList::request_cb(void* v) {
+  AsyncList* list = (AsyncList*)v;
+  remove_check(request_cb, v);
+  for (AsyncListMenu* m = list->menus_; m; m = m->next) {
+    if (m->wantfirst >= m->wantlast) continue;
+    int margin = m->visible ? m->visible : 32;
+    int first = m->wantfirst - margin;
+    if (first < 0) first = 0;
+    int last = m->wantlast + margin;
+    int rows = list->children(m->menu);
+    if (last > rows) last = rows;
+    m->wantfirst = m->wantlast = 0;
+    int p = first;
+    while (p < last) {
+      int i = ranges_index(m->requested, p);
+      if (i < m->requested.n && m->requested.r[2*i] <= p) {
+	p = m->requested.r[2*i+1];
+	continue;
+      }
+      int q = i < m->requested.n ? m->requested.r[2*i] : last;
+      if (q > last) q = last;
+      ranges_add(m->requested, p, q);
+      list->request(m->menu, p, q-p);
+      p = q;
+    }
+  }
+}
+
+struct ArrivedMessage {
+  AsyncList* list;
+  const Menu* menu;
+  int first, n;
+};
+
+void AsyncList::arrived_cb(void* v) {
+  ArrivedMessage* a = (ArrivedMessage*)v;
+  a->list->do_arrived(a->menu, a->first, a->n);
+  delete a;
+}
+
+/*!
+  Tell it that \a n rows starting at \a first can now be returned by
+  label(). This may be called by any thread; if it is not the main
+  thread the change is sent with fltk::post(), so label() must work
+  for these rows from then on. The rows that are shown are redrawn.
+*/
+void AsyncList::arrived(const Menu* menu, int first, int n) {
+  if (in_main_thread()) {
+    do_arrived(menu, first, n);
+  } else {
+    ArrivedMessage* a = new ArrivedMessage;
+    a->list = this;
+    a->menu = menu;
+    a->first = first;
+    a->n = n;
+    post(arrived_cb, a);
+  }
+}
+
+void AsyncList::do_arrived(const Menu* menu, int first, int n) {
+  AsyncListMenu* m = find(menu, false);
+  if (!m || n <= 0) return;
+  ranges_add(m->arrived, first, first+n);
+  ranges_add(m->requested, first, first+n);
+  if (!m->visible) {
+    ((Menu*)menu)->redraw(DAMAGE_CONTENTS);
+    return;
+  }
+  // redraw the arrived rows that are shown:
+  Browser* b = (Browser*)menu;
+  int a = b->topline();
+  int z = a + m->visible;
+  if (a < first) a = first;
+  if (z > first+n) z = first+n;
+  for (; a < z; a++) {
+    b->goto_index(a);
+    b->damage_item();
+  }
+}
+
+/*! Returns true if \a row has arrived. */
+bool AsyncList::ready(const Menu* menu, int row) {
+  AsyncListMenu* m = find(menu, false);
+  return m && ranges_contain(m->arrived, row);
+}
+
+/*! Forget which rows have arrived or been requested, so they are
+  all requested again. Call this when the data changes. */
+void AsyncList::reset(const Menu* menu) {
+  AsyncListMenu* m = find(menu, false);
+  if (!m) return;
+  m->arrived.n = m->requested.n = 0;
+  m->wantfirst = m->wantlast = 0;
+  ((Menu*)menu)->relayout();
+  ((Menu*)menu)->redraw();
+}
+
+/*! Throw away everything remembered about \a menu. Call this before
+  the menu is destroyed. Rows arriving for it afterwards are ignored. */
+void AsyncList::forget(const Menu* menu) {
+  for (AsyncListMenu** p = &menus_; *p; p = &(*p)->next) {
+    AsyncListMenu* m = *p;
+    if (m->menu != menu) continue;
+    *p = m->next;
+    free(m->arrived.r);
+    free(m->requested.r);
+    free(m);
+    return;
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -236,13 +236,24 @@ Widget* Browser::goto_top() {
   if (siblings <= 0) {
     item(0);
   } else {
-    item(child(HERE.indexes,0));
+    fetch_item(0);
     // skip leading invisible widgets:
     if (!item()->visible()) return next_visible();
   }
   return item();
 }
 
+// Make item() be the widget for HERE. With row_selection() the
+// SELECTED flag of a top-level row comes from selected_rows_, so it is
+// right even if the List reuses the widgets:
+Widget* Browser::fetch_item(int level) {
+  Widget* w = child(HERE.indexes, level);
+  item(w);
+  if (w && !level && row_selection_ && multi())
+    w->set_flag(SELECTED, selected_rows_.contains(HERE.indexes[0]));
+  return w;
+}
+
 /*! \fn Widget* Browser::goto_focus()
   Sets the item() to the "focus" (the item with the dotted square in
   an fltk::MultiBrowser, and the selected item in a normal
@@ -260,7 +271,7 @@ Widget* Browser::goto_mark(const Mark& mark) {
     siblings = children(HERE.indexes, L);
     if (i < 0 || i >= siblings) {item(0); return 0;}
   }
-  item(child(HERE.indexes, HERE.level));
+  fetch_item(HERE.level);
   return item();
 }
 
@@ -352,9 +363,61 @@ bool Browser::item_is_open() const {
 */
 int Browser::item_h() const {
   if (!item()->h()) item()->layout();
+  if (fixed_item_h_) return fixed_item_h_;
   return item()->h();
 }
 
+/*! Tell the browser that every item is \a h pixels tall, so layout()
+  and scrolling do not have to measure them. layout() then only looks
+  at the items that are shown, and finding the item at a position takes
+  constant time, which is useful for an fltk::List with a huge number
+  of items. This only works for a flat browser where every item is
+  visible, and width() only includes the items that have been shown.
+  Zero, the default, measures every item.
+*/
+void Browser::fixed_item_h(int h) {
+  if (h < 0) h = 0;
+  if (h == fixed_item_h_) return;
+  fixed_item_h_ = h;
+  relayout();
+}
+
+// When not fixed_item_h(), layout() puts the height of each top-level
+// item, plus its open children, in a Fenwick tree, so the position of
+// an item and the item at a position can be found in O(log n) time
+// without walking all the items before it.
+
+/*! True if the height index can be used to find top-level items */
+bool Browser::heights_ok() const {
+  if (layout_damage()) return false;
+  if (fixed_item_h_) return true;
+  return heights_ && nheights_ == children();
+}
+
+/*! The position of the top of top-level item \a i */
+int Browser::toplevel_position(int i) const {
+  if (fixed_item_h_) return i*fixed_item_h_;
+  int y = 0;
+  for (; i > 0; i -= i & -i) y += heights_[i];
+  return y;
+}
+
+/*! Set the current item to the \a i'th top-level item using the height
+  index, or to the visible item after it if it is invisible.
+  heights_ok() must be true. */
+Widget* Browser::goto_toplevel(int i) {
+  HERE.level = 0;
+  HERE.open_level = 0;
+  siblings = children(HERE.indexes, 0);
+  if (i >= siblings) i = siblings-1;
+  if (i < 0) {HERE.indexes[0] = 0; HERE.position = 0; item(0); return 0;}
+  HERE.indexes[0] = i;
+  HERE.position = toplevel_position(i);
+  fetch_item(0);
+  if (!item()->visible()) return next_visible();
+  return item();
+}
+
 /*! Move forward to the next visible Item (what the down-arrow does).
   This does not move and returns null if we are at the bottom.
   \return The next visible Item's Widget or NULL if this isn't possible
@@ -392,7 +455,7 @@ Widget* Browser::next_visible() {
       continue;
     }
 
-    item(child(HERE.indexes, HERE.level));
+    fetch_item(HERE.level);
 
     // skip invisible items:
     if (item()->visible()) break;
@@ -424,14 +487,14 @@ Widget* Browser::previous_visible() {
 	return 0;
       }
       HERE.open_level = --HERE.level;
-      item(child(HERE.indexes, HERE.level));
+      fetch_item(HERE.level);
       siblings = children(HERE.indexes, HERE.level);
       break;
     }
 
     // go back to previous item in this group:
     HERE.indexes[HERE.level] --;
-    item(child(HERE.indexes, HERE.level));
+    fetch_item(HERE.level);
 
     // go to last child in a group:
     while (item_is_open() && item()->visible() && item_is_parent()) {
@@ -440,7 +503,7 @@ Widget* Browser::previous_visible() {
       set_level(HERE.level+1);
       HERE.open_level = HERE.level;
       HERE.indexes[HERE.level] = n-1;
-      item(child(HERE.indexes, HERE.level));
+      fetch_item(HERE.level);
       siblings = n;
     }
 
@@ -475,7 +538,7 @@ Widget* Browser::next() {
   }
   for (;;) {
     if (HERE.indexes[HERE.level] < siblings) {
-      item(child(HERE.indexes, HERE.level));
+      fetch_item(HERE.level);
       return item();
     }
     if (HERE.level <= 0) {item(0); return 0;}
@@ -491,7 +554,26 @@ Widget* Browser::next() {
   \return The last Item's Widget whose top is at or before \a Y*/
 Widget* Browser::goto_position(int Y) {
   if (Y < 0) Y = 0;
-  if (layout_damage() || Y<=yposition_/2 || !goto_mark(FIRST_VISIBLE)) {
+  if (heights_ok()) {
+    // find the top-level item using the height index:
+    int i = 0;
+    if (fixed_item_h_) {
+      i = Y/fixed_item_h_;
+    } else {
+      int y = 0;
+      int step = 1;
+      while (2*step <= nheights_) step *= 2;
+      for (; step; step /= 2)
+	if (i+step <= nheights_ && y+heights_[i+step] <= Y) {
+	  i += step;
+	  y += heights_[i];
+	}
+    }
+    if (!goto_toplevel(i)) {
+      if (!previous_visible()) {goto_top(); return item();}
+      if (HERE.position+item_h() <= Y) return 0;
+    }
+  } else if (layout_damage() || Y<=yposition_/2 || !goto_mark(FIRST_VISIBLE)) {
     goto_top();
   } else {
     // move backwards until we are before or at the position:
@@ -841,6 +923,107 @@ void Browser::draw() {
 ////////////////////////////////////////////////////////////////
 // Scrolling and layout:
 
+// layout() remembers the total height and width of the visible
+// children of each open parent, found by its path of indexes. This
+// lets set_item_opened() change the height index by that amount
+// rather than measuring everything again, and makes closing a parent
+// and opening it again take the same time no matter how many children
+// it has. It is thrown away whenever layout() measures everything.
+namespace fltk {
+struct BrowserSubtrees {
+  struct Entry {
+    int* path; // 0 if this entry is empty
+    unsigned level;
+    int height, width;
+  };
+  Entry* entries;
+  unsigned size, n;
+  BrowserSubtrees() : entries(0), size(0), n(0) {}
+  ~BrowserSubtrees() {clear(); delete[] entries;}
+  static unsigned hash(const int* path, unsigned level) {
+    unsigned h = level;
+    for (unsigned i = 0; i <= level; i++) h = (h^unsigned(path[i]))*16777619u;
+    return h;
+  }
+  Entry* slot(const int* path, unsigned level) const {
+    for (unsigned i = hash(path, level);; i++) {
+      Entry* e = entries+(i&(size-1));
+      if (!e->path) return e;
+      if (e->level == level && !memcmp(e->path, path, (level+1)*sizeof(int)))
+	return e;
+    }
+  }
+  Entry* find(const int* path, unsigned level) const {
+    if (!n) return 0;
+    Entry* e = slot(path, level);
+    return e->path ? e : 0;
+  }
+  void set(const int* path, unsigned level, int height, int width) {
+    if (2*(n+1) > size) {
+      Entry* old = entries;
+      unsigned oldsize = size;
+      size = size ? 2*size : 64;
+      entries = new Entry[size];
+      for (unsigned i = 0; i < size; i++) entries[i].path = 0;
+      for (unsigned i = 0; i < oldsize; i++)
+	if (old[i].path) *slot(old[i].path, old[i].level) = old[i];
+      delete[] old;
+    }
+    Entry* e = slot(path, level);
+    if (!e->path) {
+      e->path = new int[level+1];
+      memcpy(e->path, path, (level+1)*sizeof(int));
+      e->level = level;
+      n++;
+    }
+    e->height = height;
+    e->width = width;
+  }
+  void clear() {
+    for (unsigned i = 0; i < size; i++) {delete[] entries[i].path; entries[i].path = 0;}
+    n = 0;
+  }
+};
+}
+
+// The open parents above the item being measured:
+struct OpenParents {
+  struct Parent {int* path; unsigned level; int position, h, width;};
+  Parent* parents;
+  int n, size;
+  OpenParents() : parents(0), n(0), size(0) {}
+  ~OpenParents() {while (n) delete[] parents[--n].path; delete[] parents;}
+  void push(const int* path, unsigned level, int position, int h) {
+    if (n >= size) {
+      size = size ? 2*size : 16;
+      Parent* p = new Parent[size];
+      memcpy(p, parents, n*sizeof(Parent));
+      delete[] parents;
+      parents = p;
+    }
+    Parent& p = parents[n++];
+    p.path = new int[level+1];
+    memcpy(p.path, path, (level+1)*sizeof(int));
+    p.level = level;
+    p.position = position;
+    p.h = h;
+    p.width = 0;
+  }
+  // The item at position is at level, so the parents at that level or
+  // deeper have ended:
+  void close(unsigned level, int position, BrowserSubtrees* subtrees) {
+    while (n && parents[n-1].level >= level) {
+      Parent& p = parents[--n];
+      subtrees->set(p.path, p.level, position-p.position-p.h, p.width);
+      if (n && p.width > parents[n-1].width) parents[n-1].width = p.width;
+      delete[] p.path;
+    }
+  }
+  void measured(int width) {
+    if (n && width > parents[n-1].width) parents[n-1].width = width;
+  }
+};
+
 /*! Opens the current item (which must be a parent)
   \param open If the current item is a parent, set the open state (the
   fltk::STATE flags) to the given value and redraw the browser
@@ -861,10 +1044,86 @@ bool Browser::set_item_opened(bool open)
     }
   }
   list()->flags_changed(this, item());
+  if (!open_incrementally(open)) skip_measure_ = false;
   relayout(LAYOUT_CHILD);
   return true;
 }
 
+// Move a mark after a parent that was opened or closed:
+void Browser::shift_mark(Mark& mark, const Mark& node, int dy) {
+  if (mark.is_set() && mark.compare(node) >= 2) mark.position += dy;
+}
+
+// Change the height index for opening or closing the current item,
+// only measuring its children if they have not been measured before.
+// Returns false if layout() has to measure everything instead.
+bool Browser::open_incrementally(bool open) {
+  if (!subtrees_ || fixed_item_h_ || layout_damage()) return false;
+  if (!heights_ || nheights_ != children()) return false;
+  if (!item_is_visible() || FIRST_VISIBLE.compare(HERE) > 0) return false;
+  Mark NODE(HERE);
+  // the focus inside it is moved to where it is now, if it is measured:
+  bool focus_inside = FOCUS.is_set() && FOCUS.compare(NODE) == 1;
+  // HERE.position is only right if HERE was found by moving through the
+  // visible items, but the position of a top-level item is known:
+  int top = toplevel_position(NODE.indexes[0]);
+  if (!NODE.level) NODE.position = top;
+  else if (open && focus_inside) return false;
+  BrowserSubtrees::Entry* e = subtrees_->find(NODE.indexes, NODE.level);
+  int arrow_size = int(textsize())|1;
+  if (!open) {
+    if (!e) return false;
+  } else if (!e || focus_inside) {
+    // measure the children as layout() does:
+    Item::set_style(this,false);
+    const int *last_columns = fltk::column_widths();
+    fltk::column_widths(column_widths_p);
+    OpenParents parents;
+    parents.push(NODE.indexes, NODE.level, NODE.position, item_h());
+    while (next_visible() && HERE.level > NODE.level) {
+      parents.close(HERE.level, HERE.position, subtrees_);
+      int border = arrow_size*HERE.level;
+      item()->x(interior.x()+border);
+      item()->w(interior.w()-border);
+      item()->layout_damage(LAYOUT_X|LAYOUT_W);
+      item()->layout();
+      parents.measured(item()->w()+border);
+      if (at_mark(FOCUS)) set_mark(FOCUS);
+      if (item_is_open() && item_is_parent())
+	parents.push(HERE.indexes, HERE.level, HERE.position, item()->h());
+    }
+    parents.close(NODE.level, HERE.position, subtrees_);
+    fltk::column_widths(last_columns);
+    Item::clear_style();
+    goto_mark(NODE);
+    e = subtrees_->find(NODE.indexes, NODE.level);
+  }
+  int dy = open ? e->height : -e->height;
+  int width = e->width;
+  // add it to the top-level item and every parent:
+  for (int i = NODE.indexes[0]+1; i <= nheights_; i += i & -i) heights_[i] += dy;
+  for (unsigned L = 0; L < NODE.level; L++) {
+    BrowserSubtrees::Entry* p = subtrees_->find(NODE.indexes, L);
+    if (!p) continue;
+    p->height += dy;
+    if (open && width > p->width) p->width = width;
+  }
+  height_ += dy;
+  if (indented()) width += arrow_size;
+  if (open && width > measured_width_) measured_width_ = width;
+  shift_mark(FOCUS, NODE, dy);
+  shift_mark(BELOWMOUSE, NODE, dy);
+  shift_mark(OPEN, NODE, dy);
+  for (int i = 0; i < NUM_REDRAW; i++) shift_mark(REDRAW[i], NODE, dy);
+  skip_measure_ = true;
+  // only what is below the top of the item (or of the top-level item
+  // it is in) changes:
+  int y = interior.y()+top-yposition_;
+  if (y < interior.y()) y = interior.y();
+  if (y < interior.b()) redraw(Rectangle(interior.x(), y, interior.w(), interior.b()-y));
+  return true;
+}
+
 /*! Turns off or on the fltk::INVISIBLE flag on the given item and
   redraw the browser if necessary. 
   \param value The new value of the flag on the given item 
@@ -881,13 +1140,17 @@ bool Browser::set_item_visible(bool value)
     item()->set_flag(INVISIBLE);
   }
   list()->flags_changed(this, item());
-  if (HERE.open_level >= HERE.level) relayout(LAYOUT_CHILD);
+  if (HERE.open_level >= HERE.level) {skip_measure_ = false; relayout(LAYOUT_CHILD);}
   return true;
 }
 
 void Browser::layout() {
   // This flag is used by relayout() to indicate that autoscroll is needed:
   bool scroll_to_item = (layout_damage()&LAYOUT_CHILD) != 0;
+  // If only set_item_opened() was done the heights are already right:
+  bool measure = !skip_measure_ || (layout_damage()&~LAYOUT_CHILD) ||
+    fixed_item_h_ || nheights_ != children();
+  skip_measure_ = false;
 
   // clear the flags first so the other methods know it is ok to measure
   // the widgets:
@@ -913,29 +1176,75 @@ void Browser::layout() {
     interior.move_y(headerh);
   }
 
+  // Tell a List that recycles widgets how many rows can be seen. The
+  // text size is a guess at the smallest item height:
+  list()->visible_items(this, h()/(int(textsize())|1)+2);
+
   // Measure the height of all items and find widest one, also
   // find vertical position of focus & first visible.
-  width_ = 0;
-  int arrow_size = int(textsize())|1;
-  bool saw_first_visible = false;
-  for (goto_top(); item(); next_visible()) {
-    int border = arrow_size*HERE.level;
-    item()->x(interior.x()+border);
-    item()->w(interior.w()-border);
-    item()->layout_damage(LAYOUT_X|LAYOUT_W);
-    item()->layout();
-    //if (!indented_ && item_is_parent()) indented_ = true;
-    int w = item()->w()+border;
-    if (w > width_) width_ = w;
-    if (at_mark(FOCUS)) set_mark(FOCUS);
-    if (!saw_first_visible && HERE.position+item()->h() > yposition_) {
-      saw_first_visible = true;
+  if (measure) {
+    width_ = 0;
+    int arrow_size = int(textsize())|1;
+    bool saw_first_visible = false;
+    int n = children();
+    if (!subtrees_) subtrees_ = new BrowserSubtrees;
+    subtrees_->clear();
+    OpenParents parents;
+    if (fixed_item_h_) {
+      // only the items that are shown are measured:
+      height_ = n*fixed_item_h_;
+      goto_position(yposition_);
       set_mark(FIRST_VISIBLE);
+      saw_first_visible = true;
+      if (FOCUS.is_set() && !FOCUS.level)
+	FOCUS.position = FOCUS.indexes[0]*fixed_item_h_;
+    } else {
+      if (n > heights_size_) {
+	delete[] heights_;
+	heights_size_ = n;
+	heights_ = new int[n+1];
+      }
+      if (heights_) memset(heights_, 0, (n+1)*sizeof(int));
+      nheights_ = n;
+      goto_top();
+    }
+    for (; item(); next_visible()) {
+      if (fixed_item_h_ && HERE.position >= yposition_+h()) break;
+      int border = arrow_size*HERE.level;
+      item()->x(interior.x()+border);
+      item()->w(interior.w()-border);
+      item()->layout_damage(LAYOUT_X|LAYOUT_W);
+      item()->layout();
+      //if (!indented_ && item_is_parent()) indented_ = true;
+      int w = item()->w()+border;
+      if (w > width_) width_ = w;
+      if (fixed_item_h_) continue;
+      parents.close(HERE.level, HERE.position, subtrees_);
+      parents.measured(w);
+      if (item_is_open() && item_is_parent())
+	parents.push(HERE.indexes, HERE.level, HERE.position, item()->h());
+      heights_[HERE.indexes[0]+1] += item()->h();
+      if (at_mark(FOCUS)) set_mark(FOCUS);
+      if (!saw_first_visible && HERE.position+item()->h() > yposition_) {
+	saw_first_visible = true;
+	set_mark(FIRST_VISIBLE);
+      }
     }
+    if (!saw_first_visible) set_mark(FIRST_VISIBLE);
+    if (indented()) width_ += arrow_size;
+    if (!fixed_item_h_) {
+      height_ = HERE.position;
+      parents.close(0, height_, subtrees_);
+      // turn the heights into a Fenwick tree:
+      for (int i = 1; i <= n; i++) {
+	int j = i + (i & -i);
+	if (j <= n) heights_[j] += heights_[i];
+      }
+    }
+    measured_width_ = width_;
+  } else {
+    width_ = measured_width_;
   }
-  if (!saw_first_visible) set_mark(FIRST_VISIBLE);
-  if (indented()) width_ += arrow_size;
-  height_ = HERE.position;
 
   // Do we have flexible column?
   bool has_flex = false;
@@ -1042,13 +1351,16 @@ void Browser::layout() {
   layout_damage(0); // resize of scrollbars may have turned this on
 
   // Now that we got the sizes of everything, scroll to show current item:
+  int old_yposition = yposition_;
   if (scroll_to_item) {
     goto_mark(FOCUS);
     if (!item()) yposition(0);
     else make_item_visible(NOSCROLL);
   }
 
-  redraw(DAMAGE_CONTENTS); // assumme we need to redraw
+  // set_item_opened() already redrew the part that changed:
+  if (measure || yposition_ != old_yposition)
+    redraw(DAMAGE_CONTENTS); // assumme we need to redraw
   fltk::column_widths(last_columns);
   Item::clear_style();
 }
@@ -1229,12 +1541,22 @@ bool Browser::set_item_selected(bool value, int do_callback) {
   if(!item()) return false;
 
   if (multi()) {
-    if (value) {
+    if (row_selection_ && !HERE.level) {
+      int row = HERE.indexes[0];
+      if (value) {
+	if (!selected_rows_.add(row)) return false;
+      } else {
+	if (!selected_rows_.remove(row)) return false;
+      }
+      item()->set_flag(SELECTED, value);
+    } else if (value) {
       if (item()->selected()) return false;
       item()->set_selected();
+      if (row_selection_) nested_selected_++;
     } else {
       if (!item()->selected()) return false;
       item()->clear_selected();
+      if (row_selection_ && nested_selected_) nested_selected_--;
     }
     list()->flags_changed(this, item());
     damage_item(HERE);
@@ -1290,6 +1612,34 @@ bool Browser::deselect(int do_callback) {
 	  selected\n returns true otherwise
 */
 bool Browser::select_only_this(int do_callback) {
+  if (multi() && row_selection_ && !(when() & do_callback)) {
+    // Change selected_rows_ all at once, rather than visiting every row:
+    int row = item() && !HERE.level ? HERE.indexes[0] : -1;
+    set_focus();
+    bool ret = false;
+    if (selected_rows_.remove(0, row)) ret = true;
+    if (selected_rows_.remove(row+1, 0x7fffffff)) ret = true;
+    if (row >= 0) {
+      if (selected_rows_.add(row)) ret = true;
+      item()->set_selected();
+    }
+    if (nested_selected_) {
+      nodamage = true;
+      if (goto_top()) do {
+	if (HERE.level && !at_mark(FOCUS))
+	  if (set_item_selected(false,do_callback)) ret = true;
+      } while (next());
+      nodamage = false;
+      goto_mark(FOCUS);
+    }
+    // a focus below the top level still uses the SELECTED flag:
+    if (row < 0 && item() && set_item_selected(true,do_callback)) ret = true;
+    if (ret) {
+      redraw(DAMAGE_CONTENTS);
+      if (do_callback) set_changed();
+    }
+    return ret;
+  }
   if (multi()) {
     set_focus();
     bool ret = false;
@@ -1458,7 +1808,16 @@ int Browser::handle(int event) {
       }
       return 1;
     }
-    if (multi()) {
+    if (multi() && row_selection_ && !(when() & WHEN_CHANGED) &&
+	FOCUS.is_set() && !FOCUS.level && (!hit || !HERE.level)) {
+      // select the range of rows all at once:
+      int from = FOCUS.indexes[0];
+      int to = hit ? HERE.indexes[0] : children()-1;
+      if (to < from) {int t = to; to = from; from = t;}
+      if (!hit) goto_index(to);
+      select_rows(from, to+1, drag_type, WHEN_CHANGED);
+      set_focus();
+    } else if (multi()) {
       if (hit) {
         int direction = FOCUS.compare(HERE);
         if (direction) {
@@ -1553,9 +1912,17 @@ int Browser::handle(int event) {
       clear_changed();
       execute(item());
       return 1;
-    default:
+    default: {
+      int i = type_ahead(value());
+      if (i >= 0 && goto_index(i)) {
+	bool did_callback = when()&WHEN_CHANGED;
+	select_only_this(WHEN_CHANGED);
+	if (did_callback) return 1;
+	goto RELEASE;
+      }
       if (scrollbar.send(event)) return 1;
       if (hscrollbar.send(event)) return 1;
+      }
     }
     break;
 
@@ -1627,9 +1994,12 @@ Widget* Browser::goto_index(const int* indexes, unsigned level) {
     HERE.indexes[0] = 0;
     siblings = children(HERE.indexes,0);
     if (siblings <= 0) {item(0); return 0;}// empty browser
-    item(child(HERE.indexes,0));
+    fetch_item(0);
     // quit if this is correct:
     if (!level && !indexes[0]) return item();
+  } else if (heights_ok()) {
+    // jump to the top-level item using the height index:
+    goto_toplevel(indexes[0]);
   } else {
     // move from the focus backwards until we are before it:
     while (::compare_marks(HERE.indexes,HERE.level,indexes,level)>0)
@@ -1646,7 +2016,7 @@ Widget* Browser::goto_index(const int* indexes, unsigned level) {
   set_level(level);
   for (unsigned n = 0; n <= level; n++)
     HERE.indexes[n] = indexes[n];
-  item(child(HERE.indexes, HERE.level));
+  fetch_item(HERE.level);
   return item();
 }
 
@@ -1939,10 +2309,90 @@ bool Browser::select(int line, bool value) {
   \return If \a line is out of range it returns false, else returns true
 */
 bool Browser::selected(int line) {
+  if (row_selection_ && multi())
+    return line >= 0 && line < children() && selected_rows_.contains(line);
   if (!goto_index(line)) return false;
   return item()->selected();
 }
 
+/*! Select (or deselect if \a value is false) the top-level rows from
+  \a from up to but not including \a to, for a MultiBrowser. With
+  row_selection() on this takes the same time no matter how many rows
+  there are, and if when() & \a do_callback the callback is done once
+  for all of them rather than for each row. selected_rows().callback()
+  reports which ranges changed. Without row_selection() this does
+  select(line, value) on each row.
+  \return true if any row changed.
+*/
+bool Browser::select_rows(int from, int to, bool value, int do_callback) {
+  if (from < 0) from = 0;
+  if (to > children()) to = children();
+  if (!row_selection_ || !multi()) {
+    bool ret = false;
+    for (int i = from; i < to; i++) if (select(i, value)) ret = true;
+    return ret;
+  }
+  int n = value ? selected_rows_.add(from, to) : selected_rows_.remove(from, to);
+  if (!n) return false;
+  if (item() && !HERE.level && HERE.indexes[0] >= from && HERE.indexes[0] < to)
+    item()->set_flag(SELECTED, value);
+  redraw(DAMAGE_CONTENTS);
+  if (when() & do_callback) {
+    clear_changed();
+    Mark TEMP(HERE);
+    this->do_callback();
+    goto_mark(TEMP);
+  } else if (do_callback) {
+    set_changed();
+  }
+  return true;
+}
+
+/*!
+  Turn on or off keeping the selection of a MultiBrowser in
+  selected_rows() rather than in the SELECTED flag of each item.
+  This is meant for very long flat lists: select-all, shift+click and
+  deselecting take the same time no matter how many rows there are,
+  and the selection is kept when a List reuses the widgets for rows.
+
+  The browser sets the SELECTED flag of each top-level item from
+  selected_rows() when it goes to it, so use selected(line) or
+  selected_rows() to find out what is selected rather than looking at
+  the widgets. Items below the top level still use their flags. The
+  rows are numbered, so if rows are inserted or removed call
+  deselect() or change selected_rows() to match.
+
+  Turning this on puts the currently selected items into
+  selected_rows(), turning it off sets the flags of the top-level
+  items from it.
+*/
+void Browser::row_selection(bool on) {
+  if (on == row_selection_) return;
+  Mark TEMP(HERE);
+  int n = children();
+  if (on) {
+    selected_rows_.clear();
+    nested_selected_ = 0;
+    if (goto_top()) do {
+      if (HERE.level && item()->selected()) nested_selected_++;
+    } while (next());
+    for (int i = 0; i < n; i++) {
+      Widget* w = child(&i, 0);
+      if (w && w->selected()) selected_rows_.add(i);
+    }
+    row_selection_ = true;
+  } else {
+    for (int i = 0; i < n; i++) {
+      Widget* w = child(&i, 0);
+      if (w) w->set_flag(SELECTED, selected_rows_.contains(i));
+    }
+    row_selection_ = false;
+    selected_rows_.clear();
+  }
+  goto_mark(TEMP);
+  redraw(DAMAGE_CONTENTS);
+}
+
 /*! Convenience function for non-hierarchial browsers.
   \param line The line this item is on
   \return true if the indexed item is visible,\n false otherwise
@@ -2042,6 +2492,16 @@ Browser::Browser(int X,int Y,int W,int H,const char* L)
   leaf_symbol_ = 0;
   group_symbol_ = 0;
   displaylines_ = true;
+  fixed_item_h_ = 0;
+  heights_ = 0;
+  nheights_ = heights_size_ = 0;
+  mapped_list_ = 0;
+  unmapped_list_ = 0;
+  row_selection_ = false;
+  nested_selected_ = 0;
+  subtrees_ = 0;
+  measured_width_ = 0;
+  skip_measure_ = false;
   OPEN.unset();
   Group::current(parent());
 }
@@ -2051,10 +2511,13 @@ Browser::Browser(int X,int Y,int W,int H,const char* L)
 Browser::~Browser() {
   delete[] column_widths_p;
   delete[] column_widths_i;
+  delete[] heights_;
+  delete subtrees_;
   if (header_) {
     for (int i=0; i<nHeader; i++) delete header_[i];
     delete[] header_;
   }
+  unload_mapped();
 }
 
 ////////////////////////////////////////////////////////////////
@@ -27,7 +27,9 @@
 
 #include <fltk/events.h>
 #include <fltk/Browser.h>
+#include <fltk/StringList.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 using namespace fltk;
 
@@ -40,27 +42,68 @@ using namespace fltk;
     contains no text and 1 otherwise
 */
 int Browser::load(const char *filename) {
-#define MAXBLINE 1024
-  char newtext[MAXBLINE];
-  int c;
-  int i;
+  unload_mapped();
   clear();
   if (!filename || !(filename[0])) return -1;
   FILE *fl = fopen(filename,"r");
   if (!fl) return 0;
-  i = 0;
+  int size = 1024;
+  char* newtext = (char*)malloc(size);
+  int i = 0;
+  int c;
   do {
     c = getc(fl);
-    if (c == '\n' || c <= 0 || i>=(MAXBLINE-1)) {
+    if (c == '\n' || c <= 0) {
       newtext[i] = 0;
       add(newtext);
       i = 0;
-    } else newtext[i++] = c;
+    } else {
+      if (i >= size-1) newtext = (char*)realloc(newtext, size *= 2);
+      newtext[i++] = c;
+    }
   } while (c >= 0);
+  free(newtext);
   fclose(fl);
   return 1;
 }
 
+/** Same as load(filename) if \a mapped is false. Otherwise the browser
+    is made to show the lines of the file with a MappedStringList,
+    which only makes an index of the lines rather than an Item for
+    each one. This is much faster and uses far less memory for big
+    files. The file must not be changed while the browser shows it.
+    The list() is put back by load(filename) or deleting
+    the browser.
+
+    \return 0 if the file couldn't be opened or mapped, -1 if filename
+    is NULL or the file is empty and 1 otherwise
+*/
+int Browser::load(const char *filename, bool mapped) {
+  if (!mapped) return load(filename);
+  unload_mapped();
+  clear();
+  if (!filename || !(filename[0])) return -1;
+  mapped_list_ = new MappedStringList;
+  if (!mapped_list_->load(filename)) {
+    delete mapped_list_;
+    mapped_list_ = 0;
+    return 0;
+  }
+  unmapped_list_ = list();
+  list(mapped_list_);
+  relayout();
+  redraw();
+  return mapped_list_->children(this) ? 1 : -1;
+}
+
+// Put back the list() replaced by load(filename, true):
+void Browser::unload_mapped() {
+  if (!mapped_list_) return;
+  if (list() == mapped_list_) list(unmapped_list_);
+  delete mapped_list_;
+  mapped_list_ = 0;
+}
+
 //
 // End of "$Id$".
 //
@@ -199,6 +199,12 @@ int Choice::handle(int e, const Rectangle& rectangle) {
       int i = value();
       while (++i < children) if (try_item(this,i)) return 1;
       return 1;}
+
+    default: {
+      // select the item whose name is being typed:
+      int i = type_ahead(value());
+      if (i >= 0 && try_item(this, i)) return 1;
+      return 0;}
     }
     return 0;
 
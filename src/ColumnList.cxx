@@ -0,0 +1,374 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+#include <fltk/ColumnList.h>
+#include <fltk/Browser.h>
+#include <fltk/Item.h>
+#include <fltk/Box.h>
+#include <fltk/draw.h>
+#include <fltk/run.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+/*! \class fltk::ColumnList
+
+  A List for a Browser with columns, where each row has a string in
+  each column. The strings are kept in an array for each column and
+  are drawn at the column_widths() of the browser, so no tabs have to
+  be parsed, and the width of each one is measured only once.
+
+  Clicking a column heading can sort the rows by that column. This
+  changes an array saying which row is at each position and does not
+  move the strings, and it is done in idle time, so a very large list
+  can be sorted without stopping the interface. The old order is shown
+  until it is done. The sort is stable, so sorting by one column and
+  then another leaves rows that are equal in the second one in the
+  order of the first one.
+
+\code
+fltk::ColumnList list(3);
+static void browser_cb(fltk::Widget* w, void*) {
+  if (list.column_clicked((fltk::Browser*)w)) return;
+  ... // an item was picked
+}
+...
+  for (...) {const char* row[3] = {name, size, date}; list.add(row);}
+  browser->list(&list);
+  browser->column_widths(widths);
+  browser->column_labels(labels);
+  browser->callback(browser_cb);
+\endcode
+
+  The SELECTED and OPENED flags of each row are stored so a
+  MultiBrowser keeps the selected rows when they are sorted.
+*/
+
+class fltk::ColumnListItem : public Item {
+public:
+  ColumnList* list;
+  int row;
+  ColumnListItem(ColumnList* l) : list(l), row(0) {}
+  void draw();
+  void layout();
+};
+
+// Return the width of column c of an item that is at x, whose right
+// edge is at r:
+static int cell_space(ColumnList* list, int row, int c, int x, int r) {
+  if (c == list->columns()-1) return r-x;
+  const int* widths = column_widths();
+  for (int i = 0; widths && i <= c; i++) {
+    if (!widths[i]) {widths = 0; break;}
+  }
+  if (widths) return widths[c] > 0 ? widths[c] : 0;
+  // without column widths each cell is as wide as its string:
+  return int(list->cell_width(row, c) + getsize());
+}
+
+void ColumnListItem::draw() {
+  drawstyle(style(), flags() & ~OUTPUT);
+  if (flag(SELECTED)) {
+    setbgcolor(selection_color());
+    setcolor(contrast(selection_textcolor(), getbgcolor()));
+  }
+  Rectangle r(w(),h());
+  Box* box = this->box();
+  box->draw(r);
+  Rectangle r1(r); box->inset(r1);
+  if (image()) {
+    int W = r1.w(), H = r1.h();
+    image()->measure(W, H);
+    image()->draw(Rectangle(r1.x(), r1.y()+((r1.h()-H)>>1), W, H));
+    r1.move_x(W);
+  }
+  setfont(textfont(), textsize());
+  float y = r1.y() + ((r1.h()+getascent()-getdescent())/2);
+  int x = r1.x();
+  for (int c = 0; c < list->columns(); c++) {
+    int cw = cell_space(list, row, c, x, r1.r());
+    const char* text = list->cell(row, c);
+    if (cw > 6 && text && *text) {
+      // clip only the strings that don't fit:
+      bool clip = list->cell_width(row, c) > cw-6;
+      if (clip) push_clip(x+3, r1.y(), cw-6, r1.h());
+      drawtext(text, float(x+3), y);
+      if (clip) pop_clip();
+    }
+    x += cw;
+  }
+  box->draw_symbol_overlay(r);
+}
+
+void ColumnListItem::layout() {
+  if (w() && h()) return;
+  setfont(textfont(), textsize());
+  int W = 250, H = 250;
+  measure("0", W, H);
+  H += int(leading());
+  W = 0;
+  for (int c = 0; c < list->columns(); c++) {
+    if (c < list->columns()-1) W += cell_space(list, row, c, W, 0);
+    else W += int(list->cell_width(row, c)) + 6;
+  }
+  if (image()) {
+    int iw, ih;
+    image()->measure(iw, ih);
+    W += iw;
+    if (ih > H) H = ih;
+  }
+  w(W);
+  h(H);
+  Widget::layout();
+}
+
+/*! Make an empty list with \a columns strings in each row. */
+ColumnList::ColumnList(int columns) {
+  columns_ = columns;
+  rows_ = size_ = 0;
+  cells_ = (char***)calloc(columns, sizeof(char**));
+  widths_ = (float**)calloc(columns, sizeof(float*));
+  widthfont_ = 0;
+  widthsize_ = 0;
+  rowflags_ = 0;
+  order_ = 0;
+  item_ = 0;
+  sortfrom_ = sortto_ = 0;
+  sortwidth_ = sortpos_ = 0;
+  sortmenu_ = 0;
+  sortcolumn_ = -1;
+  descending_ = false;
+  sorted_ = false;
+}
+
+ColumnList::~ColumnList() {
+  clear();
+  for (int c = 0; c < columns_; c++) {free(cells_[c]); free(widths_[c]);}
+  free(cells_);
+  free(widths_);
+  free(rowflags_);
+  free(order_);
+  delete item_;
+}
+
+void ColumnList::grow(int n) {
+  if (n <= size_) return;
+  size_ = size_ ? 2*size_ : 64;
+  if (size_ < n) size_ = n;
+  for (int c = 0; c < columns_; c++) {
+    cells_[c] = (char**)realloc(cells_[c], size_*sizeof(char*));
+    widths_[c] = (float*)realloc(widths_[c], size_*sizeof(float));
+  }
+  rowflags_ = (unsigned char*)realloc(rowflags_, size_);
+  order_ = (int*)realloc(order_, size_*sizeof(int));
+}
+
+/*!
+  Add a row to the end, with copies of the columns() strings in
+  \a cells (any of which may be null). Returns the number of the row,
+  which is what cell() and set() take. This stops a sort in progress.
+*/
+int ColumnList::add(const char* const* cells) {
+  stop_sort();
+  sorted_ = false;
+  grow(rows_+1);
+  for (int c = 0; c < columns_; c++) {
+    cells_[c][rows_] = cells[c] ? strdup(cells[c]) : 0;
+    widths_[c][rows_] = -1;
+  }
+  rowflags_[rows_] = 0;
+  order_[rows_] = rows_;
+  return rows_++;
+}
+
+/*! Replace the string in a cell with a copy of \a text. */
+void ColumnList::set(int row, int column, const char* text) {
+  free(cells_[column][row]);
+  cells_[column][row] = text ? strdup(text) : 0;
+  widths_[column][row] = -1;
+  if (column == sortcolumn_) sorted_ = false;
+}
+
+/*! Remove all the rows. */
+void ColumnList::clear() {
+  stop_sort();
+  sorted_ = false;
+  for (int c = 0; c < columns_; c++)
+    for (int r = 0; r < rows_; r++) free(cells_[c][r]);
+  rows_ = 0;
+}
+
+/*!
+  Return the width of a cell's string in the current font (set with
+  setfont()). This is remembered, and only measured again if the
+  string or font changes.
+*/
+float ColumnList::cell_width(int row, int column) {
+  if (getfont() != widthfont_ || getsize() != widthsize_) {
+    widthfont_ = getfont();
+    widthsize_ = getsize();
+    for (int c = 0; c < columns_; c++)
+      for (int r = 0; r < rows_; r++) widths_[c][r] = -1;
+  }
+  float& w = widths_[column][row];
+  if (w < 0) {
+    const char* text = cells_[column][row];
+    w = text ? getwidth(text) : 0;
+  }
+  return w;
+}
+
+int ColumnList::children(const Menu*, const int* indexes, int level) {
+  return level ? -1 : rows_;
+}
+
+Widget* ColumnList::child(const Menu*, const int* indexes, int level) {
+  if (level || indexes[0] < 0 || indexes[0] >= rows_) return 0;
+  if (!item_) {
+    Group::current(0);
+    item_ = new ColumnListItem(this);
+  }
+  int row = order_[indexes[0]];
+  item_->row = row;
+  item_->w(0);
+  item_->clear_flag(SELECTED|OPENED);
+  if (rowflags_[row] & 1) item_->set_flag(SELECTED);
+  if (rowflags_[row] & 2) item_->set_flag(OPENED);
+  return item_;
+}
+
+void ColumnList::flags_changed(const Menu*, Widget* widget) {
+  ColumnListItem* item = (ColumnListItem*)widget;
+  rowflags_[item->row] =
+    (item->flag(SELECTED) ? 1 : 0) | (item->flag(OPENED) ? 2 : 0);
+}
+
+/*!
+  Return less than, equal to, or greater than zero depending on
+  whether \a row1 goes before, with, or after \a row2 when sorting by
+  \a column. The default compares the strings with strcmp(). Override
+  this to sort numbers or dates.
+*/
+int ColumnList::compare(int column, int row1, int row2) {
+  const char* a = cells_[column][row1];
+  const char* b = cells_[column][row2];
+  return strcmp(a ? a : "", b ? b : "");
+}
+
+/*!
+  Start sorting the rows by \a column, and redraw \a menu (which may
+  be null) when it is done. Any sort in progress is stopped. The rows
+  are merged a piece at a time in idle callbacks, so the program keeps
+  running; call finish_sort() to wait for it.
+*/
+void ColumnList::sort(Menu* menu, int column, bool descending) {
+  stop_sort();
+  sortmenu_ = menu;
+  sortcolumn_ = column;
+  descending_ = descending;
+  sorted_ = false;
+  sortfrom_ = (int*)malloc((size_ ? size_ : 1)*sizeof(int));
+  sortto_ = (int*)malloc((size_ ? size_ : 1)*sizeof(int));
+  memcpy(sortfrom_, order_, rows_*sizeof(int));
+  sortwidth_ = 1;
+  sortpos_ = 0;
+  if (rows_ < 2) sort_done();
+  else add_idle(sort_idle_cb, this);
+}
+
+/*!
+  Call this from the browser's callback. If the user clicked a column
+  heading this sorts by that column, or reverses the order if it is
+  already sorted by it, and returns true.
+*/
+bool ColumnList::column_clicked(Browser* browser) {
+  int c = browser->selected_column();
+  if (c < 0 || c >= columns_) return false;
+  bool same = c == sortcolumn_ && (sorted_ || sorting());
+  sort(browser, c, same && !descending_);
+  return true;
+}
+
+/*! If a sort is in progress, finish it now. */
+void ColumnList::finish_sort() {
+  if (!sortfrom_) return;
+  while (!sort_step(rows_)) {}
+  sort_done();
+}
+
+// Bottom-up merge sort, merging runs of sortwidth_ from sortfrom_ into
+// sortto_. Stops after about budget rows have been merged, and returns
+// true when the rows are sorted into sortfrom_.
+bool ColumnList::sort_step(int budget) {
+  for (;;) {
+    if (sortpos_ >= rows_) {
+      int* t = sortfrom_; sortfrom_ = sortto_; sortto_ = t;
+      sortwidth_ *= 2;
+      sortpos_ = 0;
+      if (sortwidth_ >= rows_) return true;
+    }
+    if (budget <= 0) return false;
+    const int* from = sortfrom_;
+    int* to = sortto_;
+    int a = sortpos_;
+    int m = a+sortwidth_; if (m > rows_) m = rows_;
+    int e = m+sortwidth_; if (e > rows_) e = rows_;
+    int i = a, j = m, k = a;
+    while (i < m && j < e) {
+      int d = compare(sortcolumn_, from[j], from[i]);
+      if (descending_ ? d > 0 : d < 0) to[k++] = from[j++];
+      else to[k++] = from[i++];
+    }
+    while (i < m) to[k++] = from[i++];
+    while (j < e) to[k++] = from[j++];
+    budget -= e-a;
+    sortpos_ = e;
+  }
+}
+
+void ColumnList::sort_idle_cb(void* v) {
+  ColumnList* list = (ColumnList*)v;
+  if (list->sort_step(1<<15)) list->sort_done();
+}
+
+void ColumnList::sort_done() {
+  int* t = order_; order_ = sortfrom_; sortfrom_ = t;
+  Menu* menu = sortmenu_;
+  stop_sort();
+  sorted_ = true;
+  if (menu) menu->redraw();
+}
+
+void ColumnList::stop_sort() {
+  if (!sortto_) return;
+  remove_idle(sort_idle_cb, this);
+  free(sortfrom_);
+  free(sortto_);
+  sortfrom_ = sortto_ = 0;
+  sortmenu_ = 0;
+}
+
+//
+// End of "$Id$".
+//
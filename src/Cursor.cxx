@@ -44,6 +44,8 @@
 #include <fltk/draw.h>
 #include <fltk/Color.h>
 #include <fltk/Image.h>
+#include <fltk/run.h>
+#include <string.h>
 
 using namespace fltk;
 
@@ -61,9 +63,11 @@ using namespace fltk;
 
 /*! \class fltk::Cursor
 
-  Cursor is an opaque system-dependent class. Currently you can only
-  use the built-in cursors but a method to turn an Image into a Cursor
-  will be added in the future.
+  Cursor is an opaque system-dependent class. Besides the built-in
+  cursors below, fltk::cursor(Image*,int,int) makes one from an
+  Image, and fltk::cursor(Image* const*,int,int,int,float) makes an
+  animated one. These are made once and kept, so a widget can ask
+  for them every time it changes the cursor.
 
   To display a cursor, call Widget::cursor().
 
@@ -100,53 +104,314 @@ struct fltk::Cursor {
   ::Cursor cursor;
   uchar fontid;
   uchar tableid;
+  uchar nframes;	// frames shown by a timer if the server can't animate
+  ::Cursor* frames;
+  float delay;
 };
 
+// Cursors made by fltk::cursor() are kept, so asking for the same one
+// again returns it rather than making another X cursor:
+struct CursorEntry {
+  fltk::Cursor cursor;
+  const void* raw;
+  Image** images;	// copy of the frames
+  unsigned long* serials; // Image::serial() of each frame when made
+  int n, x, y;
+  float delay;
+  CursorEntry* next;
+};
+static CursorEntry* cursor_cache;
+
+static CursorEntry* find_cursor(const void* raw, Image* const* images, int n,
+				int x, int y, float delay)
+{
+  for (CursorEntry* e = cursor_cache; e; e = e->next) {
+    if (e->raw != raw || e->n != n) continue;
+    if (n && (e->x != x || e->y != y || e->delay != delay)) continue;
+    int i = 0;
+    for (; i < n; i++)
+      if (e->images[i] != images[i] || e->serials[i] != images[i]->serial())
+	break;
+    if (i == n) return e;
+  }
+  return 0;
+}
+
+static CursorEntry* new_cursor(const void* raw, Image* const* images, int n,
+			       int x, int y, float delay)
+{
+  CursorEntry* e = new CursorEntry;
+  e->cursor.cursor = 0;
+  e->cursor.fontid = 0;
+  e->cursor.tableid = 0;
+  e->cursor.nframes = 0;
+  e->cursor.frames = 0;
+  e->cursor.delay = delay;
+  e->raw = raw;
+  e->n = n;
+  e->x = x;
+  e->y = y;
+  e->delay = delay;
+  e->images = n ? new Image*[n] : 0;
+  e->serials = n ? new unsigned long[n] : 0;
+  for (int i = 0; i < n; i++) {
+    e->images[i] = images[i];
+    e->serials[i] = images[i]->serial();
+  }
+  e->next = cursor_cache;
+  cursor_cache = e;
+  return e;
+}
+
 FL_API fltk::Cursor *fltk::cursor(void *raw) {
-  fltk::Cursor *c = new fltk::Cursor;
-  c->cursor = (::Cursor)raw;
-  c->fontid = 0;
-  c->tableid = 0;
-  return c;
+  CursorEntry* e = find_cursor(raw, 0, 0, 0, 0, 0);
+  if (!e) {
+    e = new_cursor(raw, 0, 0, 0, 0, 0);
+    e->cursor.cursor = (::Cursor)raw;
+  }
+  return &e->cursor;
+}
+
+// Return the image as premultiplied 0xaarrggbb words, which is what
+// both Xcursor and Xrender want. Delete[] the result:
+static U32* cursor_pixels(Image* img) {
+  img->fetch_if_needed();
+  const int w = img->w();
+  const int h = img->h();
+  U32* pixels = new U32[w*h];
+  const uchar* buffer = img->buffer();
+  const PixelType type = img->buffer_pixeltype();
+  const int ld = img->buffer_linedelta();
+  U32* d = pixels;
+  for (int y = 0; y < h; y++) {
+    const uchar* s = buffer+y*ld;
+    for (int x = 0; x < w; x++, d++) {
+      U32 v; unsigned a;
+      switch (type) {
+      case MASK:
+	*d = (255-s[x])<<24;
+	break;
+      case MONO:
+	*d = 0xff000000 | s[x]*0x10101;
+	break;
+      case RGB:
+	*d = 0xff000000 | (s[3*x]<<16) | (s[3*x+1]<<8) | s[3*x+2];
+	break;
+      case RGBx:
+	*d = 0xff000000 | (s[4*x]<<16) | (s[4*x+1]<<8) | s[4*x+2];
+	break;
+      case RGBA:
+	*d = (s[4*x+3]<<24) | (s[4*x]<<16) | (s[4*x+1]<<8) | s[4*x+2];
+	break;
+      case RGBM:
+	a = s[4*x+3];
+	*d = (a<<24) | ((s[4*x]*a/255)<<16) | ((s[4*x+1]*a/255)<<8) |
+	  (s[4*x+2]*a/255);
+	break;
+      case RGB32:
+	*d = ((const U32*)s)[x] | 0xff000000;
+	break;
+      case MRGB32:
+	v = ((const U32*)s)[x];
+	a = v>>24;
+	*d = (a<<24) | ((((v>>16)&255)*a/255)<<16) |
+	  ((((v>>8)&255)*a/255)<<8) | ((v&255)*a/255);
+	break;
+      default: // ARGB32
+	*d = ((const U32*)s)[x];
+	break;
+      }
+    }
+  }
+  return pixels;
 }
 
 #ifdef USE_XCURSOR
-//#warning we assume PixelType = 6 ARGB32 in test it is true for color images
+
 static XcursorImage* create_cursor_image(Image *cimg, int x, int y) {
   XcursorImage *xcimage = XcursorImageCreate(cimg->w(),cimg->h());
-  XcursorPixel *dest;
-
   xcimage->xhot = x;
   xcimage->yhot = y;
-
-  dest = xcimage->pixels;
-  unsigned char *src = cimg->buffer();
-  //cimg->buffer_pixeltype() 
-  for (int j = 0; j < cimg->h() ; ++j){
-    for (int i = 0; i < cimg->w() ; ++i){
-     
-        *dest = (src[3] <<24) | (src[2] << 16) | (src[1] << 8) | src[0];
-        src += 4;
-        dest++;
-    }
-  }
+  U32* pixels = cursor_pixels(cimg);
+  for (int i = cimg->w()*cimg->h(); i--;) xcimage->pixels[i] = pixels[i];
+  delete[] pixels;
   return xcimage;
 }
 
-FL_API fltk::Cursor *fltk::cursor(Image *img, int x, int y) {
-  fltk::Cursor *c = new fltk::Cursor;
-  if(!xdisplay)fltk::open_display();
-  img->fetch();
+static ::Cursor create_cursor(Image* img, int x, int y) {
   XcursorImage *xcimage = create_cursor_image(img, x, y);
-  c->cursor = XcursorImageLoadCursor(xdisplay, xcimage);
-  XcursorImageDestroy (xcimage);
-  
-  c->fontid = 0;
-  c->tableid = 0;
+  ::Cursor c = XcursorImageLoadCursor(xdisplay, xcimage);
+  XcursorImageDestroy(xcimage);
   return c;
 }
 
-#endif //USE_XCURSOR
+// The X server plays the frames:
+static void create_animation(fltk::Cursor* c, Image* const* images, int n,
+			     int x, int y, float delay) {
+  XcursorImages* xcimages = XcursorImagesCreate(n);
+  for (int i = 0; i < n; i++) {
+    XcursorImage* xcimage = create_cursor_image(images[i], x, y);
+    xcimage->delay = XcursorUInt(delay*1000);
+    xcimages->images[xcimages->nimage++] = xcimage;
+  }
+  c->cursor = XcursorImagesLoadCursor(xdisplay, xcimages);
+  XcursorImagesDestroy(xcimages);
+}
+
+#elif USE_XFT
+
+static ::Cursor create_cursor(Image* img, int x, int y) {
+  const int w = img->w();
+  const int h = img->h();
+  U32* pixels = cursor_pixels(img);
+  XImage* ximage = XCreateImage(xdisplay, DefaultVisual(xdisplay, xscreen),
+				32, ZPixmap, 0, (char*)pixels, w, h, 32, w*4);
+  static const int one = 1;
+  ximage->byte_order = *(char*)&one ? LSBFirst : MSBFirst;
+  Pixmap pixmap = XCreatePixmap(xdisplay, RootWindow(xdisplay, xscreen),
+				w, h, 32);
+  GC gc = XCreateGC(xdisplay, pixmap, 0, 0);
+  XPutImage(xdisplay, pixmap, gc, ximage, 0, 0, 0, 0, w, h);
+  XFreeGC(xdisplay, gc);
+  ximage->data = 0;
+  XDestroyImage(ximage);
+  delete[] pixels;
+  ::Picture picture =
+    XRenderCreatePicture(xdisplay, pixmap,
+			 XRenderFindStandardFormat(xdisplay, PictStandardARGB32),
+			 0, 0);
+  ::Cursor c = XRenderCreateCursor(xdisplay, picture, x, y);
+  XRenderFreePicture(xdisplay, picture);
+  XFreePixmap(xdisplay, pixmap);
+  return c;
+}
+
+// The X server plays the frames:
+static void create_animation(fltk::Cursor* c, Image* const* images, int n,
+			     int x, int y, float delay) {
+  XAnimCursor* frames = new XAnimCursor[n];
+  for (int i = 0; i < n; i++) {
+    frames[i].cursor = create_cursor(images[i], x, y);
+    frames[i].delay = (unsigned long)(delay*1000);
+  }
+  c->cursor = XRenderCreateAnimCursor(xdisplay, n, frames);
+  for (int i = 0; i < n; i++) XFreeCursor(xdisplay, frames[i].cursor);
+  delete[] frames;
+}
+
+#else
+
+// Without Xcursor or Xrender the image is reduced to the two colors
+// and mask of a core X cursor. Dark pixels are fl_cursor_fg:
+static ::Cursor create_cursor(Image* img, int x, int y) {
+  const int w = img->w();
+  const int h = img->h();
+  const int bpl = (w+7)/8;
+  U32* pixels = cursor_pixels(img);
+  char* bits = new char[2*bpl*h];
+  char* mask = bits+bpl*h;
+  memset(bits, 0, 2*bpl*h);
+  for (int j = 0; j < h; j++) for (int i = 0; i < w; i++) {
+    U32 v = pixels[j*w+i];
+    unsigned a = v>>24;
+    if (a < 128) continue;
+    mask[j*bpl+i/8] |= 1<<(i&7);
+    // premultiplied, so compare the color against half the alpha:
+    if (((v>>16)&255)*3+((v>>8)&255)*6+(v&255) < 5*a)
+      bits[j*bpl+i/8] |= 1<<(i&7);
+  }
+  delete[] pixels;
+  XWindow root = RootWindow(xdisplay, xscreen);
+  Pixmap p = XCreateBitmapFromData(xdisplay, root, bits, w, h);
+  Pixmap m = XCreateBitmapFromData(xdisplay, root, mask, w, h);
+  delete[] bits;
+  uchar r,g,b;
+  XColor fgc;
+  split_color(fl_cursor_fg, r,g,b);
+  fgc.red = r*0x101;
+  fgc.green = g*0x101;
+  fgc.blue = b*0x101;
+  XColor bgc;
+  split_color(fl_cursor_bg, r,g,b);
+  bgc.red = r*0x101;
+  bgc.green = g*0x101;
+  bgc.blue = b*0x101;
+  ::Cursor c = XCreatePixmapCursor(xdisplay, p, m, &fgc, &bgc, x, y);
+  XFreePixmap(xdisplay, m);
+  XFreePixmap(xdisplay, p);
+  return c;
+}
+
+// The core protocol has no animated cursors, so Widget::cursor()
+// starts a timer that changes between the frames:
+static void create_animation(fltk::Cursor* c, Image* const* images, int n,
+			     int x, int y, float delay) {
+  c->frames = new ::Cursor[n];
+  for (int i = 0; i < n; i++) c->frames[i] = create_cursor(images[i], x, y);
+  c->nframes = uchar(n);
+  c->cursor = c->frames[0];
+}
+
+#endif
+
+/*!
+  Return a cursor that looks like the image, with the hotspot at
+  \a x, \a y in it. On X this uses Xcursor or Xrender if fltk was
+  compiled with them, and otherwise makes a two-color cursor from
+  the dark and light pixels.
+
+  The cursors are kept, calling this again with the same image
+  returns the same one, so it is fine to call this every time the
+  cursor changes. If the image is changed a new cursor is made.
+*/
+FL_API fltk::Cursor *fltk::cursor(Image *img, int x, int y) {
+  CursorEntry* e = find_cursor(0, &img, 1, x, y, 0);
+  if (!e) {
+    if (!xdisplay) open_display();
+    e = new_cursor(0, &img, 1, x, y, 0);
+    e->cursor.cursor = create_cursor(img, x, y);
+  }
+  return &e->cursor;
+}
+
+/*!
+  Return a cursor that shows the \a n images one after another, each
+  for \a delay seconds. Where possible the X server plays the frames,
+  otherwise Widget::cursor() starts a timer to change them. Like
+  the single-image version, the same cursor is returned when called
+  again with the same images.
+*/
+FL_API fltk::Cursor *fltk::cursor(Image* const* images, int n, int x, int y,
+				   float delay) {
+  if (n <= 1) return cursor(images[0], x, y);
+  if (n > 255) n = 255;
+  CursorEntry* e = find_cursor(0, images, n, x, y, delay);
+  if (!e) {
+    if (!xdisplay) open_display();
+    e = new_cursor(0, images, n, x, y, delay);
+    create_animation(&e->cursor, images, n, x, y, delay);
+  }
+  return &e->cursor;
+}
+
+// The cursor animated by a timer, and the window it is in:
+static fltk::Cursor* animated_cursor;
+static XWindow animated_window;
+static int animated_frame;
+
+static void animate_cursor(void*) {
+  fltk::Cursor* c = animated_cursor;
+  Window* window = fltk::find(animated_window);
+  CreatedWindow* i = window ? CreatedWindow::find(window) : 0;
+  if (!i || i->cursor != c->frames[animated_frame]) {
+    animated_cursor = 0;
+    return;
+  }
+  if (++animated_frame >= c->nframes) animated_frame = 0;
+  i->cursor = c->frames[animated_frame];
+  XDefineCursor(xdisplay, i->xid, i->cursor);
+  repeat_timeout(c->delay, animate_cursor);
+}
 
 static fltk::Cursor arrow = {0,35};
 static fltk::Cursor cross = {0,66};
@@ -257,6 +522,18 @@ void Widget::cursor(fltk::Cursor* c) const {
     xcursor = c->cursor;
   }
   i->cursor_for = this;
+  if (c && c->nframes) {
+    // keep showing the frame the timer is on:
+    if (animated_cursor == c && animated_window == i->xid) return;
+    if (animated_cursor) fltk::remove_timeout(animate_cursor);
+    animated_cursor = c;
+    animated_window = i->xid;
+    animated_frame = 0;
+    fltk::add_timeout(c->delay, animate_cursor);
+  } else if (animated_cursor && animated_window == i->xid) {
+    fltk::remove_timeout(animate_cursor);
+    animated_cursor = 0;
+  }
   if (xcursor != i->cursor) {
     i->cursor = xcursor;
     XDefineCursor(xdisplay, i->xid, xcursor);
@@ -540,7 +817,7 @@ fltk::Cursor* const fltk::CURSOR_CROSS	= &cross;
 fltk::Cursor* const fltk::CURSOR_WAIT	= &wait_c;
 fltk::Cursor* const fltk::CURSOR_INSERT	= &insert;
 fltk::Cursor* const fltk::CURSOR_HAND	= &hand;
-fltk::Cursor* const fltk::CURSOR_HELP	= &help;
+fltk::Cursor* const fltk::CURSOR_HELP	= &::help;
 fltk::Cursor* const fltk::CURSOR_MOVE	= &move;
 fltk::Cursor* const fltk::CURSOR_NS	= &ns;
 fltk::Cursor* const fltk::CURSOR_WE	= &we;
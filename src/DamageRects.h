@@ -0,0 +1,54 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Internal to fltk: a short list of disjoint rectangles. Window::flush()
+// points fl_damage_rects at one of these while it draws damaged children
+// into the back buffer, and Group::update_child() adds each child it
+// draws, so only those areas have to be copied to the front.
+
+#ifndef fltk_DamageRects_h
+#define fltk_DamageRects_h
+
+#include <fltk/Rectangle.h>
+
+namespace fltk {
+
+struct DamageRects {
+  enum {MAXIMUM = 16};
+  Rectangle rect[MAXIMUM+1]; // one extra used by add()
+  int n;
+  DamageRects() : n(0) {}
+  void add(const Rectangle&);
+};
+
+}
+
+extern fltk::DamageRects* fl_damage_rects;
+// areas to flash when flash_redraws() is on, in frame_stats.cxx:
+extern fltk::DamageRects* fl_flash_rects;
+
+#endif
+
+// End of "$Id$".
@@ -0,0 +1,378 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Retained drawing for Group::retained(). The drawing functions in
+// fillrect.cxx, path.cxx, clip.cxx, Font.cxx, drawtext.cxx and the
+// Image::draw() implementations call the methods here when a list is
+// being recorded. Everything is stored in device coordinates so it can
+// be replayed with only an integer translation.
+
+#include <config.h>
+#include <fltk/draw.h>
+#include <fltk/Image.h>
+#include <fltk/Font.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DisplayList.h"
+#if USE_CAIRO
+# include <fltk/fltk_cairo.h>
+#endif
+using namespace fltk;
+
+DisplayList* fl_display_list;
+unsigned fl_display_list_generation;
+
+extern bool fl_trivial_transform(); // in path.cxx
+#if !USE_CAIRO && !USE_QUARTZ
+extern int fl_path_size(int& loops);
+extern void fl_get_path(int* xy, int* loops, int* circle, float* angles);
+extern void fl_set_path(const int* xy, int n, const int* loops, int nloops,
+			const int* circle, const float* angles, int dx, int dy);
+#endif
+
+enum {
+  COLOR,	// color
+  BGCOLOR,	// color
+  LINE_STYLE,	// style, width, n, n bytes of dashes
+  FONT,		// pointer, size
+  FILLRECT,	// x, y, w, h
+  STROKERECT,	// x, y, w, h
+  LINE,		// x, y, x1, y1
+  LINEF,	// float x, y, x1, y1
+  POINT,	// x, y
+  POINTF,	// float x, y
+  PATH,		// op, color, n, loops, circle[5], angles[2], xy[2n], loops
+		// or for cairo: op, color, n, n cairo_path_data_t
+  TEXT,		// float x, y, n, n bytes
+  IMAGE,	// pointer, from, to
+  PUSH_CLIP,	// x, y, w, h
+  CLIPOUT,	// x, y, w, h
+  PUSH_NO_CLIP,
+  POP_CLIP
+};
+
+// words needed to store n bytes:
+static inline int words(int n) {return (n+sizeof(int)-1)/sizeof(int);}
+
+static inline int ftoi(float f) {int i; memcpy(&i, &f, sizeof(i)); return i;}
+static inline float itof(int i) {float f; memcpy(&f, &i, sizeof(f)); return f;}
+
+DisplayList::DisplayList() : data(0), used(0), size(0), valid(false) {}
+
+DisplayList::~DisplayList() {
+  if (fl_display_list == this) fl_display_list = outer;
+  free(data);
+}
+
+// Make space for n more words and return a pointer to them:
+int* DisplayList::room(int n) {
+  if (used+n > size) {
+    size = size ? 2*size : 256;
+    if (used+n > size) size = used+n;
+    data = (int*)realloc(data, size*sizeof(int));
+  }
+  int* p = data+used;
+  used += n;
+  return p;
+}
+
+void DisplayList::put(int op, int a, int b, int c, int d) {
+  int* p = room(5);
+  p[0] = op; p[1] = a; p[2] = b; p[3] = c; p[4] = d;
+}
+
+// Write the color, line style, and font if they changed:
+void DisplayList::sync_state(bool text) {
+  if (getcolor() != color) {
+    color = getcolor();
+    int* p = room(2); p[0] = COLOR; p[1] = color;
+  }
+  if (line_style_ != style || line_width_ != width ||
+      (line_dashes_ != dashes &&
+       (!line_dashes_ || !dashes || strcmp(line_dashes_, dashes)))) {
+    style = line_style_; width = line_width_; dashes = line_dashes_;
+    int n = dashes ? strlen(dashes)+1 : 0;
+    int* p = room(4+words(n));
+    p[0] = LINE_STYLE; p[1] = style; p[2] = ftoi(width); p[3] = n;
+    if (n) memcpy(p+4, dashes, n);
+  }
+  if (!text) return;
+  if (getbgcolor() != bgcolor) {
+    bgcolor = getbgcolor();
+    int* p = room(2); p[0] = BGCOLOR; p[1] = bgcolor;
+  }
+  if (getfont() != font || getsize() != fontsize) {
+    font = getfont(); fontsize = getsize();
+    int* p = room(2+words(sizeof(void*)));
+    p[0] = FONT; p[1] = ftoi(fontsize);
+    memcpy(p+2, &font, sizeof(void*));
+  }
+}
+
+/*! Returns true if the recording can be replayed: it is valid() and
+  fltk::redraw() has not been called since it was made. */
+bool DisplayList::current() const {
+  return valid && generation == fl_display_list_generation;
+}
+
+/*! Start recording. This must be called with the drawing transformed
+  so 0,0 is the corner of the group. Any list already being recorded
+  is remembered, and gets a copy of this one when end() is called. */
+void DisplayList::begin() {
+  used = 0;
+  valid = aborted = false;
+  // make sync_state() write everything the first time:
+  color = bgcolor = ~0u;
+  style = -1; width = -1; dashes = 0;
+  font = 0; fontsize = -1;
+  origin_x = origin_y = 0;
+  transform(origin_x, origin_y);
+  if (!fl_trivial_transform()) aborted = true;
+  outer = fl_display_list;
+  fl_display_list = this;
+}
+
+/*! Stop recording. The list is valid if nothing was drawn that could
+  not be recorded. */
+void DisplayList::end() {
+  fl_display_list = outer;
+  valid = !aborted;
+  generation = fl_display_list_generation;
+  if (outer) {
+    // the enclosing list can't use this directly as it will change, so
+    // put a copy of it there:
+    if (aborted) outer->aborted = true;
+    else {outer->color = ~0u; outer->style = -1; outer->font = 0;
+      outer->bgcolor = ~0u; memcpy(outer->room(used), data, used*sizeof(int));}
+  }
+  // it is quite likely the list will be redrawn the same size:
+  if (size > 2*used+256) {
+    size = used;
+    data = (int*)realloc(data, size*sizeof(int));
+  }
+}
+
+/*! Draw everything that was recorded, translated by how much the
+  origin has moved since it was recorded. If another list is being
+  recorded this will be added to it. */
+void DisplayList::replay() {
+  // save the state that the recording changes:
+  Color saved_color = getcolor();
+  Color saved_bgcolor = getbgcolor();
+  int saved_style = line_style_;
+  float saved_width = line_width_;
+  const char* saved_dashes = line_dashes_;
+  Font* saved_font = getfont();
+  float saved_size = getsize();
+
+  int dx = 0, dy = 0; transform(dx, dy);
+  dx -= origin_x; dy -= origin_y;
+  push_matrix();
+  load_identity();
+  translate(dx, dy);
+  for (int* p = data; p < data+used;) switch (*p) {
+  case COLOR:
+    setcolor(Color(p[1])); p += 2; break;
+  case BGCOLOR:
+    setbgcolor(Color(p[1])); p += 2; break;
+  case LINE_STYLE:
+    line_style(p[1], itof(p[2]), p[3] ? (const char*)(p+4) : 0);
+    p += 4+words(p[3]); break;
+  case FONT: {
+    Font* f; memcpy(&f, p+2, sizeof(void*));
+    setfont(f, itof(p[1]));
+    p += 2+words(sizeof(void*)); break;}
+  case FILLRECT:
+    fltk::fillrect(p[1], p[2], p[3], p[4]); p += 5; break;
+  case STROKERECT:
+    fltk::strokerect(p[1], p[2], p[3], p[4]); p += 5; break;
+  case LINE:
+    fltk::drawline(p[1], p[2], p[3], p[4]); p += 5; break;
+  case LINEF:
+    fltk::drawline(itof(p[1]), itof(p[2]), itof(p[3]), itof(p[4]));
+    p += 5; break;
+  case POINT:
+    fltk::drawpoint(p[1], p[2]); p += 3; break;
+  case POINTF:
+    fltk::drawpoint(itof(p[1]), itof(p[2])); p += 3; break;
+#if USE_CAIRO
+  case PATH: {
+    int n = p[3];
+    // copy it so the doubles are aligned:
+    cairo_path_t path;
+    path.status = CAIRO_STATUS_SUCCESS;
+    path.num_data = n;
+    path.data = new cairo_path_data_t[n];
+    memcpy(path.data, p+4, n*sizeof(cairo_path_data_t));
+    cairo_new_path(cr);
+    cairo_save(cr);
+    cairo_translate(cr, dx, dy);
+    cairo_append_path(cr, &path);
+    cairo_restore(cr); // this does not change the path
+    delete[] path.data;
+    if (p[1] == 0) strokepath();
+    else if (p[1] == 1) fillpath();
+    else fillstrokepath(Color(p[2]));
+    p += 4+words(n*sizeof(cairo_path_data_t)); break;}
+#elif !USE_QUARTZ
+  case PATH: {
+    int n = p[3]; int loops = p[4];
+    int* xy = p+12;
+    fl_set_path(xy, n, xy+2*n, loops, p+5, (float*)(p+10), dx, dy);
+    if (p[1] == 0) strokepath();
+    else if (p[1] == 1) fillpath();
+    else fillstrokepath(Color(p[2]));
+    p += 12+2*n+loops; break;}
+#endif
+  case TEXT:
+    if (fl_display_list) fl_display_list->text((const char*)(p+4), p[3],
+					       itof(p[1])+dx, itof(p[2])+dy);
+    drawtext_transformed((const char*)(p+4), p[3], itof(p[1])+dx, itof(p[2])+dy);
+    p += 4+words(p[3]); break;
+  case IMAGE: {
+    const Image* image; memcpy(&image, p+9, sizeof(void*));
+    image->draw(Rectangle(p[1], p[2], p[3], p[4]),
+		Rectangle(p[5], p[6], p[7], p[8]));
+    p += 9+words(sizeof(void*)); break;}
+  case PUSH_CLIP:
+    fltk::push_clip(p[1], p[2], p[3], p[4]); p += 5; break;
+  case CLIPOUT:
+    fltk::clipout(Rectangle(p[1], p[2], p[3], p[4])); p += 5; break;
+  case PUSH_NO_CLIP:
+    fltk::push_no_clip(); p++; break;
+  case POP_CLIP:
+    fltk::pop_clip(); p++; break;
+  default: // should not happen
+    p = data+used; break;
+  }
+  pop_matrix();
+
+  setcolor(saved_color);
+  setbgcolor(saved_bgcolor);
+  line_style(saved_style, saved_width, saved_dashes);
+  setfont(saved_font, saved_size);
+}
+
+void DisplayList::fillrect(int x, int y, int w, int h) {
+  sync_state(false);
+  transform(x, y, w, h);
+  put(FILLRECT, x, y, w, h);
+}
+
+void DisplayList::strokerect(int x, int y, int w, int h) {
+  sync_state(false);
+  transform(x, y, w, h);
+  put(STROKERECT, x, y, w, h);
+}
+
+void DisplayList::drawline(int x, int y, int x1, int y1) {
+  sync_state(false);
+  transform(x, y); transform(x1, y1);
+  put(LINE, x, y, x1, y1);
+}
+
+void DisplayList::drawline(float x, float y, float x1, float y1) {
+  sync_state(false);
+  transform(x, y); transform(x1, y1);
+  put(LINEF, ftoi(x), ftoi(y), ftoi(x1), ftoi(y1));
+}
+
+void DisplayList::drawpoint(int x, int y) {
+  sync_state(false);
+  transform(x, y);
+  int* p = room(3); p[0] = POINT; p[1] = x; p[2] = y;
+}
+
+void DisplayList::drawpoint(float x, float y) {
+  sync_state(false);
+  transform(x, y);
+  int* p = room(3); p[0] = POINTF; p[1] = ftoi(x); p[2] = ftoi(y);
+}
+
+// Record the current path, op is 0 for strokepath(), 1 for fillpath()
+// and 2 for fillstrokepath(color):
+void DisplayList::path(int op, unsigned c) {
+#if USE_QUARTZ
+  // the path is stored by the system where we can't get at it
+  aborted = true;
+#elif USE_CAIRO
+  // the points were transformed by fltk, so cairo has them in device
+  // coordinates and a copy can be replayed anywhere:
+  cairo_path_t* path = cairo_copy_path(cr);
+  if (path->status != CAIRO_STATUS_SUCCESS) {
+    cairo_path_destroy(path);
+    aborted = true;
+    return;
+  }
+  sync_state(false);
+  int n = path->num_data;
+  int* p = room(4+words(n*sizeof(cairo_path_data_t)));
+  p[0] = PATH; p[1] = op; p[2] = c; p[3] = n;
+  memcpy(p+4, path->data, n*sizeof(cairo_path_data_t));
+  cairo_path_destroy(path);
+#else
+  sync_state(false);
+  int loops; int n = fl_path_size(loops);
+  int* p = room(12+2*n+loops);
+  p[0] = PATH; p[1] = op; p[2] = c; p[3] = n; p[4] = loops;
+  fl_get_path(p+12, p+12+2*n, p+5, (float*)(p+10));
+#endif
+}
+
+void DisplayList::text(const char* s, int n, float x, float y) {
+  sync_state(true);
+  int* p = room(4+words(n));
+  p[0] = TEXT; p[1] = ftoi(x); p[2] = ftoi(y); p[3] = n;
+  memcpy(p+4, s, n);
+}
+
+void DisplayList::image(const Image* image, const Rectangle& from, const Rectangle& to) {
+  if (!fl_trivial_transform()) {aborted = true; return;}
+  sync_state(false);
+  int x = to.x(), y = to.y(); transform(x, y);
+  int* p = room(9+words(sizeof(void*)));
+  p[0] = IMAGE;
+  p[1] = from.x(); p[2] = from.y(); p[3] = from.w(); p[4] = from.h();
+  p[5] = x; p[6] = y; p[7] = to.w(); p[8] = to.h();
+  memcpy(p+9, &image, sizeof(void*));
+}
+
+void DisplayList::push_clip(int x, int y, int w, int h) {
+  transform(x, y, w, h);
+  put(PUSH_CLIP, x, y, w, h);
+}
+
+void DisplayList::clipout(const Rectangle& r1) {
+  Rectangle r; transform(r1, r);
+  put(CLIPOUT, r.x(), r.y(), r.w(), r.h());
+}
+
+void DisplayList::push_no_clip() {*room(1) = PUSH_NO_CLIP;}
+
+void DisplayList::pop_clip() {*room(1) = POP_CLIP;}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,85 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Internal to fltk: a recording of drawing calls made by a retained()
+// Group, which can be replayed instead of calling draw() again. The
+// drawing functions call the methods here when fl_display_list is set.
+
+#ifndef fltk_DisplayList_h
+#define fltk_DisplayList_h
+
+#include <fltk/Rectangle.h>
+
+namespace fltk {
+
+class Image;
+
+class DisplayList {
+  int* data;		// recorded operations
+  int used, size;	// words in data
+  int origin_x, origin_y; // device position of 0,0 when recorded
+  unsigned generation;	// fl_display_list_generation when recorded
+  bool aborted;		// something that cannot be recorded was drawn
+  DisplayList* outer;	// list being recorded when begin() was called
+  // state last written, so it is only written when it changes:
+  unsigned color, bgcolor;
+  int style; float width; const char* dashes;
+  const void* font; float fontsize;
+  int* room(int words);
+  void put(int op, int a, int b, int c, int d);
+  void sync_state(bool text);
+public:
+  bool valid;		// the recording can be replayed
+  DisplayList();
+  ~DisplayList();
+  bool current() const;
+  void begin();
+  void end();
+  void abort() {aborted = true;}
+  void replay();
+  // called by the drawing functions:
+  void fillrect(int x, int y, int w, int h);
+  void strokerect(int x, int y, int w, int h);
+  void drawline(int x, int y, int x1, int y1);
+  void drawline(float x, float y, float x1, float y1);
+  void drawpoint(int x, int y);
+  void drawpoint(float x, float y);
+  void path(int op, unsigned color);
+  void text(const char*, int n, float x, float y);
+  void image(const Image*, const Rectangle& from, const Rectangle& to);
+  void push_clip(int x, int y, int w, int h);
+  void clipout(const Rectangle&);
+  void push_no_clip();
+  void pop_clip();
+};
+
+}
+
+extern fltk::DisplayList* fl_display_list;
+extern unsigned fl_display_list_generation;
+
+#endif
+
+// End of "$Id$".
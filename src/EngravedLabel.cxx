@@ -34,23 +34,13 @@ using namespace fltk;
 
 // data is dx, dy, color triples
 
+extern void fl_drawtext_passes(const char*, const Rectangle&, Flags,
+			       const int* data); // in drawtext.cxx
+
+// All the passes share one layout of the label:
 void EngravedLabel::draw(const char* label, const Rectangle& r, Flags align) const
 {
-  Color saved_color = getcolor();
-  Flags saved_flags = drawflags();
-  setdrawflags(saved_flags|INACTIVE_R);
-  Rectangle r1(r);
-  for (const int *data = this->data; ; data += 3) {
-    r1.x(r.x()+data[0]);
-    r1.y(r.y()+data[1]);
-    Color fg = (Color)(data[2]);
-    if (!fg) break;
-    setcolor(fg);
-    drawtext(label, r1, align);
-  }
-  setdrawflags(saved_flags);
-  setcolor(saved_color);
-  drawtext(label, r1, align);
+  fl_drawtext_passes(label, r, align, data);
 }
 
 static const int shadow_data[2][3] = {{2,2,GRAY33},{0,0,0}};
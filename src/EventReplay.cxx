@@ -0,0 +1,412 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+// Recording of the events passed to fltk::handle(), and a player that
+// sends them back to the same windows for benchmarking. The file is
+// text, one line per record:
+//
+//	# fltk event recording 1
+//	W id label-in-hex child-index...	describes a window id
+//	E time event window x y x_root y_root dx dy state keysym
+//	  clicks is_click key_repeated device text-in-hex
+//	F time fd				an add_fd() callback was done
+//
+// A window is described by the label of the top-level window it is in
+// and the child indexes to get to it, so a replay works with a new run
+// of the same program.
+
+#include <fltk/EventReplay.h>
+#include <fltk/trace.h>
+#include <fltk/events.h>
+#include <fltk/Window.h>
+#include <fltk/run.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+using namespace fltk;
+
+////////////////////////////////////////////////////////////////
+// Recording:
+
+static FILE* record_file;
+static bool record_close;	// start_recording() opened the file
+static double record_start;
+static const Window** recorded;	// windows given ids so far
+static int nrecorded, recordedsize;
+bool fl_recording;		// checked by fltk::handle()
+
+static void write_hex(const char* s, int n) {
+  if (!n) {fputs(" -", record_file); return;}
+  putc(' ', record_file);
+  for (int i = 0; i < n; i++) fprintf(record_file, "%02x", (unsigned char)s[i]);
+}
+
+static int window_id(const Window* window) {
+  if (!window) return -1;
+  for (int i = 0; i < nrecorded; i++) if (recorded[i] == window) return i;
+  if (nrecorded >= recordedsize) {
+    recordedsize = recordedsize ? 2*recordedsize : 16;
+    recorded = (const Window**)realloc(recorded, recordedsize*sizeof(Window*));
+  }
+  recorded[nrecorded] = window;
+  // the path from the top-level window, written backwards:
+  int path[32]; int n = 0;
+  const Widget* top = window;
+  while (top->parent() && n < 32) {
+    path[n++] = top->parent()->find(top);
+    top = top->parent();
+  }
+  fprintf(record_file, "W %d", nrecorded);
+  const char* label = top->label();
+  write_hex(label, label ? strlen(label) : 0);
+  while (n--) fprintf(record_file, " %d", path[n]);
+  putc('\n', record_file);
+  return nrecorded++;
+}
+
+// Called by fltk::handle() for the events from the system:
+void fl_record_event(int event, const Window* window) {
+  int id = window_id(window);
+  fprintf(record_file, "E %.6f %d %d %d %d %d %d %d %d %u %u %d %u %u %d",
+	  trace_time()-record_start, event, id, e_x, e_y, e_x_root, e_y_root,
+	  e_dx, e_dy, e_state, e_keysym, e_clicks, e_is_click,
+	  e_key_repeated, e_device);
+  write_hex(e_text, e_text ? e_length : 0);
+  putc('\n', record_file);
+}
+
+// Called by the wait() code before an add_fd() callback:
+void fl_record_fd(int fd) {
+  fprintf(record_file, "F %.6f %d\n", trace_time()-record_start, fd);
+}
+
+/*!
+  Start writing every event that fltk::handle() gets from the system
+  to \a file, with the time and the event_x(), event_key(), and other
+  values, along with the times add_fd() callbacks were done. The
+  recording can be played back with EventReplay. Events that
+  handle() makes itself, such as SHORTCUT, are not recorded as they
+  are made again when the recording is played back.
+*/
+bool fltk::start_recording(FILE* file) {
+  stop_recording();
+  if (!file) return false;
+  record_file = file;
+  record_close = false;
+  record_start = trace_time();
+  nrecorded = 0;
+  fputs("# fltk event recording 1\n", record_file);
+  fl_recording = true;
+  return true;
+}
+
+/*! Same as start_recording(FILE*) but it opens and closes the file. */
+bool fltk::start_recording(const char* filename) {
+  FILE* f = fopen(filename, "w");
+  if (!start_recording(f)) return false;
+  record_close = true;
+  return true;
+}
+
+/*! Stop writing events, and close the file if start_recording() opened it. */
+void fltk::stop_recording() {
+  if (!record_file) return;
+  fl_recording = false;
+  if (record_close) fclose(record_file); else fflush(record_file);
+  record_file = 0;
+  free(recorded);
+  recorded = 0;
+  nrecorded = recordedsize = 0;
+}
+
+/*! Returns true between start_recording() and stop_recording(). */
+bool fltk::recording() {return fl_recording;}
+
+////////////////////////////////////////////////////////////////
+// Playing back:
+
+namespace fltk {
+struct ReplayRecord {
+  double time;
+  int event;		// 0 for an add_fd() callback
+  int window;
+  int x, y, x_root, y_root, dx, dy;
+  unsigned state, keysym;
+  int clicks;
+  unsigned is_click, key_repeated;
+  int device;
+  char* text;
+  int length;
+};
+}
+
+/*! \class fltk::EventReplay
+
+  Plays back the events written by fltk::start_recording(), to
+  measure how long the program takes to respond to them:
+
+\code
+  fltk::EventReplay replay;
+  if (!replay.load("session.txt")) return 1;
+  make_windows_like_when_recorded();
+  replay.run();
+  printf("median %g, 99%% %g\n", replay.percentile(.5), replay.percentile(.99));
+\endcode
+
+  Each event is sent to fltk::handle() with the event_x(),
+  event_key() and other values set to what was recorded, followed by
+  flush(). The time the two take is the latency() of that event. The
+  windows must be shown, with the same labels and children as when
+  it was recorded.
+*/
+
+EventReplay::EventReplay() {
+  records = 0;
+  nrecords = next_ = 0;
+  windows = 0;
+  nwindows = 0;
+  found = 0;
+  latency_ = 0;
+  replayed_ = missing_ = 0;
+}
+
+EventReplay::~EventReplay() {clear();}
+
+void EventReplay::clear() {
+  for (int i = 0; i < nrecords; i++) delete[] records[i].text;
+  for (int i = 0; i < nwindows; i++) delete[] windows[i];
+  delete[] records;
+  delete[] windows;
+  delete[] found;
+  delete[] latency_;
+  records = 0; nrecords = 0;
+  windows = 0; nwindows = 0;
+  found = 0; latency_ = 0;
+}
+
+static char* read_hex(const char* s, int& length) {
+  length = 0;
+  if (*s == '-' || !*s) return 0;
+  int n = 0;
+  while (isxdigit((unsigned char)s[n])) n++;
+  char* r = new char[n/2+1];
+  for (int i = 0; i+1 < n; i += 2) {
+    char b[3] = {s[i], s[i+1], 0};
+    r[length++] = char(strtol(b, 0, 16));
+  }
+  r[length] = 0;
+  return r;
+}
+
+/*!
+  Read a recording made by fltk::start_recording(). Returns false if
+  it is not one. Any recording already loaded is replaced.
+*/
+bool EventReplay::load(FILE* f) {
+  if (!f) return false;
+  char line[4096];
+  if (!fgets(line, sizeof(line), f) || strncmp(line, "# fltk event recording", 22))
+    return false;
+  int size = 1024;
+  ReplayRecord* r = new ReplayRecord[size];
+  int n = 0;
+  int wsize = 16;
+  char** w = new char*[wsize];
+  for (int i = 0; i < wsize; i++) w[i] = 0;
+  int nw = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == 'W') {
+      int id, used = 0;
+      if (sscanf(line, "W %d%n", &id, &used) < 1 || id < 0) continue;
+      if (id >= wsize) {
+	int ns = 2*id+1;
+	char** nw2 = new char*[ns];
+	for (int i = 0; i < ns; i++) nw2[i] = i < wsize ? w[i] : 0;
+	delete[] w; w = nw2; wsize = ns;
+      }
+      // keep the rest of the line, without the newline:
+      const char* p = line+used;
+      while (*p == ' ') p++;
+      int len = strlen(p);
+      while (len && (p[len-1] == '\n' || p[len-1] == '\r')) len--;
+      delete[] w[id];
+      w[id] = new char[len+1];
+      memcpy(w[id], p, len); w[id][len] = 0;
+      if (id >= nw) nw = id+1;
+      continue;
+    }
+    if (n >= size) {
+      ReplayRecord* nr = new ReplayRecord[2*size];
+      memcpy(nr, r, n*sizeof(ReplayRecord));
+      delete[] r; r = nr; size *= 2;
+    }
+    ReplayRecord& e = r[n];
+    memset(&e, 0, sizeof(e));
+    if (line[0] == 'F') {
+      if (sscanf(line, "F %lf %d", &e.time, &e.window) == 2) n++;
+    } else if (line[0] == 'E') {
+      int used = 0;
+      if (sscanf(line, "E %lf %d %d %d %d %d %d %d %d %u %u %d %u %u %d %n",
+		 &e.time, &e.event, &e.window, &e.x, &e.y, &e.x_root, &e.y_root,
+		 &e.dx, &e.dy, &e.state, &e.keysym, &e.clicks, &e.is_click,
+		 &e.key_repeated, &e.device, &used) < 15 || !used) continue;
+      e.text = read_hex(line+used, e.length);
+      n++;
+    }
+  }
+  clear();
+  records = r;
+  nrecords = n;
+  windows = w;
+  nwindows = nw;
+  found = new Window*[nw ? nw : 1];
+  for (int i = 0; i < nw; i++) found[i] = 0;
+  latency_ = new float[n ? n : 1];
+  next_ = replayed_ = missing_ = 0;
+  return true;
+}
+
+/*! Same as load(FILE*) but it opens and closes the file. */
+bool EventReplay::load(const char* filename) {
+  FILE* f = fopen(filename, "r");
+  if (!f) return false;
+  bool ret = load(f);
+  fclose(f);
+  return ret;
+}
+
+// Find the window a recorded id refers to, by the label of the
+// top-level window and the child indexes:
+Window* EventReplay::find_window(int id) {
+  if (id < 0 || id >= nwindows || !windows[id]) return 0;
+  if (found[id] && found[id]->shown()) return found[id];
+  found[id] = 0;
+  const char* p = windows[id];
+  int length;
+  char* label = read_hex(p, length);
+  while (*p && *p != ' ') p++;
+  for (Window* top = Window::first(); top; top = top->next()) {
+    const char* l = top->label();
+    if (label ? !l || strcmp(l, label) : l && *l) continue;
+    Widget* widget = top;
+    const char* q = p;
+    while (widget && *q) {
+      char* e;
+      long i = strtol(q, &e, 10);
+      if (e == q) break;
+      q = e;
+      if (!widget->is_group() || i < 0 || i >= ((Group*)widget)->children())
+	{widget = 0; break;}
+      widget = ((Group*)widget)->child(int(i));
+    }
+    if (widget && widget->is_window()) {found[id] = (Window*)widget; break;}
+  }
+  delete[] label;
+  return found[id];
+}
+
+/*!
+  Send the next recorded event to fltk::handle() and then flush(), and
+  set its latency(). An add_fd() callback in the recording is skipped,
+  and the latency is zero, as the data that was read cannot be
+  played back. Returns false if there are no more.
+*/
+bool EventReplay::step() {
+  if (next_ >= nrecords) return false;
+  int i = next_++;
+  const ReplayRecord& r = records[i];
+  latency_[i] = 0;
+  if (!r.event) return true;
+  Window* window = find_window(r.window);
+  if (r.window >= 0 && !window) {missing_++; return true;}
+  e_x = r.x; e_y = r.y; e_x_root = r.x_root; e_y_root = r.y_root;
+  e_dx = r.dx; e_dy = r.dy;
+  e_state = r.state; e_keysym = r.keysym;
+  e_clicks = r.clicks; e_is_click = r.is_click;
+  e_key_repeated = r.key_repeated; e_device = r.device;
+  static char empty[1];
+  e_text = r.text ? r.text : empty;
+  e_length = r.length;
+  double start = trace_time();
+  handle(r.event, window);
+  flush();
+  latency_[i] = float(trace_time()-start);
+  replayed_++;
+  return true;
+}
+
+/*!
+  Play back all the remaining records. If \a speed is zero they are
+  sent as fast as possible, with a check() between them so timeouts
+  and redraws are done. Otherwise the time between them is the
+  recorded time divided by \a speed, and wait() is called until then.
+*/
+void EventReplay::run(float speed) {
+  double start = trace_time();
+  double first = next_ < nrecords ? records[next_].time : 0;
+  while (!done()) {
+    if (speed > 0) {
+      double when = start + (records[next_].time-first)/speed;
+      for (;;) {
+	double t = when-trace_time();
+	if (t <= 0) break;
+	wait(float(t));
+      }
+    } else {
+      check();
+    }
+    step();
+  }
+}
+
+static int compare_floats(const void* a, const void* b) {
+  float x = *(const float*)a, y = *(const float*)b;
+  return x < y ? -1 : x > y;
+}
+
+/*!
+  Return the latency that fraction \a p of the replayed events took
+  less than, for instance percentile(.5) is the median and
+  percentile(1) the longest. Only events that were sent to handle()
+  are counted.
+*/
+float EventReplay::percentile(float p) const {
+  float* a = new float[next_ ? next_ : 1];
+  int n = 0;
+  for (int i = 0; i < next_; i++)
+    if (records[i].event && latency_[i] > 0) a[n++] = latency_[i];
+  float r = 0;
+  if (n) {
+    qsort(a, n, sizeof(float), compare_floats);
+    int i = int(p*(n-1)+.5f);
+    if (i < 0) i = 0; else if (i >= n) i = n-1;
+    r = a[i];
+  }
+  delete[] a;
+  return r;
+}
+
+//
+// End of "$Id$".
+//
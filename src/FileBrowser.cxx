@@ -39,6 +39,7 @@
 // Include necessary header files...
 //
 
+#include <config.h>
 #include <fltk/FileBrowser.h>
 #include <fltk/Browser.h>
 #include <fltk/Item.h>
@@ -79,6 +80,383 @@
 
 using namespace fltk;
 
+////////////////////////////////////////////////////////////////
+//#include <pixmaps/file_small.xpm>
+//#include <fltk/xpmImage.h>
+
+// The items made by load() keep the dirent as their label, and find
+// their icon the first time they are drawn, so only the visible rows
+// pay for matching the icon patterns:
+class FileItem : public Item {
+public:
+    FileItem(const char * label, FileIcon * icon);
+    FileItem(dirent* entry, int type);
+    ~FileItem();
+    void draw();
+    dirent* entry() const {return entry_;}
+private:
+    FileIcon* fileIcon_;
+    dirent* entry_;	// made by malloc(), or null if label was strdup'd
+    int type_;		// FileIcon type to find the icon with, or -1
+};
+
+FileItem::FileItem(const char * label, FileIcon * icon) : Item(label) {
+    fileIcon_=icon;
+    entry_ = 0;
+    type_ = -1;
+    textsize(14);
+    if(icon) icon->value(this,true);
+}
+
+FileItem::FileItem(dirent* entry, int type) : Item(entry->d_name) {
+    fileIcon_ = 0;
+    entry_ = entry;
+    type_ = type;
+    textsize(14);
+}
+
+FileItem::~FileItem() {
+    free(entry_);
+}
+
+void FileItem::draw()  {
+  if (type_ >= 0 && parent()) {
+    char filename[4096];
+    snprintf(filename, sizeof(filename), "%s/%s",
+             ((FileBrowser*)parent())->directory(), entry_->d_name);
+    fileIcon_ = FileIcon::find(filename, type_);
+    type_ = -1;
+  }
+  if (fileIcon_) fileIcon_->value(this,true);
+    Item::draw();
+}
+
+// Make an item for load() without adding it to Group::current():
+static FileItem* new_item(FileBrowser* b, dirent* entry, int type) {
+  Group* g = Group::current();
+  Group::current(0);
+  FileItem* i = new FileItem(entry, type);
+  Group::current(g);
+  i->w((int) b->icon_size());  i->h(i->w());
+  return i;
+}
+
+// Return true if load() does not show this file:
+static bool hidden(const char* name, bool show_hidden) {
+  return !strcmp(name, ".") || !strcmp(name, "./") ||
+    (!show_hidden && name[0]=='.' && strncmp(name, "../", 2));
+}
+
+// Return the FileIcon type of a directory entry. The d_type filled in
+// by readdir() is used when the system has it, otherwise the file is
+// stat()ed, which is very slow on network filesystems. Symbolic links
+// are also stat()ed, as they have the type of what they point at.
+static int entry_type(const char* directory, const dirent* d) {
+#ifdef DT_DIR
+  switch (d->d_type) {
+  case DT_DIR: return FileIcon::DIRECTORY;
+  case DT_REG: return FileIcon::PLAIN;
+  case DT_FIFO: return FileIcon::FIFO;
+  case DT_CHR:
+  case DT_BLK: return FileIcon::DEVICE;
+  }
+#endif
+  char filename[4096];
+  struct stat fileinfo;
+  snprintf(filename, sizeof(filename), "%s/%s", directory, d->d_name);
+  if (fltk_stat(filename, &fileinfo)) return FileIcon::PLAIN;
+  if (S_ISDIR(fileinfo.st_mode)) return FileIcon::DIRECTORY;
+#ifdef S_ISFIFO
+  if (S_ISFIFO(fileinfo.st_mode)) return FileIcon::FIFO;
+#endif
+#if defined(S_ISCHR) && defined(S_ISBLK)
+  if (S_ISCHR(fileinfo.st_mode) || S_ISBLK(fileinfo.st_mode))
+    return FileIcon::DEVICE;
+#endif
+  return FileIcon::PLAIN;
+}
+
+////////////////////////////////////////////////////////////////
+// Streaming load():
+//
+// The directory is read by a ThreadPool::shared() task or, if the program does not
+// use threads, by idle callbacks. Each batch of entries that has been
+// read is sorted and merged into the items that are already shown.
+
+#if (defined(WIN32) && !defined(__CYGWIN__)) || defined(__EMX__)
+# define STREAM_LOAD 0
+#else
+# define STREAM_LOAD 1
+#endif
+
+#if STREAM_LOAD
+#include <fltk/run.h>
+
+// <fltk/filename.h> may have made dirent be dirent64:
+#ifdef scandir
+# define readdir readdir64
+#endif
+
+enum {
+  POST_TIME = 100,	// milliseconds between batches sent by the thread
+  IDLE_TIME = 20	// milliseconds read by each idle callback
+};
+
+extern bool fl_lock_started(); // in lock.cxx
+
+namespace fltk {
+struct FileBrowserJob {
+  FileBrowser* owner;	// null if the browser was destroyed or reloaded
+  TimeoutHandler done_cb;	// FileBrowser::batch_cb
+  char* directory;
+  DIR* dir;		// closed when all of it is read
+  dirent** list;	// entries read since the last batch was merged
+  signed char* types;
+  int n, size;
+  int dirs;		// how many items are directories
+  bool threaded;
+  bool cancelled;	// tells the thread to stop
+  bool done;		// the thread has finished
+  bool posted;		// batch_cb is posted
+  double posttime;
+};
+}
+
+static void push_entry(FileBrowserJob* j, const dirent* d, int type) {
+  if (j->n >= j->size) {
+    j->size = j->size ? 2*j->size : 256;
+    j->list = (dirent**)realloc(j->list, j->size*sizeof(dirent*));
+    j->types = (signed char*)realloc(j->types, j->size);
+  }
+  size_t n = (const char*)d->d_name - (const char*)d + strlen(d->d_name) + 1;
+  dirent* e = (dirent*)malloc(n < sizeof(dirent) ? sizeof(dirent) : n);
+  memcpy(e, d, n);
+  j->list[j->n] = e;
+  j->types[j->n] = type;
+  j->n++;
+}
+
+static void free_entries(dirent** list, int n) {
+  for (int i = 0; i < n; i++) free(list[i]);
+  free(list);
+}
+
+static void free_job(FileBrowserJob* j) {
+  if (j->dir) closedir(j->dir);
+  free_entries(j->list, j->n);
+  free(j->types);
+  free(j->directory);
+  delete j;
+}
+
+#if HAVE_PTHREAD
+#include <fltk/Threads.h>
+
+static Mutex* job_mutex;
+
+// A ThreadPool task that reads the whole directory:
+static void reader(void* arg) {
+  FileBrowserJob* j = (FileBrowserJob*)arg;
+  for (;;) {
+    dirent* d = readdir(j->dir);
+    int type = d ? entry_type(j->directory, d) : 0;
+    job_mutex->lock();
+    if (!d || j->cancelled) {
+      closedir(j->dir);
+      j->dir = 0;
+      j->done = true;
+    } else {
+      push_entry(j, d, type);
+    }
+    bool post_it = false;
+    if (!j->posted &&
+        (j->done || get_time_secs() - j->posttime >= POST_TIME/1000.0)) {
+      j->posted = post_it = true;
+      j->posttime = get_time_secs();
+    }
+    bool done = j->done;
+    job_mutex->unlock();
+    // j may be freed as soon as the last batch is posted:
+    if (post_it) post(j->done_cb, j);
+    if (done) return;
+  }
+}
+#endif
+
+/** Called by the main thread for each batch the reading thread sends. */
+void FileBrowser::batch_cb(void* arg) {
+#if HAVE_PTHREAD
+  FileBrowserJob* j = (FileBrowserJob*)arg;
+  job_mutex->lock();
+  dirent** list = j->list;
+  signed char* types = j->types;
+  int n = j->n;
+  j->list = 0;
+  j->types = 0;
+  j->n = j->size = 0;
+  j->posted = false;
+  bool done = j->done;
+  job_mutex->unlock();
+  FileBrowser* b = j->owner;
+  if (b) {
+    b->merge(list, (const char*)types, n);
+    if (done) b->job_ = 0;
+  } else {
+    free_entries(list, n);
+    list = 0;
+  }
+  free(list);
+  free(types);
+  if (done) free_job(j);
+#endif
+}
+
+/** Called when the directory is read by idle callbacks. */
+void FileBrowser::idle_cb(void* arg) {
+  FileBrowserJob* j = (FileBrowserJob*)arg;
+  double start = get_time_secs();
+  do {
+    dirent* d = readdir(j->dir);
+    if (!d) {j->done = true; break;}
+    push_entry(j, d, entry_type(j->directory, d));
+  } while (get_time_secs() - start < IDLE_TIME/1000.0);
+  FileBrowser* b = j->owner;
+  b->merge(j->list, (const char*)j->types, j->n);
+  free(j->list); j->list = 0;
+  free(j->types); j->types = 0;
+  j->n = j->size = 0;
+  if (j->done) {
+    remove_idle(idle_cb, j);
+    b->job_ = 0;
+    free_job(j);
+  }
+}
+
+// Start reading the directory for a streaming load():
+int FileBrowser::start_loading() {
+  DIR* dir = opendir(directory_);
+  if (!dir) return 0;
+  FileBrowserJob* j = new FileBrowserJob;
+  memset(j, 0, sizeof(*j));
+  j->owner = this;
+  j->done_cb = batch_cb;
+  j->directory = strdup(directory_);
+  j->dir = dir;
+  job_ = j;
+#if HAVE_PTHREAD
+  if (fl_lock_started()) {
+    if (!job_mutex) job_mutex = new Mutex;
+    j->threaded = true;
+    j->posttime = get_time_secs();
+    ThreadPool::shared()->add(reader, j);
+    return 1;
+  }
+#endif
+  add_idle(idle_cb, j);
+  return 1;
+}
+
+// Stop a streaming load() that is still reading:
+void FileBrowser::stop_loading() {
+  FileBrowserJob* j = job_;
+  if (!j) return;
+  job_ = 0;
+  j->owner = 0;
+#if HAVE_PTHREAD
+  if (j->threaded) {
+    // the last batch_cb frees it:
+    job_mutex->lock();
+    j->cancelled = true;
+    job_mutex->unlock();
+    return;
+  }
+#endif
+  remove_idle(idle_cb, j);
+  free_job(j);
+}
+
+struct FileEntry {
+  dirent* d;	// first, so this looks like the dirent* to the sort function
+  int type;
+};
+
+static FileSortF* entry_sort;
+static int compare_entries(const void* a, const void* b) {
+  return entry_sort(&((const FileEntry*)a)->d, &((const FileEntry*)b)->d);
+}
+
+// Merge a batch of n entries into the items, taking ownership of them:
+void FileBrowser::merge(dirent** list, const char* types, int n) {
+  if (!n) return;
+  FileEntry* add = new FileEntry[n];
+  int ndirs = 0, nfiles = 0;
+  int i;
+  // directories are put at the start of add, files at the end:
+  for (i = 0; i < n; i++) {
+    if (hidden(list[i]->d_name, show_hidden_)) {
+      free(list[i]);
+    } else if (types[i] == FileIcon::DIRECTORY) {
+      add[ndirs].d = list[i];
+      add[ndirs++].type = types[i];
+    } else if (filetype_ == FILES &&
+               filter_patterns_.match(list[i]->d_name) >= 0) {
+      nfiles++;
+      add[n-nfiles].d = list[i];
+      add[n-nfiles].type = types[i];
+    } else {
+      free(list[i]);
+    }
+  }
+  if (ndirs || nfiles) {
+    if (sort_) {
+      entry_sort = sort_;
+      qsort(add, ndirs, sizeof(FileEntry), compare_entries);
+      qsort(add+n-nfiles, nfiles, sizeof(FileEntry), compare_entries);
+    }
+    int old = children();
+    Widget* focus = value() >= 0 && value() < old ? child(value()) : 0;
+    Widget** order = new Widget*[old+ndirs+nfiles];
+    int k = 0;
+    int a = 0;
+    for (int pass = 0; pass < 2; pass++) {
+      FileEntry* p = pass ? add+n-nfiles : add;
+      FileEntry* e = pass ? add+n : add+ndirs;
+      int end = pass ? old : job_->dirs;
+      while (a < end || p < e) {
+        dirent* d = a < end ? ((FileItem*)child(a))->entry() : 0;
+        if (p < e && (a >= end || (sort_ && d && sort_(&p->d, &d) < 0))) {
+          order[k++] = new_item(this, p->d, p->type);
+          p++;
+        } else {
+          order[k++] = child(a++);
+        }
+      }
+    }
+    job_->dirs += ndirs;
+    remove_all();
+    reserve(k);
+    for (i = 0; i < k; i++) Group::add(*order[i]);
+    delete[] order;
+    if (focus) {
+      i = Group::find(focus);
+      if (i != value()) value(i);
+    }
+  }
+  delete[] add;
+}
+
+#else
+
+void FileBrowser::batch_cb(void*) {}
+void FileBrowser::idle_cb(void*) {}
+int FileBrowser::start_loading() {return 0;}
+void FileBrowser::stop_loading() {}
+void FileBrowser::merge(dirent**, const char*, int) {}
+
+#endif
+
+////////////////////////////////////////////////////////////////
+
 /** \class fltk::FileBrowser
   The fltk::FileBrowser widget displays a list of filenames, optionally
   with file-specific icons.
@@ -94,21 +472,39 @@ using namespace fltk;
 FileBrowser::FileBrowser(int X, int Y, int W, int H, const char *l) : Browser(X, Y, W, H, l) {
   // Initialize the filter pattern, current directory, and icon size...
   pattern_   = "*";
+  filter_patterns_.add(pattern_);
   directory_ = "";
   icon_size_  = -1.0f;
   filetype_  = FILES;
   show_hidden_ = false;
+  sort_ = 0;
+  job_ = 0;
+  streaming_ = false;
+}
+
+FileBrowser::~FileBrowser() {
+  stop_loading();
 }
 
 /** Load a directory into the browser.
+
+  Only the type of each file is found, by the d_type that readdir()
+  returns on most systems, or by stat() if it does not. The icons are
+  found when the items are first drawn.
+
+  If streaming() is on this returns before the directory is read, and
+  the files are added, in sorted order, as they are read by another
+  thread (or by idle callbacks if fltk::lock() has not been called).
+  loading() is true until all of them are there.
+
   \param directory Directory to load
   \param sort Sorting function to use
-  \return Number of files loaded
+  \return Number of files loaded, or in streaming() mode 1 if the
+  directory could be opened
 */
 int FileBrowser::load(const char *directory, FileSortF *sort) {
   int		i;				// Looping var
   int		num_files;			// Number of files in directory
-  int		num_dirs;			// Number of directories in list
   char		filename[4096];			// Current file
   FileIcon	*icon;				// Icon to use
 
@@ -118,9 +514,11 @@ int FileBrowser::load(const char *directory, FileSortF *sort) {
   if (!directory)
     return (0);
 
+  stop_loading();
   clear();
   yposition(0);
   directory_ = directory;
+  sort_ = sort;
 
   if (directory_[0] == '\0')
   {
@@ -256,6 +654,7 @@ int FileBrowser::load(const char *directory, FileSortF *sort) {
   else
   {
     dirent	**files;	// Files in in directory
+    signed char	*types;		// FileIcon type of each, or -1 to skip it
 
 
     //
@@ -274,37 +673,40 @@ int FileBrowser::load(const char *directory, FileSortF *sort) {
 
     num_files = fltk::filename_list(filename, &files, sort);
 #else
+    if (streaming_)
+      return start_loading();
+
     num_files = fltk::filename_list(directory_, &files, sort);
 #endif /* WIN32 || __EMX__ */
 
     if (num_files <= 0)
       return (0);
 
-    for (i = 0, num_dirs = 0; i < num_files; i ++) {
-      if (strcmp(files[i]->d_name, "./") ) {
-	snprintf(filename, sizeof(filename), "%s/%s", directory_,
-	         files[i]->d_name);
-
-        //bool ft = true;	if (ft) {FileIcon::load_system_icons(); ft=false;}
-
-        icon = FileIcon::find(filename);
-	//printf("%s\n",files[i]->d_name);
-	if (!strcmp(files[i]->d_name, ".") || !strcmp(files[i]->d_name, "./") ||
-	    (!show_hidden_ &&  files[i]->d_name[0]=='.' &&  strncmp(files[i]->d_name,"../",2)))
-	  continue;
-	if ((icon && icon->type() == FileIcon::DIRECTORY) ||
-	     fltk::filename_isdir(filename)) {
-          num_dirs ++;
-          this->insert(num_dirs-1, files[i]->d_name, icon);
-	} else if (filetype_ == FILES &&
-	           fltk::filename_match(files[i]->d_name, pattern_)) {
-          add(files[i]->d_name, icon);
-	}
+    // Only the type is found now, icons are found when items are drawn:
+    types = new signed char[num_files];
+    for (i = 0; i < num_files; i ++) {
+      types[i] = -1;
+      if (hidden(files[i]->d_name, show_hidden_))
+        continue;
+      int type = entry_type(directory_, files[i]);
+      if (type == FileIcon::DIRECTORY) {
+        types[i] = type;
+      } else if (filetype_ == FILES &&
+                 filter_patterns_.match(files[i]->d_name) >= 0) {
+        types[i] = type;
       }
-
-      free(files[i]);
     }
 
+    // Directories go first, both in the order of the sort function:
+    for (i = 0; i < num_files; i ++)
+      if (types[i] == FileIcon::DIRECTORY)
+        Group::add(new_item(this, files[i], types[i]));
+    for (i = 0; i < num_files; i ++)
+      if (types[i] < 0) free(files[i]);
+      else if (types[i] != FileIcon::DIRECTORY)
+        Group::add(new_item(this, files[i], types[i]));
+
+    delete[] types;
     free(files);
   }
 
@@ -320,29 +722,19 @@ void FileBrowser::filter(const char *pattern)	{
   // If pattern is NULL set the pattern to "*"...
   if (pattern) pattern_ = pattern;
   else pattern_ = "*";
+  filter_patterns_.clear();
+  filter_patterns_.add(pattern_);
 }
 
-////////////////////////////////////////////////////////////////
-//#include <pixmaps/file_small.xpm>
-//#include <fltk/xpmImage.h>
-class FileItem : public Item {
-public:
-    FileItem(const char * label, FileIcon * icon);
-    void draw();
-private:
-    FileIcon* fileIcon_;
-};
-
-FileItem::FileItem(const char * label, FileIcon * icon) : Item(label) {
-    fileIcon_=icon;
-    textsize(14);
-    if(icon) icon->value(this,true);
-}
-void FileItem::draw()  {
-  if (fileIcon_) fileIcon_->value(this,true);
-    Item::draw();
+/** Returns true if load() would show a file called \a name, which is
+  a directory if \a isdir is true. This checks the filter() and
+  show_hidden() without reading the directory.
+*/
+bool FileBrowser::shows(const char *name, bool isdir) const {
+  if (hidden(name, show_hidden_)) return false;
+  if (isdir) return true;
+  return filetype_ == FILES && filter_patterns_.match(name) >= 0;
 }
-////////////////////////////////////////////////////////////////
 
 /** Add a line to the filebrowser
   \param line Name of the line to add
@@ -30,6 +30,8 @@
 #include <fltk/draw.h>
 #include <fltk/run.h>
 #include <fltk/Cursor.h>
+#include <fltk/SharedImage.h>
+#include <string.h>
 using namespace fltk;
 
 inline void FileChooser::cb_window_i(fltk::DoubleBufferWindow*, void*) {
@@ -180,6 +182,8 @@ void FileChooser::cb_favOkButton(fltk::ReturnButton* o, void* v) {
 
 FileChooser::FileChooser(const char *d, const char *p, int t, const char *title) {
   fltk::DoubleBufferWindow* w;
+  memset(preview_cache_, 0, sizeof(preview_cache_));
+  preview_loading_ = 0;
    {fltk::DoubleBufferWindow* o = window = new fltk::DoubleBufferWindow(490, 380, "Choose File");
     o->type(241);
     o->shortcut(0xff1b);
@@ -352,6 +356,9 @@ FileChooser::FileChooser(const char *d, const char *p, int t, const char *title)
 
 FileChooser::~FileChooser() {
   fltk::remove_timeout((TimeoutHandler)previewCB, this);
+  if (preview_loading_) preview_loading_->cancel_fetch();
+  for (int i = 0; i < PREVIEW_CACHE && preview_cache_[i]; i++)
+    preview_cache_[i]->remove();
   delete window;
   delete favWindow;
 }
@@ -149,6 +149,10 @@ using namespace fltk;
        <TD>preview_label</TD>
        <TD>"Preview"</TD>
     </TR>
+    <TR>
+       <TD>preview_loading_label</TD>
+       <TD>"Loading..."</TD>
+    </TR>
     <TR>
        <TD>save_label</TD>
        <TD>"Save"</TD>
@@ -197,6 +201,7 @@ const char	*FileChooser::manage_favorites_label = "Manage Favorites";
 const char	*FileChooser::new_directory_label = "New Directory?";
 const char	*FileChooser::new_directory_tooltip = "Create a new directory.";
 const char	*FileChooser::preview_label = "Preview";
+const char	*FileChooser::preview_loading_label = "Loading...";
 const char	*FileChooser::save_label = "Save";
 const char	*FileChooser::show_label = "Show:";
 FileSortF	*FileChooser::sort = fltk::casenumericsort;
@@ -210,6 +215,18 @@ static int	compare_dirnames(const char *a, const char *b);
 static void	quote_pathname(char *, const char *, int);
 static void	unquote_pathname(char *, const char *, int);
 
+// The directory index, in filename_index.cxx:
+extern void	fl_index_directory(const char *);
+extern int	fl_filename_complete(const char *, const char *, char *, int,
+				     bool (*)(const char *, bool, void *),
+				     void *);
+extern int	fl_filename_type(const char *, const char *);
+
+// Tell fl_filename_complete() which names the browser shows:
+static bool shown_in(const char *name, bool isdir, void *browser) {
+  return ((FileBrowser *)browser)->shows(name, isdir);
+}
+
 
 /**
   Calculate the number of selected files.
@@ -601,9 +618,10 @@ void FileChooser::fileListCB() {
     }
     fileName->value(pathname);
 
-    // Update the preview box...
+    // Update the preview box, images are decoded by another thread so
+    // this only waits long enough to skip files that are scrolled past:
     fltk::remove_timeout((TimeoutHandler)previewCB, this);
-    fltk::add_timeout(0.5, (TimeoutHandler)previewCB, this);
+    fltk::add_timeout(0.1, (TimeoutHandler)previewCB, this);
 
     // Do any callback that is registered...
     if (callback_) (*callback_)(this, data_);
@@ -633,6 +651,7 @@ void FileChooser::fileNameCB() {
 		min_match,	// Minimum number of matching chars
 		max_match,	// Maximum number of matching chars
 		num_files,	// Number of files in directory
+		num_matches,	// Number of names the index found
 		first_line;	// First matching line
   const char	*file;		// File from directory
 
@@ -738,7 +757,35 @@ void FileChooser::fileNameCB() {
     max_match  = min_match + 1;
     first_line = 0;
 
-    for (i = 1; i <= num_files && max_match > min_match; i ++) {
+    // The directory index finds the matching names without reading the
+    // directory again, even if the list is not loaded yet...
+    num_matches = -1;
+    if (directory_[0])
+      num_matches = fl_filename_complete(directory_, filename, matchname,
+                                         sizeof(matchname), shown_in,
+                                         fileList);
+
+    if (num_matches > 0) {
+      max_match = strlen(matchname);
+
+      // Make the first matching item visible...
+      for (i = 1; i <= num_files; i ++) {
+	file = fileList->child(i-1)->label();
+#if (defined(WIN32) && ! defined(__CYGWIN__)) || defined(__EMX__)
+	if (strncasecmp(file, matchname, max_match) == 0) {
+#else
+	if (strncmp(file, matchname, max_match) == 0) {
+#endif // WIN32 || __EMX__
+	  fileList->topline(i);
+	  first_line = i;
+	  break;
+	}
+      }
+    }
+
+    // Otherwise look through the items...
+    for (i = 1; num_matches < 0 && i <= num_files && max_match > min_match;
+         i ++) {
       file = fileList->child(i-1)->label();
 
 #if (defined(WIN32) && ! defined(__CYGWIN__)) || defined(__EMX__)
@@ -786,7 +833,7 @@ void FileChooser::fileNameCB() {
       fileList->deselect(0);
       fileList->select(first_line - 1);
       fileList->redraw();
-    } else if (max_match > min_match && first_line) {
+    } else if (max_match > min_match && (first_line || num_matches > 0)) {
       // Add the matching portion...
       fileName->replace(filename - pathname, filename - pathname + min_match,
                         matchname,strlen(matchname));
@@ -949,7 +996,7 @@ void FileChooser::preview(bool e) {
 /**
   Timeout handler for the preview box.
 
-  This function calls update_preview on the FileChooser after a time lapse of half a second from when a file is first selected
+  This function calls update_preview on the FileChooser after a tenth of a second from when a file is first selected
 
   \param fc Which FileChooser to use
   \see update_preview()
@@ -970,6 +1017,9 @@ void FileChooser::previewCB(FileChooser *fc) {
 */
 
 void FileChooser::rescan() {
+  // Start reading the directory for filename completion...
+  if (directory_[0]) fl_index_directory(directory_);
+
   activate_okButton_if_file();
 
   // Build the file list...
@@ -1077,16 +1127,15 @@ void FileChooser::update_favorites() {
 
   This function updates the contents of the preview box with an image, or failing that attempts to load the first 1 kilobyte of a file (if it contains printable characters). Failing this, the function just prints a large "?" in the place of the file to be previewed.
 
+  Images are decoded by another thread, and preview_loading_label is shown until they are done. If the selection changes before then, the image that is no longer wanted is not decoded. The last few images shown are kept so going back to them is immediate.
+
   \return void
 */
 
 void FileChooser::update_preview() {
   const char		*cfilename;	// Current filename
   char			*filename; 	// UTF-8 converted filename
-  SharedImage		*image,		// New image
-			*oldimage;	// Old image
-  int			pbw, pbh;	// Width and height of preview box
-  int			w, h;		// Width and height of preview image
+  SharedImage		*image;		// New image
 
 
   if (!previewButton->value()) return;
@@ -1102,25 +1151,31 @@ void FileChooser::update_preview() {
     filename = NULL;
   }
   if (filename == NULL || fltk::filename_isdir(filename)) image = NULL;
-  else {
-    window->cursor(fltk::CURSOR_WAIT);
-    fltk::check();
-
-    image = SharedImage::get(filename);
+  else image = preview_image(filename);
 
-    if (image) {
-      window->cursor(fltk::CURSOR_DEFAULT);
-      fltk::check();
-    }
+  // The image for the previous selection is not wanted any more:
+  if (preview_loading_ && preview_loading_ != image) {
+    preview_loading_->cancel_fetch();
+    preview_loading_ = 0;
   }
 
-  oldimage = (SharedImage *)previewBox->image();
-
-  if (oldimage) oldimage->remove();
-
   previewBox->image((Symbol*)0);
 
-  if (!image) {
+  if (image && (image == preview_loading_ ||
+		image->fetch_in_background(preview_fetched, this))) {
+    // Show a placeholder until preview_fetched() is called:
+    preview_loading_ = image;
+    previewBox->label(preview_loading_label);
+    previewBox->align(fltk::ALIGN_CLIP);
+    previewBox->labelsize(14);
+    previewBox->labelfont(fltk::HELVETICA);
+  } else if (image) {
+    // Already fetched, or there are no threads to do it with:
+    window->cursor(fltk::CURSOR_WAIT);
+    fltk::check();
+    show_preview_image(image);
+    window->cursor(fltk::CURSOR_DEFAULT);
+  } else {
     FILE	*fp;
     int		bytes;
     char	*ptr;
@@ -1138,9 +1193,6 @@ void FileChooser::update_preview() {
       preview_text_[0] = '\0';
     }
 
-    window->cursor(fltk::CURSOR_DEFAULT);
-    fltk::check();
-
     // Scan the buffer for printable chars...
     for (ptr = preview_text_;
          *ptr && (isprint(*ptr & 255) || isspace(*ptr & 255));
@@ -1164,32 +1216,68 @@ void FileChooser::update_preview() {
       previewBox->labelsize((uchar)size);
       previewBox->labelfont(fltk::COURIER);
     }
-  } else {
-    pbw = previewBox->w() - 20;
-    pbh = previewBox->h() - 20;
+  }
 
-    if (image->w() > pbw || image->h() > pbh) {
-      w   = pbw;
-      h   = w * image->h() / image->w();
+  free(filename);
+  previewBox->redraw();
+}
 
-      if (h > pbh) {
-	h = pbh;
-	w = h * image->w() / image->h();
-      }
-      image->setsize(w,h);
-      previewBox->image((Image *)image);
-    } else {
-      previewBox->image((Image *)image);
-    }
+/**
+  Return the image for the preview of filename, or NULL if it is not
+  an image file. Jpeg and png files are decoded about the size of the
+  preview. The last PREVIEW_CACHE images returned are kept, and the
+  oldest is removed when another one is added.
+*/
+SharedImage *FileChooser::preview_image(const char *filename) {
+  SharedImage *image = SharedImage::get(filename, previewBox->w() - 20,
+					previewBox->h() - 20);
+  if (!image) return NULL;
+
+  int i;
+  for (i = 0; i < PREVIEW_CACHE-1; i ++)
+    if (!preview_cache_[i] || preview_cache_[i] == image) break;
+  if (preview_cache_[i] && preview_cache_[i] != image)
+    preview_cache_[i]->remove();
+  memmove(preview_cache_+1, preview_cache_, i*sizeof(SharedImage*));
+  preview_cache_[0] = image;
+  return image;
+}
 
-    previewBox->align(fltk::ALIGN_CLIP);
-    previewBox->label(0);
-    previewBox->set_flag(fltk::RESIZE_FIT);
-  }
+/**
+  Put a fetched image in the preview box, scaled down to fit.
+*/
+void FileChooser::show_preview_image(SharedImage *image) {
+  int pbw = previewBox->w() - 20;	// Width and height of preview box
+  int pbh = previewBox->h() - 20;
+
+  if (image->w() > pbw || image->h() > pbh) {
+    int w = pbw;
+    int h = w * image->h() / image->w();
 
+    if (h > pbh) {
+      h = pbh;
+      w = h * image->w() / image->h();
+    }
+    image->setsize(w,h);
+  }
+  previewBox->image((Image *)image);
+  previewBox->align(fltk::ALIGN_CLIP);
+  previewBox->label(0);
+  previewBox->set_flag(fltk::RESIZE_FIT);
   previewBox->redraw();
 }
 
+/**
+  Called by SharedImage::fetch_in_background() when the image being
+  previewed has been decoded.
+*/
+void FileChooser::preview_fetched(SharedImage *image, void *v) {
+  FileChooser *fc = (FileChooser *)v;
+  if (fc->preview_loading_ != image) return;
+  fc->preview_loading_ = 0;
+  fc->show_preview_image(image);
+}
+
 /** Update the sorting method
 
   This function completely re-loads the displayed FileList.
@@ -1366,8 +1454,27 @@ void FileChooser::value(const char *filename) {
   \return void
 */
 void FileChooser::activate_okButton_if_file() {
-    if (((type_ & CREATE) || !access(fileName->text(), 0)) &&
-        (!fltk::filename_isdir(fileName->text()) || (type_ & DIRECTORY)))
+    // Ask the directory index first, so typing a name does not stat()
+    // the file each time...
+    const char *text = fileName->text();
+    const char *name = fltk::filename_name(text);
+    int type = -2; // 1 = directory, 0 = file, -1 = missing, -2 = unknown
+    if (*name && name > text) {
+      char dir[1024];
+      int n = name - text - 1;
+      // keep the slash of a root directory:
+      if (!n || (n == 2 && text[1] == ':')) n ++;
+      if (n < (int)sizeof(dir)) {
+        memcpy(dir, text, n);
+        dir[n] = '\0';
+        type = fl_filename_type(dir, name);
+      }
+    }
+    if (type == -2)
+      type = access(text, 0) ? -1 : fltk::filename_isdir(text);
+
+    if (((type_ & CREATE) || type >= 0) &&
+        (type != 1 || (type_ & DIRECTORY)))
       okButton->activate();
     else
       okButton->deactivate();
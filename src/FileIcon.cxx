@@ -78,6 +78,19 @@ using namespace fltk;
 
 FileIcon	*FileIcon::first_ = (FileIcon *)0;
 
+// The patterns of the icons, compiled by find() the first time it is
+// called after an icon is made or destroyed. Pattern n is for the n'th
+// icon in the list, and its mask is 1<<type():
+static FilenamePatterns	*icon_patterns = 0;
+static FileIcon		**icon_list = 0;
+
+static void forget_patterns() {
+  delete icon_patterns;
+  icon_patterns = 0;
+  delete[] icon_list;
+  icon_list = 0;
+}
+
 
 //
 // 'FileIcon::FileIcon()' - Create a new file icon.
@@ -106,6 +119,7 @@ FileIcon::FileIcon(const char *p,	/* I - Filename pattern */
   // And add the icon to the list of icons...
   next_  = first_;
   first_ = this;
+  forget_patterns();
   w_= h_=16;
   on_select_ = false;
   image_=0;
@@ -150,6 +164,7 @@ FileIcon::~FileIcon()
       prev->next_ = current->next_;
     else
       first_ = current->next_;
+    forget_patterns();
   }
 
   // Free any memory used...
@@ -215,7 +230,7 @@ FileIcon *				// O - Matching file icon or NULL
 FileIcon::find(const char *filename,	// I - Name of file */
 		  int	filetype)	// I - Enumerated file type
 {
-  FileIcon	*current;		// Current file in list
+  FileIcon	*current;		// Current icon in list
   struct stat	fileinfo;		// Information on file
 
   // Get file information if needed...
@@ -240,15 +255,26 @@ FileIcon::find(const char *filename,	// I - Name of file */
 	filetype = PLAIN;
     }
 
-  // Loop through the available file types and return any match that
-  // is found...
-  for (current = first_; current != (FileIcon *)0; current = current->next_)
-    if ((current->type_ == filetype || current->type_ == ANY) &&
-	filename_match(filename, current->pattern_))
-      break;
+  // Compile the patterns of all the icons if needed...
+  if (!icon_patterns)
+  {
+    int n = 0;
+    for (current = first_; current != (FileIcon *)0; current = current->next_)
+      n ++;
+    icon_patterns = new FilenamePatterns;
+    icon_list     = new FileIcon *[n + 1];
+    for (current = first_, n = 0; current != (FileIcon *)0; current = current->next_)
+      if (current->pattern_)
+      {
+        icon_list[n ++] = current;
+	icon_patterns->add(current->pattern_, 1u << current->type_);
+      }
+  }
 
-  // Return the match (if any)...
-  return (current);
+  // Return the first icon whose pattern matches and whose type is the
+  // file's type or ANY...
+  int n = icon_patterns->match(filename, (1u << filetype) | (1u << ANY));
+  return (n < 0 ? (FileIcon *)0 : icon_list[n]);
 }
 
 
@@ -28,6 +28,8 @@
 #include <fltk/draw.h>
 #include <fltk/x.h>
 #include <fltk/string.h>
+#include <fltk/trace.h>
+#include "DisplayList.h"
 
 /** \class fltk::Font
 
@@ -94,6 +96,66 @@ fltk::Font* fltk::current_font_;
 float fltk::current_size_;
 const char *fltk::encoding_ = "iso10646-1";
 
+// Each FontSize in the system-specific code has one of these:
+struct WidthCache;
+extern float fl_cached_width(WidthCache*&, const char*, int,
+			     float (*measure)(const char*, int));
+extern void fl_free_width_cache(WidthCache*);
+extern unsigned long fl_width_cache_bytes(const WidthCache*);
+extern float fl_sum_advances(const float* advances, const char*, int);
+
+bool fltk::Font::fast_metrics_;
+
+/*! \fn void fltk::Font::fast_metrics(bool)
+  Turn on a faster getwidth() for all fonts. The first time a font and
+  size is measured a table of the widths of the first 256 Unicode
+  characters is made, and any string of only those characters is
+  measured by adding up the widths. Kerning and any other interaction
+  between characters is ignored, so the result may be a pixel or so
+  different than drawtext() produces. Strings with other characters
+  are measured normally.
+
+  This greatly speeds up TextDisplay, Input and anything else that
+  measures the text a character at a time to position the cursor.
+  It is only implemented for Xft and Windows, and is off by default.
+*/
+
+/*! \fn bool fltk::Font::fast_metrics()
+  Return the value set by fast_metrics(bool).
+*/
+
+int fltk::Font::max_open_fonts_ = 128;
+
+/*! \fn void fltk::Font::max_open_fonts(int)
+  Set how many font+size combinations may be open at once. Each one
+  that is open has glyph images stored by the X server, so a program
+  that draws many sizes, such as when zooming, can use a lot of
+  memory. Above this the least recently used ones are closed, and
+  opened again if they are used. Zero means no limit. The default is
+  128. This is only implemented for Xft.
+*/
+
+/*! \fn int fltk::Font::max_open_fonts()
+  Return the value set by max_open_fonts(int).
+*/
+
+float fltk::Font::size_step_;
+
+/*! \fn void fltk::Font::size_step(float)
+  Round the size passed to setfont() to a multiple of this, so that
+  text drawn at continuously changing sizes uses only a few fonts.
+  getsize() then returns the rounded size. Zero (the default) uses
+  the size unchanged. This is only implemented for Xft.
+*/
+
+/*! \fn float fltk::Font::size_step()
+  Return the value set by size_step(float).
+*/
+
+#if !(USE_X11 && USE_XFT)
+int fltk::Font::open_fonts() {return 0;}
+#endif
+
 #if USE_X11
 # include "x11/Font.cxx"
 #elif defined(_WIN32)
@@ -135,6 +197,7 @@ void fltk::drawtext(const char* text, float x, float y) {
 */
 void fltk::drawtext(const char* text, int n, float x, float y) {
   transform(x,y);
+  if (fl_display_list) fl_display_list->text(text, n, x, y);
   drawtext_transformed(text, n, x, y);
 }
 
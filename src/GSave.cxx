@@ -27,6 +27,7 @@
 
 #include <config.h>
 #include <fltk/x.h>
+#include <fltk/Image.h>
 namespace fltk {class Image;}
 using namespace fltk;
 
@@ -88,6 +89,10 @@ GSave::~GSave() {
   fl_clip_h = v & 0xffff;
 #if USE_X11
   if (data[0]) draw_into((XWindow)(data[0]), fl_clip_w, fl_clip_h);
+# if USE_CAIRO
+  // Image::make_current() draws with no xwindow:
+  else if (data[2]) ((fltk::Image*)data[2])->make_current();
+# endif
 #elif defined(_WIN32)
   dc = (HDC)(data[0]);
   DeleteDC(fl_bitmap_dc);
@@ -0,0 +1,194 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#include <config.h>
+#include <fltk/GlyphRun.h>
+#include <fltk/Font.h>
+#include <fltk/draw.h>
+#include <fltk/math.h>
+#include <fltk/utf.h>
+#include <fltk/x.h>
+#include <fltk/trace.h>
+#include <string.h>
+#include "DisplayList.h"
+
+using namespace fltk;
+
+#if USE_X11 && USE_XFT
+extern void fl_xft_color(XftColor&); // in x11/Font_xft.cxx
+#endif
+
+/*! \class fltk::GlyphRun
+
+  A string laid out in a font and size once, so it can be drawn and
+  measured many times without decoding the UTF-8 and looking up every
+  character again. A widget that draws the same lines repeatedly, such
+  as a text display or a browser, can keep one of these per line and
+  only set() it again when the line changes.
+
+  The characters are placed by adding up their widths, the same as
+  drawtext() does on all the current systems, so draw() produces the
+  same picture as drawtext() and width() is the same as getwidth().
+*/
+
+/*! Makes an empty run, use set() to put something in it. */
+GlyphRun::GlyphRun()
+  : text_(0), n_(0), font_(0), size_(0), count_(0),
+    offset_(0), x_(0), glyph_(0) {}
+
+/*! Same as GlyphRun() followed by set(). */
+GlyphRun::GlyphRun(const char* text, int n, Font* font, float size)
+  : text_(0), n_(0), font_(0), size_(0), count_(0),
+    offset_(0), x_(0), glyph_(0) {
+  set(text, n, font, size);
+}
+
+GlyphRun::~GlyphRun() {
+  delete[] text_;
+  delete[] offset_;
+  delete[] x_;
+  delete[] glyph_;
+}
+
+/*!
+  Lay out the first \a n bytes of \a text in \a font at \a size. The
+  text is copied. This calls setfont(), so the current font is
+  changed to this one.
+*/
+void GlyphRun::set(const char* text, int n, Font* font, float size) {
+  delete[] text_;
+  delete[] offset_;
+  delete[] x_;
+  delete[] glyph_;
+  glyph_ = 0;
+  font_ = font;
+  size_ = size;
+  n_ = n;
+  text_ = new char[n+1];
+  memcpy(text_, text, n);
+  text_[n] = 0;
+  // there are at most n characters:
+  offset_ = new int[n+1];
+  x_ = new float[n+1];
+  setfont(font, size);
+#if USE_X11 && USE_XFT
+  glyph_ = new unsigned[n ? n : 1];
+  XftFont* xf = xftfont();
+#endif
+  const char* p = text_;
+  const char* e = text_+n;
+  float x = 0;
+  int i = 0;
+  while (p < e) {
+    int len;
+#if USE_X11 && USE_XFT
+    unsigned ucs = utf8decode(p, e, &len);
+#else
+    utf8decode(p, e, &len);
+#endif
+    offset_[i] = p-text_;
+    x_[i] = x;
+#if USE_X11 && USE_XFT
+    FT_UInt glyph = XftCharIndex(xdisplay, xf, ucs);
+    XGlyphInfo info;
+    XftGlyphExtents(xdisplay, xf, &glyph, 1, &info);
+    glyph_[i] = glyph;
+    x += info.xOff;
+#else
+    x += getwidth(p, len);
+#endif
+    p += len;
+    i++;
+  }
+  offset_[i] = n;
+  x_[i] = x;
+  count_ = i;
+}
+
+/*!
+  Draw the text with the baseline at \a x,\a y, same as drawtext()
+  does, in the current color. This calls setfont() with the font and
+  size of the run.
+*/
+void GlyphRun::draw(float x, float y) const {
+  if (!count_) return;
+  setfont(font_, size_);
+#if USE_X11 && USE_XFT
+  if (glyph_ && xftc && !fl_display_list) {
+    transform(x, y);
+    int X = int(floorf(x+.5f));
+    int Y = int(floorf(y+.5f));
+    enum {SPECS = 256};
+    XftGlyphSpec localspecs[SPECS];
+    XftGlyphSpec* specs = count_ > SPECS ? new XftGlyphSpec[count_] : localspecs;
+    for (int i = 0; i < count_; i++) {
+      specs[i].glyph = glyph_[i];
+      specs[i].x = short(X + int(x_[i]));
+      specs[i].y = short(Y);
+    }
+    XftColor color;
+    fl_xft_color(color);
+    XftDrawGlyphSpec(xftc, &color, xftfont(), specs, count_);
+    frame_counts_.glyphs += count_;
+    if (specs != localspecs) delete[] specs;
+    return;
+  }
+#endif
+  drawtext(text_, n_, x, y);
+}
+
+/*!
+  Return the distance from the start of the run to the character
+  starting at or containing \a byte. Bytes past the end return width().
+*/
+float GlyphRun::position(int byte) const {
+  if (byte <= 0 || !count_) return 0;
+  if (byte >= n_) return width();
+  int a = 0, b = count_;
+  while (a < b) { // find the last character starting at or before byte
+    int c = (a+b+1)/2;
+    if (offset_[c] <= byte) a = c; else b = c-1;
+  }
+  return x_[a];
+}
+
+/*!
+  Return the byte offset of the boundary between characters nearest
+  to \a x, measured from the start of the run. This is where a text
+  cursor should go when the user clicks at \a x.
+*/
+int GlyphRun::offset(float x) const {
+  if (!count_ || x <= 0) return 0;
+  int a = 0, b = count_;
+  while (a < b) { // find the first boundary at or after x
+    int c = (a+b)/2;
+    if (x_[c] < x) a = c+1; else b = c;
+  }
+  if (a > 0 && x-x_[a-1] < x_[a]-x) a--;
+  return offset_[a];
+}
+
+//
+// End of "$Id$".
+//
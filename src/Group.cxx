@@ -63,8 +63,12 @@ and the items in them are widgets.
 #include <fltk/events.h>
 #include <fltk/layout.h>
 #include <fltk/damage.h>
+#include <fltk/trace.h>
+#include "DamageRects.h"
+#include "DisplayList.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 using namespace fltk;
 
@@ -82,15 +86,86 @@ extern NamedStyle* group_style;
 static NamedStyle the_style(0, revert, &group_style);
 NamedStyle* group_style = &the_style;
 
+// Hash table from children to their index, made by find() for groups
+// with many children. Appending or removing the last child updates it,
+// anything else that moves children throws it away. Entries for
+// removed children are left in it and ignored, because the index they
+// point at no longer has them.
+struct fltk::GroupIndex {
+  unsigned size;	// always a power of 2
+  unsigned count;	// entries used, including old ones
+  const Widget** keys;
+  int* values;
+};
+
+// Grid of cells covering the children, each with a list of the
+// children that overlap it, made by children_in() for groups with
+// spatial_index() on. Children that cover many cells, or that have a
+// label outside them (which may be anywhere nearby), are in a list
+// that is always returned instead.
+struct fltk::GroupGrid {
+  bool dirty;
+  int n;		// children() when it was made
+  int x, y, cellw, cellh, cols, rows;
+  int* start;		// cols*rows+1 offsets into cells
+  int* cells;		// indexes of children, increasing in each cell
+  int* big;		// indexes of children put in no cell
+  int nbig;
+  int* found;		// returned by children_in()
+  unsigned char* mark;
+};
+
+enum {INDEX_CHILDREN = 64}; // smaller groups are searched
+
+static inline unsigned hash_widget(const Widget* w) {
+  unsigned long v = (unsigned long)w;
+  return unsigned(v ^ (v >> 16)) * 2654435761U;
+}
+
+static void index_set(GroupIndex* x, const Widget* w, int i) {
+  unsigned h = hash_widget(w);
+  for (;; h++) {
+    const Widget*& key = x->keys[h&(x->size-1)];
+    if (!key) {key = w; x->count++;}
+    else if (key != w) continue;
+    x->values[h&(x->size-1)] = i;
+    return;
+  }
+}
+
+static GroupIndex* index_make(Widget*const* array, int n) {
+  GroupIndex* x = new GroupIndex;
+  x->size = 64;
+  while (x->size < unsigned(4*n)) x->size *= 2;
+  x->count = 0;
+  x->keys = new const Widget*[x->size];
+  memset(x->keys, 0, x->size*sizeof(Widget*));
+  x->values = new int[x->size];
+  for (int i = 0; i < n; i++) index_set(x, array[i], i);
+  return x;
+}
+
+static void index_free(GroupIndex*& x) {
+  if (!x) return;
+  delete[] x->keys;
+  delete[] x->values;
+  delete x;
+  x = 0;
+}
+
 /*! Creates a new fltk::Group widget using the given position, size,
   and label string. The default boxtype is fltk::NO_BOX. */
 Group::Group(int X,int Y,int W,int H,const char *l,bool begin)
 : Widget(X,Y,W,H,l),
   children_(0),
+  capacity_(0),
   focus_index_(-1),
   array_(0),
   resize_align_(ALIGN_TOPLEFT|ALIGN_BOTTOMRIGHT),
-  sizes_(0)
+  sizes_(0),
+  display_list_(0),
+  index_(0),
+  grid_(0)
 {
   resizable_ = this;
   type(GROUP_TYPE);
@@ -121,10 +196,18 @@ void Group::clear() {
   }
   delete[] const_cast<Widget**>( array_ );
   array_ = 0;
+  capacity_ = 0;
+  index_free(index_);
+  if (grid_) grid_->dirty = true;
 }
 
 /*! Calls clear(), and thus <i>deletes all child widgets</i> */
-Group::~Group() {current_ = 0; clear();}
+Group::~Group() {
+  current_ = 0;
+  clear();
+  delete display_list_;
+  spatial_index(false);
+}
 
 /*! \fn Widget * Group::child(int n) const
   Returns a child, n >= 0 && n < children(). <i>No range checking is done!</i>
@@ -145,21 +228,17 @@ void Group::insert(Widget &o, int index) {
     o.parent()->remove(n);
   }
   o.parent(this);
-  if (children_ == 0) {
-    // allocate for 1 child
-    if (!array_) array_ = new Widget*[1];
-    array_[0] = &o;
-  } else {
-    if (!(children_ & (children_-1))) {// double number of children
-      Widget** newarray = new Widget*[2*children_];
-      memcpy(newarray, array_, children_*sizeof(Widget*));
-      delete[] array_;
-      array_ = newarray;
-    }
-    for (int j = children_; j > index; --j) array_[j] = array_[j-1];
-    array_[index] = &o;
+  if (children_ >= capacity_) reserve(children_ ? 2*children_ : 1);
+  if (index < children_) {
+    memmove(array_+index+1, array_+index, (children_-index)*sizeof(Widget*));
+    index_free(index_);
+  } else if (index_) {
+    if (2*(index_->count+1) > index_->size) index_free(index_);
+    else index_set(index_, &o, index);
   }
+  array_[index] = &o;
   ++children_;
+  if (grid_) grid_->dirty = true;
   // fix the INACTIVE_R flag:
   if ( active_r() && o.active() ) {
     if ( o.flag(INACTIVE_R) ) {
@@ -198,6 +277,18 @@ void Group::insert(Widget &o, int index) {
   group.
 */
 
+/*! Make space for \a n children, so adding that many does not have
+  to copy the array of them again. This is useful before adding a
+  large number of items to a Browser. */
+void Group::reserve(int n) {
+  if (n <= capacity_) return;
+  Widget** newarray = new Widget*[n];
+  if (children_) memcpy(newarray, array_, children_*sizeof(Widget*));
+  delete[] array_;
+  array_ = newarray;
+  capacity_ = n;
+}
+
 /*! The widget is removed from it's current group (if any) and then
   added to the end of this group. */
 void Group::add(Widget &o) {
@@ -214,7 +305,11 @@ void Group::remove(int index) {
       if (p->box() != NO_BOX || !p->parent()) {p->redraw(); break;}
   o->parent(0);
   children_--;
-  for (int i=index; i < children_; ++i) array_[i] = array_[i+1];
+  if (index < children_) {
+    memmove(array_+index, array_+index+1, (children_-index)*sizeof(Widget*));
+    index_free(index_);
+  }
+  if (grid_) grid_->dirty = true;
   init_sizes();
   redraw();
 }
@@ -240,6 +335,12 @@ void Group::replace(int index, Widget& o) {
   o.parent(this);
   array_[index]->parent(0);
   array_[index] = &o;
+  if (index_) {
+    // the old child's entry stays, so the table fills up like appending:
+    if (2*(index_->count+1) > index_->size) index_free(index_);
+    else index_set(index_, &o, index);
+  }
+  if (grid_) grid_->dirty = true;
   init_sizes();
 }
 
@@ -253,18 +354,40 @@ void Group::swap(int indexA, int indexB) {
   Widget* o = array_[indexA];
   array_[indexA] = array_[indexB];
   array_[indexB] = o;
+  if (index_) {
+    index_set(index_, array_[indexA], indexA);
+    index_set(index_, o, indexB);
+  }
+  if (grid_) grid_->dirty = true;
   init_sizes();
 }
 
 /*! Searches the children for \a widget, returns the index of \a
   widget or of a parent of \a widget that is a child() of
-  this. Returns children() if the widget is NULL or not found. */
+  this. Returns children() if the widget is NULL or not found.
+
+  Groups with many children make a hash table the first time this
+  is called, so it takes constant time until children are inserted
+  or removed anywhere other than at the end. */
 int Group::find(const Widget* widget) const {
   for (;;) {
     if (!widget) return children_;
     if (widget->parent() == this) break;
     widget = widget->parent();
   }
+  if (children_ >= INDEX_CHILDREN) {
+    if (!index_) index_ = index_make(array_, children_);
+    for (unsigned h = hash_widget(widget);; h++) {
+      const Widget* key = index_->keys[h&(index_->size-1)];
+      if (!key) break;
+      if (key != widget) continue;
+      int index = index_->values[h&(index_->size-1)];
+      if (index < children_ && array_[index] == widget) return index;
+      break;
+    }
+    // widgets such as Browser headers have a parent but are not in it:
+    return children_;
+  }
   // Search backwards so if children are deleted in backwards order
   // they are found quickly:
   for (int index = children_; index--;)
@@ -272,6 +395,185 @@ int Group::find(const Widget* widget) const {
   return children_;
 }
 
+enum {GRID_MAX = 1024, GRID_BIG = 16};
+
+static void grid_clear(GroupGrid* g) {
+  delete[] g->start; g->start = 0;
+  delete[] g->cells; g->cells = 0;
+  delete[] g->big; g->big = 0;
+  delete[] g->found; g->found = 0;
+  delete[] g->mark; g->mark = 0;
+  g->cols = g->rows = g->nbig = 0;
+}
+
+static inline int grid_cell(int v, int o, int size, int count) {
+  v = (v-o)/size;
+  return v < 0 ? 0 : v >= count ? count-1 : v;
+}
+
+static bool grid_big(const GroupGrid* g, const Widget* w) {
+  Flags f = w->flags();
+  if ((f&15) && !(f&ALIGN_INSIDE)) return true;
+  int cx = (w->r()-1-g->x)/g->cellw - (w->x()-g->x)/g->cellw + 1;
+  int cy = (w->b()-1-g->y)/g->cellh - (w->y()-g->y)/g->cellh + 1;
+  return cx*cy > GRID_BIG;
+}
+
+static void grid_make(GroupGrid* g, Widget*const* array, int n) {
+  grid_clear(g);
+  g->dirty = false;
+  g->n = n;
+  if (!n) return;
+  int X = array[0]->x(), Y = array[0]->y();
+  int R = X+1, B = Y+1;
+  int i;
+  for (i = 0; i < n; i++) {
+    const Widget* w = array[i];
+    if (w->x() < X) X = w->x();
+    if (w->y() < Y) Y = w->y();
+    if (w->r() > R) R = w->r();
+    if (w->b() > B) B = w->b();
+  }
+  // about one cell per child, about as square as the area:
+  double a = double(R-X)/(B-Y);
+  int cols = int(sqrt(n*a)); if (cols < 1) cols = 1; if (cols > GRID_MAX) cols = GRID_MAX;
+  int rows = n/cols; if (rows < 1) rows = 1; if (rows > GRID_MAX) rows = GRID_MAX;
+  g->x = X; g->y = Y;
+  g->cellw = (R-X+cols-1)/cols;
+  g->cellh = (B-Y+rows-1)/rows;
+  g->cols = (R-X+g->cellw-1)/g->cellw;
+  g->rows = (B-Y+g->cellh-1)/g->cellh;
+  int ncells = g->cols*g->rows;
+  g->start = new int[ncells+1];
+  memset(g->start, 0, (ncells+1)*sizeof(int));
+  g->big = new int[n];
+  g->found = new int[n];
+  g->mark = new unsigned char[n];
+  memset(g->mark, 0, n);
+  // count the children in each cell, then fill them in:
+  for (int pass = 0; pass < 2; pass++) {
+    for (i = 0; i < n; i++) {
+      const Widget* w = array[i];
+      if (grid_big(g, w)) {
+	if (pass) g->big[g->nbig++] = i;
+	continue;
+      }
+      int c0 = grid_cell(w->x(), g->x, g->cellw, g->cols);
+      int c1 = grid_cell(w->r()-1, g->x, g->cellw, g->cols);
+      int r0 = grid_cell(w->y(), g->y, g->cellh, g->rows);
+      int r1 = grid_cell(w->b()-1, g->y, g->cellh, g->rows);
+      for (int r = r0; r <= r1; r++) for (int c = c0; c <= c1; c++) {
+	if (pass) g->cells[g->start[r*g->cols+c]++] = i;
+	else g->start[r*g->cols+c+1]++;
+      }
+    }
+    if (!pass) {
+      for (i = 0; i < ncells; i++) g->start[i+1] += g->start[i];
+      g->cells = new int[g->start[ncells]+1];
+    } else {
+      // filling moved each start to the next one, move them back:
+      for (i = ncells; i > 0; i--) g->start[i] = g->start[i-1];
+      g->start[0] = 0;
+    }
+  }
+}
+
+static int compare_ints(const void* a, const void* b) {
+  return *(const int*)a - *(const int*)b;
+}
+
+/*!
+  Turn on or off an index of where the children are. With it on, a
+  Group with many children only looks at the children under the mouse
+  for PUSH or MOVE events, and only draws the children inside the clip
+  region, instead of looking at all of them.
+
+  The index is made again after layout() or after children are added
+  or removed, so children must be moved with resize() or position()
+  (which cause a layout()), not by setting x() or y() directly.
+  Children with a label outside them are always drawn.
+*/
+void Group::spatial_index(bool v) {
+  if (v) {
+    if (grid_) return;
+    grid_ = new GroupGrid;
+    memset(grid_, 0, sizeof(GroupGrid));
+    grid_->dirty = true;
+  } else if (grid_) {
+    grid_clear(grid_);
+    delete grid_;
+    grid_ = 0;
+  }
+}
+
+/*!
+  Add \a dx,\a dy to the position of every child, as ScrollGroup does
+  when scrolling, without calling layout() on any of them. LAYOUT_XY
+  is turned on in their layout_damage() so the next layout_child()
+  will lay them out, but their parents are not told, so the caller
+  must do that for the children it cares about. The spatial_index() is
+  moved with the children rather than made again.
+*/
+void Group::scroll_children(int dx, int dy) {
+  if (!dx && !dy) return;
+  Widget*const* a = array_;
+  Widget*const* e = a+children_;
+  while (a < e) {
+    Widget* o = *a++;
+    o->x(o->x()+dx);
+    o->y(o->y()+dy);
+    o->layout_damage(o->layout_damage()|LAYOUT_XY);
+  }
+  if (grid_) {grid_->x += dx; grid_->y += dy;}
+}
+
+/*!
+  Return the indexes, in increasing order, of the children that may
+  overlap \a r (in the coordinates of this group), and put how many in
+  \a n. This returns null, meaning all the children, and sets \a n to
+  children(), if spatial_index() is off, if the children may have
+  moved since the last layout(), or if most of them would be returned
+  anyway. The array is only good until this is called again.
+*/
+const int* Group::children_in(const Rectangle& r, int& n) const {
+  n = children_;
+  GroupGrid* g = grid_;
+  if (!g || !children_ || layout_damage()) return 0;
+  if (g->dirty || g->n != children_) grid_make(g, array_, children_);
+  int m = 0;
+  if (r.x() < g->x+g->cols*g->cellw && r.r() > g->x &&
+      r.y() < g->y+g->rows*g->cellh && r.b() > g->y && !r.empty()) {
+    int c0 = grid_cell(r.x(), g->x, g->cellw, g->cols);
+    int c1 = grid_cell(r.r()-1, g->x, g->cellw, g->cols);
+    int r0 = grid_cell(r.y(), g->y, g->cellh, g->rows);
+    int r1 = grid_cell(r.b()-1, g->y, g->cellh, g->rows);
+    if (2*(c1-c0+1)*(r1-r0+1) > g->cols*g->rows && g->cols*g->rows > 1)
+      return 0;
+    for (int y = r0; y <= r1; y++) for (int x = c0; x <= c1; x++) {
+      int c = y*g->cols+x;
+      for (int k = g->start[c]; k < g->start[c+1]; k++) {
+	int i = g->cells[k];
+	if (g->mark[i]) continue;
+	g->mark[i] = 1;
+	g->found[m++] = i;
+      }
+    }
+    for (int k = 0; k < m; k++) g->mark[g->found[k]] = 0;
+    if (c0 != c1 || r0 != r1) qsort(g->found, m, sizeof(int), compare_ints);
+  }
+  // merge in the big ones:
+  if (g->nbig) {
+    int a = m, b = g->nbig, k = m+b;
+    while (b) {
+      if (a && g->found[a-1] > g->big[b-1]) g->found[--k] = g->found[--a];
+      else g->found[--k] = g->big[--b];
+    }
+    m += g->nbig;
+  }
+  n = m;
+  return g->found;
+}
+
 ////////////////////////////////////////////////////////////////
 // Handle
 
@@ -401,8 +703,11 @@ int Group::handle(int event) {
   case DND_ENTER:
   case DND_DRAG:
   case MOUSEWHEEL:
-    // search the children in backwards (top to bottom) order:
-    for (i = numchildren; i--;) {
+    {// search the children in backwards (top to bottom) order:
+    int n; const int* list = children_in(Rectangle(event_x(), event_y(), 1, 1), n);
+    for (int k = n; k--;) {
+      i = list ? list[k] : k;
+      if (i >= children()) continue;
       Widget* child = this->child(i);
       // ignore widgets we are not pointing at:
       if (event_x() < child->x()) continue;
@@ -411,7 +716,7 @@ int Group::handle(int event) {
       if (event_y() >= child->y()+child->h()) continue;
       // see if it wants the event:
       if (child->send(event)) return true;
-    }
+    }}
     break;
 
   default:
@@ -551,6 +856,10 @@ void Group::layout() {
 */
 void Group::layout(const Rectangle& r, int layout_damage) {
 
+  // children may move, so the spatial_index() must be made again:
+  if (grid_ && (this->layout_damage() & (LAYOUT_DAMAGE|LAYOUT_WH)))
+    grid_->dirty = true;
+
   // Clear the layout damage, so layout() of a child can turn it back
   // on and subclasses like PackedGroup can detect that:
   Widget::layout();
@@ -630,25 +939,60 @@ void Group::layout(const Rectangle& r, int layout_damage) {
     }
   }
 
-  Widget*const* a = array_;
-  Widget*const* e = a+children_;
-  int extradamage = layout_damage & LAYOUT_DAMAGE;
+  // LAYOUT_DAMAGE is passed to all the children, unless it is only on
+  // because some of them were resized:
+  int extradamage = 0;
+  if ((layout_damage & (LAYOUT_DAMAGE|LAYOUT_CHILD_RESIZE)) == LAYOUT_DAMAGE)
+    extradamage = LAYOUT_DAMAGE;
+  int xydamage = 0;
 #if USE_X11 || !defined(__APPLE__)
   // If this is not a Window and the xy position is changed, we must
-  // call layout() on every child. This is necessary so that child
+  // call layout() on every child group. This is necessary so that child
   // Windows will move to their new positions:
-  if ((layout_damage & LAYOUT_XY) && !is_window()) extradamage |= LAYOUT_XY;
+  if ((layout_damage & LAYOUT_XY) && !is_window()) xydamage = LAYOUT_XY;
 #endif
-  while (a < e) {
-    Widget* widget = *a++;
-    widget->layout_damage(widget->layout_damage()|extradamage);
-    if (widget->layout_damage()) {
-      widget->layout();
-      widget->layout_damage(0);
-    }
+  for (int i = 0; i < children_; i++) {
+    Widget* widget = array_[i];
+    layout_child(*widget, widget->is_group() ? extradamage|xydamage : extradamage);
   }
 }
 
+static unsigned long layouts_done_, layouts_skipped_;
+
+/*!
+  Call layout() on a child if it has any layout_damage() or
+  \a extradamage is not zero, then clear the child's layout_damage().
+  Children with no damage are skipped, so only the parts of the widget
+  tree that changed are laid out again. Returns true if the child
+  changed its own size in layout(), so subclasses such as
+  PackedGroup know they must arrange the children again.
+*/
+bool Group::layout_child(Widget& widget, int extradamage) {
+  int damage = widget.layout_damage() | extradamage;
+  if (!damage) {layouts_skipped_++; return false;}
+  if (extradamage & LAYOUT_DAMAGE) damage &= ~LAYOUT_CHILD_RESIZE;
+  int W = widget.w();
+  int H = widget.h();
+  widget.layout_damage(damage);
+  widget.layout();
+  widget.layout_damage(0);
+  layouts_done_++;
+  return widget.w() != W || widget.h() != H;
+}
+
+/*!
+  Return how many times Group::layout_child() called layout() on a
+  child. This and layouts_skipped() can be used to check how much of
+  the widget tree is laid out again by a change.
+*/
+unsigned long fltk::layouts_done() {return layouts_done_;}
+
+/*!
+  Return how many times Group::layout_child() skipped a child because
+  it had no layout_damage().
+*/
+unsigned long fltk::layouts_skipped() {return layouts_skipped_;}
+
 ////////////////////////////////////////////////////////////////
 // Draw
 
@@ -660,16 +1004,41 @@ void Group::layout(const Rectangle& r, int layout_damage) {
 // it does not fool this into thinking the clipping is done.
 Widget* fl_did_clipping;
 
+// Find the part of the clip region inside widget g, in the coordinates
+// of g. Returns false if the transformation is not a translation:
+static bool clip_box(const Widget* g, Rectangle& r) {
+  int x0 = 0, y0 = 0; transform(x0, y0);
+  int x1 = g->w(), y1 = g->h(); transform(x1, y1);
+  if (x1-x0 != g->w() || y1-y0 != g->h()) return false;
+  r.set(x0, y0, g->w(), g->h());
+  intersect_with_clip(r);
+  r.move(-x0, -y0);
+  return true;
+}
+
+// True if child w is entirely outside r:
+static inline bool outside(const Widget& w, const Rectangle& r) {
+  return w.x() >= r.r() || w.r() <= r.x() || w.y() >= r.b() || w.b() <= r.y();
+}
+
 void Group::draw() {
   clear_flag(HIGHLIGHT); // we never draw the box with highlight colors
   int numchildren = children();
   if (damage() & ~DAMAGE_CHILD) {
+    // Skip the children outside the clip before calling draw_child(),
+    // and if spatial_index() is on don't even look at most of them:
+    Rectangle clip;
+    bool cull = clip_box(this, clip);
+    const int* list = 0;
+    int n = numchildren;
+    if (cull) list = children_in(clip, n);
 #if USE_CLIPOUT
     // Non-blinky draw, draw the inside widgets first, clip their areas
     // out, and then draw the background:
     push_clip(0, 0, w(), h());
-    int n; for (n = numchildren; n--;) {
-      Widget& w = *child(n);
+    int k; for (k = n; k--;) {
+      Widget& w = *child(list ? list[k] : k);
+      if (cull && outside(w, clip)) continue;
       fl_did_clipping = 0;
       draw_child(w);
       if (fl_did_clipping != &w) clipout(w.x(), w.y(), w.w(), w.h());
@@ -679,14 +1048,14 @@ void Group::draw() {
     pop_clip();
     // labels are drawn without the clip for back compatability so they
     // can draw atop sibling widgets:
-    for (n = 0; n < numchildren; n++) draw_outside_label(*child(n));
+    for (k = 0; k < n; k++) draw_outside_label(*child(list ? list[k] : k));
 #else
     // blinky-draw:
     draw_box();
     draw_label();
-    for (int n = 0; n < numchildren; n++) {
-      Widget& w = *child(n);
-      draw_child(w);
+    for (int k = 0; k < n; k++) {
+      Widget& w = *child(list ? list[k] : k);
+      if (!cull || !outside(w, clip)) draw_child(w);
       draw_outside_label(w);
     }
 #endif
@@ -698,6 +1067,12 @@ void Group::draw() {
     for (int n = 0; n < numchildren; n++) {
       Widget& w = *child(n);
       if (w.damage() & DAMAGE_CHILD_LABEL) {
+	// the label is outside the child, so copy all of this group:
+	if (fl_damage_rects || fl_flash_rects) {
+	  Rectangle r; transform(Rectangle(this->w(), h()), r);
+	  if (fl_damage_rects) fl_damage_rects->add(r);
+	  if (fl_flash_rects) fl_flash_rects->add(r);
+	}
 	draw_outside_label(w);
 	w.set_damage(w.damage() & ~DAMAGE_CHILD_LABEL);
       }
@@ -739,25 +1114,98 @@ void Widget::draw_background() const {
   pop_clip();
 }
 
+/*! \fn bool Group::retained() const
+  Returns true if retained(true) was called.
+*/
+
+/*! If \a v is true the drawing done by draw() is recorded, and
+  replayed instead of calling draw() when the group must be drawn
+  again but nothing in it has changed. This happens when the window is
+  exposed or when a parent group is redrawn. This can save a lot of
+  time for a complex group that is redrawn because something
+  overlapping it changes.
+
+  The recording is thrown away as soon as the damage() or that of
+  any child is turned on, or fltk::redraw() is called. So widgets that
+  change their appearance without calling redraw() will not update.
+
+  A recording is only made when the entire group is being drawn and it
+  is not clipped. Drawing that can't be recorded (fltk::drawimage() of
+  a buffer, fltk::scrollrect(), child windows, or paths when Cairo or
+  Quartz are used) makes it draw normally. Images drawn with
+  Image::draw() are remembered by pointer and must not be destroyed
+  without calling redraw().
+
+  This does nothing for a Window.
+*/
+void Group::retained(bool v) {
+  if (!v) {delete display_list_; display_list_ = 0;}
+  else if (!display_list_ && !is_window()) display_list_ = new DisplayList;
+}
+
+extern bool fl_draw_cached(Widget&, uchar damage, bool background_changed);
+
+// Draw a widget (that is not a window) with 0,0 at the corner of it.
+// If it is cached() it is drawn with it's offscreen image. If it is a
+// retained() group the recording is played back if possible, otherwise
+// it is recorded if everything is being drawn:
+static void draw_widget(Widget& w, DisplayList* list, uchar damage,
+			bool background_changed) {
+  push_matrix();
+  translate(w.x(), w.y());
+  if (w.cached() && fl_draw_cached(w, damage, background_changed)) {
+    // done
+  } else if (!list) {
+    w.draw();
+  } else {
+    if (damage & ~DAMAGE_EXPOSE) list->valid = false;
+    if (list->current()) {
+      list->replay();
+    } else {
+      Rectangle r; transform(Rectangle(w.w(), w.h()), r);
+      if ((w.damage() & (DAMAGE_ALL|DAMAGE_EXPOSE)) && intersect_with_clip(r) == 1) {
+	list->begin();
+	w.draw();
+	list->end();
+      } else {
+	w.draw();
+      }
+    }
+  }
+  pop_matrix();
+}
+
 extern void fl_window_flush(Window* window);
 
+// Child windows draw somewhere else, so they can't be in a recording:
+static void flush_window(Window& w, bool all) {
+  DisplayList* list = fl_display_list;
+  if (list) {list->abort(); fl_display_list = 0;}
+  GSave gsave;
+  if (all) fl_window_flush(&w);
+  else w.flush();
+  fl_display_list = list;
+}
+
 /*! Force a child to draw, by turning on DAMAGE_ALL and DAMAGE_EXPOSE,
   and calling it's draw() after temporarily translating so 0,0 in
   drawing coordinates is the upper-left corner. It's damage is then set to 0.
 */
 void Group::draw_child(Widget& w) const {
   if (w.visible() && not_clipped(w)) {
+    double start = profiling_draws_ ? trace_time() : 0;
+    uchar damage = w.damage();
     w.set_damage(DAMAGE_ALL|DAMAGE_EXPOSE);
     if (w.is_window()) {
-      GSave gsave;
-      fl_window_flush((Window*)&w);
+      flush_window((Window&)w, true);
     } else {
-      push_matrix();
-      translate(w.x(), w.y());
-      w.draw();
-      pop_matrix();
+      // this group's box was redrawn unless it is just being exposed:
+      bool background_changed = !(this->damage() & DAMAGE_EXPOSE);
+      draw_widget(w, w.is_group() ? ((Group&)w).display_list_ : 0, damage,
+		  background_changed);
     }
     w.set_damage(0);
+    if (profiling_draws_) profile_draw(&w, start, false);
   }
 }
 
@@ -767,16 +1215,25 @@ void Group::draw_child(Widget& w) const {
 */
 void Group::update_child(Widget& w) const {
   if (w.damage() && w.visible() && not_clipped(w)) {
+    double start = profiling_draws_ ? trace_time() : 0;
     if (w.is_window()) {
-      GSave gsave;
-      ((Window*)&w)->flush();
+      flush_window((Window&)w, false);
     } else {
-      push_matrix();
-      translate(w.x(), w.y());
-      w.draw();
-      pop_matrix();
+      // tell Window::flush() this area must be copied to the screen:
+      if (fl_damage_rects) {
+	Rectangle r; transform(w, r);
+	fl_damage_rects->add(r);
+      }
+      // a group that only has damaged children adds them itself:
+      if (fl_flash_rects && (!w.is_group() || (w.damage() & ~DAMAGE_CHILD))) {
+	Rectangle r; transform(w, r);
+	fl_flash_rects->add(r);
+      }
+      draw_widget(w, w.is_group() ? ((Group&)w).display_list_ : 0, w.damage(),
+		  false);
     }
     w.set_damage(0);
+    if (profiling_draws_) profile_draw(&w, start, true);
   }
 }
 
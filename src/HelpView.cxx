@@ -36,6 +36,7 @@
 //   HelpView::draw()            - Draw the HelpView widget.
 //   HelpView::format()          - Format the help text.
 //   HelpView::format_table()    - Format a table...
+//   HelpView::measure_table()   - Measure the columns of a table...
 //   HelpView::get_align()       - Get an alignment attribute.
 //   HelpView::get_attr()        - Get an attribute value from the string.
 //   HelpView::get_color()       - Get an alignment attribute.
@@ -63,6 +64,7 @@
 #include <fltk/damage.h>
 #include <fltk/events.h>
 #include <fltk/Cursor.h>
+#include <fltk/run.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fltk/string.h>
@@ -81,6 +83,7 @@
 #endif // WIN32
 
 #define MAX_COLUMNS	200
+#define LOAD_CHUNK	16384	// Bytes a streaming load() formats at first
 
 #define FOREGROUND_COLOR (Color(0))
 #define BACKGROUND_COLOR (Color(49))
@@ -170,12 +173,15 @@ HelpBlock* HelpView::add_block(const char *s, int xx, int yy, int ww, int hh,uch
 
   if (nblocks_ >= ablocks_)
   {
-    ablocks_ += 16;
-
-    if (ablocks_ == 16)
+    // Double the size, so a page with many blocks is not copied
+    // over and over...
+    if (ablocks_ == 0) {
+      ablocks_ = 16;
       blocks_ = (HelpBlock *)malloc(sizeof(HelpBlock) * ablocks_);
-    else
+    } else {
+      ablocks_ *= 2;
       blocks_ = (HelpBlock *)realloc(blocks_, sizeof(HelpBlock) * ablocks_);
+    }
   }
 
   temp = blocks_ + nblocks_;
@@ -208,12 +214,13 @@ void HelpView::add_link(const char *n, int xx, int yy, int ww, int hh) {
 
   if (nlinks_ >= alinks_)
   {
-    alinks_ += 16;
-
-    if (alinks_ == 16)
+    if (alinks_ == 0) {
+      alinks_ = 16;
       links_ = (HelpLink *)malloc(sizeof(HelpLink) * alinks_);
-    else
+    } else {
+      alinks_ *= 2;
       links_ = (HelpLink *)realloc(links_, sizeof(HelpLink) * alinks_);
+    }
   }
 
   temp = links_ + nlinks_;
@@ -247,12 +254,13 @@ void HelpView::add_target(const char *n, int yy) {
 
   if (ntargets_ >= atargets_)
   {
-    atargets_ += 16;
-
-    if (atargets_ == 16)
+    if (atargets_ == 0) {
+      atargets_ = 16;
       targets_ = (HelpTarget *)malloc(sizeof(HelpTarget) * atargets_);
-    else
+    } else {
+      atargets_ *= 2;
       targets_ = (HelpTarget *)realloc(targets_, sizeof(HelpTarget) * atargets_);
+    }
   }
 
   temp = targets_ + ntargets_;
@@ -341,22 +349,34 @@ void HelpView::write_text (const char * buf, const char * ptr, int X, int Y, int
 */
 void HelpView::draw() {
   int			i;		// Looping var
-  const HelpBlock	*block;		// Pointer to current block
-  const char		*ptr,		// Pointer to text in block
-			*attrs;		// Pointer to start of element attributes
-  char			*s,		// Pointer into buffer
-			buf[1024],	// Text buffer
-			attr[1024];	// Attribute buffer
-  int			xx, yy, ww, hh;	// Current positions and sizes
-  int			line;		// Current line
-  Font*			font; int  fsize;	// Current font and size
-  int			head, pre,	// Flags for text
-			needspace;	// Do we need whitespace?
+  int			ww, hh;		// Current sizes
   Box *b = box ()? box () : DOWN_BOX;
 					// Box to draw...
-  int			underline;	// Underline text?
-  int                   xtra_ww;        // Extra width for underlined space between words
+  uchar			d = damage();
+
+  // The inside of the box, less the scrollbars, is where the text goes...
+  Rectangle tmp(0, 0, w(), h());
 
+  if(scrollbar_->visible())
+    tmp.w(tmp.w() - scrollbar_->w());
+
+  if(hscrollbar_->visible())
+    tmp.h(tmp.h() - hscrollbar_->h());
+
+  b->inset(tmp);
+
+  // If it only scrolled, move what is already drawn and just draw
+  // what scrolled into view...
+  if (!(d & ~(DAMAGE_SCROLL | DAMAGE_CHILD))) {
+    if (value_)
+      scrollrect(tmp, scrolldx_, scrolldy_, draw_clip_cb, this);
+    scrolldx_ = scrolldy_ = 0;
+
+    if (hscrollbar_->visible()) update_child(*hscrollbar_);
+    if (scrollbar_->visible()) update_child(*scrollbar_);
+    return;
+  }
+  scrolldx_ = scrolldy_ = 0;
 
   // Draw the scrollbar(s) and box first...
   ww = w() ;
@@ -367,7 +387,7 @@ void HelpView::draw() {
   box(b);
   draw_box(Rectangle(0, 0, ww, hh));
 
-  if (damage() & (DAMAGE_ALL | DAMAGE_CHILD)) {
+  if (d & (DAMAGE_ALL | DAMAGE_CHILD)) {
     hscrollbar_->set_damage(DAMAGE_ALL);
 	scrollbar_->set_damage(DAMAGE_ALL);
   }
@@ -391,22 +411,65 @@ void HelpView::draw() {
     return;
 
   // Clip the drawing to the inside of the box...
-  Rectangle tmp(0, 0, w(), h());
-
-  if(scrollbar_->visible())
-    tmp.w(tmp.w() - scrollbar_->w());
+  fltk::push_clip(tmp);
+  draw_blocks(tmp);
+  fltk::pop_clip();
+}
 
-  if(hscrollbar_->visible())
-    tmp.h(tmp.h() - hscrollbar_->h());
+// Called by scrollrect() to draw the area scrolled into view
+void HelpView::draw_clip_cb(void *v, const Rectangle &r) {
+  HelpView *view = (HelpView *)v;
+  fltk::push_clip(r);
+  setcolor(view->bgcolor_);
+  fillrect(r);
+  view->draw_blocks(r);
+  fltk::pop_clip();
+}
 
-  b->inset(tmp);
-  fltk::push_clip(tmp);
+/** Draw the blocks that are in \a r, which must already be clipped to.
+    blockbottom_ and blocktop_ (made by index_blocks()) are searched
+    so only the blocks near \a r are looked at.
+*/
+void HelpView::draw_blocks(const Rectangle &r) {
+  int			i;		// Looping var
+  const HelpBlock	*block;		// Pointer to current block
+  const char		*ptr,		// Pointer to text in block
+			*attrs;		// Pointer to start of element attributes
+  char			*s,		// Pointer into buffer
+			buf[1024],	// Text buffer
+			attr[1024];	// Attribute buffer
+  int			xx, yy, ww, hh;	// Current positions and sizes
+  int			line;		// Current line
+  Font*			font; int  fsize;	// Current font and size
+  int			head, pre,	// Flags for text
+			needspace;	// Do we need whitespace?
+  int			underline;	// Underline text?
+  int                   xtra_ww;        // Extra width for underlined space between words
+  int			top, bottom;	// Part of the document in r
+  int			margin;		// How far text goes past a block
+  int			lo, hi;		// Binary search range
+  Rectangle		tmp;
+
+
+  // Text and cell backgrounds go above the block's y, and descenders
+  // below the block, by up to the biggest font...
+  margin = maxfsize_ + int(textsize() + leading()) + 4;
+  top    = topline_ + r.y() - margin;
+  bottom = topline_ + r.b() + margin;
+
+  // Find the first block that ends below the top...
+  for (lo = 0, hi = nblocks_; lo < hi;) {
+    i = (lo + hi) / 2;
+    if (blockbottom_[i] < top) lo = i + 1;
+    else hi = i;
+  }
 
   setcolor(textcolor_);
 
   // Draw all visible blocks...
-  for (i = 0, block = blocks_; i < nblocks_; i ++, block ++)
-    if ((block->y + block->h) >= topline_ && block->y < (topline_ + h()))
+  for (i = lo, block = blocks_ + lo; i < nblocks_ && blocktop_[i] < bottom;
+       i ++, block ++)
+    if ((block->y + block->h) >= top && block->y < bottom)
     {
       line      = 0;
       xx        = block->line[line];
@@ -871,60 +934,105 @@ void HelpView::draw() {
 	                         xx - leftline_ + ww);
       }
     }
+}
+
+
+// Return the next character of text at p, skipping elements and
+// decoding entities, or 0 at the end of the block...
+static int text_char(const char *&p, const char *end) {
+  int	c;				// Current character
+  const char *semi;			// End of entity
 
-  pop_clip();
+
+  while (p < end && *p == '<') {
+    while (p < end && *p != '>') p ++;
+    if (p < end) p ++;
+  }
+
+  if (p >= end || !*p)
+    return 0;
+
+  if (*p == '&' && (c = quote_char(p + 1)) >= 0) {
+    semi = strchr(p + 1, ';');
+    p    = semi ? semi + 1 : p + 1;
+  } else
+    c = *p++ & 255;
+
+  return c;
+}
+
+// Return the start of the first case-insensitive match of s in the
+// text from p to end, or NULL if there is none...
+static const char *text_find(const char *s, const char *p, const char *end) {
+  const char	*bp,			// Block matching pointer
+		*sp;			// Search string pointer
+  int		c;			// Current character
+
+
+  for (;;) {
+    // Skip elements, so a match starts on text...
+    while (p < end && *p == '<') {
+      while (p < end && *p != '>') p ++;
+      if (p < end) p ++;
+    }
+
+    if (p >= end || !*p)
+      return NULL;
+
+    for (bp = p, sp = s; *sp; sp ++) {
+      c = text_char(bp, end);
+      if (!c || tolower(c) != tolower(*sp & 255)) break;
+    }
+
+    if (!*sp)
+      return p;
+
+    text_char(p, end);
+  }
 }
 
 
 /** Find the specified string.
+  The blocks before \a p are skipped with a binary search, so each
+  "find next" only looks at the text up to the next match.
   \param s The string to find
   \param p The starting position to search from
   \return Returns the position the match begins, or -1 if no match is found
 */
 int HelpView::find(const char *s, int p) {
-  int		i,				// Looping var
-		c;				// Current character
+  int		lo, hi, i;			// Looping vars
   HelpBlock	*b;				// Current block
-  const char	*bp,				// Block matching pointer
-		*bs,				// Start of current comparison
-		*sp;				// Search string pointer
+  const char	*bp;				// Block matching pointer
 
 
   // Range check input and value...
   if (!s || !value_) return -1;
 
-  if (p < 0 || p >= (int)strlen(value_)) p = 0;
+  while (loading())
+    load_more();
+
+  if (!nblocks_) return -1;
+
+  if (p < 0 || value_ + p >= blocks_[nblocks_ - 1].end) p = 0;
   else if (p > 0) p ++;
 
+  // Find the last block that starts at or before p...
+  for (lo = 0, hi = nblocks_; lo < hi;) {
+    i = (lo + hi) / 2;
+    if (blocks_[i].start <= value_ + p) lo = i + 1;
+    else hi = i;
+  }
+  if (lo > 0) lo --;
+
   // Look for the string...
-  for (i = nblocks_, b = blocks_; i > 0; i --, b ++) {
+  for (i = lo, b = blocks_ + lo; i < nblocks_; i ++, b ++) {
     if (b->end < (value_ + p))
       continue;
 
     if (b->start < (value_ + p)) bp = value_ + p;
     else bp = b->start;
 
-    for (sp = s, bs = bp; *sp && *bp && bp < b->end; bp ++) {
-      if (*bp == '<') {
-        // skip to end of element...
-	while (*bp && bp < b->end && *bp != '>') bp ++;
-	continue;
-      } else if (*bp == '&') {
-        // decode HTML entity...
-	if ((c = quote_char(bp + 1)) < 0) c = '&';
-	else bp = strchr(bp + 1, ';') + 1;
-      } else c = *bp;
-
-      if (tolower(*sp) == tolower(c)) sp ++;
-      else {
-        // No match, so reset to start of search...
-	sp = s;
-	bs ++;
-	bp = bs;
-      }
-    }
-
-    if (!*sp) {
+    if (text_find(s, bp, b->end)) {
       // Found a match!
       topline(b->y - b->h);
       return (b->end - value_);
@@ -936,6 +1044,35 @@ int HelpView::find(const char *s, int p) {
 }
 
 
+/** Find every match of a string in one pass.
+  \param s The string to find
+  \param positions Where to put the offsets into value() of the matches
+  \param n How many offsets fit in \a positions
+  \return The number of matches, which may be more than \a n
+*/
+int HelpView::find_all(const char *s, int *positions, int n) {
+  int		i;				// Looping var
+  int		count;				// Number of matches
+  const HelpBlock *b;				// Current block
+  const char	*bp;				// Block matching pointer
+
+
+  if (!s || !*s || !value_) return 0;
+
+  while (loading())
+    load_more();
+
+  for (i = 0, b = blocks_, count = 0; i < nblocks_; i ++, b ++)
+    for (bp = b->start; (bp = text_find(s, bp, b->end)) != NULL;) {
+      if (count < n) positions[count] = bp - value_;
+      count ++;
+      text_char(bp, b->end);
+    }
+
+  return (count);
+}
+
+
 /** Format the help text.
 
   This looks like it converts everything into HTML from standard text and draws it properly
@@ -978,8 +1115,12 @@ void HelpView::format() {
 
 
   // Reset document width...
-  hsize_ = w() - 24;
+  hsize_    = w() - 24;
+  format_w_ = w();
 
+  // Anything wider than hsize_ makes it go around again. It does not
+  // stop at the first one, but keeps going to find the widest, so a
+  // page with many long <PRE> lines is not redone once for each.
   done = 0;
   while (!done)
   {
@@ -989,6 +1130,7 @@ void HelpView::format() {
     nlinks_    = 0;
     ntargets_  = 0;
     size_      = 0;
+    maxfsize_  = textsize_;
     bgcolor_   = color();
     textcolor_ = textcolor();
     linkcolor_ = selection_color();
@@ -1035,7 +1177,6 @@ void HelpView::format() {
           if (ww > hsize_) {
 	    hsize_ = ww;
 	    done   = 0;
-	    break;
 	  }
 
           if (needspace && xx > block->x)
@@ -1077,7 +1218,10 @@ void HelpView::format() {
 	  {
 	    if (*ptr == '\n')
 	    {
-              if (xx > hsize_) break;
+              if (xx > hsize_) {
+	        hsize_ = xx;
+	        done   = 0;
+	      }
 
               line     = do_align(block, line, xx, newalign, links);
               xx       = block->x;
@@ -1097,7 +1241,6 @@ void HelpView::format() {
           if (xx > hsize_) {
 	    hsize_ = xx;
 	    done   = 0;
-	    break;
 	  }
 
 	  needspace = 0;
@@ -1239,7 +1382,6 @@ void HelpView::format() {
 #endif // DEBUG
 	      hsize_ = xx + table_width;
 	      done   = 0;
-	      break;
 	    }
 
             switch (get_align(attrs, talign))
@@ -1571,7 +1713,6 @@ void HelpView::format() {
           if (ww > hsize_) {
 	    hsize_ = ww;
 	    done   = 0;
-	    break;
 	  }
 
 	  if (needspace && xx > block->x)
@@ -1604,7 +1745,6 @@ void HelpView::format() {
         if (xx > hsize_) {
 	  hsize_ = xx;
           done   = 0;
-	  break;
 	}
 
 	line      = do_align(block, line, xx, newalign, links);
@@ -1659,7 +1799,6 @@ void HelpView::format() {
       if (ww > hsize_) {
 	hsize_ = ww;
 	done   = 0;
-	break;
       }
 
       if (needspace && xx > block->x)
@@ -1691,6 +1830,8 @@ void HelpView::format() {
     qsort(targets_, ntargets_, sizeof(HelpTarget),
           (compare_func_t)compare_targets);
 
+  index_blocks();
+
   // Reset scrolling if it needs to be...
   if (scrollbar_->visible()) {
     int temph = h() - 8;
@@ -1707,12 +1848,45 @@ void HelpView::format() {
 }
 
 
-/** Format a table in the HelpView
-  \param[out] table_width The total table width, returned
-  \param[out] columns The column widths, returned
-  \param table Pointer to the start of the HTML table to format
+/** Make blockbottom_ and blocktop_ for the blocks from format().
+    The blocks are mostly in y order but table cells are not, so
+    blockbottom_[i] is the lowest bottom of any block up to \a i and
+    blocktop_[i] the highest top of any block from \a i on. Both go
+    up with \a i, so draw_blocks() can binary search them.
 */
-void HelpView::format_table(int *table_width, int *columns, const char *table) {
+void HelpView::index_blocks() {
+  int	i;				// Looping var
+  int	y;				// Running top or bottom
+
+
+  if (nblocks_ == 0)
+    return;
+
+  blockbottom_ = (int *)realloc(blockbottom_, 2 * nblocks_ * sizeof(int));
+  blocktop_    = blockbottom_ + nblocks_;
+
+  for (i = 0, y = blocks_[0].y + blocks_[0].h; i < nblocks_; i ++) {
+    if (blocks_[i].y + blocks_[i].h > y) y = blocks_[i].y + blocks_[i].h;
+    blockbottom_[i] = y;
+  }
+
+  for (i = nblocks_ - 1, y = blocks_[i].y; i >= 0; i --) {
+    if (blocks_[i].y < y) y = blocks_[i].y;
+    blocktop_[i] = y;
+  }
+}
+
+
+/** Measure the columns of a table, or return the measurements made
+  by an earlier format(). The text of each cell is scanned only once
+  and the results are kept until the text, font, or size changes, so
+  format() going around again, or the view being resized, only has to
+  fit the columns to the width. A table that runs past the end of the
+  text loaded so far is measured again next time.
+  \param table Pointer to the start of the HTML table
+  \returns The widths of the columns
+*/
+const HelpTable *HelpView::measure_table(const char *table) {
   int		column,					// Current column
 		num_columns,				// Number of columns
 		colspan,				// COLSPAN attribute
@@ -1721,7 +1895,8 @@ void HelpView::format_table(int *table_width, int *columns, const char *table) {
 		max_width,				// Maximum width
 		incell,					// In a table cell?
 		pre,					// <PRE> text?
-		needspace;				// Need whitespace?
+		needspace,				// Need whitespace?
+		ended;					// Found the end of the table?
   char		*s,					// Pointer into buffer
 		buf[1024],				// Text buffer
 		attr[1024],				// Other attribute
@@ -1730,12 +1905,35 @@ void HelpView::format_table(int *table_width, int *columns, const char *table) {
   const char	*ptr,					// Pointer into table
 		*attrs,					// Pointer to attributes
 		*start;					// Start of element
-  int		minwidths[MAX_COLUMNS];			// Minimum widths for each column
+  int		columns[MAX_COLUMNS],			// Maximum widths for each column
+		minwidths[MAX_COLUMNS];			// Minimum widths for each column
   Font* font; int fsize;				// Current font and size
+  Font*		saved_fonts[100];			// Font stack to put back
+  int		saved_sizes[100],
+		saved_nfonts;
+  int		lo, hi;					// Binary search of tables_
+
+
+  font        = fonts_[nfonts_];
+  fsize       = fontsizes_[nfonts_];
 
+  // Find it in the tables measured before...
+  for (lo = 0, hi = ntables_; lo < hi;) {
+    int mid = (lo + hi) / 2;
+    if (tables_[mid].start < table) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo < ntables_ && tables_[lo].start == table &&
+      tables_[lo].font == font && tables_[lo].fsize == fsize)
+    return tables_ + lo;
+
+  // The scan pushes and pops fonts, which must not change what
+  // format() does next depending on whether it was remembered:
+  saved_nfonts = nfonts_;
+  memcpy(saved_fonts, fonts_, (nfonts_ + 1) * sizeof(Font*));
+  memcpy(saved_sizes, fontsizes_, (nfonts_ + 1) * sizeof(int));
 
   // Clear widths...
-  *table_width = 0;
   for (column = 0; column < MAX_COLUMNS; column ++)
   {
     columns[column]   = 0;
@@ -1747,8 +1945,7 @@ void HelpView::format_table(int *table_width, int *columns, const char *table) {
   max_width   = 0;
   pre         = 0;
   needspace   = 0;
-  font        = fonts_[nfonts_];
-  fsize       = fontsizes_[nfonts_];
+  ended       = 0;
 
   // Scan the table...
   for (ptr = table, column = -1, width = 0, s = buf, incell = 0; *ptr;)
@@ -1802,7 +1999,10 @@ void HelpView::format_table(int *table_width, int *columns, const char *table) {
 	needspace = 0;
       }
       else if (strcasecmp(buf, "TABLE") == 0 && start > table)
+      {
+        ended = 1;
         break;
+      }
       else if (strcasecmp(buf, "CENTER") == 0 ||
                strcasecmp(buf, "P") == 0 ||
                strcasecmp(buf, "H1") == 0 ||
@@ -1892,7 +2092,10 @@ void HelpView::format_table(int *table_width, int *columns, const char *table) {
 	}
 
 	if (strcasecmp(buf, "/TABLE") == 0)
+	{
+	  ended = 1;
 	  break;
+	}
 
 	needspace = 0;
 	column    = -1;
@@ -2045,12 +2248,85 @@ void HelpView::format_table(int *table_width, int *columns, const char *table) {
     }
   }
 
-  // Now that we have scanned the entire table, adjust the table and
-  // cell widths to fit on the screen...
+  nfonts_ = saved_nfonts;
+  memcpy(fonts_, saved_fonts, (nfonts_ + 1) * sizeof(Font*));
+  memcpy(fontsizes_, saved_sizes, (nfonts_ + 1) * sizeof(int));
+  setfont(fonts_[nfonts_], (float)fontsizes_[nfonts_] - 1);
+
+  if (num_columns > MAX_COLUMNS)
+    num_columns = MAX_COLUMNS;
+
+  HelpTable *t;
+  if (!ended) {
+    // Not all loaded yet, don't remember it:
+    static HelpTable temp;
+    static int temp_columns[MAX_COLUMNS], temp_minwidths[MAX_COLUMNS];
+    t = &temp;
+    t->columns   = temp_columns;
+    t->minwidths = temp_minwidths;
+  } else {
+    if (lo < ntables_ && tables_[lo].start == table) {
+      // measured in a different font:
+      t = tables_ + lo;
+      free(t->columns);
+    } else {
+      if (ntables_ >= atables_) {
+        atables_ = atables_ ? atables_ * 2 : 16;
+        tables_ = (HelpTable *)realloc(tables_, sizeof(HelpTable) * atables_);
+      }
+      t = tables_ + lo;
+      memmove(t + 1, t, (ntables_ - lo) * sizeof(HelpTable));
+      ntables_ ++;
+    }
+    t->columns   = (int *)malloc(sizeof(int) * 2 * (num_columns ? num_columns : 1));
+    t->minwidths = t->columns + num_columns;
+  }
+
+  t->start       = table;
+  t->font        = font;
+  t->fsize       = fsize;
+  t->num_columns = num_columns;
+  memcpy(t->columns, columns, num_columns * sizeof(int));
+  memcpy(t->minwidths, minwidths, num_columns * sizeof(int));
   if (get_attr(table + 6, "WIDTH", attr, sizeof(attr)))
-    *table_width = get_length(attr);
+    t->width = get_length(attr);
   else
-    *table_width = 0;
+    t->width = 0;
+
+  return t;
+}
+
+
+/** Forget the tables measured by measure_table(). */
+void HelpView::clear_tables() {
+  for (int i = 0; i < ntables_; i ++)
+    free(tables_[i].columns);
+  ntables_ = 0;
+}
+
+
+/** Format a table in the HelpView
+  \param[out] table_width The total table width, returned
+  \param[out] columns The column widths, returned
+  \param table Pointer to the start of the HTML table to format
+*/
+void HelpView::format_table(int *table_width, int *columns, const char *table) {
+  int		column,					// Current column
+		num_columns,				// Number of columns
+		width;					// Current width
+  int		minwidths[MAX_COLUMNS];			// Minimum widths for each column
+  const HelpTable *t = measure_table(table);
+
+
+  num_columns = t->num_columns;
+  for (column = 0; column < MAX_COLUMNS; column ++)
+  {
+    columns[column]   = column < num_columns ? t->columns[column] : 0;
+    minwidths[column] = column < num_columns ? t->minwidths[column] : 0;
+  }
+
+  // Adjust the table and cell widths to fit on the screen...
+  *table_width = t->width;
 
 #ifdef DEBUG
   printf("num_columns = %d, table_width = %d\n", num_columns, *table_width);
@@ -2333,7 +2609,9 @@ SharedImage* HelpView::get_image(const char *name, int W, int H) {
 
   if (strncmp(localname, "file:", 5) == 0) localname += 5;
 
-  if ((ip = SharedImage::get(localname /*, W, H*/)) == NULL)
+  // Only if both are given, otherwise the layout uses the image size:
+  if (W <= 0 || H <= 0) W = H = 0;
+  if ((ip = SharedImage::get(localname, W, H)) == NULL)
     ip = (SharedImage *) & broken_image;
 
   return ip;
@@ -2478,6 +2756,7 @@ void HelpView::pushfont (Font *f, int s) {
     if (nfonts_ < 99) nfonts_++;
 	fonts_[nfonts_] = f;
 	fontsizes_[nfonts_] = s;
+    if (s > maxfsize_) maxfsize_ = s;
     setfont (f, (float)s-1);
 }
 
@@ -2501,16 +2780,22 @@ defcolor_ = c;
   \param f A pointer to a fltk::Font structure
 */
 void HelpView::textfont (Font *f) {
+if (textfont_ == f) return;
 textfont_ = f;
+clear_tables();
 format();
+relayout();
 }
 
 /** Changes the text size within the HelpView, then reformats
   \param s Integer height of the text
 */
 void HelpView::textsize (int s) {
+if (textsize_ == s) return;
 textsize_ = s;
+clear_tables();
 format ();
+relayout();
 }
 
 /** Build a HelpView widget.
@@ -2538,6 +2823,8 @@ HelpView::HelpView(int xx, int yy, int ww, int hh, const char *l)
   value_        = NULL;
 
   ablocks_      = 0;
+  blockbottom_  = 0;
+  blocktop_     = 0;
   nblocks_      = 0;
   blocks_       = (HelpBlock *)0;
 
@@ -2553,6 +2840,10 @@ HelpView::HelpView(int xx, int yy, int ww, int hh, const char *l)
   ntargets_     = 0;
   targets_      = (HelpTarget *)0;
 
+  atables_      = 0;
+  ntables_      = 0;
+  tables_       = (HelpTable *)0;
+
   directory_[0] = '\0';
   filename_[0]  = '\0';
 
@@ -2560,6 +2851,14 @@ HelpView::HelpView(int xx, int yy, int ww, int hh, const char *l)
   leftline_     = 0;
   size_         = 0;
   hsize_        = 0;
+  format_w_     = -1;
+  scrolldx_     = 0;
+  scrolldy_     = 0;
+  maxfsize_     = 12;
+  loaded_       = 0;
+  loadlen_      = 0;
+  loadchar_     = 0;
+  streaming_    = false;
 
   scrollbar_ = new Scrollbar(ww - 17, yy, 17, hh - 17);
   scrollbar_->value(0, hh, 0, 1);
@@ -2586,10 +2885,14 @@ HelpView::~HelpView()
 {
   if (nblocks_)
     free(blocks_);
+  free(blockbottom_);
   if (nlinks_)
     free(links_);
   if (ntargets_)
     free(targets_);
+  clear_tables();
+  free(tables_);
+  stop_loading();
   if (value_)
     free((void *)value_);
 }
@@ -2631,11 +2934,14 @@ int HelpView::load(const char *f) {
   else if (slash > directory_ && slash[-1] != '/')
     *slash = '\0';
 
+  stop_loading();
+
   if (value_ != NULL)
   {
     free((void *)value_);
     value_ = NULL;
   }
+  clear_tables();
 
   if (strncmp(localname, "ftp:", 4) == 0 ||
       strncmp(localname, "http:", 5) == 0 ||
@@ -2665,8 +2971,24 @@ int HelpView::load(const char *f) {
       rewind(fp);
 
       value_ = (const char *)calloc(len + 1, 1);
-      if(fread((void *)value_, 1, len, fp)); //ignore the return value
+      len = (long)fread((void *)value_, 1, len, fp);
       fclose(fp);
+
+      // Only format the start of a large file now, and the rest in
+      // idle time. The text is cut off with a nul before an element...
+      if (streaming_ && len > LOAD_CHUNK) {
+        char *text = (char *)value_;
+
+        for (loaded_ = LOAD_CHUNK; loaded_ < len && text[loaded_] != '<';
+             loaded_ ++);
+
+        if (loaded_ < len) {
+          loadlen_       = (int)len;
+          loadchar_      = text[loaded_];
+          text[loaded_]  = '\0';
+          add_idle_job(load_job, this);
+	}
+      }
     }
     else
     {
@@ -2680,6 +3002,8 @@ int HelpView::load(const char *f) {
     }
   }
 
+  topline_  = 0;
+  leftline_ = 0;
   format();
 
   if (target)
@@ -2690,10 +3014,61 @@ int HelpView::load(const char *f) {
   return (0);
 }
 
+
+/** Format the next piece of a streaming load().
+  Each piece is twice as big as the last, so the whole file is not
+  formatted more than about twice.
+*/
+void HelpView::load_more() {
+  char	*text = (char *)value_;		// Text being loaded
+  int	n;				// End of the next piece
+
+
+  text[loaded_] = loadchar_;
+
+  for (n = 2 * loaded_; n < loadlen_ && text[n] != '<'; n ++);
+
+  if (n < loadlen_) {
+    loaded_   = n;
+    loadchar_ = text[n];
+    text[n]   = '\0';
+  } else {
+    loadlen_ = 0;
+    remove_idle_job(load_job, this);
+  }
+
+  format();
+  relayout();
+}
+
+
+// Called in idle time while loading, one piece each time...
+bool HelpView::load_job(void *v) {
+  ((HelpView *)v)->load_more();
+  return ((HelpView *)v)->loadlen_ != 0;
+}
+
+
+/** Forget the rest of a streaming load() */
+void HelpView::stop_loading() {
+  if (!loadlen_)
+    return;
+
+  ((char *)value_)[loaded_] = loadchar_;
+  loadlen_ = 0;
+  remove_idle_job(load_job, this);
+}
+
 /** HelpView's layout method.
   Similar to Widget::layout() in use.
 */
 void HelpView::layout() {
+  // The text depends only on the width, and value(), textfont() and
+  // textsize() format it themselves, so only a new width needs it
+  // done again. Do it first so the scrollbars are put where the new
+  // size needs them.
+  if (format_w_ != w()) format();
+
   Rectangle inside(0, 0, w(), h());
   Box *b = box() ? box () : DOWN_BOX;
   b->inset(inside);
@@ -2721,8 +3096,6 @@ void HelpView::layout() {
     }
   }
 
-  // scrollbars will format() update additionaly
-  format();
   Widget::layout();
 }
 
@@ -2735,13 +3108,22 @@ void HelpView::topline(const char *n) {
 		*target;		// Pointer to matching target
 
 
-  if (ntargets_ == 0)
-    return;
-
   strlcpy(key.name, n, sizeof(key.name));
 
-  target = (HelpTarget *)bsearch(&key, targets_, ntargets_, sizeof(HelpTarget),
-                                 (compare_func_t)compare_targets);
+  // Format more of a streaming load() until the target is found...
+  for (;;) {
+    if (ntargets_)
+      target = (HelpTarget *)bsearch(&key, targets_, ntargets_,
+                                     sizeof(HelpTarget),
+                                     (compare_func_t)compare_targets);
+    else
+      target = NULL;
+
+    if (target != NULL || !loading())
+      break;
+
+    load_more();
+  }
 
   if (target != NULL)
     topline(target->y);
@@ -2755,18 +3137,27 @@ void HelpView::topline(int t) {
   if (!value_)
     return;
 
+  // Format more of a streaming load() if asked to go past the end...
+  while (loading() && t > size_)
+    load_more();
+
   if (size_ < (h() - 24) || t < 0)
     t = 0;
   else if (t > size_)
     t = size_;
 
+  // Just moving the text that is already drawn is much faster...
+  if (t != topline_ && !(damage() & ~(DAMAGE_SCROLL | DAMAGE_CHILD))) {
+    scrolldy_ += topline_ - t;
+    redraw(DAMAGE_SCROLL);
+  } else
+    redraw();
+
   topline_ = t;
 
   scrollbar_->value(topline_, h() - 24, 0, size_);
 
   do_callback();
-
-  redraw();
 }
 
 
@@ -2782,11 +3173,15 @@ void HelpView::leftline(int l) {
   else if (l > hsize_)
     l = hsize_;
 
+  if (l != leftline_ && !(damage() & ~(DAMAGE_SCROLL | DAMAGE_CHILD))) {
+    scrolldx_ += leftline_ - l;
+    redraw(DAMAGE_SCROLL);
+  } else
+    redraw();
+
   leftline_ = l;
 
   hscrollbar_->value(leftline_, w() - 24, 0, hsize_);
-
-  redraw();
 }
 
 
@@ -2802,8 +3197,11 @@ void HelpView::value(const char *v) {
   if (!v)
     return;
 
+  stop_loading();
+
   if (value_ != NULL)
     free((void *)value_);
+  clear_tables();
 
   value_ = strdup(v);
 
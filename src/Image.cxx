@@ -26,7 +26,10 @@
 #include <fltk/Widget.h>
 #include <fltk/events.h>
 #include <fltk/draw.h>
+#include <fltk/Window.h>
 #include <fltk/x.h>
+#include "DisplayList.h"
+#include <string.h>
 
 /*! \class fltk::Image
 
@@ -89,6 +92,18 @@
 using namespace fltk;
 
 unsigned long Image::memused_;
+unsigned long Image::serials_;
+
+// Record a draw() into the DisplayList, then draw it without recording
+// the fillrect() or anything else it may call:
+static void record_image(const Image* image,
+			 const fltk::Rectangle& from, const fltk::Rectangle& to) {
+  DisplayList* d = fl_display_list;
+  d->image(image, from, to);
+  fl_display_list = 0;
+  image->draw(from, to);
+  fl_display_list = d;
+}
 
 #if USE_CAIRO || DOXYGEN
 
@@ -269,6 +284,8 @@ uchar* Image::buffer() {
     flags |= COPIED_DATA;
     memused_ += mem_used();
   }
+  // finish anything drawn into it by make_current():
+  cairo_surface_flush(PICTURE);
   return cairo_image_surface_get_data(PICTURE);
 }
 
@@ -326,7 +343,7 @@ uchar* Image::linebuffer(int y) {
 void Image::setpixels(const uchar* buf, const fltk::Rectangle& r, int linedelta)
 {
   if (r.empty()) return;
-  flags &= ~COPIED;
+  buffer_changed();
   uchar* to = linebuffer(r.y()) + r.x()*buffer_depth();
   // see if we can do it all at once:
   if (r.w() == buffer_width() && (r.h()==1 || linedelta == buffer_linedelta())) {
@@ -350,7 +367,7 @@ void Image::setpixels(const uchar* buf, const fltk::Rectangle& r, int linedelta)
 */
 void Image::setpixels(const uchar* buf, int y) {
   convert(linebuffer(y), buf, pixeltype_, width());
-  flags &= ~COPIED;
+  buffer_changed();
 }
 
 void Image::fetch_if_needed() const {
@@ -381,6 +398,7 @@ extern void fl_set_cairo_ctm();
   * OS/X: works well in all cases.
 */
 void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
+  if (fl_display_list) {record_image(this, from, to); return;}
   fetch_if_needed();
   if (!picture) {fillrect(to); return;}
   cairo_save(cr);
@@ -408,6 +426,34 @@ void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
   cairo_restore(cr);
 }
 
+/**
+  Fill \a r with copies of the image, the top-left corner of one of
+  them at the top-left corner of \a r, in one request to the graphics
+  system rather than one for each copy. TiledImage uses this.
+
+  Returns false, having drawn nothing, if this cannot be done. The
+  caller must then draw the copies itself. This happens:
+  * on X11 without XRender if the image is scaled by the current
+  transformation, or has both color and alpha.
+  * on Windows if the image has alpha or is scaled.
+  * on OS/X, and when recording a display list.
+  * if the image is in an atlas (see atlas_size()).
+*/
+bool Image::draw_tiled(const fltk::Rectangle& r) const {
+  if (fl_display_list || r.empty()) return false;
+  fetch_if_needed();
+  if (!picture || pixeltype_ == MASK || pixeltype_ == RGBM ||
+      pixeltype_ == MRGB32) return false;
+  cairo_save(cr);
+  fl_set_cairo_ctm();
+  cairo_rectangle(cr, r.x(), r.y(), r.w(), r.h());
+  cairo_set_source_surface(cr, PICTURE, r.x(), r.y());
+  cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_REPEAT);
+  cairo_fill(cr);
+  cairo_restore(cr);
+  return true;
+}
+
 /**
   This is equivalent to:
 \code
@@ -447,8 +493,21 @@ void Image::setimage(const uchar* source, PixelType p, int w, int h, int ld)
   Figures out linedelta for you as w*depth(p).
 */
 
+extern void fl_draw_into_surface(cairo_surface_t*, int w, int h);
+extern fltk::Image* fl_current_Image;
+
+/**
+  Make the fltk drawing functions draw into the image. It is drawn by
+  Cairo in this program's memory, so this works without sending
+  anything to the display, for instance to make thumbnails. Use GSave
+  to go back to drawing into the window, and buffer() to read the
+  pixels.
+*/
 void Image::make_current() {
-  // TODO - make the cr point at the image_surface!
+  buffer();
+  flags |= FETCHED; // what is drawn must not be replaced by fetch()
+  fl_draw_into_surface(PICTURE, w_, h_);
+  fl_current_Image = this;
 }
 
 // This function is provided by some backends, and does direct-draw
@@ -534,6 +593,15 @@ static inline bool innards(const uchar *buf, fltk::PixelType type,
   setpixels() calls this for you.
 */
 
+/*! \fn unsigned long Image::serial() const
+  Returns a number that changes every time buffer_changed() is
+  called, including by setpixels(). No two Image objects share a
+  number, so code that keeps its own copy of the pixels, such as
+  the OpenGL texture cache used by gldrawimage(), can use it to tell
+  when the copy is out of date even if the Image was deleted and
+  another created at the same address.
+*/
+
 /*! The destructor calls destroy() */
 Image::~Image() {
   destroy();
@@ -570,6 +638,16 @@ bool Image::fetch() {return true;}
   if the file name or contents have changed.
 */
 
+/*! \fn bool Image::fetched() const
+  Return true if fetch() has been called since the image was made or
+  refetch() or destroy() was called.
+*/
+
+/*! \fn void Image::set_fetched()
+  Make fetch_if_needed() not call fetch(). This is for code that fills
+  in the pixels some other way, such as SharedImage::async_fetch().
+*/
+
 /*! \fn void Image::fetch_if_needed() const
   Call fetch() if it has not been called or if refetch() was called.
 */
@@ -711,6 +789,28 @@ void Image::_draw(const fltk::Rectangle& r) const
   SharedImage to decide when to clear out cached images.
 */
 
+/*! \fn int Image::atlas_size()
+  Images no wider or taller than this are put together into a few
+  large images on the server, rather than each made separately. This
+  can make drawing lots of small images, such as a toolbar, faster
+  as the server is not switching between them. The default is zero,
+  which turns this off. Images that are drawn into with
+  make_current() are never put together. This only makes a difference
+  on X11 at the moment.
+*/
+int Image::atlas_size_ = 0;
+
+/*! \fn int Image::scale_quality()
+  How draw(from,to) scales images when the system cannot do it, such
+  as on X11 servers without XRender. NEAREST copies the nearest pixel,
+  BILINEAR blends the 4 nearest ones, and BOX (the default) averages
+  all the pixels under each one when making an image smaller and is
+  the same as BILINEAR when making it bigger. The last few scaled
+  images are kept, so drawing the same image at the same size again
+  does not scale it again.
+*/
+int Image::scale_quality_ = Image::BOX;
+
 ////////////////////////////////////////////////////////////////
 // drawimage()
 
@@ -738,6 +838,8 @@ static Image* reused_image;
 void fltk::drawimage(const uchar* pointer, fltk::PixelType type,
 		     const Rectangle& r,
 		     int line_delta) {
+  // the pixels may be gone when it is replayed:
+  if (fl_display_list) fl_display_list->abort();
   if (innards(pointer, type, r, line_delta, 0, 0)) return;
   // Fake it using a temporary Image
   if (!reused_image) reused_image = new Image();
@@ -803,6 +905,7 @@ void fltk::drawimage(const uchar* pointer, fltk::PixelType type,
 void fltk::drawimage(DrawImageCallback cb,
 		     void* userdata, fltk::PixelType type,
 		     const Rectangle& r) {
+  if (fl_display_list) fl_display_list->abort();
   if (innards(0, type, r, 0, cb, userdata)) return;
   // Fake it using a temporary Image
   if (!reused_image) reused_image = new Image();
@@ -813,6 +916,32 @@ void fltk::drawimage(DrawImageCallback cb,
   reused_image->draw(Rectangle(r.w(),r.h()), r);
 }
 
+int fl_drawimage_threads = -1;
+bool fl_drawimage_concurrent = false;
+
+/*!
+  Set how many extra threads drawimage() may use to convert large
+  images to the display's format. The main thread converts part of
+  the image as well, so \a n of 1 can make it twice as fast. If \a n
+  is negative (the default) one thread is used for each processor
+  after the first, up to 7. Zero turns this off. The threads are
+  those of ThreadPool::shared(), so no more than it has are used.
+
+  Only big images (about 256K pixels or more) are split up, and only
+  on displays where the conversion does not dither, such as 24 or 32
+  bit X visuals. Other backends ignore this.
+
+  Normally the callback version of drawimage() is always run on the
+  main thread. If \a concurrent_callbacks is true it may instead be
+  called by several threads at once, and y will \e not be asked for
+  in increasing order. Only turn this on if your callback only reads
+  the image and uses the buffer it is passed for scratch space.
+*/
+void fltk::set_drawimage_threads(int n, bool concurrent_callbacks) {
+  fl_drawimage_threads = n;
+  fl_drawimage_concurrent = concurrent_callbacks;
+}
+
 //
 // End of "$Id$".
 //
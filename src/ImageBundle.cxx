@@ -0,0 +1,216 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+/*! \class fltk::ImageBundle
+
+  One Image made from many icons, decoded in a single pass from a
+  compressed block of data that is compiled into the program. Each
+  icon is a Symbol that draws its part of the image with
+  Image::draw(from,to), so all the icons share one buffer (and on
+  most systems one server-side image), and they are all decoded at
+  once, rather than each the first time it is drawn:
+
+\code
+#include "toolbar_icons.h" // static const unsigned char toolbar_icons[]
+static fltk::ImageBundle toolbar(toolbar_icons, sizeof(toolbar_icons));
+...
+button->image(toolbar.icon("open"));
+\endcode
+
+  The icons also get these names as Symbols, so "@open" in a label
+  draws one unless another Symbol has the same name.
+
+  The data is this, numbers are 16 bit little-endian:
+  - The 4 bytes "FIB1"
+  - The width and height of the whole image, and the number of icons
+  - For each icon its x, y, w, h in the image, and a nul-terminated name
+  - The pixels of the image, left to right and top to bottom, as runs.
+  A byte c less than 128 is followed by c+1 pixels, and a byte of 128
+  or more by one pixel that is repeated c-126 times. Each pixel is 4
+  bytes of A, R, G, B, not premultiplied. Runs may cross rows.
+
+  Bad data makes an image that draws nothing and has no icons.
+*/
+
+#include <config.h>
+#include <fltk/ImageBundle.h>
+#include <string.h>
+#if HAVE_PTHREAD
+# include <fltk/Threads.h>
+#endif
+
+using namespace fltk;
+
+struct ImageBundle::Icon : public Symbol {
+  const ImageBundle* bundle;
+  Rectangle area;
+  Icon(const char* name) : Symbol(name) {}
+  void _draw(const Rectangle& r) const {bundle->draw(area, r);}
+  void _measure(int& w, int& h) const {w = area.w(); h = area.h();}
+};
+
+static inline int get16(const uchar* p) {return p[0]|(p[1]<<8);}
+
+// Size of the image, or zero if the data is too short:
+static int header(const uchar* data, unsigned length, int i) {
+  return length >= 10 ? get16(data+4+2*i) : 0;
+}
+
+/*!
+  Make the icons described by \a data, which must stay around for the
+  life of this. This does not decode the pixels, that happens when one
+  is first drawn, or in another thread if decode_in_background() is
+  called.
+*/
+ImageBundle::ImageBundle(const uchar* data, unsigned length, const char* name)
+  : Image(header(data,length,0), header(data,length,1), name),
+    icon_(0), icons_(0), pixels_(0), end_(data+length), job_(0)
+{
+  if (length < 10 || memcmp(data, "FIB1", 4)) {setsize(0,0); return;}
+  int n = get16(data+8);
+  const uchar* p = data+10;
+  icon_ = new Icon*[n ? n : 1];
+  for (; icons_ < n; icons_++) {
+    const uchar* q = p+8;
+    while (q < end_ && *q) q++;
+    if (q >= end_) {
+      while (icons_) delete icon_[--icons_];
+      setsize(0,0);
+      return;
+    }
+    Icon* o = new Icon((const char*)(p+8));
+    o->bundle = this;
+    o->area.set(get16(p), get16(p+2), get16(p+4), get16(p+6));
+    icon_[icons_] = o;
+    p = q+1;
+  }
+  pixels_ = p;
+}
+
+ImageBundle::~ImageBundle() {
+  fetch_if_needed(); // finishes decode_in_background()
+  for (int i = 0; i < icons_; i++) delete icon_[i];
+  delete[] icon_;
+}
+
+/*! \fn int ImageBundle::icons() const
+  Number of icons in the data.
+*/
+
+/*! Return icon \a i, or null if \a i is out of range. */
+const Symbol* ImageBundle::icon(int i) const {
+  return (i >= 0 && i < icons_) ? icon_[i] : 0;
+}
+
+/*! Return the icon called \a name, or null if there is none. */
+const Symbol* ImageBundle::icon(const char* name) const {
+  for (int i = 0; i < icons_; i++)
+    if (!strcmp(icon_[i]->name(), name)) return icon_[i];
+  return 0;
+}
+
+// Run-length decode n ARGB32 pixels, return false if the data ends:
+static bool decode(const uchar* p, const uchar* e, U32* out, int n) {
+  U32* end = out+n;
+  while (out < end) {
+    if (p >= e) return false;
+    int c = *p++;
+    if (c < 128) {
+      if (p+4*(c+1) > e || out+c+1 > end) return false;
+      for (int i = 0; i <= c; i++, p += 4)
+	*out++ = (p[0]<<24)|(p[1]<<16)|(p[2]<<8)|p[3];
+    } else {
+      if (p+4 > e || out+c-126 > end) return false;
+      U32 v = (p[0]<<24)|(p[1]<<16)|(p[2]<<8)|p[3];
+      p += 4;
+      for (int i = c-126; i--;) *out++ = v;
+    }
+  }
+  return true;
+}
+
+struct fltk::ImageBundleJob {
+  U32* pixels;
+  bool ok;
+  const uchar* data;
+  const uchar* end;
+  int n;
+#if HAVE_PTHREAD
+  ThreadPool::TaskId task;
+#endif
+};
+
+static void decode_job(void* v) {
+  ImageBundleJob* j = (ImageBundleJob*)v;
+  j->ok = decode(j->data, j->end, j->pixels, j->n);
+}
+
+/*!
+  Make a ThreadPool thread decode the pixels, so this is done by the
+  time the icons are drawn, such as while the program is starting
+  up. The next fetch() waits for it. This does nothing if threads are
+  not supported or the pixels are already decoded.
+*/
+void ImageBundle::decode_in_background() {
+#if HAVE_PTHREAD
+  if (job_ || fetched() || !pixels_ || w() <= 0 || h() <= 0) return;
+  ImageBundleJob* j = new ImageBundleJob;
+  j->n = w()*h();
+  j->pixels = new U32[j->n];
+  j->ok = false;
+  j->data = pixels_;
+  j->end = end_;
+  j->task = ThreadPool::shared()->add(decode_job, j, ThreadPool::LOW);
+  job_ = j;
+#endif
+}
+
+/*! Decode all the pixels in one pass into the image. */
+bool ImageBundle::fetch() {
+  if (!pixels_ || w() <= 0 || h() <= 0) return false;
+  ImageBundleJob* j = job_;
+  job_ = 0;
+  U32* pixels;
+  bool ok;
+  if (j) {
+#if HAVE_PTHREAD
+    ThreadPool::shared()->wait(j->task);
+#endif
+    pixels = j->pixels;
+    ok = j->ok;
+    delete j;
+  } else {
+    pixels = new U32[w()*h()];
+    ok = decode(pixels_, end_, pixels, w()*h());
+  }
+  if (!ok) memset(pixels, 0, w()*h()*sizeof(U32)); // draw nothing
+  setpixeltype(ARGB32);
+  setpixels((const uchar*)pixels, Rectangle(w(), h()));
+  delete[] pixels;
+  return ok;
+}
+
+//
+// End of "$Id$".
+//
@@ -165,45 +165,157 @@ float Input::expandpos(
 ////////////////////////////////////////////////////////////////
 // minimal update:
 
-// Characters from mu_p to end of widget are redrawn.
+// Characters from mu_p to mu_e are redrawn, and the area below the
+// last line if mu_e is MU_END.
 // If this == erase_cursor_only, small part at mu_p is redrawn.
 static Input* erase_cursor_only;
+#define MU_END 0x7fffffff
 
 /*! Indicate that the characters after position \a p must be redrawn.
   This is done with a clip region to work with xft. The purpose is to
   avoid blinking, not to make draw() less expensive. A few minor attempts
   to make draw() not think about clipped text are implemented, though.
 */
-
 void Input::minimal_update(int p) {
+  minimal_update(p, MU_END);
+}
+
+/*! Indicate that the characters between positions \a p and \a q must be
+  redrawn. Lines entirely after both of them are not redrawn, so this
+  must not be used if the lines after them move. */
+void Input::minimal_update(int p, int q) {
+  if (q < p) {int t = p; p = q; q = t;}
   if (erase_cursor_only == this) erase_cursor_only = 0;
   // Sometimes DAMAGE_ALL is set, but widget not redrawed because it's out of clip region.
   // So widget remains undrawed before next full redraw (window resize)
   //if (damage() & DAMAGE_ALL) return; // don't waste time if it won't be done
   if (damage() & DAMAGE_VALUE) {
     if (p < mu_p) mu_p = p;
+    if (q > mu_e) mu_e = q;
   } else {
     mu_p = p;
+    mu_e = q;
   }
   redraw(DAMAGE_VALUE);
 }
 
-/*! Indicate that the characters between positions \a p and \a q must be
-  redrawn. Currently this just does minimal_update(min(p,q)). */
-void Input::minimal_update(int p, int q) {
-  if (q < p) p = q;
-  minimal_update(p);
-}
-
 /*! Indicate that a cursor drawn a postion \a p must be redrawn. */
 void Input::erase_cursor_at(int p) {
   if (!damage()) {
-    mu_p = p;
+    mu_p = mu_e = p;
     redraw(DAMAGE_VALUE);
     erase_cursor_only = this;
   } else {
-    minimal_update(p);
+    minimal_update(p, p);
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// line index:
+
+// The start of every line draw() shows is kept in linestart_, so the
+// visible lines and the one with the cursor are found without expanding
+// all the text before them. Editing only measures the paragraph that
+// changed. Where the lines break depends on the font only if wordwrap
+// is on.
+
+static void reserve_ints(int*& array, int n, int& size, int needed) {
+  if (needed > size) {
+    int m = size ? 2*size : 16;
+    while (m < needed) m *= 2;
+    int* newarray = new int[m];
+    memcpy(newarray, array, n*sizeof(int));
+    delete[] array;
+    array = newarray;
+    size = m;
+  }
+}
+
+// lines measured by update_lines():
+static int* newlines;
+static int newlinessize;
+
+/*! Returns true if linestart_ is correct for \a wordwrap and the
+  current font. */
+bool Input::lines_ok(int wordwrap) const {
+  return nlines_ && lines_type_ == type() && lines_wordwrap_ == wordwrap &&
+    (!wordwrap || (lines_font_ == getfont() && lines_fontsize_ == getsize()));
+}
+
+/*! Find the start of every line by calling expand() the same way draw()
+  does, using the current font. */
+void Input::build_lines(int wordwrap) const {
+  char buf[MAXBUF];
+  int n = 0;
+  for (const char* p = text_; ;) {
+    reserve_ints(linestart_, n, linestartsize_, n+1);
+    linestart_[n++] = p-text_;
+    const char* e = expand(p, buf, wordwrap);
+    if (e >= text_+size_) break;
+    if (*e == '\n' || *e == ' ') e++;
+    p = e;
+  }
+  nlines_ = n;
+  lines_wordwrap_ = wordwrap;
+  lines_font_ = getfont();
+  lines_fontsize_ = getsize();
+  lines_type_ = type();
+}
+
+/*! Returns the line that \a position is in, the last one starting at or
+  before it. */
+int Input::find_line(int position) const {
+  int a = 0, b = nlines_;
+  while (b-a > 1) {
+    int c = (a+b)/2;
+    if (linestart_[c] <= position) a = c; else b = c;
+  }
+  return a;
+}
+
+/*! The text from \a b to \a olde was replaced by what is now from \a b
+  to \a newe. Fix linestart_ by measuring the lines of the paragraphs
+  that changed. Returns the position after which the lines are the
+  same as before, or MU_END if the ones after the change have moved up
+  or down.
+*/
+int Input::update_lines(int b, int olde, int newe) {
+  if (!nlines_) return MU_END;
+  if (type() < MULTILINE || type() != lines_type_) {nlines_ = 0; return MU_END;}
+  // a line starts at the paragraph with b in both the old and new text:
+  int start = b;
+  while (start > 0 && text_[start-1] != '\n') start--;
+  int first = find_line(start);
+  if (linestart_[first] != start) {nlines_ = 0; return MU_END;}
+  // measure until a paragraph starts after the change, the lines from
+  // there on are the old ones moved by delta:
+  if (lines_wordwrap_) fltk::setfont(lines_font_, lines_fontsize_);
+  const int delta = newe-olde;
+  const int oldnlines = nlines_;
+  int last = oldnlines;
+  int n = 0;
+  char buf[MAXBUF];
+  for (const char* p = text_+start; ;) {
+    reserve_ints(newlines, n, newlinessize, n+1);
+    newlines[n++] = p-text_;
+    const char* e = expand(p, buf, lines_wordwrap_);
+    if (e >= text_+size_) break;
+    if (*e == '\n' || *e == ' ') e++;
+    p = e;
+    if (p-text_ > newe && p[-1] == '\n') {
+      last = find_line(p-text_-delta);
+      if (linestart_[last] != p-text_-delta) {nlines_ = 0; return MU_END;}
+      break;
+    }
   }
+  const int count = oldnlines-(last-first)+n;
+  reserve_ints(linestart_, oldnlines, linestartsize_, count);
+  memmove(linestart_+first+n, linestart_+last, (oldnlines-last)*sizeof(int));
+  memcpy(linestart_+first, newlines, n*sizeof(int));
+  for (int i = first+n; i < count; i++) linestart_[i] += delta;
+  nlines_ = count;
+  if (count != oldnlines || last == oldnlines) return MU_END;
+  return linestart_[first+n]-1;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -301,43 +413,44 @@ void Input::draw(const Rectangle& r)
   }
 
   int wordwrap = (type() > MULTILINE) ? r.w()-8 : 0;
+  if (!lines_ok(wordwrap)) build_lines(wordwrap);
+  const int lines = nlines_;
+
+  // the changed lines, all of them if this is an expose:
+  int mu_end = (damage() & DAMAGE_EXPOSE) ? MU_END : mu_e;
 
   const char *p, *e;
   char buf[MAXBUF];
 
-  // count how many lines and put the last one into the buffer:
-  // And figure out where the cursor is:
-  int lines;
-  int curx, cury;
+  // put the line with the cursor into the buffer and figure out where
+  // the cursor is:
+  int curx = 0, cury = 0;
   int cursor_position = (this==dnd_target) ? dnd_target_position : position();
-  for (p=text_, curx=cury=lines=0; ;) {
-    e = expand(p, buf, wordwrap);
-    if (cursor_position >= p-text_ && cursor_position <= e-text_) {
-      curx = int(expandpos(p, text_+cursor_position, buf, 0)+.5);
-      if (focused() && !was_up_down) up_down_pos = float(curx);
-      cury = lines*height;
-      int newscroll = xscroll_;
-      if (curx > newscroll+r.w()-20) {
-	// figure out scrolling so there is space after the cursor:
-	newscroll = curx+20-r.w();
-	// figure out the furthest left we ever want to scroll:
-	int ex = int(expandpos(p, e, buf, 0))-r.w()+8;
-	// use minimum of both amounts:
-	if (ex < newscroll) newscroll = ex;
-      } else if (curx < newscroll+20) {
-	newscroll = curx-20;
-      }
-      if (newscroll < 0) newscroll = 0;
-      if (newscroll != xscroll_) {
-	xscroll_ = newscroll;
-	mu_p = 0;
-	erase_cursor_only = false;
-      }
+  int bufline = find_line(cursor_position);
+  p = text_+linestart_[bufline];
+  e = expand(p, buf, wordwrap);
+  if (cursor_position <= e-text_) {
+    curx = int(expandpos(p, text_+cursor_position, buf, 0)+.5);
+    if (focused() && !was_up_down) up_down_pos = float(curx);
+    cury = bufline*height;
+    int newscroll = xscroll_;
+    if (curx > newscroll+r.w()-20) {
+      // figure out scrolling so there is space after the cursor:
+      newscroll = curx+20-r.w();
+      // figure out the furthest left we ever want to scroll:
+      int ex = int(expandpos(p, e, buf, 0))-r.w()+8;
+      // use minimum of both amounts:
+      if (ex < newscroll) newscroll = ex;
+    } else if (curx < newscroll+20) {
+      newscroll = curx-20;
+    }
+    if (newscroll < 0) newscroll = 0;
+    if (newscroll != xscroll_) {
+      xscroll_ = newscroll;
+      mu_p = 0;
+      mu_end = MU_END;
+      erase_cursor_only = false;
     }
-    lines++;
-    if (e >= text_+size_) break;
-    if (*e == '\n' || *e == ' ') e++;
-    p = e;
   }
 
   // adjust the scrolling:
@@ -349,6 +462,7 @@ void Input::draw(const Rectangle& r)
     if (newy != yscroll_) {
       yscroll_ = newy;
       mu_p = 0;
+      mu_end = MU_END;
       erase_cursor_only = false;
     }
   } else {
@@ -369,16 +483,19 @@ void Input::draw(const Rectangle& r)
   int xpos = r.w()-9; if (xpos > 3) xpos = 3; else if (xpos < 1) xpos = 1;
   xpos += r.x()-xscroll_;
 
-  int ypos = -yscroll_;
+  // skip the lines scrolled off the top:
+  int n = 0;
+  if (yscroll_ > 0) {n = yscroll_/height; if (n >= lines) n = lines-1;}
+  int ypos = n*height-yscroll_;
 
-  // visit each line and draw it:
-  p = text_;
+  // visit each visible line and draw it:
+  p = text_+linestart_[n];
   int spot_x = r.x();
   int spot_y = r.y();
   for (; ypos < r.h();) {
 
-    // re-expand line unless it is the last one calculated above:
-    if (lines>1) e = expand(p, buf, wordwrap);
+    // expand line unless it is the one with the cursor done above:
+    if (n != bufline) {e = expand(p, buf, wordwrap); bufline = n;}
 
     if (ypos <= -height) goto CONTINUE; // clipped off top
 
@@ -386,6 +503,7 @@ void Input::draw(const Rectangle& r)
       const char* pp = text_+mu_p; // pointer to where minimal update starts
       if (e < pp) goto CONTINUE2; // this line is before the changes
       if (erase_cursor_only && p > pp) goto CONTINUE2; // this line is after
+      if (p-text_ > mu_end) goto CONTINUE2; // after the changes
       // calculate area to erase:
       Rectangle er(r.x(), r.y()+ypos, r.w(), height);
       if (p >= pp) {
@@ -453,13 +571,13 @@ void Input::draw(const Rectangle& r)
 
   CONTINUE:
     ypos += height;
-    if (e >= text_+size_) break;
-    if (*e == '\n' || *e == ' ') e++;
-    p = e;
+    if (++n >= lines) break;
+    p = text_+linestart_[n];
   }
 
   // for minimal update, erase all lines below last one if necessary:
   if (!(damage()&DAMAGE_ALL) && type() >= MULTILINE && ypos<r.h()
+      && mu_end == MU_END
       && (!erase_cursor_only || p <= text_+mu_p)) {
     if (ypos < 0) ypos = 0;
     setcolor(background);
@@ -564,17 +682,13 @@ int Input::mouse_position(const Rectangle& r) const
 
   int wordwrap = (type() > MULTILINE) ? r.w()-8 : 0;
 
-  // Step through all the lines until we reach the pointed-to line.
-  // Expand the lines to printed representation into the buffer:
+  // Expand the pointed-to line to printed representation into the buffer:
+  if (!lines_ok(wordwrap)) build_lines(wordwrap);
+  if (theline >= nlines_) return size();
   const char *p, *e;
   char buf[MAXBUF];
-  for (p=text_;; ) {
-    e = expand(p, buf, wordwrap);
-    theline--; if (theline < 0) break;
-    if (*e == '\n' || *e == ' ') e++;
-    p = e;
-    if (e >= text_+size_) break;
-  }
+  p = text_+linestart_[theline];
+  e = expand(p, buf, wordwrap);
 
   // Do a binary search for the character that starts before this position:
   int xpos = r.x()-xscroll_; if (r.w() > 12) xpos += 3;
@@ -807,6 +921,13 @@ bool Input::replace(int b, int e, const char* text, int ilen) {
   undowidget = this;
   undoat = b+ilen;
 
+  // only the lines up to q changed, but the old selection or cursor
+  // after them must be redrawn too:
+  int q = update_lines(b, e, b+ilen);
+  int m = mark_ > position_ ? mark_ : position_;
+  if (m >= e) m += ilen-(e-b); else if (m > b) m = b+ilen;
+  if (m > q) q = m;
+
   // When editing with word wrap, it is possible to effectively turn
   // the space before the current word into a newline or back, so the
   // minimal update pointer must point at it.  This will
@@ -822,7 +943,7 @@ bool Input::replace(int b, int e, const char* text, int ilen) {
   if (mark_ < b) b = mark_;
   if (position_ < b) b = position_;
 
-  minimal_update(b);
+  minimal_update(b, q);
 
   mark_ = position_ = undoat;
 
@@ -878,6 +999,10 @@ bool Input::undo() {
   int xlen = undoinsert;
   int b = undoat-xlen;
   int b1 = b;
+  int m = mark_ > position_ ? mark_ : position_;
+  if (m >= b+xlen) m += ilen-xlen; else if (m > b) m = b+ilen;
+  if (mark_ < b1) b1 = mark_;
+  if (position_ < b1) b1 = position_;
 
   reserve(size_+ilen);
 
@@ -903,7 +1028,9 @@ bool Input::undo() {
   position_ = b;
   undo_is_redo = !undo_is_redo;
 
-  minimal_update(b1);
+  int q = update_lines(b-ilen, b-ilen+xlen, b);
+  if (m > q) q = m;
+  minimal_update(b1, q);
   changed_stuff(this);
   return true;
 }
@@ -939,6 +1066,9 @@ Input::Input(int x, int y, int w, int h, const char* l)
   buffer  = 0;
   text_ = "";
   xscroll_ = yscroll_ = 0;
+  mu_p = 0; mu_e = MU_END;
+  linestart_ = 0;
+  nlines_ = linestartsize_ = 0;
   style(default_style);
   label_width = 0;
 }
@@ -963,27 +1093,48 @@ Input::Input(int x, int y, int w, int h, const char* l)
   than strlen(text()) if there are NUL characters in it.
 */
 
+// The buffer has a count of the widgets using it in front of it, so
+// share_text() can put it in several of them:
+static char* new_buffer(int size) {
+  char* p = new char[sizeof(int)+size];
+  *(int*)p = 1;
+  return p+sizeof(int);
+}
+
+static int& buffer_users(char* buffer) {return *(int*)(buffer-sizeof(int));}
+
+static void release_buffer(char* buffer) {
+  if (buffer && !--buffer_users(buffer)) delete[] (buffer-sizeof(int));
+}
+
 /*! Reserve the interal private buffer of at least \a len bytes, even
   if the current text() is not that long. Can be used to avoid unnecessary
   memory reallocations if you know you will be replacing the text() with
   a longer one later.
 */
 void Input::reserve(int len) {
-  if (!bufsize) {
+  if (bufsize && buffer_users(buffer) > 1) {
+    // shared by share_text(), copy it before it is changed:
+    char* old = buffer;
     bufsize = (len > size_) ? len+9 : size_+1;
-    buffer = new char[bufsize];
+    buffer = new_buffer(bufsize);
+    memcpy(buffer, text_, size_);
+    release_buffer(old);
+  } else if (!bufsize) {
+    bufsize = (len > size_) ? len+9 : size_+1;
+    buffer = new_buffer(bufsize);
     memcpy(buffer, text_, size_);
   } else if (bufsize <= len) {
     int newsize = (len > size_) ? len*2 : size_+1;
     // we may need to move old value in case it points into buffer:
     if (text_ >= buffer && text_ < buffer+bufsize) {
-      char* nbuffer = new char[newsize];
+      char* nbuffer = new_buffer(newsize);
       memcpy(nbuffer, text_, size_);
-      delete[] buffer;
+      release_buffer(buffer);
       buffer = nbuffer;
     } else {
-      delete[] buffer;
-      buffer = new char[newsize];
+      release_buffer(buffer);
+      buffer = new_buffer(newsize);
       memcpy(buffer, text_, size_);
     }
     bufsize = newsize;
@@ -1010,6 +1161,7 @@ bool Input::static_text(const char* str, int len) {
   if (fl_pending_callback == this) fl_pending_callback = 0;
   clear_changed();
   if (undowidget == this) undowidget = 0;
+  nlines_ = 0;
   bool ret = true;
   if (str == text_ && len == size_) {
     ret = false;
@@ -1068,11 +1220,33 @@ bool Input::text(const char* str) {
   return text(str, str ? strlen(str) : 0);
 }
 
+/*!
+  Make text() the same as \a from->text() without copying it. The two
+  widgets share the memory until either one is edited, which copies
+  it, and the last one using it frees it. This is useful to show the
+  same large text in many Output widgets. Returns true if the text
+  changed.
+*/
+bool Input::share_text(const Input* from) {
+  if (from == this) return false;
+  if (!from->bufsize || from->text_ != from->buffer)
+    return text(from->text_, from->size_);
+  bool ret = static_text(from->text_, from->size_);
+  if (buffer != from->buffer) {
+    buffer_users(from->buffer)++;
+    release_buffer(buffer);
+    buffer = from->buffer;
+    bufsize = from->bufsize;
+  }
+  return ret;
+}
+
 /*! The destructor destroys the memory used by text() */
 Input::~Input() {
   if (fl_pending_callback == this) fl_pending_callback = 0;
   if (undowidget == this) undowidget = 0;
-  delete[] buffer;
+  release_buffer(buffer);
+  delete[] linestart_;
 }
 
 ////////////////////////////////////////////////////////////////
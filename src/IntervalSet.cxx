@@ -0,0 +1,173 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#include <fltk/IntervalSet.h>
+#include <stdlib.h>
+#include <string.h>
+using namespace fltk;
+
+/*! \class fltk::IntervalSet
+
+  A set of integers stored as a sorted array of non-overlapping ranges,
+  so a set like "all million rows except these three" is only a few
+  numbers. contains() is a binary search, and add() or remove() of a
+  range takes the same time no matter how many numbers are in it.
+
+  If callback() is set it is called after add(), remove() or clear()
+  change the set, once for each range of numbers that went in or out,
+  with \a added true if they went in.
+
+  This is used by Browser::row_selection() to remember which rows
+  are selected.
+*/
+
+IntervalSet::~IntervalSet() {free(ranges_);}
+
+// Index of the first range that ends after i, or n_ if none:
+int IntervalSet::find(int i) const {
+  int a = 0, b = n_;
+  while (a < b) {
+    int c = (a+b)/2;
+    if (ranges_[2*c+1] > i) b = c; else a = c+1;
+  }
+  return a;
+}
+
+// Replace ranges first..last-1 with the n ranges in pairs:
+void IntervalSet::replace(int first, int last, const int* pairs, int n) {
+  int newn = n_-(last-first)+n;
+  if (newn > size_) {
+    size_ = newn > 2*size_ ? newn : 2*size_;
+    ranges_ = (int*)realloc(ranges_, 2*size_*sizeof(int));
+  }
+  memmove(ranges_+2*(first+n), ranges_+2*last, 2*(n_-last)*sizeof(int));
+  memcpy(ranges_+2*first, pairs, 2*n*sizeof(int));
+  n_ = newn;
+}
+
+/*! Returns true if \a i is in the set. */
+bool IntervalSet::contains(int i) const {
+  int k = find(i);
+  return k < n_ && ranges_[2*k] <= i;
+}
+
+/*! Returns the smallest number in the set that is not less than \a i,
+  or -1 if there is none. */
+int IntervalSet::next(int i) const {
+  int k = find(i);
+  if (k >= n_) return -1;
+  return ranges_[2*k] > i ? ranges_[2*k] : i;
+}
+
+/*! Put the numbers from \a start up to but not including \a end
+  in the set. Returns how many were not already in it. */
+int IntervalSet::add(int start, int end) {
+  if (start >= end) return 0;
+  // ranges that overlap or touch this one are merged with it:
+  int first = find(start-1);
+  int last = first;
+  while (last < n_ && ranges_[2*last] <= end) last++;
+  // the gaps between them are what is added:
+  int* gaps = new int[2*(last-first+1)];
+  int ngaps = 0;
+  int added = 0;
+  int p = start;
+  for (int k = first; k < last; k++) {
+    if (ranges_[2*k] > p) {
+      gaps[2*ngaps] = p; gaps[2*ngaps+1] = ranges_[2*k]; ngaps++;
+      added += ranges_[2*k]-p;
+    }
+    if (ranges_[2*k+1] > p) p = ranges_[2*k+1];
+  }
+  if (p < end) {
+    gaps[2*ngaps] = p; gaps[2*ngaps+1] = end; ngaps++;
+    added += end-p;
+  }
+  if (added) {
+    int range[2] = {start, end};
+    if (first < last) {
+      if (ranges_[2*first] < start) range[0] = ranges_[2*first];
+      if (ranges_[2*last-1] > end) range[1] = ranges_[2*last-1];
+    }
+    replace(first, last, range, 1);
+    count_ += added;
+    if (callback_)
+      for (int i = 0; i < ngaps; i++)
+	callback_(this, gaps[2*i], gaps[2*i+1], true, arg_);
+  }
+  delete[] gaps;
+  return added;
+}
+
+/*! Take the numbers from \a start up to but not including \a end
+  out of the set. Returns how many were in it. */
+int IntervalSet::remove(int start, int end) {
+  if (start >= end) return 0;
+  int first = find(start);
+  int last = first;
+  while (last < n_ && ranges_[2*last] < end) last++;
+  if (first >= last) return 0;
+  // the pieces of the first and last range outside start..end stay:
+  int keep[4]; int nkeep = 0;
+  if (ranges_[2*first] < start) {
+    keep[0] = ranges_[2*first]; keep[1] = start; nkeep = 1;
+  }
+  if (ranges_[2*last-1] > end) {
+    keep[2*nkeep] = end; keep[2*nkeep+1] = ranges_[2*last-1]; nkeep++;
+  }
+  // remember what is removed for the callback:
+  int n = last-first;
+  int* removed = new int[2*n];
+  int total = 0;
+  for (int k = 0; k < n; k++) {
+    int a = ranges_[2*(first+k)]; if (a < start) a = start;
+    int b = ranges_[2*(first+k)+1]; if (b > end) b = end;
+    removed[2*k] = a; removed[2*k+1] = b;
+    total += b-a;
+  }
+  replace(first, last, keep, nkeep);
+  count_ -= total;
+  if (callback_)
+    for (int k = 0; k < n; k++)
+      callback_(this, removed[2*k], removed[2*k+1], false, arg_);
+  delete[] removed;
+  return total;
+}
+
+/*! Remove everything. */
+void IntervalSet::clear() {
+  if (!n_) return;
+  int* removed = ranges_;
+  int n = n_;
+  ranges_ = 0;
+  n_ = size_ = count_ = 0;
+  if (callback_)
+    for (int k = 0; k < n; k++)
+      callback_(this, removed[2*k], removed[2*k+1], false, arg_);
+  free(removed);
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,166 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#include <fltk/LazyGroup.h>
+#include <fltk/events.h>
+#include <fltk/run.h>
+
+using namespace fltk;
+
+/*! \class fltk::LazyGroup
+
+  A Group whose children are not made until it is first drawn. This
+  is meant for the pages of a TabGroup or WizardGroup, where only one
+  page is visible at a time, so a dialog with many pages opens as fast
+  as one with a single page and does not hold the memory of the pages
+  the user never looks at.
+
+  The builder() function is called with the group as Group::current(),
+  so it just constructs the widgets. It is called with the group at
+  the size it is now, which may not be the size it was created at.
+  The label() of the group is used for the tab, so that must be set
+  when it is constructed.
+
+\code
+static void build_network(fltk::LazyGroup* g, void*) {
+  new fltk::Input(100, 10, 200, 25, "Proxy:");
+  ...
+}
+
+fltk::TabGroup* tabs = new fltk::TabGroup(10, 10, 400, 300);
+tabs->begin();
+new fltk::LazyGroup(0, 25, 400, 275, "General", build_general);
+new fltk::LazyGroup(0, 25, 400, 275, "Network", build_network);
+tabs->end();
+\endcode
+
+  If prefetch() is turned on, the LazyGroup siblings just before and
+  after this one are built when the program is idle after this is
+  shown, so switching to the next tab does not wait.
+  If unload_delay() is set, the children are deleted after the group
+  has been hidden that many seconds, and built again the next time it
+  is shown. Do not keep pointers to the widgets made by the builder
+  in that case, or set them again in the builder.
+*/
+
+static LazyGroup* first;
+
+/*! The constructor does not call the builder, it is called by build()
+  when the group is first drawn. */
+LazyGroup::LazyGroup(int X, int Y, int W, int H, const char* l,
+		     Builder b, void* d)
+  : Group(X, Y, W, H, l),
+    builder_(b), data_(d), built_(false), prefetch_(false),
+    unload_delay_(0)
+{
+  next_ = first;
+  first = this;
+}
+
+LazyGroup::~LazyGroup() {
+  fltk::remove_idle_job(prefetch_job, this);
+  fltk::remove_timeout(unload_cb, this);
+  for (LazyGroup** p = &first; *p; p = &(*p)->next_)
+    if (*p == this) {*p = next_; break;}
+}
+
+/*! Call the builder() to make the children, if this has not been done
+  since the last unload(). This is done automatically when the group
+  is first drawn. */
+void LazyGroup::build() {
+  if (built_ || !builder_) return;
+  built_ = true;
+  Group* saved = Group::current();
+  begin();
+  builder_(this, data_);
+  Group::current(saved);
+  relayout();
+  redraw();
+  if (!visible_r() && unload_delay_ > 0)
+    fltk::add_timeout(unload_delay_, unload_cb, this);
+}
+
+/*! Delete all the children, the builder() is called again the next
+  time this is shown. */
+void LazyGroup::unload() {
+  fltk::remove_timeout(unload_cb, this);
+  if (!built_) return;
+  built_ = false;
+  clear();
+}
+
+void LazyGroup::unload_cb(void* v) {
+  LazyGroup* g = (LazyGroup*)v;
+  if (!g->visible_r()) g->unload();
+}
+
+// Build the LazyGroups next to this one in the parent, one each time
+// this is called:
+bool LazyGroup::prefetch_job(void* v) {
+  LazyGroup* g = (LazyGroup*)v;
+  Group* parent = g->parent();
+  if (!parent) return false;
+  int i = parent->find(g);
+  for (int j = i-1; j <= i+1; j += 2) {
+    if (j < 0 || j >= parent->children()) continue;
+    Widget* o = parent->child(j);
+    for (LazyGroup* p = first; p; p = p->next_)
+      if (p == o && !p->built_ && p->builder_) {p->build(); return true;}
+  }
+  return false;
+}
+
+/*! Builds the children the first time this is drawn. This is not
+  done when it is shown, because all the pages of a TabGroup are
+  visible() until it picks one, usually in its draw(). */
+void LazyGroup::draw() {
+  if (!built_ && builder_) {
+    build();
+    layout();
+    if (prefetch_) fltk::add_idle_job(prefetch_job, this, -1);
+  }
+  Group::draw();
+}
+
+/*! Starts the timers for prefetch() and unload_delay() on SHOW and
+  HIDE. */
+int LazyGroup::handle(int event) {
+  switch (event) {
+  case SHOW:
+    fltk::remove_timeout(unload_cb, this);
+    if (built_ && prefetch_) fltk::add_idle_job(prefetch_job, this, -1);
+    break;
+  case HIDE:
+    fltk::remove_idle_job(prefetch_job, this);
+    fltk::remove_timeout(unload_cb, this);
+    if (built_ && unload_delay_ > 0)
+      fltk::add_timeout(unload_delay_, unload_cb, this);
+    break;
+  }
+  return Group::handle(event);
+}
+
+//
+// End of "$Id$".
+//
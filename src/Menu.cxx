@@ -25,6 +25,8 @@
 #include <fltk/Menu.h>
 #include <fltk/damage.h>
 #include <fltk/Item.h> // for TOGGLE, RADIO
+#include <fltk/run.h>
+#include <fltk/string.h>
 
 #define checkmark(item) (item->type()>=Item::TOGGLE && item->type()<=Item::RADIO)
 
@@ -174,6 +176,39 @@ void My_List::flags_changed(const fltk::Menu*, fltk::Widget* widget) {
 */
 void List::flags_changed(const Menu*, Widget*) {}
 
+/*!
+  Browser::layout() calls this with about how many items it can show
+  at once. A List that keeps a widget for each item that is shown,
+  such as one using an fltk::WidgetPool, can use this to decide how
+  many to keep. The default does nothing.
+*/
+void List::visible_items(const Menu*, int) {}
+
+/*!
+  Return the index of the first top-level item at or after \a start
+  (wrapping around to the start of the list) whose label starts with
+  \a prefix, ignoring case, or -1 if there is none. This is used by
+  Menu::type_ahead() to find the item the user is typing the name of.
+
+  The default version calls child() on each item in turn. A List that
+  has the labels available, or sorted, can override this to find the
+  item without making a widget for each one, as StringArray does.
+*/
+int List::find_prefix(const Menu* menu, const char* prefix, int start) {
+  int n = children(menu, 0, 0);
+  if (n <= 0) return -1;
+  if (start < 0 || start >= n) start = 0;
+  int length = strlen(prefix);
+  for (int j = 0; j < n; j++) {
+    int i = (start+j)%n;
+    Widget* widget = child(menu, &i, 0);
+    if (!widget) continue;
+    const char* label = widget->label();
+    if (label && !strncasecmp(label, prefix, length)) return i;
+  }
+  return -1;
+}
+
 /*!
   The destructor does nothing. It is mostly here to shut up compiler
   warnings, and to allow subclasses that you want to dynamically
@@ -437,6 +472,36 @@ static Widget* shortcut_search(Group* g) {
   return 0;
 }
 
+extern int fl_matching_shortcuts(Widget** array, int max); // in ShortcutAssignment.cxx
+
+// Compare the positions in the menu of two items, like the search
+// order of handle_shortcut():
+static bool shortcut_before(const Menu* menu, const Widget* a, const Widget* b) {
+  // find the widgets above them that are in the same group:
+  for (const Widget* x = a; x != menu; x = x->parent())
+    for (const Widget* y = b; y != menu; y = y->parent())
+      if (x->parent() == y->parent()) {
+	// if one contains the other the group is found first:
+	if (x == y) return x == a && a != b;
+	return x->parent()->find(x) < x->parent()->find(y);
+      }
+  return false;
+}
+
+// Return the first of the n widgets that handle_shortcut() would find
+// in the menu, or null if none of them are active items of it:
+static Widget* shortcut_first(const Menu* menu, Widget* const* array, int n) {
+  Widget* ret = 0;
+  for (int i = 0; i < n; i++) {
+    Widget* item = array[i];
+    const Widget* w = item;
+    for (; w && w != menu; w = w->parent()) if (!w->active()) break;
+    if (w != menu) continue;
+    if (!ret || shortcut_before(menu, item, ret)) ret = item;
+  }
+  return ret;
+}
+
 /*!
   Respond to the current fltk::SHORTCUT or fltk::KEY event by finding
   a menu item it matches and calling execute() on it. True is returned
@@ -458,6 +523,26 @@ static Widget* shortcut_search(Group* g) {
 */
 int Menu::handle_shortcut() {
   //if (event_key_repeated()) return 0; // ignore repeating keys
+  if (list() == &default_list) {
+    // Find the widgets with a matching shortcut from the table of all
+    // of them, rather than testing every item:
+    Widget* array[16];
+    int n = fl_matching_shortcuts(array, 16);
+    if (!n) return 0;
+    if (n <= 16) {
+      Widget* item = shortcut_first(this, array, n);
+      if (!item) return 0;
+      // set focus_index() of each group above it like the search does:
+      Widget* w = item;
+      for (; w->parent() != this; w = w->parent())
+	w->parent()->focus_index(w->parent()->find(w));
+      value(Group::find(w));
+      if (checkmark(item))
+	item->invert_flag(STATE);
+      execute(item);
+      return 1;
+    }
+  }
   int children = this->children();
   for (int i = 0; i < children; i++) {
     Widget* item = child(i);
@@ -485,6 +570,55 @@ int Menu::handle_shortcut() {
   return 0;
 }
 
+/*!
+  Return the index of the first top-level item at or after \a start
+  whose label starts with \a prefix, ignoring case, wrapping around
+  to the start. Returns -1 if none match. This calls
+  List::find_prefix(), so a list() can make it fast.
+*/
+int Menu::find_prefix(const char* prefix, int start) const {
+  return list_->find_prefix(this, prefix, start);
+}
+
+/*!
+  Handle a KEY event by adding the typed character to a search string
+  and returning the index of the top-level item whose label starts with
+  it, or -1 if the key is not a printing character or no item matches.
+  The string is restarted if more than a second passes between keys or
+  a different Menu gets the key. Typing the same letter repeatedly
+  cycles through the items that start with it. \a current is the
+  index of the item the widget is on, the search starts there. Browser
+  and Choice call this and move to the returned item.
+*/
+int Menu::type_ahead(int current) {
+  static const Menu* last_menu;
+  static double last_time;
+  static char buffer[64];
+  static int length;
+  const char* text = event_text();
+  int n = event_length();
+  if (event_state(CTRL|ALT|META) || !n || (uchar)text[0] < ' ') return -1;
+  double now = get_time_secs();
+  if (last_menu != this || now - last_time > 1.0) length = 0;
+  last_menu = this;
+  last_time = now;
+  if (!length && text[0] == ' ') return -1;
+  if (length+n >= int(sizeof(buffer))) length = 0;
+  memcpy(buffer+length, text, n);
+  length += n;
+  // if it is all the same character, find the next item starting with it:
+  bool repeat = true;
+  for (int i = n; i < length; i++)
+    if (buffer[i] != buffer[i-n]) {repeat = false; break;}
+  if (repeat) {
+    length = n;
+    buffer[length] = 0;
+    return find_prefix(buffer, current+1);
+  }
+  buffer[length] = 0;
+  return find_prefix(buffer, current < 0 ? 0 : current);
+}
+
 /*! \fn int Menu::size() const
   Returns children() (for back compatability with older versions of fltk).
 */
@@ -37,6 +37,7 @@
 // Compatability with fltk 1.0 and with XForms is only partial!
 
 #include <fltk/Menu.h>
+#include <fltk/MenuBuilder.h>
 #include <fltk/Item.h>
 #include <fltk/ItemGroup.h>
 #include <fltk/Divider.h>
@@ -49,12 +50,7 @@ using namespace fltk;
 ////////////////////////////////////////////////////////////////
 // Menu-style api:
 
-static Widget* append(
-  Group* g,
-  const char *label,
-  int flags,
-  int insert_here
-) {
+static Widget* new_item(const char* label, int flags) {
   Group* saved = Group::current();
   Group::current(0);
   Widget* o;
@@ -63,28 +59,44 @@ static Widget* append(
   } else {
     o = new Item();
   }
-  char buf[1024];
-  const char *p;
-  char *q;
-  for (p = label, q = buf; *p; *q++ = *p++)
-    if (*p == '\\' && p[1]) p++;
-  *q = 0;
-
-  o->copy_label(buf);
+  o->copy_label(label);
   if (flags & MENU_RADIO) o->type(Item::RADIO);
   else if (flags & MENU_TOGGLE) o->type(Item::TOGGLE);
   // Shift the old flags values over to where they are in fltk,
   // but also allow new fltk flag values (this was done so RAW_LABEL
   // could be put in there for flwm)
   o->set_flag(((flags<<8)&(INACTIVE|STATE|INVISIBLE))|(flags&~0x1ff));
+  Group::current(saved);
+  return o;
+}
+
+static void insert_item(Group* g, Widget* o, int flags, int insert_here) {
   if (insert_here) g->insert(*o, insert_here-1);
   else g->add(o);
   if (flags & MENU_DIVIDER) {
+    Group* saved = Group::current();
+    Group::current(0);
     Widget* d = new Divider();
     if (insert_here) g->insert(*d, insert_here);
     else g->add(d);
+    Group::current(saved);
   }
-  Group::current(saved);
+}
+
+static Widget* append(
+  Group* g,
+  const char *label,
+  int flags,
+  int insert_here
+) {
+  char buf[1024];
+  const char *p;
+  char *q;
+  for (p = label, q = buf; *p; *q++ = *p++)
+    if (*p == '\\' && p[1]) p++;
+  *q = 0;
+  Widget* o = new_item(buf, flags);
+  insert_item(g, o, flags, insert_here);
   return o;
 }
 
@@ -460,6 +472,153 @@ Widget* Menu::add_many(const char *str) {
   return r;
 }
 
+////////////////////////////////////////////////////////////////
+// Bulk api:
+
+/*! \class fltk::MenuBuilder
+
+  Adds a large number of items to a Menu or Browser quickly. Each
+  Menu::add() splits the label, searches the existing items for each
+  submenu name, and relayouts the menu. This instead finds submenus in
+  a hash table and takes paths that are already split, and the menu
+  is relayed out once by finish():
+
+\code
+fltk::MenuBuilder builder(browser, nsymbols);
+for (int i = 0; i < nsymbols; i++) {
+  const char* path[3] = {symbol[i].file, symbol[i].kind, symbol[i].name};
+  builder.add(path, 3, 0, symbol_cb, &symbol[i]);
+}
+builder.finish();
+\endcode
+
+  Submenus already in the menu are found too, but their labels must
+  match exactly. Unlike Menu::add(), '_' and '&' and '@' in the names
+  are not looked at specially. Nothing else should add or remove
+  submenus while a MenuBuilder is being used.
+*/
+
+static unsigned submenu_hash(const Group* parent, const char* name) {
+  unsigned h = 2166136261U ^ unsigned((unsigned long)parent >> 4);
+  for (const char* p = name; *p; p++) h = (h ^ (uchar)*p) * 16777619U;
+  return h;
+}
+
+/*! Start adding items to \a menu. Space for \a reserve more items
+  is made at the top level of it. */
+MenuBuilder::MenuBuilder(Menu* menu, int reserve) {
+  menu_ = menu;
+  tablesize_ = 64;
+  count_ = 0;
+  table_ = new Group*[tablesize_];
+  memset(table_, 0, tablesize_*sizeof(Group*));
+  if (reserve > 0) menu->reserve(menu->children()+reserve);
+  index(menu);
+}
+
+MenuBuilder::~MenuBuilder() {
+  delete[] table_;
+}
+
+// Put the submenus that are already in g into the table:
+void MenuBuilder::index(Group* g) {
+  for (int n = 0; n < g->children(); n++) {
+    Widget* w = g->child(n);
+    if (!w->is_group()) continue;
+    if (w->label()) remember((Group*)w);
+    index((Group*)w);
+  }
+}
+
+void MenuBuilder::remember(Group* g) {
+  if (2*(count_+1) > tablesize_) {
+    unsigned size = 2*tablesize_;
+    Group** table = new Group*[size];
+    memset(table, 0, size*sizeof(Group*));
+    for (unsigned i = 0; i < tablesize_; i++) {
+      if (!table_[i]) continue;
+      unsigned h = submenu_hash(table_[i]->parent(), table_[i]->label());
+      while (table[h&(size-1)]) h++;
+      table[h&(size-1)] = table_[i];
+    }
+    delete[] table_;
+    table_ = table;
+    tablesize_ = size;
+  }
+  unsigned h = submenu_hash(g->parent(), g->label());
+  while (table_[h&(tablesize_-1)]) h++;
+  table_[h&(tablesize_-1)] = g;
+  count_++;
+}
+
+/*!
+  Return the submenu of \a parent (or of the menu if it is null)
+  labelled \a name, creating it at the end if it is not there.
+  \a flags are used when it is created, and are the same as for
+  Menu::add().
+*/
+Group* MenuBuilder::submenu(Group* parent, const char* name, int flags) {
+  if (!parent) parent = menu_;
+  unsigned h = submenu_hash(parent, name);
+  for (Group* g; (g = table_[h&(tablesize_-1)]); h++)
+    if (g->parent() == parent && !strcmp(g->label(), name)) return g;
+  Group* g = (Group*)new_item(name, flags|SUBMENU);
+  insert_item(parent, g, flags, 0);
+  remember(g);
+  return g;
+}
+
+/*!
+  Add an item at the end of the submenu named by the first \a n-1
+  strings in \a path, creating them as necessary. The last string is
+  the label of the item. If it is empty (or \a n is 0) no item is made
+  and the submenu is returned. The other arguments are the same as
+  for Menu::add().
+*/
+Widget* MenuBuilder::add(const char* const* path, int n, unsigned shortcut,
+			 Callback* callback, void* data, int flags) {
+  Group* group = menu_;
+  for (int i = 0; i < n-1; i++) group = submenu(group, path[i]);
+  if (n < 1 || !*path[n-1]) return group;
+  Widget* item = new_item(path[n-1], flags);
+  insert_item(group, item, flags, 0);
+  if (flags & SUBMENU) remember((Group*)item);
+  item->shortcut(shortcut);
+  if (callback) item->callback(callback);
+  item->user_data(data);
+  return item;
+}
+
+/*!
+  Split \a label at '/' characters and add the item, the same as
+  Menu::add() does, except for the differences listed above.
+  Backslashes quote the next character, and a leading slash makes it
+  a single label.
+*/
+Widget* MenuBuilder::add(const char* label, unsigned shortcut,
+			 Callback* callback, void* data, int flags) {
+  int bufsize = strlen(label)+1;
+  ARRAY(char, buf, bufsize);
+  ARRAY(const char*, path, bufsize);
+  int n = 0;
+  char* q = buf;
+  path[n++] = q;
+  for (const char* p = label; *p; p++) {
+    if (*p == '\\' && p[1]) p++;
+    else if (*p == '/' && p > label) {*q++ = 0; path[n++] = q; continue;}
+    *q++ = *p;
+  }
+  *q = 0;
+  if (*label == '/') {n = 1; path[0] = label;}
+  return add(path, n, shortcut, callback, data, flags);
+}
+
+/*! Make the menu lay out and redraw the new items. */
+void MenuBuilder::finish() {
+  menu_->relayout();
+  menu_->redraw();
+}
+
 //
 // End of "$Id$".
 //
@@ -169,6 +169,7 @@ public:
   int drawn_selected;	// last redraw has this selected
   MWindow(MenuState*, int level, const Rectangle& R, const char* title, int rightedge);
   ~MWindow();
+  void setup(MenuState*, int level, const Rectangle& R, const char* title, int rightedge);
   int find_selected(int mx, int my);
   int titlex(int);
   int autoscroll(int);
@@ -210,6 +211,29 @@ static Box* menubox(Widget* widget) {
   return box_from_menuwindow;
 }
 
+// Measuring the shortcut of every item each time a long menu pops up
+// is slow, so the widths are remembered for each shortcut and font:
+struct HotkeyWidth {
+  unsigned hotkey;
+  Font* font;
+  float size;
+  int width;
+};
+static HotkeyWidth hotkey_widths[256];
+
+static int hotkey_width(unsigned hotkey) {
+  Font* font = getfont();
+  float size = getsize();
+  HotkeyWidth& c = hotkey_widths[(hotkey^(hotkey>>16)^((unsigned long)font>>4))&255];
+  if (c.hotkey != hotkey || c.font != font || c.size != size) {
+    c.hotkey = hotkey;
+    c.font = font;
+    c.size = size;
+    c.width = int(getwidth(key_name(hotkey)) + 8.5);
+  }
+  return c.width;
+}
+
 /*! Resize the widget to contain the menu items that are the children
     of the item indicated by indexes and level (use 0 for the immediate
     children).
@@ -254,7 +278,7 @@ void Menu::layout_in(Widget* widget, const int* indexes, int level) const {
     } else {
       unsigned hotkey = item->shortcut();
       if (hotkey) {
-	int w1 = int(getwidth(key_name(hotkey)) + 8.5);
+	int w1 = hotkey_width(hotkey);
 	if (w1 > hotKeysW) hotKeysW = w1;
       }
     }
@@ -320,8 +344,10 @@ void Menu::draw_in(Widget* widget, const int* indexes, int level,
       ir.h(item->h());
     }
 
-    // for minimal update, only draw the items that changed selection:
-    if (damage != DAMAGE_CHILD || i==selected || i==drawn_selected) {
+    // for minimal update, only draw the items that changed selection,
+    // and only the ones on the screen of a long menu:
+    if ((damage != DAMAGE_CHILD || i==selected || i==drawn_selected)
+	&& not_clipped(ir)) {
 
       Flags flags = item->flags();
       if (flags&INACTIVE) flags |= INACTIVE_R;
@@ -473,8 +499,19 @@ Rectangle Menu::get_location(Widget* widget, const int* indexes, int level,
 
 MWindow::MWindow(MenuState* m, int l, const Rectangle& rectangle,
 		 const char* t, int rightedge)
-  : MenuWindow(rectangle.x(), rectangle.y(), rectangle.w(), rectangle.h(), 0), menustate(m), level(l)
+  : MenuWindow(rectangle.x(), rectangle.y(), rectangle.w(), rectangle.h(), 0)
+{
+  setup(m, l, rectangle, t, rightedge);
+}
+
+// Lay out and position the window, this is also done to reuse one:
+void MWindow::setup(MenuState* m, int l, const Rectangle& rectangle,
+		    const char* t, int rightedge)
 {
+  menustate = m;
+  level = l;
+  resize(rectangle.x(), rectangle.y(), rectangle.w(), rectangle.h());
+  redraw();
   box_from_menuwindow = style()->box();
   style(menustate->widget->style());
   set_vertical();
@@ -553,6 +590,30 @@ MWindow::~MWindow() {
   delete title;
 }
 
+// Creating and destroying the windows of submenus is slow, so the
+// hidden ones are kept for the next submenu or popup:
+static MWindow* spare_menus[MAX_LEVELS];
+static int num_spare_menus;
+
+static MWindow* new_menu(MenuState* m, int level, const Rectangle& r,
+			 const char* title, int rightedge) {
+  if (num_spare_menus) {
+    MWindow* mw = spare_menus[--num_spare_menus];
+    mw->setup(m, level, r, title, rightedge);
+    return mw;
+  }
+  return new MWindow(m, level, r, title, rightedge);
+}
+
+static void delete_menu(MWindow* mw) {
+  if (!mw) return;
+  if (num_spare_menus >= MAX_LEVELS) {delete mw; return;}
+  mw->hide();
+  delete mw->title; mw->title = 0;
+  mw->style(MenuWindow::default_style);
+  spare_menus[num_spare_menus++] = mw;
+}
+
 void MWindow::position(int X, int Y) {
   if (title) {title->position(X, title->y()+Y-y());}
   MenuWindow::position(X, Y);
@@ -579,8 +640,13 @@ int MWindow::titlex(int index) {
 
 void MWindow::draw() {
   int selected = level <= menustate->level ? menustate->indexes[level] : -1;
+  // a long menu only draws the items that are on the screen, the others
+  // are exposed when autoscroll() moves it:
+  push_clip(Rectangle(MENUAREA.x()-x(), MENUAREA.y()-y(),
+		      MENUAREA.w(), MENUAREA.h()));
   menustate->widget->draw_in(this, menustate->indexes, level,
 			     selected, drawn_selected);
+  pop_clip();
   drawn_selected = selected;
 }
 
@@ -647,14 +713,14 @@ static bool setitem(MenuState& p, int level, int index) {
   if (level+1 < p.nummenus && p.indexes[level+1] >= 0)
     p.menus[level+1]->redraw(DAMAGE_CHILD);
 
-  delete p.fakemenu; p.fakemenu = 0; // turn off "menubar button"
+  delete_menu(p.fakemenu); p.fakemenu = 0; // turn off "menubar button"
 
   // delete all the submenus that we are no longer in:
   if (index >= 0) {
-    while (p.nummenus > level+2) delete p.menus[--p.nummenus];
+    while (p.nummenus > level+2) delete_menu(p.menus[--p.nummenus]);
     // delete the next menu only if we are pointing at a different item:
     if (p.nummenus > level+1 && p.indexes[level] != index)
-      delete p.menus[--p.nummenus];
+      delete_menu(p.menus[--p.nummenus]);
   }
 
   p.level = level;
@@ -952,7 +1018,7 @@ Widget* Menu::try_popup(const Rectangle& r, const char* title, bool menubar)
       p.level++;
       p.indexes[p.level] = item;
       p.indexes[p.level+1] = -1;
-      mw = new MWindow(&p, p.level, rectangle, 0,0);
+      mw = new_menu(&p, p.level, rectangle, 0,0);
       p.menus[p.nummenus++] = mw;
       // move all earlier menus to line up with this new one:
       int dy = mw->y()-nY;
@@ -967,6 +1033,7 @@ Widget* Menu::try_popup(const Rectangle& r, const char* title, bool menubar)
     // show all the menus:
     for (int menu = 0; menu <= p.level; menu++) {
       MWindow* mw = p.menus[menu];
+      if (menu) mw->child_of(toplevel.child_of());
       if (mw->title) mw->title->show(mw->child_of());
       mw->show();
     }
@@ -1009,7 +1076,7 @@ Widget* Menu::try_popup(const Rectangle& r, const char* title, bool menubar)
       int my = r.y();
       if (p.hmenubar) {my += r.h(); r.move_y(1); r.move_b(-1);}
       else mx += r.w();
-      mw = new MWindow(&p, 1, Rectangle(mx, my, 0, 0), 0, 0);
+      mw = new_menu(&p, 1, Rectangle(mx, my, 0, 0), 0, 0);
       *(Rectangle*)(mw->title) = r;
       mw->title->show(p.menus[0]->child_of());
       if (widget->takesevents() && p.current_children()>=0) {
@@ -1026,7 +1093,7 @@ Widget* Menu::try_popup(const Rectangle& r, const char* title, bool menubar)
       // Create a normal submenu:
       int nX = mw->x() + mw->w();
       int nY = mw->y() + mw->ypos(index) - mw->ypos(0);
-      mw = new MWindow(&p, p.nummenus, Rectangle(nX, nY, 0, 0), 0,
+      mw = new_menu(&p, p.nummenus, Rectangle(nX, nY, 0, 0), 0,
 		       p.nummenus ? p.menus[p.nummenus-1]->x() : 0);
       p.menus[p.nummenus++] = mw;
       mw->show(p.menus[0]->child_of());
@@ -1038,8 +1105,8 @@ Widget* Menu::try_popup(const Rectangle& r, const char* title, bool menubar)
   Item::clear_style();
 
   // destroy all the submenus we created:
-  delete p.fakemenu;
-  while (--p.nummenus) delete p.menus[p.nummenus];
+  delete_menu(p.fakemenu);
+  while (--p.nummenus) delete_menu(p.menus[p.nummenus]);
 
   // I believe this is here so that if you exec() a window in response
   // to a menu item the correct window is selected as the parent:
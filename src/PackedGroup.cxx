@@ -46,7 +46,9 @@ using namespace fltk;
 
   A child widget can change it's size by calling layout() on itself
   and this will rearrange all other widgets to accomodate the new
-  height.
+  height. Where every child was put is remembered, so only the ones
+  after a changed child (on the same side of the resizable()) are
+  moved, and the others are not resized or laid out again.
 
   If resizable is not set, the PackedGroup itself resizes to surround
   the items, allowing it to be imbedded in a surrounding PackedGroup
@@ -70,21 +72,85 @@ PackedGroup::PackedGroup(int x,int y,int w,int h,const char *l,bool begin)
   resizable(0);
   spacing_ = 0;
   margin(0);
+  cache_ = 0;
+}
+
+// What the last layout() did, so when a child changes size only the
+// children after it are moved:
+namespace fltk {
+struct PackedCache {
+  int n;		// children() it was made for, -1 if not made
+  int capacity;
+  Rectangle* before;	// space left before each child was placed
+  Rectangle* placed;	// where each child was put
+  uchar* saw;		// saw_horizontal|saw_vertical before each child
+  uchar* flags;		// visible and vertical of each child
+  Rectangle inside;	// the rectangle it started with
+  Rectangle rest;	// what was left for the resizable
+  uchar rest_saw;
+  Widget* resizable;
+  int resizable_index;
+  int spacing;
+  int type;
+};
+}
+
+enum {SAW_HORIZONTAL = 1, SAW_VERTICAL = 2};
+enum {WAS_VISIBLE = 1, WAS_VERTICAL = 2};
+
+static inline bool same(const Rectangle& a, const Rectangle& b) {
+  return a.x()==b.x() && a.y()==b.y() && a.w()==b.w() && a.h()==b.h();
+}
+
+PackedGroup::~PackedGroup() {
+  if (cache_) {
+    delete[] cache_->before;
+    delete[] cache_->placed;
+    delete[] cache_->saw;
+    delete[] cache_->flags;
+    delete cache_;
+  }
+}
+
+// True if the child is where the last layout() put it:
+bool PackedGroup::unchanged(int i) const {
+  const Widget* widget = child(i);
+  uchar f = (widget->visible() ? WAS_VISIBLE : 0) |
+    (is_vertical(widget) ? WAS_VERTICAL : 0);
+  return f == cache_->flags[i] && same(*widget, cache_->placed[i]);
+}
+
+void PackedGroup::placed(int i) {
+  const Widget* widget = child(i);
+  cache_->placed[i] = *widget;
+  cache_->flags[i] = (widget->visible() ? WAS_VISIBLE : 0) |
+    (is_vertical(widget) ? WAS_VERTICAL : 0);
 }
 
 void PackedGroup::layout() {
   for (int iter = 0; iter < 2; iter++) {
     if (!layout_damage()) break;
 
-    // we only need to do something special if the group is resized:
+    // we only need to do something special if the group is resized,
+    // or if laying out the children changes the size of one:
     if (!(layout_damage() & (LAYOUT_WH|LAYOUT_DAMAGE)) || !children()) {
+      layout_damage(layout_damage() & ~LAYOUT_CHILD);
       Group::layout();
-      if (!(layout_damage() & LAYOUT_CHILD)) break;
+      if (!(layout_damage() & (LAYOUT_CHILD|LAYOUT_DAMAGE)) || !children())
+	break;
     }
-    int extradamage = layout_damage()&LAYOUT_DAMAGE;
+    // LAYOUT_DAMAGE is passed to the children unless it is only on
+    // because some of them were resized:
+    int extradamage = 0;
+    if ((layout_damage() & (LAYOUT_DAMAGE|LAYOUT_CHILD_RESIZE)) == LAYOUT_DAMAGE)
+      extradamage = LAYOUT_DAMAGE;
 
-    // clear the layout flags, so any resizes of children will set them again:
+    // clear the layout flags, the resizes of children below will turn
+    // them on again but only a child changing its own size needs
+    // another pass:
     Widget::layout();
+    layout_damage(0);
+    bool again = false;
 
     // This is the rectangle to lay out the remaining widgets in:
     Rectangle r(w(),h());
@@ -96,61 +162,130 @@ void PackedGroup::layout() {
     r.set_y(r.y()+margin_top_);
     r.set_b(r.b()-margin_bottom_);
 
-    bool saw_horizontal = false;
-    bool saw_vertical = false;
+    // The previous layout can be reused up to the first child that
+    // changed if only children were resized:
+    PackedCache* c = cache_;
+    if (!c) {
+      c = cache_ = new PackedCache(); // all zero
+      c->n = -1;
+    }
+    bool reuse = !extradamage && c->n == children() &&
+      c->resizable == resizable() && c->spacing == spacing_ &&
+      c->type == type() && same(c->inside, r);
+    if (children() >= c->capacity) {
+      delete[] c->before; delete[] c->placed; delete[] c->saw; delete[] c->flags;
+      c->capacity = children()+16;
+      c->before = new Rectangle[c->capacity];
+      c->placed = new Rectangle[c->capacity];
+      c->saw = new uchar[c->capacity];
+      c->flags = new uchar[c->capacity];
+      reuse = false;
+    }
+    c->n = -1; // in case a child's layout() calls this recursively
+    c->inside = r;
+
+    uchar saw = 0;
 
     // layout all the top & left widgets (the ones before the resizable):
-    int i; for (i = 0; i < children(); i++) {
+    int i = 0;
+    if (reuse) {
+      // skip the ones that did not move, but lay out any that need it:
+      for (; i < c->resizable_index; i++) {
+	Widget* widget = child(i);
+	if (!unchanged(i)) break;
+	if (widget->visible() && widget->layout_damage()) {
+	  if (layout_child(*widget, 0)) {again = true; break;}
+	}
+      }
+      r = c->before[i];
+      saw = c->saw[i];
+    }
+    for (; i < children(); i++) {
       Widget* widget = child(i);
       if (widget->contains(resizable())) break;
-      if (!widget->visible()) continue;
+      c->before[i] = r;
+      c->saw[i] = saw;
+      if (!widget->visible()) {placed(i); continue;}
       if (is_vertical(widget)) {
 	widget->resize(r.x(), r.y(), widget->w(), r.h());
-        widget->layout_damage(widget->layout_damage()|extradamage);
-	widget->layout();
+	if (layout_child(*widget, extradamage)) again = true;
 	r.move_x(widget->w()+spacing_);
-	saw_vertical = true;
+	saw |= SAW_VERTICAL;
       } else { // put along top edge:
 	widget->resize(r.x(), r.y(), r.w(), widget->h());
-        widget->layout_damage(widget->layout_damage()|extradamage);
-	widget->layout();
+	if (layout_child(*widget, extradamage)) again = true;
 	r.move_y(widget->h()+spacing_);
-	saw_horizontal = true;
+	saw |= SAW_HORIZONTAL;
       }
+      placed(i);
     }
 
     int resizable_index = i;
+    // the bottom & right ones can be reused if the space left is the same:
+    reuse = reuse && same(r, c->before[i]) && saw == c->saw[i];
+    c->before[i] = r;
+    c->saw[i] = saw;
 
     // layout all the bottom & right widgets by going backwards:
-    for (i = children()-1; i > resizable_index; i--) {
+    i = children()-1;
+    if (reuse) {
+      for (; i > resizable_index; i--) {
+	Widget* widget = child(i);
+	if (!unchanged(i)) break;
+	if (widget->visible() && widget->layout_damage()) {
+	  if (layout_child(*widget, 0)) {again = true; break;}
+	}
+      }
+      if (i < children()-1) {
+	r = i > resizable_index ? c->before[i] : c->rest;
+	saw = i > resizable_index ? c->saw[i] : c->rest_saw;
+      }
+    }
+    for (; i > resizable_index; i--) {
       Widget* widget = child(i);
-      if (!widget->visible()) continue;
+      c->before[i] = r;
+      c->saw[i] = saw;
+      if (!widget->visible()) {placed(i); continue;}
       if (is_vertical(widget)) {
 	int W = widget->w();
 	widget->resize(r.r()-W, r.y(), W, r.h());
-        widget->layout_damage(widget->layout_damage()|extradamage);
-	widget->layout();
+	if (layout_child(*widget, extradamage)) again = true;
 	r.set_r(widget->x()-spacing_);
-	saw_vertical = true;
+	saw |= SAW_VERTICAL;
       } else { // put along top edge:
 	int H = widget->h();
 	widget->resize(r.x(), r.b()-H, r.w(), H);
-        widget->layout_damage(widget->layout_damage()|extradamage);
-	widget->layout();
+	if (layout_child(*widget, extradamage)) again = true;
 	r.set_b(widget->y()-spacing_);
-	saw_horizontal = true;
+	saw |= SAW_HORIZONTAL;
       }
+      placed(i);
     }
+    reuse = reuse && same(r, c->rest) && saw == c->rest_saw;
+    c->rest = r;
+    c->rest_saw = saw;
 
     // Lay out the resizable widget to fill the remaining space:
     if (resizable_index < children()) {
       Widget* widget = child(resizable_index);
-      widget->resize(r.x(), r.y(), r.w(), r.h());
-      widget->layout_damage(widget->layout_damage()|extradamage);
-      widget->layout();
+      if (!reuse || !unchanged(resizable_index) || widget->layout_damage()) {
+	widget->resize(r.x(), r.y(), r.w(), r.h());
+	if (layout_child(*widget, extradamage)) again = true;
+      }
+      placed(resizable_index);
     }
 
+    c->n = children();
+    c->resizable = resizable();
+    c->resizable_index = resizable_index;
+    c->spacing = spacing_;
+    c->type = type();
+
+    layout_damage(again ? LAYOUT_DAMAGE|LAYOUT_CHILD_RESIZE : 0);
+
     // A non-resizable widget will become the size of its items:
+    bool saw_horizontal = (saw & SAW_HORIZONTAL) != 0;
+    bool saw_vertical = (saw & SAW_VERTICAL) != 0;
     int W = w();
     if (r.w()<0 || !(resizable() || saw_horizontal)) {
       W -= r.w()+(saw_vertical?spacing_:0);
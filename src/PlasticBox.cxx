@@ -45,6 +45,97 @@ public:
     : FrameBox(n, 2,2,4,4, s, d) {}
 };
 
+// The shading is worked out first as runs of rows across the box, for
+// the first pixel, the middle, and the last pixel of each row. This
+// does the overlapping fillrect() calls the shading is described by,
+// but then draws each pixel only once, with one fillrects() for all
+// of them, so each shade is set and sent to the system only once
+// rather than for every row.
+
+namespace {
+
+enum {FIRST = 1, MIDDLE = 2, LAST = 4};
+enum {MAXOPS = 6*13+3, MAXCUTS = 2*MAXOPS};
+
+struct ShadeOp {int a, b; uchar mask, c;};
+
+struct Shading {
+  ShadeOp op[MAXOPS];
+  int n;
+  Shading() : n(0) {}
+  // rows a through b-1 of the parts in mask are shade c:
+  void add(int a, int b, int mask, int c) {
+    if (a < b && mask && n < MAXOPS) {
+      op[n].a = a; op[n].b = b; op[n].mask = mask; op[n].c = uchar(c); n++;
+    }
+  }
+  void draw(bool horizontal, const Rectangle& r, Color bc) const;
+};
+
+}
+
+void Shading::draw(bool horizontal, const Rectangle& r, Color bc) const {
+  // Boundaries of every run, sorted:
+  int cut[MAXCUTS]; int ncut = 0;
+  int i, j;
+  for (i = 0; i < n; i++) {
+    cut[ncut++] = op[i].a;
+    cut[ncut++] = op[i].b;
+  }
+  for (i = 1; i < ncut; i++) {
+    int v = cut[i];
+    for (j = i; j > 0 && cut[j-1] > v; j--) cut[j] = cut[j-1];
+    cut[j] = v;
+  }
+  for (i = j = 0; i < ncut; i++) if (!j || cut[i] != cut[j-1]) cut[j++] = cut[i];
+  ncut = j;
+
+  // The last shade done to each interval between them, 0 if none:
+  uchar shade[3][MAXCUTS];
+  memset(shade, 0, sizeof(shade));
+  for (i = 0; i < n; i++) {
+    const ShadeOp& o = op[i];
+    int a = 0, b = ncut;
+    while (a < b) {int m = (a+b)/2; if (cut[m] < o.a) a = m+1; else b = m;}
+    for (; cut[a] < o.b; a++) for (int k = 0; k < 3; k++)
+      if (o.mask & (1<<k)) shade[k][a] = o.c;
+  }
+
+  // Join neighboring intervals of the same shade into rectangles:
+  const int across = horizontal ? r.w() : r.h();
+  Rectangle rects[3*MAXCUTS];
+  uchar rshade[3*MAXCUTS];
+  int nrects = 0;
+  for (int k = 0; k < 3; k++) {
+    int p, s;
+    if (k == 0) {p = 0; s = 1;}
+    else if (k == 1) {p = 1; s = across-2;}
+    else {p = across-1; s = 1;}
+    if (s <= 0) continue;
+    for (i = 0; i < ncut-1;) {
+      uchar c = shade[k][i];
+      for (j = i+1; j < ncut-1 && shade[k][j] == c; j++);
+      if (c) {
+	// insert it sorted by shade, so each is drawn with one setcolor():
+	int m = nrects++;
+	for (; m > 0 && rshade[m-1] > c; m--) {
+	  rects[m] = rects[m-1]; rshade[m] = rshade[m-1];
+	}
+	if (horizontal) rects[m].set(r.x()+p, r.y()+cut[i], s, cut[j]-cut[i]);
+	else rects[m].set(r.x()+cut[i], r.y()+p, cut[j]-cut[i], s);
+	rshade[m] = c;
+      }
+      i = j;
+    }
+  }
+
+  Color colors[3*MAXCUTS];
+  for (i = 0; i < nrects; i++)
+    colors[i] = (i && rshade[i] == rshade[i-1]) ? colors[i-1]
+      : shade_color(rshade[i], bc);
+  fillrects(nrects, rects, colors);
+}
+
 void PlasticBox::_draw(const Rectangle& r) const
 {
   if (drawflags(PUSHED|STATE) && down_) {
@@ -56,83 +147,61 @@ void PlasticBox::_draw(const Rectangle& r) const
     fl_to_inactive(c, buf); c = buf;}
 
   const Color bc = getbgcolor();
-  const Color fg = getcolor();
 
   int		i, j;
   int		clen = strlen(c) - 1;
   int		chalf = clen / 2;
   int		cstep = 1;
 
-  const int x = r.x();
-  const int y = r.y();
   const int w = r.w();
   const int h = r.h();
+  Shading s;
 
   if (h < (w * 2)) {
     // Horizontal shading...
     if (clen >= h) cstep = 2;
+    // the rows are one pixel wide, the last pixel then is the first:
+    const int line = w > 1 ? MIDDLE|LAST : 0;
+    const int last = w > 1 ? LAST : FIRST;
 
     for (i = 0, j = 0; j < chalf; i ++, j += cstep) {
       // Draw the top line and points...
-      setcolor(shade_color(c[i], bc));
-      fillrect(x+1, y+i, w-1, 1);
-
-      setcolor(shade_color(c[i] - 2, bc));
-      fillrect(x, y+i, 1, 1);
-      fillrect(x+w-1, y+i+1, 1, 1);
+      s.add(i, i+1, line, c[i]);
+      s.add(i, i+1, FIRST, c[i] - 2);
+      s.add(i+1, i+2, last, c[i] - 2);
 
       // Draw the bottom line and points...
-      setcolor(shade_color(c[clen - i], bc));
-      fillrect(x+1, y+h-1-i, w-1, 1);
-
-      setcolor(shade_color(c[clen - i] - 2, bc));
-      fillrect(x, y+h-i-1, 1, 1);
-      fillrect(x+w-1, y+h-i-1, 1, 1);
+      s.add(h-1-i, h-i, line, c[clen - i]);
+      s.add(h-1-i, h-i, FIRST|last, c[clen - i] - 2);
     }
 
     // Draw the interior and sides...
     i = chalf / cstep;
-
-    setcolor(shade_color(c[chalf], bc));
-    fillrect(x + 1, y + i, w - 2, h - 2 * i);
-
-    setcolor(shade_color(c[chalf] - 2, bc));
-    fillrect(x, y+i, 1, h-2*i);
-    fillrect(x+w-1, y+i, 1, h-2*i);
+    s.add(i, h-i, MIDDLE, c[chalf]);
+    s.add(i, h-i, FIRST|last, c[chalf] - 2);
 
   } else {
     // Vertical shading...
     if (clen >= w) cstep = 2;
+    const int line = h > 1 ? MIDDLE|LAST : 0;
+    const int last = h > 1 ? LAST : FIRST;
 
     for (i = 0, j = 0; j < chalf; i ++, j += cstep) {
       // Draw the left line and points...
-      setcolor(shade_color(c[i], bc));
-      fillrect(x+i, y+1, 1, h-1);
-
-      setcolor(shade_color(c[i] - 2, bc));
-      fillrect(x+i, y, 1, 1);
-      fillrect(x+i, y+h-1, 1, 1);
+      s.add(i, i+1, line, c[i]);
+      s.add(i, i+1, FIRST|last, c[i] - 2);
 
       // Draw the right line and points...
-      setcolor(shade_color(c[clen - i], bc));
-      fillrect(x+w-1-i, y+1, 1, h-1);
-
-      setcolor(shade_color(c[clen - i] - 2, bc));
-      fillrect(x+w-1-i, y, 1, 1);
-      fillrect(x+w-1-i, y+h-1, 1, 1);
+      s.add(w-1-i, w-i, line, c[clen - i]);
+      s.add(w-1-i, w-i, FIRST|last, c[clen - i] - 2);
     }
 
     // Draw the interior, top, and bottom...
     i = chalf / cstep;
-
-    setcolor(shade_color(c[chalf], bc));
-    fillrect(x + i, y + 1, w - 2 * i, h - 2);
-
-    setcolor(shade_color(c[chalf - 2], bc));
-    fillrect(x+i, y, w-2*i, 1);
-    fillrect(x+i, y+h-1, w-2*i, 1);
+    s.add(i, w-i, MIDDLE, c[chalf]);
+    s.add(i, w-i, FIRST|last, c[chalf - 2]);
   }
-  setcolor(fg);
+  s.draw(h < (w * 2), r, bc);
 }
 
 static PlasticBox plasticDownBox(0, "STUVWWWVT");
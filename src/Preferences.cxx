@@ -34,6 +34,9 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#if HAVE_PTHREAD
+#  include <fltk/Threads.h>
+#endif
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 #  include <windows.h>
@@ -49,6 +52,9 @@
 #else
 #  include <unistd.h>
 #endif
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#  include <fcntl.h>
+#endif
 
 using namespace fltk;
 
@@ -61,11 +67,18 @@ class Preferences::Node // a node contains a list to all its entries
   Node *child_, *next_, *parent_;
   char *path_;
   bool dirty_;
+  const char *text_, *textEnd_; // lines from the file that are not parsed yet
+  bool binary_;                 // text_ is records from a binary file
+  void parseBinary();
+  int *hash_, nHash_;           // entry index+1 for each hash slot, or 0
+  void addHash( int ix );
+  void makeHash();
 public:
   Node( const char *path );
   ~Node();
   // node methods
   int write( FILE *f );
+  int writeBinary( FILE *f );
   Node *find( const char *path );
   Node *search( const char *path, int offset=0 );
   Node *addChild( const char *path );
@@ -82,10 +95,18 @@ public:
   const char *get( const char *name );
   int getEntry( const char *name );
   bool deleteEntry( const char *name );
+  void setText( const char *text, const char *end, bool binary=false );
+  void parse();
+  unsigned long memory( unsigned long &nodes );
   // public values
   Entry *entry;
   int nEntry, NEntry;
   static int lastEntrySet;
+  // the root of every open preferences file:
+  static Node **roots;
+  static int nRoots, NRoots;
+  void addRoot();
+  void removeRoot();
 };
 
 class Preferences::RootNode  // the root node manages file paths and basic reading and writing
@@ -93,13 +114,21 @@ class Preferences::RootNode  // the root node manages file paths and basic readi
   Preferences *prefs_;
   char *filename_;
   char *vendor_, *application_;
+  char *data_;     // the file, which the nodes parse when they are used
+  char *pending_;  // written file waiting to be renamed over filename_
+  bool writing_;   // a ThreadPool task is renaming pending_
+  int serial_;
+  int readBinary( const char *p, const char *e );
 public:
+  Format format_;  // how write() stores the file
+  bool reformat_;  // format_ was changed, so write even if not dirty
   RootNode( Preferences *, Root root, const char *vendor, const char *application );
   RootNode( Preferences *, const char *path, const char *vendor, const char *application );
   ~RootNode();
   int read();
   int write();
   bool getPath( char *path, int pathlen );
+  static void write_task( void *arg );
 };
 
 /**
@@ -116,6 +145,7 @@ Preferences::Preferences( Root root, const char *vendor, const char *application
 {
   node = new Node( "." );
   rootNode = new RootNode( this, root, vendor, application );
+  node->addRoot();
 }
 
 
@@ -128,6 +158,7 @@ Preferences::Preferences( const char *path, const char *vendor, const char *appl
 {
   node = new Node( "." );
   rootNode = new RootNode( this, path, vendor, application );
+  node->addRoot();
 }
 
 
@@ -219,6 +250,7 @@ bool Preferences::deleteGroup( const char *key )
  */
 int Preferences::entries()
 {
+  node->parse();
   return node->nEntry;
 }
 
@@ -231,6 +263,7 @@ int Preferences::entries()
  */
 const char *Preferences::entry( int ix )
 {
+  node->parse();
   return node->entry[ix].name;
 }
 
@@ -558,13 +591,43 @@ bool Preferences::getUserdataPath( char *path, int pathlen )
  * write all preferences to disk
  * - this function works only with the base preference group
  * - this function is rarely used as deleting the base preferences flushes automatically
+ * - a new file is written and renamed over the old one, so the old one is
+ *   never left half written. Where there are threads the rename (and the
+ *   wait for the disk) is done by another thread, so this can return first.
+ *   Deleting the base preferences waits for it.
  */
 void Preferences::flush()
 {
-  if ( rootNode && node->dirty() )
+  if ( rootNode && ( node->dirty() || rootNode->reformat_ ) )
     rootNode->write();
 }
 
+/**
+ * choose how the preferences file is stored the next time it is written
+ * - TEXT is the readable format the file has always had
+ * - BINARY stores length-prefixed records, and binary data (as set by
+ *   set(entry, data, size)) as bytes instead of hex. It is about half the
+ *   size for binary data and is read without scanning for line ends, and
+ *   groups that are never used are skipped without being parsed.
+ * - files in either format are read, so this converts a file:
+ * example: Preferences p( USER, "fltk.org", "test" ); p.format( Preferences::BINARY ); p.flush();
+ */
+void Preferences::format( Format f )
+{
+  if ( rootNode->format_ == f ) return;
+  rootNode->format_ = f;
+  rootNode->reformat_ = true;
+}
+
+/**
+ * return the format the preferences file will be written in, which is the
+ * format it was read in unless format(Format) was called
+ */
+Preferences::Format Preferences::format()
+{
+  return rootNode->format_;
+}
+
 //-----------------------------------------------------------------------------
 /** \class Preferences::Name
   Helper class to create group and entry names on the fly. Use an instance
@@ -737,6 +800,12 @@ Preferences::RootNode::RootNode( Preferences *prefs, Root root, const char *vend
   filename_    = newstring(filename);
   vendor_      = newstring(vendor);
   application_ = newstring(application);
+  data_        = 0;
+  pending_     = 0;
+  writing_     = false;
+  serial_      = 0;
+  format_      = TEXT;
+  reformat_    = false;
 
   read();
 }
@@ -753,75 +822,242 @@ Preferences::RootNode::RootNode( Preferences *prefs, const char *path, const cha
   filename_    = newstring(filename);
   vendor_      = newstring(vendor);
   application_ = newstring(application);
+  data_        = 0;
+  pending_     = 0;
+  writing_     = false;
+  serial_      = 0;
+  format_      = TEXT;
+  reformat_    = false;
 
   read();
 }
 
+#if HAVE_PTHREAD
+static SignalMutex write_lock; // protects pending_ and writing_
+#endif
+
+// tell the disk to keep the newly written file, then rename it over the old one
+static int commitFile( const char *tmp, const char *filename )
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  if ( !MoveFileEx( tmp, filename, MOVEFILE_REPLACE_EXISTING ) ) {
+    remove( tmp );
+    return 1;
+  }
+#else
+  int fd = open( tmp, O_RDWR );
+  if ( fd >= 0 ) {
+    fsync( fd );
+    close( fd );
+  }
+  if ( rename( tmp, filename ) ) {
+    remove( tmp );
+    return 1;
+  }
+#endif
+  return 0;
+}
+
+// rename the files that write() leaves in pending_, until there are none
+void Preferences::RootNode::write_task( void *arg )
+{
+#if HAVE_PTHREAD
+  RootNode *rn = (RootNode*)arg;
+  for (;;) {
+    write_lock.lock();
+    char *tmp = rn->pending_;
+    rn->pending_ = 0;
+    if ( !tmp ) {
+      rn->writing_ = false;
+      write_lock.signal();
+      write_lock.unlock();
+      break;
+    }
+    write_lock.unlock();
+    commitFile( tmp, rn->filename_ );
+    delete[] tmp;
+  }
+#endif
+}
+
 // destroy the root node and all depending nodes
 Preferences::RootNode::~RootNode()
 {
   if ( prefs_->node->dirty() )
     write();
+#if HAVE_PTHREAD
+  write_lock.lock();
+  while ( writing_ ) write_lock.wait();
+  write_lock.unlock();
+#endif
   delete[] filename_;
   delete[] vendor_;
   delete[] application_;
+  prefs_->node->removeRoot();
   delete prefs_->node;
+  delete[] data_;
+}
+
+// The binary format is binaryMagic, the vendor and the application, then
+// each group's path, number of entries, and size of the entries that
+// follow. Each entry is a type byte, the name, and the value. Strings
+// are a 4 byte little-endian length followed by the bytes.
+static const char binaryMagic[] = "FLTKprf\001";
+enum { TEXT_ENTRY = 0, HEX_ENTRY, ANNOTATION_ENTRY };
+
+static void putNumber( FILE *f, unsigned n )
+{
+  unsigned char b[4] = { (unsigned char)n, (unsigned char)(n>>8),
+			 (unsigned char)(n>>16), (unsigned char)(n>>24) };
+  fwrite( b, 4, 1, f );
+}
+
+static void putString( FILE *f, const char *s, unsigned n )
+{
+  putNumber( f, n );
+  fwrite( s, n, 1, f );
 }
 
-// read a preferences file and construct the group tree and with all entry leafs
+static bool getNumber( const char *&p, const char *e, unsigned &n )
+{
+  if ( e-p < 4 ) return false;
+  const unsigned char *b = (const unsigned char*)p;
+  n = b[0] | (b[1]<<8) | (b[2]<<16) | ((unsigned)b[3]<<24);
+  p += 4;
+  return true;
+}
+
+static bool getString( const char *&p, const char *e, const char *&s, unsigned &n )
+{
+  if ( !getNumber( p, e, n ) || n > (unsigned)(e-p) ) return false;
+  s = p;
+  p += n;
+  return true;
+}
+
+// true if the value looks like what set(entry, data, size) makes, so
+// the binary format can store the bytes instead
+static bool isHex( const char *v )
+{
+  int n = 0;
+  for ( ; v[n]; n++ )
+    if ( !( ( v[n]>='0' && v[n]<='9' ) || ( v[n]>='a' && v[n]<='f' ) ) ) return false;
+  return n >= 16 && !( n & 1 );
+}
+
+// find the groups in a binary file, leaving their entries to be parsed
+int Preferences::RootNode::readBinary( const char *p, const char *e )
+{
+  const char *s;
+  unsigned n, nEntries, size;
+  if ( !getString( p, e, s, n ) || !getString( p, e, s, n ) ) return 0;
+  while ( getString( p, e, s, n ) && getNumber( p, e, nEntries ) &&
+	  getNumber( p, e, size ) && size <= (unsigned)(e-p) )
+  {
+    char buf[1024];
+    if ( n > sizeof(buf)-1 ) n = sizeof(buf)-1;
+    memcpy( buf, s, n );
+    buf[ n ] = 0;
+    prefs_->node->find( buf )->setText( p, p+size, true );
+    p += size;
+  }
+  return 0;
+}
+
+// find the start of the line after p
+static const char *nextLine( const char *p, const char *e )
+{
+  while ( p < e && *p != '\n' && *p != '\r' ) p++;
+  while ( p < e && ( *p == '\n' || *p == '\r' ) ) p++;
+  return p;
+}
+
+// read a preferences file and construct the group tree
+// - the entries of each group are left in data_ and parsed when they are used
 int Preferences::RootNode::read()
 {
-  char buf[1024];
   FILE *f = fopen( filename_, "rb" );
   if ( !f ) return 0;
-  if(fgets( buf, 1024, f ));
-  if(fgets( buf, 1024, f ));
-  if(fgets( buf, 1024, f )); //ignore these return values from fgets()
+  fseek( f, 0, SEEK_END );
+  long size = ftell( f );
+  rewind( f );
+  if ( size < 0 ) size = 0;
+  delete[] data_;
+  data_ = new char[ size+1 ];
+  size = fread( data_, 1, size, f );
+  data_[ size ] = 0;
+  fclose( f );
+  if ( size >= 8 && !memcmp( data_, binaryMagic, 8 ) ) {
+    format_ = BINARY;
+    return readBinary( data_+8, data_+size );
+  }
+  const char *p = data_, *e = data_+size;
+  for ( int i = 0; i < 3; i++ ) p = nextLine( p, e ); // skip the header
   Node *nd = prefs_->node;
-  for (;;)
+  const char *start = p;
+  while ( p < e )
   {
-    if ( !fgets( buf, 1024, f ) ) break;	// EOF or Error
-    if ( buf[0]=='[' ) // read a new group
+    if ( p[0]=='[' ) // read a new group
     {
-      int end = strcspn( buf+1, "]\n\r" );
-      buf[ end+1 ] = 0;
-      nd = prefs_->node->find( buf+1 );
-    }
-    else if ( buf[0]=='+' ) // 
-    { // value of previous name/value pair spans multiple lines
-      int end = strcspn( buf+1, "\n\r" );
-      if ( end != 0 ) // if entry is not empty
-      {
-	buf[ end+1 ] = 0;
-	nd->add( buf+1 );
-      }
-    }
-    else // read a name/value pair
-    {
-      int end = strcspn( buf, "\n\r" );
-      if ( end != 0 ) // if entry is not empty
-      {
-	buf[ end ] = 0;
-	nd->set( buf );
-      }
+      nd->setText( start, p );
+      char buf[1024];
+      int end = strcspn( p+1, "]\n\r" );
+      if ( end > (int)sizeof(buf)-1 ) end = sizeof(buf)-1;
+      memcpy( buf, p+1, end );
+      buf[ end ] = 0;
+      nd = prefs_->node->find( buf );
+      p = start = nextLine( p, e );
     }
+    else
+      p = nextLine( p, e );
   }
-  fclose( f );
+  nd->setText( start, e );
   return 0;
 }
 
 // write the group tree and all entry leafs
+// - the file is written under another name, and renamed over the old one
+//   by commitFile(), in another thread if possible
 int Preferences::RootNode::write()
 {
+  char tmp[ PATH_MAX+32 ];
   makePathForFile(filename_);
-  FILE *f = fopen( filename_, "wb" );
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  snprintf( tmp, sizeof(tmp), "%s.%lu.%d.tmp", filename_, GetCurrentProcessId(), ++serial_ );
+#else
+  snprintf( tmp, sizeof(tmp), "%s.%ld.%d.tmp", filename_, (long)getpid(), ++serial_ );
+#endif
+  FILE *f = fopen( tmp, "wb" );
   if ( !f ) return 1;
-  fprintf( f, "; FLTK preferences file format 1.0\n" );
-  fprintf( f, "; vendor: %s\n", vendor_ );
-  fprintf( f, "; application: %s\n", application_ );
-  prefs_->node->write( f );
-  fclose( f );
+  if ( format_ == BINARY ) {
+    fwrite( binaryMagic, 8, 1, f );
+    putString( f, vendor_, strlen( vendor_ ) );
+    putString( f, application_, strlen( application_ ) );
+    prefs_->node->writeBinary( f );
+  } else {
+    fprintf( f, "; FLTK preferences file format 1.0\n" );
+    fprintf( f, "; vendor: %s\n", vendor_ );
+    fprintf( f, "; application: %s\n", application_ );
+    prefs_->node->write( f );
+  }
+  if ( ferror( f ) | fclose( f ) ) {
+    remove( tmp );
+    return 1;
+  }
+  reformat_ = false;
+#if HAVE_PTHREAD
+  write_lock.lock();
+  if ( pending_ ) { remove( pending_ ); delete[] pending_; } // never renamed, a newer one is here
+  pending_ = newstring( tmp );
+  bool start = !writing_;
+  writing_ = true;
+  write_lock.unlock();
+  // this is done right here if the pool can't start a thread:
+  if ( start ) ThreadPool::shared()->add( write_task, this, ThreadPool::LOW );
   return 0;
+#else
+  return commitFile( tmp, filename_ );
+#endif
 }
 
 // get the path to the preferences directory
@@ -848,6 +1084,62 @@ Preferences::Node::Node( const char *path )
   entry = 0;
   nEntry = NEntry = 0;
   dirty_ = 0;
+  text_ = textEnd_ = 0;
+  binary_ = false;
+  hash_ = 0; nHash_ = 0;
+}
+
+Preferences::Node **Preferences::Node::roots;
+int Preferences::Node::nRoots, Preferences::Node::NRoots;
+
+void Preferences::Node::addRoot()
+{
+  if ( nRoots == NRoots )
+  {
+    NRoots = NRoots ? NRoots*2 : 4;
+    Node **newarray = new Node*[NRoots];
+    if ( nRoots ) memcpy( newarray, roots, nRoots*sizeof(Node*) );
+    delete[] roots;
+    roots = newarray;
+  }
+  roots[ nRoots++ ] = this;
+}
+
+void Preferences::Node::removeRoot()
+{
+  for ( int i = 0; i < nRoots; i++ )
+    if ( roots[i] == this ) { roots[i] = roots[--nRoots]; break; }
+}
+
+// bytes used by this and all depending nodes, counting them in nodes
+unsigned long Preferences::Node::memory( unsigned long &nodes )
+{
+  unsigned long n = sizeof( Node ) + strlen( path_ ) + 1;
+  nodes++;
+  n += NEntry*sizeof( Entry ) + nHash_*sizeof( int );
+  for ( int i = 0; i < nEntry; i++ )
+  {
+    n += strlen( entry[i].name ) + 1;
+    if ( entry[i].value ) n += strlen( entry[i].value ) + 1;
+  }
+  if ( text_ ) n += textEnd_ - text_; // still held in the file's data
+  for ( Node *nd = child_; nd; nd = nd->next_ )
+    n += nd->memory( nodes );
+  return n;
+}
+
+/**
+ * return about how many bytes all the open preferences files use,
+ * and set *groups to how many groups they have. This is for finding
+ * leaks in programs that run for a long time.
+ */
+unsigned long Preferences::total_mem_used( unsigned long *groups )
+{
+  unsigned long nodes = 0, n = 0;
+  for ( int i = 0; i < Node::nRoots; i++ )
+    n += Node::roots[i]->memory( nodes );
+  if ( groups ) *groups = nodes;
+  return n;
 }
 
 // delete this and all depending nodes
@@ -868,6 +1160,7 @@ Preferences::Node::~Node()
     }
     delete[] entry;
   }
+  delete[] hash_;
   delete[] path_;
 }
 
@@ -886,6 +1179,7 @@ bool Preferences::Node::dirty()
 int Preferences::Node::write( FILE *f )
 {
   if ( next_ ) next_->write( f );
+  parse();
   fprintf( f, "\n[%s]\n\n", path_ );
   for ( int i = 0; i < nEntry; i++ )
   {
@@ -917,6 +1211,46 @@ int Preferences::Node::write( FILE *f )
   return 0;
 }
 
+// write this node and the ones after it like write(), in the binary format
+int Preferences::Node::writeBinary( FILE *f )
+{
+  if ( next_ ) next_->writeBinary( f );
+  parse();
+  unsigned size = 0;
+  int i;
+  for ( i = 0; i < nEntry; i++ )
+  {
+    const char *v = entry[i].value;
+    size += 5 + strlen( entry[i].name );
+    if ( v ) size += 4 + ( isHex( v ) ? strlen( v )/2 : strlen( v ) );
+  }
+  putString( f, path_, strlen( path_ ) );
+  putNumber( f, nEntry );
+  putNumber( f, size );
+  for ( i = 0; i < nEntry; i++ )
+  {
+    const char *v = entry[i].value;
+    if ( !v ) {
+      fputc( ANNOTATION_ENTRY, f );
+      putString( f, entry[i].name, strlen( entry[i].name ) );
+    } else if ( isHex( v ) ) {
+      int n;
+      char *data = decodeHex( v, n );
+      fputc( HEX_ENTRY, f );
+      putString( f, entry[i].name, strlen( entry[i].name ) );
+      putString( f, data, n );
+      delete[] data;
+    } else {
+      fputc( TEXT_ENTRY, f );
+      putString( f, entry[i].name, strlen( entry[i].name ) );
+      putString( f, v, strlen( v ) );
+    }
+  }
+  if ( child_ ) child_->writeBinary( f );
+  dirty_ = 0;
+  return 0;
+}
+
 // set the parent node and create the full path
 void Preferences::Node::setParent( Node *pn )
 {
@@ -944,32 +1278,32 @@ Preferences::Node *Preferences::Node::addChild( const char *path )
 // create and set, or change an entry within this node
 void Preferences::Node::set( const char *name, const char *value )
 {
-  for ( int i=0; i<nEntry; i++ )
+  int i = getEntry( name );
+  if ( i >= 0 )
   {
-    if ( strcmp( name, entry[i].name ) == 0 )
+    if ( !value ) return; // annotation
+    if ( strcmp( value, entry[i].value ) != 0 )
     {
-      if ( !value ) return; // annotation
-      if ( strcmp( value, entry[i].value ) != 0 )
-      {
-	delete[] entry[i].value;
-	entry[i].value = newstring( value );
-	dirty_ = 1;
-      }
-      lastEntrySet = i;
-      return;
+      delete[] entry[i].value;
+      entry[i].value = newstring( value );
+      dirty_ = 1;
     }
+    lastEntrySet = i;
+    return;
   }
   if ( NEntry==nEntry )
   {
     NEntry = NEntry ? NEntry*2 : 10;
     Entry* newarray = new Entry[NEntry];
     if (entry) memcpy(newarray, entry, nEntry*sizeof(Entry));
+    delete[] entry;
     entry = newarray;
   }
   entry[ nEntry ].name = newstring( name );
   entry[ nEntry ].value = newstring( value );
   lastEntrySet = nEntry;
   nEntry++;
+  if ( hash_ ) addHash( nEntry-1 );
   dirty_ = 1;
 }
 
@@ -1019,9 +1353,49 @@ const char *Preferences::Node::get( const char *name )
   return i>=0 ? entry[i].value : 0 ;
 }
 
+static unsigned hashName( const char *name )
+{
+  unsigned h = 2166136261U;
+  for ( ; *name; name++ ) h = ( h ^ (unsigned char)*name ) * 16777619U;
+  return h;
+}
+
+// put an entry into the hash table, making it bigger if it gets half full
+void Preferences::Node::addHash( int ix )
+{
+  if ( 2*nEntry > nHash_ ) { makeHash(); return; }
+  unsigned h = hashName( entry[ix].name );
+  while ( hash_[ h & (nHash_-1) ] ) h++;
+  hash_[ h & (nHash_-1) ] = ix+1;
+}
+
+// make the hash table for all the entries
+void Preferences::Node::makeHash()
+{
+  int n = 16;
+  while ( n < 4*nEntry ) n *= 2;
+  delete[] hash_;
+  hash_ = new int[ n ];
+  nHash_ = n;
+  memset( hash_, 0, n*sizeof(int) );
+  for ( int i = 0; i < nEntry; i++ ) addHash( i );
+}
+
 // find the index of an entry, returns -1 if no such entry
+// - groups with many entries use a hash table
 int Preferences::Node::getEntry( const char *name )
 {
+  parse();
+  if ( !hash_ && nEntry >= 8 ) makeHash();
+  if ( hash_ )
+  {
+    for ( unsigned h = hashName( name ); ; h++ )
+    {
+      int ix = hash_[ h & (nHash_-1) ];
+      if ( !ix ) return -1;
+      if ( strcmp( name, entry[ix-1].name ) == 0 ) return ix-1;
+    }
+  }
   for ( int i=0; i<nEntry; i++ )
   {
     if ( strcmp( name, entry[i].name ) == 0 )
@@ -1037,12 +1411,93 @@ bool Preferences::Node::deleteEntry( const char *name )
 {
   int ix = getEntry( name );
   if ( ix == -1 ) return false;
+  delete[] entry[ix].name;
+  delete[] entry[ix].value;
   memmove( entry+ix, entry+ix+1, (nEntry-ix-1) * sizeof(Entry) );
   nEntry--;
+  delete[] hash_; hash_ = 0; nHash_ = 0; // the indexes moved
   dirty_ = 1;
   return true;
 }
 
+// remember lines from the file to be parsed when the entries are used
+void Preferences::Node::setText( const char *text, const char *end, bool binary )
+{
+  if ( text >= end ) return;
+  parse(); // the group was in the file twice
+  text_ = text;
+  textEnd_ = end;
+  binary_ = binary;
+}
+
+// parse the lines from the file given to setText()
+void Preferences::Node::parse()
+{
+  if ( !text_ ) return;
+  if ( binary_ ) { parseBinary(); return; }
+  const char *p = text_, *e = textEnd_;
+  text_ = textEnd_ = 0;
+  bool dirt = dirty_; // reading the file is not a change
+  char buf[1024];
+  while ( p < e )
+  {
+    const char *eol = p;
+    while ( eol < e && *eol != '\n' && *eol != '\r' ) eol++;
+    int len = eol-p;
+    char *line = len < (int)sizeof(buf) ? buf : new char[ len+1 ];
+    memcpy( line, p, len );
+    line[ len ] = 0;
+    if ( line[0]=='+' )
+    { // value of previous name/value pair spans multiple lines
+      if ( len > 1 ) add( line+1 );
+    }
+    else if ( len ) // read a name/value pair
+      set( line );
+    if ( line != buf ) delete[] line;
+    while ( eol < e && ( *eol == '\n' || *eol == '\r' ) ) eol++;
+    p = eol;
+  }
+  dirty_ = dirt;
+}
+
+// parse the records from a binary file given to setText()
+void Preferences::Node::parseBinary()
+{
+  const char *p = text_, *e = textEnd_;
+  text_ = textEnd_ = 0;
+  bool dirt = dirty_;
+  while ( p < e )
+  {
+    int type = (unsigned char)*p++;
+    const char *s, *v = 0;
+    unsigned n, nv = 0;
+    if ( !getString( p, e, s, n ) ) break;
+    if ( type != ANNOTATION_ENTRY && !getString( p, e, v, nv ) ) break;
+    char *name = new char[ n+1 ];
+    memcpy( name, s, n );
+    name[ n ] = 0;
+    char *value = 0;
+    if ( type == HEX_ENTRY ) {
+      static const char lu[] = "0123456789abcdef";
+      value = new char[ 2*nv+1 ];
+      for ( unsigned i = 0; i < nv; i++ ) {
+	unsigned char c = v[i];
+	value[2*i] = lu[c>>4];
+	value[2*i+1] = lu[c&15];
+      }
+      value[ 2*nv ] = 0;
+    } else if ( type == TEXT_ENTRY ) {
+      value = new char[ nv+1 ];
+      memcpy( value, v, nv );
+      value[ nv ] = 0;
+    }
+    set( name, value );
+    delete[] name;
+    delete[] value;
+  }
+  dirty_ = dirt;
+}
+
 // find a group somewhere in the tree starting here
 // - this method will always return a valid node (except for memory allocation problems)
 // - if the node was not found, 'find' will create the required branch
@@ -0,0 +1,425 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+/*! \class fltk::TileSource
+
+  Supplies the pixels of a PyramidImage in square tiles. Level 0 is
+  the full size image, each level after that is half the width and
+  height of the one before it (rounded up), and the last one fits
+  in a single tile. Tile \a column, \a row of a level covers the
+  pixels starting at column*tile_size(), row*tile_size() of that
+  level, and is smaller than tile_size() at the right and bottom
+  edges.
+
+  Subclasses read tiles from a tiled TIFF, a directory of jpeg files,
+  a tile server, or whatever else, by implementing read_tile().
+*/
+
+/*! \class fltk::PyramidImage
+
+  Draws an image that may be much too large to fit in memory, such as
+  a gigapixel scan or a map, by only getting the tiles of it from a
+  TileSource that are visible, and only at the resolution needed for
+  the current transformation. Zooming out uses the coarser levels, so
+  the number of pixels drawn stays about the size of the window.
+
+  Tiles are read by ThreadPool::shared() while drawing continues.
+  Until a tile arrives the part of a coarser one that covers it is
+  drawn, scaled up, and the tile's area is redrawn when it is ready.
+  The coarsest level is always kept, so after the first tile arrives
+  something is always drawn. Tiles next to the visible ones are read
+  at a lower priority, so panning finds them ready, and tiles that
+  are no longer visible are taken off the queue.
+
+  Each tile is an Image, so once drawn it is also kept by the
+  display. The least recently drawn ones are thrown away when the
+  memory used goes over cache_size().
+
+  The TileSource is not deleted by the PyramidImage, and must exist
+  until after it is deleted.
+*/
+
+#include <fltk/PyramidImage.h>
+#include <fltk/Image.h>
+#include <fltk/Window.h>
+#include <fltk/Threads.h>
+#include <fltk/draw.h>
+#include <math.h>
+#include <string.h>
+using namespace fltk;
+
+/*! Describe an image \a w by \a h pixels, read in tiles \a tile_size
+  pixels square (rounded up to an even number) of \a pixeltype. */
+TileSource::TileSource(int w, int h, int tile_size, PixelType pixeltype)
+  : w_(w), h_(h), pixeltype_(pixeltype)
+{
+  if (tile_size < 2) tile_size = 2;
+  tile_size_ = (tile_size+1)&-2;
+  levels_ = 1;
+  while (level_w(levels_-1) > tile_size_ || level_h(levels_-1) > tile_size_)
+    levels_++;
+}
+
+/*! \fn bool TileSource::read_tile(int level, int column, int row, uchar* pixels, int linedelta)
+
+  Store the pixels of a tile, \a linedelta bytes per row, and return
+  true, or return false if it can't. This is called by several
+  threads at once, without the fltk lock.
+
+  The default version makes tiles of levels after 0 by reading the
+  four tiles they cover from the level before and averaging 2x2
+  pixels. So a subclass only has to supply level 0, and calls this
+  for any levels its file does not have. This reads all of level 0
+  to make the coarsest tiles, so files that have smaller versions
+  stored should supply those too.
+*/
+bool TileSource::read_tile(int level, int column, int row,
+			   uchar* pixels, int linedelta)
+{
+  if (level <= 0) return false;
+  const int T = tile_size_;
+  const int half = T/2;
+  const int d = depth(pixeltype_);
+  uchar* child = new uchar[T*T*d];
+  bool ok = true;
+  for (int k = 0; k < 4 && ok; k++) {
+    int c = 2*column+(k&1);
+    int r = 2*row+(k>>1);
+    if (c >= columns(level-1) || r >= rows(level-1)) continue;
+    int cw = level_w(level-1)-c*T; if (cw > T) cw = T;
+    int ch = level_h(level-1)-r*T; if (ch > T) ch = T;
+    if (!read_tile(level-1, c, r, child, T*d)) {ok = false; break;}
+    for (int y = 0; y < (ch+1)/2; y++) {
+      const uchar* a = child+2*y*T*d;
+      const uchar* b = 2*y+1 < ch ? a+T*d : a; // odd height repeats the row
+      uchar* o = pixels+((k>>1)*half+y)*linedelta+(k&1)*half*d;
+      for (int x = 0; x < (cw+1)/2; x++) {
+	int n = 2*x+1 < cw ? d : 0;
+	for (int i = 0; i < d; i++)
+	  o[i] = uchar((a[i]+a[n+i]+b[i]+b[n+i]+2)>>2);
+	a += 2*d; b += 2*d; o += d;
+      }
+    }
+  }
+  delete[] child;
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////
+
+struct fltk::PyramidTile {
+  PyramidImage* owner;	// null once the PyramidImage is deleted
+  TileSource* source;
+  int level, column, row;
+  int w, h;
+  enum {QUEUED, READY, FAILED} state;
+  uchar* pixels;	// made by read_tile() in a pool thread
+  Image* image;		// made from pixels by tile_done()
+  unsigned long bytes;
+  ThreadPool::TaskId task;
+  unsigned long wanted;	// drawn_ when it was last needed
+  PyramidTile* hash_next;
+  PyramidTile* prev;	// more recently used
+  PyramidTile* next;
+};
+
+enum {TABLE_SIZE = 1024};
+
+static unsigned hash_tile(int level, int column, int row) {
+  return (unsigned(column)*73856093U ^ unsigned(row)*19349663U ^
+	  unsigned(level)*83492791U) & (TABLE_SIZE-1);
+}
+
+// Set while drawing so tiles done right away don't redraw the window:
+static bool in_draw;
+
+/*! The \a source is not copied and must exist until this is deleted. */
+PyramidImage::PyramidImage(TileSource* source, const char* name)
+  : Symbol(name), source_(source), first_(0), last_(0),
+    cache_size_(64*1024*1024), mem_used_(0), drawn_(0), window_(0)
+{
+  table_ = new PyramidTile*[TABLE_SIZE];
+  memset(table_, 0, TABLE_SIZE*sizeof(PyramidTile*));
+}
+
+/*! Waits for any tiles being read and frees them all. */
+PyramidImage::~PyramidImage() {
+  ThreadPool* pool = ThreadPool::shared();
+  while (first_) {
+    PyramidTile* t = first_;
+    if (t->state == PyramidTile::QUEUED && !pool->remove(t->task)) {
+      // started, so tile_done() will be called, and will delete it:
+      unlink(t);
+      t->owner = 0;
+      pool->wait(t->task); // it uses source_
+      continue;
+    }
+    free_tile(t);
+  }
+  delete[] table_;
+}
+
+/*! Set how many bytes of tiles are kept. The tiles being drawn and
+  the coarsest level are kept even if they use more. The default is
+  64 megabytes. */
+void PyramidImage::cache_size(unsigned long bytes) {
+  cache_size_ = bytes;
+  check_mem_usage();
+}
+
+/*! \fn unsigned long PyramidImage::mem_used() const
+  Bytes used by the tiles that have been read. */
+
+PyramidTile* PyramidImage::find(int level, int column, int row) const {
+  for (PyramidTile* t = table_[hash_tile(level, column, row)]; t; t = t->hash_next)
+    if (t->level == level && t->column == column && t->row == row) return t;
+  return 0;
+}
+
+// Remove it from the list, but not the table:
+void PyramidImage::unlink(PyramidTile* t) {
+  if (t->prev) t->prev->next = t->next; else first_ = t->next;
+  if (t->next) t->next->prev = t->prev; else last_ = t->prev;
+}
+
+// Mark it as the most recently used:
+void PyramidImage::touch(PyramidTile* t) {
+  if (first_ == t) return;
+  unlink(t);
+  t->prev = 0;
+  t->next = first_;
+  if (first_) first_->prev = t; else last_ = t;
+  first_ = t;
+}
+
+void PyramidImage::free_tile(PyramidTile* t) {
+  PyramidTile** p = &table_[hash_tile(t->level, t->column, t->row)];
+  for (; *p; p = &((*p)->hash_next))
+    if (*p == t) {*p = t->hash_next; break;}
+  unlink(t);
+  if (t->image) mem_used_ -= t->bytes;
+  delete t->image;
+  delete[] t->pixels;
+  delete t;
+}
+
+void PyramidImage::check_mem_usage() {
+  PyramidTile* t = last_;
+  while (t && mem_used_ > cache_size_) {
+    PyramidTile* prev = t->prev;
+    if (t->state == PyramidTile::READY && t->wanted != drawn_ &&
+	t->level < source_->levels()-1)
+      free_tile(t);
+    t = prev;
+  }
+}
+
+// Find the tile, or start reading it:
+PyramidTile* PyramidImage::request(int level, int column, int row, int priority) {
+  PyramidTile* t = find(level, column, row);
+  if (!t) {
+    t = new PyramidTile;
+    t->owner = this;
+    t->source = source_;
+    t->level = level;
+    t->column = column;
+    t->row = row;
+    const int T = source_->tile_size();
+    t->w = source_->level_w(level)-column*T; if (t->w > T) t->w = T;
+    t->h = source_->level_h(level)-row*T; if (t->h > T) t->h = T;
+    t->state = PyramidTile::QUEUED;
+    t->pixels = 0;
+    t->image = 0;
+    t->bytes = 0;
+    t->task = 0;
+    unsigned h = hash_tile(level, column, row);
+    t->hash_next = table_[h];
+    table_[h] = t;
+    t->prev = 0;
+    t->next = first_;
+    if (first_) first_->prev = t; else last_ = t;
+    first_ = t;
+    t->wanted = drawn_;
+    // this may call tile_done() right away if there are no threads:
+    ThreadPool::TaskId task = ThreadPool::shared()->add
+      (read_tile, t, ThreadPool::Priority(priority), tile_done);
+    if (t->state == PyramidTile::QUEUED) t->task = task;
+    return t;
+  }
+  t->wanted = drawn_;
+  touch(t);
+  return t;
+}
+
+// Called by a pool thread:
+void PyramidImage::read_tile(void* v) {
+  PyramidTile* t = (PyramidTile*)v;
+  int d = depth(t->source->pixeltype());
+  t->pixels = new uchar[t->w*t->h*d];
+  if (!t->source->read_tile(t->level, t->column, t->row, t->pixels, t->w*d)) {
+    delete[] t->pixels;
+    t->pixels = 0;
+  }
+}
+
+// Where the tile is drawn, inside the rectangle the whole image is
+// drawn in. Neighbors share edges so there are no gaps between them:
+static Rectangle place(const Rectangle& r, const TileSource* s,
+		       int level, int column, int row)
+{
+  double T = double(s->tile_size())*(1<<level);
+  double x0 = column*T; double x1 = x0+T; if (x1 > s->w()) x1 = s->w();
+  double y0 = row*T; double y1 = y0+T; if (y1 > s->h()) y1 = s->h();
+  double sx = double(r.w())/s->w();
+  double sy = double(r.h())/s->h();
+  int X = r.x()+int(floor(x0*sx+.5));
+  int Y = r.y()+int(floor(y0*sy+.5));
+  return Rectangle(X, Y, r.x()+int(floor(x1*sx+.5))-X,
+		   r.y()+int(floor(y1*sy+.5))-Y);
+}
+
+// Called by the main thread when read_tile() is done:
+void PyramidImage::tile_done(void* v) {
+  PyramidTile* t = (PyramidTile*)v;
+  PyramidImage* p = t->owner;
+  if (!p) {delete[] t->pixels; delete t; return;}
+  t->task = 0;
+  if (!t->pixels) {t->state = PyramidTile::FAILED; return;}
+  PixelType type = p->source_->pixeltype();
+  t->image = new Image(type, t->w, t->h);
+  t->image->setpixels(t->pixels, Rectangle(t->w, t->h));
+  delete[] t->pixels;
+  t->pixels = 0;
+  t->state = PyramidTile::READY;
+  t->bytes = (unsigned long)t->w*t->h*depth(type);
+  p->mem_used_ += t->bytes;
+  p->check_mem_usage();
+  if (in_draw || !p->window_) return;
+  Rectangle r(place(p->area_, p->source_, t->level, t->column, t->row));
+  r.inset(-1); // rounding of the scaling
+  // make sure the window was not destroyed:
+  for (Window* w = Window::first(); w; w = w->next())
+    if (w == p->window_) {w->redraw(r); break;}
+}
+
+// Draw the tile, or the part of a coarser one that covers it:
+void PyramidImage::draw_tile(const Rectangle& r, int level, int column, int row) {
+  PyramidTile* t = request(level, column, row, ThreadPool::HIGH);
+  Rectangle to(place(r, source_, level, column, row));
+  if (t->state == PyramidTile::READY) {
+    t->image->draw(Rectangle(t->w, t->h), to);
+    return;
+  }
+  const int T = source_->tile_size();
+  for (int l = level+1; l < source_->levels(); l++) {
+    int d = l-level;
+    PyramidTile* c = find(l, column>>d, row>>d);
+    if (!c || c->state != PyramidTile::READY) continue;
+    c->wanted = drawn_;
+    touch(c);
+    Rectangle from(((column&((1<<d)-1))*T)>>d, ((row&((1<<d)-1))*T)>>d,
+		   (t->w+(1<<d)-1)>>d, (t->h+(1<<d)-1)>>d);
+    c->image->draw(from, to);
+    return;
+  }
+}
+
+/*! Returns the size of level 0 of the TileSource. */
+void PyramidImage::_measure(int& w, int& h) const {
+  if (!source_) return;
+  w = source_->w();
+  h = source_->h();
+}
+
+/*! Draws the image scaled to fill \a r, using the coarsest level that
+  has at least one pixel for every pixel on the screen. */
+void PyramidImage::_draw(const Rectangle& r) const {
+  PyramidImage* p = const_cast<PyramidImage*>(this);
+  const TileSource* s = source_;
+  if (!s || s->w() <= 0 || s->h() <= 0) return;
+  Rectangle R; transform(r, R);
+  if (R.empty()) return;
+  Rectangle V(R);
+  if (!intersect_with_clip(V)) return;
+  p->drawn_++;
+  p->window_ = Window::drawing_window();
+  p->area_ = R;
+
+  double fx = double(s->w())/R.w();
+  double fy = double(s->h())/R.h();
+  double scale = fx < fy ? fx : fy;
+  const int top = s->levels()-1;
+  int level = 0;
+  while (level < top && (2<<level) <= scale) level++;
+
+  // visible tiles of that level:
+  const int T = s->tile_size();
+  int x0 = int((V.x()-R.x())*fx);
+  int x1 = int(ceil((V.r()-R.x())*fx)); if (x1 > s->w()) x1 = s->w();
+  int y0 = int((V.y()-R.y())*fy);
+  int y1 = int(ceil((V.b()-R.y())*fy)); if (y1 > s->h()) y1 = s->h();
+  if (x1 <= x0 || y1 <= y0) return;
+  int c0 = (x0>>level)/T, c1 = ((x1-1)>>level)/T;
+  int r0 = (y0>>level)/T, r1 = ((y1-1)>>level)/T;
+
+  in_draw = true;
+  push_clip(r);
+  // the coarsest tile is always wanted, it is drawn while others load:
+  p->request(top, 0, 0, ThreadPool::HIGH);
+  for (int row = r0; row <= r1; row++)
+    for (int column = c0; column <= c1; column++)
+      p->draw_tile(r, level, column, row);
+  pop_clip();
+  // read the ones just outside the visible ones for panning, and
+  // the coarser level for zooming out:
+  const int columns = s->columns(level);
+  const int rows = s->rows(level);
+  for (int row = r0-1; row <= r1+1; row++) {
+    if (row < 0 || row >= rows) continue;
+    for (int column = c0-1; column <= c1+1; column++) {
+      if (column < 0 || column >= columns) continue;
+      if (row >= r0 && row <= r1 && column >= c0 && column <= c1) continue;
+      p->request(level, column, row, ThreadPool::LOW);
+    }
+  }
+  if (level < top)
+    for (int row = r0/2; row <= r1/2; row++)
+      for (int column = c0/2; column <= c1/2; column++)
+	p->request(level+1, column, row, ThreadPool::LOW);
+  in_draw = false;
+
+  // forget about tiles not needed any more, so the pool does not spend
+  // time on places that were scrolled past:
+  ThreadPool* pool = ThreadPool::shared();
+  for (PyramidTile* t = p->first_; t;) {
+    PyramidTile* next = t->next;
+    if (t->state == PyramidTile::QUEUED && t->wanted != drawn_ &&
+	pool->remove(t->task))
+      p->free_tile(t);
+    t = next;
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,117 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+#include <fltk/ScrollAnimator.h>
+#include <fltk/run.h>
+#include <math.h>
+
+using namespace fltk;
+
+/*! \class fltk::ScrollAnimator
+
+  Moves a scrolling position smoothly to a target, once per frame of
+  the frame clock (see add_frame_callback()), instead of jumping
+  there. Scrollbar uses one for MOUSEWHEEL events, so ScrollGroup,
+  Browser, TextDisplay, and anything else scrolled by a Scrollbar
+  scroll smoothly. A custom widget can use one to do the same:
+
+\code
+static void move_cb(double y, void* v) {((MyWidget*)v)->scroll_to(int(y));}
+MyWidget::MyWidget(...) : animator(move_cb, this) {...}
+...
+case MOUSEWHEEL:
+  animator.scroll(yposition(), animator.target(yposition()) +
+		  event_dy()*style()->wheel_scroll_lines()*line_height);
+  return 1;
+\endcode
+
+  Each wheel event adds to the target, so fast wheel motion or a
+  touchpad sending many small deltas accumulates and is drawn at most
+  once per frame. The position is worked out from the time elapsed,
+  so the speed does not depend on how often frames are drawn.
+*/
+
+/*! The position moves most of the way to the target in about this
+  many seconds. The default is .1. If this is zero scroll() calls the
+  MoveHandler at once with the target. */
+float ScrollAnimator::duration_ = .1f;
+
+/*! The \a MoveHandler is called with the new position and \a arg each
+  frame while scrolling. */
+ScrollAnimator::ScrollAnimator(MoveHandler f, void* arg)
+  : move_(f), arg_(arg), active_(false), position_(0), target_(0), time_(0) {}
+
+ScrollAnimator::~ScrollAnimator() {stop();}
+
+/*!
+  Start moving to \a to. \a from is the current position, it is
+  ignored if this is already moving, so that a scroll in progress
+  continues smoothly. The caller must limit \a to to the range that
+  can be scrolled.
+*/
+void ScrollAnimator::scroll(double from, double to) {
+  if (duration_ <= 0) {
+    stop();
+    if (to != from) move_(to, arg_);
+    return;
+  }
+  if (!active_) {
+    if (to == from) return;
+    position_ = from;
+    time_ = get_time_secs();
+    active_ = true;
+    add_frame_callback(frame_cb, this);
+  }
+  target_ = to;
+}
+
+/*! Stop moving, leaving the position where it is. */
+void ScrollAnimator::stop() {
+  if (!active_) return;
+  active_ = false;
+  remove_frame_callback(frame_cb, this);
+}
+
+void ScrollAnimator::frame_cb(void* v) {((ScrollAnimator*)v)->step();}
+
+// Move a fraction of the remaining distance, which depends on how long
+// it was since the last frame, and stop when less than half a pixel
+// is left:
+void ScrollAnimator::step() {
+  double t = get_time_secs();
+  double dt = t-time_; time_ = t;
+  double left = (target_-position_)*exp(-3*dt/duration_);
+  if (fabs(left) < .5) {
+    position_ = target_;
+    active_ = false;
+  } else {
+    position_ = target_-left;
+    add_frame_callback(frame_cb, this);
+  }
+  move_(position_, arg_);
+}
+
+//
+// End of "$Id$".
+//
@@ -74,6 +74,13 @@ It is very useful to put a single PackedGroup child into a VERTICAL ScrollGroup.
 Also note that scrollbar_align() (a Style parameter) can put the
 scrollbars on different sides of the widget.
 
+For a very large area with many positioned children turn on
+spatial_index(). Then scrolling only calls layout() on the children
+that come into view, rather than on all of them, and only the newly
+exposed strip is drawn. The other children still have their x() and
+y() changed, and are laid out when they are next visible or the
+ScrollGroup is resized.
+
 Currently you cannot use Window or any subclass (including GlWindow)
 as a child of this.  The clipping is not conveyed to the operating
 system's window and it will draw over the scrollbars and neighboring
@@ -93,9 +100,9 @@ void ScrollGroup::draw_clip(void* v, const Rectangle& r) {
   setcolor(s->color()); fillrect(r);
 #endif
   // draw all the children, clipping them out of the region:
-  int numchildren = s->children(); int i;
-  for (i = numchildren; i--;) {
-    Widget& w = *s->child(i);
+  int n; const int* list = s->children_in(r, n); int k;
+  for (k = n; k--;) {
+    Widget& w = *s->child(list ? list[k] : k);
     // Partial-clipped children with their own damage will still need
     // to be redrawn before the scroll is finished drawing.  Don't clear
     // their damage in this case:
@@ -105,13 +112,16 @@ void ScrollGroup::draw_clip(void* v, const Rectangle& r) {
 	  w.r() > r.r() || w.b() > r.b())
 	save = w.damage();
     }
+    // skip the children outside the region without calling draw_child():
+    if (w.x() < r.r() && w.r() > r.x() && w.y() < r.b() && w.b() > r.y()) {
 #if USE_CLIPOUT
-    fl_did_clipping = 0;
-    s->draw_child(w);
-    if (fl_did_clipping != &w) clipout(w);
+      fl_did_clipping = 0;
+      s->draw_child(w);
+      if (fl_did_clipping != &w) clipout(w);
 #else
-    s->draw_child(w);
+      s->draw_child(w);
 #endif
+    }
     w.set_damage(save);
   }
 #if USE_CLIPOUT
@@ -119,8 +129,8 @@ void ScrollGroup::draw_clip(void* v, const Rectangle& r) {
   setcolor(s->color()); fillrect(r);
 #endif
   // draw the outside labels:
-  for (i = numchildren; i--;)
-    s->draw_outside_label(*s->child(i));
+  for (k = n; k--;)
+    s->draw_outside_label(*s->child(list ? list[k] : k));
   pop_clip();
 }
 
@@ -216,7 +226,7 @@ void ScrollGroup::layout() {
     for (int i=0; i < numchildren; i++) {
       Widget* o = child(i);
       o->position(o->x()+dx, o->y()+dy);
-      o->layout();
+      layout_child(*o);
       if (o->x() < l) l = o->x();
       if (o->y() < t) t = o->y();
       if (o->x()+o->w() > r) r = o->x()+o->w();
@@ -250,7 +260,7 @@ void ScrollGroup::layout() {
       for (int i=0; i < numchildren; i++) {
 	Widget* o = child(i);
 	o->position(o->x()+newDx, o->y()+newDy);
-	o->layout();
+	layout_child(*o);
       }
     }
 
@@ -327,6 +337,21 @@ void ScrollGroup::scrollTo(int X, int Y) {
   if (!dx && !dy) return;
   xposition_ = X;
   yposition_ = Y;
+  // With a spatial_index(), scrolling inside the area found by the last
+  // layout() does not need to look at all the children:
+  if (spatial_index() && !layout_damage() &&
+      X >= 0 && X <= max_x_scroll_ && Y >= 0 && Y <= max_y_scroll_) {
+    scroll_children(dx, dy);
+    scrolldx += dx;
+    scrolldy += dy;
+    Rectangle R; bbox(R);
+    int n; const int* list = children_in(R, n);
+    for (int k = 0; k < n; k++) layout_child(*child(list ? list[k] : k));
+    scrollbar.value(Y, R.h(), 0, max_y_scroll_+R.h());
+    hscrollbar.value(X, R.w(), 0, max_x_scroll_+R.w());
+    redraw(DAMAGE_SCROLL);
+    return;
+  }
   layoutdx += dx;
   layoutdy += dy;
   relayout();
@@ -363,6 +388,7 @@ ScrollGroup::ScrollGroup(int X,int Y,int W,int H,const char* L,bool begin)
   xposition_ = 0;
   yposition_ = 0;
   scrolldx = scrolldy = layoutdx = layoutdy = 0;
+  max_x_scroll_ = max_y_scroll_ = 0;
   hscrollbar.parent(this);
   hscrollbar.callback(hscrollbar_cb);
   scrollbar.set_vertical();
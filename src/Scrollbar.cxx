@@ -51,6 +51,9 @@ using namespace fltk;
   such as the browser will just send keystrokes to the scrollbar
   directly to get it to move in response.
 
+  The mouse wheel moves by style()->wheel_scroll_lines() times
+  linesize(), smoothly over ScrollAnimator::duration() seconds.
+
 */
 
 #define vertical() (!horizontal())
@@ -172,6 +175,7 @@ int Scrollbar::handle(int event) {
     redraw_highlight();
     return 1;
   case PUSH:
+    wheel_scroll_.stop();
     // Clicking on the slider or middle or right click on the trough
     // gives us normal slider behavior:
     if (which_part == SLIDER ||
@@ -225,10 +229,17 @@ int Scrollbar::handle(int event) {
     double n = (vertical() ? event_dy() : event_dx())
       * style()->wheel_scroll_lines() * linesize();
     if (fabs(n) > pagesize()) n = (n<0)?-pagesize():pagesize();
-    handle_drag(value()+n);
+    // add to where a scroll in progress is going, and move there
+    // smoothly:
+    double v = wheel_scroll_.target(value())+n;
+    double a = minimum(), b = maximum();
+    if (a > b) {a = b; b = minimum();}
+    if (v < a) v = a; else if (v > b) v = b;
+    wheel_scroll_.scroll(value(), v);
     return 1;
   }
   case KEY:
+    wheel_scroll_.stop();
     if (vertical()) switch(event_key()) {
     case HomeKey: handle_drag(maximum()); return 1;
     case EndKey:  handle_drag(minimum()); return 1;
@@ -307,8 +318,12 @@ static void revert(Style* s) {
 static NamedStyle style("Scrollbar", revert, &Scrollbar::default_style);
 NamedStyle* Scrollbar::default_style = &::style;
 
+void Scrollbar::wheel_cb(double p, void* v) {
+  ((Scrollbar*)v)->handle_drag(floor(p+.5));
+}
+
 Scrollbar::Scrollbar(int X, int Y, int W, int H, const char* L)
-  : Slider(X, Y, W, H, L)
+  : Slider(X, Y, W, H, L), wheel_scroll_(wheel_cb, this)
 {
   style(default_style);
   step(1);
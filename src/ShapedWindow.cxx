@@ -49,15 +49,12 @@ calling void Window::border(bool set).
 #include <config.h>
 #include <fltk/ShapedWindow.h>
 #include <fltk/x.h>
+#include <string.h>
 
 #if USE_X11
 # define Window XWindow
 # include <X11/extensions/shape.h>
 # undef Window
-#elif defined(_WIN32)
-static HRGN bitmap2region(fltk::xbmImage*);
-#elif defined(__APPLE__)
-// Not yet implemented for Apple
 #endif
 
 using namespace fltk;
@@ -69,33 +66,202 @@ window. A pointer to the image is stored, so it must remain in existence
 until shape() is called again or the ShapedWindow is destroyed.
 
 If you want your window to resize you should subclass and make a
-layout() method that draws a new image and calls shape().
+layout() method that draws a new image and calls shape(). The last few
+shapes are remembered, so going back to one of them, or calling shape()
+again with the same bits, does not need the mask to be scanned again.
 
 */
 
+// The mask is turned into rectangles, one band of rows at a time, with
+// rows that are the same as the one above added to the band above it.
+// This is the YXBanded order X wants, and what Windows regions use.
+// The last few masks are kept, found by their size and a hash of the
+// bits, and the one the window has now is not given to it again:
+namespace fltk {
+struct ShapeCache {
+  enum {SIZE = 4};
+  struct Entry {
+    int w, h;
+    unsigned long long hash;
+    Rectangle* rects;
+    int n;
+  } entries[SIZE];
+  int next;
+  int current; // the entry the window has, or -1
+  const void* id; // the system window it was given to
+  ShapeCache() : next(0), current(-1), id(0) {
+    for (int i = 0; i < SIZE; i++) {entries[i].rects = 0; entries[i].w = -1;}
+  }
+  ~ShapeCache() {for (int i = 0; i < SIZE; i++) delete[] entries[i].rects;}
+};
+}
+
+static unsigned long long hash_bits(const uchar* p, int n) {
+  unsigned long long h = 14695981039346656037ULL;
+  for (; n >= 8; n -= 8, p += 8) {
+    unsigned long long word; memcpy(&word, p, 8);
+    h = (h^word)*1099511628211ULL;
+  }
+  for (; n > 0; n--, p++) h = (h^*p)*1099511628211ULL;
+  return h;
+}
+
+// Put the starts and ends of the runs of set bits in a row into runs,
+// returning how many numbers that is. Whole words and then whole bytes
+// that do not change the state are skipped without looking at the bits:
+static int scan_row(const uchar* row, int width, int* runs) {
+  int n = 0;
+  bool in = false;
+  int x = 0;
+  while (x < width) {
+    int i = x>>3;
+    if (!(x&7)) {
+      unsigned int all = in ? ~0u : 0u;
+      for (; x+32 <= width; x += 32, i += 4) {
+	unsigned int word; memcpy(&word, row+i, 4);
+	if (word != all) break;
+      }
+      for (; x+8 <= width && row[i] == uchar(all); x += 8) i++;
+      if (x >= width) break;
+    }
+    if (bool((row[i]>>(x&7))&1) != in) {runs[n++] = x; in = !in;}
+    x++;
+  }
+  if (in) runs[n++] = width;
+  return n;
+}
+
+static void make_rects(const xbmImage* bitmap, Rectangle*& rects, int& nrects) {
+  const int W = bitmap->width();
+  const int H = bitmap->height();
+  const int bpl = (W+7)/8; // number of bytes per line of pixels
+  int* runs = new int[2*(W/2+1)];
+  int* last = new int[2*(W/2+1)];
+  int nlast = -1; // no band above
+  int band = 0; // where the band above starts in rects
+  int size = 64;
+  rects = new Rectangle[size];
+  nrects = 0;
+  const uchar* row = bitmap->array;
+  for (int y = 0; y < H; y++, row += bpl) {
+    int n = scan_row(row, W, runs);
+    if (n == nlast && !memcmp(runs, last, n*sizeof(int))) {
+      // same as the row above, make that band taller:
+      for (int i = band; i < nrects; i++) rects[i].h(rects[i].h()+1);
+      continue;
+    }
+    band = nrects;
+    if (nrects+n/2 > size) {
+      while (nrects+n/2 > size) size *= 2;
+      Rectangle* r = new Rectangle[size];
+      for (int i = 0; i < nrects; i++) r[i] = rects[i];
+      delete[] rects;
+      rects = r;
+    }
+    for (int i = 0; i < n; i += 2)
+      rects[nrects++].set(runs[i], y, runs[i+1]-runs[i], 1);
+    int* t = last; last = runs; runs = t;
+    nlast = n;
+  }
+  delete[] runs;
+  delete[] last;
+}
+
+// Return the rectangles for the mask, or null if the window already
+// has this shape:
+static ShapeCache::Entry* find_shape(ShapeCache* cache, const xbmImage* mask) {
+  int W = mask->width();
+  int H = mask->height();
+  unsigned long long hash = hash_bits(mask->array, (W+7)/8*H);
+  for (int i = 0; i < ShapeCache::SIZE; i++) {
+    ShapeCache::Entry& e = cache->entries[i];
+    if (e.w != W || e.h != H || e.hash != hash) continue;
+    if (i == cache->current) return 0;
+    cache->current = i;
+    return &e;
+  }
+  int i = cache->next;
+  cache->next = (i+1)%ShapeCache::SIZE;
+  ShapeCache::Entry& e = cache->entries[i];
+  delete[] e.rects;
+  make_rects(mask, e.rects, e.n);
+  e.w = W;
+  e.h = H;
+  e.hash = hash;
+  cache->current = i;
+  return &e;
+}
+
 // maybe one day we'll want to be able to resize the clip mask
 // when the window resized
 static xbmImage* resize_bitmap(xbmImage*, int, int);
 
+ShapedWindow::~ShapedWindow() {
+  delete cache_;
+}
+
 void ShapedWindow::draw() {
   if ((lw != w() || lh != h() || changed) && shape_) {
     // size of window has change since last time
     lw = w(); lh = h();
     xbmImage* mask = resize_bitmap(shape_, w(), h());
+    if (!cache_) cache_ = new ShapeCache;
+    // a new system window does not have the shape the cache thinks it has:
+    const void* id = (const void*)(size_t)xid(this);
+    if (id != cache_->id) {cache_->id = id; cache_->current = -1;}
+    ShapeCache::Entry* e = find_shape(cache_, mask);
 #if USE_X11
-    Pixmap pmask = XCreateBitmapFromData(xdisplay, xid(this),
-					 (const char*)mask->array,
-					 mask->width(), mask->height());
-    hide();
-    XShapeCombineMask(xdisplay, xid(this), ShapeBounding, 0, 0,
-                      pmask, ShapeSet);
-    show();
-    if (pmask != None) XFreePixmap(xdisplay, pmask);
+    if (e) {
+      XRectangle* r = new XRectangle[e->n ? e->n : 1];
+      for (int i = 0; i < e->n; i++) {
+	r[i].x = short(e->rects[i].x());
+	r[i].y = short(e->rects[i].y());
+	r[i].width = (unsigned short)(e->rects[i].w());
+	r[i].height = (unsigned short)(e->rects[i].h());
+      }
+      XShapeCombineRectangles(xdisplay, xid(this), ShapeBounding, 0, 0,
+			      r, e->n, ShapeSet, YXBanded);
+      delete[] r;
+    }
 #elif defined(_WIN32)
-    HRGN region = bitmap2region(mask);
-    SetWindowRgn(xid(this), region, TRUE);
+    if (e) {
+      // take into account the border+caption x and y offsets of the Window
+      POINT pt = {GetSystemMetrics(SM_CXBORDER)+GetSystemMetrics(SM_CXEDGE),
+		  GetSystemMetrics(SM_CYBORDER)+GetSystemMetrics(SM_CXEDGE)+GetSystemMetrics(SM_CYCAPTION)};
+      // On Windows98, ExtCreateRegion() may fail if the number of
+      // rectangles is too large (ie: > 4000). Therefore, we have to
+      // create the region by multiple steps:
+      enum {CHUNK = 2000};
+      RGNDATA* data = (RGNDATA*)new char[sizeof(RGNDATAHEADER)+CHUNK*sizeof(RECT)];
+      RECT* pr = (RECT*)&data->Buffer;
+      HRGN region = 0;
+      int i = 0;
+      do {
+	int n = e->n-i; if (n > CHUNK) n = CHUNK;
+	data->rdh.dwSize = sizeof(RGNDATAHEADER);
+	data->rdh.iType = RDH_RECTANGLES;
+	data->rdh.nCount = n;
+	data->rdh.nRgnSize = 0;
+	SetRect(&data->rdh.rcBound, MAXLONG, MAXLONG, 0, 0);
+	for (int j = 0; j < n; j++, i++) {
+	  const Rectangle& r = e->rects[i];
+	  SetRect(&pr[j], r.x()+pt.x, r.y()+pt.y, r.r()+pt.x, r.b()+pt.y);
+	  if (pr[j].left < data->rdh.rcBound.left) data->rdh.rcBound.left = pr[j].left;
+	  if (pr[j].top < data->rdh.rcBound.top) data->rdh.rcBound.top = pr[j].top;
+	  if (pr[j].right > data->rdh.rcBound.right) data->rdh.rcBound.right = pr[j].right;
+	  if (pr[j].bottom > data->rdh.rcBound.bottom) data->rdh.rcBound.bottom = pr[j].bottom;
+	}
+	HRGN h = ExtCreateRegion(NULL, sizeof(RGNDATAHEADER)+n*sizeof(RECT), data);
+	if (region) {
+	  CombineRgn(region, region, h, RGN_OR);
+	  DeleteObject(h);
+	} else region = h;
+      } while (i < e->n);
+      delete[] (char*)data;
+      SetWindowRgn(xid(this), region, TRUE);
+    }
 #elif defined(__APPLE__)
-	mask = 0; // hopefully will shut up compiler
+    e = 0; // hopefully will shut up compiler
     // not yet implemented for Apple
 #else
 #endif
@@ -110,115 +276,6 @@ static xbmImage* resize_bitmap(xbmImage* bitmap, int /*W*/, int /*H*/) {
   return bitmap; // CET - FIXME - someday...
 }
 
-#ifdef _WIN32
-#include <malloc.h>
-static inline BYTE bit(int x) { return (BYTE)(1 << (x % 8)); }
-
-// Windows uses regions only to specify the clip mask of a window therefore
-// we must convert our bitmap to a region.
-// Much of this code is "borrowed" from the Windows version of GTK
-// (also LGPLed).  Their code was based on code originally written by
-// Jean-Edouard Lachand-Robert.  Ain't open source great?
-//
-// Modified by me to use an xbmImage, to not hog memory, to not leak memory
-// (I hope) and to allow bitmaps of arbitrary dimensions. -CET
-static HRGN bitmap2region(xbmImage* bitmap) {
-  HRGN hRgn = 0;
-  /* For better performances, we will use the ExtCreateRegion()
-   * function to create the region. This function take a RGNDATA
-   * structure on entry. We will add rectangles by amount of
-   * ALLOC_UNIT number in this structure.
-   */
-# define ALLOC_UNIT  100
-  DWORD maxRects = ALLOC_UNIT;
-
-  RGNDATA* pData = (RGNDATA*)malloc(sizeof(RGNDATAHEADER)+(sizeof(RECT)*maxRects));
-  pData->rdh.dwSize = sizeof(RGNDATAHEADER);
-  pData->rdh.iType = RDH_RECTANGLES;
-  pData->rdh.nCount = pData->rdh.nRgnSize = 0;
-  SetRect(&pData->rdh.rcBound, MAXLONG, MAXLONG, 0, 0);
-
-  const int bpl = (bitmap->width()+7)/8; // number of bytes per line of pixels
-  BYTE* p8 = (BYTE*)bitmap->array;
-  BYTE* p;
-  for (int y = 0; y < bitmap->height(); y++) {
-    /* Scan each bitmap row from left to right*/
-    for (int x = 0; x < bitmap->width(); x++) {
-      /* Search for a continuous range of "non transparent pixels"*/
-      int x0 = x;
-      while (x < bitmap->width()) {
-        p = p8 + x / 8;
-        if (!((*p) & bit(x))) break; /* This pixel is "transparent"*/
-        x++;
-      }
-
-      if (x > x0) {
-        RECT* pr;
-        /* Add the pixels (x0, y) to (x, y+1) as a new rectangle
-         * in the region
-         */
-        if (pData->rdh.nCount >= maxRects) {
-          maxRects += ALLOC_UNIT;
-          pData = (RGNDATA*)realloc(pData, sizeof(RGNDATAHEADER)
-                                    + (sizeof(RECT)*maxRects));
-    	}
-        pr = (RECT*)&pData->Buffer;
-
-#ifdef WIN32
-	// fabien : we must take in account the border+caption x and y offsets of the Window
-	POINT pt={GetSystemMetrics(SM_CXBORDER)+GetSystemMetrics(SM_CXEDGE),GetSystemMetrics(SM_CYBORDER)+GetSystemMetrics(SM_CXEDGE)+GetSystemMetrics(SM_CYCAPTION)}; 
-#else
-	// please check some if some adjustement is necessary on Unix(-like) platforms
-#endif
-	
-        SetRect(&pr[pData->rdh.nCount], x0+pt.x, y+pt.y, x+pt.x, y+pt.y+1);
-        if (x0 < pData->rdh.rcBound.left)
-          pData->rdh.rcBound.left = x0;
-        if (y < pData->rdh.rcBound.top)
-          pData->rdh.rcBound.top = y;
-        if (x > pData->rdh.rcBound.right)
-          pData->rdh.rcBound.right = x;
-        if (y+1 > pData->rdh.rcBound.bottom)
-          pData->rdh.rcBound.bottom = y+1;
-        pData->rdh.nCount++;
-
-        /* On Windows98, ExtCreateRegion() may fail if the
-         * number of rectangles is too large (ie: >
-         * 4000). Therefore, we have to create the region by
-         * multiple steps.
-         */
-        if (pData->rdh.nCount == 2000) {
-          HRGN h = ExtCreateRegion(NULL, sizeof(RGNDATAHEADER)
-                                   + (sizeof(RECT)*maxRects), pData);
-          if (hRgn) {
-            CombineRgn(hRgn, hRgn, h, RGN_OR);
-            DeleteObject(h);
-          } else hRgn = h;
-          pData->rdh.nCount = 0;
-          SetRect(&pData->rdh.rcBound, MAXLONG, MAXLONG, 0, 0);
-        }
-      }
-    }
-
-    /* Go to next row */
-    p8 += bpl;
-  }
-
-  /* Create or extend the region with the remaining rectangles*/
-  HRGN h = ExtCreateRegion(NULL, sizeof(RGNDATAHEADER)
-		      + (sizeof(RECT)*maxRects), pData);
-  if (hRgn) {
-    CombineRgn(hRgn, hRgn, h, RGN_OR);
-    DeleteObject(h);
-  } else hRgn = h;
-
-  free(pData); // I've created the region so I can free this now, right?
-
-  return hRgn;
-
-}
-#endif
-
 //
 // End of "$Id$"
 //
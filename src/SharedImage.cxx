@@ -28,10 +28,23 @@
 #include <config.h>
 #include <fltk/SharedImage.h>
 #include <fltk/xbmImage.h>
+#include <fltk/Window.h>
+#include <fltk/draw.h>
+#include <fltk/run.h>
 #include <fltk/string.h>
+#include <fltk/load_plugin.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 using namespace fltk;
 
@@ -52,24 +65,309 @@ void SharedImage::set_cache_size(unsigned l)
   mem_usage_limit = l;
 }
 
-static SharedImage *limage; // used to find the less used image
-void SharedImage::find_less_used() {
-  if(l1) l1->find_less_used();
-  if(l2) l2->find_less_used();
-  if(mem_used() && (!limage->mem_used() || used<limage->used)) limage=this;
+// Fetching in another thread is done with these, see below:
+struct fltk::SharedImageJob {
+  SharedImageJob* next;
+  SharedImage* image;
+  const char* filename;	// get_filename() when it was queued
+  int w, h;		// from setsize()
+  PixelType type;	// from setpixeltype()
+  uchar* pixels;	// w*h pixels of type, made by linebuffer()
+  int pw, ph; PixelType ptype; // size pixels was made for
+  bool cancelled;	// a synchronous fetch was done instead
+  const Window* window;	// where to redraw
+  Rectangle area;
+  bool redraw_all;	// drawn in more than one window
+  bool merged;		// area is from more than one draw
+  int rows;		// rows set in order by fetch(), locked by job_mutex
+  int shown;		// rows of those copied to the Image
+  bool progress;	// job_progress() has been posted and not run
+  double posted;	// when it was posted
+  SharedImage::FetchCallback done; // from fetch_in_background()
+  void* done_data;
+};
+static SharedImageJob* worker_job; // the one the decoding thread is doing
+
+// Images are found by name in a hash table. All the images that may
+// have memory to free and are not pinned are also in a list in order of
+// use, with first_image the most recent, so check_mem_usage() destroys
+// the least recently used one by looking at the end of the list.
+
+static SharedImage** table;
+static unsigned table_size;	// always a power of 2
+static unsigned table_count;
+static SharedImage* last_image;	// least recently used
+static SharedImage::CacheStats stats;
+
+static unsigned hash_name(const char* name, int w, int h) {
+  unsigned x = 2166136261U;
+  for (const uchar* p = (const uchar*)name; *p; p++) x = (x ^ *p) * 16777619U;
+  return x ^ (w*31+h);
+}
+
+/*! Return the counts of hits, misses and images destroyed because of
+  set_cache_size(). The memory used by all images is
+  Image::total_mem_used(). */
+const SharedImage::CacheStats& SharedImage::cache_stats() {
+  return stats;
+}
+
+// Remove it from the list check_mem_usage() looks at:
+void SharedImage::lru_unlink() {
+  if (!in_lru) return;
+  if (lru_prev) lru_prev->lru_next = lru_next; else first_image = lru_next;
+  if (lru_next) lru_next->lru_prev = lru_prev; else last_image = lru_prev;
+  in_lru = false;
+}
+
+// Mark it as the most recently used:
+void SharedImage::touch() {
+  used = image_used++;
+  if (pinned || first_image == this) return;
+  lru_unlink();
+  lru_prev = 0;
+  lru_next = first_image;
+  if (first_image) first_image->lru_prev = this; else last_image = this;
+  first_image = this;
+  in_lru = true;
 }
+
 void SharedImage::check_mem_usage()
 {
-  if (mem_usage_limit==0 || first_image==NULL ||
-      total_mem_used() <= mem_usage_limit)
+  if (mem_usage_limit==0 || total_mem_used() <= mem_usage_limit)
     return;
+  // never destroy the most recent one, it is probably being drawn:
+  while (last_image && last_image != first_image &&
+	 total_mem_used() >= mem_usage_limit) {
+    SharedImage* image = last_image;
+    image->lru_unlink(); // put back by touch() when it is used again
+    unsigned long n = image->mem_used();
+    if (!n) continue;
+    image->pack();
+    image->destroy();
+    stats.evictions++;
+    stats.evicted_bytes += n;
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// Compressed copies of destroyed images:
+//
+// check_mem_usage() compresses the buffer() of an image before it
+// destroys it, and _draw() puts the pixels back rather than calling
+// fetch() again, which is much faster than reading and decoding the
+// file. The compression is LZ4-like: a token byte with the number of
+// literal bytes and the length of a match, the literals, and the 16-bit
+// distance back to the match. A match overlapping itself repeats the
+// last pixel, so masks and images with few colors become little more
+// than run lengths. The copies are in their own list, oldest first, and
+// the oldest are thrown away to keep them under the compressed size.
+
+static SharedImage* packed_first; // oldest
+static SharedImage* packed_last;
+static unsigned long packed_used;
+static unsigned packed_limit;
+static bool packed_limit_set;
+
+// At the start of the packed block:
+struct PackedHeader {
+  int w, h;
+  PixelType type;
+  unsigned n;	// bytes of buffer()
+};
+
+static inline unsigned read32(const uchar* p) {
+  return p[0] | (p[1]<<8) | (p[2]<<16) | (unsigned(p[3])<<24);
+}
+
+static uchar* put_length(uchar* op, unsigned n) {
+  for (; n >= 255; n -= 255) *op++ = 255;
+  *op++ = uchar(n);
+  return op;
+}
+
+// Returns the size written to dst, or 0 if it would not fit in cap:
+static unsigned lz_compress(const uchar* src, unsigned n,
+			    uchar* dst, unsigned cap)
+{
+  enum {HASH_BITS = 12};
+  unsigned table[1<<HASH_BITS];
+  memset(table, 0, sizeof(table));
+  const uchar* ip = src;
+  const uchar* anchor = src;
+  const uchar* end = src+n;
+  uchar* op = dst;
+  uchar* oend = dst+cap;
+  // the last bytes are always literals, so matches can read 4 at a time:
+  if (n > 12) for (const uchar* limit = end-12; ip < limit;) {
+    unsigned seq = read32(ip);
+    unsigned h = (seq*2654435761U) >> (32-HASH_BITS);
+    const uchar* ref = src+table[h];
+    table[h] = unsigned(ip-src);
+    if (ref >= ip || ip-ref > 65535 || read32(ref) != seq) {ip++; continue;}
+    const uchar* m = ip+4;
+    const uchar* r = ref+4;
+    while (m < end-5 && *m == *r) {m++; r++;}
+    unsigned lit = unsigned(ip-anchor);
+    unsigned len = unsigned(m-ip-4);
+    if (op+lit+lit/255+len/255+8 > oend) return 0;
+    uchar* token = op++;
+    *token = uchar(((lit < 15 ? lit : 15)<<4) | (len < 15 ? len : 15));
+    if (lit >= 15) op = put_length(op, lit-15);
+    memcpy(op, anchor, lit); op += lit;
+    unsigned offset = unsigned(ip-ref);
+    *op++ = uchar(offset); *op++ = uchar(offset>>8);
+    if (len >= 15) op = put_length(op, len-15);
+    ip = anchor = m;
+  }
+  unsigned lit = unsigned(end-anchor);
+  if (op+lit+lit/255+2 > oend) return 0;
+  *op++ = uchar((lit < 15 ? lit : 15)<<4);
+  if (lit >= 15) op = put_length(op, lit-15);
+  memcpy(op, anchor, lit); op += lit;
+  return unsigned(op-dst);
+}
+
+// Returns false unless it makes exactly size bytes:
+static bool lz_decompress(const uchar* src, unsigned n,
+			  uchar* dst, unsigned size)
+{
+  const uchar* ip = src;
+  const uchar* iend = src+n;
+  uchar* op = dst;
+  uchar* oend = dst+size;
+  for (;;) {
+    if (ip >= iend) return false;
+    unsigned token = *ip++;
+    unsigned lit = token>>4;
+    if (lit == 15) for (unsigned c = 255; c == 255; lit += c) {
+      if (ip >= iend) return false;
+      c = *ip++;
+    }
+    if (lit > unsigned(iend-ip) || lit > unsigned(oend-op)) return false;
+    memcpy(op, ip, lit); op += lit; ip += lit;
+    if (ip == iend) return op == oend;
+    if (iend-ip < 2) return false;
+    unsigned offset = ip[0] | (ip[1]<<8); ip += 2;
+    if (!offset || offset > unsigned(op-dst)) return false;
+    unsigned len = token&15;
+    if (len == 15) for (unsigned c = 255; c == 255; len += c) {
+      if (ip >= iend) return false;
+      c = *ip++;
+    }
+    len += 4;
+    if (len > unsigned(oend-op)) return false;
+    const uchar* r = op-offset;
+    if (offset >= len) memcpy(op, r, len);
+    else for (unsigned i = 0; i < len; i++) op[i] = r[i];
+    op += len;
+  }
+}
+
+static inline bool has_alpha(PixelType t) {
+  return t == MASK || t == RGBA || t >= ARGB32;
+}
+
+/*! Limit the memory used by the compressed copies of images that
+  set_cache_size() made it destroy. Zero (the default) is a quarter of
+  set_cache_size(). Images in this cache are drawn again without
+  reading the file. */
+void SharedImage::set_compressed_cache_size(unsigned l)
+{
+  packed_limit = l;
+  packed_limit_set = l != 0;
+  while (packed_first && packed_used > packed_limit)
+    packed_first->discard_packed();
+}
+
+/*! Memory used by the compressed copies of images. */
+unsigned long SharedImage::compressed_mem_used() {
+  return packed_used;
+}
+
+void SharedImage::discard_packed() {
+  if (!packed) return;
+  if (packed_prev) packed_prev->packed_next = packed_next; else packed_first = packed_next;
+  if (packed_next) packed_next->packed_prev = packed_prev; else packed_last = packed_prev;
+  packed_used -= packed_size;
+  delete[] packed;
+  packed = 0;
+}
+
+// Called by check_mem_usage() before destroy():
+void SharedImage::pack() {
+  discard_packed();
+  unsigned limit = packed_limit_set ? packed_limit : mem_usage_limit/4;
+  if (!limit || job || !fetched()) return;
+  // the alpha of some buffers is elsewhere, so they cannot be restored:
+  if (has_alpha(pixeltype()) && !has_alpha(buffer_pixeltype())) return;
+  unsigned n = unsigned(buffer_linedelta()*buffer_height());
+  if (!n || n != mem_used()) return;
+  static uchar* scratch;
+  static unsigned scratch_size;
+  if (scratch_size < n) {
+    delete[] scratch;
+    scratch_size = n;
+    scratch = new uchar[n];
+  }
+  unsigned size = lz_compress(buffer(), n, scratch, n-n/8);
+  if (!size) return; // not worth it
+  size += sizeof(PackedHeader);
+  if (size > limit) return;
+  while (packed_first && packed_used+size > limit)
+    packed_first->discard_packed();
+  packed = new uchar[size];
+  packed_size = size;
+  PackedHeader* header = (PackedHeader*)packed;
+  header->w = w();
+  header->h = h();
+  header->type = pixeltype();
+  header->n = n;
+  memcpy(packed+sizeof(PackedHeader), scratch, size-sizeof(PackedHeader));
+  packed_prev = packed_last;
+  packed_next = 0;
+  if (packed_last) packed_last->packed_next = this; else packed_first = this;
+  packed_last = this;
+  packed_used += size;
+  stats.compressed++;
+}
+
+// Put the pixels back instead of fetch(), returns false if it can't:
+bool SharedImage::unpack() {
+  if (!packed) return false;
+  PackedHeader header = *(PackedHeader*)packed;
+  bool ok = false;
+  if (header.w == w() && header.h == h() && header.type == pixeltype()) {
+    uchar* p = buffer();
+    if (p && unsigned(buffer_linedelta()*buffer_height()) == header.n)
+      ok = lz_decompress(packed+sizeof(PackedHeader),
+			 packed_size-sizeof(PackedHeader), p, header.n);
+  }
+  discard_packed();
+  if (!ok) {destroy(); return false;}
+  buffer_changed();
+  set_fetched();
+  stats.uncompressed++;
+  return true;
+}
 
-  do {
-    limage=first_image;
-    first_image->find_less_used();
-    if (!limage->mem_used()) break;
-    limage->destroy();
-  } while(total_mem_used() >= mem_usage_limit);
+/*! Make get() not destroy the named image when the cache is larger
+  than set_cache_size(), until unpin() is called the same number of
+  times. Use this for images that are on the screen. Returns false if
+  there is no image with this name. */
+bool SharedImage::pin(const char* name) {
+  SharedImage* image = find(name);
+  if (!image) return false;
+  image->pin();
+  return true;
+}
+
+/*! Undo pin(). Returns false if there is no image with this name. */
+bool SharedImage::unpin(const char* name) {
+  SharedImage* image = find(name);
+  if (!image) return false;
+  image->unpin();
+  return true;
 }
 
 // WAS: this is probably a waste of time! No modern system requires these
@@ -85,40 +383,51 @@ public:
 
 shared_image_destructor_class shared_image_destructor;
 
-/*! Calls destroy() on this and every less-recently-used SharedImage?. */
+/*! Calls destroy() on this and every less-recently-used SharedImage. */
 void SharedImage::clear_cache()
 {
-  destroy();
-  if (l1 && l1!=this) l1->clear_cache();
-  if (l2 && l2!=this) l2->clear_cache();
+  for (SharedImage* image = this; image; image = image->lru_next)
+    image->destroy();
 }
 
 void SharedImage::set_root_directory(const char *d) {
   shared_image_root = d;
 }
 
-void SharedImage::insert(SharedImage*& p, SharedImage* image) {
-  if(p == 0)
-    p = image;
-  else {
-    int c = strcmp(image->name, p->name);
-    if(c<0 &&p->l1!=p) insert(p->l1, image);
-    else {
-	if (p->l2!=p) insert(p->l2, image);
+void SharedImage::insert(SharedImage* image) {
+  if (table_count >= table_size) {
+    unsigned size = table_size ? 2*table_size : 64;
+    SharedImage** newtable = (SharedImage**)calloc(size, sizeof(SharedImage*));
+    for (unsigned i = 0; i < table_size; i++) {
+      for (SharedImage* q = table[i]; q;) {
+	SharedImage* next = q->hash_next;
+	SharedImage** p = &newtable[hash_name(q->name,q->want_w,q->want_h)&(size-1)];
+	q->hash_next = *p;
+	*p = q;
+	q = next;
+      }
     }
+    free(table);
+    table = newtable;
+    table_size = size;
   }
+  SharedImage** p = &table[hash_name(image->name,image->want_w,image->want_h)&(table_size-1)];
+  image->hash_next = *p;
+  *p = image;
+  table_count++;
 }
 
-SharedImage* SharedImage::find(SharedImage* image, const char* name) {
-  if(image == 0) return 0;
-  int c = strcmp(name, image->name);
-  if(c == 0) return image;
-  else if(c<0) return image->l1!= image ? find(image->l1, name) : 0;
-  else return image->l2!= image ? find(image->l2, name) : 0;
+SharedImage* SharedImage::find(const char* name, int w, int h) {
+  if (!table || !name) return 0;
+  SharedImage* image = table[hash_name(name,w,h)&(table_size-1)];
+  for (; image; image = image->hash_next)
+    if (image->want_w == w && image->want_h == h && !strcmp(name, image->name))
+      return image;
+  return 0;
 }
 
-
 const char* SharedImage::get_filename() const {
+  if (in_job()) return worker_job->filename;
   return get_filename(name);
 }
 
@@ -140,41 +449,152 @@ const char* SharedImage::get_filename(const char* name)
 }
 
 
+/*! Map all of a file into memory and put its length in \a size.
+  Returns null if it cannot be opened, is empty, or is not a plain
+  file (a pipe for instance). Call unmap_file() when done with it.
+  Image decoders can read from this without a copy being made, and the
+  system reads only the parts that are looked at.
+*/
+const uchar* SharedImage::map_file(const char* filename, unsigned& size) {
+#ifdef _WIN32
+  HANDLE f = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0,
+			 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+  if (f == INVALID_HANDLE_VALUE) return 0;
+  DWORD high = 0;
+  DWORD n = GetFileSize(f, &high);
+  HANDLE m = 0;
+  if (n && n != INVALID_FILE_SIZE && !high)
+    m = CreateFileMapping(f, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(f);
+  if (!m) return 0;
+  void* p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(m); // the view keeps it
+  if (!p) return 0;
+  size = n;
+  return (const uchar*)p;
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return 0;
+  struct stat st;
+  void* p = MAP_FAILED;
+  if (!fstat(fd, &st) && S_ISREG(st.st_mode) &&
+      st.st_size > 0 && st.st_size < 0x7fffffff)
+    p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps it
+  if (p == MAP_FAILED) return 0;
+# ifdef MADV_SEQUENTIAL
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+# endif
+  size = unsigned(st.st_size);
+  return (const uchar*)p;
+#endif
+}
+
+/*! Undo map_file(). */
+void SharedImage::unmap_file(const uchar* p, unsigned size) {
+  if (!p) return;
+#ifdef _WIN32
+  UnmapViewOfFile(p);
+#else
+  munmap((void*)p, size);
+#endif
+}
+
+/*! For the fetch() of subclasses where reads_mapped_file() is true.
+  Returns the file that get(name) mapped to find out the type, so it
+  is not opened twice, or else map_file(get_filename()). The caller
+  must unmap_file() it.
+*/
+const uchar* SharedImage::map_file(unsigned& size) {
+  if (mapped) {
+    const uchar* p = mapped;
+    size = mapped_size;
+    mapped = 0;
+    return p;
+  }
+  return map_file(get_filename(), size);
+}
+
+SharedImage::~SharedImage() {
+  unmap_file(mapped, mapped_size);
+  discard_packed();
+}
+
+// get(name) puts the file it mapped here for get(create,name) to use:
+static const char* pending_name;
+static const uchar* pending_map;
+static unsigned pending_size;
+
 SharedImage* SharedImage::get(SharedImage* (*create)(),
-				      const char* name, const uchar *datas)
+				      const char* name, const uchar *datas,
+				      int w, int h)
 {
-  SharedImage *image=SharedImage::find(first_image, name);
+  if (w <= 0 || h <= 0) w = h = 0;
+  SharedImage *image=SharedImage::find(name, w, h);
   if(!image)
   {
+    stats.misses++;
     image=create();
     image->refcount = 1;
     image->name = newstring(name);
     image->datas = datas;
-    image->l1 = image->l2 = 0;
-    SharedImage::insert(first_image, image);
+    image->hash_next = image->lru_prev = image->lru_next = 0;
+    image->pinned = 0;
+    image->in_lru = false;
+    image->want_w = w;
+    image->want_h = h;
+    image->job = 0;
+    image->mapped = 0;
+    image->packed = 0;
+    if (pending_map && name == pending_name && !datas &&
+	image->reads_mapped_file()) {
+      image->mapped = pending_map;
+      image->mapped_size = pending_size;
+      pending_map = 0;
+    }
+    SharedImage::insert(image);
   } else {
+    stats.hits++;
     if(image->datas==NULL) image->datas=datas;
     image->refcount++;
   }
-  image->used = image_used++;
+  image->touch();
   return image;
 }
 
-//
-// 'SharedImage::get()' - Get a shared image whatever the type is...
-//
-SharedImage * SharedImage::get(const char *n) {
-  SharedImage *img=SharedImage::find(first_image, n);
+int SharedImage::requested_w_ = 0;
+int SharedImage::requested_h_ = 0;
+
+/*! Return an image of any type that a Handler recognizes, from the
+  file \a n.
+
+  If \a w and \a h are not zero, the image is only going to be drawn
+  that size or smaller. Jpeg and png images then decode to a smaller
+  size that is still at least \a w by \a h (or the full size if that
+  is smaller), using less memory and time. Each size asked for is a
+  different image in the cache. Handlers can get these from
+  requested_w() and requested_h().
+*/
+SharedImage * SharedImage::get(const char *n, int w, int h) {
+  if (w <= 0 || h <= 0) w = h = 0;
+  SharedImage *img=SharedImage::find(n, w, h);
 
-  if (img!=NULL) return img;
+  if (img!=NULL) {stats.hits++; return img;}
     
     // Load image from disk...
   int		i;		// Looping var
   FILE		*fp;		// File pointer
   uchar		header[64];	// Buffer for auto-detecting files
+  unsigned	size;		// Size of the mapped file
 
-
-  if (n  && (*n) && (fp = fopen(n, "rb")) != NULL) {
+  if (!n || !*n) return NULL;
+  // The decoders that can will use this mapping rather than open it again:
+  const uchar* map = map_file(n, size);
+  if (map) {
+    memset(header, 0, sizeof(header));
+    memcpy(header, map, size < sizeof(header) ? size : sizeof(header));
+    pending_name = n; pending_map = map; pending_size = size;
+  } else if ((fp = fopen(n, "rb")) != NULL) {
     if(fread(header, 1, sizeof(header), fp)); // ignore the return value
     fclose(fp);
   } else {
@@ -189,59 +609,457 @@ SharedImage * SharedImage::get(const char *n) {
     img = gifImage::get(n);
   else {
     // Not a standard format; try an image handler...
+    requested_w_ = w; requested_h_ = h;
     for (i = 0, img = 0; i < num_handlers_; i ++) {
       img = (handlers_[i])(n, header, sizeof(header));
       if (img) break;
     }
+    if (!img) img = plugin_image(n, header, sizeof(header));
+    requested_w_ = requested_h_ = 0;
   }
+  unmap_file(pending_map, pending_size); // if no image wanted it
+  pending_map = 0;
   return img;
 }
 
+////////////////////////////////////////////////////////////////
+// Handlers in plugins, which are loaded by get() the first time it
+// sees a file they are for. A program that never reads a png file
+// does not load libpng, or even the fltk code for png files.
+
+struct ImagePlugin {
+  uchar magic[8];
+  int magic_len;
+  const char* module;
+  const char* symbol;
+  bool tried;	// load_plugin() has been called
+};
+static ImagePlugin* plugins;
+static int num_plugins;
+
+/*!
+  Make get() load the plugin \a module the first time it is given a
+  file that starts with the \a magic_len (up to 8) bytes of \a
+  magic, and add the function called \a symbol in it as a Handler.
+  See fltk::load_plugin() for how the module is found. If the plugin
+  can't be loaded an error is printed, once, and those files are not
+  recognized.
+*/
+void SharedImage::add_plugin(const char* magic, int magic_len,
+			     const char* module, const char* symbol)
+{
+  if (magic_len > 8) magic_len = 8;
+  plugins = (ImagePlugin*)realloc(plugins, (num_plugins+1)*sizeof(ImagePlugin));
+  ImagePlugin& p = plugins[num_plugins++];
+  memcpy(p.magic, magic, magic_len);
+  p.magic_len = magic_len;
+  p.module = module;
+  p.symbol = symbol;
+  p.tried = false;
+}
+
+SharedImage* SharedImage::plugin_image(const char* n, uchar* header, int len) {
+  for (int i = 0; i < num_plugins; i++) {
+    ImagePlugin& p = plugins[i];
+    if (p.tried || memcmp(header, p.magic, p.magic_len)) continue;
+    p.tried = true;
+    Handler handler = (Handler)load_plugin(p.module, p.symbol);
+    if (!handler) continue;
+    add_handler(handler);
+    SharedImage* img = handler(n, header, len);
+    if (img) return img;
+  }
+  return 0;
+}
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+# define PLUGIN(name) "fltk2_" name "_plugin.dll"
+#else
+# define PLUGIN(name) "libfltk2_" name "_plugin.so"
+#endif
+
+/*!
+  Makes SharedImage able to read PNG and Jpeg files by loading the
+  fltk2_png_plugin and fltk2_jpeg_plugin modules (built by "make
+  plugins" in the images directory) the first time one is read. Use
+  this instead of register_images() and linking the fltk_images
+  library, so programs that don't read those files start faster and
+  use less memory. The modules call back into fltk, so fltk must be a
+  shared library or the program linked with -rdynamic.
+*/
+void fltk::register_image_plugins() {
+  static bool been_here = false;
+  if (been_here) return;
+  been_here = true;
+  SharedImage::add_plugin("\211PNG", 4, PLUGIN("png"), "fltk_png_plugin");
+  SharedImage::add_plugin("\377\330\377", 3, PLUGIN("jpeg"), "fltk_jpeg_plugin");
+}
+
 void SharedImage::reload(const uchar* pdatas)
 {
   if (pdatas) datas = pdatas;
+  discard_packed();
   refetch();
 }
 void SharedImage::reload(const char* name, const uchar* pdatas)
 {
-  SharedImage *image=SharedImage::find(first_image, name);
+  SharedImage *image=SharedImage::find(name);
   if (image) image->reload(pdatas);
 }
 
-void SharedImage::remove_from_tree(SharedImage*& p, SharedImage* image) {
-  if (p) {
-    int c = strcmp(image->name, p->name);
-    if (c == 0) {
-      if (image->l1) {
-	p = image->l1;
-	if (image->l2) insert(first_image, image->l2);
-      } else
-	p = image->l2;
-    } else if (c<0) remove_from_tree(p->l1, image);
-    else remove_from_tree(p->l2, image);
+void SharedImage::remove_from_table() {
+  if (!table) return;
+  SharedImage** p = &table[hash_name(name,want_w,want_h)&(table_size-1)];
+  for (; *p; p = &((*p)->hash_next)) {
+    if (*p == this) {*p = hash_next; table_count--; break;}
   }
+  lru_unlink();
 }
 
 int SharedImage::remove()
 {
   if (--refcount) return 0;
-  remove_from_tree(first_image, this);
+  remove_from_table();
   return 1;
 }
 
 int SharedImage::remove(const char* name)
 {
-  SharedImage *image=SharedImage::find(first_image, name);
+  SharedImage *image=SharedImage::find(name);
   if (image) return image->remove();
   else return 0;
 }
 
+////////////////////////////////////////////////////////////////
+// Fetching in another thread:
+//
+// With async_fetch() on, _draw() of an image that is not fetched gives
+// it to a decoding thread and draws nothing. That thread calls fetch(),
+// and the set functions above store the pixels in the SharedImageJob
+// rather than the Image, as making the system's image is not thread
+// safe. When it is done fltk::post() makes the main thread copy them to
+// the Image and redraw where it was drawn. Several decoders keep their
+// state in static variables, so Image fetches are done one at a time
+// and there is only one thread.
+//
+// Most decoders set the rows in order from the top. As they do, a
+// job_progress() is posted every progress_interval seconds to copy the
+// new rows to the Image and redraw just that part, so a large or slow
+// file appears a piece at a time. The Image is fetched() after the
+// first of these, and _draw() draws what there is so far.
+
+bool SharedImage::async_fetch_ = false;
+
+
+#if HAVE_PTHREAD
+#include <fltk/Threads.h>
+
+static SignalMutex* job_mutex;	// protects the queue and cancelled
+static Mutex* fetch_mutex;	// held while any SharedImage is fetched
+static SharedImageJob* job_head;
+static SharedImageJob* job_tail;
+static Thread worker_thread;
+static const double progress_interval = .1;
+
+static void* fetch_worker(void*) {
+  job_mutex->lock();
+  for (;;) {
+    while (!job_head) job_mutex->wait();
+    SharedImageJob* j = job_head;
+    job_head = j->next;
+    if (!job_head) job_tail = 0;
+    bool cancelled = j->cancelled;
+    job_mutex->unlock();
+    if (!cancelled) {
+      fetch_mutex->lock();
+      worker_job = j;
+      ((Image*)(j->image))->fetch(); // it is public in Image
+      worker_job = 0;
+      fetch_mutex->unlock();
+    }
+    post(SharedImage::job_done, j);
+    job_mutex->lock();
+  }
+  return 0;
+}
+
+// Returns false if the thread could not be made:
+static bool queue_job(SharedImageJob* j) {
+  if (!job_mutex) {
+    job_mutex = new SignalMutex;
+    fetch_mutex = new Mutex;
+    if (create_thread(worker_thread, fetch_worker, 0)) {
+      SharedImage::async_fetch(false); // don't try again
+      return false;
+    }
+    pthread_detach(worker_thread);
+  }
+  job_mutex->lock();
+  j->next = 0;
+  if (job_tail) job_tail->next = j; else job_head = j;
+  job_tail = j;
+  job_mutex->signal();
+  job_mutex->unlock();
+  return true;
+}
+
+// True if this is the decoding thread running fetch() for this image:
+bool SharedImage::in_job() const {
+  return job_mutex && pthread_equal(pthread_self(), worker_thread) &&
+    worker_job && worker_job->image == this;
+}
+
+#else
+bool SharedImage::in_job() const {return false;}
+#endif
+
+static void free_job(SharedImageJob* j) {
+  delete[] (char*)(j->filename);
+  delete[] j->pixels;
+  delete j;
+}
+
+// Copy rows from..to-1 to the Image:
+static void show_rows(SharedImage* image, SharedImageJob* j, int from, int to) {
+  int ld = fltk::depth(j->type)*j->w;
+  image->Image::setpixeltype(j->type);
+  image->Image::setsize(j->w, j->h);
+  image->Image::setpixels(j->pixels+from*ld, Rectangle(0,from,j->w,to-from), ld);
+  j->shown = to;
+}
+
+// Redraw where rows from..to-1 of the image were drawn:
+static void redraw_rows(SharedImageJob* j, int from, int to) {
+  if (j->redraw_all) {fltk::redraw(); return;}
+  Rectangle r(j->area);
+  if (!j->merged && j->h > 0 && (from > 0 || to < j->h)) {
+    int y = r.y()+r.h()*from/j->h;
+    r.set(r.x(), y, r.w(), r.y()+(r.h()*to+j->h-1)/j->h-y);
+  }
+  // make sure the window was not destroyed:
+  for (Window* w = Window::first(); w; w = w->next())
+    if (w == j->window) {w->redraw(r); break;}
+}
+
+// Called in the main thread by fltk::post() when the thread is done:
+void SharedImage::job_done(void* v) {
+  SharedImageJob* j = (SharedImageJob*)v;
+  SharedImage* image = j->image;
+  if (j->cancelled || image->job != j) {
+    // _measure() fetched it instead, still tell fetch_in_background():
+    if (j->done && image->fetched()) j->done(image, j->done_data);
+    free_job(j);
+    return;
+  }
+  image->job = 0;
+  // rows already shown are not copied again, unless destroy() was called:
+  int from = image->fetched() ? j->shown : 0;
+  if (!j->pixels) from = 0; // failed, redraw it all
+  else if (from < j->h) show_rows(image, j, from, j->h);
+  image->set_fetched(); // even if it failed, like fetch_if_needed()
+  redraw_rows(j, from, j->h);
+  if (j->done) j->done(image, j->done_data);
+  free_job(j);
+  check_mem_usage();
+}
+
+#if HAVE_PTHREAD
+// Posted by the decoding thread when more rows are done:
+void SharedImage::job_progress(void* v) {
+  SharedImageJob* j = (SharedImageJob*)v;
+  SharedImage* image = j->image;
+  job_mutex->lock();
+  j->progress = false;
+  int from = image->fetched() ? j->shown : 0;
+  int to = j->rows;
+  bool copy = !j->cancelled && image->job == j && to > from;
+  if (copy) show_rows(image, j, from, to);
+  job_mutex->unlock(); // job_done() will free it if cancelled
+  if (!copy) return;
+  image->set_fetched();
+  redraw_rows(j, from, to);
+}
+
+// The decoding thread calls this after setting rows y..y+n-1:
+static void rows_done(SharedImageJob* j, int y, int n) {
+  if (y != j->rows) return; // not in order, job_done() shows them
+  double now = get_time_secs();
+  job_mutex->lock();
+  j->rows = y+n;
+  bool post_it = !j->progress && now >= j->posted+progress_interval;
+  if (post_it) {j->progress = true; j->posted = now;}
+  job_mutex->unlock();
+  if (post_it) post(SharedImage::job_progress, j);
+}
+#else
+static void rows_done(SharedImageJob*, int, int) {}
+#endif
+
+// Make the pixels array for the current size and type:
+static uchar* job_pixels(SharedImageJob* j) {
+  if (!j->pixels || j->pw != j->w || j->ph != j->h || j->ptype != j->type) {
+#if HAVE_PTHREAD
+    job_mutex->lock(); // job_progress() may be copying it
+#endif
+    delete[] j->pixels;
+    j->pixels = new uchar[j->w*j->h*fltk::depth(j->type)];
+    j->pw = j->w; j->ph = j->h; j->ptype = j->type;
+    j->rows = j->shown = 0;
+#if HAVE_PTHREAD
+    job_mutex->unlock();
+#endif
+  }
+  return j->pixels;
+}
+
+void SharedImage::setpixeltype(PixelType p) {
+  if (in_job()) worker_job->type = p; else Image::setpixeltype(p);
+}
+
+void SharedImage::setsize(int w, int h) {
+  if (in_job()) {worker_job->w = w; worker_job->h = h;} else Image::setsize(w, h);
+}
+
+PixelType SharedImage::pixeltype() const {
+  return in_job() ? worker_job->type : Image::pixeltype();
+}
+
+int SharedImage::w() const {return in_job() ? worker_job->w : Image::w();}
+
+int SharedImage::h() const {return in_job() ? worker_job->h : Image::h();}
+
+uchar* SharedImage::linebuffer(int y) {
+  if (!in_job()) return Image::linebuffer(y);
+  return job_pixels(worker_job) + y*worker_job->w*fltk::depth(worker_job->type);
+}
+
+void SharedImage::setpixels(const uchar* d, int y) {
+  if (!in_job()) {Image::setpixels(d, y); return;}
+  uchar* to = linebuffer(y);
+  if (to != d) memcpy(to, d, worker_job->w*fltk::depth(worker_job->type));
+  rows_done(worker_job, y, 1);
+}
+
+void SharedImage::setpixels(const uchar* d, const Rectangle& r, int linedelta) {
+  if (!in_job()) {Image::setpixels(d, r, linedelta); return;}
+  if (r.empty()) return;
+  int depth = fltk::depth(worker_job->type);
+  for (int y = r.y(); y < r.b(); y++, d += linedelta)
+    memcpy(linebuffer(y) + r.x()*depth, d, r.w()*depth);
+  if (r.x() == 0 && r.w() == worker_job->w) rows_done(worker_job, r.y(), r.h());
+}
+
 void SharedImage::_draw(const Rectangle& r) const {
-  const_cast<SharedImage*>(this)->used = image_used++; // do this before check_mem_usage
+  SharedImage* image = const_cast<SharedImage*>(this);
+  image->touch(); // do this before check_mem_usage
+  if (!fetched() && packed) image->unpack();
+#if HAVE_PTHREAD
+  if (job) {
+    // being fetched, also redraw this place as rows arrive:
+    Rectangle area; transform(r, area);
+    if (job->window != Window::drawing_window()) job->redraw_all = true;
+    else if (area.x() != job->area.x() || area.y() != job->area.y() ||
+	     area.w() != job->area.w() || area.h() != job->area.h()) {
+      job->area.merge(area);
+      job->merged = true;
+    }
+    if (!fetched()) return; // else draw the rows there are so far
+  } else if (!fetched() && async_fetch_ && fetch_in_thread()) {
+    Rectangle area; transform(r, area);
+    SharedImageJob* j = new SharedImageJob;
+    memset((void*)j, 0, sizeof(*j));
+    j->image = image;
+    j->filename = newstring(get_filename());
+    j->type = Image::pixeltype();
+    j->window = Window::drawing_window();
+    j->area = area;
+    image->job = j;
+    if (queue_job(j)) return;
+    image->job = 0; // no thread, do it now
+    free_job(j);
+  }
+  if (fetch_mutex && !fetched()) {
+    fetch_mutex->lock();
+    fetch_if_needed();
+    fetch_mutex->unlock();
+  }
+#endif
   Image::_draw(r);
   check_mem_usage();
 }
 
+/*!
+  Make the decoding thread fetch the image, and call \a done(this,data)
+  in the main thread once it has. This is for showing something else,
+  such as a "loading" message, until an image is ready, as Image::w()
+  and h() are not known until it is fetched. The image is drawn a
+  piece at a time if it is drawn before it is done, as with
+  async_fetch().
+
+  Returns false, and \a done is not called, if the image is already
+  fetched or it cannot be done by another thread. Then just use it as
+  usual, it will be fetched when it is first measured or drawn.
+*/
+bool SharedImage::fetch_in_background(FetchCallback done, void* data) {
+  if (!fetched() && packed) unpack();
+  if (fetched()) return false;
+#if HAVE_PTHREAD
+  if (job) {job->done = done; job->done_data = data; return true;}
+  if (!fetch_in_thread()) return false;
+  SharedImageJob* j = new SharedImageJob;
+  memset((void*)j, 0, sizeof(*j));
+  j->image = this;
+  j->filename = newstring(get_filename());
+  j->type = Image::pixeltype();
+  j->done = done;
+  j->done_data = data;
+  job = j;
+  if (queue_job(j)) return true;
+  job = 0;
+  free_job(j);
+#endif
+  return false;
+}
+
+/*!
+  Stop the decoding thread from fetching this image if it has not
+  started yet, and don't call the function given to
+  fetch_in_background(). A fetch that has started runs to the end
+  but is thrown away, so the image is fetched again when drawn.
+*/
+void SharedImage::cancel_fetch() {
+#if HAVE_PTHREAD
+  if (!job) return;
+  job_mutex->lock();
+  job->cancelled = true;
+  job_mutex->unlock();
+  job->done = 0;
+  job = 0;
+#endif
+}
+
+/*! If another thread is fetching the image this cancels that and does
+  it now, as the size is not known until fetch() is done or the first
+  rows have been shown by draw(). */
+void SharedImage::_measure(int& w, int& h) const {
+  if (!fetched() && packed) const_cast<SharedImage*>(this)->unpack();
+#if HAVE_PTHREAD
+  if (fetch_mutex && !fetched()) {
+    if (job) {
+      job_mutex->lock();
+      job->cancelled = true;
+      job_mutex->unlock();
+      const_cast<SharedImage*>(this)->job = 0;
+    }
+    fetch_mutex->lock();
+    Image::_measure(w, h);
+    fetch_mutex->unlock();
+    return;
+  }
+#endif
+  Image::_measure(w, h);
+}
+
 //
 // 'SharedImage::add_handler()' - Add a shared image handler.
 //
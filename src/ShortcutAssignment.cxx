@@ -45,6 +45,132 @@ class shortcutAssociationType : public AssociationType {
 // this is our association to the shortcuts associated with widgets
 static shortcutAssociationType shortcutAssociation;
 
+////////////////////////////////////////////////////////////////
+// Every assignment is also in a hash table by key, so the widgets a
+// keystroke is a shortcut for can be found without testing every
+// widget. The table is updated by all the functions below that change
+// the assignments.
+
+struct ShortcutEntry {
+  const Widget* widget;
+  unsigned key;
+  ShortcutEntry* next;
+};
+
+#define SHORTCUT_TABLE 1024 // must be a power of 2
+static ShortcutEntry* shortcut_table[SHORTCUT_TABLE];
+static int shortcut_entries;
+
+// The keysym or character the event must match, lower-case like event_key():
+static unsigned shortcut_hash(unsigned key) {
+  key &= 0xffffu;
+  if (!(key & 0xff00u)) key = tolower(key);
+  return (key ^ (key >> 10)) & (SHORTCUT_TABLE-1);
+}
+
+class unregisterFunctor : public AssociationFunctor {
+public:
+  bool handle(const AssociationType&, const Widget* widget, void* data) {
+    unsigned key = unsigned(long(data));
+    for (ShortcutEntry** p = &shortcut_table[shortcut_hash(key)]; *p; p = &(*p)->next) {
+      ShortcutEntry* e = *p;
+      if (e->widget == widget && e->key == key) {
+	*p = e->next;
+	delete e;
+	shortcut_entries--;
+	break;
+      }
+    }
+    return false;
+  }
+};
+
+class registerFunctor : public AssociationFunctor {
+public:
+  bool handle(const AssociationType&, const Widget* widget, void* data) {
+    unsigned key = unsigned(long(data));
+    ShortcutEntry* e = new ShortcutEntry;
+    e->widget = widget;
+    e->key = key;
+    ShortcutEntry*& head = shortcut_table[shortcut_hash(key)];
+    e->next = head;
+    head = e;
+    shortcut_entries++;
+    return false;
+  }
+};
+
+// Remove the widget's entries before changing its assignments:
+static void unregister_shortcuts(const Widget* widget) {
+  if (!shortcut_entries) return;
+  unregisterFunctor f;
+  foreach(&shortcutAssociation, widget, f);
+}
+
+// And put them back afterwards:
+static void register_shortcuts(const Widget* widget) {
+  registerFunctor f;
+  foreach(&shortcutAssociation, widget, f);
+}
+
+// Returns true if the current KEY or SHORTCUT event matches the
+// shortcut value:
+static bool shortcut_matches(unsigned shortcut) {
+  // turn letters into lower-case to match event_key()
+  if (!(shortcut & 0xff00u))
+    shortcut = (shortcut & 0xffff0000u) | tolower(shortcut & 0xffu);
+
+  // we must match all bits in the keysym, all shift keys that
+  // must be held down, and the main shift keys must match if off:
+  unsigned mismatch = shortcut ^ (event_key() | event_state());
+  if (!(mismatch & (0xffffu|shortcut|META|ALT|CTRL|SHIFT)))
+    return true;
+
+  // Check against punctuation characters that may require shift
+  // or that the keypad produces. If you want '#' to work as a
+  // shortcut, you would have to specify SHIFT+'3' for the above
+  // to work. This code allows SHIFT+'#' and just '#' to work:
+  char c = event_text()[0];
+  // this does not work for letters (as it would make different
+  // shortcuts for shift and unshifted not work) and not for UTF-8:
+  if (c && !isalpha(c) && !(c&0x80)) {
+    mismatch = shortcut ^ (unsigned(c) | event_state());
+    if (!(mismatch & (0xffffu|shortcut|META|ALT|CTRL)))
+      return true;
+  }
+
+  return false;
+}
+
+/*! Put up to \a max widgets with an assignment that matches the
+  current event into \a array, and return how many there are, which
+  may be more than \a max. This is used by Menu::handle_shortcut(). */
+int fl_matching_shortcuts(Widget** array, int max) {
+  if (!shortcut_entries) return 0;
+  int n = 0;
+  unsigned buckets[2];
+  buckets[0] = shortcut_hash(event_key());
+  int nbuckets = 1;
+  char c = event_text()[0];
+  if (c && !isalpha(c) && !(c&0x80)) {
+    buckets[1] = shortcut_hash(c);
+    if (buckets[1] != buckets[0]) nbuckets = 2;
+  }
+  for (int b = 0; b < nbuckets; b++) {
+    for (ShortcutEntry* e = shortcut_table[buckets[b]]; e; e = e->next) {
+      if (!shortcut_matches(e->key)) continue;
+      // a widget may match both of its keys, only list it once:
+      int i; for (i = 0; i < n && i < max; i++) if (array[i] == e->widget) break;
+      if (i < n && i < max) continue;
+      if (n < max) array[n] = (Widget*)(e->widget);
+      n++;
+    }
+  }
+  return n;
+}
+
+////////////////////////////////////////////////////////////////
+
 /*!
   Add a new shortcut assignment. Returns true if successful.  If \a key
   is zero or the assignment already exists this does nothing and
@@ -92,7 +218,9 @@ static shortcutAssociationType shortcutAssociation;
 bool Widget::add_shortcut(unsigned key) {
   if (!key) return false;
   if (find(shortcutAssociation, (void*)key)) return false;
+  unregister_shortcuts(this);
   add(shortcutAssociation, (void*)key);
+  register_shortcuts(this);
   return true;
 }
 
@@ -101,7 +229,10 @@ bool Widget::add_shortcut(unsigned key) {
   Delete a shortcut assignment. Returns true if it actually existed.
 */
 bool Widget::remove_shortcut(unsigned key) {
-  return remove(shortcutAssociation, (void*)key);
+  unregister_shortcuts(this);
+  bool ret = remove(shortcutAssociation, (void*)key);
+  register_shortcuts(this);
+  return ret;
 }
 
 
@@ -110,6 +241,7 @@ bool Widget::remove_shortcut(unsigned key) {
   This is automatically done by the Widget destructor.
 */
 void Widget::remove_shortcuts() {
+  unregister_shortcuts(this);
   set(shortcutAssociation, 0);
 }
 
@@ -130,7 +262,9 @@ unsigned Widget::shortcut() const {
   The result is exactly one shortcut (or none if \a key is zero).
 */
 void Widget::shortcut(unsigned key) {
+  unregister_shortcuts(this);
   set(shortcutAssociation, (void*)key);
+  register_shortcuts(this);
 }
 
 
@@ -208,37 +342,10 @@ class keyCompareFunctor : public AssociationFunctor {
 
     bool handle(const AssociationType&, const Widget*, void* data) {
       count++;
-
-      unsigned shortcut = unsigned(long(data));
-
-      // turn letters into lower-case to match event_key()
-      if (!(shortcut & 0xff00u))
-        shortcut = (shortcut & 0xffff0000u) | tolower(shortcut & 0xffu);
-
-      // we must match all bits in the keysym, all shift keys that
-      // must be held down, and the main shift keys must match if off:
-      unsigned mismatch = shortcut ^ (event_key() | event_state());
-      if (!(mismatch & (0xffffu|shortcut|META|ALT|CTRL|SHIFT)))
-        return true;
-
-      // Check against punctuation characters that may require shift
-      // or that the keypad produces. If you want '#' to work as a
-      // shortcut, you would have to specify SHIFT+'3' for the above
-      // to work. This code allows SHIFT+'#' and just '#' to work:
-      char c = event_text()[0];
-      // this does not work for letters (as it would make different
-      // shortcuts for shift and unshifted not work) and not for UTF-8:
-      if (c && !isalpha(c) && !(c&0x80)) {
-        mismatch = shortcut ^ (unsigned(c) | event_state());
-        if (!(mismatch & (0xffffu|shortcut|META|ALT|CTRL)))
-          return true;
-      }
-
-      return false;
+      return shortcut_matches(unsigned(long(data)));
     }
 };
 
-
 /*! Same as test_shortcut(true) */
 bool Widget::test_shortcut() const { return test_shortcut(true); }
 
@@ -29,8 +29,11 @@
 #include <fltk/Box.h>
 #include <fltk/draw.h>
 #include <fltk/math.h>
+#include <fltk/Image.h>
 #include <config.h>
 #include <stdio.h>
+#include "DisplayList.h"
+#include "DamageRects.h"
 
 using namespace fltk;
 
@@ -357,6 +360,35 @@ void Slider::draw_ticks(const Rectangle& r, int min_spacing)
   drawtext(p, x,y);
 }
 
+// Everything but the moving part is kept in an Image, so when only
+// the value changes the old and new positions of the moving part are
+// copied from it instead of drawing the box and tick marks again:
+namespace fltk {
+struct SliderLayer {
+  Image* image;
+  // what it was drawn for:
+  Rectangle area;
+  Flags flags;
+  bool slot;
+  double minimum, maximum, step;
+  int type, slider_size, tick_size;
+  Rectangle knob;	// where the moving part was drawn over it
+};
+}
+
+extern bool fl_trivial_transform(); // in path.cxx
+
+static inline bool same(const Rectangle& a, const Rectangle& b) {
+  return a.x()==b.x() && a.y()==b.y() && a.w()==b.w() && a.h()==b.h();
+}
+
+Slider::~Slider() {
+  if (layer_) {
+    delete layer_->image;
+    delete layer_;
+  }
+}
+
 void Slider::draw()
 {
   Flags flags = this->flags();
@@ -364,19 +396,89 @@ void Slider::draw()
   if (pushed()) f2 |= PUSHED;
   flags &= ~HIGHLIGHT;
 
+  // we draw the slot if box() has a zero-sized border:
+  Rectangle r1(w(),h()); box()->inset(r1);
+  draw_layered(r1, flags, f2, r1.y()==0, true);
+}
+
+/*!
+  Draw the box and, inside \a area, the tick marks, slot, and moving
+  part. If only the value or highlighting changed, only the part of
+  the widget where the moving part was and now is is drawn again, by
+  copying it from an Image of everything else.
+  \a flags is used to draw the box, \a f2 to draw the moving part. If
+  \a overlay is true the focus indicator of the box is drawn.
+*/
+void Slider::draw_layered(const Rectangle& area, Flags flags, Flags f2,
+			  bool slot, bool overlay)
+{
   Box* box = this->box();
-  if (!box->fills_rectangle()) draw_background();
-  drawstyle(style(),flags);
   Rectangle r(w(),h());
-  box->draw(r);
+  // for back compatability, use type flag to set slider size:
+  if (type()&16/*FILL*/) slider_size(0);
 
-  // we draw the slot if box() has a zero-sized border:
-  Rectangle r1(r); box->inset(r1);
-  draw(r1, f2, r1.y()==0);
+  // the image can't be used when recording or transformed:
+  if (fl_display_list || !fl_trivial_transform() || r.empty()) {
+    if (!box->fills_rectangle()) draw_background();
+    drawstyle(style(),flags);
+    box->draw(r);
+    draw(area, f2, slot);
+    if (overlay) {drawstyle(style(),flags); box->draw_symbol_overlay(r);}
+    return;
+  }
 
-  // draw the focus indicator inside the box:
-  drawstyle(style(),flags);
-  box->draw_symbol_overlay(r);
+  SliderLayer* l = layer_;
+  if (!l) {
+    l = layer_ = new SliderLayer;
+    l->image = 0;
+  }
+  Rectangle knob; int sglyph;
+  Rectangle sr(area); slider_area(sr, 0, slot);
+  knob_rect(sr, knob, sglyph);
+
+  Rectangle u(knob);
+  if (!l->image || l->image->w() != w() || l->image->h() != h() ||
+      damage() & ~(DAMAGE_VALUE|DAMAGE_HIGHLIGHT) ||
+      !same(l->area, area) || l->flags != flags || l->slot != slot ||
+      l->minimum != minimum() || l->maximum != maximum() ||
+      l->step != step() || l->type != type() ||
+      l->slider_size != slider_size_ || l->tick_size != tick_size_) {
+    if (l->image && (l->image->w() != w() || l->image->h() != h())) {
+      delete l->image;
+      l->image = 0;
+    }
+    if (!l->image) l->image = new Image(RGB32, w(), h());
+    l->area = area;
+    l->flags = flags;
+    l->slot = slot;
+    l->minimum = minimum();
+    l->maximum = maximum();
+    l->step = step();
+    l->type = type();
+    l->slider_size = slider_size_;
+    l->tick_size = tick_size_;
+    DamageRects* rects = fl_damage_rects; fl_damage_rects = 0;
+    {
+      GSave gsave;
+      l->image->make_current();
+      load_identity();
+      if (!box->fills_rectangle()) draw_background();
+      drawstyle(style(),flags);
+      box->draw(r);
+      draw_track(area, slot);
+    }
+    fl_damage_rects = rects;
+    u = r;
+  } else {
+    u.merge(l->knob);
+  }
+
+  push_clip(u);
+  l->image->draw(u, u);
+  draw_knob(sr, f2);
+  if (overlay) {drawstyle(style(),flags); box->draw_symbol_overlay(r);}
+  pop_clip();
+  l->knob = knob;
 }
 
 /*!
@@ -390,44 +492,62 @@ bool Slider::draw(const Rectangle& sr, Flags flags, bool slot)
 {
   // for back compatability, use type flag to set slider size:
   if (type()&16/*FILL*/) slider_size(0);
+  draw_track(sr, slot);
+  Rectangle r(sr); slider_area(r, 0, slot);
+  draw_knob(r, flags);
+  return true;
+}
+
+// Inset r from the area passed to draw() to where the slider moves,
+// and set tr to where the tick marks go. Returns false if there are
+// no tick marks:
+bool Slider::slider_area(Rectangle& r, Rectangle* tr, bool slot) const
+{
+  if (!tick_size_ || !(type()&TICK_BOTH)) return false;
+  const int slot_size_ = 3; // was 6, really should be a preference?
+  Rectangle t = r;
+  if (horizontal()) {
+    r.move_b(-tick_size_);
+    switch (type()&TICK_BOTH) {
+    case TICK_BOTH:
+      r.y(r.y()+tick_size_/2);
+      break;
+    case TICK_ABOVE:
+      r.y(r.y()+tick_size_);
+      t.set_b(r.center_y());
+      break;
+    case TICK_BELOW:
+      t.set_y(r.center_y()+(slot?slot_size_/2:0));
+      break;
+    }
+  } else {
+    r.move_r(-tick_size_);
+    switch (type()&TICK_BOTH) {
+    case TICK_BOTH:
+      r.x(r.x()+tick_size_/2);
+      break;
+    case TICK_ABOVE:
+      r.x(r.x()+tick_size_);
+      t.set_r(r.center_x());
+      break;
+    case TICK_BELOW:
+      t.set_x(r.center_x()+(slot?slot_size_/2:0));
+      break;
+    }
+  }
+  if (tr) *tr = t;
+  return true;
+}
 
+// Draw the tick marks and slot for draw():
+void Slider::draw_track(const Rectangle& sr, bool slot)
+{
   Rectangle r = sr;
   const int slot_size_ = 3; // was 6, really should be a preference?
 
   // draw the tick marks and inset the slider drawing area to clear them:
-  if (tick_size_ && (type()&TICK_BOTH)) {
-    Rectangle tr = r;
-    if (horizontal()) {
-      r.move_b(-tick_size_);
-      switch (type()&TICK_BOTH) {
-      case TICK_BOTH:
-        r.y(r.y()+tick_size_/2);
-        break;
-      case TICK_ABOVE:
-        r.y(r.y()+tick_size_);
-        tr.set_b(r.center_y());
-        break;
-      case TICK_BELOW:
-        tr.set_y(r.center_y()+(slot?slot_size_/2:0));
-        break;
-      }
-    } else {
-      r.move_r(-tick_size_);
-      switch (type()&TICK_BOTH) {
-      case TICK_BOTH:
-        r.x(r.x()+tick_size_/2);
-        break;
-      case TICK_ABOVE:
-        r.x(r.x()+tick_size_);
-        tr.set_r(r.center_x());
-        break;
-      case TICK_BELOW:
-        tr.set_x(r.center_x()+(slot?slot_size_/2:0));
-        break;
-      }
-    }
-    draw_ticks(tr, (slider_size()+1)/2);
-  }
+  Rectangle tr;
+  if (slider_area(r, &tr, slot)) draw_ticks(tr, (slider_size()+1)/2);
 
   if (slot) {
     Rectangle sl;
@@ -446,17 +566,14 @@ bool Slider::draw(const Rectangle& sr, Flags flags, bool slot)
     setbgcolor(BLACK);
     THIN_DOWN_BOX->draw(sl);
   }
+}
 
-  drawstyle(style(),flags|OUTPUT);
-  // if user directly set selected_color we use it:
-  if (style()->selection_color_) {
-    setbgcolor(style()->selection_color_);
-    setcolor(contrast(selection_textcolor(), style()->selection_color_));
-  }
-
-  // figure out where the slider should be:
-  Rectangle s(r);
-  int sglyph = 0; // draw our special glyph
+// Figure out where the moving part is drawn in r, the area returned
+// by slider_area(), and the glyph to draw for it:
+void Slider::knob_rect(const Rectangle& r, Rectangle& s, int& sglyph)
+{
+  s = r;
+  sglyph = 0; // draw our special glyph
   if (horizontal()) {
     s.x(r.x()+slider_position(value(),r.w()));
     s.w(slider_size_);
@@ -473,8 +590,20 @@ bool Slider::draw(const Rectangle& sr, Flags flags, bool slot)
       sglyph=ALIGN_CENTER; // stops it from drawing divider line
     }
   }
+}
+
+// Draw the moving part in r, the area returned by slider_area():
+void Slider::draw_knob(const Rectangle& r, Flags flags)
+{
+  drawstyle(style(),flags|OUTPUT);
+  // if user directly set selected_color we use it:
+  if (style()->selection_color_) {
+    setbgcolor(style()->selection_color_);
+    setcolor(contrast(selection_textcolor(), style()->selection_color_));
+  }
+  Rectangle s; int sglyph;
+  knob_rect(r, s, sglyph);
   draw_glyph(sglyph, s); // draw slider in new position
-  return true;
 }
 
 /*! This call is provied so subclasses can draw the moving part inside
@@ -616,6 +745,7 @@ Slider::Slider(int x, int y, int w, int h, const char* l)
   style(default_style);
   tick_size_ = 4;
   slider_size_ = 12;
+  layer_ = 0;
   //set_vertical();
 }
 
@@ -1,5 +1,9 @@
 #include <fltk/StringList.h>
 #include <fltk/Item.h>
+#include <fltk/SharedImage.h>
+#include <fltk/string.h>
+#include <stdio.h>
+#include <stdlib.h>
 using namespace fltk;
 
 /*! \class fltk::StringHierarchy
@@ -32,6 +36,30 @@ Widget* StringHierarchy::child(const Menu* group, const int* indexes,int level)
   return generated_item_;
 }
 
+/*!
+  Tests the strings returned by label() rather than making a widget for
+  each item.
+*/
+int StringHierarchy::find_prefix(const Menu* group, const char* prefix,
+				 int start)
+{
+  int n = children(group, 0, 0);
+  if (n <= 0) return -1;
+  if (start < 0 || start >= n) start = 0;
+  // label() may set things on this:
+  if (!generated_item_) {
+    Group::current(0);
+    generated_item_ = new Item();
+  }
+  int length = strlen(prefix);
+  for (int j = 0; j < n; j++) {
+    int i = (start+j)%n;
+    const char* label = this->label(group, &i, 0);
+    if (label && !strncasecmp(label, prefix, length)) return i;
+  }
+  return -1;
+}
+
 /*! \fn Widget* StringHierarchy::generated_item()
 
   Inside label() this points at the widget that will have the label
@@ -108,6 +136,47 @@ const char* StringArray::label(const Menu*, int index) {
   return array[index];
 }
 
+static const char* const* sort_array;
+
+static int compare_labels(const void* a, const void* b) {
+  int i = *(const int*)a;
+  int j = *(const int*)b;
+  int c = strcasecmp(sort_array[i], sort_array[j]);
+  return c ? c : i-j;
+}
+
+/*!
+  The first time it is called this sorts the labels into an index,
+  which is then binary-searched for ones starting with \a prefix.
+  The index is thrown away by set().
+*/
+int StringArray::find_prefix(const Menu*, const char* prefix, int start) {
+  int n = children_;
+  if (n <= 0) return -1;
+  if (!sorted_) {
+    sorted_ = new int[n];
+    for (int i = 0; i < n; i++) sorted_[i] = i;
+    sort_array = array;
+    qsort(sorted_, n, sizeof(int), compare_labels);
+  }
+  int length = strlen(prefix);
+  // find the first label that is not less than the prefix:
+  int a = 0, b = n;
+  while (a < b) {
+    int c = (a+b)/2;
+    if (strncasecmp(array[sorted_[c]], prefix, length) < 0) a = c+1; else b = c;
+  }
+  // of the ones starting with it, pick the first at or after start:
+  int found = -1;
+  int first = -1;
+  for (; a < n && !strncasecmp(array[sorted_[a]], prefix, length); a++) {
+    int i = sorted_[a];
+    if (first < 0 || i < first) first = i;
+    if (i >= start && (found < 0 || i < found)) found = i;
+  }
+  return found >= 0 ? found : first;
+}
+
 /*! \fn void StringArray::set(const char*const* array, int n)
   Make it return \a n labels from \a array. The array and strings
   are \e not copied, they should be in static memory!
@@ -120,6 +189,7 @@ const char* StringArray::label(const Menu*, int index) {
   If \a array is null then children is set to zero.
 */
 void StringArray::set(const char*const* array) {
+  delete[] sorted_; sorted_ = 0;
   this->array = array;
   for (children_ = 0; array && array[children_]; children_++);
 }
@@ -137,6 +207,7 @@ void StringArray::set(const char*const* array) {
   good name for it...
 */
 void StringArray::set(const char* s) {
+  delete[] sorted_; sorted_ = 0;
   if (!s || !*s) {children_ = 0; return;}
   const char* temp[256];
   int n = 0;
@@ -150,3 +221,86 @@ void StringArray::set(const char* s) {
   array = t;
   for (; n--;) t[n] = temp[n];
 }
+
+/*! \class fltk::MappedStringList
+
+  This subclass of List allows a Menu or Browser to display each line
+  of a file. The file is mapped into memory with SharedImage::map_file()
+  rather than read, and load() only makes an index of where each line
+  starts, so a very large file loads quickly and uses very little
+  memory besides what the system uses to cache the file. Only the
+  labels that are drawn or measured are copied, one at a time.
+
+  Browser::load(filename, true) makes one of these for the browser.
+  The file must not be changed while it is mapped.
+*/
+int MappedStringList::children(const Menu*) {return children_;}
+
+/*! Returns a copy of the line without the newline. This is only
+  good until label() is called again. */
+const char* MappedStringList::label(const Menu*, int index) {
+  if (index < 0 || index >= children_) return 0;
+  unsigned start = lines_[index];
+  unsigned end = lines_[index+1];
+  if (end > start && data_[end-1] == '\n') end--;
+  unsigned n = end-start;
+  if (n+1 > buffersize_) {
+    buffersize_ = n+1 > 2*buffersize_ ? n+1 : 2*buffersize_;
+    buffer_ = (char*)realloc(buffer_, buffersize_);
+  }
+  memcpy(buffer_, data_+start, n);
+  buffer_[n] = 0;
+  return buffer_;
+}
+
+/*! Unmaps the file and sets children() to zero. */
+void MappedStringList::clear() {
+  SharedImage::unmap_file(data_, size_);
+  data_ = 0;
+  size_ = 0;
+  free(lines_);
+  lines_ = 0;
+  children_ = 0;
+  free(buffer_);
+  buffer_ = 0;
+  buffersize_ = 0;
+}
+
+/*!
+  Map the file into memory and make the index of the lines in it.
+  Returns false if the file can't be opened or can't be mapped (files
+  must be smaller than 2GB). An empty file works and has no lines.
+  A last line without a newline at the end is included.
+*/
+bool MappedStringList::load(const char* filename) {
+  clear();
+  unsigned size = 0;
+  const uchar* data = SharedImage::map_file(filename, size);
+  if (!data) {
+    // map_file() does not do empty files:
+    FILE* f = fopen(filename, "rb");
+    if (!f) return false;
+    bool empty = fgetc(f) == EOF && !ferror(f);
+    fclose(f);
+    return empty;
+  }
+  data_ = data;
+  size_ = size;
+  int n = 0;
+  int allocated = 1024;
+  lines_ = (unsigned*)malloc(allocated*sizeof(unsigned));
+  const uchar* p = data;
+  const uchar* e = data+size;
+  while (p < e) {
+    if (n+1 >= allocated) {
+      allocated *= 2;
+      lines_ = (unsigned*)realloc(lines_, allocated*sizeof(unsigned));
+    }
+    lines_[n++] = unsigned(p-data);
+    p = (const uchar*)memchr(p, '\n', e-p);
+    p = p ? p+1 : e;
+  }
+  lines_[n] = size;
+  children_ = n;
+  return true;
+}
@@ -28,6 +28,7 @@
 #include <fltk/math.h>
 #include <fltk/run.h>
 #include <fltk/draw.h>
+#include <fltk/trace.h>
 #include <stdlib.h>
 #include <config.h>
 #include <ctype.h>
@@ -50,12 +51,14 @@ using namespace fltk;
   local member variable is set. Notice that by setting a zero value
   you will indicate that it should return the parent value.
 
-  The method Widget::box(BOX) will create a dynamic() style for that
-  widget, which is a child of the original style, and set the box in
-  that style. This "unique" style is reused for any other changes to
-  that widget and it is deleted when the widget is deleted. Thus
-  changes to a single widget do not affect other widgets, but the
-  majority of widgets all share a Style structure.
+  The method Widget::box(BOX) will make the widget use a dynamic()
+  style, which is a child of the original style, with the box set in
+  that style. Any other widgets that set the same values on the same
+  original style share this dynamic() style, and it is deleted when
+  the last widget using it is deleted. Changes to a widget make it
+  use a different dynamic() style. Thus changes to a single widget do
+  not affect other widgets, but the majority of widgets all share a
+  Style structure.
 
   Occasionally it is useful to see if a field has been set. To do this
   you can directly access the local member variables using names like box_.
@@ -63,8 +66,9 @@ using namespace fltk;
 */
 
 /*! \fn bool Style::dynamic() const
-  True if this Style is unique to the Widget that owns it, and is not
-  shared with other Widgets.
+  True if this Style was made by a Widget set function such as
+  Widget::box(BOX). It is only shared with other Widgets that set the
+  same values, and must not be modified.
 */
 
 // Do not change the contents of this ever.  The themes depend on getting
@@ -244,48 +248,208 @@ NamedStyle* NamedStyle::first;
 static NamedStyle default_named_style("default", ::revert, &Widget::default_style);
 NamedStyle* Widget::default_style = &default_named_style;
 
+// Widgets set their own attributes by switching to a dynamic() style
+// that is a child of their current style and has the new value set.
+// Many widgets often set the same things (think of 20,000 table cells
+// that all set the same box and color), so identical dynamic styles are
+// shared: they are kept in a hash table keyed by the parent and all the
+// fields, and counted by refcount_. A shared style is never changed,
+// setting a value makes the widget use another one.
+
+static Style** shared_table;
+static unsigned shared_size;	// always a power of 2
+static unsigned shared_count;
+
+// The bytes that identify a dynamic style, parent_ through scrollbar_width_.
+// All Styles are memset to zero first so the padding matches:
+static inline const char* key_begin(const Style* s) {return (const char*)&s->parent_;}
+static inline size_t key_size(const Style* s) {
+  return (const char*)&s->dynamic_ - (const char*)&s->parent_;
+}
+
+static unsigned hash_style(const Style* s) {
+  const unsigned char* p = (const unsigned char*)key_begin(s);
+  const unsigned char* e = p + key_size(s);
+  unsigned h = 2166136261U;
+  for (; p < e; p++) h = (h ^ *p) * 16777619U;
+  return h;
+}
+
+static void shared_rehash(unsigned size) {
+  Style** t = (Style**)calloc(size, sizeof(Style*));
+  for (unsigned i = 0; i < shared_size; i++) {
+    for (Style* s = shared_table[i]; s;) {
+      Style* next = s->next_shared_;
+      Style** p = &t[s->hash_&(size-1)];
+      s->next_shared_ = *p;
+      *p = s;
+      s = next;
+    }
+  }
+  free(shared_table);
+  shared_table = t;
+  shared_size = size;
+}
+
+// Return the shared dynamic style identical to key, making it if needed,
+// with one more reference:
+static const Style* share_style(const Style& key) {
+  if (!shared_table) shared_rehash(256);
+  unsigned hash = hash_style(&key);
+  Style** p = &shared_table[hash&(shared_size-1)];
+  for (Style* s = *p; s; s = s->next_shared_) {
+    if (s->hash_ == hash && !memcmp(key_begin(s), key_begin(&key), key_size(&key))) {
+      s->refcount_++;
+      return s;
+    }
+  }
+  Style* s = new Style;
+  memcpy((void*)key_begin(s), key_begin(&key), key_size(&key));
+  s->dynamic_ = true;
+  s->refcount_ = 1;
+  s->hash_ = hash;
+  s->next_shared_ = *p;
+  *p = s;
+  if (++shared_count > shared_size) shared_rehash(2*shared_size);
+  return s;
+}
+
+// For memory_report():
+unsigned long fl_dynamic_styles() {return shared_count;}
+
+/*! Remove a reference to a dynamic() style, and delete it if this was
+  the last one. This is done by the Widget destructor and when a widget
+  switches to a different style. Does nothing if \a s is not dynamic. */
+void Style::release(const Style* s) {
+  if (!s || !s->dynamic() || --((Style*)s)->refcount_) return;
+  if (shared_table) {
+    Style** p = &shared_table[s->hash_&(shared_size-1)];
+    for (; *p; p = &((*p)->next_shared_)) {
+      if (*p == s) {*p = s->next_shared_; shared_count--; break;}
+    }
+  }
+  delete (Style*)s; // cast away const
+}
+
 /*! Copy the Style from another widget. Copying a style pointer from
-  another widget is not safe if that
-  style is dynamic() because it may change or be deleted.  This makes
-  another dynamic() copy if necessary. For non-dynamic styles the
-  pointer is copied.  */
+  another widget is not safe if that style is dynamic() because it may
+  be deleted. This adds a reference to a dynamic() style so it remains
+  as long as this widget uses it. Returns false, as no new style is
+  ever made. */
 bool Widget::copy_style(const Style* t) {
   if (style_ == t) return false;
-  if (style_ && style_->dynamic()) delete (Style*)style_;
-  if (!t->dynamic()) {style_ = t; return false;}
-  Style* newstyle = new Style;
-  newstyle->parent_ = (Style*)t;
-  style_ = newstyle;
-  return true;
+  if (style_) Style::release(style_);
+  if (t->dynamic()) ((Style*)t)->refcount_++;
+  style_ = t;
+  return false;
 }
 
-// Widgets set their own attributes by (possibly) creating a unique copy
-// of their current style and setting it there.  Because this copy does
-// not have any children the recursive search is not needed:
-
-static Style* unique_style(const Style* & pointer) {
-  if (pointer->dynamic()) return (Style*)pointer;
-  Style* newstyle = new Style();
-  newstyle->dynamic_ = true;
-  newstyle->parent_ = (Style*)pointer;
-  pointer = newstyle;
-  return newstyle;
+/*! Set every field that is not zero in \a changes, as though the set
+  function for each one was called, but switching to a shared
+  dynamic() style only once instead of once per field. The parent_
+  of \a changes is ignored. This is used by build_widgets(). */
+void Widget::set_style_fields(const Style& changes) {
+  Style key;
+  if (style_->dynamic()) memcpy((void*)key_begin(&key), key_begin(style_), key_size(style_));
+  else key.parent_ = style_;
+  bool changed = false;
+#define change_field(FIELD) \
+  if (changes.FIELD##_ && changes.FIELD##_ != key.FIELD##_) { \
+    key.FIELD##_ = changes.FIELD##_; changed = true;}
+  change_field(box);
+  change_field(buttonbox);
+  change_field(focusbox);
+  change_field(glyph);
+  change_field(labelfont);
+  change_field(textfont);
+  change_field(labeltype);
+  change_field(color);
+  change_field(alt_color);
+  change_field(textcolor);
+  change_field(selection_color);
+  change_field(selection_textcolor);
+  change_field(buttoncolor);
+  change_field(labelcolor);
+  change_field(highlight_color);
+  change_field(highlight_textcolor);
+  change_field(labelsize);
+  change_field(textsize);
+  change_field(leading);
+  change_field(scrollbar_align);
+  change_field(scrollbar_width);
+#undef change_field
+  if (!changed) return;
+  const Style* old = style_;
+  style_ = share_style(key);
+  Style::release(old);
 }
 
-// Retrieve/set values from a style, using parent's value if not in child:
+// Retrieve/set values from a style, using parent's value if not in child.
+// Searching the parents for every call is slow, as draw() code asks for
+// the same values over and over. So the first call fills in a Resolved
+// copy with all the values found, and later calls return from that until
+// Style::generation_ is changed. Anything that may change a Style that
+// has already been used must call Style::changed(), this is done by all
+// the Style set functions and themes and fltk::redraw(). The Widget set
+// functions never change a style that is in use, see share_style(). Code that sets the
+// underscore fields directly should call one of them afterwards.
+
+unsigned Style::generation_ = 1;
+
+/*!
+  Fill in the Resolved copy by searching this style and its parents
+  for each field. This is done by resolved() if the copy is missing or
+  Style::changed() has been called since it was made.
+*/
+const Style::Resolved& Style::resolve() const {
+  // Fill in a local copy first, as lock_shared() threads may be reading
+  // the old one, which has the same values unless a style was changed:
+  Resolved r;
+  memset((void*)&r, 0, sizeof(r));
+  for (const Style* s = this; s; s = s->parent_) {
+#define resolve_field(FIELD) if (!r.FIELD) r.FIELD = s->FIELD##_
+    resolve_field(box);
+    resolve_field(buttonbox);
+    resolve_field(focusbox);
+    resolve_field(glyph);
+    resolve_field(labelfont);
+    resolve_field(textfont);
+    resolve_field(labeltype);
+    resolve_field(color);
+    resolve_field(textcolor);
+    resolve_field(selection_color);
+    resolve_field(selection_textcolor);
+    resolve_field(buttoncolor);
+    resolve_field(labelcolor);
+    resolve_field(highlight_color);
+    resolve_field(highlight_textcolor);
+    resolve_field(labelsize);
+    resolve_field(textsize);
+    resolve_field(leading);
+    resolve_field(scrollbar_align);
+    resolve_field(scrollbar_width);
+#undef resolve_field
+  }
+  // copies are usually changed directly, so don't trust it next time:
+  r.generation = uncached_ ? 0 : generation_;
+  if (!resolved_) resolved_ = new Resolved;
+  *resolved_ = r;
+  return *resolved_;
+}
 
 #ifndef DOXYGEN
 #define style_functions(TYPE,FIELD)	\
 TYPE Widget::FIELD() const {return style()->FIELD();} \
-TYPE Style::FIELD() const {		\
-  for (const Style* s = this;;) {	\
-    if (s->FIELD##_) return s->FIELD##_;\
-    s = s->parent_;			\
-    if (!s) return 0;			\
-  }					\
-}					\
+TYPE Style::FIELD() const {return resolved().FIELD;} \
 void Widget::FIELD(TYPE v) {		\
-  unique_style(style_)->FIELD##_ = v;	\
+  if (style_->dynamic() && style_->FIELD##_ == v) return; \
+  Style key;				\
+  if (style_->dynamic()) memcpy((void*)key_begin(&key), key_begin(style_), key_size(style_)); \
+  else key.parent_ = style_;		\
+  key.FIELD##_ = v;			\
+  const Style* old = style_;		\
+  style_ = share_style(key);		\
+  Style::release(old);			\
 }
 
 style_functions(Box*,	box		)
@@ -395,22 +559,23 @@ const Style* fltk::drawstyle_ = Widget::default_style;
 void fltk::drawstyle(const Style* style, Flags flags) {
   drawstyle_ = style;
   drawflags_ = flags;
+  const Style::Resolved& r = style->resolved();
   // this is not correct! It should search the styles in order and
   // decide what to do as it searches. For instance highlight_textcolor
   // should only be used if set before or at the highlight_color style.
   Color bg, fg;
-  if ((flags & HIGHLIGHT) && (bg = style->highlight_color())) {
-    fg = contrast(style->highlight_textcolor(), bg);
+  if ((flags & HIGHLIGHT) && (bg = r.highlight_color)) {
+    fg = contrast(r.highlight_textcolor, bg);
   } else {
-    if (flags & OUTPUT) {bg = style->buttoncolor(); fg = style->labelcolor();}
-    else {bg = style->color(); fg = style->textcolor();}
+    if (flags & OUTPUT) {bg = r.buttoncolor; fg = r.labelcolor;}
+    else {bg = r.color; fg = r.textcolor;}
     // fg = contrast(fg, bg);this messes up things
   }
   if (flags & INACTIVE_R) fg = inactive(fg,bg);
   setcolor(fg);
   setbgcolor(bg);
-  if (flags & OUTPUT) setfont(style->labelfont(), style->labelsize());
-  else setfont(style->textfont(), style->textsize());
+  if (flags & OUTPUT) setfont(r.labelfont, r.labelsize);
+  else setfont(r.textfont, r.textsize);
 }
 
 /*! \class fltk::NamedStyle
@@ -432,6 +597,78 @@ void fltk::drawstyle(const Style* style, Flags flags) {
   It is also used to undo theme changes when fltk::reset_theme()
   is called.  */
 
+////////////////////////////////////////////////////////////////
+// Hash table of the NamedStyles by name, so themes looking up dozens
+// of them don't search the whole list each time. It uses quadratic
+// probing like the one in Symbol.cxx. It is built from the list the
+// first time find() is called, new styles are added to it, and it is
+// built again if StyleSet switches NamedStyle::first to another list.
+
+static NamedStyle** named_table;
+static int named_table_size;	// always prime
+static int named_count;
+static NamedStyle* named_table_first; // NamedStyle::first it was built from
+
+// Names match if they are the same ignoring case, underscores and spaces:
+static unsigned named_hash(const char* s) {
+  unsigned h = 0;
+  for (; *s; s++) if (*s != '_' && *s != ' ') h = 37*h + tolower(*s);
+  return h;
+}
+
+static bool named_match(const char* a, const char* b) {
+  for (;;) {
+    while (*a == '_' || *a == ' ') a++;
+    while (*b == '_' || *b == ' ') b++;
+    if (tolower(*a) != tolower(*b)) return false;
+    if (!*a) return true;
+    a++;
+    b++;
+  }
+}
+
+// returns hash entry if it exists, or the empty slot for it:
+static int named_index(const char* name) {
+  unsigned pos = named_hash(name) % named_table_size;
+  for (unsigned i = 0;;) {
+    NamedStyle* s = named_table[pos];
+    if (!s || named_match(s->name, name)) return pos;
+    pos += 2 * ++i - 1;
+    pos %= named_table_size;
+  }
+}
+
+// The list has the newest first, and a newer style replaces an
+// older one of the same name:
+static void named_add(NamedStyle* s, bool replace) {
+  if (!s->name) return;
+  int pos = named_index(s->name);
+  if (named_table[pos]) {if (replace) named_table[pos] = s; return;}
+  named_table[pos] = s;
+  named_count++;
+}
+
+static void build_named_table() {
+  int n = 0;
+  NamedStyle* p;
+  for (p = NamedStyle::first; p; p = p->next) n++;
+  // figure out a size that is prime and more than twice that:
+  n = 2*n+113;
+  for (int i = 3; i*i <= n; i += 2) while (n%i == 0) {i = 3; n += 2;}
+  delete[] named_table;
+  named_table_size = n;
+  named_table = new NamedStyle*[n];
+  memset(named_table, 0, n*sizeof(NamedStyle*));
+  named_count = 0;
+  for (p = NamedStyle::first; p; p = p->next) named_add(p, false);
+  named_table_first = NamedStyle::first;
+}
+
+static inline void update_named_table() {
+  if (!named_table || named_table_first != NamedStyle::first)
+    build_named_table();
+}
+
 static void plainrevert(Style*) {}
 
 NamedStyle::NamedStyle(const char* n, void (*revert)(Style*), NamedStyle** pds) {
@@ -443,6 +680,34 @@ NamedStyle::NamedStyle(const char* n, void (*revert)(Style*), NamedStyle** pds)
   NamedStyle::first = this;
   back_pointer = pds;
   name = n;
+  // keep the table up to date if it was built from the list this is added to:
+  if (named_table && named_table_first == next) {
+    named_table_first = this;
+    named_add(this, true);
+    if (named_count > named_table_size/2) build_named_table();
+  }
+}
+
+/*! You can call this to get a list of all the NamedStyles that
+  find() can return, which leaves out older ones with the same name.
+  They are returned out of a hash table and are in random order. To
+  get all of them in the order they were made, follow the \a next
+  pointers from NamedStyle::first instead.
+  \code
+  for (int i = 0;;) {
+    NamedStyle* style = NamedStyle::iterate(i);
+    if (!style) break;
+    ...
+  }
+  \endcode
+*/
+NamedStyle* NamedStyle::iterate(int& i) {
+  update_named_table();
+  while (i < named_table_size) {
+    NamedStyle* ret = named_table[i++];
+    if (ret) return ret;
+  }
+  return 0;
 }
 
 /*! The constructor clears the style to entirely zeros, including the
@@ -453,22 +718,39 @@ Style::Style() {
   memset((void*)this, 0, sizeof(*this));
 }
 
-Style* Style::find(const char* name) {
-  for (NamedStyle* p = NamedStyle::first; p; p = p->next) {
-    const char* a = p->name;
-    const char* b = name;
-    if (!a) continue;
-    for (;;) {
-      if (*a == '_') {
-	if (*b == ' ' || *b == '_');
-	else {a++; continue;}
-      } else if (tolower(*a) != tolower(*b)) break;
-      if (!*a && !*b) return p;
-      a++;
-      b++;
-    }
+/*! Copy all the fields. The copy is assumed to be a temporary that the
+  caller will change directly, so it does not remember the values found
+  by searching the parents. */
+Style::Style(const Style& s) {
+  memcpy((void*)this, (const void*)&s, sizeof(*this));
+  resolved_ = 0;
+  uncached_ = true;
+}
+
+/*! Same as the copy constructor. */
+Style& Style::operator=(const Style& s) {
+  if (this != &s) {
+    Resolved* r = resolved_;
+    memcpy((void*)this, (const void*)&s, sizeof(*this));
+    resolved_ = r;
+    uncached_ = true;
   }
-  return 0;
+  return *this;
+}
+
+Style::~Style() {
+  delete resolved_;
+}
+
+/*! Return the NamedStyle with this name, or null if there is none,
+  such as when that widget class is not linked into the program. Case,
+  underscores and spaces are ignored, so "Menu_Bar", "menu bar" and
+  "MenuBar" all find the same one. This is a hash table lookup so it
+  does not get slower as more styles are made.
+*/
+Style* Style::find(const char* name) {
+  update_named_table();
+  return named_table[named_index(name)];
 }
 
 ////////////////////////////////////////////////////////////////
@@ -523,10 +805,12 @@ static char theme_loaded;
 */
 void fltk::load_theme() {
   if (theme_loaded) return;
+  TraceScope trace(TRACE_STARTUP, "load_theme");
   theme_loaded = 2; // signal reset_theme to do nothing
   theme_();
   if (fl_bg_switch) set_background(fl_bg_switch);
   theme_loaded = 1;
+  Style::changed();
 }
 
 /*!
@@ -561,11 +845,14 @@ bool fltk::reset_theme() {
   for (NamedStyle* p = NamedStyle::first; p; p = p->next) {
     if (p->name) {
       const Style* savep = p->parent_;
+      Style::Resolved* saver = p->resolved_;
       memset((void*)p, 0, sizeof(Style));
       p->parent_ = savep;
+      p->resolved_ = saver;
       p->revertfunc(p);
     }
   }
+  Style::changed();
   return true;
 }
 
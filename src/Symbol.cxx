@@ -391,7 +391,11 @@ bool Symbol::is_frame() const {return false;}
 
 /**************** The routines seen by the user *************************/
 
-// Internal class to define scalable square symbols:
+// Internal class to define scalable square symbols.
+// These are not cached. Recording them in a DisplayList keyed on the
+// symbol, size and color and replaying that was tried, and took about
+// twice as long as drawing them again: each is only a few vertices,
+// and it sends exactly the same requests to the X server.
 class SymbolSymbol : public Symbol {
   void (*drawit)(Color);
 public:
@@ -52,6 +52,9 @@ the arrow keys.
 The callback() of the TabGroup widget is called when
 the user changes the visible tab, and SHOW and HIDE events are passed
 to the children.
+
+If there are many cards, make each one an fltk::LazyGroup so its
+widgets are not made until the user first selects it.
 */
 
 #include <config.h>
@@ -63,32 +66,132 @@ to the children.
 #include <fltk/draw.h>
 #include <fltk/Tooltip.h>
 #include <stdlib.h>
+#include <string.h>
 
 using namespace fltk;
 
-// return the left edges of each tab (plus a fake left edge for a tab
-// past the right-hand one).  These position are actually of the left
-// edge of the slope.  They are either seperated by the correct distance
-// or by pager_->slope() or by zero.
-// Return value is the index of the selected item.
+// Measuring the labels is slow, so the widths are kept along with
+// what the label looked like so changes are noticed, and the positions
+// made from them by the pager are kept along with the selected tab,
+// shift() and width they were made for.
+namespace fltk {
+struct TabCache {
+  struct Key {
+    const char* label;
+    const Symbol* image;
+    Font* font;
+    float size;
+    LabelType* type;
+  };
+  int n, capacity;
+  Key* keys;
+  int* measured;	// width of each label plus pager spacing
+  int* p;		// n+1 positions returned by tab_positions()
+  int* w;		// n widths returned by tab_positions()
+  bool measured_ok;
+  bool positions_ok;
+  int selected, shift, width, spacing, result;
+};
+}
 
-int TabGroup::tab_positions(int* p, int* w) {
-  int i, selected = 0, numchildren = children(), width = 0;
-  p[0] = w[0] = 0;
-  for (i=0; i<numchildren; i++) {
+static void make_key(TabCache::Key& k, const Widget* o) {
+  k.label = o->label();
+  k.image = o->image();
+  k.font = o->labelfont();
+  k.size = o->labelsize();
+  k.type = o->labeltype();
+}
+
+static bool same_key(const TabCache::Key& k, const Widget* o) {
+  return k.label == o->label() && k.image == o->image() &&
+    k.font == o->labelfont() && k.size == o->labelsize() &&
+    k.type == o->labeltype();
+}
+
+/*! Same as tab_positions(int*,int*) but sets \a p and \a w to arrays
+  kept by the TabGroup, so it works for any number of children and
+  is fast if called repeatedly. If \a check_labels is true the labels
+  are checked for changes, otherwise only a change to the number of
+  children, the width, selected tab, or pager shift() causes the
+  positions to be figured out again. draw() checks the labels, so they
+  are only measured again if a change to them caused a redraw.
+*/
+int TabGroup::tab_positions(int*& p, int*& w, bool check_labels) {
+  TabCache* c = tabs_;
+  if (!c) {
+    c = tabs_ = new TabCache;
+    memset(c, 0, sizeof(TabCache));
+  }
+  int i, selected = 0, numchildren = children();
+  if (numchildren != c->n || !c->p) {
+    if (numchildren >= c->capacity) {
+      delete[] c->keys; delete[] c->measured; delete[] c->p; delete[] c->w;
+      c->capacity = numchildren+8;
+      c->keys = new TabCache::Key[c->capacity];
+      c->measured = new int[c->capacity];
+      c->p = new int[c->capacity+1];
+      c->w = new int[c->capacity];
+    }
+    c->n = numchildren;
+    c->measured_ok = false;
+  }
+  p = c->p;
+  w = c->w;
+  for (i = 0; i < numchildren; i++) {
     Widget* o = child(i);
     if (o->visible()) selected = i;
-    int wt = 300; int ht = 300; // rather arbitrary choice for max size
-    o->measure_label(wt, ht);
-    w[i] = wt+pager_->spacing(); // slope + extra_space
+    if (check_labels && c->measured_ok && !same_key(c->keys[i], o))
+      c->measured_ok = false;
+  }
+  const int spacing = pager_->spacing();
+  if (!c->measured_ok || spacing != c->spacing) {
+    for (i = 0; i < numchildren; i++) {
+      Widget* o = child(i);
+      int wt = 300; int ht = 300; // rather arbitrary choice for max size
+      o->measure_label(wt, ht);
+      c->measured[i] = wt+spacing; // slope + extra_space
+      make_key(c->keys[i], o);
+    }
+    c->spacing = spacing;
+    c->measured_ok = true;
+    c->positions_ok = false;
+  }
+  if (c->positions_ok && selected == c->selected &&
+      pager_->shift() == c->shift && this->w() == c->width)
+    return c->result;
+
+  int width = 0;
+  p[0] = w[0] = 0;
+  for (i = 0; i < numchildren; i++) {
+    w[i] = c->measured[i];
     width += w[i];
     p[i+1] = width;
   }
-  int r = pager_->available_width(this); 
-  if (width <= r) return selected;
+  c->selected = selected;
+  c->width = this->w();
+  c->positions_ok = true;
+  int r = pager_->available_width(this);
+  if (width <= r) c->result = selected;
+  else c->result = pager_->update_positions(this, numchildren, selected, width, r, p, w);
+  // the pager may change shift(), remember what it was left at:
+  c->shift = pager_->shift();
+  return c->result;
+}
 
-  return pager_->update_positions(this, numchildren,selected, width, r, p, w);
+// return the left edges of each tab (plus a fake left edge for a tab
+// past the right-hand one).  These position are actually of the left
+// edge of the slope.  They are either seperated by the correct distance
+// or by pager_->slope() or by zero.
+// Return value is the index of the selected item.
 
+int TabGroup::tab_positions(int* p, int* w) {
+  int *cp, *cw;
+  int selected = tab_positions(cp, cw, true);
+  int n = children();
+  memcpy(p, cp, (n+1)*sizeof(int));
+  if (n) memcpy(w, cw, n*sizeof(int));
+  else w[0] = 0;
+  return selected;
 }
 
 // return space needed for tabs.  Negative to put them on the bottom:
@@ -326,19 +429,18 @@ extern Widget* fl_did_clipping;
 #endif
 
 static int H;
-static int p[128];
 void TabGroup::draw() {
   Widget *v = selected_child();
 
   H = tab_height();
+  int *p, *w;
+  int selected = tab_positions(p, w, true);
 
   // draw the tabs if needed:
   if (damage() & (DAMAGE_VALUE|DAMAGE_ALL)) {
     if ( damage() & DAMAGE_ALL ) {
       draw_tab_background();
     }
-    int w[128];
-    int selected = tab_positions(p,w);
     int i;
 
     if (!pager_->draw_tabs(this, selected, p, w)) { // no custom draw :
@@ -488,6 +590,7 @@ void TabGroup::pager(TabGroupPager * value) {
   if (value && pager_!=value) {
       if (pager_) delete pager_; 
       pager_= value->clone();
+      if (tabs_) tabs_->positions_ok = false;
       redraw();
   } 
 }
@@ -522,6 +625,18 @@ TabGroup::TabGroup(int X,int Y,int W, int H, const char *l,bool begin)
   style(default_style);
   focus_index(0);
   pager_ = default_pager_->clone();
+  tabs_ = 0;
+}
+
+TabGroup::~TabGroup() {
+  delete pager_;
+  if (tabs_) {
+    delete[] tabs_->keys;
+    delete[] tabs_->measured;
+    delete[] tabs_->p;
+    delete[] tabs_->w;
+    delete tabs_;
+  }
 }
 
 // End of "$Id$".
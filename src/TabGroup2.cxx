@@ -81,6 +81,24 @@ private:
 ////////////////////////////////////////////////////////////////////////////////////
 TabGroupPager* TabGroup::default_pager_= new MenuTabPager();
 
+// Return the first tab i where x < p[i+1]+(i<selected ? left : right),
+// or -1. The positions only increase, so this is a binary search of
+// the tabs left of the selected one and then of the rest:
+static int tab_at(const int* p, int n, int selected, int x, int left, int right) {
+    int a = 0, b = selected;
+    while (a < b) {
+	int c = (a+b)/2;
+	if (x < p[c+1]+left) b = c; else a = c+1;
+    }
+    if (a < selected) return a;
+    b = n;
+    while (a < b) {
+	int c = (a+b)/2;
+	if (x < p[c+1]+right) b = c; else a = c+1;
+    }
+    return a < n ? a : -1;
+}
+
 int TabGroupPager::available_width(TabGroup *g ) const {
     return g->w() - this->slope()-1;
 }
@@ -110,7 +128,7 @@ int ShrinkTabPager::update_positions(TabGroup* g, int numchildren, int& selected
 	for (i = selected+1; i <= numchildren; i++) tab_pos[i] = available_width;
 	return selected ;
     }
-    int w2[128];
+    int* w2 = new int[numchildren];
     for (i = 0; i < numchildren; i++) w2[i] = tab_width[i];
     i = numchildren-1;
     int j = 0;
@@ -145,6 +163,7 @@ int ShrinkTabPager::update_positions(TabGroup* g, int numchildren, int& selected
 	cumulated_width += w2[i];
 	tab_pos[i+1] = cumulated_width;
     }
+    delete[] w2;
     return selected;
 }
 
@@ -158,14 +177,11 @@ int ShrinkTabPager::which(TabGroup* g, int event_x,int event_y) {
 	if (event_y > H || event_y < 0) return -1;
     }
     if (event_x < 0) return -1;
-    int p[128], w[128];
-    int selected = g->tab_positions(p, w);
+    int *p, *w;
+    int selected = g->tab_positions(p, w, false);
     int d = (event_y-(H>=0?0:g->h()))*slope()/H;
-    for (int i=0; i<g->children(); i++) {
-	if (event_x < p[i+1]+(i<selected ? slope() - d : d)) return i;
-    }
-    return -1;
-    
+    return tab_at(p, g->children(), selected, event_x, slope()-d, d);
+
 }
 ////////////////////////////////////////////////////////////////
 TabGroupPager* ShrinkTabPager::clone() const {
@@ -239,14 +255,11 @@ int MenuTabPager::which(TabGroup* g, int event_x,int event_y) {
 	if (event_y > H || event_y < 0) return -1;
     }
     if (event_x < 0) return -1;
-    int p[128], w[128];
-    int selected = g->tab_positions(p, w);
+    int *p, *w;
+    int selected = g->tab_positions(p, w, false);
     int d = (event_y-(H>=0?0:g->h()))*slope()/H;
-    for (int i=0; i<g->children(); i++) {
-	if (event_x < p[i+1]+(i<selected ? slope() - d : d)) return i;
-    }
-    return -1;
-    
+    return tab_at(p, g->children(), selected, event_x, slope()-d, d);
+
 }
 ////////////////////////////////////////////////////////////////
 #include <stdio.h>
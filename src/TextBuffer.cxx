@@ -25,6 +25,7 @@
 //     http://www.fltk.org/str.php
 //
 
+#include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fltk/string.h>
@@ -33,6 +34,14 @@
 #include <fltk/ask.h>
 #include <fltk/error.h>
 #include <fltk/TextBuffer.h>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
 
 // Return number of bytes that a legal UTF-8 encoding starting with cc
 // will use. Returns 1 if cc cannot start an encoding.
@@ -84,34 +93,468 @@ static const char *ControlCodeTable[32] = {
   "can", "em", "sub", "esc", "fs", "gs", "rs", "us"};
 #endif
 
-static char* undobuffer;
-static int undobufferlength;
-static TextBuffer* undowidget;
-static int undoat;	            /// points after insertion
-static int undocut;	            /// number of characters deleted there
-static int undoinsert;	        /// number of characters inserted
-static int undoyankcut;	        /// length of valid contents of buffer, even if undocut=0
-
-static void undobuffersize(int n) {
-  if (n > undobufferlength) {
-    if (undobuffer) {
-      do {undobufferlength *= 2;} while (undobufferlength < n);
-      undobuffer = (char*)realloc(undobuffer, undobufferlength);
+/*
+ * Undo log. Each change is kept as the position, the number of bytes
+ * deleted and inserted there, and the deleted bytes, which are
+ * appended to one arena for the whole stack. The inserted bytes are
+ * not stored, they are still in the buffer and are copied out when
+ * the change is undone, to make the record that redoes it. Typing and
+ * backspacing merge into the record on top, and a begin_batch() /
+ * end_batch() pair makes one step of all the records in it, so a
+ * replace-all is undone at once and only stores the replaced words.
+ */
+namespace fltk {
+struct TextUndoRecord {
+  int pos;		// where the change is
+  int ndeleted;		// bytes stored at text+bytes to put back
+  int ninserted;	// bytes at pos to remove
+  int bytes;		// offset in the arena
+  bool more;		// the record below is part of the same step
+};
+
+struct TextUndoStack {
+  TextUndoRecord* r;
+  int n, size;
+  char* text;
+  int used, textsize;
+};
+
+struct TextUndo {
+  TextUndoStack undo;
+  TextUndoStack redo;
+  int limit;		// bytes the undo stack may use
+  bool sealed;		// don't merge a new change into the top record
+  bool batchfirst;	// next record starts the batch's step
+  bool busy;		// undo() or redo() is changing the buffer
+};
+}
+
+static TextUndoRecord* undo_push(TextUndoStack& s, int pos, int ndeleted,
+                                 int ninserted, bool more) {
+  if (s.n >= s.size) {
+    s.size = s.size ? 2*s.size : 64;
+    s.r = (TextUndoRecord*)realloc(s.r, s.size*sizeof(TextUndoRecord));
+  }
+  if (s.used + ndeleted > s.textsize) {
+    do {s.textsize = s.textsize ? 2*s.textsize : 1024;}
+    while (s.used + ndeleted > s.textsize);
+    s.text = (char*)realloc(s.text, s.textsize);
+  }
+  TextUndoRecord* r = s.r + s.n++;
+  r->pos = pos;
+  r->ndeleted = ndeleted;
+  r->ninserted = ninserted;
+  r->bytes = s.used;
+  r->more = more;
+  s.used += ndeleted;
+  return r;
+}
+
+// make room for n more deleted bytes in the top record
+static char* undo_grow(TextUndoStack& s, int n) {
+  if (s.used + n > s.textsize) {
+    do {s.textsize *= 2;} while (s.used + n > s.textsize);
+    s.text = (char*)realloc(s.text, s.textsize);
+  }
+  s.r[s.n-1].ndeleted += n;
+  s.used += n;
+  return s.text + s.r[s.n-1].bytes;
+}
+
+static void undo_clear(TextUndoStack& s) {
+  free(s.r); free(s.text);
+  s.r = 0; s.text = 0;
+  s.n = s.size = s.used = s.textsize = 0;
+}
+
+static int undo_memory(const TextUndoStack& s) {
+  return s.used + s.n*int(sizeof(TextUndoRecord));
+}
+
+/* Drop the oldest steps until the stack fits in limit, always keeping
+   the newest step. */
+static void undo_trim(TextUndoStack& s, int limit) {
+  if (limit <= 0 || undo_memory(s) <= limit) return;
+  int top = s.n-1;
+  while (top > 0 && s.r[top].more) top--;
+  int memory = undo_memory(s);
+  int j = 0;
+  while (j < top && memory > limit) {
+    int k = j+1;
+    while (k < top && s.r[k].more) k++;
+    memory -= (s.r[k].bytes - s.r[j].bytes)
+      + (k-j)*int(sizeof(TextUndoRecord));
+    j = k;
+  }
+  if (!j) return;
+  int off = s.r[j].bytes;
+  memmove(s.text, s.text+off, s.used-off);
+  s.used -= off;
+  s.n -= j;
+  memmove(s.r, s.r+j, s.n*sizeof(TextUndoRecord));
+  for (int i = 0; i < s.n; i++) s.r[i].bytes -= off;
+  s.r[0].more = false;
+  if (s.textsize > 4096 && s.used < s.textsize/4) {
+    s.textsize /= 2;
+    s.text = (char*)realloc(s.text, s.textsize);
+  }
+}
+
+/*
+ * Piece table storage. The text is a list of pieces, each pointing at
+ * some bytes in a TextBlock. Inserted text is appended to the buffer's
+ * current block and never changed after that, so an edit only changes
+ * the list. The list is kept in a treap (a randomly balanced binary
+ * tree) ordered by position, with the number of bytes under each node,
+ * so finding, splitting and joining it at a position is O(log n).
+ *
+ * Nodes and blocks are reference counted, and a node is copied before
+ * it is changed if anything else refers to it. This makes a snapshot()
+ * just another reference to the root.
+ */
+namespace fltk {
+struct TextBlock {
+  int refs;
+  int size;		// bytes allocated
+  int used;		// bytes written, pieces only point at these
+  char* data;
+  bool mapped;		// data is a read-only mapping of a file
+};
+
+struct TextPiece {
+  int refs;
+  unsigned priority;	// larger than the priority of the children
+  TextPiece* left;
+  TextPiece* right;
+  TextBlock* block;
+  const char* text;	// points into block
+  int length;
+  int total;		// length of this and all the children
+};
+}
+
+#define PIECE_BLOCK_SIZE (64*1024)
+
+static void block_unref(TextBlock* b) {
+  if (b && !--b->refs) {
+    if (!b->mapped) free(b->data);
+#ifdef _WIN32
+    else UnmapViewOfFile(b->data);
+#else
+    else munmap(b->data, b->size);
+#endif
+    delete b;
+  }
+}
+
+static void piece_unref(TextPiece* t) {
+  while (t && !--t->refs) {
+    piece_unref(t->left);
+    block_unref(t->block);
+    TextPiece* r = t->right;
+    delete t;
+    t = r;
+  }
+}
+
+static inline int piece_total(const TextPiece* t) {return t ? t->total : 0;}
+
+static inline void piece_update(TextPiece* t) {
+  t->total = piece_total(t->left) + t->length + piece_total(t->right);
+}
+
+static TextPiece* piece_new(TextBlock* b, const char* text, int length) {
+  static unsigned seed = 2463534242U;
+  seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+  TextPiece* t = new TextPiece;
+  t->refs = 1;
+  t->priority = seed;
+  t->left = t->right = 0;
+  t->block = b; b->refs++;
+  t->text = text;
+  t->length = t->total = length;
+  return t;
+}
+
+// Return a node that only the caller refers to, copying t if needed.
+// The caller's reference to t is given up:
+static TextPiece* piece_unshare(TextPiece* t) {
+  if (t->refs == 1) return t;
+  TextPiece* c = new TextPiece(*t);
+  c->refs = 1;
+  if (c->left) c->left->refs++;
+  if (c->right) c->right->refs++;
+  c->block->refs++;
+  t->refs--;
+  return c;
+}
+
+// Split the tree t at byte pos into l and r, giving up the reference to t:
+static void piece_split(TextPiece* t, int pos, TextPiece** l, TextPiece** r) {
+  if (!t) {*l = *r = 0; return;}
+  t = piece_unshare(t);
+  int left = piece_total(t->left);
+  if (pos <= left) {
+    piece_split(t->left, pos, l, &t->left);
+    piece_update(t);
+    *r = t;
+  } else if (pos >= left + t->length) {
+    piece_split(t->right, pos - left - t->length, &t->right, r);
+    piece_update(t);
+    *l = t;
+  } else {
+    // cut the piece in two:
+    int k = pos - left;
+    TextPiece* n = piece_new(t->block, t->text + k, t->length - k);
+    n->priority = t->priority;
+    n->right = t->right;
+    t->right = 0;
+    t->length = k;
+    piece_update(n);
+    piece_update(t);
+    *l = t;
+    *r = n;
+  }
+}
+
+// Join a and b, all of a goes before b. The references are given up:
+static TextPiece* piece_merge(TextPiece* a, TextPiece* b) {
+  if (!a) return b;
+  if (!b) return a;
+  if (a->priority > b->priority) {
+    a = piece_unshare(a);
+    a->right = piece_merge(a->right, b);
+    piece_update(a);
+    return a;
+  } else {
+    b = piece_unshare(b);
+    b->left = piece_merge(a, b->left);
+    piece_update(b);
+    return b;
+  }
+}
+
+// If the piece that ends at pos also ends at text, make it n bytes longer
+// rather than adding another piece. This is what happens when typing:
+static bool piece_extend(TextPiece* t, int pos, const char* text, int n) {
+  if (!t || t->refs != 1) return false;
+  int left = piece_total(t->left);
+  if (pos <= left) {
+    if (!piece_extend(t->left, pos, text, n)) return false;
+  } else if (pos < left + t->length) {
+    return false;
+  } else if (pos == left + t->length) {
+    if (t->text + t->length != text) return false;
+    t->length += n;
+  } else {
+    if (!piece_extend(t->right, pos - left - t->length, text, n)) return false;
+  }
+  t->total += n;
+  return true;
+}
+
+// Copy all the text in the tree to dest:
+static char* piece_copy(const TextPiece* t, char* dest) {
+  for (; t; t = t->right) {
+    dest = piece_copy(t->left, dest);
+    memcpy(dest, t->text, t->length);
+    dest += t->length;
+  }
+  return dest;
+}
+
+static TextPiece* piece_from_text(const char* text, int n) {
+  if (n <= 0) return 0;
+  TextBlock* b = new TextBlock;
+  b->refs = 0;
+  b->mapped = false;
+  b->data = (char*)malloc(n);
+  b->size = b->used = n;
+  memcpy(b->data, text, n);
+  return piece_new(b, b->data, n);
+}
+
+// Return space for n bytes at the end of the current block:
+char* TextBuffer::piece_reserve_(int n) {
+  TextBlock* b = addblock_;
+  if (!b || b->used + n > b->size) {
+    block_unref(b);
+    b = addblock_ = new TextBlock;
+    b->refs = 1;
+    b->size = n > PIECE_BLOCK_SIZE ? n : PIECE_BLOCK_SIZE;
+    b->used = 0;
+    b->mapped = false;
+    b->data = (char*)malloc(b->size);
+  }
+  char* p = b->data + b->used;
+  b->used += n;
+  return p;
+}
+
+// Put n bytes that were just written to piece_reserve_() at pos:
+void TextBuffer::piece_insert_(int pos, const char* text, int n) {
+  if (n <= 0 || piece_extend(pieces_, pos, text, n)) return;
+  TextPiece* l; TextPiece* r;
+  piece_split(pieces_, pos, &l, &r);
+  pieces_ = piece_merge(piece_merge(l, piece_new(addblock_, text, n)), r);
+}
+
+/**
+ * Return a pointer to the text around pos, and set start and end to
+ * the range of positions it is good for. pointer[start] is the
+ * character at start, and pointer[end-1] is the last one that can
+ * be found by indexing the pointer. pos must be in 0..length()-1.
+ */
+const char* TextBuffer::run_(int pos, int* start, int* end) const {
+  if (!piecetable_) {
+    if (pos < gapstart_) {
+      *start = 0;
+      *end = gapstart_;
+      return buf_;
+    }
+    *start = gapstart_;
+    *end = length_;
+    return buf_ + (gapend_ - gapstart_);
+  }
+  int base = 0;
+  const TextPiece* t = pieces_;
+  for (;;) {
+    int left = piece_total(t->left);
+    if (pos < left) {
+      t = t->left;
+    } else if (pos < left + t->length) {
+      *start = base + left;
+      *end = base + left + t->length;
+      return t->text - (base + left);
     } else {
-      undobufferlength = n+9;
-      undobuffer = (char*)malloc(undobufferlength);
+      pos -= left + t->length;
+      base += left + t->length;
+      t = t->right;
     }
   }
 }
 
+// Copy the text from start to end, which must be in range, to dest:
+void TextBuffer::copy_out_(char* dest, int start, int end) const {
+  while (start < end) {
+    int s, e;
+    const char* p = run_(start, &s, &e);
+    if (e > end) e = end;
+    memcpy(dest, p + start, e - start);
+    dest += e - start;
+    start = e;
+  }
+}
+
+/**
+ * Change how the text is stored. The default, GAP_BUFFER, keeps the
+ * text in one block of memory with an empty space at the last place
+ * it was edited. This is fast and small as long as the edits are near
+ * each other, but moving from one end of a big file to the other copies
+ * all of it. PIECE_TABLE keeps a tree of pieces of the text instead,
+ * so inserting and removing anywhere is O(log n), and snapshot() is
+ * O(1), at the cost of a little speed looking at the text. Changing
+ * the storage copies the text but does not call the modify callbacks,
+ * as the text is still the same.
+ */
+void TextBuffer::storage(Storage mode) {
+  bool p = (mode == PIECE_TABLE);
+  if (p == piecetable_) return;
+  if (p) {
+    TextPiece* t = piece_from_text(text(), length_);
+    free(buf_);
+    buf_ = 0;
+    gapstart_ = gapend_ = 0;
+    pieces_ = t;
+    piecetable_ = true;
+  } else {
+    char* b = (char*)malloc(length_ + PREFERRED_GAP_SIZE + 1);
+    copy_out_(b, 0, length_);
+    free(buf_);
+    buf_ = b;
+    gapstart_ = length_;
+    gapend_ = length_ + PREFERRED_GAP_SIZE;
+    piece_unref(pieces_);
+    pieces_ = 0;
+    block_unref(addblock_);
+    addblock_ = 0;
+    piecetable_ = false;
+  }
+}
+
+/**
+ * Return a copy of the current text that can be given to restore()
+ * later, for instance to undo a series of changes. It must be freed
+ * with release(). With PIECE_TABLE storage this takes constant time
+ * and memory, as the snapshot shares the pieces with the buffer until
+ * they are changed. With GAP_BUFFER storage the text is copied.
+ */
+TextPiece* TextBuffer::snapshot() {
+  if (!piecetable_) return piece_from_text(text(), length_);
+  if (pieces_) pieces_->refs++;
+  return pieces_;
+}
+
+/**
+ * Free a snapshot() of a buffer. This may be done after the buffer
+ * is destroyed.
+ */
+void TextBuffer::release(TextPiece* snapshot) {
+  piece_unref(snapshot);
+}
+
+/**
+ * Replace the entire contents of the buffer with a snapshot(),
+ * which may be of another buffer. The modify callbacks are called the
+ * same as text(const char*). The snapshot can be used again; it still
+ * has to be freed with release().
+ */
+void TextBuffer::restore(TextPiece* snapshot) {
+  call_predelete_callbacks(0, length_);
+
+  const char* deleted_text = text();
+  int deleted_length = length_;
+  char* oldbuf = buf_; // keep this until we are done w deleted_text
+  int insert_length = piece_total(snapshot);
+  undo_deleted_(0, deleted_length);
+
+  if (piecetable_) {
+    buf_ = 0;
+    if (snapshot) snapshot->refs++;
+    piece_unref(pieces_);
+    pieces_ = snapshot;
+    length_ = insert_length;
+  } else {
+      buf_ = (char*)malloc(insert_length + PREFERRED_GAP_SIZE);
+      piece_copy(snapshot, buf_);
+      length_ = gapstart_ = gapend_ = insert_length;
+  }
+  lineindex_free_();
+  undo_inserted_(0, insert_length);
+
+  update_selections(0, deleted_length, 0);
+  call_modify_callbacks(0, deleted_length, insert_length, 0, deleted_text);
+
+  free(oldbuf);
+}
+
 /**
  * Create an empty text buffer of a pre-determined size (use this to
  * avoid unnecessary re-allocation if you know exactly how much the buffer
  * will need to hold.
  */
+// Every TextBuffer, for memory_report():
+static TextBuffer** all_buffers;
+static int num_buffers, all_buffers_size;
+
 TextBuffer::TextBuffer(int requestedsize) {
+  if (num_buffers >= all_buffers_size) {
+    all_buffers_size = all_buffers_size ? 2*all_buffers_size : 16;
+    all_buffers = (TextBuffer**)realloc(all_buffers, all_buffers_size*sizeof(TextBuffer*));
+  }
+  all_buffers[num_buffers++] = this;
   length_ = 0;
-  buf_ = (char *)malloc(requestedsize + PREFERRED_GAP_SIZE);
+  buf_ = (char *)malloc(requestedsize + PREFERRED_GAP_SIZE + 1);
   gapstart_ = 0;
   gapend_   = PREFERRED_GAP_SIZE;
   tabdist_  = 8;
@@ -129,6 +572,17 @@ TextBuffer::TextBuffer(int requestedsize) {
   nullsubschar_ = '\0';
 
   mCanUndo = 1;
+  undo_ = 0;
+  undolimit_ = 4*1024*1024;
+  lineindex_ = 0;
+  piecetable_ = false;
+  pieces_ = 0;
+  addblock_ = 0;
+  batchdepth_ = 0;
+  batchchanged_ = batchrestyled_ = false;
+  batchtext_ = 0;
+  batchtextsize_ = 0;
+  loader_ = 0;
 
 #ifdef PURIFY
     { int i; for (i = gapstart_; i < gapend_; i++) buf_[i] = '.'; }
@@ -139,7 +593,15 @@ TextBuffer::TextBuffer(int requestedsize) {
  * Free a text buffer
  */
 TextBuffer::~TextBuffer() {
+  for (int i = num_buffers; i--;)
+    if (all_buffers[i] == this) {all_buffers[i] = all_buffers[--num_buffers]; break;}
+  cancel_load();
   free(buf_);
+  lineindex_free_();
+  piece_unref(pieces_);
+  block_unref(addblock_);
+  free(batchtext_);
+  clear_undo();
   if (nmodifyprocs_ != 0) {
     delete[] modifyprocs_;
     delete[] modifycbargs_;
@@ -150,6 +612,29 @@ TextBuffer::~TextBuffer() {
   }
 }
 
+/**
+ * Return about how many bytes the text, the space for inserting more
+ * (see gap_size()), and the undo history take. With PIECE_TABLE
+ * storage this counts the text once even if snapshot()s share it.
+ */
+unsigned long TextBuffer::mem_used() const {
+  unsigned long n = buf_ ? length_ + gap_size() + 1 : length_;
+  if (addblock_) n += addblock_->size - addblock_->used;
+  if (undo_) n += undo_memory(undo_->undo) + undo_memory(undo_->redo);
+  return n;
+}
+
+// For memory_report():
+void fl_text_buffer_memory(unsigned long& count, unsigned long& bytes,
+			   unsigned long& gaps) {
+  count = num_buffers;
+  bytes = gaps = 0;
+  for (int i = 0; i < num_buffers; i++) {
+    bytes += all_buffers[i]->mem_used();
+    gaps += all_buffers[i]->gap_size();
+  }
+}
+
 /**
  * Return the entire contents of the text buffer. Returned memory is
  * temporary and will only be usable until the next time the text is
@@ -158,6 +643,12 @@ TextBuffer::~TextBuffer() {
  * Unlike previous versions of fltk, DO NOT FREE THE RETURNED RESULT!
  */
 const char *TextBuffer::text() {
+  if (piecetable_) {
+    buf_ = (char*)realloc(buf_, length_+1);
+    copy_out_(buf_, 0, length_);
+    buf_[length_] = 0;
+    return buf_;
+  }
   if (!gapstart_ && length_) {
     buf_[length_+gapend_] = 0;
     return buf_+gapend_;
@@ -183,11 +674,21 @@ void TextBuffer::text(const char *t) {
   int deleted_length = length_;
   char* oldbuf = buf_; // keep this until we are done w deleted_text
   int insert_length = strlen(t);
+  undo_deleted_(0, deleted_length);
 
+  if (piecetable_) {
+    buf_ = 0;
+    piece_unref(pieces_);
+    pieces_ = piece_from_text(t, insert_length);
+    length_ = insert_length;
+  } else {
   /* Start a new buffer with a gap of PREFERRED_GAP_SIZE at end */
   buf_ = (char*)malloc(insert_length + PREFERRED_GAP_SIZE);
   length_ = gapstart_ = gapend_ = insert_length;
   strcpy(buf_, t);
+  }
+  lineindex_free_();
+  undo_inserted_(0, insert_length);
 
   /* Zero all of the existing selections */
   update_selections(0, deleted_length, 0);
@@ -205,7 +706,7 @@ void TextBuffer::text(const char *t) {
  */
 char *TextBuffer::text_range(int start, int end) {
   char *text;
-  int length, part1length;
+  int length;
   
   /* Make sure start and end are ok, and allocate memory for returned string.
      If start is bad, return "", if end is bad, adjust it. */
@@ -226,15 +727,7 @@ char *TextBuffer::text_range(int start, int end) {
   text = (char*)malloc(length+1);
   
   /* Copy the text from the buffer to the returned string */
-  if (end <= gapstart_) {
-      memcpy(text, &buf_[start], length);
-  } else if (start >= gapstart_) {
-      memcpy(text, &buf_[start+(gapend_-gapstart_)], length);
-  } else {
-      part1length = gapstart_ - start;
-      memcpy(text, &buf_[start], part1length);
-      memcpy(&text[part1length], &buf_[gapend_], length-part1length);
-  }
+  copy_out_(text, start, end);
   text[length] = '\0';
   return text;
 }
@@ -245,10 +738,8 @@ char *TextBuffer::text_range(int start, int end) {
 char TextBuffer::character(int pos) {
   if (pos < 0 || pos >= length_)
     return '\0';
-  if (pos < gapstart_)
-    return buf_[pos];
-  
-  return buf_[pos + gapend_-gapstart_];
+  int start, end;
+  return run_(pos, &start, &end)[pos];
 }
 
 /**
@@ -320,79 +811,211 @@ void TextBuffer::remove(int start, int end) {
 
 void TextBuffer::copy(TextBuffer *from_buf, int from_start, int from_end, int to_pos) {
   int copy_length = from_end - from_start;
-  int part1length;
-
-  /* Prepare the buffer to receive the new text.  If the new text fits in
-     the current buffer, just move the gap (if necessary) to where
-     the text should be inserted.  If the new text is too large, reallocate
-     the buffer with a gap large enough to accomodate the new text and a
-     gap of PREFERRED_GAP_SIZE */
-  if (copy_length > gapend_ - gapstart_)
-    reallocate_with_gap(to_pos, copy_length + PREFERRED_GAP_SIZE);
-  else if (to_pos != gapstart_)
-    move_gap(to_pos);
-  
-  /* Insert the new text (to_pos now corresponds to the start of the gap) */
-  if (from_end <= from_buf->gapstart_) {
-      memcpy(&buf_[to_pos], &from_buf->buf_[from_start], copy_length);
-  } else if (from_start >= from_buf->gapstart_) {
-      memcpy(&buf_[to_pos],
-            &from_buf->buf_[from_start+(from_buf->gapend_-from_buf->gapstart_)],
-            copy_length);
+
+  if (piecetable_) {
+    char* p = piece_reserve_(copy_length);
+    from_buf->copy_out_(p, from_start, from_end);
+    piece_insert_(to_pos, p, copy_length);
   } else {
-      part1length = from_buf->gapstart_ - from_start;
-      memcpy(&buf_[to_pos], &from_buf->buf_[from_start], part1length);
-      memcpy(&buf_[to_pos+part1length], &from_buf->buf_[from_buf->gapend_],
-            copy_length-part1length);
+    /* Prepare the buffer to receive the new text.  If the new text fits in
+       the current buffer, just move the gap (if necessary) to where
+       the text should be inserted.  If the new text is too large, reallocate
+       the buffer with a gap large enough to accomodate the new text and a
+       gap of PREFERRED_GAP_SIZE */
+    if (copy_length > gapend_ - gapstart_)
+      reallocate_with_gap(to_pos, copy_length + PREFERRED_GAP_SIZE);
+    else if (to_pos != gapstart_)
+      move_gap(to_pos);
+  
+    /* Insert the new text (to_pos now corresponds to the start of the gap) */
+    from_buf->copy_out_(&buf_[to_pos], from_start, from_end);
+    gapstart_ += copy_length;
   }
-  gapstart_ += copy_length;
   length_ += copy_length;
+  lineindex_inserted_(to_pos, copy_length);
   update_selections(to_pos, 0, copy_length);
+  undo_inserted_(to_pos, copy_length);
 }
 
-/**
- * Remove text according to the undo variables or insert text 
- * from the undo buffer.
+/*
+ * Return the undo log, creating it if needed.
  */
-int TextBuffer::undo(int *cursorPos) {
-  if (undowidget != this || (!undocut && !undoinsert &&!mCanUndo)) return 0;
+TextUndo* TextBuffer::undo_log_() {
+  if (!undo_) {
+    undo_ = (TextUndo*)calloc(1, sizeof(TextUndo));
+    undo_->limit = undolimit_;
+    undo_->batchfirst = batchdepth_ > 0;
+  }
+  return undo_;
+}
 
-  int ilen = undocut;
-  int xlen = undoinsert;
-  int b = undoat-xlen;
+/*
+ * Return the top record of the undo stack if a change may be merged
+ * into it.
+ */
+static TextUndoRecord* undo_mergeable(TextUndo* u) {
+  if (u->sealed || u->batchfirst || !u->undo.n) return 0;
+  return u->undo.r + u->undo.n - 1;
+}
 
-  if (xlen && undoyankcut && !ilen) {
-    ilen = undoyankcut;
+/*
+ * Record that the text from start to end is about to be deleted.
+ */
+void TextBuffer::undo_deleted_(int start, int end) {
+  if (!mCanUndo || start >= end) return;
+  TextUndo* u = undo_log_();
+  if (u->busy) return;
+  undo_clear(u->redo);
+  int n = end - start;
+  TextUndoRecord* r = undo_mergeable(u);
+  if (r && r->ninserted >= n && end == r->pos + r->ninserted
+      && start >= r->pos) {
+    // backspacing over text that was just typed
+    r->ninserted -= n;
+    if (!r->ninserted && !r->ndeleted) {
+      // nothing is left, don't merge the next change into the record
+      // below, and if the batch started with this one start it again
+      if (!r->more) u->batchfirst = batchdepth_ > 0;
+      u->undo.n--;
+      u->undo.used = r->bytes;
+      u->sealed = true;
+      return;
+    }
+  } else if (r && !r->ninserted && r->pos == end) {
+    // backspace, put these bytes in front of the ones deleted before
+    char* p = undo_grow(u->undo, n);
+    memmove(p + n, p, r->ndeleted - n);
+    copy_out_(p, start, end);
+    r->pos = start;
+  } else if (r && !r->ninserted && r->pos == start) {
+    // delete key
+    char* p = undo_grow(u->undo, n);
+    copy_out_(p + r->ndeleted - n, start, end);
+  } else {
+    r = undo_push(u->undo, start, n, 0, batchdepth_ && !u->batchfirst);
+    copy_out_(u->undo.text + r->bytes, start, end);
+    u->batchfirst = false;
   }
+  u->sealed = false;
+  undo_trim(u->undo, u->limit);
+}
 
-  if (xlen && ilen) {
-    undobuffersize(ilen+1);
-    undobuffer[ilen] = 0;
-    char *tmp = newstring(undobuffer);
-    replace(b, undoat, tmp);
-    if (cursorPos) *cursorPos = cursorposhint_;
-    delete[] tmp;
-  }
-  else if (xlen) {
-    remove(b, undoat);
-    if (cursorPos) *cursorPos = cursorposhint_;
-  }
-  else if (ilen) {
-    undobuffersize(ilen+1);
-    undobuffer[ilen] = 0;
-    insert(undoat, undobuffer);
-    if (cursorPos) *cursorPos = cursorposhint_;
-    undoyankcut = 0;
+/*
+ * Record that n bytes were inserted at pos.
+ */
+void TextBuffer::undo_inserted_(int pos, int n) {
+  if (!mCanUndo || n <= 0) return;
+  TextUndo* u = undo_log_();
+  if (u->busy) return;
+  undo_clear(u->redo);
+  TextUndoRecord* r = undo_mergeable(u);
+  if (r && pos == r->pos + r->ninserted) {
+    r->ninserted += n;
+  } else {
+    undo_push(u->undo, pos, 0, n, batchdepth_ && !u->batchfirst);
+    u->batchfirst = false;
   }
+  u->sealed = false;
+  undo_trim(u->undo, u->limit);
+}
 
+/*
+ * Pop a step off one stack, undoing its changes, and push the records
+ * that will do them again onto the other one.
+ */
+int TextBuffer::undo_apply_(bool redo, int *cursorPos) {
+  if (!undo_) return 0;
+  TextUndoStack& from = redo ? undo_->redo : undo_->undo;
+  TextUndoStack& to = redo ? undo_->undo : undo_->redo;
+  if (!from.n) return 0;
+  undo_->busy = true;
+  begin_batch();
+  bool first = true;
+  TextUndoRecord r;
+  do {
+    r = from.r[--from.n];
+    TextUndoRecord* t =
+      undo_push(to, r.pos, r.ninserted, r.ndeleted, !first);
+    copy_out_(to.text + t->bytes, r.pos, r.pos + r.ninserted);
+    first = false;
+    char* s = (char*)malloc(r.ndeleted + 1);
+    memcpy(s, from.text + r.bytes, r.ndeleted);
+    s[r.ndeleted] = 0;
+    from.used = r.bytes;
+    if (r.ninserted && r.ndeleted) replace(r.pos, r.pos + r.ninserted, s);
+    else if (r.ninserted) remove(r.pos, r.pos + r.ninserted);
+    else insert(r.pos, s);
+    free(s);
+  } while (r.more && from.n);
+  end_batch();
+  undo_->busy = false;
+  undo_->sealed = true;
+  if (redo) undo_trim(to, undo_->limit);
+  if (cursorPos) *cursorPos = cursorposhint_;
   return 1;
 }
 
 /**
- * Let the undo system know if we can undo changes.
+ * Undo the last change, or the last run of typing or backspacing, or
+ * all the changes done between a begin_batch() and end_batch(). Each
+ * call goes back one more step. Returns 0 if there is nothing to undo,
+ * otherwise the position after the change is put in \a cursorPos.
+ */
+int TextBuffer::undo(int *cursorPos) {
+  return undo_apply_(false, cursorPos);
+}
+
+/**
+ * Do a change again that was undone by undo(). Any other change to
+ * the buffer throws away what can be redone. Returns 0 if there is
+ * nothing to redo.
+ */
+int TextBuffer::redo(int *cursorPos) {
+  return undo_apply_(true, cursorPos);
+}
+
+/** Return true if undo() will do something. */
+bool TextBuffer::undoable() const {
+  return undo_ && undo_->undo.n;
+}
+
+/** Return true if redo() will do something. */
+bool TextBuffer::redoable() const {
+  return undo_ && undo_->redo.n;
+}
+
+/**
+ * Throw away all the changes that can be undone or redone.
+ */
+void TextBuffer::clear_undo() {
+  if (!undo_) return;
+  undo_clear(undo_->undo);
+  undo_clear(undo_->redo);
+  free(undo_);
+  undo_ = 0;
+}
+
+/**
+ * Set how many bytes the undo log may use, the default is 4 megabytes.
+ * The oldest steps are thrown away when it uses more than this, but the
+ * last step can always be undone no matter how large it is. Zero means
+ * no limit.
+ */
+void TextBuffer::undo_limit(int bytes) {
+  undolimit_ = bytes;
+  if (undo_) {
+    undo_->limit = bytes;
+    undo_trim(undo_->undo, bytes);
+  }
+}
+
+/**
+ * Let the undo system know if we can undo changes. Turning it off
+ * throws away the undo log.
  */
 void TextBuffer::canUndo(char flag) {
   mCanUndo = flag;
+  if (!flag) clear_undo();
 }
 
 /**
@@ -1043,28 +1666,270 @@ int TextBuffer::skip_displayed_characters_utf(int linestartpos, int nchars) {
   return pos;
 }
 
-/**
- * Count the number of newlines between startpos and endpos in buffer "buf".
- * The character at position "endpos" is not counted.
+/*
+ * Index of where the lines start, so that line numbers can be turned into
+ * positions and back without scanning the whole buffer. The text is
+ * divided into chunks of about LINEINDEX_CHUNK bytes, and the number of
+ * bytes and newlines in each is kept, along with two Fenwick trees that
+ * sum them. Finding a chunk is O(log n) and then at most one chunk has
+ * to be scanned. insert_() and remove_() keep it up to date; it is not
+ * built until something asks for a line number.
  */
-int TextBuffer::count_lines(int startpos, int endpos) {
-  int pos, gaplen = gapend_ - gapstart_;
-  int line_count = 0;
+#define LINEINDEX_CHUNK 4096
+
+namespace fltk {
+struct TextLineIndex {
+  int n;		// number of chunks, always at least 1
+  int alloc;
+  int* bytes;		// per-chunk counts
+  int* lines;
+  int* fbytes;		// Fenwick trees of the above, 1-based
+  int* flines;
+};
+}
+
+static void lineindex_reserve(TextLineIndex* x, int n) {
+  if (n <= x->alloc) return;
+  int a = x->alloc ? x->alloc : 16;
+  while (a < n) a *= 2;
+  x->bytes = (int*)realloc(x->bytes, a*sizeof(int));
+  x->lines = (int*)realloc(x->lines, a*sizeof(int));
+  x->fbytes = (int*)realloc(x->fbytes, (a+1)*sizeof(int));
+  x->flines = (int*)realloc(x->flines, (a+1)*sizeof(int));
+  x->alloc = a;
+}
+
+// Rebuild the Fenwick trees from the per-chunk counts in O(n):
+static void lineindex_sum(TextLineIndex* x) {
+  int i;
+  for (i = 1; i <= x->n; i++) {
+    x->fbytes[i] = x->bytes[i-1];
+    x->flines[i] = x->lines[i-1];
+  }
+  for (i = 1; i <= x->n; i++) {
+    int j = i + (i & -i);
+    if (j <= x->n) {
+      x->fbytes[j] += x->fbytes[i];
+      x->flines[j] += x->flines[i];
+    }
+  }
+}
 
-  pos = startpos;
-  while (pos < gapstart_) {
-    if (pos == endpos)
-      return line_count;
-    if (buf_[pos++] == '\n')
-      line_count++;
+static void lineindex_add(TextLineIndex* x, int k, int nbytes, int nlines) {
+  x->bytes[k] += nbytes;
+  x->lines[k] += nlines;
+  for (int i = k+1; i <= x->n; i += i & -i) {
+    x->fbytes[i] += nbytes;
+    x->flines[i] += nlines;
   }
-  while (pos < length_) {
-    if (pos == endpos)
-      return line_count;
-    if (buf_[pos++ + gaplen] == '\n')
-      line_count++;
+}
+
+// Find the chunk containing pos, and the position and line number
+// of the start of it:
+static int lineindex_find_pos(const TextLineIndex* x, int pos,
+                              int* start, int* line) {
+  int k = 0, b = 0, l = 0;
+  int bit = 1; while (bit*2 <= x->n) bit *= 2;
+  for (; bit; bit /= 2) {
+    int i = k + bit;
+    if (i <= x->n && b + x->fbytes[i] <= pos) {
+      k = i;
+      b += x->fbytes[i];
+      l += x->flines[i];
+    }
   }
-  return line_count;
+  // k is now the number of chunks entirely before pos
+  if (k >= x->n) { // pos is at the end
+    k = x->n-1;
+    b -= x->bytes[k];
+    l -= x->lines[k];
+  }
+  *start = b;
+  *line = l;
+  return k;
+}
+
+// Find the chunk containing the nth newline (n > 0), and the position and
+// line number of the start of it. Returns -1 if there are not that many:
+static int lineindex_find_line(const TextLineIndex* x, int n,
+                               int* start, int* line) {
+  int k = 0, b = 0, l = 0;
+  int bit = 1; while (bit*2 <= x->n) bit *= 2;
+  for (; bit; bit /= 2) {
+    int i = k + bit;
+    if (i <= x->n && l + x->flines[i] < n) {
+      k = i;
+      b += x->fbytes[i];
+      l += x->flines[i];
+    }
+  }
+  if (k >= x->n) return -1;
+  *start = b;
+  *line = l;
+  return k;
+}
+
+// Number of newlines in [start,end):
+int TextBuffer::count_newlines_(int start, int end) const {
+  int count = 0;
+  while (start < end) {
+    int s, e;
+    const char* b = run_(start, &s, &e);
+    if (e > end) e = end;
+    const char* p = b + start;
+    const char* q = b + e;
+    while ((p = (const char*)memchr(p, '\n', q-p))) {count++; p++;}
+    start = e;
+  }
+  return count;
+}
+
+// Position of the first character after the nth newline at or after start,
+// or length() if there are not that many:
+int TextBuffer::find_newline_(int start, int n) const {
+  if (start >= length_) return start;
+  while (start < length_) {
+    int s, e;
+    const char* b = run_(start, &s, &e);
+    const char* p = b + start;
+    const char* q = b + e;
+    while ((p = (const char*)memchr(p, '\n', q-p))) {
+      p++;
+      if (!--n) return p - b;
+    }
+    start = e;
+  }
+  return length_;
+}
+
+// Divide [start,start+length) into chunks and put them into the index
+// starting at chunk k, replacing one chunk there:
+void TextBuffer::lineindex_fill_(int k, int start, int length) {
+  TextLineIndex* x = lineindex_;
+  int add = (length + LINEINDEX_CHUNK - 1) / LINEINDEX_CHUNK;
+  if (add < 1) add = 1;
+  lineindex_reserve(x, x->n + add - 1);
+  memmove(x->bytes+k+add, x->bytes+k+1, (x->n-k-1)*sizeof(int));
+  memmove(x->lines+k+add, x->lines+k+1, (x->n-k-1)*sizeof(int));
+  x->n += add-1;
+  for (int i = 0; i < add; i++) {
+    int b = i < add-1 ? LINEINDEX_CHUNK : length - i*LINEINDEX_CHUNK;
+    x->bytes[k+i] = b;
+    x->lines[k+i] = count_newlines_(start, start+b);
+    start += b;
+  }
+  lineindex_sum(x);
+}
+
+void TextBuffer::lineindex_build_() {
+  TextLineIndex* x = new TextLineIndex;
+  x->n = 1;
+  x->alloc = 0;
+  x->bytes = x->lines = x->fbytes = x->flines = 0;
+  lineindex_reserve(x, 1);
+  lineindex_ = x;
+  lineindex_fill_(0, 0, length_);
+}
+
+void TextBuffer::lineindex_free_() {
+  if (!lineindex_) return;
+  free(lineindex_->bytes);
+  free(lineindex_->lines);
+  free(lineindex_->fbytes);
+  free(lineindex_->flines);
+  delete lineindex_;
+  lineindex_ = 0;
+}
+
+// Called after n bytes are put into the buffer at pos:
+void TextBuffer::lineindex_inserted_(int pos, int n) {
+  TextLineIndex* x = lineindex_;
+  if (!x || !n) return;
+  int start, line;
+  // Put the text in the chunk with the character before it, so typing at
+  // the end of a chunk does not make empty chunks after it:
+  int k = lineindex_find_pos(x, pos ? pos-1 : 0, &start, &line);
+  lineindex_add(x, k, n, count_newlines_(pos, pos+n));
+  if (x->bytes[k] > 2*LINEINDEX_CHUNK)
+    lineindex_fill_(k, start, x->bytes[k]);
+}
+
+// Called before the bytes from start to end are removed from the buffer:
+void TextBuffer::lineindex_removed_(int start, int end) {
+  TextLineIndex* x = lineindex_;
+  if (!x || start >= end) return;
+  int b, line;
+  int k = lineindex_find_pos(x, start, &b, &line);
+  for (; k < x->n && b < end; k++) {
+    int e = b + x->bytes[k];
+    int s1 = start > b ? start : b;
+    int e1 = end < e ? end : e;
+    if (s1 < e1) lineindex_add(x, k, s1-e1, -count_newlines_(s1, e1));
+    b = e;
+  }
+  // merge chunks together if deleting has left too many little ones:
+  int remaining = length_ - (end-start);
+  if (x->n > 2*remaining/LINEINDEX_CHUNK + 64) {
+    int j = 0;
+    for (int i = 1; i < x->n; i++) {
+      if (x->bytes[j] + x->bytes[i] <= LINEINDEX_CHUNK) {
+        x->bytes[j] += x->bytes[i];
+        x->lines[j] += x->lines[i];
+      } else {
+        j++;
+        x->bytes[j] = x->bytes[i];
+        x->lines[j] = x->lines[i];
+      }
+    }
+    x->n = j+1;
+    lineindex_sum(x);
+  }
+}
+
+/**
+ * Return the position of the first character of line number \a line,
+ * counting the first line as 0. This is the position after the
+ * \a line'th newline, or length() if there are not that many lines.
+ * This takes O(log n) time, using an index that is built the first
+ * time a line number is asked for and updated as the text is changed.
+ * Because it may build the index, this and the other line number
+ * functions must not be called with only fltk::lock_shared().
+ */
+int TextBuffer::line_to_position(int line) {
+  if (line <= 0) return 0;
+  if (!lineindex_) lineindex_build_();
+  int start, l;
+  if (lineindex_find_line(lineindex_, line, &start, &l) < 0) return length_;
+  return find_newline_(start, line - l);
+}
+
+/**
+ * Return the line number that position \a pos is in, counting the first
+ * line as 0. This is the number of newlines before \a pos.
+ * This takes O(log n) time, see line_to_position().
+ */
+int TextBuffer::position_to_line(int pos) {
+  if (pos <= 0) return 0;
+  if (pos > length_) pos = length_;
+  if (!lineindex_) lineindex_build_();
+  int start, line;
+  lineindex_find_pos(lineindex_, pos, &start, &line);
+  return line + count_newlines_(start, pos);
+}
+
+/**
+ * Count the number of newlines between startpos and endpos in buffer "buf".
+ * The character at position "endpos" is not counted. If endpos is less
+ * than startpos, this counts to the end of the buffer.
+ */
+int TextBuffer::count_lines(int startpos, int endpos) {
+  if (startpos < 0) startpos = 0;
+  if (endpos < startpos || endpos > length_) endpos = length_;
+  if (startpos >= endpos) return 0;
+  // short distances are faster to scan than to look up:
+  if (endpos - startpos <= 2*LINEINDEX_CHUNK)
+    return count_newlines_(startpos, endpos);
+  return position_to_line(endpos) - position_to_line(startpos);
 }
 
 /**
@@ -1072,28 +1937,13 @@ int TextBuffer::count_lines(int startpos, int endpos) {
  * in "buf" and return its position
  */
 int TextBuffer::skip_lines(int startpos, int nlines) {
-  int pos, gaplen = gapend_ - gapstart_;
-  int line_count = 0;
-
   if (nlines == 0)
     return startpos;
 
-  pos = startpos;
-  while (pos < gapstart_) {
-    if (buf_[pos++] == '\n') {
-      line_count++;
-      if (line_count == nlines)
-        return pos;
-    }
-  }
-  while (pos < length_) {
-    if (buf_[pos++ + gaplen] == '\n') {
-      line_count++;
-      if (line_count >= nlines)
-        return pos;
-    }
-  }
-  return pos;
+  // a few lines are faster to scan than to look up:
+  if (nlines < 0 || nlines <= 16)
+    return find_newline_(startpos, nlines < 0 ? 1 : nlines);
+  return line_to_position(position_to_line(startpos) + nlines);
 }
 
 /**
@@ -1103,26 +1953,28 @@ int TextBuffer::skip_lines(int startpos, int nlines) {
  * the line
  */
 int TextBuffer::rewind_lines( int startpos, int nlines ) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int pos;
   int line_count = -1;
 
   pos = startpos - 1;
   if ( pos <= 0 )
     return 0;
 
-  while (pos >= gapstart_) {
-    if (buf_[pos + gaplen] == '\n') {
-      if (++line_count >= nlines)
-        return pos + 1;
-    }
-    pos--;
+  if (nlines > 16) {
+    int line = position_to_line(startpos) - nlines;
+    return line <= 0 ? 0 : line_to_position(line);
   }
+
+  if (pos >= length_) pos = length_ - 1;
   while (pos >= 0) {
-    if (buf_[pos] == '\n') {
-      if (++line_count >= nlines)
-        return pos + 1;
+    int s, e;
+    const char* b = run_(pos, &s, &e);
+    for (; pos >= s; pos--) {
+      if (b[pos] == '\n') {
+        if (++line_count >= nlines)
+          return pos + 1;
+      }
     }
-    pos--;
   }
   return 0;
 }
@@ -1134,7 +1986,7 @@ int TextBuffer::rewind_lines( int startpos, int nlines ) {
  */
 bool TextBuffer::findchars_forward(int startpos, const char *searchChars, int *foundPos)
 {
-  int pos, gaplen = gapend_ - gapstart_;
+  int pos;
   const char *c;
   
   if (!searchChars) {
@@ -1142,52 +1994,23 @@ bool TextBuffer::findchars_forward(int startpos, const char *searchChars, int *f
     return false;
   }
   
-  pos = startpos;
-  while (pos < gapstart_) {
-    for (c=searchChars; *c!='\0'; c++) {
-	    if (buf_[pos]==*c) {
-        *foundPos = pos;
-        return true;
-      }
-    }
-    pos++;
-  }
+  pos = startpos < 0 ? 0 : startpos;
   while (pos < length_) {
-    for (c=searchChars; *c!='\0'; c++) {
-    	if (buf_[pos + gaplen]==*c) {
-        *foundPos = pos;
-        return true;
+    int s, e;
+    const char* b = run_(pos, &s, &e);
+    for (; pos < e; pos++) {
+      for (c=searchChars; *c!='\0'; c++) {
+        if (b[pos]==*c) {
+          *foundPos = pos;
+          return true;
+        }
       }
     }
-    pos++;
   }
   *foundPos = length_;
   return false;
 }
 
-bool TextBuffer::search_forward(int startpos, const char *searchString,
-                               int *foundPos, bool matchCase)
-{ 
-  if (!searchString) return 0;
-  int bp;
-  const char *sp;
-  while (startpos < length_)
-  {
-    bp = startpos;
-    sp = searchString;
-    do {
-       if (!*sp) { 
-        *foundPos = startpos; 
-        return true; 
-       }
-    } while ((matchCase ? character(bp++) == *sp++ :
-             toupper(character(bp++)) == toupper(*sp++))
-             && bp <= length_);
-    startpos++;
-  }
-  return 0;
-}
-
 /**
  * Search backwards in buffer "buf" for characters in "searchChars", starting
  * with the character BEFORE "startpos", returning the result in "foundPos"
@@ -1195,61 +2018,31 @@ bool TextBuffer::search_forward(int startpos, const char *searchString,
  */
 bool TextBuffer::findchars_backward(int startpos, const char *searchChars, int *foundPos)
 {
-  int pos, gapLen = gapend_ - gapstart_;
+  int pos;
   const char *c;
   
-  if (startpos == 0) {
+  if (startpos <= 0) {
     *foundPos = 0;
     return false;
   }
 
-  pos = startpos == 0 ? 0 : startpos - 1;
-  while (pos >= gapstart_) {
-    for (c=searchChars; *c!='\0'; c++) {
-      if (buf_[pos + gapLen] == *c) {
-        *foundPos = pos;
-        return true;
-      }
-    }
-    pos--;
-  }
+  pos = startpos > length_ ? length_ - 1 : startpos - 1;
   while (pos >= 0) {
-    for (c=searchChars; *c!='\0'; c++) {
-      if (buf_[pos] == *c) {
-        *foundPos = pos;
-        return true;
+    int s, e;
+    const char* b = run_(pos, &s, &e);
+    for (; pos >= s; pos--) {
+      for (c=searchChars; *c!='\0'; c++) {
+        if (b[pos] == *c) {
+          *foundPos = pos;
+          return true;
+        }
       }
     }
-    pos--;
   }
   *foundPos = 0;
   return false;
 }
 
-bool TextBuffer::search_backward(int startpos, const char *searchString,
-                                 int *foundPos, bool matchCase)
-{
-  if (!searchString) return 0;
-  int bp;
-  int searchStringLen = strlen(searchString);
-  const char *sp;
-  while (startpos > 0)
-  {
-    bp = startpos-1;
-    sp = searchString+searchStringLen-1;
-    do {
-      if (sp < searchString) { 
-        *foundPos = bp+1; 
-        return true; 
-      }
-    } while ((matchCase ? character(bp--) == *sp-- :
-             toupper(character(bp--)) == toupper(*sp--))
-             && bp >= 0);
-    startpos--;
-  }
-  return false;
-}
-
 /**
  * Internal (non-redisplaying) version of BufInsert.  Returns the length of
  * text inserted (this is just strlen(text), however this calculation can be
@@ -1260,33 +2053,30 @@ bool TextBuffer::search_backward(int startpos, const char *searchString,
 int TextBuffer::insert_(int pos, const char *s) {
   int insertedLength = strlen(s);
 
-  /* Prepare the buffer to receive the new text.  If the new text fits in
-     the current buffer, just move the gap (if necessary) to where
-     the text should be inserted.  If the new text is too large, reallocate
-     the buffer with a gap large enough to accomodate the new text and a
-     gap of PREFERRED_GAP_SIZE */
-  if (insertedLength > gapend_ - gapstart_)
-    reallocate_with_gap(pos, insertedLength + PREFERRED_GAP_SIZE);
-  else if (pos != gapstart_)
-    move_gap(pos);
-
-  /* Insert the new text (pos now corresponds to the start of the gap) */
-  memcpy(&buf_[pos], s, insertedLength);
-  gapstart_ += insertedLength;
+  if (piecetable_) {
+    char* p = piece_reserve_(insertedLength);
+    memcpy(p, s, insertedLength);
+    piece_insert_(pos, p, insertedLength);
+  } else {
+    /* Prepare the buffer to receive the new text.  If the new text fits in
+       the current buffer, just move the gap (if necessary) to where
+       the text should be inserted.  If the new text is too large, reallocate
+       the buffer with a gap large enough to accomodate the new text and a
+       gap of PREFERRED_GAP_SIZE */
+    if (insertedLength > gapend_ - gapstart_)
+      reallocate_with_gap(pos, insertedLength + PREFERRED_GAP_SIZE);
+    else if (pos != gapstart_)
+      move_gap(pos);
+
+    /* Insert the new text (pos now corresponds to the start of the gap) */
+    memcpy(&buf_[pos], s, insertedLength);
+    gapstart_ += insertedLength;
+  }
   length_ += insertedLength;
+  lineindex_inserted_(pos, insertedLength);
   update_selections(pos, 0, insertedLength);
 
-  if (mCanUndo) {
-    if (undowidget==this && undoat==pos && undoinsert) {
-      undoinsert += insertedLength;
-    } else {
-      undoinsert = insertedLength;
-      undoyankcut = (undoat==pos) ? undocut : 0 ;
-    }
-    undoat = pos+insertedLength;
-    undocut = 0;
-    undowidget = this;
-  }
+  undo_inserted_(pos, insertedLength);
 
   return insertedLength;
 }
@@ -1297,42 +2087,27 @@ int TextBuffer::insert_(int pos, const char *s) {
  * the delete).
  */
 void TextBuffer::remove_(int start, int end) {
-  
-  if (mCanUndo) {
-    if (undowidget==this && undoat==end && undocut) {
-      undobuffersize(undocut+end-start+1);
-      memmove(undobuffer+end-start, undobuffer, undocut);
-      undocut += end-start;
-    } else {
-      undocut = end-start;
-      undobuffersize(undocut);
-    }
-    undoat = start;
-    undoinsert = 0;
-    undoyankcut = 0;
-    undowidget = this;
-  }
+  lineindex_removed_(start, end);
 
-  /* if the gap is not contiguous to the area to remove, move it there */
-  if (start > gapstart_) {
-    if (mCanUndo)
-      memcpy(undobuffer, buf_+(gapend_-gapstart_)+start, end-start);
-    move_gap(start);
-  }
-  else if (end < gapstart_) {
-    if (mCanUndo)
-      memcpy(undobuffer, buf_+start, end-start);
-    move_gap(end);
-  }
-  else if (mCanUndo) {
-    int prelen = gapstart_ - start;
-    memcpy(undobuffer, buf_+start, prelen);
-    memcpy(undobuffer+prelen, buf_+gapend_, end-start-prelen);
-  }
+  undo_deleted_(start, end);
 
-  /* expand the gap to encompass the deleted characters */
-  gapend_ += end - gapstart_;
-  gapstart_ -= gapstart_ - start;
+  if (piecetable_) {
+    TextPiece* l; TextPiece* m; TextPiece* r;
+    piece_split(pieces_, start, &l, &r);
+    piece_split(r, end - start, &m, &r);
+    piece_unref(m);
+    pieces_ = piece_merge(l, r);
+  } else {
+    /* if the gap is not contiguous to the area to remove, move it there */
+    if (start > gapstart_)
+      move_gap(start);
+    else if (end < gapstart_)
+      move_gap(end);
+
+    /* expand the gap to encompass the deleted characters */
+    gapend_ += end - gapstart_;
+    gapstart_ -= gapstart_ - start;
+  }
 
   /* update the length */
   length_ -= end - start;
@@ -1884,6 +2659,20 @@ void TextBuffer::call_modify_callbacks(int pos, int ndeleted,
                                        int ninserted, int nRestyled, const char *deleted_text) {
   int i;
 
+  if (batchdepth_) {
+    if (ndeleted || ninserted) {
+      batch_change_(pos, ndeleted, ninserted, deleted_text);
+    } else if (!batchrestyled_) {
+      batchrestyled_ = true;
+      batchrestylestart_ = pos;
+      batchrestyleend_ = pos + nRestyled;
+    } else {
+      batchrestylestart_ = min(batchrestylestart_, pos);
+      batchrestyleend_ = max(batchrestyleend_, pos + nRestyled);
+    }
+    return;
+  }
+
   for (i = 0; i < nmodifyprocs_; i++)
     (*modifyprocs_[i])(pos, ninserted, ndeleted, nRestyled, deleted_text, modifycbargs_[i]);
 }
@@ -1895,10 +2684,149 @@ void TextBuffer::call_modify_callbacks(int pos, int ndeleted,
 void TextBuffer::call_predelete_callbacks(int pos, int ndeleted) {
     int i;
     
+    if (batchdepth_) return;
     for (i=0; i<npredeleteprocs_; i++)
     	(*predeleteprocs_[i])(pos, ndeleted, prepeletecbargs_[i]);
 }
 
+/**
+ * Stop calling the modify callbacks until end_batch() is called. Then
+ * they are called once, as though the range from the first to the last
+ * changed character was replaced in one step, with the text that was
+ * there before as the deleted text. This is much faster than calling
+ * them for each change when many changes are done at once, such as a
+ * replace-all, because a TextDisplay only has to figure out what to
+ * redraw once.
+ *
+ * Calls nest, only the outermost end_batch() calls the callbacks. The
+ * predelete callbacks are not called for the changes in a batch, as
+ * the range is not known until the end. A TextDisplay showing the
+ * buffer is not updated until end_batch(), so don't move its cursor or
+ * scroll it during a batch. All the changes in a batch are undone by
+ * one call to undo().
+ */
+void TextBuffer::begin_batch() {
+  if (!batchdepth_++) {
+    batchchanged_ = false;
+    batchrestyled_ = false;
+    if (undo_) undo_->batchfirst = true;
+  }
+}
+
+/**
+ * End a begin_batch(), calling the modify callbacks once for all the
+ * changes made since then.
+ */
+void TextBuffer::end_batch() {
+  if (batchdepth_ <= 0 || --batchdepth_) return;
+  if (undo_) {
+    undo_->batchfirst = false;
+    undo_->sealed = true;
+  }
+  if (batchchanged_) {
+    // also redraw anything restyled outside the changed text:
+    if (batchrestyled_ && batchrestylestart_ < batchstart_) {
+      batch_deleted_(0, batcholdend_ - batchstart_, batchrestylestart_,
+                     batchstart_, length_, 0, 0, 0);
+      batchstart_ = batchrestylestart_;
+    }
+    if (batchrestyled_ && batchrestyleend_ > batchnewend_) {
+      int end = min(batchrestyleend_, length_);
+      batch_deleted_(batcholdend_ - batchstart_, batcholdend_ - batchstart_,
+                     batchnewend_, end, length_, 0, 0, 0);
+      batcholdend_ += end - batchnewend_;
+      batchnewend_ = end;
+    }
+    if (!batchtext_) batchtext_ = (char*)malloc(batchtextsize_ = 1024);
+    batchtext_[batcholdend_ - batchstart_] = 0;
+    call_modify_callbacks(batchstart_, batcholdend_ - batchstart_,
+                          batchnewend_ - batchstart_, 0, batchtext_);
+  } else if (batchrestyled_) {
+    call_modify_callbacks(batchrestylestart_, 0, 0,
+                          batchrestyleend_ - batchrestylestart_, 0);
+  }
+  batchchanged_ = batchrestyled_ = false;
+  if (batchtextsize_ > 64*1024) {
+    free(batchtext_);
+    batchtext_ = 0;
+    batchtextsize_ = 0;
+  }
+}
+
+/*
+ * Put the text that was from start to end, before the change where
+ * nDeleted characters at pos were replaced with nInserted ones, into
+ * batchtext_ at offset at, moving the rest of the used bytes up.
+ */
+void TextBuffer::batch_deleted_(int at, int used, int start, int end, int pos,
+                                int nDeleted, int nInserted,
+                                const char* deletedText) {
+  int n = end - start;
+  if (n <= 0) return;
+  if (used + n + 1 > batchtextsize_) {
+    batchtextsize_ = 2*(used + n) + 1024;
+    batchtext_ = (char*)realloc(batchtext_, batchtextsize_);
+  }
+  char* p = batchtext_ + at;
+  memmove(p + n, p, used - at);
+  // before the change:
+  if (start < pos) {
+    int e = min(end, pos);
+    copy_out_(p, start, e);
+    p += e - start;
+    start = e;
+  }
+  // the deleted text:
+  if (start < end && start < pos + nDeleted) {
+    int e = min(end, pos + nDeleted);
+    memcpy(p, deletedText + (start - pos), e - start);
+    p += e - start;
+    start = e;
+  }
+  // after the change:
+  if (start < end)
+    copy_out_(p, start - nDeleted + nInserted, end - nDeleted + nInserted);
+}
+
+/*
+ * Add nDeleted characters at pos being replaced by nInserted ones to
+ * the range that end_batch() will report.
+ */
+void TextBuffer::batch_change_(int pos, int nDeleted, int nInserted,
+                               const char* deletedText) {
+  // move the restyled range to where that text is now:
+  if (batchrestyled_) {
+    int* e[2] = {&batchrestylestart_, &batchrestyleend_};
+    for (int i = 0; i < 2; i++) {
+      if (*e[i] >= pos + nDeleted) *e[i] += nInserted - nDeleted;
+      else if (*e[i] > pos) *e[i] = i ? pos + nInserted : pos;
+    }
+  }
+  if (!batchchanged_) {
+    batch_deleted_(0, 0, pos, pos + nDeleted, pos, nDeleted, nInserted,
+                   deletedText);
+    batchchanged_ = true;
+    batchstart_ = pos;
+    batcholdend_ = pos + nDeleted;
+    batchnewend_ = pos + nInserted;
+    return;
+  }
+  // Positions here are before this change. Outside the changed range
+  // the text is what it was at the start of the batch:
+  int start = min(batchstart_, pos);
+  int end = max(batchnewend_, pos + nDeleted);
+  int delta = batchnewend_ - batcholdend_;
+  int used = batcholdend_ - batchstart_;
+  batch_deleted_(0, used, start, batchstart_, pos, nDeleted, nInserted,
+                 deletedText);
+  used += batchstart_ - start;
+  batch_deleted_(used, used, batchnewend_, end, pos, nDeleted, nInserted,
+                 deletedText);
+  batchstart_ = start;
+  batcholdend_ = end - delta;
+  batchnewend_ = end + nInserted - nDeleted;
+}
+
 /**
  * Call the stored redisplay procedure(s) for this buffer to update the
  * screen for a change in a selection.
@@ -1984,7 +2912,8 @@ void TextBuffer::reallocate_with_gap(int newGapStart, int newGapLen) {
   char *newBuf;
   int newGapEnd;
 
-  newBuf = (char *)malloc(length_ + newGapLen);
+  // one more byte so text() can add a nul:
+  newBuf = (char *)malloc(length_ + newGapLen + 1);
   newGapEnd = newGapStart + newGapLen;
   if (newGapStart <= gapstart_) {
     memcpy(newBuf, buf_, newGapStart );
@@ -2004,6 +2933,29 @@ void TextBuffer::reallocate_with_gap(int newGapStart, int newGapLen) {
 #endif
 }
 
+// What an insertfile_async() that is not done yet needs, see below:
+struct fltk::TextLoader {
+  TextBuffer* buffer;	// null after cancel_load()
+  FILE* fp;
+  int pos;		// where the next piece goes, moved by other edits
+  int loaded, total;
+  int buflen;
+  char* data;		// being filled by read_piece()
+  char* spare;		// the piece being inserted
+  int n;		// bytes read_piece() read, 0 at the end
+  int error;		// 2 if it failed to read
+  Text_Load_Cb cb;
+  void* arg;
+};
+
+// Called by update_selections() so the rest of the file goes after
+// the text already inserted even if it is edited meanwhile:
+static void loader_update(TextLoader* l, int pos, int ndeleted, int ninserted) {
+  if (l->pos < pos) return;
+  if (l->pos < pos+ndeleted) l->pos = pos; else l->pos -= ndeleted;
+  l->pos += ninserted;
+}
+
 /**
  * Update all of the selections in "buf" for changes in the buffer's text
  */
@@ -2011,6 +2963,7 @@ void TextBuffer::update_selections(int pos, int ndeleted, int ninserted) {
   primary_.update(pos, ndeleted, ninserted);
   secondary_.update(pos, ndeleted, ninserted);
   highlight_.update(pos, ndeleted, ninserted);
+  if (loader_) loader_update(loader_, pos, ndeleted, ninserted);
 }
 
 /**
@@ -2022,7 +2975,7 @@ void TextBuffer::update_selections(int pos, int ndeleted, int ninserted) {
  * count lines quickly, hence searching for a single character: newline)
  */
 bool TextBuffer::findchar_forward(int startpos, char searchChar, int *foundPos) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int pos;
 
   if (startpos < 0 || startpos >= length_) {
     *foundPos = length_;
@@ -2030,19 +2983,15 @@ bool TextBuffer::findchar_forward(int startpos, char searchChar, int *foundPos)
   }
 
   pos = startpos;
-  while (pos < gapstart_) {
-    if (buf_[pos] == searchChar) {
-      *foundPos = pos;
-      return true;
-    }
-    pos++;
-  }
   while (pos < length_) {
-    if (buf_[pos + gaplen] == searchChar) {
-      *foundPos = pos;
+    int s, e;
+    const char* b = run_(pos, &s, &e);
+    const char* p = (const char*)memchr(b + pos, searchChar, e - pos);
+    if (p) {
+      *foundPos = p - b;
       return true;
     }
-    pos++;
+    pos = e;
   }
   *foundPos = length_;
   return false;
@@ -2057,7 +3006,7 @@ bool TextBuffer::findchar_forward(int startpos, char searchChar, int *foundPos)
  ** count lines quickly, hence searching for a single character: newline)
  */
 bool TextBuffer::findchar_backward(int startpos, char searchChar, int *foundPos) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int pos;
 
   if (startpos <= 0 || startpos > length_) {
     *foundPos = 0;
@@ -2065,19 +3014,15 @@ bool TextBuffer::findchar_backward(int startpos, char searchChar, int *foundPos)
   }
 
   pos = startpos - 1;
-  while (pos >= gapstart_) {
-    if (buf_[pos + gaplen] == searchChar) {
-      *foundPos = pos;
-      return true;
-    }
-    pos--;
-  }
   while (pos >= 0) {
-    if (buf_[pos] == searchChar) {
-      *foundPos = pos;
-      return true;
+    int s, e;
+    const char* b = run_(pos, &s, &e);
+    for (; pos >= s; pos--) {
+      if (b[pos] == searchChar) {
+        *foundPos = pos;
+        return true;
+      }
     }
-    pos--;
   }
   *foundPos = 0;
   return false;
@@ -2314,6 +3259,124 @@ static int min( int i1, int i2 ) {
   return i1 <= i2 ? i1 : i2;
 }
 
+////////////////////////////////////////////////////////////////
+// insertfile_async() has a ThreadPool thread read the file a piece at
+// a time. Each piece is inserted by the main thread from fltk::post(),
+// which first asks for the next piece, so reading it overlaps inserting
+// this one, and the windows are redrawn between pieces.
+
+static void read_piece(void* v) {
+  TextLoader* l = (TextLoader*)v;
+  int n = fread(l->data, 1, l->buflen-1, l->fp);
+  if (n <= 0) {
+    n = 0;
+    if (ferror(l->fp)) l->error = 2;
+  }
+  l->data[n] = '\0';
+  l->n = n;
+}
+
+#if HAVE_PTHREAD || defined(_WIN32)
+#include <fltk/Threads.h>
+extern bool fl_lock_started(); // in lock.cxx
+
+// The main thread's half, see above:
+void TextBuffer::insert_piece_(void* v) {
+  TextLoader* l = (TextLoader*)v;
+  TextBuffer* b = l->buffer;
+  if (b && l->n > 0) {
+    char* piece = l->data; l->data = l->spare; l->spare = piece;
+    ThreadPool::shared()->add(read_piece, l, ThreadPool::NORMAL, insert_piece_);
+    b->insert(l->pos, piece);
+    if (!l->buffer) return; // a modify callback cancelled it
+    l->loaded += strlen(piece);
+    if (l->cb) l->cb(b, l->loaded, l->total, -1, l->arg);
+    return;
+  }
+  // done, failed, or cancelled:
+  if (b) {
+    b->loader_ = 0;
+    if (l->cb) l->cb(b, l->loaded, l->total, l->error, l->arg);
+  }
+  fclose(l->fp);
+  delete[] l->data;
+  delete[] l->spare;
+  delete l;
+}
+#else
+void TextBuffer::insert_piece_(void*) {}
+#endif
+
+/**
+ * Insert the contents of a file at \a pos without waiting for it to be
+ * read. A ThreadPool thread reads it \a buflen bytes at a time, and
+ * each piece is inserted by fltk::wait() as it arrives, calling the
+ * modify callbacks, so a TextDisplay shows the start of the file right
+ * away and the program can be used while the rest arrives. Edits made
+ * meanwhile are kept, and the rest of the file goes after the part
+ * already inserted.
+ *
+ * If \a cb is not null it is called after each piece with the bytes
+ * inserted so far and the size of the file, and \a status -1. It is
+ * called a last time when the whole file is in, with \a status 0, or 2
+ * if reading it failed. After that loading() is false. It is not
+ * called after cancel_load(), which happens if the buffer is deleted.
+ *
+ * This needs fltk::lock() to have been called so the reading thread
+ * can hand the pieces to the main thread. Without it, or without
+ * threads, the file is inserted now with insertfile() and \a cb is
+ * called once when done. To view a very large file without reading
+ * it into memory at all, use mapfile().
+ *
+ * Returns 1 if the file can't be opened, else 0. Calling this again
+ * before it is done cancels the first one.
+ */
+int TextBuffer::insertfile_async(const char *file, int pos, Text_Load_Cb cb,
+                                 void* cbArg, int buflen) {
+  cancel_load();
+#if HAVE_PTHREAD || defined(_WIN32)
+  if (fl_lock_started()) {
+    FILE* fp = fopen(file, "r");
+    if (!fp) return 1;
+    long size = 0;
+    if (!fseek(fp, 0, SEEK_END)) size = ftell(fp);
+    rewind(fp);
+    if (buflen < 2) buflen = 2;
+    TextLoader* l = new TextLoader;
+    l->buffer = this;
+    l->fp = fp;
+    l->pos = pos;
+    l->loaded = 0;
+    l->total = size > 0x7fffffffL ? 0x7fffffff : int(size);
+    l->buflen = buflen;
+    l->data = new char[buflen];
+    l->spare = new char[buflen];
+    l->n = 0;
+    l->error = 0;
+    l->cb = cb;
+    l->arg = cbArg;
+    loader_ = l;
+    ThreadPool::shared()->add(read_piece, l, ThreadPool::NORMAL, insert_piece_);
+    return 0;
+  }
+#endif
+  int before = length();
+  int r = insertfile(file, pos, buflen);
+  if (r == 1) return 1;
+  if (cb) cb(this, length()-before, length()-before, r, cbArg);
+  return 0;
+}
+
+/**
+ * Stop an insertfile_async() that is not done. The text inserted so
+ * far stays, and its callback is not called again.
+ */
+void TextBuffer::cancel_load() {
+  if (!loader_) return;
+  loader_->buffer = 0;
+  loader_ = 0;
+}
+
 int
 TextBuffer::insertfile(const char *file, int pos, int buflen) {
   FILE *fp;
@@ -2331,15 +3394,90 @@ TextBuffer::insertfile(const char *file, int pos, int buflen) {
   return e;
 }
 
+/**
+ * Replace the text with the contents of a file, without reading it.
+ * The buffer is changed to PIECE_TABLE storage() and the file is mapped
+ * into memory as the first piece, so this takes the same time no matter
+ * how big the file is, and only the parts that are looked at or edited
+ * are read. Edits are kept in memory and the file is not changed.
+ * The mapping stays until all the text from it has been deleted and
+ * any snapshot() that uses it has been released.
+ *
+ * The file must not be changed or truncated by anything else while it
+ * is mapped. Calling text() copies the whole file into memory, use
+ * text_range() or outputfile() instead. Files of 2GB or more can't be
+ * put in a TextBuffer and return 2.
+ *
+ * Returns 0 on success, 1 if the file can't be opened, 2 if it can't
+ * be mapped. The modify callbacks are called as for text(const char*).
+ */
+int TextBuffer::mapfile(const char *file) {
+  char* data = 0;
+  int size = 0;
+#ifdef _WIN32
+  HANDLE fh = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL,
+                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fh == INVALID_HANDLE_VALUE) return 1;
+  DWORD high = 0;
+  DWORD low = GetFileSize(fh, &high);
+  if (high || low >= 0x80000000UL) {CloseHandle(fh); return 2;}
+  size = int(low);
+  if (size) {
+    HANDLE mh = CreateFileMapping(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mh) {
+      data = (char*)MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mh);
+    }
+  }
+  CloseHandle(fh);
+#else
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) return 1;
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size >= 0x80000000LL) {close(fd); return 2;}
+  size = int(st.st_size);
+  if (size) {
+    data = (char*)mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == (char*)MAP_FAILED) data = 0;
+  }
+  close(fd);
+#endif
+  if (size && !data) return 2;
+
+  storage(PIECE_TABLE);
+  TextPiece* t = 0;
+  if (size) {
+    TextBlock* b = new TextBlock;
+    b->refs = 0;
+    b->size = b->used = size;
+    b->data = data;
+    b->mapped = true;
+    t = piece_new(b, data, size);
+  }
+  restore(t);
+  piece_unref(t);
+  return 0;
+}
+
+/**
+ * Write the text from start to end to a file. This writes each piece
+ * of the buffer directly, without making a copy of the text.
+ * Returns 0 on success, 1 if the file can't be opened, 2 if writing
+ * failed. buflen is ignored.
+ */
 int
 TextBuffer::outputfile(const char *file, int start, int end, int buflen) {
   FILE *fp;
   if (!(fp = fopen(file, "w"))) return 1;
-  for (int n; (n = min(end - start, buflen)); start += n) {
-    const char *p = text_range(start, start + n);
-    int r = fwrite(p, 1, n, fp);
-    free((void *)p);
-    if (r != n) break;
+  if (start < 0) start = 0;
+  if (end > length_) end = length_;
+  while (start < end) {
+    int s, e;
+    const char *p = run_(start, &s, &e);
+    if (e > end) e = end;
+    int n = e - start;
+    if (int(fwrite(p + start, 1, n, fp)) != n) break;
+    start = e;
   }
 
   int e = ferror(fp) ? 2 : 0;
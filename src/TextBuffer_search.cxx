@@ -0,0 +1,645 @@
+//
+// "$Id$"
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Searching a TextBuffer for strings and regular expressions. This
+// works directly on the text as it is stored, using run_() to get
+// each part of it, so nothing is copied. Plain strings are found by
+// using memchr() to find the first byte, which the C library does
+// many bytes at a time, and then comparing the rest.
+//
+// Regular expressions are compiled into a little program that is run
+// by a "Pike VM", which tries all the ways the expression can match at
+// once, so the time is proportional to the length of the text times
+// the length of the expression, and there is no bad case. This supports
+// . [] [^] * + ? | () ^ $ and the \d \w \s \D \W \S escapes, with
+// anything else after a backslash being that character. It works on
+// bytes, so a UTF-8 character has to be matched by putting all of its
+// bytes in the pattern, and . matches only one byte of it.
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <fltk/string.h>
+#include <fltk/TextBuffer.h>
+
+using namespace fltk;
+
+// The byte at pos, using the run p, s, e to avoid calling run_() every
+// time. This can only be used in a TextBuffer method:
+#define BYTE(pos) ((uchar)((pos) >= s && (pos) < e ? p : (p = run_((pos), &s, &e)))[pos])
+
+static inline int fold(int c) {return tolower(c);}
+
+////////////////////////////////////////////////////////////////
+// Plain strings:
+
+// Return true if the n bytes of str are at pos, where pos+n <= length():
+bool TextBuffer::text_match_(int pos, const char* str, int n, bool matchcase) const {
+  while (n > 0) {
+    int s, e;
+    const char* p = run_(pos, &s, &e) + pos;
+    int k = e - pos; if (k > n) k = n;
+    if (matchcase) {
+      if (memcmp(p, str, k)) return false;
+    } else {
+      for (int i = 0; i < k; i++)
+        if (fold((uchar)p[i]) != fold((uchar)str[i])) return false;
+    }
+    pos += k; str += k; n -= k;
+  }
+  return true;
+}
+
+// Return the first position from start where the n bytes of str are,
+// so that they end by end, or -1:
+int TextBuffer::text_find_(int start, int end, const char* str, int n, bool matchcase) const {
+  if (start < 0) start = 0;
+  int last = end - n; // last position a match can start at
+  uchar c0 = (uchar)str[0];
+  uchar c1 = matchcase ? c0 : (uchar)toupper(c0);
+  c0 = matchcase ? c0 : (uchar)tolower(c0);
+  int pos = start;
+  while (pos <= last) {
+    int s, e;
+    const char* b = run_(pos, &s, &e);
+    if (e > last+1) e = last+1;
+    // find both cases of the first byte, remembering where the other one is:
+    const char* q0 = (const char*)memchr(b+pos, c0, e-pos);
+    const char* q1 = c1 == c0 ? 0 : (const char*)memchr(b+pos, c1, e-pos);
+    for (;;) {
+      const char* q = q0;
+      if (!q || (q1 && q1 < q)) q = q1;
+      if (!q) break;
+      int i = q - b;
+      if (text_match_(i, str, n, matchcase)) return i;
+      if (q == q0) q0 = (const char*)memchr(q+1, c0, b+e-(q+1));
+      else q1 = (const char*)memchr(q+1, c1, b+e-(q+1));
+    }
+    pos = e;
+  }
+  return -1;
+}
+
+// Return the last position at or after start where the n bytes of str
+// are, so that they end by end, or -1:
+int TextBuffer::text_rfind_(int start, int end, const char* str, int n, bool matchcase) const {
+  if (start < 0) start = 0;
+  int pos = end - n;
+  int c0 = matchcase ? (uchar)str[0] : fold((uchar)str[0]);
+  while (pos >= start) {
+    int s, e;
+    const char* b = run_(pos, &s, &e);
+    if (s < start) s = start;
+    for (; pos >= s; pos--) {
+      int c = (uchar)b[pos];
+      if ((matchcase ? c : fold(c)) == c0 && text_match_(pos, str, n, matchcase))
+        return pos;
+    }
+  }
+  return -1;
+}
+
+////////////////////////////////////////////////////////////////
+// Regular expressions:
+
+namespace fltk {
+struct TextRegex {
+  enum {CHAR, ANY, CLASS, BOL, EOL, SPLIT, JMP, MATCH};
+  struct Inst {int op, arg, x, y;};
+  Inst* prog;
+  int n;
+  uchar (*classes)[32];	// bitmaps of bytes for [] and \d etc
+  int nclasses;
+  bool matchcase;
+  int first;		// byte every match starts with, or -1
+  // workspace for the matcher:
+  int* list[2][2];	// pc and start of each thread
+  int* mark[2];		// generation each pc was added to the list
+  int count[2];
+  int gen[2];
+  int* stack;
+};
+}
+
+namespace {
+
+// Parse tree, made first so the size of the program is known:
+struct Node {
+  int op;		// CHAR, ANY, CLASS, BOL, EOL, or one of these:
+  int arg;
+  Node* l;
+  Node* r;
+};
+enum {CAT = 100, ALT, STAR, PLUS, QUEST, EMPTY};
+
+struct Parser {
+  const char* p;
+  Node* nodes;
+  int nnodes;
+  TextRegex* re;
+  bool error;
+
+  Node* node(int op, Node* l = 0, Node* r = 0, int arg = 0) {
+    Node* n = nodes + nnodes++;
+    n->op = op; n->l = l; n->r = r; n->arg = arg;
+    return n;
+  }
+
+  uchar* new_class() {
+    re->classes = (uchar(*)[32])realloc(re->classes, (re->nclasses+1)*32);
+    uchar* c = re->classes[re->nclasses++];
+    memset(c, 0, 32);
+    return c;
+  }
+
+  void set(uchar* c, int i) {
+    if (!re->matchcase) {
+      c[tolower(i)>>3] |= 1<<(tolower(i)&7);
+      c[toupper(i)>>3] |= 1<<(toupper(i)&7);
+    } else
+      c[i>>3] |= 1<<(i&7);
+  }
+
+  // add the \d, \w, \s sets, or their inverse for capital letters:
+  bool escape_class(uchar* c, int e) {
+    int t = tolower(e);
+    if (t != 'd' && t != 'w' && t != 's') return false;
+    for (int i = 0; i < 256; i++) {
+      bool in = t == 'd' ? (i >= '0' && i <= '9') :
+        t == 's' ? (i == ' ' || (i >= '\t' && i <= '\r')) :
+        (isalnum(i) && i < 128) || i == '_';
+      if (in != (e != t)) set(c, i);
+    }
+    return true;
+  }
+
+  Node* atom() {
+    int c = (uchar)*p++;
+    switch (c) {
+    case '(': {
+      Node* n = alt();
+      if (*p != ')') {error = true; return n;}
+      p++;
+      return n;}
+    case '.':
+      return node(TextRegex::ANY);
+    case '^':
+      return node(TextRegex::BOL);
+    case '$':
+      return node(TextRegex::EOL);
+    case '[': {
+      int k = re->nclasses;
+      uchar* set = new_class();
+      bool negate = false;
+      if (*p == '^') {negate = true; p++;}
+      bool first = true;
+      while (*p && (*p != ']' || first)) {
+        first = false;
+        int a = (uchar)*p++;
+        if (a == '\\' && *p) {
+          a = (uchar)*p++;
+          if (escape_class(set, a)) continue;
+        }
+        int b = a;
+        if (*p == '-' && p[1] && p[1] != ']') {
+          b = (uchar)p[1]; p += 2;
+          if (b == '\\' && *p) b = (uchar)*p++;
+        }
+        for (int i = a; i <= b; i++) this->set(set, i);
+      }
+      if (*p != ']') {error = true; return node(EMPTY);}
+      p++;
+      if (negate) for (int i = 0; i < 32; i++) set[i] = ~set[i];
+      return node(TextRegex::CLASS, 0, 0, k);}
+    case '\\':
+      if (!*p) {error = true; return node(EMPTY);}
+      c = (uchar)*p++;
+      { int k = re->nclasses;
+        uchar* set = new_class();
+        if (escape_class(set, c)) return node(TextRegex::CLASS, 0, 0, k);
+        re->nclasses--; }
+      switch (c) {
+      case 'n': c = '\n'; break;
+      case 't': c = '\t'; break;
+      }
+      break;
+    case '*': case '+': case '?': case ')': case '|': case 0:
+      error = true;
+      return node(EMPTY);
+    }
+    return node(TextRegex::CHAR, 0, 0, re->matchcase ? c : fold(c));
+  }
+
+  Node* repeat() {
+    Node* n = atom();
+    for (;;) {
+      if (*p == '*') n = node(STAR, n);
+      else if (*p == '+') n = node(PLUS, n);
+      else if (*p == '?') n = node(QUEST, n);
+      else break;
+      p++;
+    }
+    return n;
+  }
+
+  Node* cat() {
+    Node* n = 0;
+    while (*p && *p != '|' && *p != ')' && !error) {
+      Node* a = repeat();
+      n = n ? node(CAT, n, a) : a;
+    }
+    return n ? n : node(EMPTY);
+  }
+
+  Node* alt() {
+    Node* n = cat();
+    while (*p == '|' && !error) {
+      p++;
+      n = node(ALT, n, cat());
+    }
+    return n;
+  }
+};
+
+int size(const Node* n) {
+  switch (n->op) {
+  case CAT: return size(n->l) + size(n->r);
+  case ALT: return size(n->l) + size(n->r) + 2;
+  case STAR: return size(n->l) + 2;
+  case PLUS: case QUEST: return size(n->l) + 1;
+  case EMPTY: return 0;
+  default: return 1;
+  }
+}
+
+TextRegex::Inst* emit(TextRegex::Inst* pc, const TextRegex::Inst* prog, const Node* n) {
+  TextRegex::Inst* a;
+  switch (n->op) {
+  case CAT:
+    pc = emit(pc, prog, n->l);
+    return emit(pc, prog, n->r);
+  case ALT:
+    a = pc++;
+    a->op = TextRegex::SPLIT;
+    a->x = pc - prog;
+    pc = emit(pc, prog, n->l);
+    { TextRegex::Inst* j = pc++;
+      j->op = TextRegex::JMP;
+      a->y = pc - prog;
+      pc = emit(pc, prog, n->r);
+      j->x = pc - prog; }
+    return pc;
+  case STAR:
+    a = pc++;
+    a->op = TextRegex::SPLIT;
+    a->x = pc - prog;
+    pc = emit(pc, prog, n->l);
+    pc->op = TextRegex::JMP;
+    pc->x = a - prog;
+    pc++;
+    a->y = pc - prog;
+    return pc;
+  case PLUS:
+    a = pc;
+    pc = emit(pc, prog, n->l);
+    pc->op = TextRegex::SPLIT;
+    pc->x = a - prog;
+    pc->y = pc - prog + 1;
+    return pc+1;
+  case QUEST:
+    a = pc++;
+    a->op = TextRegex::SPLIT;
+    a->x = pc - prog;
+    pc = emit(pc, prog, n->l);
+    a->y = pc - prog;
+    return pc;
+  case EMPTY:
+    return pc;
+  default:
+    pc->op = n->op;
+    pc->arg = n->arg;
+    return pc+1;
+  }
+}
+
+void regex_free(TextRegex* re) {
+  if (!re) return;
+  free(re->prog);
+  free(re->classes);
+  for (int i = 0; i < 2; i++) {
+    free(re->list[i][0]);
+    free(re->list[i][1]);
+    free(re->mark[i]);
+  }
+  free(re->stack);
+  delete re;
+}
+
+TextRegex* regex_compile(const char* pattern, bool matchcase) {
+  TextRegex* re = new TextRegex;
+  memset(re, 0, sizeof(*re));
+  re->matchcase = matchcase;
+  Parser parser;
+  parser.p = pattern;
+  parser.nodes = (Node*)malloc((2*strlen(pattern)+2)*sizeof(Node));
+  parser.nnodes = 0;
+  parser.re = re;
+  parser.error = false;
+  Node* tree = parser.alt();
+  if (*parser.p) parser.error = true; // unmatched )
+  if (parser.error) {
+    free(parser.nodes);
+    regex_free(re);
+    return 0;
+  }
+  re->n = size(tree) + 1;
+  re->prog = (TextRegex::Inst*)calloc(re->n, sizeof(TextRegex::Inst));
+  TextRegex::Inst* end = emit(re->prog, re->prog, tree);
+  end->op = TextRegex::MATCH;
+  free(parser.nodes);
+
+  // if every match starts with the same byte, memchr can find them:
+  re->first = -1;
+  if (re->prog[0].op == TextRegex::CHAR) {
+    int c = re->prog[0].arg;
+    if (matchcase || toupper(c) == c) re->first = c;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    re->list[i][0] = (int*)malloc(re->n*sizeof(int));
+    re->list[i][1] = (int*)malloc(re->n*sizeof(int));
+    re->mark[i] = (int*)calloc(re->n, sizeof(int));
+  }
+  re->stack = (int*)malloc((2*re->n+1)*sizeof(int));
+  return re;
+}
+
+}
+
+/*
+ * Add the thread at pc that started at start to list l, following all
+ * the jumps and checking ^ and $ at pos. The threads are kept in the
+ * order they are found, which is the order of preference.
+ */
+void TextBuffer::regex_add_(TextRegex* re, int l, int pc, int start, int pos) const {
+  const char* p = 0; int s = 1, e = 0;
+  int* stack = re->stack;
+  int sp = 0;
+  stack[sp++] = pc;
+  while (sp) {
+    pc = stack[--sp];
+    if (re->mark[l][pc] == re->gen[l]) continue;
+    re->mark[l][pc] = re->gen[l];
+    const TextRegex::Inst& i = re->prog[pc];
+    switch (i.op) {
+    case TextRegex::JMP:
+      stack[sp++] = i.x;
+      break;
+    case TextRegex::SPLIT:
+      stack[sp++] = i.y; // do x first
+      stack[sp++] = i.x;
+      break;
+    case TextRegex::BOL:
+      if (pos == 0 || BYTE(pos-1) == '\n') stack[sp++] = pc+1;
+      break;
+    case TextRegex::EOL:
+      if (pos >= length_ || BYTE(pos) == '\n') stack[sp++] = pc+1;
+      break;
+    default:
+      re->list[l][0][re->count[l]] = pc;
+      re->list[l][1][re->count[l]] = start;
+      re->count[l]++;
+      break;
+    }
+  }
+}
+
+/*
+ * Find the first match starting at or after start, and ending by end.
+ * If anchored is true it must start at start. Returns the start and
+ * puts the end in matchend, or returns -1.
+ */
+int TextBuffer::regex_search_(TextRegex* re, int start, int end, bool anchored,
+                              int* matchend) const {
+  const char* p = 0; int s = 1, e = 0;
+  int matched = -1;
+  int cur = 0;
+  re->count[0] = re->count[1] = 0;
+  re->gen[cur]++;
+  for (int pos = start; ; pos++) {
+    if (matched < 0 && (!anchored || pos == start)) {
+      if (!re->count[cur] && !anchored && re->first >= 0) {
+        // skip to the next place a match can start:
+        const char* q = 0;
+        while (pos < end) {
+          p = run_(pos, &s, &e);
+          int k = (e < end ? e : end) - pos;
+          q = (const char*)memchr(p+pos, re->first, k);
+          if (q) break;
+          pos += k;
+        }
+        if (!q) break;
+        pos = q - p;
+      }
+      regex_add_(re, cur, 0, pos, pos);
+    }
+    if (!re->count[cur]) {
+      if (matched >= 0 || anchored || pos >= end) break;
+      re->gen[cur]++;
+      continue;
+    }
+    int c = pos < end ? BYTE(pos) : -1;
+    if (c >= 0 && !re->matchcase) c = fold(c);
+    int next = !cur;
+    re->count[next] = 0;
+    re->gen[next]++;
+    for (int t = 0; t < re->count[cur]; t++) {
+      int pc = re->list[cur][0][t];
+      const TextRegex::Inst& i = re->prog[pc];
+      bool ok = false;
+      switch (i.op) {
+      case TextRegex::MATCH:
+        matched = re->list[cur][1][t];
+        *matchend = pos;
+        t = re->count[cur]; // threads after this one are not preferred
+        continue;
+      case TextRegex::CHAR:
+        ok = c == i.arg;
+        break;
+      case TextRegex::ANY:
+        ok = c >= 0 && c != '\n';
+        break;
+      case TextRegex::CLASS:
+        ok = c >= 0 && (re->classes[i.arg][c>>3] & (1<<(c&7)));
+        break;
+      }
+      if (ok) regex_add_(re, next, pc+1, re->list[cur][1][t], pos+1);
+    }
+    cur = next;
+    if (pos >= end) break;
+  }
+  return matched;
+}
+
+////////////////////////////////////////////////////////////////
+
+/**
+ * Search forwards for \a pattern, starting at \a startPos. If found,
+ * put the position of the match in \a foundPos and the position after
+ * the end of it in \a foundEnd, and return true. \a flags can have
+ * SEARCH_MATCH_CASE to not ignore the case of letters, and SEARCH_REGEX
+ * to make the pattern a regular expression, which supports . [] [^]
+ * * + ? | () ^ $ \\d \\w \\s \\D \\W \\S and backslash before any other
+ * character to match it. ^ and $ match at the start and end of lines.
+ * A pattern that is not a legal regular expression is never found.
+ */
+bool TextBuffer::search_forward(int startPos, const char* pattern,
+                                int* foundPos, int* foundEnd, int flags) {
+  if (!pattern) return false;
+  bool matchcase = (flags & SEARCH_MATCH_CASE) != 0;
+  if (startPos < 0) startPos = 0;
+  int found, end;
+  if (flags & SEARCH_REGEX) {
+    TextRegex* re = regex_compile(pattern, matchcase);
+    if (!re) return false;
+    found = regex_search_(re, startPos, length_, false, &end);
+    regex_free(re);
+  } else {
+    int n = strlen(pattern);
+    if (!n) found = startPos < length_ ? startPos : -1;
+    else found = text_find_(startPos, length_, pattern, n, matchcase);
+    end = found + n;
+  }
+  if (found < 0) return false;
+  *foundPos = found;
+  if (foundEnd) *foundEnd = end;
+  return true;
+}
+
+/**
+ * Search backwards for the last match of \a pattern that ends at or
+ * before \a startPos. See search_forward() for the flags.
+ */
+bool TextBuffer::search_backward(int startPos, const char* pattern,
+                                 int* foundPos, int* foundEnd, int flags) {
+  if (!pattern) return false;
+  bool matchcase = (flags & SEARCH_MATCH_CASE) != 0;
+  if (startPos > length_) startPos = length_;
+  int found = -1, end;
+  if (flags & SEARCH_REGEX) {
+    TextRegex* re = regex_compile(pattern, matchcase);
+    if (!re) return false;
+    const char* p = 0; int s = 1, e = 0;
+    for (int pos = startPos-1; pos >= 0; pos--) {
+      if (re->first >= 0) {
+        while (pos >= 0 && BYTE(pos) != re->first) pos--;
+        if (pos < 0) break;
+      }
+      found = regex_search_(re, pos, startPos, true, &end);
+      if (found >= 0) break;
+    }
+    regex_free(re);
+  } else {
+    int n = strlen(pattern);
+    if (!n) found = startPos > 0 ? startPos : -1;
+    else found = text_rfind_(0, startPos, pattern, n, matchcase);
+    end = found + n;
+  }
+  if (found < 0) return false;
+  *foundPos = found;
+  if (foundEnd) *foundEnd = end;
+  return true;
+}
+
+/**
+ * Find all the matches of \a pattern between \a start and \a end (or
+ * the end of the buffer if \a end is negative), for instance to
+ * highlight them. \a ranges is set to a malloc'd array of the start
+ * and end of each match, which the caller must free(). Returns the
+ * number of matches, or -1 if a regular expression is not legal.
+ * See search_forward() for the flags. A regular expression that
+ * matches nothing is found at each place, but not twice in a row.
+ */
+int TextBuffer::search_all(const char* pattern, int** ranges, int flags,
+                           int start, int end) {
+  *ranges = 0;
+  if (!pattern) return 0;
+  bool matchcase = (flags & SEARCH_MATCH_CASE) != 0;
+  if (start < 0) start = 0;
+  if (end < 0 || end > length_) end = length_;
+  TextRegex* re = 0;
+  int n = strlen(pattern);
+  if (flags & SEARCH_REGEX) {
+    re = regex_compile(pattern, matchcase);
+    if (!re) return -1;
+  } else if (!n) return 0;
+
+  int count = 0, alloc = 0;
+  int* r = 0;
+  for (int pos = start; pos <= end;) {
+    int found, fend;
+    if (re) found = regex_search_(re, pos, end, false, &fend);
+    else {found = text_find_(pos, end, pattern, n, matchcase); fend = found + n;}
+    if (found < 0) break;
+    if (count >= alloc) {
+      alloc = alloc ? 2*alloc : 64;
+      r = (int*)realloc(r, 2*alloc*sizeof(int));
+    }
+    r[2*count] = found;
+    r[2*count+1] = fend;
+    count++;
+    pos = fend > found ? fend : found + 1;
+  }
+  regex_free(re);
+  *ranges = r;
+  return count;
+}
+
+/**
+ * Search forwards in buffer for string "searchString", starting with the
+ * character "startpos", and returning the result in "foundPos"
+ * returns 1 if found, 0 if not.
+ */
+bool TextBuffer::search_forward(int startpos, const char *searchString,
+                               int *foundPos, bool matchCase)
+{
+  return search_forward(startpos, searchString, foundPos, 0,
+                        matchCase ? SEARCH_MATCH_CASE : 0);
+}
+
+/**
+ * Search backwards in buffer for string "searchString", for a match
+ * that ends at or before "startpos", and returning the result in
+ * "foundPos". Returns 1 if found, 0 if not.
+ */
+bool TextBuffer::search_backward(int startpos, const char *searchString,
+                                 int *foundPos, bool matchCase)
+{
+  return search_backward(startpos, searchString, foundPos, 0,
+                         matchCase ? SEARCH_MATCH_CASE : 0);
+}
+
+//
+// End of "$Id$".
+//
@@ -41,6 +41,7 @@
 #include <fltk/layout.h>
 #include <fltk/utf.h>
 #include <fltk/Input.h>
+#include <fltk/run.h>
 
 // Similar to utf8len in TextBuffer except it returns zero for characters
 // that are illegal. Code here seems to rely on this and does not work
@@ -155,6 +156,21 @@ TextDisplay::TextDisplay(int X, int Y, int W, int H,  const char* l)
 
   linenumleft_ = linenumwidth_ = 0;
 
+  log_maxlines_ = 0;
+  log_text_ = 0;
+  log_length_ = log_size_ = 0;
+  scrolldy_ = 0;
+
+  lineoffsets_ = 0;
+  nlineoffsets_ = 0;
+  offsetsfont_ = 0;
+  offsetssize_ = 0;
+
+  wraprows_ = wraptree_ = 0;
+  wrapnlines_ = wrapsize_ = wrapunknown_ = wrapnext_ = 0;
+  wrapchars_ = 1;
+  wrapidle_ = false;
+
   // Copied from Input:
   style(Input::default_style);
   clear_flag(ALIGN_MASK);
@@ -175,6 +191,16 @@ TextDisplay::~TextDisplay() {
     buffer_->remove_predelete_callback(buffer_predelete_cb, this);
   }
   if (linestarts_) delete[] linestarts_;
+  for (int i = 0; i < nlineoffsets_; i++) {
+    delete[] lineoffsets_[i].index;
+    delete[] lineoffsets_[i].x;
+  }
+  delete[] lineoffsets_;
+  wrap_index_clear();
+  if (log_text_) {
+    remove_check(log_flush_cb, this);
+    free(log_text_);
+  }
 }
 
 /*
@@ -223,6 +249,8 @@ void TextDisplay::buffer(TextBuffer *buf) {
  * (see extendRangeForStyleMods for more information on this protocol).
  *
  * Style buffers, tables and their associated memory are managed by the caller.
+ * A null styleBuffer turns highlighting off. See TextHighlighter for a
+ * class that keeps a style buffer up to date.
  */
 void TextDisplay::highlight_data(TextBuffer *styleBuffer,
 				 StyleTableEntry *styleTable,
@@ -235,7 +263,8 @@ void TextDisplay::highlight_data(TextBuffer *styleBuffer,
   unfinished_highlight_cb_ = unfinishedHighlightCB;
   highlight_cbarg_ = cbArg;
 
-  stylebuffer_->canUndo(0);
+  if (stylebuffer_) stylebuffer_->canUndo(0);
+  clear_line_offsets(0, INT_MAX);
 
   /* Relayout/redraw widget */
   relayout();
@@ -343,9 +372,9 @@ void TextDisplay::layout() {
        the top character no longer pointing at a valid line start */
     if (continuous_wrap_ && !wrapmargin_ && ldamage&LAYOUT_W) {
       int oldFirstChar = firstchar_;
-      bufferlines_cnt_ = count_lines(0, buffer()->length(), true);
       firstchar_ = line_start(firstchar_);
-      topline_num_ = count_lines(0, firstchar_, true)+1;
+      wrap_index_reset();
+      topline_num_ = wrap_top_line();
       absolute_top_line_number(oldFirstChar);
     }
  
@@ -479,6 +508,9 @@ void TextDisplay::redisplay_range(int startpos, int endpos) {
   startpos = find_prev_char(startpos-1);
   endpos   = find_next_char(endpos+1);
 
+  /* the styles may have changed, altering the widths */
+  if (stylebuffer_) clear_line_offsets(startpos, endpos);
+
   if (damage_range1_start == -1 && damage_range1_end == -1) {
     damage_range1_start = startpos;
     damage_range1_end = endpos;
@@ -496,6 +528,14 @@ void TextDisplay::redisplay_range(int startpos, int endpos) {
   redraw(DAMAGE_SCROLL);
 }
 
+// Called by scrollrect() to draw the area scrolled into view
+void TextDisplay::draw_scrolled_cb(void* v, const Rectangle& r) {
+  TextDisplay* d = (TextDisplay*)v;
+  fltk::push_clip(r);
+  d->draw_text(r.x(), r.y(), r.w(), r.h());
+  fltk::pop_clip();
+}
+
 /*
  * Refresh all of the text between buffer positions "start" and "end"
  * not including the character at the position "end".
@@ -603,14 +643,20 @@ void TextDisplay::wrap_mode(bool wrap, int wrapMargin) {
   wrapmargin_ = wrapMargin;
   continuous_wrap_ = wrap;
 
-  /* wrapping can change change the total number of lines, re-count */
-  bufferlines_cnt_ = count_lines(0, buffer()->length(), true);
-
   /* changing wrap margins wrap or changing from wrapped mode to non-wrapped
      can leave the character at the top no longer at a line start, and/or
      change the line number */
   firstchar_ = line_start(firstchar_);
-  topline_num_ = count_lines(0, firstchar_, true) + 1;
+
+  /* wrapping can change change the total number of lines, re-count */
+  if (wrap) {
+    wrap_index_reset();
+    topline_num_ = wrap_top_line();
+  } else {
+    wrap_index_clear();
+    bufferlines_cnt_ = buffer()->count_lines(0, buffer()->length());
+    topline_num_ = buffer()->count_lines(0, firstchar_) + 1;
+  }
   reset_absolute_top_line_number();
 
   /* update the line starts array */
@@ -635,6 +681,82 @@ void TextDisplay::insert(const char *text) {
   cursor_hint_ = NO_HINT;
 }
 
+/**
+  Turn on log mode, for displays that text is being continuously
+  added to, such as the output of a program. log_append() then saves
+  the text and adds it all at once when the event loop next checks,
+  so the display is redone once no matter how many lines come in. If
+  the end of the text was showing, the display scrolls to keep showing
+  it, by moving the pixels already drawn and drawing only the new
+  lines. Lines are deleted from the start of the buffer when there are
+  more than \a maxlines. The buffer is changed to
+  TextBuffer::PIECE_TABLE storage so this is fast.
+
+  Zero turns log mode off, adding any text that is waiting.
+*/
+void TextDisplay::log_mode(int maxlines) {
+  if (maxlines < 0) maxlines = 0;
+  if (!maxlines) log_flush();
+  log_maxlines_ = maxlines;
+  if (maxlines && buffer_) {
+    buffer_->storage(TextBuffer::PIECE_TABLE);
+    log_flush();
+  }
+}
+
+/**
+  Add text to the end of the buffer. If log_mode() is on this is
+  delayed until the next time the event loop checks, or until
+  log_flush() is called, otherwise this is the same as append()
+  except the insert_position() is not changed.
+*/
+void TextDisplay::log_append(const char *text) {
+  if (!buffer_ || !text || !*text) return;
+  if (!log_maxlines_) {
+    buffer_->append(text);
+    return;
+  }
+  int n = strlen(text);
+  if (log_length_ + n >= log_size_) {
+    log_size_ = 2*(log_length_ + n) + 1024;
+    log_text_ = (char*)realloc(log_text_, log_size_);
+  }
+  if (!log_length_) add_check(log_flush_cb, this);
+  memcpy(log_text_ + log_length_, text, n);
+  log_length_ += n;
+}
+
+void TextDisplay::log_flush_cb(void* v) {
+  ((TextDisplay*)v)->log_flush();
+}
+
+void TextDisplay::log_flush() {
+  if (!log_length_) return;
+  remove_check(log_flush_cb, this);
+  log_text_[log_length_] = 0;
+  log_length_ = 0;
+  if (!buffer_) return;
+
+  // follow the end if it is showing:
+  bool follow = lastchar_ + 1 >= buffer_->length();
+
+  buffer_->append(log_text_);
+  if (log_maxlines_) {
+    int extra = buffer_->count_lines(0, buffer_->length()) - log_maxlines_;
+    if (extra > 0) buffer_->remove(0, buffer_->line_to_position(extra));
+  }
+  if (log_size_ > 64*1024) { // don't keep a big burst around
+    free(log_text_);
+    log_text_ = 0;
+    log_size_ = 0;
+  }
+
+  if (follow) {
+    int top = bufferlines_cnt_ + 2 - visiblelines_cnt_;
+    scroll(top < 1 ? 1 : top, horiz_offset_);
+  }
+}
+
 /*
  * Insert "text" (which must not contain newlines), overstriking the current
  * cursor location.
@@ -707,10 +829,7 @@ void TextDisplay::overstrike(const char *text) {
  * X coordinate where the position would be if it were visible.
  */
 bool TextDisplay::position_to_xy(int pos, int *X, int *Y) {
-  int charIndex, lineStartPos, fontHeight, lineLen;
-  int visLineNum, charLen, outIndex, xStep, charStyle;
-  char expandedChar[TEXT_MAX_EXP_CHAR_LEN];
-  char *lineStr;
+  int lineStartPos, fontHeight, visLineNum;
 
   /* If position is not displayed, return false */
   if (pos < firstchar_ || (pos > lastchar_ && !empty_vlines())) {
@@ -737,33 +856,15 @@ bool TextDisplay::position_to_xy(int pos, int *X, int *Y) {
     *X = text_area.x() - horiz_offset_;
     return true;
   }
-  lineLen = vline_length(visLineNum);
-  lineStr = buffer_->text_range(lineStartPos, lineStartPos + lineLen);
-
-  /* Step through character positions from the beginning of the line
-     to "pos" to calculate the X coordinate */
-  xStep = text_area.x() - horiz_offset_;
-  outIndex = 0;
-  for (charIndex = 0; charIndex < lineLen && charIndex < pos - lineStartPos; charIndex++) {
-    charLen = TextBuffer::expand_character(lineStr[charIndex], outIndex, expandedChar,
-    		                          buffer_->tab_distance(), buffer_->null_substitution_character());
-
-    // UTF-8
-    bool utf8 = false;
-    if (lineStr[charIndex] & 0x80) {
-      charLen = utf8seqlen(lineStr[charIndex]);
-      memcpy(expandedChar, &lineStr[charIndex], charLen);
-      utf8 = true;
-    }
-
-    charStyle = position_style(lineStartPos, lineLen, charIndex, outIndex);
-    xStep += string_width(expandedChar, charLen, charStyle);
-    // UTF-8
-    if (utf8 && charLen > 1) charIndex += (charLen-1);
-    outIndex += charLen;    
+  /* Find the first character at or after pos in the measured line */
+  const LineOffsets* o = line_offsets(visLineNum);
+  int i = pos - lineStartPos;
+  int lo = 0, hi = o->count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (o->index[mid] < i) lo = mid + 1; else hi = mid;
   }
-  *X = xStep;
-  free(lineStr);
+  *X = text_area.x() - horiz_offset_ + o->x[lo];
   return true;
 }
 
@@ -1210,9 +1311,25 @@ void TextDisplay::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   int wrapModStart, wrapModEnd;
   bool scrolled;
 
-  /* buffer modification cancels vertical cursor motion column */
-  if (nInserted != 0 || nDeleted != 0)
+  /* buffer modification cancels vertical cursor motion column, and
+     moves or changes the measured lines after pos */
+  if (nInserted != 0 || nDeleted != 0) {
     textD->cursor_preferred_col_ = -1;
+    textD->clear_line_offsets(pos, INT_MAX);
+    if (textD->continuous_wrap_)
+      textD->wrap_index_changed(pos, nInserted, nDeleted, deletedText);
+  }
+
+  /* In continuous wrap mode with proportional fonts the deleted lines
+     must be measured by the predelete callback. It is not called for
+     the single merged change reported by TextBuffer::end_batch(), or
+     when a buffer is attached, so recount everything instead. That is
+     slow but it is only done once for the whole batch. */
+  if (textD->continuous_wrap_ && textD->fixed_fontwidth_ == -1 &&
+      !textD->suppressresync_ && (nInserted != 0 || nDeleted != 0)) {
+    textD->resync_all(pos, nInserted, nDeleted);
+    return;
+  }
 
   /* Count the number of lines inserted and deleted, and in the case
      of continuous wrap mode, how much has changed */
@@ -1248,8 +1365,14 @@ void TextDisplay::buffer_modified_cb( int pos, int nInserted, int nDeleted,
       textD->reset_absolute_top_line_number();
   }
 
-  /* Update the line count for the whole buffer */
-  textD->bufferlines_cnt_ += linesInserted - linesDeleted;
+  /* Update the line count for the whole buffer. The wrap index may
+     hold estimates, so the rows before the top line are taken from it
+     too, to keep the scrollbar consistent with offset_line_starts() */
+  if (textD->wraprows_) {
+    textD->bufferlines_cnt_ = textD->wrap_rows_before(textD->wrapnlines_);
+    if (pos <= oldFirstChar) textD->topline_num_ = textD->wrap_top_line();
+  } else
+    textD->bufferlines_cnt_ += linesInserted - linesDeleted;
 
   /* Update the cursor position */
   if (textD->cursor_hint_ != NO_HINT) {
@@ -1315,6 +1438,281 @@ void TextDisplay::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   textD->redisplay_range(startDispPos, endDispPos);
 }
 
+/*
+ * Recalculate everything after nDeleted characters at pos were replaced
+ * with nInserted ones, for when the changed lines can't be figured out.
+ * The top line stays at the same text if it was not changed.
+ */
+void TextDisplay::resync_all(int pos, int nInserted, int nDeleted) {
+  TextBuffer *buf = buffer_;
+  int delta = nInserted - nDeleted;
+
+  if (firstchar_ >= pos + nDeleted) firstchar_ += delta;
+  else if (firstchar_ > pos) firstchar_ = pos;
+  if (cursor_hint_ != NO_HINT) {
+    cursor_pos_ = cursor_hint_;
+    cursor_hint_ = NO_HINT;
+  } else if (cursor_pos_ >= pos + nDeleted) cursor_pos_ += delta;
+  else if (cursor_pos_ > pos) cursor_pos_ = pos;
+  if (firstchar_ > buf->length()) firstchar_ = buf->length();
+
+  firstchar_ = line_start(firstchar_);
+  if (wraprows_)
+    bufferlines_cnt_ = wrap_rows_before(wrapnlines_);
+  else
+    wrap_index_reset();
+  topline_num_ = wrap_top_line();
+  calc_line_starts(0, visiblelines_cnt_);
+  calc_last_char();
+  reset_absolute_top_line_number();
+
+  relayout();
+  redraw();
+}
+
+/*
+ * The wrap index remembers how many rows each line of the buffer wraps
+ * into in continuous wrap mode, so the total and the row number of the
+ * top line can be found without wrapping the whole buffer. When the
+ * width changes only the lines on the screen are wrapped; the others
+ * get an estimate from their length, which wrap_idle_job() replaces with
+ * the real count in idle time. A Fenwick tree over the counts
+ * finds the rows before a line, or the line holding a row, quickly.
+ */
+
+/* Changed lines measured right away, more are estimated */
+#define WRAP_MEASURE_LINES 64
+
+/* Estimated rows for a line of n bytes, possibly the last one */
+static int estimate_rows(int n, bool last, float chars) {
+  if (n <= 0) return last ? 0 : 1;
+  return int((n - 1) / chars) + 1;
+}
+
+int TextDisplay::wrap_estimate(int line) {
+  int start = buffer_->line_to_position(line);
+  if (line + 1 < wrapnlines_)
+    return estimate_rows(buffer_->line_to_position(line + 1) - 1 - start,
+			   false, wrapchars_);
+  return estimate_rows(buffer_->length() - start, true, wrapchars_);
+}
+
+/* Return how many rows a line really wraps into */
+int TextDisplay::wrap_count(int line) {
+  int retPos, retLines, retLineStart, retLineEnd;
+  int start = buffer_->line_to_position(line);
+  if (line + 1 < wrapnlines_) {
+    wrapped_line_counter(buffer_, start, buffer_->line_to_position(line + 1) - 1,
+			 INT_MAX, true, 0, &retPos, &retLines, &retLineStart,
+			 &retLineEnd);
+    return retLines + 1;
+  }
+  wrapped_line_counter(buffer_, start, buffer_->length(), INT_MAX, true, 0,
+		       &retPos, &retLines, &retLineStart, &retLineEnd);
+  return retLines;
+}
+
+/* Replace the estimate for a line with the real count, and return it */
+int TextDisplay::wrap_measure(int line) {
+  int v = wraprows_[line];
+  if (v >= 0) return v;
+  int rows = wrap_count(line);
+  wraprows_[line] = rows;
+  wrapunknown_--;
+  wrap_tree_add(line, rows + 1 + v);
+  bufferlines_cnt_ += rows + 1 + v;
+  return rows;
+}
+
+void TextDisplay::wrap_tree_build() {
+  int n = wrapnlines_, i, j;
+  for (i = 1; i <= n; i++) {
+    int v = wraprows_[i-1];
+    wraptree_[i] = v < 0 ? -1 - v : v;
+  }
+  for (i = 1; i <= n; i++) {
+    j = i + (i & -i);
+    if (j <= n) wraptree_[j] += wraptree_[i];
+  }
+}
+
+void TextDisplay::wrap_tree_add(int line, int delta) {
+  if (!delta) return;
+  for (int i = line + 1; i <= wrapnlines_; i += i & -i)
+    wraptree_[i] += delta;
+}
+
+/* Return the rows in all the lines before line */
+int TextDisplay::wrap_rows_before(int line) {
+  int rows = 0;
+  for (int i = line; i > 0; i -= i & -i)
+    rows += wraptree_[i];
+  return rows;
+}
+
+/* Return the line holding the row (counting from zero), and the rows
+   before that line in *rowsBefore */
+int TextDisplay::wrap_find_row(int row, int* rowsBefore) {
+  int line = 0, rows = 0, step = 1;
+  while (2 * step <= wrapnlines_) step *= 2;
+  for (; step; step /= 2) {
+    if (line + step <= wrapnlines_ && rows + wraptree_[line + step] <= row) {
+      line += step;
+      rows += wraptree_[line];
+    }
+  }
+  if (line >= wrapnlines_) {
+    line = wrapnlines_ - 1;
+    rows = wrap_rows_before(line);
+  }
+  *rowsBefore = rows;
+  return line;
+}
+
+/* Return topline_num_ for firstchar_ as the index sees it */
+int TextDisplay::wrap_top_line() {
+  int line = buffer_->position_to_line(firstchar_);
+  int start = buffer_->line_to_position(line);
+  return wrap_rows_before(line) + count_lines(start, firstchar_, true) + 1;
+}
+
+/*
+ * Estimate the rows of every line for the current width, measure the
+ * lines starting at firstchar_ that fill the screen, and set
+ * bufferlines_cnt_. The rest is measured by wrap_idle_job().
+ */
+void TextDisplay::wrap_index_reset() {
+  TextBuffer *buf = buffer_;
+  int n = buf->position_to_line(buf->length()) + 1;
+  int i;
+
+  if (n > wrapsize_) {
+    wrapsize_ = n + n / 4 + 16;
+    wraprows_ = (int*)realloc(wraprows_, wrapsize_ * sizeof(int));
+    wraptree_ = (int*)realloc(wraptree_, (wrapsize_ + 1) * sizeof(int));
+  }
+  wrapnlines_ = wrapunknown_ = n;
+  wrapnext_ = 0;
+
+  if (wrapmargin_)
+    wrapchars_ = float(wrapmargin_);
+  else if (fixed_fontwidth_ > 0)
+    wrapchars_ = float(text_area.w() / fixed_fontwidth_);
+  else {
+    static const char sample[] = "the quick brown fox jumps over the lazy dog";
+    setfont(textfont(), textsize());
+    float w = getwidth(sample, sizeof(sample) - 1);
+    wrapchars_ = w > 0 ? text_area.w() * (sizeof(sample) - 1) / w : 1;
+  }
+  if (wrapchars_ < 1) wrapchars_ = 1;
+
+  int start = 0, end;
+  for (i = 0; i < n; i++) {
+    buf->findchar_forward(start, '\n', &end);
+    wraprows_[i] = -1 - estimate_rows(end - start, i + 1 == n, wrapchars_);
+    start = end + 1;
+  }
+  wrap_tree_build();
+  bufferlines_cnt_ = wrap_rows_before(n);
+
+  int rows = 0;
+  for (i = buf->position_to_line(firstchar_); i < n && rows < visiblelines_cnt_; i++)
+    rows += wrap_measure(i);
+
+  if (wrapunknown_ && !wrapidle_) {
+    add_idle_job(wrap_idle_job, this, 1);
+    wrapidle_ = true;
+  }
+}
+
+/* Throw away the wrap index, when not in continuous wrap mode */
+void TextDisplay::wrap_index_clear() {
+  if (wrapidle_) {
+    remove_idle_job(wrap_idle_job, this);
+    wrapidle_ = false;
+  }
+  free(wraprows_);
+  free(wraptree_);
+  wraprows_ = wraptree_ = 0;
+  wrapnlines_ = wrapsize_ = wrapunknown_ = wrapnext_ = 0;
+}
+
+/*
+ * Update the wrap index after nDeleted characters at pos were replaced
+ * with nInserted ones. Only the changed lines are counted again.
+ */
+void TextDisplay::wrap_index_changed(int pos, int nInserted, int nDeleted,
+				     const char* deletedText) {
+  TextBuffer *buf = buffer_;
+  if (!wraprows_ || (nDeleted && !deletedText)) {
+    wrap_index_reset();
+    return;
+  }
+  int line = buf->position_to_line(pos);
+  int nDel = nDeleted ? countlines(deletedText) : 0;
+  int nIns = nInserted ? buf->count_lines(pos, pos + nInserted) : 0;
+  int n = wrapnlines_ + nIns - nDel;
+  int i;
+  if (line + nDel >= wrapnlines_) { // can't happen, but don't crash
+    wrap_index_reset();
+    return;
+  }
+
+  for (i = line; i <= line + nDel; i++)
+    if (wraprows_[i] < 0) wrapunknown_--;
+  if (nIns != nDel) {
+    if (n > wrapsize_) {
+      wrapsize_ = n + n / 4 + 16;
+      wraprows_ = (int*)realloc(wraprows_, wrapsize_ * sizeof(int));
+      wraptree_ = (int*)realloc(wraptree_, (wrapsize_ + 1) * sizeof(int));
+    }
+    memmove(wraprows_ + line + nIns + 1, wraprows_ + line + nDel + 1,
+	    (wrapnlines_ - line - nDel - 1) * sizeof(int));
+    wrapnlines_ = n;
+  }
+
+  for (i = line; i <= line + nIns; i++) {
+    int old = wraprows_[i];
+    int v;
+    if (nIns < WRAP_MEASURE_LINES)
+      v = wrap_count(i);
+    else {
+      v = -1 - wrap_estimate(i);
+      wrapunknown_++;
+    }
+    wraprows_[i] = v;
+    if (nIns == nDel)
+      wrap_tree_add(i, (v < 0 ? -1 - v : v) - (old < 0 ? -1 - old : old));
+  }
+  if (nIns != nDel) wrap_tree_build();
+
+  if (wrapunknown_ && !wrapidle_) {
+    add_idle_job(wrap_idle_job, this, 1);
+    wrapidle_ = true;
+  }
+}
+
+/*
+ * Measure some of the lines that only have an estimate, fixing the line
+ * count and the top line number so the scrollbar gets more accurate.
+ */
+bool TextDisplay::wrap_idle_job(void* v) {
+  TextDisplay *d = (TextDisplay *)v;
+  int top = d->buffer_->position_to_line(d->firstchar_);
+  int oldTotal = d->bufferlines_cnt_;
+  while (d->wrapunknown_ && !idle_slice_over()) {
+    if (d->wrapnext_ >= d->wrapnlines_) d->wrapnext_ = 0;
+    int line = d->wrapnext_++;
+    if (d->wraprows_[line] >= 0) continue;
+    int before = d->bufferlines_cnt_;
+    d->wrap_measure(line);
+    if (line < top) d->topline_num_ += d->bufferlines_cnt_ - before;
+  }
+  if (!d->wrapunknown_) d->wrapidle_ = false;
+  if (d->bufferlines_cnt_ != oldTotal) d->update_v_scrollbar();
+  return d->wrapidle_;
+}
+
 /*
  * In continuous wrap mode, internal line numbers are calculated after
  * wrapping.  A separate non-wrapped line count is maintained when line
@@ -1858,6 +2256,101 @@ int TextDisplay::string_width(const char *string, int length, int style) {
   return (int)fltk::getwidth(string, length);
 }
 
+/*
+ * Return the x position of each character of a displayed line, measured
+ * from the start of the line, so position_to_xy() and xy_to_position()
+ * don't have to measure them all again. The last x is the width of the
+ * line. These are remembered for each visible line until that text (or
+ * its style) is changed.
+ */
+const TextDisplay::LineOffsets* TextDisplay::line_offsets(int visLineNum) {
+  int i;
+  if (visLineNum >= nlineoffsets_) {
+    int n = max(visLineNum + 1, visiblelines_cnt_);
+    LineOffsets* a = new LineOffsets[n];
+    memcpy(a, lineoffsets_, nlineoffsets_ * sizeof(LineOffsets));
+    for (i = nlineoffsets_; i < n; i++) {
+      a[i].start = -2;
+      a[i].size = 0;
+      a[i].index = a[i].x = 0;
+    }
+    delete[] lineoffsets_;
+    lineoffsets_ = a;
+    nlineoffsets_ = n;
+  }
+  if (offsetsfont_ != textfont() || offsetssize_ != textsize()) {
+    clear_line_offsets(0, INT_MAX);
+    offsetsfont_ = textfont();
+    offsetssize_ = textsize();
+  }
+
+  int lineStartPos = linestarts_[visLineNum];
+  int lineLen = lineStartPos < 0 ? 0 : vline_length(visLineNum);
+  LineOffsets* o = &lineoffsets_[visLineNum];
+  if (o->start == lineStartPos && o->length == lineLen) return o;
+  /* a scrolled line may have been measured in another slot: */
+  for (i = 0; i < nlineoffsets_; i++) {
+    LineOffsets* p = &lineoffsets_[i];
+    if (p->start == lineStartPos && p->length == lineLen) {
+      LineOffsets t = *o; *o = *p; *p = t;
+      return o;
+    }
+  }
+
+  o->start = lineStartPos;
+  o->length = lineLen;
+  if (o->size < lineLen + 1) {
+    delete[] o->index;
+    delete[] o->x;
+    o->size = lineLen + 1;
+    o->index = new int[o->size];
+    o->x = new int[o->size];
+  }
+  int n = 0, xStep = 0;
+  if (lineLen) {
+    char expandedChar[TEXT_MAX_EXP_CHAR_LEN];
+    char *lineStr = buffer_->text_range(lineStartPos, lineStartPos + lineLen);
+    int outIndex = 0;
+    for (int charIndex = 0; charIndex < lineLen; charIndex++) {
+      o->index[n] = charIndex;
+      o->x[n] = xStep;
+      n++;
+      int charLen = TextBuffer::expand_character(lineStr[charIndex], outIndex, expandedChar,
+				buffer_->tab_distance(), buffer_->null_substitution_character());
+
+      // UTF-8
+      bool utf8 = false;
+      if (lineStr[charIndex] & 0x80) {
+	charLen = utf8seqlen(lineStr[charIndex]);
+	memcpy(expandedChar, &lineStr[charIndex], charLen);
+	utf8 = true;
+      }
+
+      int charStyle = position_style(lineStartPos, lineLen, charIndex, outIndex);
+      xStep += string_width(expandedChar, charLen, charStyle);
+      // UTF-8
+      if (utf8 && charLen > 1) charIndex += (charLen-1);
+      outIndex += charLen;
+    }
+    free(lineStr);
+  }
+  o->count = n;
+  o->index[n] = lineLen;
+  o->x[n] = xStep;
+  return o;
+}
+
+/*
+ * Forget the measurements of displayed lines that touch startpos..endpos.
+ */
+void TextDisplay::clear_line_offsets(int startpos, int endpos) {
+  for (int i = 0; i < nlineoffsets_; i++) {
+    LineOffsets* o = &lineoffsets_[i];
+    if (o->start != -2 && o->start <= endpos && o->start + o->length >= startpos)
+      o->start = -2;
+  }
+}
+
 /**
  * Translate window coordinates to the nearest (insert cursor or character
  * cell) text position.  The parameter posType specifies how to interpret the
@@ -1866,10 +2359,7 @@ int TextDisplay::string_width(const char *string, int length, int style) {
  * closest to (X, Y).
  */
 int TextDisplay::xy_to_position(int X, int Y, int posType) {
-  int charIndex, lineStart, lineLen, fontHeight;
-  int charWidth, charLen, charStyle, visLineNum, xStep, outIndex;
-  char expandedChar[TEXT_MAX_EXP_CHAR_LEN];
-  char *lineStr;
+  int lineStart, fontHeight, visLineNum;
 
   /* Find the visible line number corresponding to the Y coordinate */
   fontHeight = maxsize_;
@@ -1886,42 +2376,24 @@ int TextDisplay::xy_to_position(int X, int Y, int posType) {
   if (lineStart == -1)
     return buffer_->length();
 
-  /* Get the line text and its length */
-  lineLen = vline_length(visLineNum);
-  lineStr = buffer_->text_range(lineStart, lineStart + lineLen);
-
-  /* Step through character positions from the beginning of the line
-     to find the character position corresponding to the X coordinate */
-  xStep = text_area.x() - horiz_offset_;
-  outIndex = 0;
-  for (charIndex = 0; charIndex < lineLen; charIndex++) {
-    charLen = TextBuffer::expand_character( lineStr[charIndex], outIndex, expandedChar,
-					    buffer_->tab_distance(), buffer_->null_substitution_character());
-
-    // UTF-8
-    bool utf8 = false;
-    if (lineStr[charIndex] & 0x80) {
-      charLen = utf8seqlen(lineStr[charIndex]);
-      memcpy(expandedChar, &lineStr[charIndex], charLen);
-      utf8 = true;
-    }
-
-    charStyle = position_style(lineStart, lineLen, charIndex, outIndex);
-    charWidth = string_width(expandedChar, charLen, charStyle);
-    if (X < xStep + (posType == CURSOR_POS ? charWidth / 2 : charWidth)) {
-      free(lineStr);
-      return lineStart + charIndex;
-    }
-    xStep += charWidth;
-    // UTF-8
-    if (utf8 && charLen > 1) charIndex += (charLen-1);
-    outIndex += charLen;
+  /* Binary search the measured line for the first character whose
+     middle (or right edge) is to the right of X */
+  const LineOffsets* o = line_offsets(visLineNum);
+  X -= text_area.x() - horiz_offset_;
+  int lo = 0, hi = o->count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    int charWidth = o->x[mid+1] - o->x[mid];
+    if (X < o->x[mid] + (posType == CURSOR_POS ? charWidth / 2 : charWidth))
+      hi = mid;
+    else
+      lo = mid + 1;
   }
+  if (lo < o->count) return lineStart + o->index[lo];
 
   /* If the X position was beyond the end of the line, return the position
      of the newline at the end of the line */
-  free(lineStr);
-  return lineStart + lineLen;
+  return lineStart + o->length;
 }
 
 /**
@@ -1970,12 +2442,23 @@ void TextDisplay::offset_line_starts(int newTopLineNum) {
      known line start (start or end of buffer, or the closest value in the
      lineStarts array) */
   lastLineNum = oldTopLineNum + nVisLines - 1;
-  if (newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta) {
+  if (newTopLineNum > oldTopLineNum && newTopLineNum < lastLineNum) {
+    firstchar_ = lineStarts[newTopLineNum - oldTopLineNum];
+  } else if (wraprows_) {
+    /* In continuous wrap mode the index finds the line holding the row,
+       and only the rows in that line are counted. The lines about to be
+       shown are measured first, so their estimates are not used */
+    int rowsBefore, rows = 0;
+    int line = wrap_find_row(newTopLineNum - 1, &rowsBefore);
+    for (i = line; i < wrapnlines_ && rows < newTopLineNum - 1 - rowsBefore + nVisLines; i++)
+      rows += wrap_measure(i);
+    line = wrap_find_row(newTopLineNum - 1, &rowsBefore);
+    firstchar_ = skip_lines(buf->line_to_position(line),
+			    newTopLineNum - 1 - rowsBefore, true);
+  } else if (newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta) {
     firstchar_ = skip_lines(0, newTopLineNum - 1, true);
   } else if (newTopLineNum < oldTopLineNum) {
     firstchar_ = rewind_lines(firstchar_, -lineDelta);
-  } else if (newTopLineNum < lastLineNum) {
-    firstchar_ = lineStarts[newTopLineNum - oldTopLineNum];
   } else if (newTopLineNum - lastLineNum < bufferlines_cnt_ - newTopLineNum) {
     firstchar_ = skip_lines(lineStarts[ nVisLines - 1 ], newTopLineNum - lastLineNum, true);
   } else {
@@ -2199,6 +2682,13 @@ void TextDisplay::scroll_(int topLineNum, int horizOffset) {
   if (horiz_offset_ == horizOffset && topline_num_ == topLineNum)
     return;
 
+  /* In log mode, moving the pixels up and drawing only the new lines
+     is much faster than redrawing all of them */
+  int dy = scrolldy_ + (topline_num_ - topLineNum) * maxsize_;
+  bool blit = log_maxlines_ && horiz_offset_ == horizOffset &&
+    dy > -text_area.h() && dy < text_area.h() &&
+    !(damage() & (DAMAGE_ALL|DAMAGE_EXPOSE));
+
   /* If the vertical scroll position has changed, update the line
      starts array and related counters in the text display */
   offset_line_starts(topLineNum);
@@ -2206,8 +2696,14 @@ void TextDisplay::scroll_(int topLineNum, int horizOffset) {
   /* Just setting horiz_offset_ is enough information for redisplay */
   horiz_offset_ = horizOffset;
 
-  // redraw all text
-  redraw(DAMAGE_EXPOSE);
+  if (blit) {
+    scrolldy_ = dy;
+    redraw(DAMAGE_SCROLL);
+  } else {
+    // redraw all text
+    scrolldy_ = 0;
+    redraw(DAMAGE_EXPOSE);
+  }
 }
 
 /*
@@ -2980,6 +3476,7 @@ void TextDisplay::draw(void) {
   }
 
   if (damage() & (DAMAGE_ALL | DAMAGE_EXPOSE)) {
+    scrolldy_ = 0;
     fltk::push_clip(text_area);
     // draw all of the text
     draw_text(text_area.x(), text_area.y(), text_area.w(), text_area.h());
@@ -2992,6 +3489,12 @@ void TextDisplay::draw(void) {
   }
   else if (damage() & DAMAGE_SCROLL) {
     fltk::push_clip(text_area);
+    // move the text that is still visible and draw the lines scrolled in
+    bool scrolled = scrolldy_ != 0;
+    if (scrolled) {
+      scrollrect(text_area, 0, scrolldy_, draw_scrolled_cb, this);
+      scrolldy_ = 0;
+    }
     // draw some lines of text
     draw_range(damage_range1_start, damage_range1_end);
     if (damage_range2_end != -1) {
@@ -3000,6 +3503,7 @@ void TextDisplay::draw(void) {
     damage_range1_start = damage_range1_end = -1;
     damage_range2_start = damage_range2_end = -1;
     fltk::pop_clip();
+    if (scrolled && linenumwidth_ != 0) draw_line_numbers(false);
   }
 }
 
@@ -45,6 +45,7 @@ TextEditor::TextEditor(int X, int Y, int W, int H, const char* l)
   cursor_on_ = false;
   insert_mode_ = true;
   key_bindings = 0;
+  key_table_ = 0;
 
   // handle the default key bindings
   add_default_key_bindings(&key_bindings);
@@ -53,12 +54,6 @@ TextEditor::TextEditor(int X, int Y, int W, int H, const char* l)
   default_key_function(kf_default);
 }
 
-extern Widget* fl_pending_callback;
-TextEditor::~TextEditor() {
-  if (fl_pending_callback == this) fl_pending_callback = 0;
-  remove_all_key_bindings();
-}
-
 TextEditor::Key_Binding* TextEditor::global_key_bindings = 0;
 
 // These are the default key bindings every widget should start with
@@ -108,6 +103,8 @@ static struct {
     //{ Clear,    0,                        TextEditor::delete_to_eol },
     { 'z',          CTRL,                 TextEditor::kf_undo      },
     { '/',          CTRL,                 TextEditor::kf_undo      },
+    { 'z',          CTRL|SHIFT,           TextEditor::kf_redo      },
+    { 'y',          CTRL,                 TextEditor::kf_redo      },
     { 'x',          CTRL,                 TextEditor::kf_cut        },
     { DeleteKey,    SHIFT,                TextEditor::kf_cut        },
     { 'c',          CTRL,                 TextEditor::kf_copy       },
@@ -119,6 +116,7 @@ static struct {
 #ifdef __APPLE__
     // Define CMD+key accelerators...
     { 'z',          COMMAND,              TextEditor::kf_undo       },
+    { 'z',          COMMAND|SHIFT,        TextEditor::kf_redo       },
     { 'x',          COMMAND,              TextEditor::kf_cut        },
     { 'c',          COMMAND,              TextEditor::kf_copy       },
     { 'v',          COMMAND,              TextEditor::kf_paste      },
@@ -136,7 +134,96 @@ void TextEditor::add_default_key_bindings(Key_Binding** list) {
   }
 }
 
+// The bindings of a list are also put in a hash table by key and state,
+// so finding the function for a keystroke does not get slower as more
+// are added. The table is made again the next time it is used after the
+// list is changed, or if the first item in the list is not the same.
+namespace fltk {
+struct KeyBindingTable {
+  struct Entry {
+    int key, state;
+    int order;		// where in the list, -1 for an empty entry
+    TextEditor::Key_Func function;
+  };
+  Entry* entries;
+  unsigned size;	// a power of 2
+  const TextEditor::Key_Binding* head;
+  bool dirty;
+  KeyBindingTable() : entries(0), size(0), head(0), dirty(true) {}
+  ~KeyBindingTable() {delete[] entries;}
+  Entry* find(int key, int state) const;
+  void build(const TextEditor::Key_Binding* list);
+  TextEditor::Key_Func lookup(int key, int state) const;
+};
+}
+
+KeyBindingTable* TextEditor::global_key_table_ = 0;
+
+extern Widget* fl_pending_callback;
+TextEditor::~TextEditor() {
+  if (fl_pending_callback == this) fl_pending_callback = 0;
+  remove_all_key_bindings();
+  delete key_table_;
+}
+
+// Returns the entry for key and state, or the empty one it would go in:
+KeyBindingTable::Entry* KeyBindingTable::find(int key, int state) const {
+  unsigned h = (unsigned(key)*31u+unsigned(state))*2654435761u;
+  for (unsigned i = h^(h>>15);; i++) {
+    Entry* e = entries+(i&(size-1));
+    if (e->order < 0 || (e->key == key && e->state == state)) return e;
+  }
+}
+
+void KeyBindingTable::build(const TextEditor::Key_Binding* list) {
+  unsigned n = 0;
+  const TextEditor::Key_Binding* cur;
+  for (cur = list; cur; cur = cur->next) n++;
+  unsigned newsize = 16;
+  while (newsize < 2*n) newsize *= 2;
+  if (newsize != size) {
+    delete[] entries;
+    entries = new Entry[newsize];
+    size = newsize;
+  }
+  for (unsigned i = 0; i < size; i++) entries[i].order = -1;
+  // the first one in the list wins, as it did when the list was searched:
+  int order = 0;
+  for (cur = list; cur; cur = cur->next, order++) {
+    Entry* e = find(cur->key, cur->state);
+    if (e->order >= 0) continue;
+    e->key = cur->key;
+    e->state = cur->state;
+    e->order = order;
+    e->function = cur->function;
+  }
+  head = list;
+  dirty = false;
+}
+
+TextEditor::Key_Func KeyBindingTable::lookup(int key, int state) const {
+  const Entry* exact = find(key, state);
+  const Entry* any = find(key, TEXT_EDITOR_ANY_STATE);
+  if (exact->order < 0) exact = 0;
+  if (any->order < 0) any = 0;
+  if (exact && any) return exact->order < any->order ? exact->function : any->function;
+  if (exact) return exact->function;
+  if (any) return any->function;
+  return 0;
+}
+
 TextEditor::Key_Func TextEditor::bound_key_function(int key, int state, Key_Binding* list) {
+  // Use the hash table for the editor's own list and for the global one:
+  KeyBindingTable** tablep = 0;
+  if (list == key_bindings) tablep = &key_table_;
+  else if (list == global_key_bindings) tablep = &global_key_table_;
+  if (!list) return 0;
+  if (tablep) {
+    if (!*tablep) *tablep = new KeyBindingTable;
+    KeyBindingTable* table = *tablep;
+    if (table->dirty || table->head != list) table->build(list);
+    return table->lookup(key, state);
+  }
   Key_Binding* cur;
   for (cur = list; cur; cur = cur->next)
     if (cur->key == key)
@@ -146,6 +233,13 @@ TextEditor::Key_Func TextEditor::bound_key_function(int key, int state, Key_Bind
   return cur->function;
 }
 
+// Called when a list is changed so the hash table is made again:
+void TextEditor::key_bindings_changed(Key_Binding** list) {
+  if (list == &key_bindings && key_table_) key_table_->dirty = true;
+  else if (list == &global_key_bindings && global_key_table_)
+    global_key_table_->dirty = true;
+}
+
 void TextEditor::remove_all_key_bindings(Key_Binding** list) {
   Key_Binding *cur, *next;
   for (cur = *list; cur; cur = next) {
@@ -153,6 +247,7 @@ void TextEditor::remove_all_key_bindings(Key_Binding** list) {
       delete cur;
   }
   *list = 0;
+  key_bindings_changed(list);
 }
 
 void TextEditor::remove_key_binding(int key, int state, Key_Binding** list) {
@@ -163,6 +258,7 @@ void TextEditor::remove_key_binding(int key, int state, Key_Binding** list) {
   if (last) last->next = cur->next;
   else *list = cur->next;
   delete cur;
+  key_bindings_changed(list);
 }
 
 void TextEditor::add_key_binding(int key, int state, Key_Func function,
@@ -173,6 +269,7 @@ void TextEditor::add_key_binding(int key, int state, Key_Func function,
   kb->function = function;
   kb->next = *list;
   *list = kb;
+  key_bindings_changed(list);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -387,11 +484,21 @@ int TextEditor::kf_select_all(int, TextEditor* e) {
 int TextEditor::kf_undo(int , TextEditor* e) {
   e->buffer()->unselect();
   int crsr;
-  int ret = e->buffer()->undo(&crsr);
+  if (!e->buffer()->undo(&crsr)) return 0;
   e->insert_position(crsr);
   e->show_insert_position();
   e->maybe_do_callback();
-  return ret;
+  return 1;
+}
+
+int TextEditor::kf_redo(int , TextEditor* e) {
+  e->buffer()->unselect();
+  int crsr;
+  if (!e->buffer()->redo(&crsr)) return 0;
+  e->insert_position(crsr);
+  e->show_insert_position();
+  e->maybe_do_callback();
+  return 1;
 }
 
 int TextEditor::handle_key() {
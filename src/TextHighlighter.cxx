@@ -0,0 +1,469 @@
+//
+// "$Id$"
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Keeps the style buffer of a TextDisplay up to date by calling a
+// lexer for each line. The state the lexer was in at the start of each
+// line is remembered, so after a change only the changed lines are
+// styled, and then following lines until one ends in the same state as
+// it did before. When that takes more than sync_lines(), such as when
+// a comment is opened at the top of a big file, the rest is done on a
+// worker thread (which sends the styles back with fltk::post()) or, if
+// the program does not use threads, in idle callbacks. Until then the
+// old styles are shown.
+
+#include <config.h>
+#include <fltk/TextHighlighter.h>
+#include <fltk/TextBuffer.h>
+#include <fltk/run.h>
+#include <fltk/string.h>
+#include <stdlib.h>
+
+using namespace fltk;
+
+enum {
+  SYNC_LINES = 256,	// default sync_lines()
+  IDLE_LINES = 1024,	// lines done by each idle callback
+  JOB_LINES = 8192,	// lines sent to the worker thread at once
+  JOB_BYTES = 0x80000	// limit on the size of that text
+};
+
+extern bool fl_lock_started(); // in lock.cxx
+
+// Style nlines lines of text, putting the state at the end of each
+// into states:
+static void lex_lines(TextHighlighter::Lexer lexer, void* arg,
+                      const char* text, int n, char* style, int state,
+                      int* states, int nlines) {
+  const char* e = text+n;
+  const char* p = text;
+  for (int k = 0; k < nlines; k++) {
+    const char* q = (const char*)memchr(p, '\n', e-p);
+    q = q ? q+1 : e;
+    state = lexer(p, q-p, style+(p-text), state, arg);
+    states[k] = state;
+    p = q;
+  }
+}
+
+namespace fltk {
+struct TextHighlightJob {
+  TextHighlighter* owner; // null if it was destroyed
+  TextHighlighter::Lexer lexer;
+  void* arg;
+  TimeoutHandler done;
+  int edits;
+  int line, nlines, state;
+  char* text;
+  int n;
+  char* style;
+  int* states;
+};
+}
+
+static void free_job(TextHighlightJob* j) {
+  free(j->text);
+  delete[] j->style;
+  delete[] j->states;
+  delete j;
+}
+
+////////////////////////////////////////////////////////////////
+// Worker thread:
+
+#if HAVE_PTHREAD
+#include <fltk/Threads.h>
+
+static void lex_job(void* v) {
+  TextHighlightJob* j = (TextHighlightJob*)v;
+  lex_lines(j->lexer, j->arg, j->text, j->n, j->style, j->state,
+            j->states, j->nlines);
+}
+
+// Jobs are done by the shared ThreadPool, and j->done is posted to the
+// main thread when each is finished:
+static void queue_job(TextHighlightJob* j) {
+  ThreadPool::shared()->add(lex_job, j, ThreadPool::NORMAL, j->done);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////
+
+/**
+ * Make a highlighter that uses \a lexer to style each line, passing
+ * it \a arg. Call attach() to make it style a TextDisplay.
+ */
+TextHighlighter::TextHighlighter(Lexer lexer, void* arg) {
+  lexer_ = lexer;
+  arg_ = arg;
+  display_ = 0;
+  buffer_ = 0;
+  stylebuffer_ = 0;
+  states_ = 0;
+  nlines_ = statessize_ = 0;
+  dirty_ = 0;
+  ndirty_ = dirtysize_ = 0;
+  synclines_ = SYNC_LINES;
+  threaded_ = true;
+  idle_ = false;
+  job_ = 0;
+  edits_ = 0;
+}
+
+TextHighlighter::~TextHighlighter() {
+  detach();
+}
+
+/**
+ * Make a style buffer for \a display and keep it up to date as its
+ * buffer() is changed. \a styleTable and \a nStyles are passed to
+ * TextDisplay::highlight_data(). This must be called after the
+ * display has been given its buffer(), and the highlighter must be
+ * destroyed or detached before the display is.
+ */
+void TextHighlighter::attach(TextDisplay* display,
+                             TextDisplay::StyleTableEntry* styleTable,
+                             int nStyles) {
+  detach();
+  display_ = display;
+  buffer_ = display->buffer();
+  int n = buffer_->length();
+  stylebuffer_ = new TextBuffer(n);
+  char* s = new char[n+1];
+  memset(s, 'A', n);
+  s[n] = 0;
+  stylebuffer_->text(s);
+  delete[] s;
+  nlines_ = buffer_->count_lines(0, n) + 1;
+  statessize_ = nlines_ + 1;
+  states_ = new int[statessize_];
+  memset(states_, 0, statessize_*sizeof(int));
+  mark_dirty(0, nlines_);
+  // first so the style buffer is updated before the display redraws:
+  buffer_->add_modify_callback(modified_cb, this);
+  display->highlight_data(stylebuffer_, styleTable, nStyles, 0, 0, 0);
+  process(synclines_, false);
+  schedule();
+}
+
+/** Stop styling the display, and turn its highlighting off. */
+void TextHighlighter::detach() {
+  if (!display_) return;
+  buffer_->remove_modify_callback(modified_cb, this);
+  display_->highlight_data(0, 0, 0, 0, 0, 0);
+  delete stylebuffer_;
+  if (idle_) remove_idle(idle_cb, this);
+  idle_ = false;
+  if (job_) job_->owner = 0; // job_done_cb() will free it
+  job_ = 0;
+  delete[] states_;
+  delete[] dirty_;
+  states_ = dirty_ = 0;
+  nlines_ = statessize_ = ndirty_ = dirtysize_ = 0;
+  display_ = 0;
+  buffer_ = 0;
+  stylebuffer_ = 0;
+}
+
+/**
+ * Style the text from \a startPos to \a endPos again, or all of it with
+ * no arguments. Call this if the lexer has been changed to do
+ * something different.
+ */
+void TextHighlighter::restyle(int startPos, int endPos) {
+  if (!display_) return;
+  if (endPos < 0 || endPos > buffer_->length()) endPos = buffer_->length();
+  mark_dirty(buffer_->position_to_line(startPos),
+             buffer_->position_to_line(endPos) + 1);
+  schedule();
+}
+
+/**
+ * Style everything that has not been done yet, right now. This does
+ * not wait for the worker thread, it does the work itself.
+ */
+void TextHighlighter::update() {
+  if (display_) process(nlines_, false);
+}
+
+////////////////////////////////////////////////////////////////
+
+// Add first..last-1 to the lines that need styling:
+void TextHighlighter::mark_dirty(int first, int last) {
+  if (first < 0) first = 0;
+  if (last > nlines_) last = nlines_;
+  if (first >= last) return;
+  // find the ranges that touch this one:
+  int i = 0;
+  while (i < ndirty_ && dirty_[2*i+1] < first) i++;
+  int j = i;
+  while (j < ndirty_ && dirty_[2*j] <= last) j++;
+  if (j > i) {
+    if (dirty_[2*i] < first) first = dirty_[2*i];
+    if (dirty_[2*j-1] > last) last = dirty_[2*j-1];
+  }
+  int n = ndirty_ - (j-i) + 1;
+  if (n > dirtysize_) {
+    dirtysize_ = dirtysize_ ? 2*dirtysize_ : 16;
+    int* d = new int[2*dirtysize_];
+    memcpy(d, dirty_, 2*ndirty_*sizeof(int));
+    delete[] dirty_;
+    dirty_ = d;
+  }
+  memmove(dirty_+2*i+2, dirty_+2*j, 2*(ndirty_-j)*sizeof(int));
+  dirty_[2*i] = first;
+  dirty_[2*i+1] = last;
+  ndirty_ = n;
+}
+
+// The nDeleted lines after line were replaced with nInserted new ones:
+void TextHighlighter::lines_changed(int line, int nDeleted, int nInserted) {
+  int n = nlines_ - nDeleted + nInserted;
+  if (n+1 > statessize_) {
+    statessize_ = n+1 + n/2;
+    int* s = new int[statessize_];
+    memcpy(s, states_, (nlines_+1)*sizeof(int));
+    delete[] states_;
+    states_ = s;
+  }
+  int from = line+1+nDeleted;
+  memmove(states_+line+1+nInserted, states_+from, (nlines_+1-from)*sizeof(int));
+  for (int i = 1; i <= nInserted; i++) states_[line+i] = states_[line];
+  // move the dirty ranges after it:
+  int k = 0;
+  for (int i = 0; i < ndirty_; i++) {
+    int a = dirty_[2*i];
+    int b = dirty_[2*i+1];
+    if (a > line) a = a < from ? line+1 : a - nDeleted + nInserted;
+    if (b > line) b = b < from ? line+1 : b - nDeleted + nInserted;
+    if (k && dirty_[2*k-1] >= a) {
+      if (b > dirty_[2*k-1]) dirty_[2*k-1] = b;
+    } else if (a < b) {
+      dirty_[2*k] = a;
+      dirty_[2*k+1] = b;
+      k++;
+    }
+  }
+  ndirty_ = k;
+  nlines_ = n;
+  mark_dirty(line, line + nInserted + 1);
+}
+
+/*
+ * Style up to maxlines of the dirty lines, starting with the first
+ * ones. If select is true the changed styles are selected in the
+ * style buffer, so the display's modify callback redraws them,
+ * otherwise redisplay_range() is called. Returns how many lines
+ * were done.
+ */
+int TextHighlighter::process(int maxlines, bool select) {
+  int done = 0;
+  int chunk = 8; // grows while the lines after the change are different
+  while (ndirty_ && done < maxlines) {
+    int line = dirty_[0];
+    int n = dirty_[1] - line;
+    if (n < chunk) n = chunk;
+    if (n > maxlines - done) n = maxlines - done;
+    if (n > nlines_ - line) n = nlines_ - line;
+    int start = buffer_->line_to_position(line);
+    int end = buffer_->line_to_position(line + n);
+    char* text = buffer_->text_range(start, end);
+    char* style = new char[end - start + 1];
+    int* states = new int[n];
+    lex_lines(lexer_, arg_, text, end - start, style, states_[line], states, n);
+    int k = apply(line, n, style, states, select);
+    free(text);
+    delete[] style;
+    delete[] states;
+    done += k;
+    if (k == n && chunk < JOB_LINES) chunk *= 2;
+  }
+  return done;
+}
+
+/*
+ * Put the styles for nlines lines starting at line, which must be the
+ * first dirty one, into the style buffer. This stops at the first line
+ * that ends in the same state as before, unless the next line is also
+ * dirty. Returns how many lines were used.
+ */
+int TextHighlighter::apply(int line, int nlines, const char* style,
+                           const int* states, bool select) {
+  int k = 0;
+  while (k < nlines) {
+    int l = line + k;
+    if (++dirty_[0] >= dirty_[1]) {
+      ndirty_--;
+      memmove(dirty_, dirty_+2, 2*ndirty_*sizeof(int));
+    }
+    bool changed = states_[l+1] != states[k];
+    states_[l+1] = states[k];
+    k++;
+    if (l+1 >= nlines_) break;
+    if (changed) mark_dirty(l+1, l+2);
+    if (!ndirty_ || dirty_[0] != l+1) break;
+  }
+
+  // only replace the styles that are different, so less is redrawn:
+  int start = buffer_->line_to_position(line);
+  int end = buffer_->line_to_position(line + k);
+  char* old = stylebuffer_->text_range(start, end);
+  int n = end - start;
+  int a = 0;
+  while (a < n && old[a] == style[a]) a++;
+  int b = n;
+  while (b > a && old[b-1] == style[b-1]) b--;
+  free(old);
+  if (a < b) {
+    char* s = new char[b - a + 1];
+    memcpy(s, style + a, b - a);
+    s[b - a] = 0;
+    stylebuffer_->replace(start + a, start + b, s);
+    delete[] s;
+    a += start;
+    b += start;
+    if (select) {
+      TextSelection* sel = stylebuffer_->primary_selection();
+      if (sel->selected()) {
+        if (sel->start() < a) a = sel->start();
+        if (sel->end() > b) b = sel->end();
+      }
+      stylebuffer_->select(a, b);
+    } else {
+      display_->redisplay_range(a, b);
+    }
+  }
+  return k;
+}
+
+// Arrange for the rest of the dirty lines to be done later:
+void TextHighlighter::schedule() {
+  if (!ndirty_) return;
+#if HAVE_PTHREAD
+  if (threaded_ && fl_lock_started()) {
+    if (!job_) start_job();
+    if (job_) return;
+  }
+#endif
+  if (!idle_) {
+    add_idle(idle_cb, this);
+    idle_ = true;
+  }
+}
+
+// Send the first dirty lines to the worker thread:
+void TextHighlighter::start_job() {
+#if HAVE_PTHREAD
+  int line = dirty_[0];
+  int n = nlines_ - line;
+  if (n > JOB_LINES) n = JOB_LINES;
+  int start = buffer_->line_to_position(line);
+  int end = buffer_->line_to_position(line + n);
+  if (end - start > JOB_BYTES) {
+    n = buffer_->position_to_line(start + JOB_BYTES) - line + 1;
+    end = buffer_->line_to_position(line + n);
+  }
+  TextHighlightJob* j = new TextHighlightJob;
+  j->owner = this;
+  j->lexer = lexer_;
+  j->arg = arg_;
+  j->done = job_done_cb;
+  j->edits = edits_;
+  j->line = line;
+  j->nlines = n;
+  j->state = states_[line];
+  j->text = buffer_->text_range(start, end);
+  j->n = end - start;
+  j->style = new char[j->n + 1];
+  j->states = new int[n];
+  job_ = j;
+  queue_job(j);
+#endif
+}
+
+// Called by the main thread when the worker thread is done:
+void TextHighlighter::job_done_cb(void* arg) {
+  TextHighlightJob* j = (TextHighlightJob*)arg;
+  TextHighlighter* h = j->owner;
+  if (h) {
+    h->job_ = 0;
+    // the results are thrown away if the text has changed since:
+    if (j->edits == h->edits_ && h->ndirty_ && h->dirty_[0] == j->line)
+      h->apply(j->line, j->nlines, j->style, j->states, false);
+    h->schedule();
+  }
+  free_job(j);
+}
+
+void TextHighlighter::idle_cb(void* arg) {
+  TextHighlighter* h = (TextHighlighter*)arg;
+  h->process(IDLE_LINES, false);
+  if (!h->ndirty_) {
+    remove_idle(idle_cb, h);
+    h->idle_ = false;
+  }
+}
+
+void TextHighlighter::modified_cb(int pos, int nInserted, int nDeleted,
+                                  int, const char* deletedText, void* arg) {
+  ((TextHighlighter*)arg)->modified(pos, nInserted, nDeleted, deletedText);
+}
+
+void TextHighlighter::modified(int pos, int nInserted, int nDeleted,
+                               const char* deletedText) {
+  stylebuffer_->unselect();
+  if (!nInserted && !nDeleted) return; // just a selection change
+
+  // new text gets the style before it until it is styled:
+  char* s = new char[nInserted + 1];
+  memset(s, pos > 0 ? stylebuffer_->character(pos - 1) : 'A', nInserted);
+  s[nInserted] = 0;
+  stylebuffer_->replace(pos, pos + nDeleted, s);
+  delete[] s;
+
+  int line = buffer_->position_to_line(pos);
+  int inserted = buffer_->count_lines(pos, pos + nInserted);
+  if (nDeleted && !deletedText) {
+    // can't tell what lines were deleted, so start over:
+    lines_changed(0, nlines_ - 1, buffer_->count_lines(0, buffer_->length()));
+    mark_dirty(0, nlines_);
+  } else {
+    int deleted = 0;
+    const char* e = deletedText + nDeleted;
+    for (const char* p = deletedText; p < e; p++) {
+      p = (const char*)memchr(p, '\n', e - p);
+      if (!p) break;
+      deleted++;
+    }
+    lines_changed(line, deleted, inserted);
+  }
+  edits_++;
+  process(synclines_, true);
+  schedule();
+}
+
+//
+// End of "$Id$".
+//
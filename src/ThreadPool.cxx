@@ -0,0 +1,303 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+// A set of threads shared by everything in fltk that wants work done
+// in the background, so each subsystem does not start its own.
+
+#include <config.h>
+#if HAVE_PTHREAD || defined(_WIN32)
+#include <fltk/Threads.h>
+#include <fltk/run.h>
+#if !defined(_WIN32) || defined(__CYGWIN__)
+# include <unistd.h>
+#endif
+
+using namespace fltk;
+
+extern bool fl_lock_started(); // in lock.cxx
+
+struct fltk::ThreadPoolTask {
+  ThreadPool::Function work;
+  void* arg;
+  ThreadPool::Function done;
+  CancelToken* token;
+  ThreadPool::TaskId id;
+  ThreadPoolTask* next;
+};
+
+/*! \class fltk::ThreadPool
+
+  Runs functions on a set of threads that are started as they are
+  needed, up to threads() of them. Each add() puts a task on the queue
+  for its priority, and an idle thread takes the oldest one of the
+  highest priority.
+
+  When the call is done, a \a done function can be called by the main
+  thread through fltk::post(), so it can update widgets with the
+  results. Giving several tasks a CancelToken allows all of them to
+  be stopped at once, for instance when the data they are working on
+  is destroyed.
+
+  Use shared() rather than making a ThreadPool, so all of fltk and
+  the program use the same threads and the CPU is not oversubscribed.
+*/
+
+/*! Make a pool with up to \a threads threads. If zero it is one for
+  each CPU after the first, but at least one. No threads are started
+  until add() is called. */
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0) {
+    threads = cpu_count()-1;
+    if (threads < 1) threads = 1;
+  }
+  max_threads_ = threads;
+  thread_count_ = idle_ = queued_ = 0;
+  for (int p = LOW; p <= HIGH; p++) head_[p] = tail_[p] = 0;
+  running_ = 0;
+  last_id_ = 0;
+  quit_ = false;
+}
+
+/*! Waits for all the tasks to be done and stops the threads. */
+ThreadPool::~ThreadPool() {
+  wait_all();
+  mutex_.lock();
+  quit_ = true;
+  mutex_.signal();
+  while (thread_count_) mutex_.wait();
+  mutex_.unlock();
+}
+
+/*! The ThreadPool used by fltk itself, made the first time this is
+  called. */
+ThreadPool* ThreadPool::shared() {
+  static Mutex shared_mutex;
+  static ThreadPool* pool;
+  Guard guard(shared_mutex);
+  if (!pool) pool = new ThreadPool;
+  return pool;
+}
+
+/*! Number of CPUs the program can run on. */
+int ThreadPool::cpu_count() {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int n = int(info.dwNumberOfProcessors);
+#else
+  int n = int(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+  return n < 1 ? 1 : n;
+}
+
+// Take the next task to do off the queues, called locked:
+ThreadPoolTask* ThreadPool::pop() {
+  for (int p = HIGH; p >= LOW; p--) {
+    ThreadPoolTask* t = head_[p];
+    if (!t) continue;
+    head_[p] = t->next;
+    if (!head_[p]) tail_[p] = 0;
+    queued_--;
+    return t;
+  }
+  return 0;
+}
+
+// Take a task that has not started off the queues, called locked:
+ThreadPoolTask* ThreadPool::unlink(TaskId id) {
+  for (int p = LOW; p <= HIGH; p++) {
+    ThreadPoolTask* prev = 0;
+    for (ThreadPoolTask* t = head_[p]; t; prev = t, t = t->next) {
+      if (t->id != id) continue;
+      if (prev) prev->next = t->next; else head_[p] = t->next;
+      if (tail_[p] == t) tail_[p] = prev;
+      queued_--;
+      return t;
+    }
+  }
+  return 0;
+}
+
+// Do a task in this thread, called locked and the lock is released
+// while the functions are called:
+void ThreadPool::run(ThreadPoolTask* t) {
+  t->next = running_;
+  running_ = t;
+  mutex_.unlock();
+  if (!t->token || !t->token->cancelled()) t->work(t->arg);
+  if (t->done) post(t->done, t->arg);
+  mutex_.lock();
+  for (ThreadPoolTask** p = &running_; *p; p = &(*p)->next)
+    if (*p == t) {*p = t->next; break;}
+  delete t;
+  mutex_.signal(); // wake up wait()
+}
+
+void* ThreadPool::worker(void* v) {
+  ThreadPool* pool = (ThreadPool*)v;
+  pool->mutex_.lock();
+  for (;;) {
+    ThreadPoolTask* t = pool->pop();
+    if (t) {pool->run(t); continue;}
+    if (pool->quit_) break;
+    pool->idle_++;
+    pool->mutex_.wait();
+    pool->idle_--;
+  }
+  pool->thread_count_--;
+  pool->mutex_.signal();
+  pool->mutex_.unlock();
+  return 0;
+}
+
+/*!
+  Make one of the threads call \a work(\a arg). Tasks of a higher
+  Priority are started before any waiting ones of a lower one, and
+  ones of the same priority in the order they were added.
+
+  If \a done is not null then after \a work returns the main thread
+  calls \a done(\a arg) the next time it is in fltk::wait(), with the
+  fltk lock held, as described for fltk::post(). This can only be done
+  if the main thread has called fltk::lock(); if it has not, both
+  functions are called right away by this thread.
+
+  If \a token is not null and is cancelled before the task starts,
+  \a work is not called, but \a done still is so it can free \a arg.
+
+  This returns an id for remove(), done() and wait().
+*/
+ThreadPool::TaskId ThreadPool::add(Function work, void* arg, Priority priority,
+				   Function done, CancelToken* token) {
+  if (done && !fl_lock_started()) {
+    if (!token || !token->cancelled()) work(arg);
+    done(arg);
+    return 0;
+  }
+  ThreadPoolTask* t = new ThreadPoolTask;
+  t->work = work;
+  t->arg = arg;
+  t->done = done;
+  t->token = token;
+  t->next = 0;
+  mutex_.lock();
+  if (!++last_id_) ++last_id_; // zero means "nothing"
+  TaskId id = t->id = last_id_;
+  if (tail_[priority]) tail_[priority]->next = t; else head_[priority] = t;
+  tail_[priority] = t;
+  queued_++;
+  if (queued_ > idle_ && thread_count_ < max_threads_) {
+    Thread thread;
+    if (!create_thread(thread, worker, this)) {
+#if !defined(_WIN32) || defined(__CYGWIN__)
+      pthread_detach(thread);
+#endif
+      thread_count_++;
+    }
+  }
+  if (!thread_count_) {
+    // no thread could be started, do it now:
+    run(unlink(id));
+  } else {
+    mutex_.signal();
+  }
+  mutex_.unlock();
+  return id;
+}
+
+/*!
+  Take the task add() returned \a id for off the queue, and return
+  true, if it has not started. Neither of its functions will be called.
+  Returns false if it has already started or finished.
+*/
+bool ThreadPool::remove(TaskId id) {
+  mutex_.lock();
+  ThreadPoolTask* t = unlink(id);
+  mutex_.unlock();
+  delete t;
+  return t != 0;
+}
+
+/*! Returns true if the work function of the task add() returned
+  \a id for has returned, or the task was removed. Its done function
+  may not have been called yet. Zero is always done. */
+bool ThreadPool::done(TaskId id) {
+  Guard guard(mutex_);
+  for (int p = LOW; p <= HIGH; p++)
+    for (ThreadPoolTask* t = head_[p]; t; t = t->next)
+      if (t->id == id) return false;
+  for (ThreadPoolTask* t = running_; t; t = t->next)
+    if (t->id == id) return false;
+  return true;
+}
+
+/*! Block until done(\a id) is true. If the task has not started this
+  thread does it immediately, rather than waiting for a thread to be
+  free. As with fltk::wait_posted(), a thread waiting for a task that
+  calls fltk::lock() must not hold the lock. */
+void ThreadPool::wait(TaskId id) {
+  mutex_.lock();
+  ThreadPoolTask* t = unlink(id);
+  if (t) {
+    run(t);
+  } else for (;;) {
+    ThreadPoolTask* r = running_;
+    while (r && r->id != id) r = r->next;
+    if (!r) break;
+    mutex_.wait();
+  }
+  mutex_.unlock();
+}
+
+/*! Block until every task is done, helping by doing waiting ones in
+  this thread. */
+void ThreadPool::wait_all() {
+  mutex_.lock();
+  for (;;) {
+    ThreadPoolTask* t = pop();
+    if (t) run(t);
+    else if (running_) mutex_.wait();
+    else break;
+  }
+  mutex_.unlock();
+}
+
+/*! \fn int ThreadPool::threads() const
+  The most threads this will start.
+*/
+
+/*! \fn int ThreadPool::queued() const
+  How many tasks are waiting for a thread.
+*/
+
+/*! \class fltk::CancelToken
+  Pass one of these to several ThreadPool::add() calls to be able to
+  stop all of them with cancel(). A task's work function can check
+  cancelled() to see if it should stop early.
+*/
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -38,6 +38,12 @@ using namespace fltk;
   is null then the TiledImage draws nothing.
 */
 
+/*! \fn TiledImage::TiledImage(Image*)
+
+  Same as the Symbol constructor, but the image can then be tiled by
+  the system with Image::draw_tiled().
+*/
+
 /*! Returns w and h unchanged, indicating that it can draw any size
   of rectangle, with no preference. */
 void TiledImage::_measure(int& w, int& h) const {}
@@ -45,10 +51,14 @@ void TiledImage::_measure(int& w, int& h) const {}
 /*! Repeatedly draws the image to fill the area, putting the top-left
   corner at \a x,y. This checks the current clip region and does
   minimal drawing of only the visible portions of the image.
+
+  If the image was given as an Image, Image::draw_tiled() is tried
+  first, so the system can fill the whole area in one operation.
 */
 void TiledImage::_draw(const Rectangle& r) const
 {
   if (!image_) return;
+  if (tile_ && tile_->draw_tiled(r)) return;
   int iw = r.w();
   int ih = r.h();
   image_->measure(iw,ih); if (iw <= 0 || ih <= 0) return;
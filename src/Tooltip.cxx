@@ -47,6 +47,8 @@
 #include <fltk/run.h>
 #include <fltk/draw.h>
 #include <fltk/Box.h>
+#include <fltk/string.h>
+#include <string.h>
 using namespace fltk;
 
 float		Tooltip::delay_ = 1.0f;
@@ -54,6 +56,17 @@ bool		Tooltip::enabled_ = true;
 
 static const int MAX_WIDTH = 400;
 static bool recent_tooltip;
+static bool waiting; // the generator returned LATER
+
+// The text of the tooltip last measured, so showing the same text again
+// does not measure it again:
+static char* measured_text;
+static Font* measured_font;
+static float measured_size;
+static int measured_w, measured_h;
+
+// Text passed to ready(), this is the label() while it is shown:
+static char* ready_text;
 
 Widget*			Tooltip::current_widget_;
 Tooltip::Generator	Tooltip::current_generator_;
@@ -71,10 +84,24 @@ Tooltip::Tooltip() : MenuWindow(0, 0) {
   line up with the rectangle passed to the last enter().
 */
 void Tooltip::layout() {
-  setfont(textfont(), textsize());
-  int ww=MAX_WIDTH, hh=0;
-  measure(label(), ww, hh, flags());
-  ww += 7; hh += 6;
+  int ww, hh;
+  const char* text = label();
+  if (this == instance_ && text && measured_text && !strcmp(text, measured_text)
+      && measured_font == textfont() && measured_size == textsize()) {
+    ww = measured_w; hh = measured_h;
+  } else {
+    setfont(textfont(), textsize());
+    ww=MAX_WIDTH; hh=0;
+    measure(text, ww, hh, flags());
+    ww += 7; hh += 6;
+    if (this == instance_) {
+      delete[] measured_text;
+      measured_text = newstring(text);
+      measured_font = textfont();
+      measured_size = textsize();
+      measured_w = ww; measured_h = hh;
+    }
+  }
 
   // We may want to skip some of this is this!=instance_
 
@@ -127,26 +154,78 @@ static inline void hide_tooltip() {
 #endif
 }
 
+// Show the text, or hide the tooltip if there is none:
+void Tooltip::popup(const char* tip) {
+  if (!tip || !*tip) {
+    hide_tooltip();
+    return;
+  }
+  //if (grab()) return;
+  if (!instance_) instance_ = new Tooltip;
+  // only draw it again if the text changed:
+  bool same = instance_->visible() && measured_text &&
+    !strcmp(tip, measured_text);
+  // this cast bypasses the normal Window label() code:
+  instance_->Widget::label(tip);
+  instance_->layout();
+  if (!same) instance_->redraw();
+  instance_->show();
+}
+
 void Tooltip::tooltip_timeout(void*) {
   if (recursion) return;
   recursion = true;
   const char* tip = current_generator_(current_widget_, current_data_);
-  if (!tip || !*tip) {
-    hide_tooltip();
-  } else {
-    //if (grab()) return;
-    if (!instance_) instance_ = new Tooltip;
-    // this cast bypasses the normal Window label() code:
-    instance_->Widget::label(tip);
-    instance_->layout();
-    instance_->redraw();
-    instance_->show();
-  }
+  waiting = (tip == LATER);
+  if (!waiting) popup(tip);
   fltk::remove_timeout(recent_timeout);
   recent_tooltip = true;
   recursion = false;
 }
 
+/**
+  A Generator can return this if making the text takes a long time.
+  No tooltip pops up until ready() is called with the text.
+*/
+const char* const Tooltip::LATER = "(later)";
+
+struct ReadyTip {
+  Widget* widget;
+  void* data;
+  char* text;
+};
+
+void Tooltip::ready_cb(void* v) {
+  ReadyTip* t = (ReadyTip*)v;
+  if (waiting && t->widget == current_widget_ && t->data == current_data_) {
+    waiting = false;
+    delete[] ready_text;
+    ready_text = t->text;
+    popup(ready_text);
+  } else {
+    delete[] t->text;
+  }
+  delete t;
+}
+
+/**
+  Provide the text for a Generator that returned LATER when it was
+  called for \a widget and \a data. This may be called by any
+  thread, the text is copied and then shown by the main thread
+  through fltk::post(). It is ignored if the mouse has moved to
+  another tooltip area since. NULL means no tooltip.
+*/
+void Tooltip::ready(Widget* widget, void* data, const char* text) {
+  ReadyTip* t = new ReadyTip;
+  t->widget = widget;
+  t->data = data;
+  t->text = text ? newstring(text) : 0;
+#if HAVE_PTHREAD || defined(_WIN32)
+  if (!in_main_thread()) {post(ready_cb, t); return;}
+#endif
+  ready_cb(t);
+}
+
 /**
   Get ready to display a tooltip. The \a widget and the \a rectangle inside
   it define an area the tooltip is for. The mouse is assummed to currently
@@ -163,7 +242,9 @@ void Tooltip::tooltip_timeout(void*) {
   arguments, and it should return a pointer to a static buffer
   containing the tooltip text. You can use '@' commands to insert
   arbitrary fltk::Symbol graphics into it. If \a generator returns
-  NULL no tooltip will be popped up.
+  NULL no tooltip will be popped up. If it returns LATER, the
+  tooltip pops up when ready() is called with the text, which lets
+  slow text be made by another thread.
 */
 void Tooltip::enter(Widget* widget, const Rectangle& rectangle,
 		    Tooltip::Generator generator, void* data)
@@ -177,6 +258,7 @@ void Tooltip::enter(Widget* widget, const Rectangle& rectangle,
       data == current_data_) return;
   fltk::remove_timeout(tooltip_timeout);
   fltk::remove_timeout(recent_timeout);
+  waiting = false;
   // remember it:
   current_widget_ = widget;
   current_rectangle_ = rectangle;
@@ -262,6 +344,7 @@ void Tooltip::current(Widget* w) {
 void Tooltip::exit() {
   if (!current_widget_) return;
   current_widget_ = 0;
+  waiting = false;
   fltk::remove_timeout(tooltip_timeout);
   fltk::remove_timeout(recent_timeout);
   hide_tooltip();
@@ -38,6 +38,10 @@
 #include <fltk/math.h>
 using namespace fltk;
 
+#if defined(_WIN32)
+extern void fl_d2d_flush(); // in win32/direct2d.cxx
+#endif
+
 ////////////////////////////////////////////////////////////////
 
 // Maybe this should be a public fltk method?
@@ -100,6 +104,7 @@ void drawFocusRect(const fltk::Rectangle& r1) {
   HBRUSH brush = (r.x()+r.y()-r1.x()-r1.y())&1 ? oddbrush : evenbrush;
 
   // Select the patterned brush into the DC
+  fl_d2d_flush();
   HBRUSH old_brush = (HBRUSH)SelectObject(dc, brush);
   int oldrop = SetROP2(dc, R2_NOT);
 
@@ -246,6 +251,35 @@ Box* const fltk::FLAT_BOX = &flatBox;
     many widgets draw faster and with less blinking.
 */
 
+// The lines of a frame do not touch each other, so they are saved up
+// and drawn with drawlines() sorted by shade, which sets each shade
+// once and sends all the lines of it together:
+namespace {
+class FrameLines {
+  enum {N = 32};
+  int v[N][4];
+  int shade[N];
+  int n;
+public:
+  FrameLines() : n(0) {}
+  ~FrameLines() {flush();}
+  void add(char c, int x, int y, int x1, int y1) {
+    if (n == N) flush();
+    int i = n++;
+    for (; i > 0 && shade[i-1] > c; i--) {
+      memcpy(v[i], v[i-1], sizeof(v[i])); shade[i] = shade[i-1];
+    }
+    v[i][0] = x; v[i][1] = y; v[i][2] = x1; v[i][3] = y1; shade[i] = c;
+  }
+  void flush() {
+    Color colors[N];
+    for (int i = 0; i < n; i++) colors[i] = shade[i] + (GRAY00-'A');
+    drawlines(n, v, colors);
+    n = 0;
+  }
+};
+}
+
 /**
   Draw a spiral, useful as a box edge, starting with the bottom edge and
   going in a counter-clockwise direction, from the outside in
@@ -254,27 +288,24 @@ Box* const fltk::FLAT_BOX = &flatBox;
   possible steps of gray shade, and R is the normal background
   color of GRAY75. A leading '2' makes it start with the top
   edge, which will reverse exactly which pixels are drawn in
-  the corner.
+  the corner. The current color is not changed.
 
   Emulates the fltk1 fl_frame2() function
 */
 void fltk::drawframe(const char* s, int x, int y, int w, int h) {
+  FrameLines lines;
   if (h > 0 && w > 0) for (;*s;) {
     // draw bottom line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x, y+h-1, x+w-1, y+h-1);
+    lines.add(*s++, x, y+h-1, x+w-1, y+h-1);
     if (--h <= 0 || !*s) break;
     // draw right line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x+w-1, y+h-1, x+w-1, y);
+    lines.add(*s++, x+w-1, y+h-1, x+w-1, y);
     if (--w <= 0 || !*s) break;
     // draw top line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x, y, x+w-1, y);
+    lines.add(*s++, x, y, x+w-1, y);
     y++; if (--h <= 0 || !*s) break;
     // draw left line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x, y+h-1, x, y);
+    lines.add(*s++, x, y+h-1, x, y);
     x++; if (--w <= 0 || !*s) break;
   }
 }
@@ -286,22 +317,19 @@ void fltk::drawframe(const char* s, int x, int y, int w, int h) {
   Emulates the fltk1 fl_frame() function
 */
 void fltk::drawframe2(const char* s, int x, int y, int w, int h) {
+  FrameLines lines;
   if (h > 0 && w > 0) for (;*s;) {
     // draw top line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x, y, x+w-1, y);
+    lines.add(*s++, x, y, x+w-1, y);
     y++; if (--h <= 0 || !*s) break;
     // draw left line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x, y+h-1, x, y);
+    lines.add(*s++, x, y+h-1, x, y);
     x++; if (--w <= 0 || !*s) break;
     // draw bottom line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x, y+h-1, x+w-1, y+h-1);
+    lines.add(*s++, x, y+h-1, x+w-1, y+h-1);
     if (--h <= 0 || !*s) break;
     // draw right line:
-    setcolor(*s++ + (GRAY00-'A'));
-    drawline(x+w-1, y+h-1, x+w-1, y);
+    lines.add(*s++, x+w-1, y+h-1, x+w-1, y);
     if (--w <= 0 || !*s) break;
   }
 }
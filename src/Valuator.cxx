@@ -25,6 +25,7 @@
 
 #include <fltk/Valuator.h>
 #include <fltk/events.h>
+#include <fltk/run.h>
 #include <fltk/damage.h>
 #include <fltk/math.h>
 #include <stdio.h>
@@ -84,6 +85,12 @@ Valuator::Valuator(int X, int Y, int W, int H, const char* L)
   maximum_ = 1;
   linesize_ = 0;
   previous_value_ = 0;
+  throttle_ = false;
+  damage_pending_ = false;
+}
+
+Valuator::~Valuator() {
+  if (damage_pending_) remove_frame_callback(damage_cb, this);
 }
 
 /*! \fn double Valuator::value() const
@@ -95,15 +102,48 @@ Valuator::Valuator(int X, int Y, int W, int H, const char* L)
   value_damage(). <i>The new value is stored unchanged, even if it is
   outside the range or not a multiple of step()</i>.
   Returns true if the new value is different.
+
+  If throttle() is on, value_damage() is not called until just before
+  the next frame is drawn.
 */
 bool Valuator::value(double v) {
   clear_changed();
   if (v == value_) return false;
   value_ = v;
-  value_damage();
+  if (!throttle_) value_damage();
+  else if (!damage_pending_) {
+    damage_pending_ = true;
+    add_frame_callback(damage_cb, this);
+  }
   return true;
 }
 
+void Valuator::damage_cb(void* v) {
+  Valuator* o = (Valuator*)v;
+  o->damage_pending_ = false;
+  o->value_damage();
+}
+
+/*!
+  If this is turned on, value() only stores the new value, and
+  value_damage() is called once just before the next frame is drawn
+  (see add_frame_callback()), no matter how many times the value
+  changed in between. Use this for widgets that show values arriving
+  much faster than the screen can show them. The default is off.
+*/
+void Valuator::throttle(bool v) {
+  throttle_ = v;
+  if (!v && damage_pending_) {
+    remove_frame_callback(damage_cb, this);
+    damage_pending_ = false;
+    value_damage();
+  }
+}
+
+/*! \fn bool Valuator::throttle() const
+  Return the value set by throttle(bool).
+*/
+
 /*! \fn void Valuator::set_value(double)
   Sets the current value but does not call value_damage().
 */
@@ -9,6 +9,7 @@
 #include <fltk/draw.h>
 #include <fltk/Box.h>
 #include <fltk/run.h>
+#include <string.h>
 using namespace fltk;
 
 /*! \class fltk::ValueOutput
@@ -32,8 +33,12 @@ void ValueOutput::draw() {
   if (damage() & DAMAGE_ALL) draw_frame();
   Rectangle r(w(),h()); box()->inset(r);
   push_clip(r);
-  char buf[40];
-  format(buf);
+  if (damage() & DAMAGE_ALL || !text_[0] ||
+      text_value_ != value() || text_step_ != step()) {
+    format(text_);
+    text_value_ = value();
+    text_step_ = step();
+  }
   if (!(damage() & DAMAGE_ALL)) {
     Color fg = getcolor();
     setcolor(getbgcolor());
@@ -46,10 +51,24 @@ void ValueOutput::draw() {
 //      fillrect(ir);
 //	setcolor(selection_textcolor());
 //    } else
-  drawtext(buf, float(r.x()+3), float(r.y()+(int(r.h()+getascent()-getdescent()) >> 1)));
+  drawtext(text_, float(r.x()+3), float(r.y()+(int(r.h()+getascent()-getdescent()) >> 1)));
   pop_clip();
 }
 
+// Only redraw if the printed text changes:
+void ValueOutput::value_damage() {
+  char buf[40];
+  format(buf);
+  if (text_[0] && text_step_ == step() && !strcmp(buf, text_)) {
+    text_value_ = value();
+    return;
+  }
+  strcpy(text_, buf);
+  text_value_ = value();
+  text_step_ = step();
+  Valuator::value_damage();
+}
+
 int ValueOutput::handle(int event) {
   switch (event) {
   case FOCUS:
@@ -95,12 +95,9 @@ void ValueSlider::draw() {
     input.set_damage(DAMAGE_ALL);
     Flags f2 = flags() & ~FOCUSED;
     if (pushed()) f2 |= PUSHED;
-    Box* box = this->box();
-    if (!box->fills_rectangle()) draw_background();
-    drawstyle(style(),flags()&~HIGHLIGHT);
-    Rectangle r(w(),h()); box->draw(r);
-    slider_rect(r);
-    Slider::draw(r, f2, r.y()==0);
+    Rectangle r; slider_rect(r);
+    draw_layered(r, flags()&~HIGHLIGHT, f2, r.y()==0, false);
+    drawn_pixel_ = slider_pixel();
   }
   input.label(label());
   input.align(align());
@@ -160,6 +157,13 @@ void ValueSlider::slider_rect(Rectangle& r) {
   else r.move_x(input.w());
 }
 
+// Where the slider is drawn for the current value. Tick marks only
+// change the other direction, so this is the same as in draw():
+int ValueSlider::slider_pixel() {
+  Rectangle r; slider_rect(r);
+  return slider_position(value(), horizontal() ? r.w() : r.h());
+}
+
 // Resize the input field and put it at the edge:
 void ValueSlider::layout() {
   Slider::layout();
@@ -197,7 +201,8 @@ void ValueSlider::value_damage() {
   format(buf);
   input.text(buf);
   //input.position(0, input.size()); // highlight it all
-  Slider::value_damage();
+  // changing the text redraws it, only redraw the slider if it moves:
+  if (slider_pixel() != drawn_pixel_) Slider::value_damage();
 }
 
 static inline int nogroup(int x) {Group::current(0); return x;}
@@ -209,6 +214,7 @@ ValueSlider::ValueSlider(int x, int y, int w, int h, const char* l)
   Group::current(parent());
   step(.01);
   when(WHEN_CHANGED|WHEN_ENTER_KEY);
+  drawn_pixel_ = -1;
 }
 
 ValueSlider::~ValueSlider() {
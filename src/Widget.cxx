@@ -63,6 +63,17 @@ void Widget::default_callback(Widget* w, void*) {w->set_changed();}
   or Group::current(0), then the parent() is set to null. In this case
   you must add the widget yourself in order to see it.
 */
+// in WidgetArena.cxx:
+extern void* fl_new_widget;
+extern size_t fl_new_widget_size;
+
+// For memory_report():
+unsigned long fl_widget_count, fl_widget_bytes;
+
+// Start at 1 so the zero in a new widget is out of date:
+unsigned Widget::tree_changes_ = 1;
+unsigned Widget::damage_clears_ = 1;
+
 Widget::Widget(int X, int Y, int W, int H, const char* L) :
   Rectangle(X,Y,W,H)
 {
@@ -82,9 +93,27 @@ Widget::Widget(int X, int Y, int W, int H, const char* L) :
   damage_	= DAMAGE_ALL;
   layout_damage_= LAYOUT_DAMAGE;
   when_		= WHEN_RELEASE;
+  window_	= 0;
+  depth_	= 0;
+  tree_cached_	= 0;
+  damage_marked_= 0;
+  if (this == fl_new_widget) {
+    alloc_size_ = unsigned(fl_new_widget_size);
+    fl_new_widget = 0;
+  } else {
+    alloc_size_ = 0; // static, local, or a member of something else
+  }
+  fl_widget_count++;
+  fl_widget_bytes += alloc_size_;
   if (Group::current()) Group::current()->add(this);
 }
 
+/*! \fn unsigned Widget::alloc_size() const
+  Returns the size of the object if it was made with new, for
+  fltk::memory_report(). Returns zero for widgets that are static,
+  local variables, or members of other objects.
+*/
+
 extern void delete_associations_for(Widget* widget); // in WidgetAssociation.cxx
 
 /*! The destructor is virtual. The base class removes itself from the
@@ -94,12 +123,13 @@ Widget::~Widget() {
   remove_timeout();
   if (parent_) parent_->remove(this);
   throw_focus();
+  remove_shortcuts();
   delete_associations_for(this);
-  if (style_->dynamic()) {
-    // When a widget is destroyed it can destroy unique styles:
-    delete (Style*)style_; // cast away const
-  }
-  if (flags_&COPIED_LABEL) delete[] const_cast<char*>( label_ );
+  // When a widget is destroyed it can destroy unique styles:
+  Style::release(style_);
+  if (flags_&COPIED_LABEL) releasestring(label_);
+  fl_widget_count--;
+  fl_widget_bytes -= alloc_size_;
 }
 
 /*! \fn Group* Widget::parent() const
@@ -107,11 +137,36 @@ Widget::~Widget() {
   fltk::Group or fltk::Window.  Returns NULL if none.
 */
 
+// Find window() and depth() from the parent's, which are updated first.
+// Nothing is done again until some parent() or type() changes:
+void Widget::update_tree_cache() const {
+  Group* p = parent_;
+  if (!p) {
+    window_ = 0;
+    depth_ = 0;
+  } else {
+    if (p->tree_cached_ != tree_changes_) p->update_tree_cache();
+    window_ = p->is_window() ? (Window*)p : p->window_;
+    depth_ = p->depth_+1;
+  }
+  tree_cached_ = tree_changes_;
+}
+
+/*! Returns how many parent() widgets this has, zero if the parent()
+  is NULL. This is remembered so it is fast, like window(). */
+int Widget::depth() const {
+  if (tree_cached_ != tree_changes_) update_tree_cache();
+  return depth_;
+}
+
 /*! Returns true if \a b is a child of this widget, or is equal to
   this widget. Returns false if \a b is NULL. */
 bool Widget::contains(const Widget* b) const {
-  for (; b; b = b->parent_) if (b == this) return true;
-  return false;
+  if (!b) return false;
+  int n = b->depth()-depth();
+  if (n < 0) return false;
+  while (n--) b = b->parent_;
+  return b == this;
 }
 
 /*! Fills the Rectangle pointed to by \a rect with the widget's
@@ -148,7 +203,7 @@ void Widget::get_absolute_rect( Rectangle *rect ) const
 void Widget::label(const char* s) {
   if (label_ == s) return; // Avoid problems if label(label()) is called
   if (flags_&COPIED_LABEL) {
-    delete[] const_cast<char*>( label_ );
+    releasestring(label_);
     flags_ &= ~COPIED_LABEL;
   }
   label_ = s;
@@ -159,13 +214,17 @@ void Widget::label(const char* s) {
   label(). The memory will be freed when the widget is destroyed or when
   copy_label() is called again, or label(const char*) is called.
 
+  The copy is made by internstring(), so all widgets given the same
+  string by copy_label() share one copy of it.
+
   Passing NULL will set label() to NULL.
 */
 void Widget::copy_label(const char* s) {
   if (label_ == s) return; // Avoid problems if label(label()) is called
-  if (flags_&COPIED_LABEL) delete[] const_cast<char*>( label_ );
-  label_ = newstring(s);
+  const char* old = (flags_&COPIED_LABEL) ? label_ : 0;
+  label_ = internstring(s);
   flags_ |= COPIED_LABEL;
+  releasestring(old); // after, in case s is in it
 }
 
 /*! void Widget::image(Image*)
@@ -387,7 +446,7 @@ bool Widget::resize(int x,int y,int w,int h) {
     // parent must get LAYOUT_DAMAGE as well as LAYOUT_CHILD:
     if (parent()) {
       layout_damage_ |= flags;
-      parent()->relayout(LAYOUT_DAMAGE|LAYOUT_CHILD);
+      parent()->relayout(LAYOUT_DAMAGE|LAYOUT_CHILD|LAYOUT_CHILD_RESIZE);
     } else {
       relayout(flags);
     }
@@ -422,6 +481,12 @@ void Widget::relayout() {
 */
 void Widget::relayout(uchar flags) {
   //if (!(flags & ~layout_damage_)) return;
+  // LAYOUT_CHILD_RESIZE stays on only if all the LAYOUT_DAMAGE was from it:
+  if ((flags & (LAYOUT_DAMAGE|LAYOUT_CHILD_RESIZE)) == LAYOUT_DAMAGE ||
+      (layout_damage_ & (LAYOUT_DAMAGE|LAYOUT_CHILD_RESIZE)) == LAYOUT_DAMAGE) {
+    flags &= ~LAYOUT_CHILD_RESIZE;
+    layout_damage_ &= ~LAYOUT_CHILD_RESIZE;
+  }
   layout_damage_ |= flags;
   for (Widget* w = this->parent(); w; w = w->parent())
     w->layout_damage_ |= LAYOUT_CHILD;
@@ -572,8 +637,14 @@ void Widget::redraw() {
 void Widget::redraw(uchar flags) {
   if (!(flags & ~damage_)) return;
   damage_ |= flags;
-  for (Widget* widget = parent(); widget; widget = widget->parent())
+  for (Widget* widget = parent(); widget; widget = widget->parent()) {
+    // If it was marked and since then no DAMAGE_CHILD was turned off and
+    // no parent() changed, all the parents of it are marked too:
+    if ((widget->damage_ & DAMAGE_CHILD) && widget->damage_marked_ == damage_clears_)
+      break;
     widget->damage_ |= DAMAGE_CHILD;
+    widget->damage_marked_ = damage_clears_;
+  }
   fltk::damage(1); // make flush() do something
 }
 
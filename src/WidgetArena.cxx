@@ -0,0 +1,229 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+// Widgets made between Window::begin_arena() and Window::end_arena()
+// are allocated from large blocks belonging to that window, rather
+// than each one from the heap. Nothing in a block is freed until
+// everything in it is deleted, then the blocks are reused if the
+// window still exists and freed if not.
+
+#include <fltk/Window.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+namespace fltk {
+
+struct WidgetArenaBlock {
+  WidgetArena* arena;
+  WidgetArenaBlock* next;
+  size_t size;		// bytes after this header
+  size_t used;
+};
+
+struct WidgetArena {
+  WidgetArenaBlock* blocks; // the one being filled is first
+  size_t live;		// allocations not yet freed
+  size_t nextsize;	// size of the next block
+  bool owned;		// the Window has not been destroyed
+  WidgetArena* previous; // current_arena before begin_arena()
+};
+
+}
+
+enum {ALIGN = 16, FIRST_BLOCK = 16*1024, MAX_BLOCK = 1024*1024};
+// the header in front of the memory of each block:
+enum {HEADER = (sizeof(WidgetArenaBlock)+ALIGN-1)&~(ALIGN-1)};
+
+static WidgetArena* current_arena;
+
+// The last allocation, so the Widget constructor knows its size:
+void* fl_new_widget;
+size_t fl_new_widget_size;
+
+// All the blocks of all the arenas sorted by address, so the one
+// a pointer is in can be found:
+static WidgetArenaBlock** ranges;
+static int nranges, rangesize;
+
+static inline char* block_begin(WidgetArenaBlock* b) {return (char*)b+HEADER;}
+
+static int range_find(const void* p) {
+  int a = 0, b = nranges;
+  while (a < b) {
+    int c = (a+b)/2;
+    if ((const char*)p < block_begin(ranges[c])) b = c; else a = c+1;
+  }
+  return a-1; // last block starting at or before p
+}
+
+static WidgetArenaBlock* find_block(const void* p) {
+  if (!nranges) return 0;
+  int i = range_find(p);
+  if (i < 0) return 0;
+  WidgetArenaBlock* b = ranges[i];
+  if ((const char*)p >= block_begin(b)+b->size) return 0;
+  return b;
+}
+
+static void range_add(WidgetArenaBlock* b) {
+  if (nranges >= rangesize) {
+    rangesize = rangesize ? 2*rangesize : 16;
+    ranges = (WidgetArenaBlock**)realloc(ranges, rangesize*sizeof(*ranges));
+  }
+  int i = range_find(block_begin(b))+1;
+  memmove(ranges+i+1, ranges+i, (nranges-i)*sizeof(*ranges));
+  ranges[i] = b;
+  nranges++;
+}
+
+static void range_remove(WidgetArenaBlock* b) {
+  int i = range_find(block_begin(b));
+  nranges--;
+  memmove(ranges+i, ranges+i+1, (nranges-i)*sizeof(*ranges));
+  if (!nranges) {free(ranges); ranges = 0; rangesize = 0;}
+}
+
+static void* arena_alloc(WidgetArena* arena, size_t n) {
+  n = (n+ALIGN-1)&~(size_t)(ALIGN-1);
+  WidgetArenaBlock* b = arena->blocks;
+  if (!b || b->size-b->used < n) {
+    size_t size = arena->nextsize;
+    if (size < n) size = n;
+    b = (WidgetArenaBlock*)malloc(HEADER+size);
+    b->arena = arena;
+    b->size = size;
+    b->used = 0;
+    b->next = arena->blocks;
+    arena->blocks = b;
+    range_add(b);
+    if (arena->nextsize < MAX_BLOCK) arena->nextsize *= 2;
+  }
+  void* p = block_begin(b)+b->used;
+  b->used += n;
+  arena->live++;
+  return p;
+}
+
+static void arena_destroy(WidgetArena* arena) {
+  for (WidgetArenaBlock* b = arena->blocks; b;) {
+    WidgetArenaBlock* next = b->next;
+    range_remove(b);
+    free(b);
+    b = next;
+  }
+  delete arena;
+}
+
+// Everything is deleted but the window is still there, keep the
+// biggest block for the next begin_arena():
+static void arena_rewind(WidgetArena* arena) {
+  WidgetArenaBlock* keep = arena->blocks;
+  for (WidgetArenaBlock* b = arena->blocks; b; b = b->next)
+    if (b->size > keep->size) keep = b;
+  for (WidgetArenaBlock* b = arena->blocks; b;) {
+    WidgetArenaBlock* next = b->next;
+    if (b != keep) {range_remove(b); free(b);}
+    b = next;
+  }
+  keep->next = 0;
+  keep->used = 0;
+  arena->blocks = keep;
+}
+
+// Return false if p is not in an arena:
+static bool arena_free(void* p) {
+  WidgetArenaBlock* b = find_block(p);
+  if (!b) return false;
+  WidgetArena* arena = b->arena;
+  if (!--arena->live) {
+    if (!arena->owned) arena_destroy(arena);
+    else if (arena != current_arena) arena_rewind(arena);
+  }
+  return true;
+}
+
+/*! Widgets are allocated from the arena of the window that
+  Window::begin_arena() was called on, if there is one. */
+void* Widget::operator new(size_t n) {
+  void* p = current_arena ? arena_alloc(current_arena, n) : ::operator new(n);
+  fl_new_widget = p;
+  fl_new_widget_size = n;
+  return p;
+}
+
+void Widget::operator delete(void* p) {
+  if (p && !arena_free(p)) ::operator delete(p);
+}
+
+/*!
+  Makes every widget constructed after this, until end_arena(), come
+  from large blocks of memory belonging to this window instead of each
+  being allocated separately, and calls begin(). This keeps the widgets of a big window
+  together in memory, and makes deleting them much faster.
+
+  The memory is not reused when a single widget is deleted, only when
+  all of them are, such as by clear() or destroying the window. It is
+  not a good idea to make and delete many widgets between
+  begin_arena() and end_arena() for this reason. Widgets may be moved
+  to other windows or outlive this one, the memory is kept until the
+  last one is deleted.
+
+  \a size is about how many bytes the first block should be.
+*/
+void Window::begin_arena(int size) {
+  if (!arena_) {
+    arena_ = new WidgetArena;
+    arena_->blocks = 0;
+    arena_->live = 0;
+    arena_->nextsize = size > 0 ? size : FIRST_BLOCK;
+    arena_->owned = true;
+  }
+  arena_->previous = current_arena;
+  current_arena = arena_;
+  begin();
+}
+
+/*! Stop allocating widgets from this window's arena and call end(). */
+void Window::end_arena() {
+  if (arena_ && current_arena == arena_) {
+    current_arena = arena_->previous;
+    if (!arena_->live && arena_->blocks) arena_rewind(arena_);
+  }
+  end();
+}
+
+// Called by the Window destructor. The children are deleted after this,
+// so the last one frees the arena:
+void arena_release(WidgetArena* arena) {
+  if (!arena) return;
+  for (WidgetArena** p = &current_arena; *p; p = &(*p)->previous)
+    if (*p == arena) {*p = arena->previous; break;}
+  arena->owned = false;
+  if (!arena->live) arena_destroy(arena);
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,194 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#include <fltk/WidgetPool.h>
+#include <fltk/Item.h>
+#include <string.h>
+
+using namespace fltk;
+
+/*! \class fltk::WidgetPool
+
+  Recycles the widgets that an fltk::List returns from child(), so a
+  List can give each row that is shown its own widget without making
+  one for every row. The same row gets the same widget back for as long
+  as it is kept, so it only has to be set up once. When there are
+  capacity() widgets of a type already, the one used least recently is
+  taken over by the new row.
+
+  Browser::layout() calls List::visible_items() with about how many
+  rows it shows, and a List using a pool should pass that to
+  capacity(), so memory stays proportional to the size of the browser
+  rather than the number of rows:
+
+\code
+class MyList : public fltk::List {
+  fltk::WidgetPool pool;
+public:
+  int children(const fltk::Menu*, const int* indexes, int level) {...}
+  fltk::Widget* child(const fltk::Menu* menu, const int* indexes, int level) {
+    bool reused;
+    fltk::Widget* w = pool.get(menu, indexes, level, 0, &reused);
+    if (!reused) {
+      w->label(text_for_row(indexes[0]));
+      w->w(0); w->h(0); // cause it to be measured
+    }
+    return w;
+  }
+  void visible_items(const fltk::Menu*, int n) {pool.capacity(n);}
+};
+\endcode
+
+  If the data for the rows changes, call forget() so they are all
+  set up again.
+
+  The rows are searched linearly, which is fast for the few dozen
+  widgets a browser shows.
+*/
+
+/*!
+  The \a maker is called with the \a type passed to get() and \a arg to
+  create new widgets. If it is null an fltk::Item is made. The widgets
+  are not added to any group.
+*/
+WidgetPool::WidgetPool(Maker maker, void* arg) {
+  entries_ = 0;
+  count_ = size_ = 0;
+  capacity_ = 32;
+  clock_ = 0;
+  maker_ = maker;
+  arg_ = arg;
+}
+
+/*! Deletes all the widgets. */
+WidgetPool::~WidgetPool() {
+  clear();
+  delete[] entries_;
+}
+
+/*!
+  Return the widget for the row identified by the \a menu, \a indexes
+  and \a level, as passed to List::child(). \a type selects different
+  kinds of widgets, for instance parents and leaves; each type is
+  recycled separately. \a reused is set to true if this widget was
+  already returned for this row, and to false if it is new or was
+  used for another row, and must be set up.
+*/
+Widget* WidgetPool::get(const Menu* menu, const int* indexes, int level,
+			int type, bool* reused) {
+  Entry* victim = 0;
+  int n = 0;
+  for (int i = 0; i < count_; i++) {
+    Entry& e = entries_[i];
+    if (e.type != type) continue;
+    if (e.menu == menu && e.level == level &&
+	!memcmp(e.indexes, indexes, (level+1)*sizeof(int))) {
+      e.stamp = ++clock_;
+      if (reused) *reused = true;
+      return e.widget;
+    }
+    n++;
+    if (!victim || e.stamp < victim->stamp) victim = &e;
+  }
+  if (!victim || n < capacity_) {
+    if (count_ >= size_) {
+      size_ = size_ ? 2*size_ : 16;
+      Entry* newentries = new Entry[size_];
+      memcpy(newentries, entries_, count_*sizeof(Entry));
+      delete[] entries_;
+      entries_ = newentries;
+    }
+    victim = &entries_[count_++];
+    Group* saved = Group::current();
+    Group::current(0);
+    victim->widget = maker_ ? maker_(type, arg_) : new Item();
+    Group::current(saved);
+    victim->type = type;
+    victim->level = -1;
+    victim->indexes = 0;
+  }
+  if (victim->level != level) {
+    delete[] victim->indexes;
+    victim->indexes = new int[level+1];
+  }
+  memcpy(victim->indexes, indexes, (level+1)*sizeof(int));
+  victim->menu = menu;
+  victim->level = level;
+  victim->stamp = ++clock_;
+  if (reused) *reused = false;
+  return victim->widget;
+}
+
+// Delete the least recently used widgets of type beyond capacity(),
+// return true if any were deleted:
+bool WidgetPool::trim(int type) {
+  bool ret = false;
+  for (;;) {
+    int n = 0, oldest = -1;
+    for (int i = 0; i < count_; i++) {
+      if (entries_[i].type != type) continue;
+      n++;
+      if (oldest < 0 || entries_[i].stamp < entries_[oldest].stamp) oldest = i;
+    }
+    if (n <= capacity_) return ret;
+    delete entries_[oldest].widget;
+    delete[] entries_[oldest].indexes;
+    entries_[oldest] = entries_[--count_];
+    ret = true;
+  }
+}
+
+/*!
+  Set how many widgets of each type are kept. This should be at least
+  the number of rows that can be seen at once, and is usually set by
+  List::visible_items(). The default is 32. Extra widgets are deleted.
+*/
+void WidgetPool::capacity(int n) {
+  if (n < 1) n = 1;
+  capacity_ = n;
+  // trimming moves the entries, so repeat until nothing changes:
+  for (bool again = true; again;) {
+    again = false;
+    for (int i = 0; i < count_; i++)
+      if (trim(entries_[i].type)) again = true;
+  }
+}
+
+/*! Make get() report every widget as not reused, so they are all set
+  up again. The widgets are kept. */
+void WidgetPool::forget() {
+  for (int i = 0; i < count_; i++) entries_[i].menu = 0;
+}
+
+/*! Delete all the widgets. */
+void WidgetPool::clear() {
+  for (int i = 0; i < count_; i++) {
+    delete entries_[i].widget;
+    delete[] entries_[i].indexes;
+  }
+  count_ = 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,109 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+#include <fltk/WidgetTable.h>
+#include <fltk/Group.h>
+
+using namespace fltk;
+
+/*! \class fltk::WidgetDescriptor
+
+  Describes one widget for build_widgets(). Fluid writes these for a
+  window when the "widget tables" option is on, instead of a new
+  and a list of set calls for each widget. \a make constructs it, and
+  is usually new_widget<T>. A group is followed by its \a descendants,
+  which are made inside it.
+
+\code
+static const fltk::WidgetDescriptor widgets[] = {
+  {fltk::new_widget<fltk::Button>, 10, 10, 90, 25, "OK", 0, 0, ok_cb},
+  {fltk::new_widget<fltk::Group>, 10, 40, 200, 100, 0, 1},
+  {fltk::new_widget<fltk::Input>, 50, 10, 140, 25, "Name:"},
+};
+fltk::build_widgets(widgets, 3);
+\endcode
+*/
+
+// Make one row and its descendants, return the row after them:
+static const WidgetDescriptor* build(const WidgetDescriptor* d) {
+  Widget* o = d->make(d->x, d->y, d->w, d->h, d->label);
+  const unsigned flags = d->flags;
+  if (d->pointer) *d->pointer = o;
+  if (flags & WidgetDescriptor::TYPE) o->type(d->type);
+  if (flags & WidgetDescriptor::VERTICAL) o->set_vertical();
+
+  // all the style fields go into one shared style:
+  Style changes;
+  changes.box_ = d->box ? *d->box : 0;
+  changes.buttonbox_ = d->buttonbox ? *d->buttonbox : 0;
+  changes.labelfont_ = d->labelfont ? *d->labelfont : 0;
+  changes.textfont_ = d->textfont ? *d->textfont : 0;
+  changes.labeltype_ = d->labeltype ? *d->labeltype : 0;
+  changes.color_ = d->color;
+  changes.textcolor_ = d->textcolor;
+  changes.selection_color_ = d->selection_color;
+  changes.selection_textcolor_ = d->selection_textcolor;
+  changes.buttoncolor_ = d->buttoncolor;
+  changes.labelcolor_ = d->labelcolor;
+  changes.highlight_color_ = d->highlight_color;
+  changes.highlight_textcolor_ = d->highlight_textcolor;
+  changes.labelsize_ = d->labelsize;
+  changes.textsize_ = d->textsize;
+  o->set_style_fields(changes);
+
+  if (flags & WidgetDescriptor::STATE) o->set_flag(STATE);
+  if (d->shortcut) o->shortcut(d->shortcut);
+  if (d->callback) o->callback(d->callback);
+  if (flags & WidgetDescriptor::ALIGN) o->align(d->align);
+  if (flags & WidgetDescriptor::WHEN) o->when(d->when);
+  if (flags & WidgetDescriptor::HIDE) o->hide();
+  if (flags & WidgetDescriptor::DEACTIVATE) o->deactivate();
+  if (d->tooltip) o->tooltip(d->tooltip);
+
+  const WidgetDescriptor* e = d+1+d->descendants;
+  if (d->descendants) {
+    Group* g = (Group*)o;
+    g->begin();
+    for (d++; d < e;) d = build(d);
+    g->end();
+  }
+  if (flags & WidgetDescriptor::RESIZABLE) Group::current()->resizable(o);
+  return e;
+}
+
+/*!
+  Construct the widgets described by the \a n rows of \a table, which
+  include the descendants of any groups, and add them to
+  Group::current().
+  This has the same result as fluid's code for each widget, but is
+  smaller, and each widget looks up its shared style only once no
+  matter how many style fields it sets.
+*/
+void fltk::build_widgets(const WidgetDescriptor* table, int n) {
+  const WidgetDescriptor* e = table+n;
+  while (table < e) table = build(table);
+}
+
+//
+// End of "$Id$".
+//
@@ -34,15 +34,85 @@
 #include <fltk/draw.h>
 #include <fltk/string.h>
 #include <config.h>
+#include <ctype.h>
 using namespace fltk;
 
+LabelType* LabelType::first = 0;
+
+// Hash table of the LabelTypes by name, the same as the one for
+// NamedStyle in Style.cxx. It is built by the first find(), as the
+// constructors of static ones may run before the table is.
+
+static LabelType** label_table;
+static int label_table_size;	// always prime
+static int label_count;
+
+static unsigned label_hash(const char* s) {
+  unsigned h = 0;
+  for (; *s; s++) h = 37*h + tolower(*s);
+  return h;
+}
+
+// returns hash entry if it exists, or the empty slot for it:
+static int label_index(const char* name) {
+  unsigned pos = label_hash(name) % label_table_size;
+  for (unsigned i = 0;;) {
+    LabelType* p = label_table[pos];
+    if (!p || !strcasecmp(p->name, name)) return pos;
+    pos += 2 * ++i - 1;
+    pos %= label_table_size;
+  }
+}
+
+// The list has the newest first, and a newer one replaces an older
+// one of the same name:
+static void label_add(LabelType* p, bool replace) {
+  if (!p->name) return;
+  int pos = label_index(p->name);
+  if (label_table[pos]) {if (replace) label_table[pos] = p; return;}
+  label_table[pos] = p;
+  label_count++;
+}
+
+static void build_label_table() {
+  int n = 0;
+  LabelType* p;
+  for (p = LabelType::first; p; p = p->next) n++;
+  n = 2*n+31;
+  for (int i = 3; i*i <= n; i += 2) while (n%i == 0) {i = 3; n += 2;}
+  delete[] label_table;
+  label_table_size = n;
+  label_table = new LabelType*[n];
+  memset(label_table, 0, n*sizeof(LabelType*));
+  label_count = 0;
+  for (p = LabelType::first; p; p = p->next) label_add(p, false);
+}
+
+LabelType::LabelType(const char* n) : name(n), next(first) {
+  first = this;
+  if (label_table) {
+    label_add(this, true);
+    if (label_count > label_table_size/2) build_label_table();
+  }
+}
+
+/*! Return the LabelType with this name, ignoring case, or null. */
 LabelType* LabelType::find(const char* name) {
-  for (LabelType* p = LabelType::first; p; p = p->next)
-    if (p->name && !strcasecmp(name, p->name)) return p;
-  return 0;
+  if (!label_table) build_label_table();
+  return label_table[label_index(name)];
 }
 
-LabelType* LabelType::first = 0;
+/*! Return the LabelTypes that find() can return, in random order. Start
+  with \a index set to zero and call this until it returns null.
+*/
+LabelType* LabelType::iterate(int& i) {
+  if (!label_table) build_label_table();
+  while (i < label_table_size) {
+    LabelType* ret = label_table[i++];
+    if (ret) return ret;
+  }
+  return 0;
+}
 
 ////////////////////////////////////////////////////////////////
 
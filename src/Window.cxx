@@ -60,10 +60,12 @@ If you don't change it then that key will close the window.
 #include <config.h>
 #include <fltk/Window.h>
 #include <fltk/events.h>
+#include <fltk/Font.h>
 #include <fltk/damage.h>
 #include <fltk/layout.h>
 #include <fltk/run.h>
 #include <fltk/x.h>
+#include "DamageRects.h"
 using namespace fltk;
 
 /*! Return a pointer to the fltk::Window this widget is in.
@@ -71,11 +73,13 @@ using namespace fltk;
   the window).  Returns NULL if none.  Note: for an
   fltk::Window, this returns the \e parent window (if any),
   not \e this window.
+
+  This is remembered, so it is only searched for again after some
+  widget's parent() or type() changes.
 */
 Window *Widget::window() const {
-  for (Widget *o = parent(); o; o = o->parent())
-    if (o->is_window()) return (Window*)o;
-  return 0;
+  if (tree_cached_ != tree_changes_) update_tree_cache();
+  return window_;
 }
 
 // WAS: anything with cairo contexts should be put into make_current()
@@ -122,9 +126,11 @@ void Window::_Window() {
   i = 0;
   icon_ = 0;
   iconlabel_ = 0;
+  arena_ = 0;
   resizable(0);
   minw = minh = maxw = maxh = 0;
   size_range_set = 0;
+  client_drawing_ = AUTO_DRAWING;
   child_of_ = 0;
   shortcut(EscapeKey);
   callback((Callback*)default_callback);
@@ -451,7 +457,8 @@ void Window::show() {
 
   if (!shown()) {
 
-    // open the display:
+    // open the display, the font list is made meanwhile if possible:
+    prefetch_fonts();
     load_theme();
     open_display();
     layout();
@@ -742,6 +749,43 @@ void CreatedWindow::expose(const fltk::Rectangle& r) {
   fltk::damage(1); // make flush() do something
 }
 
+DamageRects* fl_damage_rects;
+
+static long area(const Rectangle& r) {return long(r.w())*r.h();}
+
+// Add a rectangle, merging it with any it overlaps, or that are close
+// enough that the bounding box is not much bigger than the two of them.
+// If there are too many, the two that waste the least area when merged
+// are replaced with their bounding box.
+void DamageRects::add(const Rectangle& r1) {
+  if (r1.empty()) return;
+  Rectangle r(r1);
+  for (int i = 0; i < n;) {
+    Rectangle u(rect[i]); u.merge(r);
+    Rectangle o(rect[i]); o.intersect(r);
+    if (!o.empty() || area(u) <= (area(rect[i])+area(r))*5/4) {
+      // the result may now touch ones already checked, so start over:
+      r = u;
+      rect[i] = rect[--n];
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+  rect[n++] = r;
+  if (n <= MAXIMUM) return;
+  int a = 0, b = 1; long waste = 0;
+  for (int i = 0; i < n; i++) for (int j = i+1; j < n; j++) {
+    Rectangle u(rect[i]); u.merge(rect[j]);
+    long w = area(u)-area(rect[i])-area(rect[j]);
+    if ((!i && j == 1) || w < waste) {a = i; b = j; waste = w;}
+  }
+  r = rect[a]; r.merge(rect[b]);
+  rect[b] = rect[--n];
+  rect[a] = rect[--n];
+  add(r);
+}
+
 /*! \fn bool Window::double_buffer() const
   Returns true if set_double_buffer() was called, returns false if
   clear_double_buffer() was called. If neither has been called this
@@ -762,6 +806,47 @@ void CreatedWindow::expose(const fltk::Rectangle& r) {
   will remain double buffered even if this is off.
 */
 
+/*! \fn bool Window::sparse_update() const
+  Returns true if set_sparse_update() was called.
+*/
+
+/*! \fn void Window::set_sparse_update();
+  When a double_buffer() window is redrawn because only some of its
+  child widgets were damaged, copy only the areas of those children
+  from the offscreen image to the screen, rather than the whole
+  window. This can greatly reduce the pixels sent to the screen when
+  small widgets far apart change. Do not use this if a subclass's
+  draw() draws more than its children when damage() is
+  fltk::DAMAGE_CHILD, as that drawing will not be copied.
+*/
+
+/*! \fn void Window::clear_sparse_update();
+  Copy the whole window to the screen after redrawing damaged
+  children. This is the default.
+*/
+
+/*! \fn int Window::client_drawing() const
+  Returns what client_drawing(int) was set to. The default is
+  AUTO_DRAWING.
+*/
+
+/*! \fn void Window::client_drawing(int);
+  Where a double_buffer() window is drawn. With CLIENT_DRAWING all of
+  it is drawn with Cairo into an Image in this program's memory, and
+  only the changed area is sent to the screen, as one image. Exposing
+  it also only sends the image again. Over a slow connection to a
+  remote X server this is much faster than sending every drawing
+  request and waiting for the round trips they need.
+
+  SERVER_DRAWING turns this off. AUTO_DRAWING, the default, picks
+  CLIENT_DRAWING if fltk::display_latency() is more than a few
+  milliseconds.
+
+  This is only done on X11 when fltk was compiled to use Cairo. In
+  other builds the drawing calls are done by the server and this
+  setting is ignored.
+*/
+
 /** A subclass of Window can define this method to draw an "overlay"
   image that appears atop everything else in the window. This will
   only be called if you call redraw_overlay() on the shown() window,
@@ -889,8 +974,11 @@ void Window::destroy() {
   kludge has been done so the Window and all of it's children
   can be automatic (local) variables, but you must declare the
   Window first so that it is destroyed last. */
+extern void arena_release(WidgetArena*); // in WidgetArena.cxx
+
 Window::~Window() {
   destroy();
+  arena_release(arena_);
 }
 
 /** \fn void Window::borders( Rectangle *r ) const
@@ -34,6 +34,12 @@
 
 using namespace fltk;
 
+#if USE_X11
+extern Atom fl_NET_WM_STATE; // in run.cxx
+extern Atom fl_NET_WM_STATE_MAXIMIZED_VERT;
+extern Atom fl_NET_WM_STATE_MAXIMIZED_HORZ;
+#endif
+
 static void innards(Window*, bool fullscreen, int X, int Y, int W, int H);
 
 /*! Make the window completely fill the \a monitor, without any window
@@ -196,13 +202,14 @@ void Window::maximize() {
   // TODO: make it work on very old/simple WMs (as described in url above)
   // TODO: test it more / cleanup (some Xlib expert, please take a look)
 
-  Display *dpy = xdisplay;
+  // The atoms were looked up by open_display() with all the others,
+  // so this does not wait for the server:
+  Atom wm_state = fl_NET_WM_STATE;
+  Atom maximizeV = fl_NET_WM_STATE_MAXIMIZED_VERT;
+  Atom maximizeH = fl_NET_WM_STATE_MAXIMIZED_HORZ;
+  // _NET_WM_STATE_FULLSCREEN would give true fullscreen
 
   XEvent xev;
-  Atom wm_state = XInternAtom(dpy, "_NET_WM_STATE", False);
-  Atom maximizeV = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_VERT", False);
-  Atom maximizeH = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
-  // XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False); // that would give true fullscreen
 
   memset(&xev, 0, sizeof(xev));
   xev.type = ClientMessage;
@@ -217,7 +224,7 @@ void Window::maximize() {
              SubstructureNotifyMask|SubstructureRedirectMask, &xev);
 
   // flush it right away? Also seems to works without this as well...
-  // XFlush(dpy);
+  // XFlush(xdisplay);
 
 #else
 # warning "This method will not work on this system. (you can ignore this warning)"
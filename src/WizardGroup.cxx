@@ -60,6 +60,8 @@ int main(int argc, char **argv) {
   return fltk::run();
 }
 \endcode
+  The pages can be fltk::LazyGroup so their widgets are not made
+  until the page is first shown.
 */
 
 /** \fn void fltk::WizardGroup::draw(); 
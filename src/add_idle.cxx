@@ -110,6 +110,127 @@ void fltk::remove_idle(TimeoutHandler cb, void* data) {
   freelist = p;
 }
 
+////////////////////////////////////////////////////////////////
+// Idle jobs:
+//
+// These are all run by one idle callback. Each time it is called it
+// runs jobs until the slice of time is used up or an event is waiting,
+// so a job can do a little at a time without knowing how long each
+// piece takes.
+
+#include <fltk/trace.h>
+#include <stdlib.h>
+
+struct IdleJobEntry {
+  IdleJob job;
+  void* data;
+  int priority;
+  unsigned long last_run;	// for round-robin between equal priorities
+};
+
+static IdleJobEntry* jobs;
+static int num_jobs, jobs_size;
+static unsigned long job_runs;
+static float slice_length = .01f;
+static double slice_end;	// trace_time() when the slice is over
+static double next_ready_check;
+
+// The highest priority job that has waited the longest:
+static IdleJobEntry* next_job() {
+  IdleJobEntry* best = jobs;
+  for (IdleJobEntry* j = jobs+1; j < jobs+num_jobs; j++)
+    if (j->priority > best->priority ||
+	(j->priority == best->priority && j->last_run < best->last_run))
+      best = j;
+  return best;
+}
+
+static void run_idle_jobs(void*) {
+  next_ready_check = trace_time();
+  slice_end = next_ready_check + slice_length;
+  do {
+    IdleJobEntry* j = next_job();
+    j->last_run = ++job_runs;
+    IdleJob job = j->job; void* data = j->data;
+    // this may call add_idle_job() or remove_idle_job()!
+    if (!job(data)) remove_idle_job(job, data);
+  } while (num_jobs && !idle_slice_over());
+  slice_end = 0;
+}
+
+/*!
+  Add a job that is done a piece at a time in idle time.  job(
+  data) is called repeatedly until it returns false. It should do
+  some of the work and return true when idle_slice_over() is true,
+  keeping whatever it needs to continue where it left off.
+
+  Jobs with a higher  priority are run before any with a lower one,
+  and ones with the same priority take turns. All the jobs are run by
+  one idle callback (see add_idle()), which stops as soon as the slice
+  of time set by idle_slice() is used up or there are events waiting,
+  so the program still responds quickly to the user.
+
+  Adding a job that is already there only changes its priority.
+*/
+void fltk::add_idle_job(IdleJob job, void* data, int priority) {
+  for (int i = 0; i < num_jobs; i++)
+    if (jobs[i].job == job && jobs[i].data == data) {
+      jobs[i].priority = priority;
+      return;
+    }
+  if (num_jobs >= jobs_size) {
+    jobs_size = jobs_size ? 2*jobs_size : 8;
+    jobs = (IdleJobEntry*)realloc(jobs, jobs_size*sizeof(IdleJobEntry));
+  }
+  IdleJobEntry& j = jobs[num_jobs++];
+  j.job = job;
+  j.data = data;
+  j.priority = priority;
+  j.last_run = 0;
+  if (num_jobs == 1) add_idle(run_idle_jobs);
+}
+
+/*! Returns true if add_idle_job() was done for  job and  data and
+  it has not returned false or been removed. */
+bool fltk::has_idle_job(IdleJob job, void* data) {
+  for (int i = 0; i < num_jobs; i++)
+    if (jobs[i].job == job && jobs[i].data == data) return true;
+  return false;
+}
+
+/*! Stop calling the job, if it is installed. */
+void fltk::remove_idle_job(IdleJob job, void* data) {
+  for (int i = 0; i < num_jobs; i++)
+    if (jobs[i].job == job && jobs[i].data == data) {
+      jobs[i] = jobs[--num_jobs];
+      if (!num_jobs) remove_idle(run_idle_jobs);
+      return;
+    }
+}
+
+/*!
+  An idle job should return as soon as this is true. This happens
+  when the slice of time is used up, or when there are events or
+  timeouts waiting (this is only checked every millisecond, so this
+  can be called very often). It is always true outside of idle jobs.
+*/
+bool fltk::idle_slice_over() {
+  double now = trace_time();
+  if (now >= slice_end) return true;
+  if (now >= next_ready_check) {
+    next_ready_check = now + .001;
+    if (ready()) {slice_end = 0; return true;}
+  }
+  return false;
+}
+
+/*! Set how long idle jobs are run each time fltk::wait() calls the
+  idle callbacks. The default is .01 second. */
+void fltk::idle_slice(float seconds) {slice_length = seconds;}
+
+/*! Returns the value set by idle_slice(). */
+float fltk::idle_slice() {return slice_length;}
+
 //
 // End of "$Id$".
 //
@@ -60,13 +60,16 @@ void fltk::addcurve(float x0, float y0,
   float* p = points[0];
   *p++ = float(x); *p++ = float(y);
 
-  // find the area:
-  float a = fabsf((x-x2)*(y3-y1)-(y-y2)*(x3-x1));
-  float b = fabsf((x-x3)*(y2-y1)-(y-y3)*(x2-x1));
-  if (b > a) a = b;
-
-  // use that to guess at the number of segments:
-  int n = int(sqrtf(a)/4);
+  // The second derivative is at most 6 times the larger of these
+  // differences, and n chords are then no more than d*6/(8*n*n) away
+  // from the curve. Use enough that this is 1/4 pixel, so curves that
+  // are nearly straight at the current scale get only a few points:
+  float ax = x-2*x1+x2; float ay = y-2*y1+y2;
+  float bx = x1-2*x2+x3; float by = y1-2*y2+y3;
+  float d = sqrtf(ax*ax+ay*ay);
+  float d2 = sqrtf(bx*bx+by*by);
+  if (d2 > d) d = d2;
+  int n = int(ceilf(sqrtf(3*d)));
   if (n > 1) {
     if (n > MAXPOINTS-1) n = MAXPOINTS-1;
 
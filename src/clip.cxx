@@ -32,6 +32,7 @@
 #include <fltk/x.h>
 #include <fltk/string.h>
 #include <stdlib.h>
+#include "DisplayList.h"
 using namespace fltk;
 
 #if USE_X11
@@ -40,26 +41,70 @@ using namespace fltk;
 # define Region HRGN
 #endif
 
-static Region emptyrstack = 0;
-static Region* rstack = &emptyrstack;
+// Each level of the clip stack is a rectangle, a Region, or no clip at
+// all. Most clips are rectangles, and for them the system clip is set
+// without making a Region at all. One is only made for a rectangle if
+// clip_region() asks for it, or clipout() changes it into some other
+// shape, and then it is kept with the rectangle until popped:
+struct ClipState {
+  Region region; // the clip, or if rect it is 0 or the same as box
+  Rectangle box; // the clip if rect is true
+  bool rect;
+};
+
+static ClipState emptyrstack; // no clip
+static ClipState* rstack = &emptyrstack;
 static int rstacksize = 0;
 static int rstackptr = 0;
 
-static inline void pushregion(Region r) {
-  if (rstackptr >= rstacksize) {
-    if (rstacksize) {
-      rstacksize = 2*rstacksize;
-      Region* newstack = new Region[rstacksize];
-      memcpy(newstack, rstack, sizeof(Region)*rstackptr);
-      delete[] rstack;
-      rstack = newstack;
-    } else {
-      rstacksize = 16;
-      rstack = new Region[rstacksize];
-      rstack[0] = 0;
-    }
+// Regions no longer in use are kept for reuse, rather than destroyed:
+static Region region_pool[32];
+static int pooled_regions;
+
+static void free_region(Region r) {
+  if (!r) return;
+  if (pooled_regions < 32) {region_pool[pooled_regions++] = r; return;}
+#if USE_X11
+  XDestroyRegion(r);
+#elif defined(_WIN32)
+  DeleteObject(r);
+#endif
+}
+
+// Return a Region containing only the rectangle:
+static Region rect_region(const Rectangle& b) {
+#if USE_X11
+  if (!pooled_regions) return XRectangleRegion(b.x(), b.y(), b.w(), b.h());
+  Region r = region_pool[--pooled_regions];
+  static Region empty_region;
+  if (!empty_region) empty_region = XCreateRegion();
+  XIntersectRegion(empty_region, r, r);
+  if (!b.empty()) {
+    XRectangle R;
+    R.x = b.x(); R.y = b.y(); R.width = b.w(); R.height = b.h();
+    XUnionRectWithRegion(&R, r, r);
+  }
+  return r;
+#elif defined(_WIN32)
+  int R = b.empty() ? b.x() : b.r();
+  int B = b.empty() ? b.y() : b.b();
+  if (!pooled_regions) return CreateRectRgn(b.x(), b.y(), R, B);
+  Region r = region_pool[--pooled_regions];
+  SetRectRgn(r, b.x(), b.y(), R, B);
+  return r;
+#endif
+}
+
+static inline ClipState& pushstate() {
+  if (rstackptr+1 >= rstacksize) {
+    int newsize = rstacksize ? 2*rstacksize : 16;
+    ClipState* newstack = new ClipState[newsize];
+    for (int i = 0; i <= rstackptr; i++) newstack[i] = rstack[i];
+    if (rstacksize) delete[] rstack;
+    rstack = newstack;
+    rstacksize = newsize;
   }
-  rstack[++rstackptr] = r;
+  return rstack[++rstackptr];
 }
 
 int fl_clip_state_number = 0; // used by code that needs to update clip regions
@@ -69,7 +114,9 @@ int fl_clip_state_number = 0; // used by code that needs to update clip regions
   include <fltk/x.h> to use this. Returns null if there is no clipping.
 */
 Region fltk::clip_region() {
-  return rstack[rstackptr];
+  ClipState& s = rstack[rstackptr];
+  if (s.rect && !s.region) s.region = rect_region(s.box);
+  return s.region;
 }
 
 #if USE_X11 || defined(DOXYGEN)
@@ -85,23 +132,50 @@ Region XRectangleRegion(int x, int y, int w, int h) {
 }
 #endif
 
+#if USE_X11 && USE_XFT && !USE_CAIRO
+extern void fl_flush_trapezoids(); // in path.cxx
+#elif defined(_WIN32) && !USE_CAIRO
+extern void fl_d2d_flush(); // in win32/direct2d.cxx
+#endif
+
 // Make the system's clip match the top of the clip stack.  This can
 // be used after changing the stack, or to undo any clobbering of clip
 // done by your program:
 void fl_restore_clip() {
-  Region r = rstack[rstackptr];
+  const ClipState& s = rstack[rstackptr];
   fl_clip_state_number++;
 #if USE_CAIRO
 #elif USE_X11
-  if (r) XSetRegion(xdisplay, gc, r);
+#if USE_XFT
+  fl_flush_trapezoids(); // draw them with the old clip
+#endif
+  XRectangle R;
+  int n = 0;
+  if (s.rect && !s.box.empty()) {
+    R.x = s.box.x(); R.y = s.box.y();
+    R.width = s.box.w(); R.height = s.box.h();
+    n = 1;
+  }
+  if (s.rect) XSetClipRectangles(xdisplay, gc, 0, 0, &R, n, YXBanded);
+  else if (s.region) XSetRegion(xdisplay, gc, s.region);
   else XSetClipMask(xdisplay, gc, 0);
 #if USE_XFT
   if (xftc) {
-    XftDrawSetClip(xftc, r);
+    if (s.rect) XftDrawSetClipRectangles(xftc, 0, 0, &R, n);
+    else XftDrawSetClip(xftc, s.region);
   }
 #endif
 #elif defined(_WIN32)
-  SelectClipRgn(dc, r); //if r is NULL, clip is automatically cleared
+  fl_d2d_flush(); // draw them with the old clip
+  if (s.rect) {
+    SelectClipRgn(dc, 0);
+    if (s.box.empty())
+      IntersectClipRect(dc, 0, 0, 0, 0);
+    else
+      IntersectClipRect(dc, s.box.x(), s.box.y(), s.box.r(), s.box.b());
+  } else {
+    SelectClipRgn(dc, s.region); //if r is NULL, clip is automatically cleared
+  }
 #else
 # error
 #endif
@@ -109,13 +183,11 @@ void fl_restore_clip() {
 
 /** Replace the top of the clip stack. */
 void fltk::clip_region(Region region) {
-  Region oldr = rstack[rstackptr];
-#if USE_X11
-  if (oldr) XDestroyRegion(oldr);
-#elif defined(_WIN32)
-  if (oldr) DeleteObject(oldr);
-#endif
-  rstack[rstackptr] = region;
+  if (fl_display_list) fl_display_list->abort(); // can't record a Region
+  ClipState& s = rstack[rstackptr];
+  free_region(s.region);
+  s.region = region;
+  s.rect = false;
 #if !USE_CAIRO
   fl_restore_clip();
 #endif
@@ -135,39 +207,34 @@ void fltk::push_clip(const Rectangle& r) {
   construction of an intermediate rectangle object.
 */
 void fltk::push_clip(int x, int y, int w, int h) {
-  // Rectangle r; transform(x,y,w,h,r);
-  // no rectangle creation needed, use the direct FLTK_RECT predicates
-  // when dealing with x,y,w,h scalars evaluation in frequently used code
-  // Here XRectangleRegion() as well as CreateRectRgn() both use scalars so let's
-  // try not to build a Rectangle object that is not necessary:
-  Region region;
+  if (fl_display_list) fl_display_list->push_clip(x,y,w,h);
+  ClipState& s = pushstate();
+  const ClipState& current = rstack[rstackptr-1];
+  s.region = 0;
+  s.rect = true;
   if (FLTK_RECT_EMPTY(w,h)) {
-# if USE_X11
-    region = XCreateRegion();
-# elif defined(_WIN32)
-    region = CreateRectRgn(0,0,0,0);
-# else
-#  error
-# endif
+    s.box.set(0,0,0,0);
   } else {
-    Region current = rstack[rstackptr];
     transform(x, y); // absolute coordinates lazy evaluation, only when really needed
-# if USE_X11
-    region = XRectangleRegion(x, y, w, h);
-    if (current) {
-      Region temp = XCreateRegion();
-      XIntersectRegion(current, region, temp);
-      XDestroyRegion(region);
-      region = temp;
+    s.box.set(x, y, w, h);
+    if (current.rect) {
+      s.box.intersect(current.box);
+      if (s.box.empty()) s.box.set(0,0,0,0);
+    } else if (current.region) {
+#if USE_X11
+      // only make a new Region if the rectangle is not entirely inside it:
+      if (XRectInRegion(current.region, x, y, w, h) != RectangleIn) {
+	s.rect = false;
+	s.region = rect_region(s.box);
+	XIntersectRegion(current.region, s.region, s.region);
+      }
+#elif defined(_WIN32)
+      s.rect = false;
+      s.region = rect_region(s.box);
+      CombineRgn(s.region, s.region, current.region, RGN_AND);
+#endif
     }
-# elif defined(_WIN32)
-    region = CreateRectRgn(x, y, w+x, h+y);
-    if (current) CombineRgn(region, region, current, RGN_AND);
-# else
-#  error
-# endif
   }
-  pushregion(region);
 #if USE_CAIRO
     //transform(x,y);
     // fabien: FIXME! should be able to clip the current region not only a rect!
@@ -187,24 +254,26 @@ void fltk::push_clip(int x, int y, int w, int h) {
   non-rectangular clip regions. This call does nothing on those.
 */
 void fltk::clipout(const Rectangle& rectangle) {
+  if (fl_display_list) fl_display_list->clipout(rectangle);
   Rectangle r; transform(rectangle, r);
   if (r.empty()) return;
+  ClipState& s = rstack[rstackptr];
+  if (s.rect) {
+    // nothing to take out of an empty or non-intersecting rectangle:
+    Rectangle t(r); t.intersect(s.box);
+    if (t.empty()) return;
+  }
+  Region current = clip_region();
+  if (!current) current = rect_region(Rectangle(0,0,16383,16383));//?
+  Region region = rect_region(r);
 #if USE_X11
-  Region current = rstack[rstackptr];
-  if (!current) current = XRectangleRegion(0,0,16383,16383);//?
-  Region region = XRectangleRegion(r.x(), r.y(), r.w(), r.h());
-  Region temp = XCreateRegion();
-  XSubtractRegion(current, region, temp);
-  XDestroyRegion(region);
-  XDestroyRegion(current);
-  rstack[rstackptr] = temp;
+  XSubtractRegion(current, region, current);
 #elif defined(_WIN32)
-  Region current = rstack[rstackptr];
-  if (!current) current = CreateRectRgn(0,0,16383,16383);
-  Region region = CreateRectRgn(r.x(), r.y(), r.r(), r.b());
   CombineRgn(current, current, region, RGN_DIFF);
-  DeleteObject(region);
 #endif
+  free_region(region);
+  s.region = current;
+  s.rect = false;
 #if !USE_CAIRO
   fl_restore_clip();
 #endif
@@ -217,7 +286,10 @@ void fltk::clipout(const Rectangle& rectangle) {
   an offscreen area.
 */
 void fltk::push_no_clip() {
-  pushregion(0);
+  if (fl_display_list) fl_display_list->push_no_clip();
+  ClipState& s = pushstate();
+  s.region = 0;
+  s.rect = false;
 #if !USE_CAIRO
   fl_restore_clip();
 #else
@@ -231,13 +303,11 @@ void fltk::push_no_clip() {
   FLTK with the clip stack not empty unpredictable results occur.
 */
 void fltk::pop_clip() {
+  if (fl_display_list) fl_display_list->pop_clip();
   if (rstackptr > 0) {
-    Region oldr = rstack[rstackptr--];
-# if USE_X11
-    if (oldr) XDestroyRegion(oldr);
-# elif defined(_WIN32)
-    if (oldr) DeleteObject(oldr);
-# endif
+    ClipState& s = rstack[rstackptr--];
+    free_region(s.region);
+    s.region = 0;
 #if USE_CAIRO
      cairo_reset_clip(cr);
 #else
@@ -260,7 +330,11 @@ bool fltk::not_clipped(const Rectangle& rectangle) {
   // outside the 16-bit range the X/Win32 calls take:
   if (r.r() <= 0 || r.b() <= 0 || r.x() >= fl_clip_w || r.y() >= fl_clip_h)
     return false;
-  Region region = rstack[rstackptr];
+  const ClipState& s = rstack[rstackptr];
+  if (s.rect)
+    return !s.box.empty() && r.x() < s.box.r() && r.r() > s.box.x() &&
+      r.y() < s.box.b() && r.b() > s.box.y();
+  Region region = s.region;
   if (!region) return true;
 #if USE_X11
   return XRectInRegion(region, r.x(), r.y(), r.w(), r.h());
@@ -287,7 +361,8 @@ bool fltk::not_clipped(const Rectangle& rectangle) {
   - 2 if it is partially clipped.
 */
 int fltk::intersect_with_clip(Rectangle& r) {
-  Region region = rstack[rstackptr];
+  const ClipState& s = rstack[rstackptr];
+  Region region = s.region;
   // Test against the window to get 16-bit values:
   int ret = 1;
   if (r.x() < 0) {r.set_x(0); ret = 2;}
@@ -296,6 +371,14 @@ int fltk::intersect_with_clip(Rectangle& r) {
   t = fl_clip_h; if (r.b() > t) {r.set_b(t); ret = 2;}
   // check for total clip (or for empty rectangle):
   if (r.empty()) return 0;
+  if (s.rect) {
+    Rectangle t(r); t.intersect(s.box);
+    if (t.empty()) {r.set(0,0,0,0); return 0;}
+    if (t.x() == r.x() && t.y() == r.y() && t.w() == r.w() && t.h() == r.h())
+      return ret;
+    r = t;
+    return 2;
+  }
   if (!region) return ret;
 #if USE_X11
   switch (XRectInRegion(region, r.x(), r.y(), r.w(), r.h())) {
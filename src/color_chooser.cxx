@@ -36,6 +36,7 @@
 #include <fltk/ValueInput.h>
 #include <fltk/layout.h>
 #include <stdio.h>
+#include <string.h>
 
 using namespace fltk;
 
@@ -204,6 +205,38 @@ int ccHueBox::handle(int e) {
   }
 }
 
+#ifndef CIRCLE
+// The hue only depends on x, so with V=1 each of r, g and b from
+// hsv2rgb() is 1-S*k, where k is 0, 1, f or 1-f depending only on x.
+// The k of each column are figured out once for the width, then
+// each pixel is only a multiply, rather than going through tohs() and
+// hsv2rgb():
+static float* hue_columns;
+static int hue_columns_w;
+
+static void make_hue_columns(int W) {
+  if (W == hue_columns_w || W <= 0) return;
+  delete[] hue_columns;
+  hue_columns = new float[3*W];
+  hue_columns_w = W;
+  for (int x = 0; x < W; x++) {
+    float H,S; tohs(float(x)/W, 0, H, S);
+    int i = (int)H;
+    float f = H - (float)i;
+    float g = 1.0f-f;
+    float* k = hue_columns+3*x;
+    switch (i) {
+    case 0: k[0] = 0; k[1] = g; k[2] = 1; break;
+    case 1: k[0] = f; k[1] = 0; k[2] = 1; break;
+    case 2: k[0] = 1; k[1] = 0; k[2] = g; break;
+    case 3: k[0] = 1; k[1] = f; k[2] = 0; break;
+    case 4: k[0] = g; k[1] = 1; k[2] = 0; break;
+    default: k[0] = 0; k[1] = 1; k[2] = f; break;
+    }
+  }
+}
+#endif
+
 static const uchar* generate_image(void* vv, int X, int Y, int W, uchar* p) {
   ccHueBox* v = (ccHueBox*)vv;
   Rectangle r(v->w(),v->h()); v->box()->inset(r);
@@ -214,6 +247,19 @@ static const uchar* generate_image(void* vv, int X, int Y, int W, uchar* p) {
   const float V = 1.0f;
 #endif
   uchar* buf = p;
+#ifndef CIRCLE
+  float H,S; tohs(0,Yf,H,S);
+  if (S < 5.0e-6) {
+    uchar c = uchar(255*V+.5f);
+    memset(buf, c, 3*W);
+    return p;
+  }
+  for (const float* k = hue_columns+3*X; k < hue_columns+3*(X+W); k += 3) {
+    *buf++ = uchar(255*(V*(1.0f-S*k[0]))+.5f);
+    *buf++ = uchar(255*(V*(1.0f-S*k[1]))+.5f);
+    *buf++ = uchar(255*(V*(1.0f-S*k[2]))+.5f);
+  }
+#else
   for (int x = X; x < X+W; x++) {
     float Xf = float(x)/r.w();
     float H,S; tohs(Xf,Yf,H,S);
@@ -223,6 +269,7 @@ static const uchar* generate_image(void* vv, int X, int Y, int W, uchar* p) {
     *buf++ = uchar(255*g+.5f);
     *buf++ = uchar(255*b+.5f);
   }
+#endif
   return p;
 }
 
@@ -232,6 +279,9 @@ void ccHueBox::draw() {
   if (damage() == DAMAGE_VALUE) {
     push_clip(r.x()+px,r.y()+py,6,6);
   }
+#ifndef CIRCLE
+  make_hue_columns(r.w());
+#endif
   drawimage(generate_image, this, RGB, r);
   if (damage() == DAMAGE_VALUE) pop_clip();
   ColorChooser* c = (ColorChooser*)parent();
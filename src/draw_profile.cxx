@@ -0,0 +1,204 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Per-widget timing of draw(), measured by Group::draw_child() and
+// Group::update_child(), and an overlay that outlines the widgets that
+// cost the most. The statistics are attached to each widget with an
+// AssociationType so they go away when the widget is destroyed.
+
+#include <fltk/trace.h>
+#include <fltk/Window.h>
+#include <fltk/WidgetAssociation.h>
+#include <fltk/draw.h>
+#include <fltk/Style.h>
+#include <fltk/run.h>
+#include <fltk/string.h>
+#include <stdio.h>
+using namespace fltk;
+
+/*! \fn bool fltk::profiling_draws()
+  Returns true if start_draw_profile() has been called and
+  stop_draw_profile() has not.
+*/
+bool fltk::profiling_draws_;
+
+/*! \fn int fltk::draw_profile_overlay()
+  Returns the number of widgets outlined by the overlay, as passed
+  to start_draw_profile().
+*/
+int fltk::draw_profile_overlay_;
+
+namespace {
+
+struct ProfileEntry : DrawProfile {
+  ProfileEntry* next;
+  ProfileEntry* prev;
+};
+
+ProfileEntry* first_entry;
+
+class ProfileAssociation : public AssociationType {
+public:
+  void destroy(void* data) const {
+    ProfileEntry* e = (ProfileEntry*)data;
+    if (e->prev) e->prev->next = e->next; else first_entry = e->next;
+    if (e->next) e->next->prev = e->prev;
+    delete e;
+  }
+};
+
+const ProfileAssociation profile_association;
+
+}
+
+/*!
+  Start measuring how long each widget's draw() takes when it is
+  drawn by its parent Group. This can be used to find which widgets
+  make redrawing slow. The time for a Group includes the time for
+  all its children.
+
+  If \a overlay is not zero, after each window is drawn the \a overlay
+  widgets with the highest average time are outlined on top of it,
+  in colors ranging from green to red for the most expensive, with
+  their average time in milliseconds and the number of times they
+  were damaged.
+
+  The results can be read with draw_profile() and draw_profiles().
+*/
+void fltk::start_draw_profile(int overlay) {
+  profiling_draws_ = true;
+  if (overlay != draw_profile_overlay_) {
+    draw_profile_overlay_ = overlay;
+    redraw();
+  }
+}
+
+/*!
+  Stop measuring draw() times, and remove the overlay. The results so
+  far are kept until clear_draw_profile() is called.
+*/
+void fltk::stop_draw_profile() {
+  profiling_draws_ = false;
+  if (draw_profile_overlay_) {
+    draw_profile_overlay_ = 0;
+    redraw();
+  }
+}
+
+/*! Throw away all the per-widget statistics. */
+void fltk::clear_draw_profile() {
+  while (first_entry) {
+    Widget* w = (Widget*)(first_entry->widget);
+    if (!w->remove(profile_association, first_entry))
+      profile_association.destroy(first_entry);
+  }
+}
+
+/*!
+  Add the time since \a start (as returned by trace_time()) to the
+  statistics for \a widget. \a update is true if the widget was drawn
+  because it was damaged, false if the parent redrew everything.
+  This is called by Group::draw_child() and Group::update_child()
+  when profiling_draws() is on.
+*/
+void fltk::profile_draw(Widget* widget, double start, bool update) {
+  float t = float(trace_time()-start);
+  ProfileEntry* e = (ProfileEntry*)(widget->get(profile_association));
+  if (!e) {
+    e = new ProfileEntry;
+    e->widget = widget;
+    e->average = e->max = t;
+    e->draws = e->updates = 0;
+    e->prev = 0;
+    e->next = first_entry;
+    if (first_entry) first_entry->prev = e;
+    first_entry = e;
+    widget->set(profile_association, e);
+  } else {
+    e->average += (t-e->average)/16;
+    if (t > e->max) e->max = t;
+  }
+  e->last = t;
+  if (update) e->updates++; else e->draws++;
+}
+
+/*!
+  Return the statistics for \a widget, or null if it has not been
+  drawn since start_draw_profile() or clear_draw_profile().
+*/
+const DrawProfile* fltk::draw_profile(const Widget* widget) {
+  return (const DrawProfile*)(widget->get(profile_association));
+}
+
+/*!
+  Fill \a array with the \a n widgets with the highest average draw()
+  time, most expensive first. Returns how many were put in the array,
+  which may be less than \a n.
+*/
+int fltk::draw_profiles(const DrawProfile** array, int n) {
+  int used = 0;
+  for (ProfileEntry* e = first_entry; e; e = e->next) {
+    int i;
+    if (used < n) i = used++;
+    else if (n && e->average > array[n-1]->average) i = n-1;
+    else continue;
+    for (; i > 0 && array[i-1]->average < e->average; i--)
+      array[i] = array[i-1];
+    array[i] = e;
+  }
+  return used;
+}
+
+// Called by fl_window_flush() after it draws a window:
+void fl_draw_profile_overlay(Window* window) {
+  enum {MAXIMUM = 64};
+  const DrawProfile* list[MAXIMUM];
+  int n = draw_profiles(list, draw_profile_overlay_ < MAXIMUM ?
+			draw_profile_overlay_ : MAXIMUM);
+  if (!n) return;
+  float worst = list[0]->average;
+  for (int i = n; i--;) { // draw the worst last so it is on top
+    Widget* w = (Widget*)(list[i]->widget);
+    if (w->window() != window || !w->visible_r()) continue;
+    w->make_current();
+    Color c = lerp(GREEN, RED, worst > 0 ? list[i]->average/worst : 1);
+    setcolor(c);
+    strokerect(0, 0, w->w(), w->h());
+    strokerect(1, 1, w->w()-2, w->h()-2);
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.2fms %lu",
+	     list[i]->average*1000, list[i]->updates);
+    setfont(HELVETICA, 10);
+    int tw = int(getwidth(buffer))+4;
+    int th = int(getascent()+getdescent()+.5f)+2;
+    fillrect(0, 0, tw, th);
+    setcolor(BLACK);
+    drawtext(buffer, 2, getascent()+1);
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include "DisplayList.h"
 using namespace fltk;
 
 /* These are for getting the default leading: */
@@ -482,15 +483,13 @@ static void wrap(
 // Split at newlines and tabs into sections and then call wrap on them
 // Return value is the y height of the text. The width is stored in
 // max_x. W is only used if ALIGN_WRAP is on.
-static float split(
+static float layout(
     const char* str,
     int W,
     Flags flags,
     float (*getwidth)(const char*, int) // lets you change the width function
     )
 {
-  normal_font = getfont();
-  normal_size = getsize();
   ::flags = flags;
   const int* column = column_widths_;
 
@@ -533,6 +532,165 @@ static float split(
   }
 }
 
+////////////////////////////////////////////////////////////////
+// Cache of previous layouts. The same labels are measured and drawn
+// over and over, so the segments from layout() are remembered along
+// with everything that affected them. The Segments point into the
+// string, so the pointer must match as well as the contents.
+
+struct Layout {
+  unsigned hash;	// of everything below
+  const char* str;
+  int W;
+  Flags flags;
+  Font* font;
+  float size;
+  float leading;
+  float (*getwidth)(const char*, int);
+  const int* column_widths;
+  bool hide_underscore;
+  // the results:
+  Segment* segments;
+  int segment_count;
+  float max_x, max_y;
+  Color bgboxcolor;
+  Layout* hash_next;
+  Layout* prev;		// LRU list, most recently used first
+  Layout* next;
+};
+
+enum {LAYOUT_BUCKETS = 256, MAX_LAYOUT_SEGMENTS = 256};
+static Layout* layout_buckets[LAYOUT_BUCKETS];
+static Layout* first_layout;
+static Layout* last_layout;
+static int layout_count;
+static int max_layouts = 512;
+
+static void unlink_layout(Layout* l) {
+  if (l->prev) l->prev->next = l->next; else first_layout = l->next;
+  if (l->next) l->next->prev = l->prev; else last_layout = l->prev;
+}
+
+static void push_layout(Layout* l) {
+  l->prev = 0;
+  l->next = first_layout;
+  if (first_layout) first_layout->prev = l; else last_layout = l;
+  first_layout = l;
+}
+
+static void remove_last_layout() {
+  Layout* l = last_layout;
+  Layout** p = &layout_buckets[l->hash%LAYOUT_BUCKETS];
+  while (*p != l) p = &((*p)->hash_next);
+  *p = l->hash_next;
+  unlink_layout(l);
+  delete[] l->segments;
+  delete l;
+  layout_count--;
+}
+
+static inline unsigned hash_bytes(unsigned h, const void* data, int n) {
+  for (int i = 0; i < n; i++) h = (h ^ ((const uchar*)data)[i]) * 16777619U;
+  return h;
+}
+
+// Same as layout() but reuses the answer from last time if possible:
+static float split(
+    const char* str,
+    int W,
+    Flags flags,
+    float (*getwidth)(const char*, int)
+    )
+{
+  normal_font = getfont();
+  normal_size = getsize();
+  if (max_layouts <= 0) return layout(str, W, flags, getwidth);
+  Layout k;
+  k.str = str;
+  k.W = W;
+  k.flags = flags;
+  k.font = normal_font;
+  k.size = normal_size;
+  k.leading = Widget::default_style->leading();
+  k.getwidth = getwidth;
+  k.column_widths = column_widths_;
+  k.hide_underscore = fl_hide_underscore;
+  unsigned h = hash_bytes(2166136261U, str, strlen(str));
+  h = hash_bytes(h, &k.str, sizeof(k.str));
+  h = hash_bytes(h, &k.W, sizeof(k.W));
+  h = hash_bytes(h, &k.flags, sizeof(k.flags));
+  h = hash_bytes(h, &k.font, sizeof(k.font));
+  h = hash_bytes(h, &k.size, sizeof(k.size));
+  h = hash_bytes(h, &k.leading, sizeof(k.leading));
+  h = hash_bytes(h, &k.getwidth, sizeof(k.getwidth));
+  // the column widths are a zero-terminated array:
+  if (column_widths_) {
+    const int* c = column_widths_; while (*c) c++;
+    h = hash_bytes(h, column_widths_, (c-column_widths_)*sizeof(int));
+    h = hash_bytes(h, &k.column_widths, sizeof(k.column_widths));
+  }
+  h = hash_bytes(h, &k.hide_underscore, 1);
+  k.hash = h;
+
+  Layout** bucket = &layout_buckets[h%LAYOUT_BUCKETS];
+  for (Layout* l = *bucket; l; l = l->hash_next) {
+    if (l->hash == h && l->str == str && l->W == W && l->flags == flags &&
+	l->font == k.font && l->size == k.size && l->leading == k.leading &&
+	l->getwidth == getwidth && l->column_widths == column_widths_ &&
+	l->hide_underscore == k.hide_underscore) {
+      if (l != first_layout) {unlink_layout(l); push_layout(l);}
+      if (l->segment_count > segment_array_size) {
+	delete[] segments;
+	segment_array_size = l->segment_count;
+	segments = new Segment[segment_array_size];
+      }
+      memcpy(segments, l->segments, l->segment_count*sizeof(Segment));
+      segment_count = l->segment_count;
+      max_x = l->max_x;
+      max_y = l->max_y;
+      if (l->bgboxcolor) bgboxcolor = l->bgboxcolor;
+      return max_y;
+    }
+  }
+
+  Color old_bgboxcolor = bgboxcolor;
+  bgboxcolor = 0;
+  float ret = layout(str, W, flags, getwidth);
+  Color new_bgboxcolor = bgboxcolor;
+  if (!bgboxcolor) bgboxcolor = old_bgboxcolor;
+  if (segment_count > MAX_LAYOUT_SEGMENTS) return ret;
+
+  while (layout_count >= max_layouts) remove_last_layout();
+  Layout* l = new Layout(k);
+  l->segments = new Segment[segment_count ? segment_count : 1];
+  memcpy(l->segments, segments, segment_count*sizeof(Segment));
+  l->segment_count = segment_count;
+  l->max_x = max_x;
+  l->max_y = max_y;
+  l->bgboxcolor = new_bgboxcolor;
+  l->hash_next = *bucket;
+  *bucket = l;
+  push_layout(l);
+  layout_count++;
+  return ret;
+}
+
+/*!
+  Set how many label layouts drawtext() and measure() remember. The
+  default is 512, zero turns this off.
+
+  A layout is reused when the same string, at the same address, is
+  formatted again with the same font, size, flags, width, and
+  column_widths(). Changing the text in place is noticed, but changing
+  the size of a Symbol it uses (for instance an image read from a
+  file) is not, so turn this off or call it with zero and then the old
+  value to clear the cache.
+*/
+void fltk::set_text_layout_cache(int n) {
+  max_layouts = n;
+  while (layout_count > (n > 0 ? n : 0)) remove_last_layout();
+}
+
 /*!
   This is the fancy string-drawing function that is used to draw all
   labels in fltk. The string is formatted and aligned inside the
@@ -548,13 +706,23 @@ static float split(
   - Splits it at every \\t tab character and uses column_widths() to
     set each section into a column.
 */
+static bool draw_layout(void (*)(const char*,int,float,float),
+			const Rectangle&, Flags, int);
+
+// Used instead of drawtext_transformed when a DisplayList is recording:
+static void record_text(const char* s, int n, float x, float y) {
+  fl_display_list->text(s, n, x, y);
+  drawtext_transformed(s, n, x, y);
+}
+
 void fltk::drawtext(const char* str, const Rectangle& r1, Flags flags)
 {
   if (!str || !*str) return; // speeds up very common widgets
   Rectangle r; transform(r1,r);
   push_matrix();
   load_identity();
-  drawtext(drawtext_transformed, getwidth, str, r, flags);
+  drawtext(fl_display_list ? record_text : drawtext_transformed,
+	   getwidth, str, r, flags);
   pop_matrix();
   setfont(normal_font, normal_size);
   setcolor(normal_color);
@@ -582,6 +750,15 @@ void fltk::drawtext(void (*textfunction)(const char*,int,float,float),
   bgboxcolor = 0;
   normal_color = getcolor();
   int h = int(split(str, r.w(), flags, getwidth)+.5);
+  draw_layout(textfunction, r, flags, h);
+}
+
+// Draw the segments left by split() into r, h is the height it returned.
+// Returns true if any of them are symbols:
+static bool draw_layout(void (*textfunction)(const char*,int,float,float),
+			const Rectangle& r, Flags flags, int h)
+{
+  bool symbols = false;
   int dy;
   if (flags & ALIGN_BOTTOM) {
     dy = r.b()-h;
@@ -621,6 +798,7 @@ void fltk::drawtext(void (*textfunction)(const char*,int,float,float),
 	  push_clip(xx, r.y(), r.w(), r.h());
       }
       if (s.symbol) {
+	symbols = true;
 	Symbol::text(s.start,s.end-s.start);
 	s.symbol->draw(Rectangle(int(s.x)+r.x(), int(s.y+dy), int(s.w), int(s.h)));
       } else {
@@ -632,6 +810,7 @@ void fltk::drawtext(void (*textfunction)(const char*,int,float,float),
     for (h = 0; h < segment_count; h++) {
       Segment& s = segments[h];
       if (s.symbol) {
+	symbols = true;
 	Symbol::text(s.start,s.end-s.start);
 	s.symbol->draw(Rectangle(int(s.x)+r.x(), int(s.y+dy), int(s.w), int(s.h)));
       } else {
@@ -640,6 +819,46 @@ void fltk::drawtext(void (*textfunction)(const char*,int,float,float),
     }
   }
   Symbol::text("",0);
+  return symbols;
+}
+
+// Used by EngravedLabel to draw str several times from one layout.
+// data is dx, dy, color triples ending with a zero color. The text is
+// drawn moved by each of them in that color with INACTIVE_R turned on,
+// then drawn normally moved by the dx, dy of the last triple.
+void fl_drawtext_passes(const char* str, const Rectangle& r1, Flags flags,
+			const int* data)
+{
+  if (!str || !*str) return;
+  void (*textfunction)(const char*,int,float,float) =
+    fl_display_list ? record_text : drawtext_transformed;
+  Color saved_color = getcolor();
+  Flags saved_flags = drawflags();
+  setdrawflags(saved_flags|INACTIVE_R);
+  int h = -1;
+  for (;; data += 3) {
+    Color color = Color(data[2]);
+    if (!color) {
+      setdrawflags(saved_flags);
+      color = saved_color;
+    }
+    Rectangle moved(r1); moved.move(data[0], data[1]);
+    Rectangle r; transform(moved, r);
+    push_matrix();
+    load_identity();
+    setcolor(color);
+    normal_color = color;
+    if (h < 0) {
+      // a symbol may have drawn other text over the layout:
+      bgboxcolor = 0;
+      h = int(split(str, r.w(), flags, getwidth)+.5);
+    }
+    if (draw_layout(textfunction, r, flags, h)) h = -1;
+    pop_matrix();
+    if (!data[2]) break;
+  }
+  setfont(normal_font, normal_size);
+  setcolor(normal_color);
 }
 
 /**
@@ -0,0 +1,377 @@
+//
+// "$Id$"
+//
+// Directory index for filename completion for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// The names in the last few directories the user typed a path into,
+// sorted so the ones starting with a prefix can be found with a binary
+// search. FileChooser uses this so completing a filename and checking
+// whether it exists does not read the directory or stat() the file on
+// every keystroke, which is very slow on network filesystems.
+//
+// A directory is read by the ThreadPool, and until it is done the
+// callers fall back to asking the filesystem. It is read again after
+// it changes, which is found out by inotify on Linux and kqueue on the
+// BSDs and OS/X, or otherwise by the directory's modification time.
+//
+// All of these functions must be called by the main thread.
+
+#include <config.h>
+#include <fltk/filename.h>
+#include <fltk/string.h>
+#include <fltk/run.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if HAVE_PTHREAD
+# include <fltk/Threads.h>
+#endif
+#if HAVE_INOTIFY
+# include <sys/inotify.h>
+# include <unistd.h>
+#elif HAVE_KQUEUE
+# include <sys/event.h>
+# include <sys/time.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+using namespace fltk;
+
+#if (defined(_WIN32) && !defined(__CYGWIN__)) || defined(__EMX__)
+# define index_sort fltk::casealphasort
+# define index_ncmp strncasecmp
+#else
+# define index_sort fltk::alphasort
+# define index_ncmp strncmp
+#endif
+
+enum {
+  INDEXES = 8,		// how many directories are remembered
+  MTIME_CHECK = 1	// seconds between mtime checks without notification
+};
+
+struct IndexJob;
+
+struct DirIndex {
+  char* directory;	// null if this slot is unused
+  char** names;		// sorted in the order index_sort() puts them
+  unsigned char* isdir;
+  int n;
+  bool ready;		// names is filled in and up to date
+  IndexJob* job;	// the read that is still going on
+  unsigned long used;	// for throwing out the least recently used one
+#if HAVE_INOTIFY
+  int watch;
+#elif HAVE_KQUEUE
+  int fd;
+#else
+  long mtime;
+  double checked;
+#endif
+};
+
+// The read of one directory, done by a ThreadPool thread:
+struct IndexJob {
+  DirIndex* index;	// null if the slot was reused before it finished
+  char* directory;
+  char** names;
+  unsigned char* isdir;
+  int n;
+  bool changed;		// it changed while being read
+#if !HAVE_INOTIFY && !HAVE_KQUEUE
+  long mtime;
+#endif
+};
+
+static DirIndex indexes[INDEXES];
+static unsigned long use_count;
+
+#if HAVE_INOTIFY
+static int notify_fd = -2; // -1 if inotify does not work
+#elif HAVE_KQUEUE
+static int notify_fd = -2;
+#endif
+
+static void read_job(void* arg) {
+  IndexJob* j = (IndexJob*)arg;
+#if !HAVE_INOTIFY && !HAVE_KQUEUE
+  j->mtime = filename_mtime(j->directory);
+#endif
+  dirent** list;
+  int n = filename_list(j->directory, &list, index_sort);
+  if (n <= 0) {
+    if (!n) free(list);
+    return;
+  }
+  j->names = (char**)malloc(n*sizeof(char*));
+  j->isdir = (unsigned char*)malloc(n);
+  char path[4096];
+  size_t len = strlen(j->directory);
+  for (int i = 0; i < n; i++) {
+    dirent* d = list[i];
+    j->names[i] = strdup(d->d_name);
+    // The d_type readdir() fills in is used if the system has it, so
+    // only symbolic links and unknown types need a stat():
+    int type = -1;
+#ifdef DT_DIR
+    if (d->d_type == DT_DIR) type = 1;
+    else if (d->d_type != DT_UNKNOWN && d->d_type != DT_LNK) type = 0;
+#endif
+    if (type < 0) {
+      snprintf(path, sizeof(path), "%s%s%s", j->directory,
+	       len && j->directory[len-1] == '/' ? "" : "/", d->d_name);
+      type = filename_isdir(path);
+    }
+    j->isdir[i] = (unsigned char)type;
+    free(d);
+  }
+  free(list);
+  j->n = n;
+}
+
+static void free_names(char** names, unsigned char* isdir, int n) {
+  for (int i = 0; i < n; i++) free(names[i]);
+  free(names);
+  free(isdir);
+}
+
+static void job_done(void* arg) {
+  IndexJob* j = (IndexJob*)arg;
+  DirIndex* x = j->index;
+  if (x) {
+    free_names(x->names, x->isdir, x->n);
+    x->names = j->names;
+    x->isdir = j->isdir;
+    x->n = j->n;
+    x->job = 0;
+    x->ready = !j->changed;
+#if !HAVE_INOTIFY && !HAVE_KQUEUE
+    x->mtime = j->mtime;
+    x->checked = get_time_secs();
+#endif
+  } else {
+    free_names(j->names, j->isdir, j->n);
+  }
+  free(j->directory);
+  delete j;
+}
+
+// Start reading the directory again:
+static void start_read(DirIndex* x) {
+  x->ready = false;
+  if (x->job) return;
+  IndexJob* j = new IndexJob;
+  memset(j, 0, sizeof(*j));
+  j->index = x;
+  j->directory = strdup(x->directory);
+  x->job = j;
+#if HAVE_PTHREAD
+  ThreadPool::shared()->add(read_job, j, ThreadPool::HIGH, job_done);
+#else
+  read_job(j);
+  job_done(j);
+#endif
+}
+
+// Start watching the directory for changes, before it is read so that
+// none are missed:
+static void watch(DirIndex* x) {
+#if HAVE_INOTIFY
+  if (notify_fd == -2) notify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+  x->watch = notify_fd < 0 ? -1 :
+    inotify_add_watch(notify_fd, x->directory,
+		      IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|
+		      IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR);
+#elif HAVE_KQUEUE
+  if (notify_fd == -2) notify_fd = kqueue();
+  x->fd = -1;
+  if (notify_fd < 0) return;
+# ifdef O_EVTONLY
+  x->fd = open(x->directory, O_EVTONLY);
+# else
+  x->fd = open(x->directory, O_RDONLY);
+# endif
+  if (x->fd < 0) return;
+  struct kevent change;
+  EV_SET(&change, x->fd, EVFILT_VNODE, EV_ADD|EV_CLEAR,
+	 NOTE_WRITE|NOTE_DELETE|NOTE_RENAME, 0, 0);
+  if (kevent(notify_fd, &change, 1, 0, 0, 0) < 0) {close(x->fd); x->fd = -1;}
+#else
+  x->mtime = 0;
+  x->checked = 0;
+#endif
+}
+
+static void unwatch(DirIndex* x) {
+#if HAVE_INOTIFY
+  // other slots may have gotten the same watch for the same directory:
+  if (x->watch < 0) return;
+  for (int i = 0; i < INDEXES; i++)
+    if (indexes+i != x && indexes[i].directory && indexes[i].watch == x->watch)
+      return;
+  inotify_rm_watch(notify_fd, x->watch);
+#elif HAVE_KQUEUE
+  if (x->fd >= 0) close(x->fd); // this removes the kevent
+#endif
+}
+
+// The directory must be read again. If it is being read now that may
+// have missed the change, so that is not used either:
+static void changed(DirIndex* x) {
+  x->ready = false;
+  if (x->job) x->job->changed = true;
+}
+
+// Find out which directories have changed:
+static void check_changes() {
+#if HAVE_INOTIFY
+  if (notify_fd < 0) return;
+  char buffer[4096];
+  for (;;) {
+    ssize_t n = read(notify_fd, buffer, sizeof(buffer));
+    if (n <= 0) break;
+    for (char* p = buffer; p < buffer+n; ) {
+      inotify_event* e = (inotify_event*)p;
+      for (int i = 0; i < INDEXES; i++)
+	if (indexes[i].directory &&
+	    (indexes[i].watch == e->wd || (e->mask & IN_Q_OVERFLOW)))
+	  changed(indexes+i);
+      p += sizeof(inotify_event)+e->len;
+    }
+  }
+#elif HAVE_KQUEUE
+  if (notify_fd < 0) return;
+  struct kevent events[16];
+  struct timespec zero = {0, 0};
+  for (;;) {
+    int n = kevent(notify_fd, 0, 0, events, 16, &zero);
+    if (n <= 0) break;
+    for (int k = 0; k < n; k++)
+      for (int i = 0; i < INDEXES; i++)
+	if (indexes[i].directory && indexes[i].fd == (int)events[k].ident)
+	  changed(indexes+i);
+  }
+#else
+  double now = get_time_secs();
+  for (int i = 0; i < INDEXES; i++) {
+    DirIndex* x = indexes+i;
+    if (!x->ready || now-x->checked < MTIME_CHECK) continue;
+    x->checked = now;
+    if (filename_mtime(x->directory) != x->mtime) changed(x);
+  }
+#endif
+}
+
+// Return the index of the directory, starting it if it is not there:
+static DirIndex* find(const char* directory) {
+  check_changes();
+  DirIndex* x = 0;
+  for (int i = 0; i < INDEXES; i++) {
+    DirIndex* y = indexes+i;
+    if (y->directory && !strcmp(y->directory, directory)) {x = y; break;}
+  }
+  if (!x) {
+    // reuse the least recently used slot:
+    x = indexes;
+    for (int i = 1; i < INDEXES && x->directory; i++)
+      if (!indexes[i].directory || indexes[i].used < x->used) x = indexes+i;
+    if (x->directory) {
+      unwatch(x);
+      if (x->job) x->job->index = 0;
+      free_names(x->names, x->isdir, x->n);
+      free(x->directory);
+      memset(x, 0, sizeof(*x));
+    }
+    x->directory = strdup(directory);
+    watch(x);
+  }
+  x->used = ++use_count;
+  if (!x->ready) start_read(x);
+  return x;
+}
+
+// Return the first name in x starting with prefix, or x->n if none:
+static int lower_bound(const DirIndex* x, const char* prefix, size_t len) {
+  int a = 0, b = x->n;
+  while (a < b) {
+    int c = (a+b)/2;
+    if (index_ncmp(x->names[c], prefix, len) < 0) a = c+1; else b = c;
+  }
+  return a;
+}
+
+// Start reading directory into the index if it is not there already,
+// so the next fl_filename_complete() of it does not have to wait:
+void fl_index_directory(const char* directory) {
+  find(directory);
+}
+
+// Find the names in directory starting with prefix that accept() is
+// true for (all of them if it is null). The longest string they all
+// start with is put into match. Returns how many there are, or -1 if
+// the directory has not been read yet (it is started, so asking again
+// later may work):
+int fl_filename_complete(const char* directory, const char* prefix,
+			 char* match, int size,
+			 bool (*accept)(const char* name, bool isdir, void*),
+			 void* data) {
+  DirIndex* x = find(directory);
+  if (!x->ready) return -1;
+  size_t len = strlen(prefix);
+  int count = 0;
+  for (int i = lower_bound(x, prefix, len);
+       i < x->n && !index_ncmp(x->names[i], prefix, len); i++) {
+    const char* name = x->names[i];
+    if (accept && !accept(name, x->isdir[i] != 0, data)) continue;
+    if (!count++) {
+      strlcpy(match, name, size);
+    } else {
+      // shorten it to what this one also starts with:
+      size_t j = len;
+      while (match[j] && !index_ncmp(match+j, name+j, 1)) j++;
+      match[j] = 0;
+    }
+  }
+  return count;
+}
+
+// Return 1 if name is a directory in directory, 0 if it is some other
+// file, -1 if it does not exist, or -2 if the directory has not been
+// read yet:
+int fl_filename_type(const char* directory, const char* name) {
+  DirIndex* x = find(directory);
+  if (!x->ready) return -2;
+  size_t len = strlen(name);
+  int a = lower_bound(x, name, len+1);
+  if (a < x->n && !index_ncmp(x->names[a], name, len+1)) return x->isdir[a];
+  return -1;
+}
+
+//
+// End of "$Id$".
+//
@@ -33,9 +33,13 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <fltk/string.h>
 #include <fltk/utf.h>
 #include <fltk/filename.h>
+#if HAVE_PTHREAD
+# include <fltk/Threads.h>
+#endif
 
 #if ! HAVE_SCANDIR
 extern "C" {
@@ -53,8 +57,193 @@ int fltk::casealphasort(const dirent*const*a, const dirent*const*b) {
   return strcasecmp((*a)->d_name, (*b)->d_name);
 }
 
+////////////////////////////////////////////////////////////////
+// The sort functions fltk provides are done by making a key for each
+// name once, so that comparing two keys with memcmp() gives the same
+// answer as the function. This avoids parsing the numbers and folding
+// the case again on every comparison.
+//
+// A run of digits becomes a marker byte, its length without leading
+// zeros, and the digits. Digits only ever compare against other
+// digits or against non-digits, which are all below or all above the
+// marker, so this orders them the way numericsort() does.
+// numericsort() compares signed chars, so the case-sensitive keys flip
+// the top bit of every byte and end with a flipped nul.
+
+enum {ALPHA, CASEALPHA, NUMERIC, CASENUMERIC};
+
+// Write the key for name into out and return its length, or just
+// return the length if out is null:
+static int make_key(const char* name, int mode, unsigned char* out) {
+  const unsigned char* p = (const unsigned char*)name;
+  const unsigned char flip = mode == NUMERIC ? 0x80 : 0;
+  int n = 0;
+  for (;;) {
+    unsigned char c = *p;
+    if (mode >= NUMERIC && isdigit(c)) {
+      while (*p == '0') p++;
+      const unsigned char* q = p;
+      while (isdigit(*q)) q++;
+      unsigned len = unsigned(q-p);
+      if (out) {
+	out[n] = (unsigned char)('0'^flip);
+	if (len < 255) {
+	  out[n+1] = (unsigned char)len;
+	} else {
+	  out[n+1] = 255;
+	  out[n+2] = (unsigned char)(len>>24); out[n+3] = (unsigned char)(len>>16);
+	  out[n+4] = (unsigned char)(len>>8); out[n+5] = (unsigned char)len;
+	}
+	memcpy(out+n+(len < 255 ? 2 : 6), p, len);
+      }
+      n += (len < 255 ? 2 : 6)+len;
+      p = q;
+      continue;
+    }
+    if (!c) break;
+    if (out) {
+      if (mode == CASEALPHA || mode == CASENUMERIC) c = (unsigned char)tolower(c);
+      out[n] = c^flip;
+    }
+    n++; p++;
+  }
+  if (flip) {if (out) out[n] = flip; n++;}
+  return n;
+}
+
+struct SortKey {
+  const unsigned char* key;
+  int n;
+  dirent* d;
+};
+
+static inline bool key_less(const SortKey& a, const SortKey& b) {
+  int c = memcmp(a.key, b.key, a.n < b.n ? a.n : b.n);
+  return c ? c < 0 : a.n < b.n;
+}
+
+// Stable merge of a[0..m) and a[m..n) through tmp:
+static void merge(SortKey* a, SortKey* tmp, int m, int n) {
+  if (!key_less(a[m], a[m-1])) return; // already in order
+  memcpy(tmp, a, m*sizeof(SortKey));
+  int i = 0, j = m, k = 0;
+  while (i < m && j < n) a[k++] = key_less(a[j], tmp[i]) ? a[j++] : tmp[i++];
+  while (i < m) a[k++] = tmp[i++];
+}
+
+static void merge_sort(SortKey* a, SortKey* tmp, int n) {
+  if (n < 16) {
+    for (int i = 1; i < n; i++) {
+      SortKey k = a[i];
+      int j = i;
+      for (; j > 0 && key_less(k, a[j-1]); j--) a[j] = a[j-1];
+      a[j] = k;
+    }
+    return;
+  }
+  int m = n/2;
+  merge_sort(a, tmp, m);
+  merge_sort(a+m, tmp, n-m);
+  merge(a, tmp, m, n);
+}
+
+#if HAVE_PTHREAD
+// Directories at least this big are sorted in pieces by the ThreadPool:
+enum {PARALLEL_SORT = 16384, MAX_PIECES = 8};
+
+struct SortPiece {
+  SortKey* a;
+  SortKey* tmp;
+  int n;
+};
+
+static void sort_piece(void* data) {
+  SortPiece* p = (SortPiece*)data;
+  merge_sort(p->a, p->tmp, p->n);
+}
+#endif
+
+static void sort_keys(SortKey* a, int n) {
+  SortKey* tmp = new SortKey[n];
+#if HAVE_PTHREAD
+  int pieces = 1;
+  if (n >= PARALLEL_SORT) {
+    pieces = fltk::ThreadPool::shared()->threads()+1;
+    if (pieces > MAX_PIECES) pieces = MAX_PIECES;
+  }
+  if (pieces > 1) {
+    SortPiece piece[MAX_PIECES];
+    fltk::ThreadPool::TaskId task[MAX_PIECES];
+    int size = (n+pieces-1)/pieces;
+    for (int i = 0; i < pieces; i++) {
+      piece[i].a = a+i*size;
+      piece[i].tmp = tmp+i*size;
+      piece[i].n = i < pieces-1 ? size : n-i*size;
+    }
+    for (int i = 1; i < pieces; i++)
+      task[i] = fltk::ThreadPool::shared()->add(sort_piece, &piece[i],
+						fltk::ThreadPool::HIGH);
+    sort_piece(&piece[0]);
+    // this does any piece no thread has started:
+    for (int i = 1; i < pieces; i++) fltk::ThreadPool::shared()->wait(task[i]);
+    // merge the sorted pieces together:
+    for (int w = size; w < n; w *= 2)
+      for (int i = 0; i+w < n; i += 2*w)
+	merge(a+i, tmp, w, i+2*w < n ? 2*w : n-i);
+    delete[] tmp;
+    return;
+  }
+#endif
+  merge_sort(a, tmp, n);
+  delete[] tmp;
+}
+
+// Sort the list with one of fltk's sort functions:
+static void sort_list(dirent** list, int n, int mode) {
+  SortKey* keys = new SortKey[n];
+  unsigned char* buffer = 0;
+  if (mode == ALPHA) {
+    // the name is the key:
+    for (int i = 0; i < n; i++) {
+      keys[i].key = (const unsigned char*)list[i]->d_name;
+      keys[i].n = int(strlen(list[i]->d_name));
+      keys[i].d = list[i];
+    }
+  } else {
+    size_t total = 0;
+    for (int i = 0; i < n; i++) {
+      keys[i].n = make_key(list[i]->d_name, mode, 0);
+      total += keys[i].n;
+    }
+    buffer = new unsigned char[total ? total : 1];
+    unsigned char* p = buffer;
+    for (int i = 0; i < n; i++) {
+      make_key(list[i]->d_name, mode, p);
+      keys[i].key = p;
+      keys[i].d = list[i];
+      p += keys[i].n;
+    }
+  }
+  sort_keys(keys, n);
+  for (int i = 0; i < n; i++) list[i] = keys[i].d;
+  delete[] buffer;
+  delete[] keys;
+}
+
 int fltk::filename_list(const char *d, dirent ***list,
                      FileSortF *sort) {
+  // fltk's own sort functions are done afterwards with sort keys:
+  int mode = -1;
+  if (sort == fltk::numericsort) mode = NUMERIC;
+  else if (sort == fltk::casenumericsort) mode = CASENUMERIC;
+  else if (sort == fltk::alphasort) mode = ALPHA;
+  else if (sort == fltk::casealphasort) mode = CASEALPHA;
+  if (mode >= 0) {
+    int n = filename_list(d, list, (FileSortF*)0);
+    if (n > 1) sort_list(*list, n, mode);
+    return n;
+  }
+
   // Nobody defines the comparison function prototype correctly!
   // It should be "const dirent* const*". I don't seem to be able to
   // do this even for our own internal version because some compilers
@@ -22,6 +22,8 @@
 /* Adapted from Rich Salz. */
 #include <fltk/filename.h>
 #include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define CASE_INSENSITIVE 1
 
@@ -124,4 +126,226 @@ bool fltk::filename_match(const char *s, const char *p) {
   }
 }
 
+////////////////////////////////////////////////////////////////
+
+/*! \class fltk::FilenamePatterns
+
+  Tests a name against many filename_match() patterns at once, such as
+  the patterns of every FileIcon. match() returns the first pattern
+  that matches, the same as calling filename_match() with each one in
+  the order they were added, but patterns that are a '*' and a literal
+  suffix starting with '.' ("*.png"), or a literal name, are found with
+  a hash table. One set of alternatives is allowed in these, so both
+  "*.{jpg|jpeg}" and "{*.jpg|*.JPG}" are two hash table entries. Only
+  the other patterns are tried one at a time.
+*/
+
+namespace fltk {
+struct FilenamePatternKey {
+  FilenamePatternKey* next;
+  unsigned hash;
+  int n;
+  int index;	// which pattern this is from
+  bool suffix;	// true for a "*key" pattern
+  char text[1];	// n bytes as they are in the pattern
+};
+}
+
+using namespace fltk;
+
+static inline unsigned lower(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a'-'A') : (unsigned char)c;
+}
+
+// Hash of the lowercase text taken backwards, so match() can make the
+// hash of each suffix of a name as it goes:
+static unsigned hash_text(const char* text, int n) {
+  unsigned h = 2166136261U;
+  for (int i = n; i-- > 0;) h = (h ^ lower(text[i])) * 16777619U;
+  return h;
+}
+
+// Same test filename_match() does for non-special pattern characters:
+static bool same_text(const char* s, const char* p, int n) {
+  for (int i = 0; i < n; i++) {
+#if CASE_INSENSITIVE
+    if (s[i] != p[i] && lower(s[i]) != (unsigned char)p[i]) return false;
+#else
+    if (s[i] != p[i]) return false;
+#endif
+  }
+  return true;
+}
+
+static bool is_literal(char c) {
+  switch (c) {
+  case '*': case '?': case '[': case ']': case '\\':
+  case '{': case '}': case '|': case ',': case 0:
+    return false;
+  }
+  return true;
+}
+
+FilenamePatterns::FilenamePatterns() {
+  patterns_ = 0;
+  count_ = size_ = 0;
+  buckets_ = 0;
+  nbuckets_ = nkeys_ = 0;
+  rest_ = 0;
+  nrest_ = 0;
+}
+
+FilenamePatterns::~FilenamePatterns() {
+  clear();
+}
+
+/*! Forget all the patterns. */
+void FilenamePatterns::clear() {
+  for (unsigned b = 0; b < nbuckets_; b++) {
+    for (FilenamePatternKey* k = buckets_[b]; k;) {
+      FilenamePatternKey* next = k->next;
+      free(k);
+      k = next;
+    }
+  }
+  free(buckets_);
+  buckets_ = 0;
+  nbuckets_ = nkeys_ = 0;
+  for (int i = 0; i < count_; i++) free(patterns_[i].text);
+  free(patterns_);
+  patterns_ = 0;
+  count_ = size_ = 0;
+  free(rest_);
+  rest_ = 0;
+  nrest_ = 0;
+}
+
+void FilenamePatterns::add_key(const char* key, int n, bool suffix, int index) {
+  if (nkeys_ >= nbuckets_) {
+    unsigned nb = nbuckets_ ? 2*nbuckets_ : 64;
+    FilenamePatternKey** b =
+      (FilenamePatternKey**)calloc(nb, sizeof(FilenamePatternKey*));
+    for (unsigned i = 0; i < nbuckets_; i++) {
+      for (FilenamePatternKey* k = buckets_[i]; k;) {
+	FilenamePatternKey* next = k->next;
+	FilenamePatternKey** p = &b[k->hash&(nb-1)];
+	k->next = *p;
+	*p = k;
+	k = next;
+      }
+    }
+    free(buckets_);
+    buckets_ = b;
+    nbuckets_ = nb;
+  }
+  FilenamePatternKey* k =
+    (FilenamePatternKey*)malloc(sizeof(FilenamePatternKey)+n);
+  k->hash = hash_text(key, n);
+  k->n = n;
+  k->index = index;
+  k->suffix = suffix;
+  memcpy(k->text, key, n);
+  k->text[n] = 0;
+  FilenamePatternKey** p = &buckets_[k->hash&(nbuckets_-1)];
+  k->next = *p;
+  *p = k;
+  nkeys_++;
+}
+
+/*!
+  Add a pattern that match() will test after all the ones added
+  before. \a mask is compared with the mask passed to match(), so a
+  caller can skip some of the patterns. Returns the number match()
+  returns for this pattern, which counts up from zero.
+*/
+int FilenamePatterns::add(const char* pattern, unsigned mask) {
+  if (count_ >= size_) {
+    size_ = size_ ? 2*size_ : 16;
+    patterns_ = (Pattern*)realloc(patterns_, size_*sizeof(Pattern));
+    rest_ = (int*)realloc(rest_, size_*sizeof(int));
+  }
+  int index = count_++;
+  patterns_[index].text = strdup(pattern);
+  patterns_[index].mask = mask;
+
+  // Find the {a|b|c} if there is one. Each alternative put in place of
+  // it must be an optional '*' and literal text:
+  const char* brace = 0;
+  const char* close = 0;
+  bool ok = true;
+  for (const char* q = pattern; *q && ok; q++) {
+    if (*q == '{' && !brace) {
+      brace = q;
+      for (q++; *q != '}'; q++)
+	if (!*q || *q == '{' || *q == '[' || *q == '\\') {ok = false; break;}
+      close = q;
+    } else if (*q == '*' && q == pattern) {
+    } else if (!is_literal(*q)) {
+      ok = false;
+    }
+  }
+  char* key = (char*)malloc(strlen(pattern)+1);
+  // every key must be able to go in the hash table, or none are added:
+  for (int pass = 0; ok && pass < 2; pass++) {
+    const char* a = brace ? brace+1 : pattern;
+    for (;;) {
+      const char* b = brace ? a : a+strlen(a);
+      if (brace) while (b < close && *b != '|' && *b != ',') b++;
+      int n = 0;
+      if (brace) {memcpy(key, pattern, brace-pattern); n = int(brace-pattern);}
+      memcpy(key+n, a, b-a); n += int(b-a);
+      if (brace) {strcpy(key+n, close+1); n += int(strlen(close+1));}
+      key[n] = 0;
+      bool suffix = (key[0] == '*');
+      const char* k = suffix ? key+1 : key;
+      int kn = suffix ? n-1 : n;
+      if (!pass) {
+	if (!kn || (suffix && *k != '.')) {ok = false; break;}
+	for (int i = 0; i < kn; i++)
+	  if (!is_literal(k[i])) {ok = false; break;}
+	if (!ok) break;
+      } else {
+	add_key(k, kn, suffix, index);
+      }
+      if (!brace || b >= close) break;
+      a = b+1;
+    }
+  }
+  free(key);
+  if (!ok) rest_[nrest_++] = index;
+  return index;
+}
+
+/*!
+  Return the number add() returned for the first pattern that \a name
+  matches, ignoring ones whose mask has no bits in common with \a mask.
+  Returns -1 if none match.
+*/
+int FilenamePatterns::match(const char* name, unsigned mask) const {
+  int best = -1;
+  if (nkeys_) {
+    int n = int(strlen(name));
+    unsigned h = 2166136261U;
+    for (int i = n; i-- > 0;) {
+      h = (h ^ lower(name[i])) * 16777619U;
+      // suffixes start with '.', and the whole name is also looked up:
+      if (name[i] != '.' && i) continue;
+      for (FilenamePatternKey* k = buckets_[h&(nbuckets_-1)]; k; k = k->next) {
+	if (k->hash != h || k->n != n-i || (!k->suffix && i)) continue;
+	if (best >= 0 && k->index > best) continue;
+	if (!(patterns_[k->index].mask & mask)) continue;
+	if (same_text(name+i, k->text, k->n)) best = k->index;
+      }
+    }
+  }
+  for (int j = 0; j < nrest_; j++) {
+    int index = rest_[j];
+    if (best >= 0 && index > best) break;
+    if ((patterns_[index].mask & mask) &&
+	filename_match(name, patterns_[index].text))
+      return index;
+  }
+  return best;
+}
+
 // End of "$Id$".
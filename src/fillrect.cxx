@@ -30,12 +30,27 @@
 #include <fltk/draw.h>
 #include <fltk/x.h>
 #include <fltk/math.h>
+#include "DisplayList.h"
 using namespace fltk;
 
+#if defined(_WIN32) && !USE_CAIRO
+// in win32/direct2d.cxx:
+extern bool fl_d2d_fillrect(int x, int y, int w, int h);
+extern void fl_d2d_flush();
+#endif
+
+// On X11 these do not need to be saved up and sent together: Xlib
+// appends an XFillRectangle, XDrawLine or XDrawPoint to the previous
+// request if it is the same kind with the same drawable and gc, so a
+// run of them in one color already goes to the server as a single
+// PolyFillRectangle, PolySegment or PolyPoint. setcolor() to the color
+// already in the gc does not send anything and does not end the run.
+
 /*! Fill the rectangle with the current color. */
 void fltk::fillrect(int x, int y, int w, int h) {
   if (getcolor() < 0) return; 
   if (w <= 0 || h <= 0) return;
+  if (fl_display_list) fl_display_list->fillrect(x,y,w,h);
   transform(x,y,w,h);
 #if USE_CAIRO
   cairo_rectangle(cr,x,y,w,h);
@@ -43,6 +58,7 @@ void fltk::fillrect(int x, int y, int w, int h) {
 #elif USE_X11
   if (w && h) XFillRectangle(xdisplay, xwindow, gc, x, y, w, h);
 #elif defined(_WIN32)
+  if (fl_d2d_fillrect(x, y, w, h)) return;
   RECT rect;
   rect.left = x; rect.top = y;  
   rect.right = x+w; rect.bottom = y+h;
@@ -64,6 +80,7 @@ void fltk::fillrect(int x, int y, int w, int h) {
 */
 void fltk::strokerect(int x, int y, int w, int h) {
   if (w <= 0 || h <= 0) return;
+  if (fl_display_list) fl_display_list->strokerect(x,y,w,h);
   transform(x,y,w,h);
 #if USE_CAIRO
   cairo_rectangle(cr,x+.5,y+.5,w-1,h-1);
@@ -106,6 +123,7 @@ void fltk::strokerect(int x, int y, int w, int h) {
   integer translation or if the line is not horizontal or vertical.
 */
 void fltk::drawline(int x, int y, int x1, int y1) {
+  if (fl_display_list) fl_display_list->drawline(x,y,x1,y1);
   transform(x,y);
   transform(x1,y1);
 #if USE_CAIRO
@@ -145,6 +163,7 @@ void fltk::drawline(int x, int y, int x1, int y1) {
 
 /*! Draw a straight line between the two points. */
 void fltk::drawline(float x, float y, float x1, float y1) {
+  if (fl_display_list) fl_display_list->drawline(x,y,x1,y1);
   transform(x,y);
   transform(x1,y1);
 #if USE_CAIRO
@@ -184,6 +203,15 @@ void fltk::drawline(float x, float y, float x1, float y1) {
   this is a dot drawn with the current pen and line caps.
 */
 void fltk::drawpoint(int x, int y) {
+  if (fl_display_list) {
+    // record it once, not again for the fillrect() or drawline() used:
+    DisplayList* d = fl_display_list;
+    d->drawpoint(x,y);
+    fl_display_list = 0;
+    drawpoint(x,y);
+    fl_display_list = d;
+    return;
+  }
   if (!line_width_) {
   transform(x,y);
 #if USE_CAIRO
@@ -191,6 +219,7 @@ void fltk::drawpoint(int x, int y) {
 #elif USE_X11
   XDrawPoint(xdisplay, xwindow, gc, x, y);
 #elif defined(_WIN32)
+  fl_d2d_flush();
   SetPixel(dc, x, y, current_xpixel);
 #else
     fillrect(x,y,1,1);
@@ -207,6 +236,14 @@ void fltk::drawpoint(int x, int y) {
   draws nothing in some api's unless the line_style has CAP_ROUND).
 */
 void fltk::drawpoint(float X, float Y) {
+  if (fl_display_list) {
+    DisplayList* d = fl_display_list;
+    d->drawpoint(X,Y);
+    fl_display_list = 0;
+    drawpoint(X,Y);
+    fl_display_list = d;
+    return;
+  }
   if (!line_width_) {
   transform(X,Y); 
   int x = int(floorf(X)); int y = int(floorf(Y));
@@ -215,6 +252,7 @@ void fltk::drawpoint(float X, float Y) {
 #elif USE_X11
   XDrawPoint(xdisplay, xwindow, gc, x, y);
 # elif defined(_WIN32)
+  fl_d2d_flush();
   SetPixel(dc, x, y, current_xpixel);
 # else
     fillrect(x,y,1,1);
@@ -224,6 +262,238 @@ void fltk::drawpoint(float X, float Y) {
   }
 }
 
+////////////////////////////////////////////////////////////////
+// Drawing arrays of rectangles, lines and points:
+
+// Set the color for the run of elements starting at i that have the
+// same color, and return the index after it:
+static int color_run(const Color* colors, int i, int n) {
+  if (!colors) return n;
+  setcolor(colors[i]);
+  int j = i+1;
+  while (j < n && colors[j] == colors[i]) j++;
+  return j;
+}
+
+enum {CHUNK = 256}; // elements sent to the system at once
+
+static void fillrect_run(const Rectangle* r, int n) {
+  if (fl_display_list) {
+    for (int i = 0; i < n; i++) fillrect(r[i]);
+    return;
+  }
+#if USE_CAIRO
+  for (int i = 0; i < n; i++) {
+    int x = r[i].x(); int y = r[i].y(); int w = r[i].w(); int h = r[i].h();
+    if (w <= 0 || h <= 0) continue;
+    transform(x,y,w,h);
+    cairo_rectangle(cr,x,y,w,h);
+  }
+  cairo_fill(cr);
+#elif USE_X11
+  XRectangle buffer[CHUNK];
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    int x = r[i].x(); int y = r[i].y(); int w = r[i].w(); int h = r[i].h();
+    if (w <= 0 || h <= 0) continue;
+    transform(x,y,w,h);
+    if (!w || !h) continue;
+    buffer[k].x = x; buffer[k].y = y;
+    buffer[k].width = w; buffer[k].height = h;
+    if (++k == CHUNK) {XFillRectangles(xdisplay, xwindow, gc, buffer, k); k = 0;}
+  }
+  if (k) XFillRectangles(xdisplay, xwindow, gc, buffer, k);
+#elif defined(_WIN32)
+  SetBkColor(dc, current_xpixel);
+  for (int i = 0; i < n; i++) {
+    int x = r[i].x(); int y = r[i].y(); int w = r[i].w(); int h = r[i].h();
+    if (w <= 0 || h <= 0) continue;
+    transform(x,y,w,h);
+    if (fl_d2d_fillrect(x, y, w, h)) continue;
+    RECT rect;
+    rect.left = x; rect.top = y;
+    rect.right = x+w; rect.bottom = y+h;
+    ExtTextOut(dc, 0, 0, ETO_OPAQUE, &rect, NULL, 0, NULL);
+  }
+#elif USE_QUARTZ
+  if (!line_width_) CGContextSetShouldAntialias(quartz_gc, false);
+  CGRect buffer[CHUNK];
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    int x = r[i].x(); int y = r[i].y(); int w = r[i].w(); int h = r[i].h();
+    if (w <= 0 || h <= 0) continue;
+    transform(x,y,w,h);
+    buffer[k] = CGRectMake(x, y, w-1, h-1);
+    if (++k == CHUNK) {CGContextFillRects(quartz_gc, buffer, k); k = 0;}
+  }
+  if (k) CGContextFillRects(quartz_gc, buffer, k);
+  if (!line_width_) CGContextSetShouldAntialias(quartz_gc, true);
+#else
+# error
+#endif
+}
+
+/*!
+  Fill the \a n rectangles in \a r. If \a colors is not null then
+  rectangle i is filled with colors[i] and the current color is put
+  back afterwards, otherwise they are all the current color.
+
+  This draws the same as calling setcolor() and fillrect() for each
+  one, but each run of rectangles of the same color is given to the
+  system in as few calls as possible, which is much faster when
+  there are thousands of them.
+*/
+void fltk::fillrects(int n, const Rectangle* r, const Color* colors) {
+  Color saved = getcolor();
+  for (int i = 0; i < n;) {
+    int j = color_run(colors, i, n);
+    fillrect_run(r+i, j-i);
+    i = j;
+  }
+  if (colors) setcolor(saved);
+}
+
+static void drawline_run(const int v[][4], int n) {
+  if (fl_display_list) {
+    for (int i = 0; i < n; i++) drawline(v[i][0], v[i][1], v[i][2], v[i][3]);
+    return;
+  }
+#if USE_CAIRO
+  float d = line_width_ ? 0 : .5f;
+  for (int i = 0; i < n; i++) {
+    int x = v[i][0]; int y = v[i][1]; int x1 = v[i][2]; int y1 = v[i][3];
+    transform(x,y); transform(x1,y1);
+    cairo_move_to(cr, x+d, y+d);
+    cairo_line_to(cr, x1+d, y1+d);
+  }
+  cairo_stroke(cr);
+#elif USE_X11
+  XSegment buffer[CHUNK];
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    int x = v[i][0]; int y = v[i][1]; int x1 = v[i][2]; int y1 = v[i][3];
+    transform(x,y); transform(x1,y1);
+    buffer[k].x1 = x; buffer[k].y1 = y;
+    buffer[k].x2 = x1; buffer[k].y2 = y1;
+    if (++k == CHUNK) {XDrawSegments(xdisplay, xwindow, gc, buffer, k); k = 0;}
+  }
+  if (k) XDrawSegments(xdisplay, xwindow, gc, buffer, k);
+#elif defined(_WIN32)
+  setpen();
+  POINT buffer[2*CHUNK];
+  static DWORD counts[CHUNK];
+  if (!counts[0]) for (int i = 0; i < CHUNK; i++) counts[i] = 2;
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    int x = v[i][0]; int y = v[i][1]; int x1 = v[i][2]; int y1 = v[i][3];
+    transform(x,y); transform(x1,y1);
+    buffer[2*k].x = x; buffer[2*k].y = y;
+    buffer[2*k+1].x = x1; buffer[2*k+1].y = y1;
+    // add the end pixel like drawline() does:
+    if (!line_width_) SetPixel(dc, x1, y1, current_xpixel);
+    if (++k == CHUNK) {PolyPolyline(dc, buffer, counts, k); k = 0;}
+  }
+  if (k) PolyPolyline(dc, buffer, counts, k);
+#elif USE_QUARTZ
+  // like drawline(), only turn off antialiasing if every line is
+  // horizontal or vertical:
+  bool aa = true;
+  if (!line_width_) {
+    aa = false;
+    for (int i = 0; i < n; i++)
+      if (v[i][0] != v[i][2] && v[i][1] != v[i][3]) {aa = true; break;}
+    if (!aa) CGContextSetShouldAntialias(quartz_gc, false);
+  }
+  CGPoint buffer[2*CHUNK];
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    int x = v[i][0]; int y = v[i][1]; int x1 = v[i][2]; int y1 = v[i][3];
+    transform(x,y); transform(x1,y1);
+    buffer[2*k] = CGPointMake(x, y);
+    buffer[2*k+1] = CGPointMake(x1, y1);
+    if (++k == CHUNK) {CGContextStrokeLineSegments(quartz_gc, buffer, 2*k); k = 0;}
+  }
+  if (k) CGContextStrokeLineSegments(quartz_gc, buffer, 2*k);
+  if (!aa) CGContextSetShouldAntialias(quartz_gc, true);
+#else
+# error
+#endif
+}
+
+/*!
+  Draw \a n lines, where line i goes from v[i][0],v[i][1] to
+  v[i][2],v[i][3]. If \a colors is not null then line i is drawn
+  in colors[i] and the current color is put back afterwards.
+  Otherwise they are all the current color.
+
+  This draws the same as calling drawline() for each one, but runs
+  of lines of the same color are given to the system together.
+*/
+void fltk::drawlines(int n, const int v[][4], const Color* colors) {
+  Color saved = getcolor();
+  for (int i = 0; i < n;) {
+    int j = color_run(colors, i, n);
+    drawline_run(v+i, j-i);
+    i = j;
+  }
+  if (colors) setcolor(saved);
+}
+
+static void drawpoint_run(const int v[][2], int n) {
+  if (fl_display_list || line_width_) {
+    for (int i = 0; i < n; i++) drawpoint(v[i][0], v[i][1]);
+    return;
+  }
+#if USE_X11 && !USE_CAIRO
+  XPoint buffer[CHUNK];
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    int x = v[i][0]; int y = v[i][1];
+    transform(x,y);
+    buffer[k].x = x; buffer[k].y = y;
+    if (++k == CHUNK) {
+      XDrawPoints(xdisplay, xwindow, gc, buffer, k, CoordModeOrigin);
+      k = 0;
+    }
+  }
+  if (k) XDrawPoints(xdisplay, xwindow, gc, buffer, k, CoordModeOrigin);
+#elif defined(_WIN32) && !USE_CAIRO
+  fl_d2d_flush();
+  for (int i = 0; i < n; i++) {
+    int x = v[i][0]; int y = v[i][1];
+    transform(x,y);
+    SetPixel(dc, x, y, current_xpixel);
+  }
+#else
+  // a rectangle for each pixel, like drawpoint() does:
+  Rectangle buffer[CHUNK];
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    buffer[k].set(v[i][0], v[i][1], 1, 1);
+    if (++k == CHUNK) {fillrect_run(buffer, k); k = 0;}
+  }
+  if (k) fillrect_run(buffer, k);
+#endif
+}
+
+/*!
+  Draw \a n dots at the points in \a v. If \a colors is not null then
+  point i is drawn in colors[i] and the current color is put back
+  afterwards. Otherwise they are all the current color.
+
+  This draws the same as calling drawpoint() for each one, but runs
+  of points of the same color are given to the system together.
+*/
+void fltk::drawpoints(int n, const int v[][2], const Color* colors) {
+  Color saved = getcolor();
+  for (int i = 0; i < n;) {
+    int j = color_run(colors, i, n);
+    drawpoint_run(v+i, j-i);
+    i = j;
+  }
+  if (colors) setcolor(saved);
+}
+
 //
 // End of "$Id$".
 //
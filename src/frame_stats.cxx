@@ -0,0 +1,222 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Counts of the requests, round trips, image data and text sent to the
+// display for each frame, and a debugging mode that flashes every area
+// Window::flush() redraws. The counters are plain additions done where
+// the work happens, so they are always on. The flashed areas are put
+// back by redrawing them a moment later, and remembered per window with
+// an AssociationType so they go away when the window is destroyed.
+
+#include <config.h>
+#include <fltk/trace.h>
+#include <fltk/Window.h>
+#include <fltk/WidgetAssociation.h>
+#include <fltk/damage.h>
+#include <fltk/draw.h>
+#include <fltk/run.h>
+#include <fltk/x.h>
+#include <string.h>
+#include "DamageRects.h"
+using namespace fltk;
+
+/*! \fn bool fltk::flashing_redraws()
+  Returns true if flash_redraws() has been turned on.
+*/
+bool fltk::flashing_redraws_;
+
+/*!
+  The counts for the frame being drawn now. Code that sends things
+  to the display adds to these. They are moved to frame_stats() when
+  fltk::flush() finishes drawing.
+*/
+FrameStats fltk::frame_counts_;
+
+static FrameStats last_frame, total;
+#if USE_X11
+static unsigned long last_request;
+#endif
+
+// Called at the end of fltk::flush() if anything was drawn:
+void fl_end_frame() {
+#if USE_X11
+  unsigned long request = XNextRequest(xdisplay);
+  if (last_request) frame_counts_.requests = request-last_request;
+  last_request = request;
+#endif
+  frame_counts_.frames = 1;
+  last_frame = frame_counts_;
+  total.frames++;
+  total.windows += frame_counts_.windows;
+  total.requests += frame_counts_.requests;
+  total.round_trips += frame_counts_.round_trips;
+  total.image_bytes += frame_counts_.image_bytes;
+  total.glyphs += frame_counts_.glyphs;
+  memset(&frame_counts_, 0, sizeof(frame_counts_));
+}
+
+/*!
+  Return what was done to draw the most recent frame, which is the
+  last call to fltk::flush() that drew any windows. Everything sent
+  since the frame before is counted, including things done while
+  handling events. This can be used to find out which widgets cause a
+  flood of requests to the display, by watching this while they are
+  used.
+
+  The X requests are counted by the difference in XNextRequest(), so
+  they include ones made by Xlib, Xft and Cairo. The round trips are
+  only those fltk makes on purpose while drawing, such as waiting for
+  the server to finish with a shared memory image or reading back
+  pixels with readimage(). On other systems only the windows, image
+  bytes and glyphs are counted.
+*/
+const FrameStats& fltk::frame_stats() {return last_frame;}
+
+/*! Return the sum of all frames since clear_frame_stats(). */
+const FrameStats& fltk::frame_stats_total() {return total;}
+
+/*! Zero frame_stats_total(). */
+void fltk::clear_frame_stats() {
+  memset(&total, 0, sizeof(total));
+}
+
+////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct FlashEntry {
+  Window* window;
+  DamageRects rects;	// areas flashed and not put back yet
+  bool restoring;	// the next flush is the one putting them back
+  FlashEntry* next;
+  FlashEntry* prev;
+};
+
+FlashEntry* first_entry;
+
+class FlashAssociation : public AssociationType {
+public:
+  void destroy(void* data) const {
+    FlashEntry* e = (FlashEntry*)data;
+    if (e->prev) e->prev->next = e->next; else first_entry = e->next;
+    if (e->next) e->next->prev = e->prev;
+    delete e;
+  }
+};
+
+const FlashAssociation flash_association;
+
+}
+
+DamageRects* fl_flash_rects;
+
+static void restore_flash(void*) {
+  for (FlashEntry* e = first_entry; e; e = e->next) {
+    if (!e->rects.n) continue;
+    for (int i = 0; i < e->rects.n; i++) e->window->redraw(e->rects.rect[i]);
+    e->rects.n = 0;
+    e->restoring = true;
+  }
+}
+
+/*!
+  Turn on or off a debugging mode where every area of a window that
+  is redrawn is filled with a bright color right after it is drawn,
+  and then drawn again normally a tenth of a second later. Widgets
+  that are redrawn when nothing about them changed stand out, as do
+  ones that cause their whole window to be drawn. The color changes
+  each time so something redrawn over and over flickers. The redraw
+  that puts back the flashed areas is not itself flashed.
+
+  Setting FLTK_FLASH_REDRAWS in the environment turns this on when
+  the display is opened.
+*/
+void fltk::flash_redraws(bool on) {
+  if (on == flashing_redraws_) return;
+  flashing_redraws_ = on;
+  if (!on) {
+    restore_flash(0);
+    remove_timeout(restore_flash);
+  }
+}
+
+// Called by fl_window_flush() before it draws a window. Adds the areas
+// that will be drawn as a whole to rects, and Group::update_child()
+// adds each damaged widget to it while drawing. Returns false if this
+// is the redraw that erases the previous flash:
+bool fl_flash_begin(Window* window, DamageRects& rects) {
+  FlashEntry* e = (FlashEntry*)(window->get(flash_association));
+  if (e && e->restoring) {e->restoring = false; return false;}
+  if (window->damage() & ~(DAMAGE_CHILD|DAMAGE_EXPOSE)) {
+    rects.add(Rectangle(window->w(), window->h()));
+    return true;
+  }
+  CreatedWindow* x = CreatedWindow::find(window);
+  if (x && x->region) {
+#if USE_X11
+    XRectangle b;
+    XClipBox(x->region, &b);
+    rects.add(Rectangle(b.x, b.y, b.width, b.height));
+#elif defined(_WIN32)
+    RECT b;
+    GetRgnBox(x->region, &b);
+    rects.add(Rectangle(b.left, b.top, b.right-b.left, b.bottom-b.top));
+#elif USE_QUARTZ
+    Rect b;
+    GetRegionBounds(x->region, &b);
+    rects.add(Rectangle(b.left, b.top, b.right-b.left, b.bottom-b.top));
+#endif
+  }
+  return true;
+}
+
+// Called by fl_window_flush() after it draws a window, on the front buffer:
+void fl_flash_end(Window* window, const DamageRects& rects) {
+  if (!rects.n) return;
+  static const Color colors[] = {YELLOW, MAGENTA, CYAN};
+  static unsigned n;
+  FlashEntry* e = (FlashEntry*)(window->get(flash_association));
+  if (!e) {
+    e = new FlashEntry;
+    e->window = window;
+    e->restoring = false;
+    e->prev = 0;
+    e->next = first_entry;
+    if (first_entry) first_entry->prev = e;
+    first_entry = e;
+    window->set(flash_association, e);
+  }
+  window->make_current();
+  setcolor(colors[n++ % 3]);
+  for (int i = 0; i < rects.n; i++) {
+    fillrect(rects.rect[i]);
+    e->rects.add(rects.rect[i]);
+  }
+  if (!has_timeout(restore_flash)) add_timeout(.1f, restore_flash);
+}
+
+//
+// End of "$Id$".
+//
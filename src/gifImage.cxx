@@ -11,6 +11,11 @@
   To use data, pass a non-null pointer as the second argument to the
   constructor. The filename is ignored in this case, but the "guess image"
   code uses this to identify identical images and reuse them (nyi)
+
+  If the file is an animated gif, draw() shows the frames one after
+  another with the delays in the file, while the image keeps being
+  drawn. frames(), frame(n) and delay(n) can be used to show them
+  some other way, and animate(false) stops it.
 */
 
 // Extensively modified from original code for gif2ras by
@@ -46,6 +51,8 @@
 
 #include <config.h>
 #include <fltk/SharedImage.h>
+#include <fltk/Window.h>
+#include <fltk/run.h>
 #include <fltk/x.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -53,8 +60,61 @@
 
 using namespace fltk;
 
-#define NEXTBYTE (dat? *dat++ : getc(GifFile))
-#define GETSHORT(var) var = NEXTBYTE; var += NEXTBYTE << 8
+// Bytes come from the inline datas, a mapped file, or stdio:
+struct GifReader {
+  const uchar* dat;
+  const uchar* end;	// zero if the size of the datas is unknown
+  FILE* file;
+  int next() {
+    if (!dat) return getc(file);
+    if (end && dat >= end) return -1;
+    return *dat++;
+  }
+  int short_() {int a = next(); int b = next(); return a+(b<<8);}
+  void skip_blocks() {
+    for (;;) {
+      int n = next();
+      if (n <= 0) return;
+      while (n--) if (next() < 0) return;
+    }
+  }
+};
+
+// One image in the file. The pixels are the color indexes of just the
+// rectangle it covers, so the frames of an animation all share the
+// global colormap and cost a byte per changed pixel:
+struct GifFrame {
+  int x, y, w, h;
+  uchar* pixels;	// w*h indexes, top to bottom
+  U32* colormap;	// local colormap, or null to use the global one
+  int transparent;	// index that is not drawn, or -1
+  int disposal;		// what to do after it is shown
+  float delay;		// seconds to show it
+};
+
+enum {KEEP = 1, BACKGROUND = 2, PREVIOUS = 3}; // GifFrame::disposal
+
+struct fltk::GifAnimation {
+  int w, h;
+  U32 colormap[256];
+  GifFrame* frames;
+  int nframes;
+  int plays;		// times to play it, 0 for forever
+  U32* canvas;		// w*h pixels shown now
+  U32* saved;		// what a PREVIOUS frame covers, to put back
+  int frame;		// one being shown
+  int played;		// times the last frame has been shown
+  // the animation timer:
+  GifAnimation* next;
+  gifImage* image;
+  double time;		// when to show the next frame
+  bool running;
+  // where it was drawn since the last frame was shown:
+  const Window* window;
+  Rectangle area;
+  bool drawn;
+  bool many;		// in more than one window
+};
 
 /*! Tests block of data to see if it looks like the start of a .gif file. */
 bool gifImage::test(const uchar *datas, unsigned size)
@@ -62,262 +122,503 @@ bool gifImage::test(const uchar *datas, unsigned size)
   return !strncmp((char*) datas,"GIF", 3);
 }
 
-bool gifImage::fetch()
-{
-  const uchar* dat = datas;
-  FILE *GifFile=0;
+static void free_animation(GifAnimation* a) {
+  if (!a) return;
+  for (int i = 0; i < a->nframes; i++) {
+    delete[] a->frames[i].pixels;
+    delete[] a->frames[i].colormap;
+  }
+  free(a->frames);
+  delete[] a->canvas;
+  delete[] a->saved;
+  delete a;
+}
 
-  if (dat) {
-    dat += 6;
-  } else { // set up to read from file, quit silently on any errors:
-    GifFile=fopen(get_filename(), "rb");
-    if (!GifFile)
-      return false;
-    char b[6];
-    if (!GifFile || fread(b,1,6,GifFile) < 6 ||
-	b[0]!='G' || b[1]!='I' || b[2] != 'F') {
-      fclose(GifFile);
-      return false;
+////////////////////////////////////////////////////////////////
+// LZW decompression.
+//
+// The codes are taken from a bit buffer that is refilled a byte at a
+// time. Each string in the table is a place earlier in the output, as
+// a code is always the output of the previous code plus the first byte
+// of the next, so a code is written with one memcpy from there rather
+// than following Prefix links backwards onto a stack.
+
+static const unsigned short code_mask[13] = {
+  0, 1, 3, 7, 15, 31, 63, 127, 255, 511, 1023, 2047, 4095
+};
+
+// Decode n pixels to out in the order they are in the file. Returns
+// how many were decoded, missing ones at the end are left zero:
+static int decode_lzw(GifReader& in, int CodeSize, uchar* out, int n) {
+  if (CodeSize < 2 || CodeSize > 12) return 0;
+  int ClearCode = 1 << (CodeSize-1);
+  int EOFCode = ClearCode+1;
+  int InitCodeSize = CodeSize;
+  int FreeCode = ClearCode+2;
+  int offset[4096];		// where in out the string for each code is
+  unsigned short length[4096];	// and how long it is
+  int OldCode = -1;
+  int oldpos = 0, oldlen = 0;
+  int pos = 0;
+  unsigned bits = 0; int nbits = 0;
+  int blocklen = 0;
+
+  while (pos < n) {
+    while (nbits < CodeSize) {
+      if (!blocklen) {
+	blocklen = in.next();
+	if (blocklen <= 0) goto DONE; // the terminator or end of file
+      }
+      int c = in.next();
+      if (c < 0) goto DONE;
+      blocklen--;
+      bits |= unsigned(c) << nbits;
+      nbits += 8;
     }
-  }
+    int code = bits & code_mask[CodeSize];
+    bits >>= CodeSize;
+    nbits -= CodeSize;
 
-  int inumber=0; // which image from animated gif file to read
+    if (code == ClearCode) {
+      CodeSize = InitCodeSize;
+      FreeCode = ClearCode+2;
+      OldCode = -1;
+      continue;
+    }
+    if (code == EOFCode) break;
+
+    int start = pos;
+    if (code < ClearCode) {
+      out[pos++] = code;
+    } else if (OldCode < 0) {
+      break; // a string code before any table entries, file is bad
+    } else if (code < FreeCode) {
+      int len = length[code];
+      if (len > n-pos) len = n-pos;
+      memcpy(out+pos, out+offset[code], len);
+      pos += len;
+    } else if (code == FreeCode) {
+      // the previous string plus its own first byte:
+      int len = oldlen;
+      if (len > n-pos) len = n-pos;
+      memcpy(out+pos, out+oldpos, len);
+      pos += len;
+      if (pos < n) out[pos++] = out[oldpos];
+    } else {
+      break; // LZW Barf!
+    }
 
-  int Width; GETSHORT(Width);
-  int Height; GETSHORT(Height);
-  if (Width <= 0 || Height <= 0) {
-    fclose(GifFile);
-    return false;
+    if (OldCode >= 0 && FreeCode < 4096) {
+      offset[FreeCode] = oldpos;
+      length[FreeCode] = oldlen+1;
+      FreeCode++;
+      if (FreeCode > code_mask[CodeSize] && CodeSize < 12) CodeSize++;
+    }
+    OldCode = code;
+    oldpos = start;
+    oldlen = pos-start;
   }
+  // skip the rest of the data and the terminator:
+  while (blocklen-- > 0) in.next();
+  in.skip_blocks();
+  return pos;
+ DONE:
+  return pos;
+}
 
-  uchar ch = NEXTBYTE;
-  char HasColormap = ((ch & 0x80) != 0);
-  int BitsPerPixel = (ch & 7) + 1;
-  int ColorMapSize = 1 << BitsPerPixel;
-  // int OriginalResolution = ((ch>>4)&7)+1;
-  // int SortedTable = (ch&8)!=0;
-  NEXTBYTE; // Background Color index
-  NEXTBYTE; // Aspect ratio is N/64
-
-  // Read in global colormap:
-  uchar transparent_pixel = 0;
-  char has_transparent = 0;
-  U32 colormap[256];
+////////////////////////////////////////////////////////////////
 
-  if (HasColormap) {
-    for (int i=0; i < ColorMapSize; i++) {
-      U32 r = NEXTBYTE;
-      U32 g = NEXTBYTE;
-      U32 b = NEXTBYTE;
-      colormap[i] = 0xff000000|(r<<16)|(g<<8)|b;
-    }
-  } else {
-    //    fprintf(stderr,"%s does not have a colormap.\n", infname);
-    for (int i = 0; i < ColorMapSize; i++)
-      colormap[i] = 0xff000000|(0x10101*i);
+static void read_colormap(GifReader& in, U32* colormap, int n) {
+  for (int i = 0; i < n; i++) {
+    U32 r = in.next();
+    U32 g = in.next();
+    U32 b = in.next();
+    colormap[i] = 0xff000000|((r&255)<<16)|((g&255)<<8)|(b&255);
   }
+  for (int i = n; i < 256; i++) colormap[i] = 0xff000000;
+}
 
-  int CodeSize;		/* Code size, init from GIF header, increases... */
-  char Interlace;
+// Read an image block (after the 0x2c), rows are put in order:
+static bool read_frame(GifReader& in, GifFrame& f) {
+  f.x = in.short_();
+  f.y = in.short_();
+  f.w = in.short_();
+  f.h = in.short_();
+  int ch = in.next();
+  if (ch < 0 || f.w <= 0 || f.h <= 0) return false;
+  if (f.w > 0x7fffffff/f.h) return false;
+  bool interlace = (ch & 0x40) != 0;
+  if (ch & 0x80) {
+    f.colormap = new U32[256];
+    read_colormap(in, f.colormap, 2 << (ch&7));
+  }
+  int CodeSize = in.next()+1;
+  int n = f.w*f.h;
+  uchar* data = new uchar[n];
+  memset(data, 0, n);
+  decode_lzw(in, CodeSize, data, n);
+  if (!interlace) {
+    f.pixels = data;
+    return true;
+  }
+  f.pixels = new uchar[n];
+  const uchar* from = data;
+  static const int start[4] = {0, 4, 2, 1};
+  static const int step[4] = {8, 8, 4, 2};
+  for (int pass = 0; pass < 4; pass++)
+    for (int y = start[pass]; y < f.h; y += step[pass], from += f.w)
+      memcpy(f.pixels+y*f.w, from, f.w);
+  delete[] data;
+  return true;
+}
 
-  for (;;) {
+// Draw row y of frame f onto row y of the image:
+static void composite_row(GifAnimation* a, const GifFrame& f, int y, U32* to) {
+  if (y < f.y || y >= f.y+f.h) return;
+  const U32* colormap = f.colormap ? f.colormap : a->colormap;
+  int x = f.x > 0 ? f.x : 0;
+  int r = f.x+f.w < a->w ? f.x+f.w : a->w;
+  const uchar* p = f.pixels+(y-f.y)*f.w+(x-f.x);
+  for (; x < r; x++, p++)
+    if (*p != f.transparent) to[x] = colormap[*p];
+}
 
-    int i = NEXTBYTE;
-    if (i<0) {
-      // fprintf(stderr,"%s: unexpected EOF\n",infname);
-      return false;
-    }
-    int blocklen;
+// Draw frame f onto the canvas. Returns the area it changed:
+static Rectangle composite(GifAnimation* a, const GifFrame& f) {
+  Rectangle r(f.x, f.y, f.w, f.h);
+  r.intersect(Rectangle(a->w, a->h));
+  for (int y = r.y(); y < r.b(); y++)
+    composite_row(a, f, y, a->canvas+y*a->w);
+  return r;
+}
 
-    //  if (i == 0x3B) return;  eof code
+// Copy a rectangle of the canvas to or from saved:
+static void save_area(GifAnimation* a, const Rectangle& r, bool restore) {
+  if (!a->saved) a->saved = new U32[a->w*a->h];
+  for (int y = r.y(); y < r.b(); y++) {
+    U32* c = a->canvas+y*a->w+r.x();
+    U32* s = a->saved+y*a->w+r.x();
+    if (restore) memcpy(c, s, r.w()*4); else memcpy(s, c, r.w()*4);
+  }
+}
 
-    if (i == 0x21) {		// a "gif extension"
+// Go to the next frame, returns the area that changed:
+static Rectangle next_frame(GifAnimation* a) {
+  Rectangle changed(0,0,0,0);
+  if (a->frame >= 0) {
+    const GifFrame& f = a->frames[a->frame];
+    Rectangle r(f.x, f.y, f.w, f.h); r.intersect(Rectangle(a->w, a->h));
+    if (f.disposal == BACKGROUND) {
+      for (int y = r.y(); y < r.b(); y++)
+	memset(a->canvas+y*a->w+r.x(), 0, r.w()*4);
+      changed = r;
+    } else if (f.disposal == PREVIOUS) {
+      save_area(a, r, true);
+      changed = r;
+    }
+  }
+  if (++a->frame >= a->nframes) {
+    // start again with a clear canvas:
+    a->frame = 0;
+    memset(a->canvas, 0, a->w*a->h*4);
+    changed.set(0, 0, a->w, a->h);
+  }
+  const GifFrame& f = a->frames[a->frame];
+  if (f.disposal == PREVIOUS) {
+    Rectangle r(f.x, f.y, f.w, f.h); r.intersect(Rectangle(a->w, a->h));
+    save_area(a, r, false);
+  }
+  Rectangle r = composite(a, f);
+  if (changed.empty()) changed = r; else if (!r.empty()) changed.merge(r);
+  return changed;
+}
 
-      ch = NEXTBYTE;
-      blocklen = NEXTBYTE;
-
-      if (ch==0xF9 && blocklen==4) { // Netscape animation extension
-
-	char bits;
-	bits = NEXTBYTE;
-	NEXTBYTE; NEXTBYTE; // GETSHORT(delay);
-	transparent_pixel = NEXTBYTE;
-	if (bits & 1) has_transparent = 1;
-	blocklen = NEXTBYTE;
-
-      } else if (ch == 0xFF) { // Netscape repeat count
-	;
-
-      } else if (ch == 0xFE) { //Gif Comment
-#if 0
-	if(blocklen>0) {
-	  char *comment=new char[blocklen+1];
-	  int l;
-	  for(l=0;blocklen;l++,blocklen--)
-	    comment[l]=NEXTBYTE;
-	  comment[l]=0;
-	  //fprintf(stderr,"%s: Gif Comment: '%s'\n", infname, comment);
-	  delete[] comment;
-	  NEXTBYTE; //End marker
-	}
-#endif
-      } else {
-	//fprintf(stderr,"%s: unknown gif extension 0x%02x\n", infname, ch);
+bool gifImage::fetch()
+{
+  stop_animation(); // does nothing in the decoding thread, draw() did it
+  free_animation(anim);
+  anim = 0;
+
+  GifReader in;
+  unsigned mapsize = 0;
+  const uchar* map = 0;
+  in.file = 0;
+  in.end = 0;
+  if (datas) {
+    in.dat = datas;
+  } else if ((map = map_file(mapsize))) {
+    in.dat = map;
+    in.end = map+mapsize;
+  } else { // set up to read from file, quit silently on any errors:
+    in.dat = 0;
+    in.file = fopen(get_filename(), "rb");
+    if (!in.file) return false;
+  }
 
-      }
+  GifAnimation* a = new GifAnimation;
+  memset((void*)a, 0, sizeof(*a));
+  a->plays = 1; // unless there is a NETSCAPE2.0 block
+  int nalloc = 0;
+  if (in.next() != 'G' || in.next() != 'I' || in.next() != 'F') goto DONE;
+  in.next(); in.next(); in.next(); // version
+
+  {
+  a->w = in.short_();
+  a->h = in.short_();
+  int ch = in.next();
+  in.next(); // Background Color index, is drawn transparent like browsers do
+  in.next(); // Aspect ratio is N/64
+  if (ch & 0x80) {
+    read_colormap(in, a->colormap, 2 << (ch&7));
+  } else {
+    for (int i = 0; i < 256; i++) a->colormap[i] = 0xff000000|(0x10101*i);
+  }
 
-    } else if (i == 0x2c) {	// an image
+  // graphic control extension, applies to the next image:
+  int transparent = -1;
+  int disposal = 0;
+  int delay = 0;
 
-      NEXTBYTE; NEXTBYTE; // GETSHORT(x_position);
-      NEXTBYTE; NEXTBYTE; // GETSHORT(y_position);
-      GETSHORT(Width);
-      GETSHORT(Height);
-      ch = NEXTBYTE;
-      Interlace = ((ch & 0x40) != 0);
-      if (ch&0x80) {
-	// read local color map
-	int n = 2 << (ch&7);
-	for (i=0; i < n; i++) {
-          U32 r = NEXTBYTE;
-          U32 g = NEXTBYTE;
-          U32 b = NEXTBYTE;
-          colormap[i] = 0xff000000|(r<<16)|(g<<8)|b;
+  for (;;) {
+    int i = in.next();
+    if (i < 0 || i == 0x3B) break; // end of file
+    if (i == 0x21) {		// a "gif extension"
+      ch = in.next();
+      if (ch == 0xF9) { // graphic control
+	int blocklen = in.next();
+	int bits = in.next();
+	delay = in.short_();
+	int t = in.next();
+	transparent = (bits & 1) ? t : -1;
+	disposal = (bits >> 2) & 7;
+	for (blocklen -= 4; blocklen > 0; blocklen--) in.next();
+      } else if (ch == 0xFF) { // application, look for the repeat count
+	int blocklen = in.next();
+	char id[11];
+	for (int j = 0; j < blocklen; j++) {
+	  int c = in.next();
+	  if (j < 11) id[j] = c;
+	}
+	if (blocklen == 11 && !memcmp(id, "NETSCAPE2.0", 11)) {
+	  int n = in.next();
+	  if (n <= 0) continue; // that was the terminator
+	  int c = in.next(); n--;
+	  if (c == 1 && n >= 2) { // how many times to repeat, 0 is forever
+	    int repeats = in.short_(); n -= 2;
+	    a->plays = repeats ? repeats+1 : 0;
+	  }
+	  while (n-- > 0) in.next();
 	}
       }
-      CodeSize = NEXTBYTE+1;
-      if (!inumber--) break; // okay, this is the image we want
-      blocklen = NEXTBYTE;
-
+      in.skip_blocks();
+    } else if (i == 0x2c) {	// an image
+      if (a->nframes >= nalloc) {
+	nalloc = nalloc ? 2*nalloc : 4;
+	a->frames = (GifFrame*)realloc(a->frames, nalloc*sizeof(GifFrame));
+      }
+      GifFrame& f = a->frames[a->nframes];
+      memset((void*)&f, 0, sizeof(f));
+      f.transparent = transparent;
+      f.disposal = disposal;
+      f.delay = delay > 1 ? delay/100.0f : .1f; // like browsers do
+      if (!read_frame(in, f)) {
+	delete[] f.pixels;
+	delete[] f.colormap;
+	break;
+      }
+      a->nframes++;
+      transparent = -1; disposal = 0; delay = 0;
     } else {
-      //fprintf(stderr,"%s: unknown gif code 0x%02x\n", infname, i);
-      blocklen = 0;
+      break; // unknown gif code
     }
-
-    // skip the data:
-    while (blocklen>0) {while (blocklen--) {NEXTBYTE;} blocklen=NEXTBYTE;}
+  }
   }
 
-  if (BitsPerPixel >= CodeSize) {
-    // Workaround for broken GIF files...
-    BitsPerPixel = CodeSize - 1;
-    ColorMapSize = 1 << BitsPerPixel;
+ DONE:
+  if (in.file) fclose(in.file);
+  unmap_file(map, mapsize);
+  if (!a->nframes) {free_animation(a); return false;}
+
+  // Some files have a wrong screen size:
+  const GifFrame& f0 = a->frames[0];
+  if (a->w < f0.x+f0.w) a->w = f0.x+f0.w;
+  if (a->h < f0.y+f0.h) a->h = f0.y+f0.h;
+  if (a->w > 0x7fffffff/4/a->h) {free_animation(a); return false;}
+
+  // It needs alpha if anything does not cover the pixels or is transparent:
+  bool alpha = f0.x || f0.y || f0.w != a->w || f0.h != a->h;
+  for (int i = 0; i < a->nframes; i++)
+    if (a->frames[i].transparent >= 0 ||
+	(a->nframes > 1 && a->frames[i].disposal == BACKGROUND)) alpha = true;
+
+  setsize(a->w, a->h);
+  setpixeltype(alpha ? fltk::ARGB32 : fltk::RGB32);
+  if (a->nframes == 1) { // not animated, no canvas is needed
+    for (int y=0; y<a->h; y++) {
+      U32* to = (U32*)(linebuffer(y));
+      memset(to, 0, a->w*4);
+      composite_row(a, f0, y, to);
+      setpixels((uchar*)to, y);
+    }
+    free_animation(a);
+    return true;
   }
 
-  uchar *Image = new uchar[Width*Height];
-  if (!Image) {
-    //fprintf (stderr, "Insufficient memory\n");
-    return false;
+  a->canvas = new U32[a->w*a->h];
+  memset(a->canvas, 0, a->w*a->h*4);
+  a->frame = -1;
+  next_frame(a);
+  for (int y=0; y<a->h; y++) {
+    U32* to = (U32*)(linebuffer(y));
+    memcpy(to, a->canvas+y*a->w, a->w*4);
+    setpixels((uchar*)to, y);
   }
-  int YC = 0, Pass = 0; /* Used to de-interlace the picture */
-  uchar *p = Image;
-  uchar *eol = p+Width;
+  a->image = this;
+  anim = a;
+  return true;
+}
 
-  int InitCodeSize = CodeSize;
-  int ClearCode = (1 << (CodeSize-1));
-  int EOFCode = ClearCode + 1;
-  int FirstFree = ClearCode + 2;
-  int FinChar = 0;
-  int ReadMask = (1<<CodeSize) - 1;
-  int FreeCode = FirstFree;
-  int OldCode = ClearCode;
-
-  // tables used by LZW decompresser:
-  short int Prefix[4096];
-  uchar Suffix[4096];
-
-  int blocklen = NEXTBYTE;
-  uchar thisbyte = NEXTBYTE; blocklen--;
-  int frombit = 0;
+////////////////////////////////////////////////////////////////
+// Animation:
+//
+// All the animated gifs share one timeout, which shows the next frame
+// of any whose time has come and then waits for the next one that is
+// due. An image only animates while it is being drawn: if draw() has
+// not been called since the last frame was shown it stops, and draw()
+// starts it again. Only the part of where it was drawn that the new
+// frame changes is redrawn.
+
+static GifAnimation* animating;
+
+static void schedule() {
+  remove_timeout(gifImage::animation_timeout);
+  if (!animating) return;
+  double t = animating->time;
+  for (GifAnimation* a = animating->next; a; a = a->next)
+    if (a->time < t) t = a->time;
+  t -= get_time_secs();
+  add_timeout(t > 0 ? float(t) : 0.0f, gifImage::animation_timeout);
+}
 
-  for (;;) {
+static void unlist(GifAnimation* a) {
+  for (GifAnimation** p = &animating; *p; p = &((*p)->next))
+    if (*p == a) {*p = a->next; break;}
+  a->running = false;
+}
 
-/* Fetch the next code from the raster data stream.  The codes can be
- * any length from 3 to 12 bits, packed into 8-bit bytes, so we have to
- * maintain our location as a pointer and a bit offset.
- * In addition, gif adds totally useless and annoying block counts
- * that must be correctly skipped over. */
-    int CurCode = thisbyte;
-    if (frombit+CodeSize > 7) {
-      if (blocklen <= 0) {
-	blocklen = NEXTBYTE;
-	if (blocklen <= 0) break;
-      }
-      thisbyte = NEXTBYTE; blocklen--;
-      CurCode |= thisbyte<<8;
-    }
-    if (frombit+CodeSize > 15) {
-      if (blocklen <= 0) {
-	blocklen = NEXTBYTE;
-	if (blocklen <= 0) break;
-      }
-      thisbyte = NEXTBYTE; blocklen--;
-      CurCode |= thisbyte<<16;
-    }
-    CurCode = (CurCode>>frombit)&ReadMask;
-    frombit = (frombit+CodeSize)%8;
+// Redraw where rectangle r of the image was drawn:
+static void redraw_area(GifAnimation* a, const Rectangle& r) {
+  if (a->many) {fltk::redraw(); return;}
+  const Rectangle& A = a->area;
+  int x = A.x()+r.x()*A.w()/a->w;
+  int y = A.y()+r.y()*A.h()/a->h;
+  int R = A.x()+(r.r()*A.w()+a->w-1)/a->w;
+  int B = A.y()+(r.b()*A.h()+a->h-1)/a->h;
+  // make sure the window was not destroyed:
+  for (Window* w = Window::first(); w; w = w->next())
+    if (w == a->window) {w->redraw(Rectangle(x, y, R-x, B-y)); break;}
+}
 
-    if (CurCode == ClearCode) {
-      CodeSize = InitCodeSize;
-      ReadMask = (1<<CodeSize) - 1;
-      FreeCode = FirstFree;
-      OldCode = ClearCode;
-      continue;
-    }
+// Put the changed part of the canvas into the Image and redraw it:
+static void show_frame(gifImage* image, GifAnimation* a, const Rectangle& r) {
+  if (r.empty()) return;
+  image->setpixels((uchar*)(a->canvas+r.y()*a->w+r.x()), r, a->w*4);
+  if (a->drawn) redraw_area(a, r);
+  a->drawn = a->many = false;
+}
 
-    if (CurCode == EOFCode) break;
-
-    uchar OutCode[1025]; // temporary array for reversing codes
-    uchar *tp = OutCode;
-    int i;
-    if (CurCode < FreeCode) i = CurCode;
-    else if (CurCode == FreeCode) {*tp++ = FinChar; i = OldCode;}
-    else {/*fprintf(stderr,"%s : LZW Barf!\n",infname);*/ break;}
-
-    while (i >= ColorMapSize) {*tp++ = Suffix[i]; i = Prefix[i];}
-    *tp++ = FinChar = i;
-    while (tp > OutCode) {
-      *p++ = *--tp;
-      if (p >= eol) {
-	if (!Interlace) YC++;
-	else switch (Pass) {
-	case 0: YC += 8; if (YC >= Height) {Pass++; YC = 4;} break;
-	case 1: YC += 8; if (YC >= Height) {Pass++; YC = 2;} break;
-	case 2: YC += 4; if (YC >= Height) {Pass++; YC = 1;} break;
-	case 3: YC += 2; break;
-	}
-	if (YC>=Height) YC=0; /* cheap bug fix when excess data */
-	p = Image + YC*Width;
-	eol = p+Width;
-      }
+void gifImage::animation_timeout(void*) {
+  double now = get_time_secs();
+  for (GifAnimation* a = animating; a;) {
+    GifAnimation* next = a->next;
+    gifImage* image = a->image;
+    if (a->time > now+.001) {
+      // not yet
+    } else if (!a->drawn || !image->fetched() || image->job) {
+      unlist(a); // not being drawn, or destroy() or refetch() was done
+    } else {
+      show_frame(image, a, next_frame(a));
+      a->time += a->frames[a->frame].delay;
+      if (a->time < now) a->time = now+a->frames[a->frame].delay;
+      if (a->frame == a->nframes-1 && a->plays && ++a->played >= a->plays)
+	unlist(a); // leave the last frame showing
     }
+    a = next;
+  }
+  schedule();
+}
 
-    if (OldCode != ClearCode) {
-      Prefix[FreeCode] = OldCode;
-      Suffix[FreeCode] = FinChar;
-      FreeCode++;
-      if (FreeCode > ReadMask) {
-	if (CodeSize < 12) {
-	  CodeSize++;
-	  ReadMask = (1 << CodeSize) - 1;
-	}
-	else FreeCode--;
-      }
-    }
-    OldCode = CurCode;
+void gifImage::stop_animation() {
+  if (anim && anim->running) {unlist(anim); schedule();}
+}
+
+/*! Draws the current frame. If it is an animation this also starts it,
+  it runs until it is not drawn any more. */
+void gifImage::_draw(const Rectangle& r) const {
+  gifImage* image = const_cast<gifImage*>(this);
+  if (!fetched()) image->stop_animation(); // fetch() will replace anim
+  SharedImage::_draw(r);
+  GifAnimation* a = anim;
+  if (!a || !fetched() || job || !animate_) return;
+  Rectangle area; transform(r, area);
+  if (!a->drawn) {
+    a->window = Window::drawing_window();
+    a->area = area;
+    a->drawn = true;
+  } else if (a->window != Window::drawing_window()) {
+    a->many = true;
+  } else {
+    a->area.merge(area);
+  }
+  if (!a->running && !(a->plays && a->played >= a->plays)) {
+    a->running = true;
+    a->time = get_time_secs()+a->frames[a->frame].delay;
+    a->next = animating;
+    animating = a;
+    schedule();
   }
-  if (!datas) fclose(GifFile);
+}
 
-  setsize(Width,Height);
-  if (has_transparent) colormap[transparent_pixel] = 0;
-  setpixeltype(has_transparent ? fltk::ARGB32 : fltk::RGB32);
-  for (int y=0; y<Height; y++) {
-    U32* to = (U32*)(linebuffer(y));
-    p = Image+y*Width;
-    for (int x=0; x<Width; x++) to[x] = colormap[*p++];
-    setpixels((uchar*)to, y);
+gifImage::~gifImage() {
+  stop_animation();
+  free_animation(anim);
+}
+
+/*! Return the number of images in the file. This is 1 unless it is
+  an animated gif file. */
+int gifImage::frames() const {
+  int w, h; measure(w, h); // makes sure fetch() is done
+  return anim ? anim->nframes : 1;
+}
+
+/*! Return which frame is being shown, starting at 0. */
+int gifImage::frame() const {
+  return anim ? anim->frame : 0;
+}
+
+/*! Show frame \a n of an animated gif, and redraw the part it changes. */
+void gifImage::frame(int n) {
+  if (n < 0 || n >= frames() || !anim || n == anim->frame) return;
+  GifAnimation* a = anim;
+  Rectangle changed(0,0,0,0);
+  if (n < a->frame) {
+    a->frame = -1;
+    memset(a->canvas, 0, a->w*a->h*4);
+    changed.set(0, 0, a->w, a->h);
   }
-  delete[] Image;
-  return true;
+  while (a->frame < n) {
+    Rectangle r = next_frame(a);
+    if (changed.empty()) changed = r; else if (!r.empty()) changed.merge(r);
+  }
+  a->drawn = true; // redraw where it was last drawn
+  show_frame(this, a, changed);
+  if (a->running) a->time = get_time_secs()+a->frames[n].delay;
+}
+
+/*! Return how many seconds frame \a n is shown. */
+float gifImage::delay(int n) const {
+  if (n < 0 || n >= frames() || !anim) return 0;
+  return anim->frames[n].delay;
 }
 
 //
@@ -0,0 +1,168 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Time from an event entering fltk::handle() until the frame showing
+// what it changed has been sent to the display. fltk::handle() remembers
+// each outer event that called fltk::damage(), and the end of the next
+// fltk::flush() that draws any windows finishes all the remembered ones,
+// which is after every Window::flush() including GlWindow's swap. When
+// this is turned off it costs a test of measuring_latency_ per event.
+
+#include <fltk/trace.h>
+#include <fltk/events.h>
+#include <string.h>
+using namespace fltk;
+
+/*! \fn bool fltk::measuring_latency()
+  Returns true if start_latency_measure() has been called and
+  stop_latency_measure() has not.
+*/
+bool fltk::measuring_latency_;
+
+static LatencyHistogram histograms[LATENCY_EVENTS];
+
+struct PendingEvent {
+  double start;
+  int event;
+};
+static PendingEvent pending[256]; // events waiting for the next frame
+static int npending;
+
+/*!
+  Start measuring the time from when each event enters fltk::handle()
+  until the drawing it caused has been sent to the display. Only the
+  outermost handle() call is timed, and only if it called
+  fltk::damage(), which Widget::redraw() and Window::redraw() do.
+  The time ends after the next fltk::flush() that draws any window
+  has called Window::flush() on all of them, swapped the double
+  buffers (including GlWindow ones) and sent everything to the
+  display, so it includes the handling, layout and drawing, and any
+  timeouts and other events done before the frame was drawn.
+
+  It does not include the time the event waited in the system before
+  fltk read it, or the time the display and monitor take to show the
+  new picture.
+
+  This is cheap enough to leave on in a program that is in use. On X,
+  setting FLTK_INPUT_LATENCY in the environment turns it on when the
+  display is opened and prints write_latency_report() to stderr when
+  the program exits.
+*/
+void fltk::start_latency_measure() {measuring_latency_ = true;}
+
+/*! Stop measuring. The histograms are kept. */
+void fltk::stop_latency_measure() {
+  measuring_latency_ = false;
+  npending = 0;
+}
+
+/*! Zero all the histograms. */
+void fltk::clear_latency_measure() {
+  memset(histograms, 0, sizeof(histograms));
+  npending = 0;
+}
+
+// Called by fltk::handle() for an outer event that damaged something:
+void fl_latency_event(int event, double start) {
+  if (npending >= int(sizeof(pending)/sizeof(*pending))) return;
+  pending[npending].start = start;
+  pending[npending].event = event;
+  npending++;
+}
+
+static void add(LatencyHistogram& h, float t) {
+  h.count++;
+  h.total += t;
+  if (t > h.max) h.max = t;
+  int i = 0;
+  for (float edge = .0005f; i < LATENCY_BUCKETS-1 && t >= edge; edge *= 2) i++;
+  h.bucket[i]++;
+}
+
+// Called at the end of fltk::flush() if anything was drawn:
+void fl_latency_frame() {
+  if (!npending) return;
+  double now = trace_time();
+  for (int i = 0; i < npending; i++) {
+    float t = float(now - pending[i].start);
+    add(histograms[0], t);
+    int e = pending[i].event;
+    if (e > 0 && e < LATENCY_EVENTS) add(histograms[e], t);
+  }
+  npending = 0;
+}
+
+/*!
+  Return the latencies measured for one type of event, such as
+  fltk::PUSH or fltk::KEY. input_latency(0) returns all of them added
+  together.
+*/
+const LatencyHistogram& fltk::input_latency(int event) {
+  static const LatencyHistogram empty = {0,0,0,{0}};
+  if (event < 0 || event >= LATENCY_EVENTS) return empty;
+  return histograms[event];
+}
+
+/*!
+  Return a latency that \a fraction (such as .5 or .99) of the ones
+  in the histogram are less than. This is the top of the bucket that
+  fraction falls in, so it is only accurate to a factor of two, except
+  that it is never more than the max.
+*/
+float fltk::latency_percentile(const LatencyHistogram& h, float fraction) {
+  if (!h.count) return 0;
+  unsigned long want = (unsigned long)(fraction*h.count+.5f);
+  unsigned long n = 0;
+  float edge = .0005f;
+  for (int i = 0; i < LATENCY_BUCKETS-1; i++, edge *= 2) {
+    n += h.bucket[i];
+    if (n >= want) return edge < h.max ? edge : h.max;
+  }
+  return h.max;
+}
+
+/*!
+  Print the count, mean, median, 99th percentile and maximum latency
+  in milliseconds for each type of event that has been measured.
+*/
+void fltk::write_latency_report(FILE* f) {
+  fprintf(f, "%-12s %8s %8s %8s %8s %8s\n",
+	  "event", "count", "mean", "50%", "99%", "max");
+  for (int e = 1; e <= LATENCY_EVENTS; e++) {
+    // print the total last:
+    const LatencyHistogram& h = histograms[e % LATENCY_EVENTS];
+    if (!h.count) continue;
+    fprintf(f, "%-12s %8lu %8.2f %8.2f %8.2f %8.2f\n",
+	    e < LATENCY_EVENTS ? event_name(e) : "all",
+	    h.count, 1000*h.total/h.count,
+	    1000*latency_percentile(h, .5f),
+	    1000*latency_percentile(h, .99f),
+	    1000*h.max);
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,133 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Shared copies of strings, used by Widget::copy_label(). Programs
+// that make lots of widgets tend to give many of them the same label,
+// such as "OK" or "0.00", and this makes them all point at one copy.
+// Each copy is in a hash table with a count of how many users it has,
+// and is freed when the last one releases it.
+
+#include <fltk/string.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+struct InternedString {
+  InternedString* next;	// in the same hash bucket
+  unsigned hash;
+  unsigned refcount;
+  unsigned length;	// strlen(text)
+  char text[1];		// length+1 bytes are allocated
+};
+
+static InternedString** buckets;
+static unsigned nbuckets;	// always a power of 2
+static unsigned count;
+
+// For memory_report(), the strings shared by copy_label():
+unsigned long fl_copied_labels, fl_copied_label_bytes;
+
+static unsigned hash_string(const char* text, unsigned n) {
+  unsigned h = 2166136261U;
+  for (unsigned i = 0; i < n; i++) h = (h ^ (unsigned char)text[i]) * 16777619U;
+  return h;
+}
+
+static inline InternedString* entry(const char* s) {
+  return (InternedString*)(s - offsetof(InternedString, text));
+}
+
+static void rehash(unsigned n) {
+  InternedString** b = (InternedString**)calloc(n, sizeof(InternedString*));
+  for (unsigned i = 0; i < nbuckets; i++) {
+    for (InternedString* e = buckets[i]; e;) {
+      InternedString* next = e->next;
+      InternedString** p = &b[e->hash&(n-1)];
+      e->next = *p;
+      *p = e;
+      e = next;
+    }
+  }
+  free(buckets);
+  buckets = b;
+  nbuckets = n;
+}
+
+/*!
+  Return a copy of \a s that is shared with every other caller that
+  asked for the same string, and must be given to releasestring() when
+  no longer needed rather than deleted. The copy is freed when every
+  internstring() of it has been released. Returns NULL if \a s is NULL.
+
+  Widget::copy_label() uses this, so a program that makes thousands of
+  widgets with the same label only has one copy of it.
+*/
+const char* internstring(const char* s) {
+  if (!s) return 0;
+  unsigned n = strlen(s);
+  unsigned hash = hash_string(s, n);
+  if (nbuckets) {
+    for (InternedString* e = buckets[hash&(nbuckets-1)]; e; e = e->next) {
+      if (e->hash == hash && e->length == n && !memcmp(e->text, s, n)) {
+	e->refcount++;
+	return e->text;
+      }
+    }
+  }
+  if (count >= nbuckets) rehash(nbuckets ? 2*nbuckets : 256);
+  InternedString* e =
+    (InternedString*)malloc(offsetof(InternedString, text)+n+1);
+  e->hash = hash;
+  e->refcount = 1;
+  e->length = n;
+  memcpy(e->text, s, n+1);
+  InternedString** p = &buckets[hash&(nbuckets-1)];
+  e->next = *p;
+  *p = e;
+  count++;
+  fl_copied_labels++;
+  fl_copied_label_bytes += offsetof(InternedString, text)+n+1;
+  return e->text;
+}
+
+/*!
+  Give back a string returned by internstring(). It is freed if this
+  was the last user. Does nothing if \a s is NULL.
+*/
+void releasestring(const char* s) {
+  if (!s) return;
+  InternedString* e = entry(s);
+  if (--e->refcount) return;
+  InternedString** p = &buckets[e->hash&(nbuckets-1)];
+  while (*p != e) p = &((*p)->next);
+  *p = e->next;
+  count--;
+  fl_copied_labels--;
+  fl_copied_label_bytes -= offsetof(InternedString, text)+e->length+1;
+  free(e);
+}
+
+//
+// End of "$Id$".
+//
@@ -31,6 +31,7 @@
 #include <config.h>
 #include <fltk/Font.h>
 #include <fltk/string.h>
+#include <fltk/trace.h>
 
 #if USE_X11
 # include "x11/list_fonts.cxx"
@@ -56,6 +57,58 @@ using namespace fltk;
   old array and return a new one.
 */
 
+/*! \fn void fltk::prefetch_fonts()
+  \relates fltk::Font
+
+  Start making the list returned by list_fonts() in another thread, so
+  that it may be done by the time anything asks for it. Window::show()
+  calls this before loading the theme, as the theme usually looks up a
+  font by name. list_fonts() waits for the other thread to finish.
+
+  This only does something with Xft, where listing the fonts is done
+  by fontconfig and reading its configuration and caches is a large
+  part of the time a program takes to start. Elsewhere it does nothing.
+*/
+
+/*! \fn void fltk::prefetch_fonts(Font** fonts, const float* sizes, int n)
+  \relates fltk::Font
+
+  Start loading the \a n fonts \a fonts[i] at size \a sizes[i] in
+  another thread, such as the ones a window full of text is about to
+  use. Until each one arrives, setfont() of it picks the nearest size
+  of that font that is already loaded, and once it arrives all the
+  windows are laid out and redrawn with it. Fonts that are loaded
+  already are skipped.
+
+  This only does something with plain X fonts (no Xft), where the
+  XListFonts() and XLoadQueryFont() for each font and size are round
+  trips to the server with large replies. It does them on another
+  connection to the server, so the program keeps running meanwhile.
+*/
+
+/*! \fn void fltk::list_fonts(void (*done)(void*), void* arg)
+  \relates fltk::Font
+
+  Call \a done(\a arg) once list_fonts() can return the list without
+  waiting. With Xft the list is made in another thread and \a done is
+  called by fltk::wait(), elsewhere it is made and \a done is called
+  right away.
+*/
+
+#if !(USE_X11 && !USE_XFT && HAVE_PTHREAD)
+void fltk::prefetch_fonts(fltk::Font**, const float*, int) {}
+#endif
+
+#if !(USE_X11 && USE_XFT && HAVE_PTHREAD)
+void fltk::prefetch_fonts() {}
+
+void fltk::list_fonts(void (*done)(void*), void* arg) {
+  Font** array;
+  list_fonts(array);
+  done(arg);
+}
+#endif
+
 /*! \relates fltk::Font
 
   Find a font with the given "nice" name. You can get bold and italic
@@ -98,7 +151,8 @@ fltk::Font* fltk::font(const char* name, int attributes /* = 0 */) {
   name = GetFontSubstitutes(name,length);
 #endif
   font = 0;
-  {Font** list; int b = list_fonts(list); int a = 0;
+  {TraceScope trace(TRACE_STARTUP, "font(name)");
+  Font** list; int b = list_fonts(list); int a = 0;
   while (a < b) {
     int c = (a+b)/2;
     Font* testfont = list[c];
@@ -22,6 +22,36 @@
   waits for events, and then grabs it again before handling the
   events.
 
+\section mtshared Reading widgets from other threads
+
+  A thread that only wants to look at the state of widgets can call
+  fltk::lock_shared() and fltk::unlock_shared() instead. Any number of
+  threads can hold the shared lock at once, and the main thread only
+  holds the exclusive lock while it handles events and callbacks, it
+  turns it into a shared lock while it is drawing the windows. So
+  reading threads do not wait for each other or for the redraw, and do
+  not stall the main loop.
+
+  While holding only the shared lock you must not change anything, and
+  should only call these accessors, which only read a field or two and
+  are safe to call while the main thread is drawing:
+  - Widget::x(), y(), w(), h(), label(), tooltip(), flags(), visible(),
+    active(), takesevents(), parent(), user_data(), argument()
+  - Group::children() and Group::child()
+  - Valuator::value(), minimum(), maximum(), step()
+  - Button::value() and all the other Widget::state() based values
+  - Input::value(), size(), text(), position(), mark()
+  - Browser::value(), and Menu::value() and size()
+  - TextBuffer::length(), character(), text_range()
+  - StringList::children() and child()
+
+  Values may be changed by the main thread as soon as you call
+  unlock_shared(), so copy anything you need before then. The main
+  thread does the layout() of the windows before it shares the lock,
+  so the positions and sizes do not change while it draws. A thread
+  must not call lock_shared() again while it holds it, as it will wait
+  for the main thread, which may be waiting for it.
+
 \section mtbugs Known problems
 
   The "main" thread is the one that is calling fltk::wait().
@@ -100,6 +130,26 @@
   return, it will get control.
 */
 
+/*! \fn void fltk::lock_shared()
+
+  Get a shared "read-only" lock on fltk. Any number of threads can
+  hold this at the same time, and it is granted even while the main
+  thread is drawing the windows, but not while any thread holds
+  lock(). See the \ref mtshared "list of functions" that may be called
+  with only this lock held.
+
+  This is not recursive with itself, and a thread that holds it must
+  not call lock() or it will deadlock. If the thread already holds
+  lock() this does nothing.
+
+  Where fltk cannot do shared locks (such as when X11 multithreading
+  is used) this is the same as lock().
+*/
+
+/*! \fn void fltk::unlock_shared()
+  Releases the lock from lock_shared().
+*/
+
 /*! \fn void fltk::awake(void* message)
 
   A child thread can call this to cause the main thread's call to
@@ -117,10 +167,22 @@
 
 /*! \fn void* fltk::thread_message()
 
-  Returns an argument sent to the most recent awake(), or returns null
-  if none. Warning: this is almost useless for communication as the
-  current implementation only has a one-entry queue and
-  only returns the most recent awake() result.
+  Returns the oldest message sent by awake() that has not been
+  returned yet, or returns null if none. Messages are returned in the
+  order they were sent, even if several threads call awake() at the
+  same time, so you can process all of them after each wait():
+
+\code
+  for (;;) {
+    fltk::wait();
+    while (void* m = fltk::thread_message()) do_something(m);
+  }
+\endcode
+
+  awake(0) wakes up the main thread but does not queue anything. The
+  queue holds FL_AWAKE_QUEUE_SIZE (currently 1024) messages, if the
+  main thread falls that far behind any further messages are thrown
+  away (the main thread is still woken up).
 */
 
 /*! \fn bool fltk::in_main_thread()
@@ -174,6 +236,99 @@ fltk::RecursiveMutex::RecursiveMutex() : Mutex(recursive_attrib()) {}
 # endif
 #endif
 
+#if (USE_X11 && USE_X11_MULTITHREADING) || \
+    (HAVE_PTHREAD && (!defined(_WIN32) || defined(__CYGWIN__)))
+
+// Messages from fltk::awake() are put in a bounded lock-free queue
+// (the multi-producer version of Dmitry Vyukov's ring buffer, with
+// only the main thread reading it). Each cell has a sequence number
+// that says whether it is free for the producer that claimed that
+// position or full for the consumer. The pipe is only written when
+// the main thread has not already been woken up, so a burst of
+// messages costs a single system call.
+
+#define FL_AWAKE_QUEUE_SIZE 1024 // must be a power of 2
+
+#if defined(__GNUC__)
+# define fl_compare_and_swap(p,o,n) __sync_bool_compare_and_swap(p,o,n)
+# define fl_test_and_set(p) __sync_lock_test_and_set(p,1)
+# define fl_memory_barrier() __sync_synchronize()
+#else
+// Not lock-free, but correct, on compilers without atomic builtins:
+# include <fltk/Threads.h>
+static fltk::Mutex atomic_mutex;
+static bool fl_compare_and_swap(volatile unsigned long* p,
+				unsigned long o, unsigned long n) {
+  fltk::Guard guard(atomic_mutex);
+  if (*p != o) return false;
+  *p = n;
+  return true;
+}
+static int fl_test_and_set(volatile int* p) {
+  fltk::Guard guard(atomic_mutex);
+  int r = *p; *p = 1; return r;
+}
+static void fl_memory_barrier() {fltk::Guard guard(atomic_mutex);}
+#endif
+
+static struct AwakeCell {
+  volatile unsigned long sequence;
+  void* message;
+} awake_queue[FL_AWAKE_QUEUE_SIZE];
+static volatile unsigned long awake_enqueue_pos;
+static unsigned long awake_dequeue_pos; // only used by main thread
+static volatile int awake_pending; // pipe has been written to
+
+static void awake_queue_init() {
+  for (unsigned long i = 0; i < FL_AWAKE_QUEUE_SIZE; i++)
+    awake_queue[i].sequence = i;
+  fl_memory_barrier();
+}
+
+// Add the message to the queue (unless it is null or the queue is full).
+// Returns true if the main thread must be woken up:
+static bool awake_queue_push(void* msg) {
+  if (msg) {
+    unsigned long pos = awake_enqueue_pos;
+    for (;;) {
+      AwakeCell& cell = awake_queue[pos & (FL_AWAKE_QUEUE_SIZE-1)];
+      long dif = long(cell.sequence) - long(pos);
+      if (!dif) {
+	if (fl_compare_and_swap(&awake_enqueue_pos, pos, pos+1)) {
+	  cell.message = msg;
+	  fl_memory_barrier();
+	  cell.sequence = pos+1;
+	  break;
+	}
+      } else if (dif < 0) {
+	break; // queue is full, message is thrown away
+      }
+      pos = awake_enqueue_pos;
+    }
+  }
+  return !fl_test_and_set(&awake_pending);
+}
+
+// Called by the main thread after it has read the pipe, so the next
+// awake() will write to it again:
+static void awake_queue_drained() {
+  fl_memory_barrier();
+  awake_pending = 0;
+  fl_memory_barrier();
+}
+
+static void* awake_queue_pop() {
+  AwakeCell& cell = awake_queue[awake_dequeue_pos & (FL_AWAKE_QUEUE_SIZE-1)];
+  if (long(cell.sequence) - long(awake_dequeue_pos+1) < 0) return 0;
+  fl_memory_barrier();
+  void* msg = cell.message;
+  cell.sequence = awake_dequeue_pos + FL_AWAKE_QUEUE_SIZE;
+  awake_dequeue_pos++;
+  return msg;
+}
+
+#endif
+
 #if USE_X11 && USE_X11_MULTITHREADING
 
 // This is NOT normally done, instead the HAVE_PTHREAD case is done
@@ -192,30 +347,89 @@ fltk::RecursiveMutex::RecursiveMutex() : Mutex(recursive_attrib()) {}
 
 extern void (*fl_lock_function)();
 extern void (*fl_unlock_function)();
+extern void (*fl_share_lock_function)();
+extern void (*fl_unshare_lock_function)();
 static void init_function();
 static void (*init_or_lock_function)() = init_function;
 
+// The exclusive lock is the recursive fltkmutex, plus the write side of
+// fltkrwlock which is taken by the outermost lock() only. Threads that
+// call lock_shared() take the read side, so they only wait for threads
+// that really hold lock(). The main thread turns its write lock into a
+// read lock while it draws (it keeps fltkmutex so no other thread can
+// get the exclusive lock in the meantime).
+//
+// Pthread rwlocks usually let new readers in while a writer waits, so
+// a steady stream of lock_shared() threads could keep the main thread
+// from ever getting the lock back. Readers and the writer both pass
+// through fltkgate first, and the writer holds it while it waits, so
+// once it is waiting no new readers start.
 static fltk::RecursiveMutex fltkmutex;
+static fltk::RWMutex fltkrwlock;
+static fltk::Mutex fltkgate;
+
+// How many lock() calls each thread has not unlocked. Only the thread
+// itself reads or writes its count, so have_lock() can't be fooled by a
+// count that belongs to the thread that has the lock now:
+static pthread_key_t depth_key;
+static inline long lock_depth() {return (long)pthread_getspecific(depth_key);}
+static inline void lock_depth(long d) {pthread_setspecific(depth_key, (void*)d);}
+
+static void write_lock() {
+  fltkgate.lock();
+  fltkrwlock.lock();
+  fltkgate.unlock();
+}
+
+static void lock_function() {
+  fltkmutex.lock();
+  long d = lock_depth();
+  if (!d) write_lock();
+  lock_depth(d+1);
+}
+
+static void unlock_function() {
+  long d = lock_depth()-1;
+  lock_depth(d);
+  if (!d) fltkrwlock.unlock();
+  fltkmutex.unlock();
+}
 
-static void lock_function() { fltkmutex.lock(); }
-static void unlock_function() { fltkmutex.unlock(); }
+static void share_lock_function() {
+  fltkrwlock.unlock();
+  fltkrwlock.read_lock();
+}
+
+static void unshare_lock_function() {
+  fltkrwlock.read_unlock();
+  write_lock();
+}
+
+static bool have_lock() {
+  return lock_depth() > 0;
+}
 
 static pthread_t main_thread_id;
 
-static void* thread_message_;
 static void thread_awake_cb(int fd, void*) {
-  while (read(fd, &thread_message_, sizeof(void*)) > 0);
+  char buffer[64];
+  while (read(fd, buffer, sizeof(buffer)) > 0);
+  awake_queue_drained();
 }
 static int thread_filedes[2];
 
 static void init_function() {
   // Init threads communication pipe to let threads awake FLTK from wait
   main_thread_id = pthread_self();
+  pthread_key_create(&depth_key, 0);
+  awake_queue_init();
   if(pipe(thread_filedes)); //ignore the return value
   fcntl(thread_filedes[0], F_SETFL, O_NONBLOCK);
   fltk::add_fd(thread_filedes[0], fltk::READ, thread_awake_cb);
   fl_lock_function = init_or_lock_function = lock_function;
   fl_unlock_function = unlock_function;
+  fl_share_lock_function = share_lock_function;
+  fl_unshare_lock_function = unshare_lock_function;
   lock_function();
 }
 
@@ -223,28 +437,178 @@ void fltk::lock() {init_or_lock_function();}
 
 void fltk::unlock() {fl_unlock_function();}
 
+void fltk::lock_shared() {
+  if (init_or_lock_function == init_function || have_lock()) return;
+  fltkgate.lock();
+  fltkrwlock.read_lock();
+  fltkgate.unlock();
+}
+
+void fltk::unlock_shared() {
+  if (init_or_lock_function == init_function || have_lock()) return;
+  fltkrwlock.read_unlock();
+}
+
 bool fltk::in_main_thread() {
   return init_or_lock_function == init_function || pthread_self() == main_thread_id;
 }
 
 void fltk::awake(void* msg) {
-  if(write(thread_filedes[1], &msg, sizeof(void*))); //ignore the return value
+  // only write to the pipe if the main thread has not been woken yet:
+  if (awake_queue_push(msg))
+    if(write(thread_filedes[1], "", 1)); //ignore the return value
 }
 
-// the following is already defined in CYGWIN
-// for the common win32/run.cxx part
-#if !defined(__CYGWIN__) 
 void* fltk::thread_message() {
-  void* r = thread_message_;
-  thread_message_ = 0;
-  return r;
+  return awake_queue_pop();
 }
-#endif
 
 #else
 
 // If no lock is supported, the fltk::lock() and similar functions are
 // missing.
+# define NO_LOCK 1
+
+#endif
+
+// True once the main thread has called lock(), so other threads may use
+// awake() and post(). Used by code that can hand work to a thread:
+#if NO_LOCK
+bool fl_lock_started() {return false;}
+#else
+bool fl_lock_started() {return init_or_lock_function != init_function;}
+#endif
+
+////////////////////////////////////////////////////////////////
+// fltk::post() queue:
+
+#if HAVE_PTHREAD || defined(_WIN32)
+#include <fltk/Threads.h>
+#include <stdlib.h>
+
+/*! \fn fltk::PostId fltk::post(TimeoutHandler cb, void* arg)
+
+  Any thread can call this to make the main thread call \a cb(\a arg)
+  the next time it is in fltk::wait(). This is done while it holds
+  the fltk lock, so \a cb can do anything to the widgets. The calling
+  thread does not need to (and should not) hold the lock(), and the
+  main thread is woken up as though awake() was called.
+
+  Posted calls are done in the order they were posted, and all the
+  calls posted since the last wait() are done together, so this is
+  far more efficient than each thread doing lock(), modify, awake(),
+  unlock() when there are many updates.
+
+  The returned value can be passed to post_done() to see if the call
+  has been done yet, or to wait_posted() to block until it has.
+
+  As with awake(), the main thread must call fltk::lock() once before
+  this can be used from other threads.
+*/
+
+/*! \fn bool fltk::post_done(PostId id)
+  Returns true if the call that post() returned \a id for has
+  finished. Zero is always done.
+*/
+
+/*! \fn void fltk::wait_posted(PostId id)
+
+  Block the calling thread until the call that post() returned \a id
+  for has finished. The calling thread must not hold fltk::lock() or
+  this will deadlock. If called by the main thread (with the lock
+  held) this does all the pending posted calls immediately, except it
+  returns without waiting if called by a posted call for a call in the
+  same batch, which cannot run until this one returns.
+*/
+
+struct PostedCall {
+  fltk::TimeoutHandler cb;
+  void* arg;
+};
+static fltk::SignalMutex post_mutex;
+static PostedCall* posted_calls;	// waiting to be done
+static int posted_count, posted_size;
+static PostedCall* spare_calls;	// array to use for the next batch
+static int spare_size;
+static fltk::PostId last_posted;	// id of most recent post()
+static fltk::PostId last_done;		// id of most recently finished one
+static fltk::PostId batches_done;	// end of the latest batch finished
+static int running_depth;		// batches being done by the main thread
+
+extern volatile int fl_posted_pending;	// in run.cxx
+extern void (*fl_do_posted_calls)();
+
+// A posted call may call fltk::wait() or wait_posted(), which does the
+// next batch before this one is finished. So each batch is done out of
+// its own array, and last_done is only moved once all the batches
+// being done have finished. Returns false if nothing was posted:
+static bool run_posted_calls() {
+  // take the whole batch, so other threads can post while these run:
+  post_mutex.lock();
+  int n = posted_count;
+  fl_posted_pending = 0;
+  if (!n) {post_mutex.unlock(); return false;}
+  PostedCall* calls = posted_calls; int size = posted_size;
+  posted_calls = spare_calls; posted_size = spare_size;
+  spare_calls = 0; spare_size = 0;
+  posted_count = 0;
+  fltk::PostId batch_end = last_posted;
+  running_depth++;
+  post_mutex.unlock();
+  for (int i = 0; i < n; i++) calls[i].cb(calls[i].arg);
+  post_mutex.lock();
+  if (!spare_calls) {spare_calls = calls; spare_size = size;}
+  else free(calls);
+  // batches finish newest first when nested, keep the latest end:
+  if (!batches_done || long(batch_end - batches_done) > 0)
+    batches_done = batch_end;
+  if (!--running_depth) {
+    last_done = batches_done;
+    post_mutex.signal();
+  }
+  post_mutex.unlock();
+  return true;
+}
+
+static void do_posted_calls() {run_posted_calls();}
+
+fltk::PostId fltk::post(TimeoutHandler cb, void* arg) {
+  post_mutex.lock();
+  if (posted_count >= posted_size) {
+    posted_size = posted_size ? 2*posted_size : 64;
+    posted_calls = (PostedCall*)
+      realloc(posted_calls, posted_size*sizeof(PostedCall));
+  }
+  posted_calls[posted_count].cb = cb;
+  posted_calls[posted_count].arg = arg;
+  bool first = !posted_count++;
+  if (!++last_posted) ++last_posted; // zero means "nothing"
+  PostId id = last_posted;
+  fl_do_posted_calls = do_posted_calls;
+  fl_posted_pending = 1;
+  post_mutex.unlock();
+  // only the first call in a batch needs to wake up the main thread:
+  if (first) awake();
+  return id;
+}
+
+bool fltk::post_done(PostId id) {
+  fltk::Guard guard(post_mutex);
+  return long(last_done - id) >= 0 || long(last_posted - id) < 0;
+}
+
+void fltk::wait_posted(PostId id) {
+  if (in_main_thread()) {
+    // if id is in a batch that is being done (this was called by one of
+    // its calls) it can't finish until this returns, so give up:
+    while (!post_done(id)) if (!run_posted_calls()) break;
+    return;
+  }
+  post_mutex.lock();
+  while (long(last_done - id) < 0 && long(last_posted - id) >= 0)
+    post_mutex.wait();
+  post_mutex.unlock();
+}
 
 #endif
 
@@ -0,0 +1,209 @@
+// "$Id$"
+//
+// Copyright 1998-2007 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+
+// A report of the memory used by the parts of fltk that can grow in a
+// program that runs for a long time. Each part keeps its own count and
+// this only adds them up, so nothing is slower when it is not used.
+
+#include <config.h>
+#include <fltk/trace.h>
+#include <fltk/Window.h>
+#include <fltk/Image.h>
+#include <fltk/Style.h>
+#include <fltk/Preferences.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_RTTI
+# include <typeinfo>
+# if defined(__GNUC__)
+#  include <cxxabi.h>
+# endif
+#endif
+
+using namespace fltk;
+
+// Updated by the OpenGL library when it makes and deletes textures:
+FL_API unsigned long fl_gl_textures, fl_gl_texture_bytes;
+
+extern unsigned long fl_widget_count, fl_widget_bytes; // in Widget.cxx
+extern unsigned long fl_copied_labels, fl_copied_label_bytes; // in internstring.cxx
+extern unsigned long fl_dynamic_styles(); // in Style.cxx
+extern void fl_text_buffer_memory(unsigned long&, unsigned long&,
+				  unsigned long&); // in TextBuffer.cxx
+#if USE_X11
+extern void fl_font_memory(unsigned long&, unsigned long&); // in Font.cxx
+extern void fl_backbuffer_memory(unsigned long&, unsigned long&); // in run.cxx
+extern void fl_atlas_memory(unsigned long&, unsigned long&); // in Image.cxx
+#endif
+
+/*!
+  Fill in \a r with how much memory is used by widgets, their styles
+  and labels, TextBuffer, images, fonts, and Preferences. This is
+  for finding leaks and growing caches in a program that runs for a
+  long time, compare reports made hours apart. Sizes are what fltk
+  asked for, not counting the overhead of malloc(), and memory used
+  by the X server or graphics card is estimated from the sizes of the
+  pixmaps and textures. Fonts and server pixmaps are only counted on
+  X11.
+*/
+void fltk::memory_report(MemoryReport& r) {
+  memset(&r, 0, sizeof(r));
+  r.widgets = fl_widget_count;
+  r.widget_bytes = fl_widget_bytes;
+  r.styles = fl_dynamic_styles();
+  r.style_bytes = r.styles*sizeof(Style);
+  r.labels = fl_copied_labels;
+  r.label_bytes = fl_copied_label_bytes;
+  fl_text_buffer_memory(r.text_buffers, r.text_buffer_bytes,
+			r.text_buffer_gap_bytes);
+  r.image_bytes = Image::total_mem_used();
+  r.widget_cache_bytes = Widget::cache_mem_used();
+#if USE_X11
+  fl_backbuffer_memory(r.pixmaps, r.pixmap_bytes);
+  unsigned long n, bytes;
+  fl_atlas_memory(n, bytes);
+  r.pixmaps += n;
+  r.pixmap_bytes += bytes;
+  fl_font_memory(r.fonts, r.font_bytes);
+#endif
+  r.gl_textures = fl_gl_textures;
+  r.gl_texture_bytes = fl_gl_texture_bytes;
+  r.preferences_bytes = Preferences::total_mem_used(&r.preferences_nodes);
+}
+
+////////////////////////////////////////////////////////////////
+
+static WidgetClassMemory* classes;
+static int num_classes, classes_size;
+
+// Class names are kept forever, there are only so many classes:
+static const char* class_name(const Widget* widget) {
+#if HAVE_RTTI
+  const char* name = typeid(*widget).name();
+  static const char** mangled;
+  static const char** names;
+  static int num_names, names_size;
+  for (int i = 0; i < num_names; i++) if (mangled[i] == name) return names[i];
+  if (num_names >= names_size) {
+    names_size = names_size ? 2*names_size : 32;
+    mangled = (const char**)realloc(mangled, names_size*sizeof(char*));
+    names = (const char**)realloc(names, names_size*sizeof(char*));
+  }
+  mangled[num_names] = name;
+# if defined(__GNUC__)
+  int status;
+  char* demangled = abi::__cxa_demangle(name, 0, 0, &status);
+  if (demangled && !status) name = demangled;
+# endif
+  names[num_names++] = name;
+  return name;
+#else
+  return "Widget";
+#endif
+}
+
+static void count_widget(const Widget* widget) {
+  const char* name = class_name(widget);
+  int i;
+  for (i = 0; i < num_classes; i++) if (classes[i].name == name) break;
+  if (i == num_classes) {
+    if (num_classes >= classes_size) {
+      classes_size = classes_size ? 2*classes_size : 32;
+      classes = (WidgetClassMemory*)
+	realloc(classes, classes_size*sizeof(WidgetClassMemory));
+    }
+    classes[i].name = name;
+    classes[i].count = 0;
+    classes[i].bytes = 0;
+    num_classes++;
+  }
+  classes[i].count++;
+  classes[i].bytes += widget->alloc_size();
+  if (widget->is_group()) {
+    const Group* group = (const Group*)widget;
+    for (int j = 0; j < group->children(); j++) count_widget(group->child(j));
+  }
+}
+
+static int compare_classes(const void* a, const void* b) {
+  const WidgetClassMemory* x = (const WidgetClassMemory*)a;
+  const WidgetClassMemory* y = (const WidgetClassMemory*)b;
+  if (x->bytes != y->bytes) return x->bytes > y->bytes ? -1 : 1;
+  return x->count > y->count ? -1 : x->count < y->count;
+}
+
+/*!
+  Count the widgets in all the shown windows by class, and copy up to
+  \a n of the classes to \a array, the ones using the most memory
+  first. Returns how many classes there are, which may be more than
+  \a n. The names are only the real class names if the library was
+  compiled with rtti.
+
+  Widgets that are not in a shown window are not counted, compare the
+  total with MemoryReport::widgets to see if some were forgotten.
+*/
+int fltk::widget_class_memory(WidgetClassMemory* array, int n) {
+  num_classes = 0;
+  for (Window* w = Window::first(); w; w = w->next()) count_widget(w);
+  qsort(classes, num_classes, sizeof(WidgetClassMemory), compare_classes);
+  if (n > num_classes) n = num_classes;
+  if (n > 0) memcpy(array, classes, n*sizeof(WidgetClassMemory));
+  return num_classes;
+}
+
+/*!
+  Print memory_report() and the widget_class_memory() of the
+  twenty classes using the most to \a f, for a debugging menu item or
+  signal handler.
+*/
+void fltk::write_memory_report(FILE* f) {
+  MemoryReport r;
+  memory_report(r);
+  fprintf(f, "%-14s %8s %12s\n", "memory", "count", "bytes");
+  fprintf(f, "%-14s %8lu %12lu\n", "widgets", r.widgets, r.widget_bytes);
+  fprintf(f, "%-14s %8lu %12lu\n", "styles", r.styles, r.style_bytes);
+  fprintf(f, "%-14s %8lu %12lu\n", "labels", r.labels, r.label_bytes);
+  fprintf(f, "%-14s %8lu %12lu (%lu in gaps)\n", "text buffers",
+	  r.text_buffers, r.text_buffer_bytes, r.text_buffer_gap_bytes);
+  fprintf(f, "%-14s %8s %12lu\n", "images", "", r.image_bytes);
+  fprintf(f, "%-14s %8s %12lu\n", "widget cache", "", r.widget_cache_bytes);
+  fprintf(f, "%-14s %8lu %12lu\n", "pixmaps", r.pixmaps, r.pixmap_bytes);
+  fprintf(f, "%-14s %8lu %12lu\n", "fonts", r.fonts, r.font_bytes);
+  fprintf(f, "%-14s %8lu %12lu\n", "gl textures", r.gl_textures, r.gl_texture_bytes);
+  fprintf(f, "%-14s %8lu %12lu\n", "preferences", r.preferences_nodes, r.preferences_bytes);
+
+  WidgetClassMemory array[20];
+  int n = widget_class_memory(array, 20);
+  unsigned long shown = 0;
+  for (int i = 0; i < num_classes; i++) shown += classes[i].count;
+  fprintf(f, "\nwidgets in shown windows: %lu of %lu, %d classes\n",
+	  shown, r.widgets, n);
+  if (n > 20) n = 20;
+  for (int i = 0; i < n; i++)
+    fprintf(f, "%-30s %8lu %12lu\n", array[i].name, array[i].count, array[i].bytes);
+}
+
+//
+// End of "$Id$".
+//
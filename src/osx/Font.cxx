@@ -37,7 +37,7 @@
 
 using namespace fltk;
 
-struct FontSize {float size; unsigned opengl_id;};
+struct FontSize {float size; unsigned opengl_id; WidthCache* widths;};
 
 // The public-visible fltk::Font structures are actually imbedded in
 // this larger structure:
@@ -95,6 +95,7 @@ static FontSize* findsize() {
   FontSize* f = array+a;
   f->size = current_size_;
   f->opengl_id = 0;
+  f->widths = 0;
   return f;
 }
 
@@ -213,9 +214,28 @@ float fltk::getdescent() { return ((IFont*)current_font_)->descent*current_size_
 
 #include "utf8tomac.cxx"
 
-#define WCBUFLEN 256
+// Return the text in MacRoman for CGContextShowTextAtPoint() and set
+// count to its length. ASCII, which is most text, is the same in
+// MacRoman, so it is returned without copying. Anything else is
+// converted into a buffer that is kept for the next call:
+static const char* mactext(const char* text, int n, int& count) {
+  const char* p = text;
+  const char* e = text+n;
+  while (p < e && !(*p & 0x80)) p++;
+  if (p >= e) {count = n; return text;}
+  static char* buffer;
+  static unsigned size;
+  count = utf8tomac(text, n, buffer, size);
+  if (unsigned(count) >= size) {
+    delete[] buffer;
+    size = count+256;
+    buffer = new char[size];
+    count = utf8tomac(text, n, buffer, size);
+  }
+  return buffer;
+}
 
-float fltk::getwidth(const char* text, int n) {
+static float measure_width(const char* text, int n) {
   if (!quartz_gc) {
     Window *w = Window::first();
     if (w) w->make_current();
@@ -223,33 +243,24 @@ float fltk::getwidth(const char* text, int n) {
     CGContextSelectFont(quartz_gc, ((IFont*)current_font_)->name,
 			current_size_, kCGEncodingMacRoman);
   }
-  char localbuffer[WCBUFLEN];
-  char* buffer = localbuffer;
-  char* mallocbuffer = 0;
-  int count = utf8tomac(text, n, buffer, WCBUFLEN);
-  if (count >= WCBUFLEN) {
-    buffer = mallocbuffer = new char[count+1];
-    count = utf8toa(text, n, buffer, count+1);
-  }
+  int count;
+  const char* buffer = mactext(text, n, count);
   CGContextSetTextDrawingMode(quartz_gc, kCGTextInvisible);
   CGContextShowTextAtPoint(quartz_gc, 0, 0, buffer, count);
   CGContextSetTextDrawingMode(quartz_gc, kCGTextFill);
   CGPoint p = CGContextGetTextPosition(quartz_gc);
-  delete[] mallocbuffer;
   return p.x;
 }
 
+float fltk::getwidth(const char* text, int n) {
+  if (!current_font_) return measure_width(text, n);
+  return fl_cached_width(findsize()->widths, text, n, measure_width);
+}
+
 void fltk::drawtext_transformed(const char *text, int n, float x, float y) {
-  char localbuffer[WCBUFLEN];
-  char* buffer = localbuffer;
-  char* mallocbuffer = 0;
-  int count = utf8tomac(text, n, buffer, WCBUFLEN);
-  if (count >= WCBUFLEN) {
-    buffer = mallocbuffer = new char[count+1];
-    count = utf8toa(text, n, buffer, count+1);
-  }
+  int count;
+  const char* buffer = mactext(text, n, count);
   CGContextShowTextAtPoint(quartz_gc, x, y, buffer, count);
-  delete[] mallocbuffer;
 }
 
 //
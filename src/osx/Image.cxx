@@ -170,7 +170,7 @@ uchar* Image::linebuffer(int y) {
 
 void Image::setpixels(const uchar* buf, int y) {
   buffer();
-  flags &= ~COPIED;
+  buffer_changed();
   uchar* to = picture->data+y*picture->linedelta;
   if (buf != to) memcpy(to, buf, width()*depth());
 }
@@ -179,7 +179,7 @@ void Image::setpixels(const uchar* buf, const fltk::Rectangle& r, int linedelta)
 {
   if (r.empty()) return;
   buffer();
-  flags &= ~COPIED;
+  buffer_changed();
   uchar* to = picture->data+r.y()*picture->linedelta+r.x()*buffer_depth();
   // see if we can do it all at once:
   if (r.w() == picture->w && (r.h()==1 || linedelta == picture->linedelta)) {
@@ -204,6 +204,7 @@ void Image::fetch_if_needed() const {
 extern void fl_set_quartz_ctm();
 
 void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
+  if (fl_display_list) {record_image(this, from, to); return;}
   fetch_if_needed();
   if (!picture) {fillrect(to); return;}
   CGContextSaveGState(quartz_gc);
@@ -215,6 +216,10 @@ void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
   CGContextRestoreGState(quartz_gc);
 }
 
+bool Image::draw_tiled(const fltk::Rectangle&) const {
+  return false;
+}
+
 void Image::setimage(const uchar* source, PixelType p, int w, int h, int ld)
 {
   setsize(w,h);
@@ -84,19 +84,18 @@ namespace fltk {
 static void nothing() {}
 void (*fl_lock_function)() = nothing;
 void (*fl_unlock_function)() = nothing;
+// these are set by lock() so other threads can lock_shared() during flush():
+void (*fl_share_lock_function)() = nothing;
+void (*fl_unshare_lock_function)() = nothing;
 
 ////////////////////////////////////////////////////////////////
 // interface to select call:
 //
-// WAS: This is similar to the x.cxx version but with USE_POLL set to 0
-// I modified this from Matt's version to more closely match the X
-// version, with the addition of the locks for the parallel thread. It
-// may be better to kill the parallel thread and launch it on the next
-// wait call, however.
-//
-// Surely this can be done without a second thread, what we need
-// is a file descriptor that becomes ready when an Apple UI event
-// is pending.
+// When there are windows each file descriptor is a CFFileDescriptor
+// source on the main run loop, which ReceiveNextEvent() runs while
+// it waits, so the callbacks are done right there on the main thread
+// with no other thread to hand off to. Without any windows select()
+// is called directly, as in the X version with USE_POLL set to 0.
 
 static fd_set fdsets[3];
 static int maxfd;
@@ -112,17 +111,110 @@ static struct FD {
   void (*cb)(int, void*);
   void* arg;
 } *fd = 0;
-static pthread_t select_thread = 0;	// parallel thread running select()
-static int G_pipe[2] = { 0,0 };		// for waking up that thread
-static pthread_mutex_t select_mutex;	// lock for above data
-static inline void wake_select_thread() {
-  if (select_thread) write(G_pipe[1], "x", 1);
+
+// One run loop source for each different file descriptor:
+static int nsources = 0;
+static int source_array_size = 0;
+static struct Source {
+  int fd;
+  CFFileDescriptorRef ref;
+  CFRunLoopSourceRef source;
+} *sources = 0;
+
+enum { kEventClassFLTK = 'fltk' };
+enum { kEventFLTKBreakLoop = 1, kEventFLTKDataReady };
+
+static short fd_events(int n) {
+  short events = 0;
+  for (int i = 0; i < nfds; i++) if (fd[i].fd == n) events |= fd[i].events;
+  return events;
+}
+
+// CFFileDescriptor callbacks are one-shot, this turns them back on.
+// There is no callback for exceptions, errors also make the fd readable:
+static void enable_source(const Source& s, short events) {
+  CFOptionFlags flags = 0;
+  if (events & (POLLIN|POLLERR)) flags |= kCFFileDescriptorReadCallBack;
+  if (events & POLLOUT) flags |= kCFFileDescriptorWriteCallBack;
+  CFFileDescriptorEnableCallBacks(s.ref, flags);
+}
+
+static Source* find_source(int n) {
+  for (int i = 0; i < nsources; i++) if (sources[i].fd == n) return sources+i;
+  return 0;
+}
+
+// Called by the run loop inside ReceiveNextEvent():
+static void fd_ready_cb(CFFileDescriptorRef ref, CFOptionFlags, void*) {
+  int n = CFFileDescriptorGetNativeDescriptor(ref);
+  fl_lock_function();
+  // The source may say readable for an fd only waiting for POLLERR,
+  // and the fd may have been used already by run_select(), so check:
+  short events = fd_events(n);
+  fd_set r, w, x; FD_ZERO(&r); FD_ZERO(&w); FD_ZERO(&x);
+  if (events & POLLIN) FD_SET(n, &r);
+  if (events & POLLOUT) FD_SET(n, &w);
+  if (events & POLLERR) FD_SET(n, &x);
+  timeval t = { 0, 0 };
+  if (events && ::select(n+1, &r, &w, &x, &t) > 0) {
+    short revents = 0;
+    if (FD_ISSET(n, &r)) revents |= POLLIN;
+    if (FD_ISSET(n, &w)) revents |= POLLOUT;
+    if (FD_ISSET(n, &x)) revents |= POLLERR;
+    for (int i=0; i<nfds; i++) {
+      if (fd[i].fd == n && (fd[i].events & revents)) {
+        DEBUGMSG("DOING CALLBACK: ");
+        fd[i].cb(n, fd[i].arg);
+        DEBUGMSG("DONE\n");
+      }
+    }
+  }
+  // the callback may have removed it:
+  Source* s = find_source(n);
+  if (s) enable_source(*s, fd_events(n));
+  fl_unlock_function();
+  // make ReceiveNextEvent() return so wait() knows something happened:
+  EventRef drEvent;
+  CreateEvent( 0, kEventClassFLTK, kEventFLTKDataReady,
+               0, kEventAttributeUserEvent, &drEvent);
+  PostEventToQueue(GetMainEventQueue(), drEvent, kEventPriorityStandard);
+  ReleaseEvent(drEvent);
+}
+
+// Make the source for n match the events wanted for it:
+static void update_source(int n) {
+  short events = fd_events(n);
+  Source* s = find_source(n);
+  if (!events) {
+    if (s) {
+      CFRunLoopRemoveSource(CFRunLoopGetMain(), s->source, kCFRunLoopCommonModes);
+      CFRelease(s->source);
+      CFFileDescriptorInvalidate(s->ref);
+      CFRelease(s->ref);
+      *s = sources[--nsources];
+    }
+    return;
+  }
+  if (!s) {
+    CFFileDescriptorRef ref =
+      CFFileDescriptorCreate(kCFAllocatorDefault, n, false, fd_ready_cb, 0);
+    if (!ref) return;
+    if (nsources >= source_array_size) {
+      source_array_size = 2*source_array_size+1;
+      sources = (Source*)realloc(sources, source_array_size*sizeof(Source));
+    }
+    s = sources+nsources++;
+    s->fd = n;
+    s->ref = ref;
+    s->source = CFFileDescriptorCreateRunLoopSource(kCFAllocatorDefault, ref, 0);
+    CFRunLoopAddSource(CFRunLoopGetMain(), s->source, kCFRunLoopCommonModes);
+  }
+  enable_source(*s, events);
 }
 
 //+++ verify port to FLTK2
 void fltk::add_fd(int n, int events, FileHandler cb, void *v) {
   remove_fd(n, events);
-  pthread_mutex_lock(&select_mutex);
   int i = nfds++;
   if (i >= fd_array_size) {
     fd_array_size = 2*fd_array_size+1;
@@ -136,8 +228,7 @@ void fltk::add_fd(int n, int events, FileHandler cb, void *v) {
   if (events & POLLOUT) FD_SET(n, &fdsets[1]);
   if (events & POLLERR) FD_SET(n, &fdsets[2]);
   if (n > maxfd) maxfd = n;
-  wake_select_thread();
-  pthread_mutex_unlock(&select_mutex);
+  update_source(n);
 }
 
 //+++ verify port to FLTK2
@@ -147,7 +238,6 @@ void fltk::add_fd(int fd, FileHandler cb, void* v) {
 
 //+++ verify port to FLTK2
 void fltk::remove_fd(int n, int events) {
-  pthread_mutex_lock(&select_mutex);
   int i,j;
   maxfd = 0;
   for (i=j=0; i<nfds; i++) {
@@ -167,27 +257,14 @@ void fltk::remove_fd(int n, int events) {
   if (events & POLLIN) FD_CLR(n, &fdsets[0]);
   if (events & POLLOUT) FD_CLR(n, &fdsets[1]);
   if (events & POLLERR) FD_CLR(n, &fdsets[2]);
-  wake_select_thread();
-  pthread_mutex_unlock(&select_mutex);
+  update_source(n);
 }
 
-enum { kEventClassFLTK = 'fltk' };
-enum { kEventFLTKBreakLoop = 1, kEventFLTKDataReady };
-
-// Run select() and do the callbacks:
-static int run_select(double time_to_wait, bool in_thread, bool callbacks) {
-  // Thread safe local copy
-  pthread_mutex_lock(&select_mutex);
-  int maxfd = ::maxfd;
+// Run select() and do the callbacks, used when there are no windows:
+static int run_select(double time_to_wait, bool callbacks) {
   fd_set r = fdsets[0];
   fd_set w = fdsets[1];
   fd_set x = fdsets[2];
-  pthread_mutex_unlock(&select_mutex);
-  // TACK ON FD'S FOR 'CANCEL PIPE'
-  if (in_thread) {
-    FD_SET(G_pipe[0], &r);
-    if ( G_pipe[0] > maxfd ) maxfd = G_pipe[0];
-  }
   DEBUGMSG("Calling select\n");
   int ret;
   if (time_to_wait < 2147483.648f) {
@@ -201,6 +278,7 @@ static int run_select(double time_to_wait, bool in_thread, bool callbacks) {
   if (ret > 0) {
     DEBUGMSG("Select returned non-zero\n");
     if (!callbacks) return ret;
+    fl_lock_function();
     for (int i=0; i<nfds; i++) {
       //fprintf(stderr, "CHECKING FD %d OF %d (%d)\n", i, nfds, fd[i].fd);
       int f = fd[i].fd;
@@ -210,74 +288,16 @@ static int run_select(double time_to_wait, bool in_thread, bool callbacks) {
       if (FD_ISSET(f, &x)) revents |= POLLERR;
       if (fd[i].events & revents) {
         DEBUGMSG("DOING CALLBACK: ");
-        fl_lock_function();
         fd[i].cb(f, fd[i].arg);
-        fl_unlock_function();
         DEBUGMSG("DONE\n");
       }
     }
-    // see if we need to copy fd_sets again:
-    if (in_thread && FD_ISSET(G_pipe[0], &r)) {
-      DEBUGMSG("reading from G_pipe\n");
-      char buf[1]; read(G_pipe[0],buf,1);
-    }
+    fl_unlock_function();
     return ret;
   } else {
     return 0;
   }
 }
-
-// select_thread
-//    Separate thread, watches for changes in user's file descriptors.
-//    Sends a 'data ready event' to the main thread if any change.
-// WAS: This new one locks and does the callback. Without this it is
-// impossible to call select() again. Wonko was killing this thread
-// on every event to stop it.
-static void *select_thread_proc(void *userdata)
-{
-  while (1) {
-    if (run_select(1e20, true, true)) {
-      // wake up the main thread with a message:
-      EventRef drEvent;
-      CreateEvent( 0, kEventClassFLTK, kEventFLTKDataReady,
-                   0, kEventAttributeUserEvent, &drEvent);
-      PostEventToQueue(GetCurrentEventQueue(), drEvent, kEventPriorityStandard);
-    }
-    //pthread_testcancel();	// OSX 10.0.4 and under: need to do this
-                          // so parent can cancel us :(
-  }
-}
-
-// Main thread calls this when it gets the above data-ready message:
-// This does nothing right now because above code did the callbacks:
-static void HandleDataReady()
-{
-#if 0
-  fl_lock_function();
-  timeval t = { 0, 0 };		// quick check
-  fd_set r = fdsets[0];
-  fd_set w = fdsets[1];
-  fd_set x = fdsets[2];
-  if (::select(maxfd+1, &r, &w, &x, &t) > 0) {
-    //DEBUGMSG("DATA READY EVENT: RECEIVED\n");
-    for (int i=0; i<nfds; i++) {
-      //fprintf(stderr, "CHECKING FD %d OF %d (%d)\n", i, nfds, fd[i].fd);
-      int f = fd[i].fd;
-      short revents = 0;
-      if (FD_ISSET(f, &r)) revents |= POLLIN;
-      if (FD_ISSET(f, &w)) revents |= POLLOUT;
-      if (FD_ISSET(f, &x)) revents |= POLLERR;
-      if (fd[i].events & revents) {
-	DEBUGMSG("DOING CALLBACK: ");
-	fd[i].cb(f, fd[i].arg);
-	DEBUGMSG("DONE\n");
-      }
-    }
-  }
-  fl_unlock_function();
-#endif
-}
-
 ////////////////////////////////////////////////////////////////
 
 // public variables
@@ -392,8 +412,7 @@ static pascal OSStatus carbonDispatchHandler( EventHandlerCallRef nextHandler, E
     case kEventFLTKBreakLoop:
       ret = noErr;
       break;
-    case kEventFLTKDataReady:
-      HandleDataReady();
+    case kEventFLTKDataReady: // fd_ready_cb() already did the callbacks
       ret = noErr;
       break;
     }
@@ -411,13 +430,13 @@ static pascal OSStatus carbonDispatchHandler( EventHandlerCallRef nextHandler, E
  */
 static inline int fl_wait(double time) 
 {
-  if (!CreatedWindow::first && !select_thread) {
+  if (!CreatedWindow::first) {
     // If there are no windows, avoid calling event handler stuff. This
     // allows the program to work on a headless render farm or when
     // ssh'd in without admin privledges.
     // Also similar to how the X11 version works when DISPLAY is not set.
     fl_unlock_function();
-    int ret = run_select(time, false, true);
+    int ret = run_select(time, true);
     fl_lock_function();
     return ret;  
   }
@@ -456,17 +475,6 @@ static inline int fl_wait(double time)
   }
 
   int got_events = 0;
-  // START A THREAD TO WATCH FOR DATA READY
-  if ( nfds && !select_thread) {
-    // detect if calling program did not do fltk::lock() and do it:
-    if (fl_lock_function == nothing) fltk::lock();
-    pthread_mutex_init(&select_mutex, NULL);
-    pipe(G_pipe);
-    DEBUGMSG("*** START THREAD\n");
-    pthread_create(&select_thread, NULL, select_thread_proc,
-		   (void*)GetCurrentEventQueue());
-  }
-
   fl_unlock_function();
 
   EventRef event;
@@ -517,8 +525,8 @@ static inline int fl_wait(double time)
  * ready() is just like wait(0.0) except no callbacks are done.
  */
 static inline int fl_ready() {
-  if (!CreatedWindow::first && !select_thread) {
-    return run_select(0.0, false, false);
+  if (!CreatedWindow::first) {
+    return run_select(0.0, false);
   }
   EventRef event;
   return !ReceiveNextEvent(0, NULL, 0.0, false, &event);
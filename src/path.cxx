@@ -29,10 +29,15 @@
 
 #include <config.h>
 #include <fltk/draw.h>
+#include <fltk/Path.h>
 #include <fltk/math.h>
 #include <fltk/x.h>
 #include <fltk/string.h>
 #include <stdlib.h>
+#include "DisplayList.h"
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 using namespace fltk;
 
 struct Matrix {
@@ -286,6 +291,44 @@ void fltk::transform(int& x, int& y) {
   }
 }
 
+/**
+Transform the \a n points in \a in and put them in \a out, which may
+be the same array. This is the same as calling transform(x,y) on each,
+but is much faster for large arrays.
+*/
+void fltk::transform(int n, const float in[][2], float out[][2]) {
+  const float* p = in[0];
+  float* q = out[0];
+  const float a = m.a, b = m.b, c = m.c, d = m.d, x = m.x, y = m.y;
+  if (m.trivial) {
+    for (int i = 0; i < 2*n; i += 2) {
+      q[i] = p[i]+x;
+      q[i+1] = p[i+1]+y;
+    }
+    return;
+  }
+  int i = 0;
+#if defined(__SSE2__)
+  // two points in each vector, multiply x,y by a,d and y,x by c,b:
+  const __m128 A = _mm_setr_ps(a, d, a, d);
+  const __m128 C = _mm_setr_ps(c, b, c, b);
+  const __m128 T = _mm_setr_ps(x, y, x, y);
+  for (; i+4 <= n; i += 4) {
+    __m128 v0 = _mm_loadu_ps(p+2*i);
+    __m128 v1 = _mm_loadu_ps(p+2*i+4);
+    __m128 s0 = _mm_shuffle_ps(v0, v0, _MM_SHUFFLE(2,3,0,1));
+    __m128 s1 = _mm_shuffle_ps(v1, v1, _MM_SHUFFLE(2,3,0,1));
+    _mm_storeu_ps(q+2*i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(v0,A), _mm_mul_ps(s0,C)), T));
+    _mm_storeu_ps(q+2*i+4, _mm_add_ps(_mm_add_ps(_mm_mul_ps(v1,A), _mm_mul_ps(s1,C)), T));
+  }
+#endif
+  for (; i < n; i++) {
+    float X = p[2*i]; float Y = p[2*i+1];
+    q[2*i] = X*a + Y*c + x;
+    q[2*i+1] = X*b + Y*d + y;
+  }
+}
+
 /**
 Transform the rectangle \a from into device coordinates and put
 it into \a to. This only works correctly for 90 degree rotations, for
@@ -382,6 +425,51 @@ static void add_n_points(int n) {
   xpoint = newpoints;
 }
 
+// Put floorf(x*k[0] + y*k[2] + k[4] + .5f) and
+// floorf(x*k[1] + y*k[3] + k[5] + .5f) for each of the n points in v into p:
+static void round_points(const float* v, int n, XPoint* p, const float k[6]) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 A = _mm_setr_ps(k[0], k[3], k[0], k[3]);
+  const __m128 C = _mm_setr_ps(k[2], k[1], k[2], k[1]);
+  const __m128 T = _mm_setr_ps(k[4], k[5], k[4], k[5]);
+  const __m128 H = _mm_set1_ps(.5f);
+  int r[8];
+  for (; i+4 <= n; i += 4) {
+    for (int j = 0; j < 2; j++) {
+      __m128 q = _mm_loadu_ps(v+2*i+4*j);
+      __m128 s = _mm_shuffle_ps(q, q, _MM_SHUFFLE(2,3,0,1));
+      q = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(q,A), _mm_mul_ps(s,C)), T), H);
+      // floor is truncate, less one where that went up:
+      __m128i t = _mm_cvttps_epi32(q);
+      t = _mm_add_epi32(t, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), q)));
+      _mm_storeu_si128((__m128i*)(r+4*j), t);
+    }
+    for (int j = 0; j < 4; j++) {
+      p[i+j].x = COORD_T(r[2*j]);
+      p[i+j].y = COORD_T(r[2*j+1]);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    p[i].x = COORD_T(floorf(v[2*i]*k[0] + v[2*i+1]*k[2] + k[4] + .5f));
+    p[i].y = COORD_T(floorf(v[2*i]*k[1] + v[2*i+1]*k[3] + k[5] + .5f));
+  }
+}
+
+// Remove repeats of the previous point from the n points starting
+// at xpoint[pn] and update numpoints. The addvertices functions
+// transform all the points first, then call this:
+static void remove_repeats(int pn, int n) {
+  XPoint* p = xpoint+pn;
+  XPoint* e = p+n;
+  XPoint* q = p;
+  if (q == xpoint && p < e) {p++; q++;}
+  for (; p < e; p++)
+    if (p->x != q[-1].x || p->y != q[-1].y) *q++ = *p;
+  numpoints = int(q-xpoint);
+}
+
 // The path also contains one dummy pie/chord piece:
 static fltk::Rectangle circle;
 static float circle_start, circle_end;
@@ -453,7 +541,9 @@ void fltk::addvertex(int X, int Y) {
 */
 void fltk::addvertices(int n, const float array[][2]) {
   const float* a = array[0];
+#if USE_CAIRO || USE_QUARTZ
   const float* e = a+2*n;
+#endif
 #if USE_CAIRO
   for (; a < e; a += 2) {
     float X = (float) a[0]; float Y = (float) a[1];
@@ -468,36 +558,23 @@ void fltk::addvertices(int n, const float array[][2]) {
   }
 #else
   if (numpoints+n >= point_array_size) add_n_points(n);
-  int pn = numpoints;
   if (m.trivial) {
-    for (; a < e; a += 2) {
-      COORD_T x = COORD_T(floorf(a[0] + m.x + .5f));
-      COORD_T y = COORD_T(floorf(a[1] + m.y + .5f));
-      if (!pn || x != xpoint[pn-1].x || y != xpoint[pn-1].y) {
-	xpoint[pn].x = x;
-	xpoint[pn].y = y;
-	pn++;
-      }
-    }
+    const float k[6] = {1, 0, 0, 1, m.x, m.y};
+    round_points(a, n, xpoint+numpoints, k);
   } else {
-    for (; a < e; a += 2) {
-      COORD_T x = COORD_T(floorf(a[0]*m.a + a[1]*m.c + m.x + .5f));
-      COORD_T y = COORD_T(floorf(a[0]*m.b + a[1]*m.d + m.y + .5f));
-      if (!pn || x != xpoint[pn-1].x || y != xpoint[pn-1].y) {
-	xpoint[pn].x = x;
-	xpoint[pn].y = y;
-	pn++;
-      }
-    }
+    const float k[6] = {m.a, m.b, m.c, m.d, m.x, m.y};
+    round_points(a, n, xpoint+numpoints, k);
   }
-  numpoints = pn;
+  remove_repeats(numpoints, n);
 #endif
 }
 
 /** Add a whole set of integer vertices to the current path. */
 void fltk::addvertices(int n, const int array[][2]) {
   const int* a = array[0];
+#if USE_CAIRO || USE_QUARTZ
   const int* e = a+2*n;
+#endif
 #if USE_CAIRO
   for (; a < e; a += 2) {
     float X = (float) a[0]; float Y = (float) a[1];
@@ -512,29 +589,24 @@ void fltk::addvertices(int n, const int array[][2]) {
   }
 #else
   if (numpoints+n >= point_array_size) add_n_points(n);
-  int pn = numpoints;
+  XPoint* p = xpoint+numpoints;
   if (m.trivial) {
-    for (; a < e; a += 2) {
-      COORD_T x = COORD_T(a[0]+m.ix);
-      COORD_T y = COORD_T(a[1]+m.iy);
-      if (!pn || x != xpoint[pn-1].x || y != xpoint[pn-1].y) {
-	xpoint[pn].x = x;
-	xpoint[pn].y = y;
-	pn++;
-      }
+    const int ix = m.ix, iy = m.iy;
+    for (int i = 0; i < n; i++) {
+      p[i].x = COORD_T(a[2*i]+ix);
+      p[i].y = COORD_T(a[2*i+1]+iy);
     }
   } else {
-    for (; a < e; a += 2) {
-      COORD_T x = COORD_T(floorf(a[0]*m.a + a[1]*m.c + m.x + .5f));
-      COORD_T y = COORD_T(floorf(a[0]*m.b + a[1]*m.d + m.y + .5f));
-      if (!pn || x != xpoint[pn-1].x || y != xpoint[pn-1].y) {
-	xpoint[pn].x = x;
-	xpoint[pn].y = y;
-	pn++;
-      }
+    // convert pieces to float for round_points():
+    const float k[6] = {m.a, m.b, m.c, m.d, m.x, m.y};
+    float buffer[2*256];
+    for (int i = 0; i < n; i += 256) {
+      int c = n-i < 256 ? n-i : 256;
+      for (int j = 0; j < 2*c; j++) buffer[j] = float(a[2*i+j]);
+      round_points(buffer, c, p+i, k);
     }
   }
-  numpoints = pn;
+  remove_repeats(numpoints, n);
 #endif
 }
 
@@ -545,24 +617,18 @@ void fltk::addvertices(int n, const int array[][2]) {
 */
 void fltk::addvertices_transformed(int n, const float array[][2]) {
   const float* a = array[0];
+#if USE_CAIRO || USE_QUARTZ
   const float* e = a+2*n;
+#endif
 #if USE_CAIRO
   for (; a < e; a += 2) cairo_line_to(cr,a[0],a[1]);
 #elif USE_QUARTZ
   for (; a < e; a += 2) quartz_add_vertex(a[0], a[1]);
 #else
   if (numpoints+n >= point_array_size) add_n_points(n);
-  int pn = numpoints;
-  for (; a < e; a += 2) {
-    COORD_T x = COORD_T(floorf(a[0] + .5f));
-    COORD_T y = COORD_T(floorf(a[1] + .5f));
-    if (!pn || x != xpoint[pn-1].x || y != xpoint[pn-1].y) {
-      xpoint[pn].x = x;
-      xpoint[pn].y = y;
-      pn++;
-    }
-  }
-  numpoints = pn;
+  const float k[6] = {1, 0, 0, 1, 0, 0};
+  round_points(a, n, xpoint+numpoints, k);
+  remove_repeats(numpoints, n);
 #endif
 }
 
@@ -663,6 +729,267 @@ void fltk::addchord(const Rectangle& r, float start, float end) {
 #endif
 }
 
+#if !USE_CAIRO && !USE_QUARTZ
+// Used by DisplayList to record and replay the current path. The circle
+// is stored as type, x, y, w, h and the angles as start, end:
+int fl_path_size(int& loops) {loops = ::loops; return numpoints;}
+
+void fl_get_path(int* xy, int* loopsizes, int* c, float* angles) {
+  for (int i = 0; i < numpoints; i++) {
+    *xy++ = xpoint[i].x;
+    *xy++ = xpoint[i].y;
+  }
+  for (int i = 0; i < loops; i++) loopsizes[i] = loop[i];
+  c[0] = circle_type;
+  c[1] = circle.x(); c[2] = circle.y(); c[3] = circle.w(); c[4] = circle.h();
+  angles[0] = circle_start; angles[1] = circle_end;
+}
+
+void fl_set_path(const int* xy, int n, const int* loopsizes, int nloops,
+		 const int* c, const float* angles, int dx, int dy) {
+  numpoints = 0;
+  if (n+1 >= point_array_size) add_n_points(n+1);
+  for (int i = 0; i < n; i++, xy += 2) {
+    xpoint[i].x = COORD_T(xy[0]+dx);
+    xpoint[i].y = COORD_T(xy[1]+dy);
+  }
+  numpoints = n;
+  if (nloops > loop_array_size) {
+    loop_array_size = nloops;
+    delete[] loop;
+    loop = new int[loop_array_size];
+  }
+  loop_start = 0;
+  for (loops = 0; loops < nloops; loops++)
+    loop_start += (loop[loops] = loopsizes[loops]);
+  circle_type = c[0] == PIE ? PIE : c[0] == CHORD ? CHORD : NONE;
+  circle.set(c[1]+dx, c[2]+dy, c[3], c[4]);
+  circle_start = angles[0]; circle_end = angles[1];
+}
+#endif
+
+#if USE_XFT && !USE_CAIRO
+////////////////////////////////////////////////////////////////
+// Filling with setcolor_alpha(). XFillPolygon cannot blend, so the path
+// is cut into trapezoids and drawn with XRender, which antialiases the
+// edges. Fills in the same color and alpha that do not overlap are
+// saved and sent as one XRenderCompositeTrapezoids() call when the
+// color, clip or drawable changes, or when fltk::flush() is done.
+// Overlapping fills are not batched because the trapezoids of one call
+// are added together, rather than each being blended on the last.
+
+extern float fl_current_alpha; // in x11/setcolor.cxx
+
+// The Path that loaded the current points, and how far they were moved:
+static Path* loaded_path;
+static int loaded_dx, loaded_dy, loaded_points, loaded_loops;
+
+struct TrapEdge {
+  int x1, y1, x2, y2; // y1 < y2
+  double x, xb; // x at top and bottom of the current band
+};
+
+static TrapEdge* edges;
+static TrapEdge** active;
+static int edges_size;
+static XTrapezoid* traps;
+static int traps_size;
+
+static inline double edge_x(const TrapEdge* e, double y) {
+  return e->x1 + (e->x2-e->x1)*(y-e->y1)/(e->y2-e->y1);
+}
+
+static int edge_compare(const void* a, const void* b) {
+  return ((const TrapEdge*)a)->y1 - ((const TrapEdge*)b)->y1;
+}
+
+// Edges that meet at the top of a band are ordered by their bottom:
+static inline bool edge_before(const TrapEdge* a, const TrapEdge* b) {
+  if (a->x < b->x-1e-6) return true;
+  if (a->x > b->x+1e-6) return false;
+  return a->xb < b->xb;
+}
+
+static void add_trapezoid(int& n, double top, double bottom,
+			  const TrapEdge* l, const TrapEdge* r) {
+  if (n >= traps_size) {
+    traps_size = traps_size ? 2*traps_size : 64;
+    XTrapezoid* newtraps = new XTrapezoid[traps_size];
+    memcpy(newtraps, traps, n*sizeof(XTrapezoid));
+    delete[] traps;
+    traps = newtraps;
+  }
+  XTrapezoid& t = traps[n++];
+  t.top = XDoubleToFixed(top);
+  t.bottom = XDoubleToFixed(bottom);
+  t.left.p1.x = XDoubleToFixed(l->x1); t.left.p1.y = XDoubleToFixed(l->y1);
+  t.left.p2.x = XDoubleToFixed(l->x2); t.left.p2.y = XDoubleToFixed(l->y2);
+  t.right.p1.x = XDoubleToFixed(r->x1); t.right.p1.y = XDoubleToFixed(r->y1);
+  t.right.p2.x = XDoubleToFixed(r->x2); t.right.p2.y = XDoubleToFixed(r->y2);
+}
+
+// Cut the closed loops of the current path into trapezoids, using the
+// even/odd rule like XFillPolygon does. The path is swept downwards in
+// bands that end at every vertex and every crossing of two edges, so
+// inside each band the edges are in the same order from left to right.
+// Returns the number of trapezoids put into traps:
+static int tessellate() {
+  if (numpoints > edges_size) {
+    delete[] edges;
+    delete[] active;
+    edges_size = numpoints;
+    edges = new TrapEdge[edges_size];
+    active = new TrapEdge*[edges_size];
+  }
+  int ne = 0;
+  int start = 0;
+  for (int l = 0; l < loops; l++) {
+    int end = start+loop[l];
+    for (int i = start; i+1 < end; i++) {
+      const XPoint& p = xpoint[i];
+      const XPoint& q = xpoint[i+1];
+      if (p.y == q.y) continue;
+      TrapEdge& e = edges[ne++];
+      if (p.y < q.y) {e.x1 = p.x; e.y1 = p.y; e.x2 = q.x; e.y2 = q.y;}
+      else {e.x1 = q.x; e.y1 = q.y; e.x2 = p.x; e.y2 = p.y;}
+    }
+    start = end;
+  }
+  qsort(edges, ne, sizeof(TrapEdge), edge_compare);
+
+  int n = 0;
+  int nactive = 0;
+  int next = 0; // first edge not added yet
+  double y = ne ? edges[0].y1 : 0;
+  while (next < ne || nactive) {
+    while (next < ne && edges[next].y1 <= y) active[nactive++] = &edges[next++];
+    int j = 0;
+    for (int i = 0; i < nactive; i++) if (active[i]->y2 > y) active[j++] = active[i];
+    nactive = j;
+    if (!nactive) {
+      if (next >= ne) break;
+      y = edges[next].y1;
+      continue;
+    }
+    // the band ends at the next vertex:
+    double bottom = next < ne ? edges[next].y1 : active[0]->y2;
+    for (int i = 0; i < nactive; i++)
+      if (active[i]->y2 < bottom) bottom = active[i]->y2;
+    for (int i = 0; i < nactive; i++) {
+      TrapEdge* e = active[i];
+      e->x = edge_x(e, y);
+      e->xb = edge_x(e, bottom);
+    }
+    // insertion sort, as the order changes little from band to band:
+    for (int i = 1; i < nactive; i++) {
+      TrapEdge* e = active[i];
+      int k = i;
+      for (; k > 0 && edge_before(e, active[k-1]); k--) active[k] = active[k-1];
+      active[k] = e;
+    }
+    // or at the first crossing, which is always of two neighbors:
+    double band = bottom;
+    for (int i = 0; i+1 < nactive; i++) {
+      const TrapEdge* a = active[i];
+      const TrapEdge* b = active[i+1];
+      if (a->xb <= b->xb) continue;
+      double d0 = a->x-b->x;
+      double d1 = a->xb-b->xb;
+      double c = y+(band-y)*(-d0)/(d1-d0);
+      if (c > y && c < bottom) bottom = c;
+    }
+    for (int i = 0; i+1 < nactive; i += 2)
+      add_trapezoid(n, y, bottom, active[i], active[i+1]);
+    y = bottom;
+  }
+  return n;
+}
+
+static void copy_trapezoids(XTrapezoid* to, const XTrapezoid* from, int n,
+			    int dx, int dy) {
+  if (!dx && !dy) {memcpy(to, from, n*sizeof(XTrapezoid)); return;}
+  const XFixed fx = XDoubleToFixed(dx);
+  const XFixed fy = XDoubleToFixed(dy);
+  for (int i = 0; i < n; i++) {
+    XTrapezoid& t = to[i];
+    t = from[i];
+    t.top += fy; t.bottom += fy;
+    t.left.p1.x += fx; t.left.p1.y += fy; t.left.p2.x += fx; t.left.p2.y += fy;
+    t.right.p1.x += fx; t.right.p1.y += fy; t.right.p2.x += fx; t.right.p2.y += fy;
+  }
+}
+
+enum {BATCH_BOXES = 64};
+static XTrapezoid* batch;
+static int batch_n, batch_size;
+static Color batch_color;
+static float batch_alpha;
+static Rectangle batch_box[BATCH_BOXES];
+static int batch_boxes;
+
+// Draw the saved alpha fills:
+void fl_flush_trapezoids() {
+  if (!batch_n) return;
+  ::Picture dest = xftc ? XftDrawPicture(xftc) : 0;
+  if (dest) {
+    static XRenderPictFormat* mask_format;
+    if (!mask_format)
+      mask_format = XRenderFindStandardFormat(xdisplay, PictStandardA8);
+    // XRender wants the color premultiplied by the alpha:
+    XftColor color;
+    uchar r,g,b; split_color(batch_color, r,g,b);
+    unsigned a = unsigned(batch_alpha*0xffff+.5f);
+    color.pixel = xpixel(batch_color);
+    color.color.red   = (unsigned short)(r*0x101*a/0xffff);
+    color.color.green = (unsigned short)(g*0x101*a/0xffff);
+    color.color.blue  = (unsigned short)(b*0x101*a/0xffff);
+    color.color.alpha = (unsigned short)a;
+    XRenderCompositeTrapezoids(xdisplay, PictOpOver,
+			       XftDrawSrcPicture(xftc, &color), dest,
+			       mask_format, 0, 0, batch, batch_n);
+  }
+  batch_n = batch_boxes = 0;
+}
+
+static inline bool overlaps(const Rectangle& a, const Rectangle& b) {
+  return a.x() < b.r() && b.x() < a.r() && a.y() < b.b() && b.y() < a.b();
+}
+
+static void batch_trapezoids(const XTrapezoid* t, int n, int dx, int dy,
+			     const Rectangle& box) {
+  if (batch_n) {
+    bool flush = batch_color != current_color_ ||
+      batch_alpha != fl_current_alpha || batch_boxes >= BATCH_BOXES;
+    for (int i = 0; i < batch_boxes && !flush; i++)
+      if (overlaps(batch_box[i], box)) flush = true;
+    if (flush) fl_flush_trapezoids();
+  }
+  if (batch_n+n > batch_size) {
+    batch_size = batch_size ? 2*batch_size : 256;
+    if (batch_n+n > batch_size) batch_size = batch_n+n;
+    XTrapezoid* newbatch = new XTrapezoid[batch_size];
+    memcpy(newbatch, batch, batch_n*sizeof(XTrapezoid));
+    delete[] batch;
+    batch = newbatch;
+  }
+  copy_trapezoids(batch+batch_n, t, n, dx, dy);
+  batch_n += n;
+  batch_color = current_color_;
+  batch_alpha = fl_current_alpha;
+  batch_box[batch_boxes++] = box;
+}
+
+static Rectangle path_bounds() {
+  int x = xpoint[0].x, y = xpoint[0].y, r = x, b = y;
+  for (int i = 1; i < numpoints; i++) {
+    const XPoint& p = xpoint[i];
+    if (p.x < x) x = p.x; else if (p.x > r) r = p.x;
+    if (p.y < y) y = p.y; else if (p.y > b) b = p.y;
+  }
+  return Rectangle(x, y, r-x+1, b-y+1);
+}
+#endif
+
 static inline void inline_newpath() {
 #if USE_CAIRO
   cairo_new_path(cr);
@@ -672,6 +999,9 @@ static inline void inline_newpath() {
 #else
   numpoints = loop_start = loops = 0;
   circle_type = NONE;
+#if USE_XFT
+  loaded_path = 0;
+#endif
 #endif
 }
 
@@ -683,6 +1013,108 @@ void fltk::newpath() {inline_newpath();}
 
 ////////////////////////////////////////////////////////////////
 
+/*! \class fltk::Path
+
+  Keeps a path that is drawn many times, so the curves and arcs in it
+  are not calculated again each time. The constructor takes a function
+  that makes the path with the normal functions such as addvertex(),
+  addcurve() and closepath(). load() calls it if needed and makes the
+  result the current path, which can then be drawn with fillpath() or
+  strokepath():
+
+\code
+static void make_coastline(void* data) {
+  Map* map = (Map*)data;
+  for (int i = 0; i < map->segments; i++) {
+    const float* p = map->segment[i];
+    addcurve(p[0],p[1], p[2],p[3], p[4],p[5], p[6],p[7]);
+  }
+  closepath();
+}
+
+void MapWidget::draw() {
+  push_matrix();
+  scale(zoom);
+  coastline.load(); // coastline is a Path(make_coastline, &map)
+  setcolor(BLACK);
+  strokepath();
+  pop_matrix();
+}
+\endcode
+
+  The transformed points are saved, and are reused as long as the
+  current transformation only differs by an integer translation from
+  the one they were made with. Otherwise the function is called again,
+  so curves are calculated for the new scale. Call changed() if the
+  data the function uses changes.
+
+  On systems that store the path themselves (Cairo and Quartz) nothing
+  is saved and load() always calls the function.
+*/
+
+/*! Make a Path built by calling \a build with \a data. */
+Path::Path(void (*build)(void*), void* data)
+  : build_(build), data_(data), xy_(0), n_(0), loops_(0), size_(0),
+    traps_(0), ntraps_(-1), valid_(false) {}
+
+Path::~Path() {delete[] xy_; delete[] traps_;}
+
+/*!
+  Replace the current path with this one. This only calls the build
+  function the first time, after changed(), or if the transformation
+  has been changed by more than an integer translation.
+*/
+void Path::load() {
+#if !USE_CAIRO && !USE_QUARTZ
+  if (valid_ && m.a == matrix_[0] && m.b == matrix_[1] &&
+      m.c == matrix_[2] && m.d == matrix_[3]) {
+    float fx = m.x-matrix_[4];
+    float fy = m.y-matrix_[5];
+    int dx = int(fx);
+    int dy = int(fy);
+    if (dx == fx && dy == fy) {
+      fl_set_path(xy_, n_, xy_+2*n_, loops_, circle_, angles_, dx, dy);
+#if USE_XFT
+      loaded_path = this;
+      loaded_dx = dx; loaded_dy = dy;
+      loaded_points = n_; loaded_loops = loops_;
+#endif
+      return;
+    }
+  }
+#endif
+  inline_newpath();
+  build_(data_);
+#if !USE_CAIRO && !USE_QUARTZ
+  int loops;
+  int n = fl_path_size(loops);
+  if (2*n+loops > size_) {
+    delete[] xy_;
+    size_ = 2*n+loops;
+    xy_ = new int[size_];
+  }
+  fl_get_path(xy_, xy_+2*n, circle_, angles_);
+  n_ = n;
+  loops_ = loops;
+  matrix_[0] = m.a; matrix_[1] = m.b; matrix_[2] = m.c; matrix_[3] = m.d;
+  matrix_[4] = m.x; matrix_[5] = m.y;
+  valid_ = true;
+#if USE_XFT
+  ntraps_ = -1;
+  loaded_path = this;
+  loaded_dx = loaded_dy = 0;
+  loaded_points = n; loaded_loops = loops;
+#endif
+#endif
+}
+
+/*! \fn void Path::changed()
+  Make the next load() call the build function again, because the
+  data it uses has changed.
+*/
+
+////////////////////////////////////////////////////////////////
+
 #if 0
 // removed as it is difficult to emulate except on OpenGL
 /**
@@ -711,11 +1143,15 @@ void fltk::drawpoints() {
   the line), then clear the path.
 */
 void fltk::strokepath() {
+  if (fl_display_list) fl_display_list->path(0, 0);
 #if USE_CAIRO
   cairo_stroke(cr);
 #elif USE_QUARTZ
   CGContextStrokePath(quartz_gc);
 #elif USE_X11
+#if USE_XFT
+  fl_flush_trapezoids();
+#endif
   if (circle_type) {
     int A = int(circle_start*64);
     int B = int(circle_end*64)-A;
@@ -778,11 +1214,40 @@ void fltk::strokepath() {
   making the current pen invisible?
 */
 void fltk::fillpath() {
+  if (fl_display_list) fl_display_list->path(1, 0);
 #if USE_CAIRO
   cairo_fill(cr);
 #elif USE_QUARTZ
   CGContextFillPath(quartz_gc);
 #elif USE_X11
+#if USE_XFT
+  if (fl_current_alpha < 1 && !circle_type && xftc && XftDrawPicture(xftc)) {
+    // the Path that made these points, unless more were added:
+    Path* path = loaded_path && numpoints == loaded_points &&
+      loops == loaded_loops ? loaded_path : 0;
+    closepath();
+    if (fl_current_alpha > 0 && numpoints > 2) {
+      if (path && path->ntraps_ >= 0) {
+	batch_trapezoids((XTrapezoid*)path->traps_, path->ntraps_,
+			 loaded_dx, loaded_dy, path_bounds());
+      } else {
+	int n = tessellate();
+	if (path) {
+	  // save them where they would be without the integer translation:
+	  delete[] path->traps_;
+	  path->traps_ = new int[n*(sizeof(XTrapezoid)/sizeof(int))];
+	  copy_trapezoids((XTrapezoid*)path->traps_, traps, n,
+			  -loaded_dx, -loaded_dy);
+	  path->ntraps_ = n;
+	}
+	batch_trapezoids(traps, n, 0, 0, path_bounds());
+      }
+    }
+    inline_newpath();
+    return;
+  }
+  fl_flush_trapezoids();
+#endif
   if (circle_type) {
     int A = int(circle_start*64);
     int B = int(circle_end*64)-A;
@@ -847,6 +1312,15 @@ void fltk::fillpath() {
   be faster.
 */
 void fltk::fillstrokepath(Color color) {
+  if (fl_display_list) {
+    // record it once, not again for the strokepath() this calls:
+    DisplayList* d = fl_display_list;
+    d->path(2, color);
+    fl_display_list = 0;
+    fillstrokepath(color);
+    fl_display_list = d;
+    return;
+  }
 #if USE_CAIRO
   closepath();
   cairo_fill_preserve(cr);
@@ -860,6 +1334,9 @@ void fltk::fillstrokepath(Color color) {
   setcolor(color);
   inline_newpath();
 #elif USE_X11
+#if USE_XFT
+  fl_flush_trapezoids();
+#endif
   if (circle_type && circle.w()>1 && circle.h()>1) {
     int A = int(circle_start*64);
     int B = int(circle_end*64)-A;
@@ -39,10 +39,16 @@
 #include <fltk/Style.h>
 #include <fltk/Tooltip.h>
 #include <fltk/filename.h>
+#include <fltk/trace.h>
+#include "DisplayList.h"
+#include "DamageRects.h"
 
 #if defined(__APPLE__)
 #include <sys/time.h>
 #endif
+#if HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
 
 #if defined(_WIN32) && USE_MULTIMONITOR && WINVER<0x0500
 // Make the headers declare the functions needed for multimonitor:
@@ -89,6 +95,64 @@ const char *fltk::e_text = "";
 bool      fltk::grab_,
 	  fltk::exit_modal_;
 
+// Mouse positions merged into the current MOVE or DRAG:
+bool fl_keep_motion_history;
+int fl_motion_history_count;
+static MotionSample* motion_history;
+enum {MAX_MOTION_HISTORY = 256};
+
+/*!
+  If \a on is true, the system code remembers every mouse position,
+  along with the tablet pressure and tilt, that it merges together into
+  a single MOVE or DRAG event. Programs that draw with a tablet can use
+  event_motion_history() to get all of them rather than only the last.
+  This is off by default.
+*/
+void fltk::keep_motion_history(bool on) {
+  fl_keep_motion_history = on;
+  fl_motion_history_count = 0;
+}
+
+/*!
+  During a MOVE or DRAG event, set \a samples to point at the mouse
+  positions that were merged into this event, oldest first, and return
+  how many there are. The last one is the position reported by
+  event_x() and event_y(). Returns 0 for other events, if
+  keep_motion_history() is off, or if the system did not merge any
+  events, in which case the event_x(), event_pressure(), etc of the
+  current event are the only information.
+
+  The x and y are relative to the window. To convert to the coordinates
+  of the widget handling the event add event_x()-event_x_root() to
+  x_root and y_root.
+*/
+int fltk::event_motion_history(const MotionSample*& samples) {
+  samples = motion_history;
+  return (e_type == MOVE || e_type == DRAG) ? fl_motion_history_count : 0;
+}
+
+// Called by the system code for each motion event it merges, using
+// the e_x, e_pressure, etc it just set:
+void fl_add_motion_sample(unsigned long time) {
+  if (!motion_history)
+    motion_history = new MotionSample[MAX_MOTION_HISTORY];
+  if (fl_motion_history_count >= MAX_MOTION_HISTORY) {
+    // throw away the oldest half so this is not done very often:
+    fl_motion_history_count = MAX_MOTION_HISTORY/2;
+    memmove(motion_history, motion_history+MAX_MOTION_HISTORY/2,
+	    fl_motion_history_count*sizeof(MotionSample));
+  }
+  MotionSample& m = motion_history[fl_motion_history_count++];
+  m.x = e_x;
+  m.y = e_y;
+  m.x_root = e_x_root;
+  m.y_root = e_y_root;
+  m.time = time;
+  m.pressure = e_pressure;
+  m.x_tilt = e_x_tilt;
+  m.y_tilt = e_y_tilt;
+}
+
 static Window *xfocus;	// which window X thinks has focus
 static Window *xmousewin; // which window X thinks has ENTER
 
@@ -167,16 +231,34 @@ bool Widget::take_focus() {
 #endif
 
 ////////////////////////////////////////////////////////////////
-// Timeouts are stored in a sorted list, so only the first one needs
-// to be checked to see if any should be called.
+// Timeouts are stored in a binary heap ordered by their absolute
+// deadline, so only the top one needs to be checked to see if any
+// should be called. Deadlines are measured with a monotonic clock so
+// changing the system time does not disturb them.
+//
+// The Timeout structures live in an array of "slots" that is reused,
+// each one remembers where it is in the heap so it can be removed in
+// O(log n), and a TimeoutId names the slot directly so it can be
+// found in O(1). A serial number that is bumped every time the slot
+// is reused is put in the upper bits of the id so stale ids do not
+// match.
 
 struct Timeout {
-  double time;
+  double time;		// absolute deadline from monotonic_time()
   void (*cb)(void*);
   void* arg;
-  Timeout* next;
+  int heap_index;	// position in timeout_heap, -1 if slot is free
+  unsigned serial;	// changed each time the slot is reused
 };
-static Timeout* first_timeout, *free_timeout;
+static Timeout* timeout_slot;	// all Timeout structures
+static int* timeout_heap;	// indexes into timeout_slot, in heap order
+static int* free_slot;		// stack of unused indexes into timeout_slot
+static int num_timeouts;	// number of entries in timeout_heap
+static int num_free_slots;	// number of entries in free_slot
+static int timeout_array_size;	// allocated size of all three arrays
+
+#define TIMEOUT_SLOT_BITS 20
+#define TIMEOUT_SLOT_MASK ((1UL<<TIMEOUT_SLOT_BITS)-1)
 
 /** Return portable time that increases by 1.0 each second.
 
@@ -201,43 +283,134 @@ double fltk::get_time_secs() {
 #endif
 }
 
-static void elapse_timeouts() {
-  static double prev = 0;
-  double now = get_time_secs();
-  double elapsed = now-prev;
-  prev = now;
-  for (Timeout* t = first_timeout; t; t = t->next) t->time -= elapsed;
+// Same as get_time_secs() except it never jumps when the user or ntp
+// changes the clock. Only differences between these values mean anything.
+static double monotonic_time() {
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + double(ts.tv_nsec)/1000000000.0;
+#else
+  return get_time_secs(); // GetTickCount() is already monotonic on Windows
+#endif
 }
 
-// Continuously-adjusted error value, this is a number <= 0 for how late
-// we were at calling the last timeout. This appears to make repeat_timeout
-// very accurate even when processing takes a significant portion of the
-// time interval:
-static double missed_timeout_by;
+/*! Returns the time in seconds used by fltk::trace(). This comes from
+  a clock that is not changed when the system time is set, so only the
+  difference between two values means anything. */
+double fltk::trace_time() {
+  return monotonic_time();
+}
 
-static void _add_timeout(double time, TimeoutHandler cb, void *arg) {
-  if (time < -.05) time = 0; // prevent missed_timeout_by from accumulating
-  Timeout* t = free_timeout;
-  if (t) free_timeout = t->next;
-  else t = new Timeout;
-  t->time = time;
-  t->cb = cb;
-  t->arg = arg;
-  // insert-sort the new timeout:
-  Timeout** p = &first_timeout;
-  while (*p && (*p)->time <= time) p = &((*p)->next);
-  t->next = *p;
-  *p = t;
+static inline bool timeout_before(int a, int b) {
+  return timeout_slot[timeout_heap[a]].time < timeout_slot[timeout_heap[b]].time;
+}
+
+static inline void timeout_swap(int a, int b) {
+  int t = timeout_heap[a]; timeout_heap[a] = timeout_heap[b]; timeout_heap[b] = t;
+  timeout_slot[timeout_heap[a]].heap_index = a;
+  timeout_slot[timeout_heap[b]].heap_index = b;
+}
+
+static void timeout_sift_up(int i) {
+  while (i > 0) {
+    int parent = (i-1)/2;
+    if (!timeout_before(i, parent)) break;
+    timeout_swap(i, parent);
+    i = parent;
+  }
+}
+
+static void timeout_sift_down(int i) {
+  for (;;) {
+    int child = 2*i+1;
+    if (child >= num_timeouts) break;
+    if (child+1 < num_timeouts && timeout_before(child+1, child)) child++;
+    if (!timeout_before(child, i)) break;
+    timeout_swap(i, child);
+    i = child;
+  }
+}
+
+// Remove the timeout at heap position i and put it's slot on the free list:
+static void timeout_remove_at(int i) {
+  int slot = timeout_heap[i];
+  timeout_slot[slot].heap_index = -1;
+  free_slot[num_free_slots++] = slot;
+  if (i != --num_timeouts) {
+    timeout_heap[i] = timeout_heap[num_timeouts];
+    timeout_slot[timeout_heap[i]].heap_index = i;
+    timeout_sift_down(i);
+    timeout_sift_up(i);
+  }
+}
+
+static inline TimeoutId timeout_id(int slot) {
+  return ((unsigned long)timeout_slot[slot].serial << TIMEOUT_SLOT_BITS) | slot;
+}
+
+// Return the slot an id refers to, or -1 if it is not pending:
+static int timeout_find(TimeoutId id) {
+  if (!id) return -1;
+  int slot = int(id & TIMEOUT_SLOT_MASK);
+  if (slot >= timeout_array_size) return -1;
+  Timeout& t = timeout_slot[slot];
+  if (t.heap_index < 0 || timeout_id(slot) != id) return -1;
+  return slot;
+}
+
+// Deadline of the timeout whose callback is being called, so
+// repeat_timeout() can measure from it. Only valid if in_timeout:
+static double repeat_base;
+static bool in_timeout;
+
+static TimeoutId _add_timeout(double time, TimeoutHandler cb, void *arg) {
+  double now = monotonic_time();
+  if (time < now-.05) time = now; // prevent lateness from accumulating
+  if (!num_free_slots) {
+    // a TimeoutId only has room for TIMEOUT_SLOT_BITS of slot number:
+    if (timeout_array_size > int(TIMEOUT_SLOT_MASK)) {
+      warning("fltk: too many timeouts");
+      return 0;
+    }
+    int n = timeout_array_size ? 2*timeout_array_size : 16;
+    timeout_slot = (Timeout*)realloc(timeout_slot, n*sizeof(Timeout));
+    timeout_heap = (int*)realloc(timeout_heap, n*sizeof(int));
+    free_slot = (int*)realloc(free_slot, n*sizeof(int));
+    for (int i = n; i-- > timeout_array_size;) {
+      timeout_slot[i].heap_index = -1;
+      timeout_slot[i].serial = 0;
+      free_slot[num_free_slots++] = i;
+    }
+    timeout_array_size = n;
+  }
+  int slot = free_slot[--num_free_slots];
+  Timeout& t = timeout_slot[slot];
+  t.time = time;
+  t.cb = cb;
+  t.arg = arg;
+  // make the id different from any previous one for this slot, and nonzero:
+  if (!++t.serial || !timeout_id(slot)) t.serial = 1;
+  t.heap_index = num_timeouts;
+  timeout_heap[num_timeouts++] = slot;
+  timeout_sift_up(t.heap_index);
+  return timeout_id(slot);
 }
 
 /*!
   Add a one-shot timeout callback. The function will be called by
   fltk::wait() at t seconds after this function is called. The
   optional void* argument is passed to the callback.
+
+  About a million timeouts can be pending at once. Past that this
+  prints a warning(), does not add it, and returns zero.
+
+  The returned value can be passed to has_timeout(TimeoutId) and
+  remove_timeout(TimeoutId), which are much faster than searching
+  for the function and argument when there are many timeouts.
 */
-void fltk::add_timeout(float time, TimeoutHandler cb, void *arg) {
-  elapse_timeouts();
-  _add_timeout(time, cb, arg);
+TimeoutId fltk::add_timeout(float time, TimeoutHandler cb, void *arg) {
+  return _add_timeout(monotonic_time()+time, cb, arg);
 }
 
 /*!
@@ -265,33 +438,152 @@ main() {
 }
 \endcode
 */
-void fltk::repeat_timeout(float time, TimeoutHandler cb, void *arg) {
-  _add_timeout(time+missed_timeout_by, cb, arg);
+TimeoutId fltk::repeat_timeout(float time, TimeoutHandler cb, void *arg) {
+  if (!in_timeout) return add_timeout(time, cb, arg);
+  return _add_timeout(repeat_base+time, cb, arg);
 }
 
 /*!
  Returns true if the timeout exists and has not been called yet.
 */
 bool fltk::has_timeout(TimeoutHandler cb, void *arg) {
-  for (Timeout* t = first_timeout; t; t = t->next)
-    if (t->cb == cb && t->arg == arg) return true;
+  for (int i = 0; i < num_timeouts; i++) {
+    Timeout& t = timeout_slot[timeout_heap[i]];
+    if (t.cb == cb && t.arg == arg) return true;
+  }
   return false;
 }
 
+/*!
+  Returns true if the timeout returned by add_timeout() or
+  repeat_timeout() has not been called or removed yet.
+*/
+bool fltk::has_timeout(TimeoutId id) {
+  return timeout_find(id) >= 0;
+}
+
 /*!
   Removes all pending timeout callbacks that match the function and arg.
   Does nothing if there are no matching ones that have not been
   called yet.
 */
 void fltk::remove_timeout(TimeoutHandler cb, void *arg) {
-  for (Timeout** p = &first_timeout; *p;) {
-    Timeout* t = *p;
-    if (t->cb == cb && t->arg == arg) {
-      *p = t->next;
-      t->next = free_timeout;
-      free_timeout = t;
-    } else {
-      p = &(t->next);
+  // removing one reorders the heap, but the slots stay where they are:
+  for (int slot = 0; slot < timeout_array_size; slot++) {
+    Timeout& t = timeout_slot[slot];
+    if (t.heap_index >= 0 && t.cb == cb && t.arg == arg)
+      timeout_remove_at(t.heap_index);
+  }
+}
+
+/*!
+  Removes the timeout returned by add_timeout() or repeat_timeout().
+  Does nothing if it has already been called or removed.
+*/
+void fltk::remove_timeout(TimeoutId id) {
+  int slot = timeout_find(id);
+  if (slot >= 0) timeout_remove_at(timeout_slot[slot].heap_index);
+}
+
+////////////////////////////////////////////////////////////////
+// Timer groups share a single repeating timeout between all the
+// callbacks that want the same period, so a screen full of blinking
+// or animated widgets wakes up once per tick instead of once per
+// widget. They are stored in a list as there are only a few distinct
+// periods in a program. Empty groups are kept for reuse.
+
+struct TimerGroupMember {
+  TimeoutHandler cb;
+  void* arg;
+};
+
+struct TimerGroup {
+  float period;
+  TimeoutId timeout;	// zero when there are no members
+  TimerGroupMember* member;
+  int members;
+  int array_size;
+  int next_member;	// next one to call, so callbacks can remove members
+  TimerGroup* next;
+};
+static TimerGroup* first_timer_group;
+
+static void timer_group_cb(void* v) {
+  TimerGroup* g = (TimerGroup*)v;
+  g->timeout = repeat_timeout(g->period, timer_group_cb, g);
+  for (g->next_member = 0; g->next_member < g->members;) {
+    TimerGroupMember& m = g->member[g->next_member++];
+    m.cb(m.arg);
+  }
+}
+
+/*!
+  Call \a cb every \a period seconds, sharing a single timeout with
+  all other callbacks added with exactly the same period. All the
+  callbacks in a group are called together, in the order they were
+  added, and the display is only flushed once after all of them
+  have been done (by fltk::wait() as usual).
+
+  This is much more efficient than having each of many widgets call
+  repeat_timeout() for themselves. The callback keeps getting
+  called until remove_timer_group() is done, it is not necessary
+  to add it again.
+
+  The first call will be done \a period seconds after the first
+  callback was added to the group, so callbacks added later may be
+  called sooner than \a period after they were added.
+*/
+void fltk::add_timer_group(float period, TimeoutHandler cb, void* arg) {
+  TimerGroup* g;
+  for (g = first_timer_group; g; g = g->next)
+    if (g->period == period) break;
+  if (!g) {
+    g = new TimerGroup;
+    g->period = period;
+    g->timeout = 0;
+    g->member = 0;
+    g->members = g->array_size = g->next_member = 0;
+    g->next = first_timer_group;
+    first_timer_group = g;
+  }
+  if (g->members >= g->array_size) {
+    g->array_size = g->array_size ? 2*g->array_size : 16;
+    g->member = (TimerGroupMember*)
+      realloc(g->member, g->array_size*sizeof(TimerGroupMember));
+  }
+  TimerGroupMember& m = g->member[g->members++];
+  m.cb = cb;
+  m.arg = arg;
+  if (!g->timeout) g->timeout = add_timeout(period, timer_group_cb, g);
+}
+
+/*!
+  Return true if add_timer_group() has been done with this \a cb and
+  \a arg and it has not been removed.
+*/
+bool fltk::has_timer_group(TimeoutHandler cb, void* arg) {
+  for (TimerGroup* g = first_timer_group; g; g = g->next)
+    for (int i = 0; i < g->members; i++)
+      if (g->member[i].cb == cb && g->member[i].arg == arg) return true;
+  return false;
+}
+
+/*!
+  Remove all matching callbacks from all the timer groups. You can
+  call this from inside the callback if you want.
+*/
+void fltk::remove_timer_group(TimeoutHandler cb, void* arg) {
+  for (TimerGroup* g = first_timer_group; g; g = g->next) {
+    for (int i = g->members; i--;) {
+      if (g->member[i].cb != cb || g->member[i].arg != arg) continue;
+      g->members--;
+      memmove(g->member+i, g->member+i+1,
+	      (g->members-i)*sizeof(TimerGroupMember));
+      if (i < g->next_member) g->next_member--;
+    }
+    if (!g->members && g->timeout) {
+      remove_timeout(g->timeout);
+      g->timeout = 0;
     }
   }
 }
@@ -387,8 +679,128 @@ void (*fltk::idle)(); // see add_idle.cxx for the add/remove functions
 
 static bool in_idle;
 
+// set by fltk::post() in lock.cxx when there are calls to do:
+volatile int fl_posted_pending;
+void (*fl_do_posted_calls)();
+
 #define FOREVER 1e20f
 
+////////////////////////////////////////////////////////////////
+// Frame clock: when frame_interval() is set, or there are frame
+// callbacks, wait() draws the windows at most once per frame instead
+// of every time it is called. Frame callbacks are in two lists so
+// ones added by a frame callback are called by the next frame.
+
+struct FrameCallback {
+  TimeoutHandler cb;
+  void* arg;
+};
+static struct FrameList {
+  FrameCallback* item;
+  int n;
+  int size;
+} frame_list[2];
+static FrameList* pending_frames = frame_list; // called by the next frame
+static FrameList* calling_frames;	// being called right now
+static float frame_interval_ = 0;
+static double next_frame_time;	// monotonic_time() of the next frame
+
+/*!
+  Set the shortest time between drawings of the windows by
+  fltk::wait(). Damage done by a burst of events is then drawn once
+  per frame. Set this to the refresh interval of the screen, such as
+  1/60 second, to avoid drawing more often than it can be seen.
+  The default is zero, which draws every time wait() is called.
+  Calling fltk::flush() directly always draws at once.
+*/
+void fltk::frame_interval(float t) {frame_interval_ = t;}
+
+/*! Return the value set by frame_interval(). */
+float fltk::frame_interval() {return frame_interval_;}
+
+/*!
+  Call \a cb once, just before the windows are drawn for the next
+  frame. Call this again from the callback to animate something, it
+  is then called once per frame. This replaces a repeat_timeout()
+  loop for animation, and all the animations are done together right
+  before the drawing. Frames are frame_interval() seconds apart, or
+  1/60 second if that is zero.
+*/
+void fltk::add_frame_callback(TimeoutHandler cb, void* arg) {
+  FrameList& l = *pending_frames;
+  if (l.n >= l.size) {
+    l.size = l.size ? 2*l.size : 16;
+    l.item = (FrameCallback*)realloc(l.item, l.size*sizeof(FrameCallback));
+  }
+  l.item[l.n].cb = cb;
+  l.item[l.n].arg = arg;
+  l.n++;
+}
+
+/*!
+  Return true if add_frame_callback() has been done with this \a cb
+  and \a arg and it has not been called or removed.
+*/
+bool fltk::has_frame_callback(TimeoutHandler cb, void* arg) {
+  for (int i = 0; i < pending_frames->n; i++)
+    if (pending_frames->item[i].cb == cb && pending_frames->item[i].arg == arg)
+      return true;
+  return false;
+}
+
+/*! Remove all frame callbacks that match the function and argument. */
+void fltk::remove_frame_callback(TimeoutHandler cb, void* arg) {
+  FrameList& l = *pending_frames;
+  int j = 0;
+  for (int i = 0; i < l.n; i++)
+    if (l.item[i].cb != cb || l.item[i].arg != arg) l.item[j++] = l.item[i];
+  l.n = j;
+  // don't call any that are still waiting in the current frame:
+  if (calling_frames)
+    for (int i = 0; i < calling_frames->n; i++)
+      if (calling_frames->item[i].cb == cb && calling_frames->item[i].arg == arg)
+	calling_frames->item[i].cb = 0;
+}
+
+static bool frame_paced() {return frame_interval_ > 0 || pending_frames->n;}
+
+// Seconds until the next frame should be drawn, if wait() has
+// something to draw then:
+static float time_to_frame() {
+  if (!frame_paced() || (!damage_ && !pending_frames->n)) return FOREVER;
+  return float(next_frame_time - monotonic_time());
+}
+
+// Replaces flush() in wait():
+static void frame_flush() {
+  if (!frame_paced()) {flush(); return;}
+  double now = monotonic_time();
+  if (now < next_frame_time || (!damage_ && !pending_frames->n)) {
+    // still send the X requests and fix the cursor, but draw nothing:
+    int saved = damage_; damage_ = 0;
+    flush();
+    damage_ = saved;
+    return;
+  }
+  double period = frame_interval_ > 0 ? frame_interval_ : 1.0/60;
+  // stay on the same grid of frames unless the last one was missed:
+  next_frame_time += period;
+  if (next_frame_time <= now) next_frame_time = now + period;
+  if (pending_frames->n) {
+    calling_frames = pending_frames;
+    pending_frames = frame_list + (calling_frames == frame_list);
+    for (int i = 0; i < calling_frames->n; i++) {
+      FrameCallback& f = calling_frames->item[i];
+      if (!f.cb) continue;
+      TraceScope trace(TRACE_TIMEOUT, "frame", (const void*)f.cb);
+      f.cb(f.arg);
+    }
+    calling_frames->n = 0;
+    calling_frames = 0;
+  }
+  flush();
+}
+
 /*!
   Calls fltk::wait() as long as any windows are not closed. When
   all the windows are hidden or destroyed (checked by seeing if
@@ -422,6 +834,7 @@ static void run_checks() {
     while (next_check) {
       Check* check = next_check;
       next_check = check->next;
+      TraceScope trace(TRACE_CHECK, "check", (const void*)check->cb);
       (check->cb)(check->arg);
     }
     next_check = first_check;
@@ -449,43 +862,55 @@ int fltk::wait(float time_to_wait) {
   // check functions must be run first so they can install idle or timeout
   // functions:
   run_checks();
-  flush();
+  frame_flush();
 
   // delete all widgets that were listed during callbacks
   //do_widget_deletion(); // fabien: removed by Bill
 
-  if (first_timeout) {
-    elapse_timeouts();
-    float t = float(first_timeout->time);
+  if (num_timeouts) {
+    float t = float(timeout_slot[timeout_heap[0]].time - monotonic_time());
     if (t < time_to_wait) time_to_wait = t;
   }
+  float f = time_to_frame();
+  if (f < time_to_wait) time_to_wait = f;
 
   // run the system-specific part that waits for sockets & events:
   if (time_to_wait <= 0 || (idle && !in_idle)) time_to_wait = 0;
   int ret = fl_wait(time_to_wait);
 
-  if (first_timeout) {
-    elapse_timeouts();
-    Timeout *t;
-    while ((t = first_timeout)) {
-      if (t->time > 0) break;
-      // We must remove timeout from array before doing the callback
-      void (*cb)(void*) = t->cb;
-      void *arg = t->arg;
-      first_timeout = t->next;
-      t->next = free_timeout;
-      free_timeout = t;
+  if (fl_posted_pending) {
+    TraceScope trace(TRACE_POST, "post");
+    fl_do_posted_calls();
+    ret = 1;
+  }
+
+  if (num_timeouts) {
+    double now = monotonic_time();
+    while (num_timeouts) {
+      Timeout& t = timeout_slot[timeout_heap[0]];
+      if (t.time > now) break;
+      // We must remove timeout from heap before doing the callback
+      void (*cb)(void*) = t.cb;
+      void *arg = t.arg;
+      double saved_base = repeat_base; bool saved_in = in_timeout;
+      repeat_base = t.time; // make repeat_timeout more accurate
+      in_timeout = true;
+      timeout_remove_at(0);
       // Now it is safe for the callback to do add_timeout:
-      missed_timeout_by = t->time; // make repeat_timeout more accurate
-      cb(arg);
+      {TraceScope trace(TRACE_TIMEOUT, "timeout", (const void*)cb);
+      cb(arg);}
+      repeat_base = saved_base; in_timeout = saved_in;
       // return true because something was done:
       ret = 1;
     }
   }
 
-  if (idle && !in_idle) {in_idle = true; idle(); in_idle = false;}
+  if (idle && !in_idle) {
+    TraceScope trace(TRACE_IDLE, "idle");
+    in_idle = true; idle(); in_idle = false;
+  }
 
-  flush();
+  frame_flush();
 
   return ret;
 }
@@ -525,10 +950,9 @@ while (!calculation_done()) {
 \endcode
 */
 int fltk::ready() {
-  if (first_timeout) {
-    elapse_timeouts();
-    if (first_timeout->time <= 0) return 1;
-  }
+  if (num_timeouts &&
+      timeout_slot[timeout_heap[0]].time <= monotonic_time()) return 1;
+  if (pending_frames->n && next_frame_time <= monotonic_time()) return 1;
   // run the system-specific part:
   return fl_ready();
 }
@@ -629,6 +1053,8 @@ int fltk::damage_;
   changes to the styles.
 */
 void fltk::redraw() {
+  fl_display_list_generation++; // replace all Group::retained() drawings
+  Style::changed(); // the caller may have changed styles directly
   for (CreatedWindow* x = CreatedWindow::first; x; x = x->next)
     x->window->redraw();
 }
@@ -637,8 +1063,64 @@ void fltk::redraw() {
 extern void fl_do_deferred_calls(); // in Fl_Window.cxx:
 #endif
 
-// This is extra code that probably should be in Window::flush():
-void fl_window_flush(Window* window) {
+extern void fl_draw_profile_overlay(Window*); // in draw_profile.cxx
+extern bool fl_flash_begin(Window*, DamageRects&); // in frame_stats.cxx
+extern void fl_flash_end(Window*, const DamageRects&);
+extern void fl_end_frame();
+extern void fl_latency_frame(); // in input_latency.cxx
+
+// While the user drags the edge of a window the system may send a new
+// size far faster than the window can lay out and draw. Only the first
+// size in each resize_throttle() interval is done at once, later ones
+// wait for this timeout, by which time only the latest size is left:
+static float resize_interval = 1.0f/60;
+static Window* resized_window;
+static double resized_time;
+
+static void resize_timeout(void*) {
+  fltk::damage_ = true; // make flush() look at the windows again
+}
+
+/*!
+  Set the shortest time between the layout and redraw of a window that
+  the user is resizing. The system may send many sizes per screen
+  refresh during an interactive ("opaque") resize. Those that arrive
+  sooner than this after the last one that was drawn are not laid out,
+  the window keeps showing the old picture, and when the time runs out
+  only the latest size is laid out and drawn. The default is 1/60
+  second. Zero lays out and draws every size as it arrives.
+*/
+void fltk::resize_throttle(float t) {resize_interval = t;}
+
+/*! Return the value set by resize_throttle(). */
+float fltk::resize_throttle() {return resize_interval;}
+
+// Do the layout() of a window that needs it, unless it is being
+// resized faster than resize_throttle(). Widgets are changed, so this
+// is done before fltk::flush() shares the lock with reading threads:
+static void window_layout(Window* window) {
+  CreatedWindow* x = CreatedWindow::find(window);
+  if (!x || x->wait_for_expose || !window->visible_r()) return;
+  if ((window->layout_damage() & LAYOUT_USER) && resize_interval > 0) {
+    double now = monotonic_time();
+    if (window == resized_window && now < resized_time + resize_interval) {
+      if (!has_timeout(resize_timeout))
+	add_timeout(float(resized_time + resize_interval - now), resize_timeout);
+      return;
+    }
+    resized_window = window;
+    resized_time = now;
+  }
+  if (window->layout_damage()) {
+    TraceScope trace(TRACE_LAYOUT, "layout", window);
+    window->layout();
+    window->layout_damage(0);
+  }
+}
+
+// Draw a window that has been laid out. A window that still has
+// layout_damage() was skipped by the resize throttle and is not drawn:
+static void window_draw(Window* window) {
   CreatedWindow* x = CreatedWindow::find(window);
   if (x->wait_for_expose || !window->visible_r()) return;
 #if !USE_X11 && USE_QUARTZ
@@ -651,13 +1133,24 @@ void fl_window_flush(Window* window) {
     return;
   }
 #endif
-  if (window->layout_damage()) {
-    window->layout();
-    window->layout_damage(0);
-  }
+  if (window->layout_damage()) return;
   if (window->damage() || x->region) {
-    window->flush();
+    DamageRects flashed;
+    DamageRects* saved_flash = fl_flash_rects;
+    bool flash = flashing_redraws_ && fl_flash_begin(window, flashed);
+    fl_flash_rects = flash ? &flashed : 0;
+    {TraceScope trace(TRACE_DRAW, "draw", window);
+    window->flush();}
+    fl_flash_rects = saved_flash;
+    frame_counts_.windows++;
     window->set_damage(0);
+    if (draw_profile_overlay_ || flash) {
+#if USE_X11
+      fl_defer_swaps(false); // the overlay is drawn on the front buffer
+#endif
+      if (draw_profile_overlay_) fl_draw_profile_overlay(window);
+      if (flash) fl_flash_end(window, flashed);
+    }
     if (x->region) {
 #if USE_X11
       XDestroyRegion(x->region);
@@ -671,6 +1164,12 @@ void fl_window_flush(Window* window) {
   }
 }
 
+// This is extra code that probably should be in Window::flush():
+void fl_window_flush(Window* window) {
+  window_layout(window);
+  window_draw(window);
+}
+
 /*!
   Get the display up to date. This is done by calling layout() on
   all Window objects with layout_damage() and then calling draw()
@@ -688,12 +1187,23 @@ void fltk::flush() {
 #endif
   if (damage_) {
     damage_ = false; // turn it off so Window::flush() can turn it back on
-    for (CreatedWindow* x = CreatedWindow::first; x; x = x->next) {
-      Window* window = x->window;
-      fl_window_flush(window);
-    }
+    CreatedWindow* x;
+    for (x = CreatedWindow::first; x; x = x->next) window_layout(x->window);
+    // drawing only reads the widgets, so lock_shared() threads may run:
+    fl_share_lock_function();
+#if USE_X11
+    fl_defer_swaps(true);
+#endif
+    for (x = CreatedWindow::first; x; x = x->next) window_draw(x->window);
+#if USE_X11
+    fl_defer_swaps(false); // show all the double buffered windows at once
+#endif
+    fl_unshare_lock_function();
   }
 #if USE_X11
+#if USE_XFT && !USE_CAIRO
+  fl_flush_trapezoids(); // alpha fills drawn outside Window::flush()
+#endif
   if (xmousewin && !pushed() && !grab()) {
     CreatedWindow* i = CreatedWindow::find(xmousewin);
     if (i->cursor != None && i->cursor_for != xmousewin
@@ -702,13 +1212,20 @@ void fltk::flush() {
       XDefineCursor(xdisplay, i->xid, None);
     }
   }
-  XFlush(xdisplay);
+  {TraceScope trace(TRACE_FLUSH, "XFlush");
+  XFlush(xdisplay);}
 #elif defined(_WIN32)
-  GdiFlush();
+  fl_d2d_flush();
+  {TraceScope trace(TRACE_FLUSH, "GdiFlush");
+  GdiFlush();}
   fl_do_deferred_calls();
 #elif USE_QUARTZ
   //+++ QDFlushPortBuffer( GetWindowPort(xid), 0 ); // \todo do we need this?
 #endif
+  if (frame_counts_.windows) {
+    fl_end_frame();
+    if (measuring_latency_) fl_latency_frame();
+  }
 }
 
 ////////////////////////////////////////////////////////////////
@@ -1220,8 +1737,43 @@ bool fltk::try_shortcut() {
 # include <stdio.h>
 #endif
 
+extern bool fl_recording;
+extern void fl_record_event(int, const Window*); // in EventReplay.cxx
+
+// Only the outermost handle() call is recorded, the ones it causes are
+// made again when it is played back:
+static int handle_depth;
+struct HandleDepth {
+  HandleDepth() {handle_depth++;}
+  ~HandleDepth() {handle_depth--;}
+};
+
+extern void fl_latency_event(int, double); // in input_latency.cxx
+
+// While measuring_latency() the outermost event is timed if it calls
+// fltk::damage(), which is cleared while it is handled so that shows:
+struct LatencyProbe {
+  double start;
+  int event;
+  bool saved;
+  bool on;
+  LatencyProbe(int e) : start(0), event(e), saved(false),
+    on(measuring_latency_ && e && !handle_depth) {
+    if (on) {start = trace_time(); saved = damage_; damage_ = false;}
+  }
+  ~LatencyProbe() {
+    if (!on) return;
+    if (damage_) fl_latency_event(event, start);
+    else damage_ = saved;
+  }
+};
+
 bool fltk::handle(int event, Window* window)
 {
+  TraceScope trace(TRACE_EVENT, tracing_ ? event_name(event) : 0, window);
+  if (fl_recording && !handle_depth) fl_record_event(event, window);
+  LatencyProbe latency(event);
+  HandleDepth depth;
   e_type = event;
 
 #ifdef DUMP_EVENTS
@@ -29,6 +29,7 @@
 #include <fltk/Window.h>
 #include <fltk/x.h>
 #include <fltk/draw.h>
+#include "DisplayList.h"
 
 // Turn this off to stop using copy-area for scrolling:
 #define USE_SCROLL 1
@@ -49,6 +50,7 @@ extern "C" {
 #endif /* SYSRGN */
 
 extern int has_unicode();
+extern void fl_d2d_flush(); // in win32/direct2d.cxx
 
 // Return true if rect is completely visible on screen.
 // If other window is overlapping rect, return false.
@@ -91,6 +93,24 @@ static bool is_visible(int x, int y, int w, int h)
 
 #endif /* _WIN32 */
 
+#if USE_SCROLL && !defined(USE_QUARTZ)
+// Return true if drawing into the back buffer of a double_buffer()
+// window. All of it is always there, so a copy inside it never leaves
+// anything to be exposed, and the parts of the window that are covered
+// are updated from it by expose events:
+static bool drawing_backbuffer() {
+  const fltk::Window* window = fltk::Window::drawing_window();
+  if (!window) return false;
+  fltk::CreatedWindow* i = fltk::CreatedWindow::find(window);
+  if (!i || !i->backbuffer) return false;
+# if USE_X11
+  return fltk::xwindow == i->backbuffer;
+# else
+  return fltk::dc == i->bdc;
+# endif
+}
+#endif
+
 /**
   Move the contents of a rectangle by \a dx and \a dy. The area that
   was previously outside the rectangle or obscured by other windows is
@@ -103,11 +123,17 @@ static bool is_visible(int x, int y, int w, int h)
   If \a dx or \a dy are larger than the rectangle then this just calls
   \a draw_area for the entire rectangle. This is also done on systems
   (Quartz) that do not support copying screen regions.
+
+  In a double_buffer() window the back buffer is copied, which is
+  faster than copying the screen, because there is never an obscured
+  area to wait for from the server and redraw.
 */
 void fltk::scrollrect(const Rectangle& r, int dx, int dy,
 		       void (*draw_area)(void*, const Rectangle&), void* data)
 {
   if (!dx && !dy) return;
+  // copying the screen can't be replayed:
+  if (fl_display_list) fl_display_list->abort();
 #if !USE_SCROLL || defined(USE_QUARTZ)
   draw_area(data, r);
   return;
@@ -147,21 +173,34 @@ void fltk::scrollrect(const Rectangle& r, int dx, int dy,
   }
   int ox = 0; int oy = 0; transform(ox, oy);
 #if USE_X11
-  XCopyArea(xdisplay, xwindow, xwindow, gc,
-	    src_x+ox, src_y+oy, src_w, src_h,
-	    dest_x+ox, dest_y+oy);
-// Synchronous update by waiting for graphics expose events:
-  for (;;) {
-    XEvent e; XWindowEvent(xdisplay, xwindow, ExposureMask, &e);
-    if (e.type == NoExpose) break;
-    // otherwise assumme it is a GraphicsExpose event:
-    draw_area(data,
-	      Rectangle(e.xexpose.x-ox, e.xexpose.y-oy,
-			e.xexpose.width, e.xexpose.height));
-    if (!e.xgraphicsexpose.count) break;
+  if (!xwindow) {
+    // drawing with Cairo into an Image, there is nothing to copy:
+    draw_area(data, r);
+  } else if (drawing_backbuffer()) {
+    // No GraphicsExpose events are needed, so don't wait for the server:
+    XSetGraphicsExposures(xdisplay, gc, False);
+    XCopyArea(xdisplay, xwindow, xwindow, gc,
+	      src_x+ox, src_y+oy, src_w, src_h,
+	      dest_x+ox, dest_y+oy);
+    XSetGraphicsExposures(xdisplay, gc, True);
+  } else {
+    XCopyArea(xdisplay, xwindow, xwindow, gc,
+	      src_x+ox, src_y+oy, src_w, src_h,
+	      dest_x+ox, dest_y+oy);
+    // Synchronous update by waiting for graphics expose events:
+    for (;;) {
+      XEvent e; XWindowEvent(xdisplay, xwindow, ExposureMask, &e);
+      if (e.type == NoExpose) break;
+      // otherwise assumme it is a GraphicsExpose event:
+      draw_area(data,
+		Rectangle(e.xexpose.x-ox, e.xexpose.y-oy,
+			  e.xexpose.width, e.xexpose.height));
+      if (!e.xgraphicsexpose.count) break;
+    }
   }
 #elif defined(_WIN32)
-  if (is_visible(src_x+ox, src_y+oy, src_w, src_h)) {
+  fl_d2d_flush();
+  if (drawing_backbuffer() || is_visible(src_x+ox, src_y+oy, src_w, src_h)) {
     BitBlt(dc, dest_x+ox, dest_y+oy, src_w, src_h,
 	   dc, src_x+ox, src_y+oy, SRCCOPY);
   } else {
@@ -26,6 +26,7 @@
 #include <config.h>
 #include <fltk/visual.h>
 #include <fltk/x.h>
+#include <fltk/trace.h>
 
 /*! \fn bool fltk::visual(int);
 
@@ -102,8 +103,8 @@ static int test_visual(XVisualInfo& v, int flags) {
   return 1;
 }
 
-bool fltk::visual(int flags) {
-  open_display();
+static bool choose_visual(int flags) {
+  TraceScope trace(TRACE_STARTUP, "visual");
   // always use default if possible:
   if (test_visual(*xvisual, flags)) return true;
   // get all the visuals:
@@ -123,6 +124,19 @@ bool fltk::visual(int flags) {
   return true;
 }
 
+bool fltk::visual(int flags) {
+  open_display();
+  // the answer is the same if nothing changed since the last call:
+  static int last_flags = -1;
+  static XVisualInfo* last_visual;
+  static bool last_result;
+  if (flags == last_flags && xvisual == last_visual) return last_result;
+  last_flags = flags;
+  last_result = choose_visual(flags);
+  last_visual = xvisual;
+  return last_result;
+}
+
 #elif defined(_WIN32)
 
 bool fltk::visual(int flags) {
@@ -0,0 +1,217 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Ring buffer of timing records for the main loop, and a writer for the
+// Chrome "about:tracing" JSON format. The code that is measured is in
+// run.cxx and the system-specific run.cxx files, it only costs a test
+// of tracing_ when this is turned off.
+
+#include <fltk/trace.h>
+#include <stdlib.h>
+#include <string.h>
+using namespace fltk;
+
+/*! \fn bool fltk::tracing()
+  Returns true if start_tracing() has been called and stop_tracing()
+  has not.
+*/
+bool fltk::tracing_;
+
+static TraceRecord* records;	// ring buffer
+static int records_size;	// allocated size of ring
+static int records_next;	// where the next record goes
+static int records_used;	// how many are valid
+
+static unsigned long category_count[TRACE_CATEGORIES];
+static double category_total[TRACE_CATEGORIES];
+static float category_max[TRACE_CATEGORIES];
+
+/*!
+  Start recording how long fltk::wait() spends waiting for events,
+  handling them, calling timeouts, checks, idle and fltk::post()
+  callbacks, doing layout, drawing each window, and flushing to the
+  display.
+
+  The most recent \a n intervals are remembered, older ones are thrown
+  away, but the totals returned by trace_count(), trace_total() and
+  trace_max() include all of them. Calling this again changes the
+  number kept, which clears the remembered ones.
+*/
+void fltk::start_tracing(int n) {
+  if (n < 1) n = 1;
+  if (n != records_size) {
+    delete[] records;
+    records = new TraceRecord[n];
+    records_size = n;
+    records_next = records_used = 0;
+  }
+  tracing_ = true;
+}
+
+/*! Stop recording. The records are kept until clear_trace() or
+  start_tracing() with a different size is called. */
+void fltk::stop_tracing() {
+  tracing_ = false;
+}
+
+/*! Throw away all the records and reset all the totals to zero. */
+void fltk::clear_trace() {
+  records_next = records_used = 0;
+  for (int i = 0; i < TRACE_CATEGORIES; i++) {
+    category_count[i] = 0;
+    category_total[i] = 0;
+    category_max[i] = 0;
+  }
+}
+
+/*!
+  Add a record of something that started at \a start (a value
+  returned by trace_time()) and ended now. \a name must be a static
+  string, it is not copied. Does nothing if tracing() is off.
+*/
+void fltk::trace(TraceCategory c, const char* name, const void* object,
+		 double start) {
+  if (!tracing_) return;
+  float duration = float(trace_time()-start);
+  category_count[c]++;
+  category_total[c] += duration;
+  if (duration > category_max[c]) category_max[c] = duration;
+  TraceRecord& r = records[records_next];
+  r.start = start;
+  r.duration = duration;
+  r.category = c;
+  r.name = name;
+  r.object = object;
+  if (++records_next >= records_size) records_next = 0;
+  if (records_used < records_size) records_used++;
+}
+
+/*! Returns how many records are remembered. */
+int fltk::trace_records() {
+  return records_used;
+}
+
+/*! Returns one of the remembered records. 0 is the oldest and
+  trace_records()-1 is the most recent. Returns null if \a i is out
+  of range. */
+const TraceRecord* fltk::trace_record(int i) {
+  if (i < 0 || i >= records_used) return 0;
+  i += records_next-records_used;
+  if (i < 0) i += records_size;
+  return records+i;
+}
+
+/*! Returns how many intervals of this category have been recorded
+  since tracing started or clear_trace() was called. */
+unsigned long fltk::trace_count(TraceCategory c) {
+  return category_count[c];
+}
+
+/*! Returns the total seconds spent in this category. */
+double fltk::trace_total(TraceCategory c) {
+  return category_total[c];
+}
+
+/*! Returns the longest single interval of this category. */
+float fltk::trace_max(TraceCategory c) {
+  return category_max[c];
+}
+
+static const char* const category_name[TRACE_CATEGORIES] = {
+  "wait", "event", "timeout", "check", "idle", "post",
+  "layout", "draw", "flush", "user", "startup"
+};
+
+static void write_json_string(FILE* f, const char* s) {
+  putc('"', f);
+  if (s) for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+    else if (c < ' ') fprintf(f, "\\u%04x", c);
+    else putc(c, f);
+  }
+  putc('"', f);
+}
+
+/*!
+  Write all the remembered records in the Chrome Trace Event format,
+  which can be loaded into chrome://tracing or Perfetto. Returns false
+  if there was an error writing the file.
+*/
+bool fltk::write_trace_json(FILE* f) {
+  fprintf(f, "{\"traceEvents\":[");
+  double origin = records_used ? trace_record(0)->start : 0;
+  for (int i = 0; i < records_used; i++) {
+    const TraceRecord* r = trace_record(i);
+    fprintf(f, i ? ",\n" : "\n");
+    fprintf(f, "{\"name\":");
+    write_json_string(f, r->name ? r->name : category_name[r->category]);
+    fprintf(f, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+	    "\"pid\":1,\"tid\":1,\"args\":{\"object\":\"%p\"}}",
+	    category_name[r->category],
+	    (r->start-origin)*1e6, r->duration*1e6, r->object);
+  }
+  fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return !ferror(f);
+}
+
+/*!
+  Print the remembered TRACE_STARTUP records to \a f, one per line,
+  with when each started (relative to the first one) and how long it
+  took in milliseconds. These are the display connection, loading the
+  theme, finding fonts, choosing the visual and image formats, and
+  the input method, which is not opened until a window gets the focus.
+  Some of these happen inside others, such as a theme looking up a font
+  by name. Call start_tracing() before the first Window::show() to get
+  these. On X, setting FLTK_STARTUP_REPORT in the environment turns on
+  tracing when the display is opened and prints this to stderr when
+  the first window is mapped.
+*/
+void fltk::write_startup_report(FILE* f) {
+  double origin = -1;
+  for (int i = 0; i < records_used; i++) {
+    const TraceRecord* r = trace_record(i);
+    if (r->category != TRACE_STARTUP) continue;
+    if (origin < 0) origin = r->start;
+    fprintf(f, "%8.2f %8.2f ms  %s\n", (r->start-origin)*1e3,
+	    r->duration*1e3, r->name);
+  }
+  fprintf(f, "startup total %.2f ms in %lu intervals\n",
+	  category_total[TRACE_STARTUP]*1e3, category_count[TRACE_STARTUP]);
+}
+
+/*! Same as write_trace_json(FILE*) but it opens and closes the named
+  file. Returns false if it cannot be written. */
+bool fltk::write_trace_json(const char* filename) {
+  FILE* f = fopen(filename, "w");
+  if (!f) return false;
+  bool ret = write_trace_json(f);
+  if (fclose(f)) ret = false;
+  return ret;
+}
+
+//
+// End of "$Id$".
+//
@@ -24,6 +24,9 @@
 #include <fltk/utf.h>
 #include <string.h>
 #include <stdlib.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -66,6 +69,30 @@ static unsigned short cp1252[32] = {
 };
 #endif
 
+/* Return the first byte at or after p that is not ASCII, or e.
+   Almost all text is mostly ASCII, so this checks 16 bytes at a time
+   with SSE2, or a word at a time otherwise, and the callers copy or
+   count the whole run without decoding it:
+*/
+static const char* skip_ascii(const char* p, const char* e) {
+#if defined(__SSE2__)
+  while (e-p >= 16) {
+    if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p))) break;
+    p += 16;
+  }
+#else
+  const unsigned long highbits = ((unsigned long)-1/255)*0x80;
+  while (e-p >= (int)sizeof(unsigned long)) {
+    unsigned long w;
+    memcpy(&w, p, sizeof(w));
+    if (w & highbits) break;
+    p += sizeof(w);
+  }
+#endif
+  while (p < e && !(*p & 0x80)) p++;
+  return p;
+}
+
 /*! Decode a single UTF-8 encoded character starting at \e p. The
     resulting Unicode value (in the range 0-0x10ffff) is returned,
     and \e len is set the the number of bytes in the UTF-8 encoding
@@ -337,6 +364,16 @@ unsigned utf8towc(const char* src, unsigned srclen,
   if (dstlen) for (;;) {
     if (p >= e) {dst[count] = 0; return count;}
     if (!(*p & 0x80)) { // ascii
+      const char* q = skip_ascii(p, e);
+      unsigned n = q-p;
+      if (n > dstlen-1-count) n = dstlen-1-count;
+      if (n) { // copy the whole run, leaving room for the terminator
+	wchar_t* d = dst+count;
+	const char* pe = p+n;
+	while (p < pe) *d++ = *p++;
+	count += n;
+	continue;
+      }
       dst[count] = *p++;
     } else {
       int len; unsigned ucs = utf8decode(p,e,&len);
@@ -358,8 +395,12 @@ unsigned utf8towc(const char* src, unsigned srclen,
   }
   // we filled dst, measure the rest:
   while (p < e) {
-    if (!(*p & 0x80)) p++;
-    else {
+    if (!(*p & 0x80)) {
+      const char* q = skip_ascii(p, e);
+      count += q-p;
+      p = q;
+      continue;
+    } else {
 #ifdef _WIN32
       int len; unsigned ucs = utf8decode(p,e,&len);
       p += len;
@@ -404,7 +445,19 @@ unsigned utf8toa(const char* src, unsigned srclen,
     unsigned char c;
     if (p >= e) {dst[count] = 0; return count;}
     c = *(unsigned char*)p;
-    if (c < 0xC2) { // ascii or bad code
+    if (c < 0x80) { // ascii
+      const char* q = skip_ascii(p, e);
+      unsigned n = q-p;
+      if (n > dstlen-1-count) n = dstlen-1-count;
+      if (n) { // copy the whole run, leaving room for the terminator
+	memcpy(dst+count, p, n);
+	p += n;
+	count += n;
+	continue;
+      }
+      dst[count] = c;
+      p++;
+    } else if (c < 0xC2) { // bad code
       dst[count] = c;
       p++;
     } else {
@@ -417,8 +470,12 @@ unsigned utf8toa(const char* src, unsigned srclen,
   }
   // we filled dst, measure the rest:
   while (p < e) {
-    if (!(*p & 0x80)) p++;
-    else {
+    if (!(*p & 0x80)) {
+      const char* q = skip_ascii(p, e);
+      count += q-p;
+      p = q;
+      continue;
+    } else {
       int len;
       utf8decode(p,e,&len);
       p += len;
@@ -464,7 +521,10 @@ unsigned utf8fromwc(char* dst, unsigned dstlen,
     if (i >= srclen) {dst[count] = 0; return count;}
     ucs = src[i++];
     if (ucs < 0x80U) {
+      // copy the rest of an ascii run without the other tests:
       dst[count++] = ucs;
+      while (count < dstlen && i < srclen && (unsigned)src[i] < 0x80U)
+	dst[count++] = (char)src[i++];
       if (count >= dstlen) {dst[count-1] = 0; break;}
     } else if (ucs < 0x800U) { // 2 bytes
       if (count+2 >= dstlen) {dst[count] = 0; count += 2; break;}
@@ -778,7 +838,7 @@ int utf8test(const char* src, unsigned srclen) {
       if (len > ret) ret = len;
       p += len;
     } else {
-      p++;
+      p = skip_ascii(p, e);
     }
   }
   return ret;
@@ -0,0 +1,196 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Widget::set_cached(): the widget draws into an offscreen Image, which
+// is copied to the window. When the window is exposed, or the parent
+// redraws everything, the Image is copied again without calling
+// draw(). The Images are attached with an AssociationType and the
+// least-recently drawn ones are destroyed when they use more memory
+// than set_cache_size() allows.
+
+#include <fltk/Widget.h>
+#include <fltk/WidgetAssociation.h>
+#include <fltk/Image.h>
+#include <fltk/Box.h>
+#include <fltk/draw.h>
+#include <fltk/damage.h>
+#include "DisplayList.h"
+#include "DamageRects.h"
+using namespace fltk;
+
+extern bool fl_trivial_transform(); // in path.cxx
+
+namespace {
+
+struct CacheEntry {
+  Image* image;
+  unsigned generation;	// fl_display_list_generation when drawn
+  unsigned long used;	// value of use_count when last drawn
+  CacheEntry* next;
+  CacheEntry* prev;
+};
+
+CacheEntry* first_entry;
+unsigned long use_count;
+unsigned long mem_used;
+unsigned long mem_limit = 16*1024*1024;
+
+void free_image(CacheEntry* e) {
+  if (!e->image) return;
+  mem_used -= e->image->mem_used();
+  delete e->image;
+  e->image = 0;
+}
+
+class CacheAssociation : public AssociationType {
+public:
+  void destroy(void* data) const {
+    CacheEntry* e = (CacheEntry*)data;
+    if (e->prev) e->prev->next = e->next; else first_entry = e->next;
+    if (e->next) e->next->prev = e->prev;
+    free_image(e);
+    delete e;
+  }
+};
+
+const CacheAssociation cache_association;
+
+// Destroy the least recently drawn images, other than keep, until the
+// memory used is within the limit:
+void check_mem_usage(CacheEntry* keep) {
+  while (mem_limit && mem_used > mem_limit) {
+    CacheEntry* oldest = 0;
+    for (CacheEntry* e = first_entry; e; e = e->next)
+      if (e->image && e != keep && (!oldest || e->used < oldest->used))
+	oldest = e;
+    if (!oldest) break;
+    free_image(oldest);
+  }
+}
+
+}
+
+/*! \fn bool Widget::cached() const
+  Returns true if set_cached() has been called.
+*/
+
+/*! \fn void Widget::set_cached()
+  Makes the widget draw into an offscreen image, which is then copied
+  to the window. When the window is exposed, or the parent group
+  redraws everything, the image is copied again without calling
+  draw(). This can make exposing a window much faster if it contains
+  widgets with expensive boxes or labels. The image is updated by
+  calling draw() with the widget's damage() when it is redrawn.
+
+  The widget must call redraw() when anything it draws changes. If the
+  box() does not fill the rectangle the parent's background is in the
+  image, so the parent must also be redrawn if that changes.
+
+  The images are destroyed, least recently drawn first, if they use
+  more memory than set_cache_size(). Nothing is cached for a Window or
+  if the drawing is scaled or rotated.
+*/
+
+/*! Turn off cached() and destroy the image. */
+void Widget::clear_cached() {
+  clear_flag(CACHED);
+  CacheEntry* e = (CacheEntry*)get(cache_association);
+  if (e && !remove(cache_association, e)) cache_association.destroy(e);
+}
+
+/*! Set the maximum number of bytes used by the images for all the
+  cached() widgets. Zero means no limit. The default is 16 megabytes. */
+void Widget::set_cache_size(unsigned long bytes) {
+  mem_limit = bytes;
+  check_mem_usage(0);
+}
+
+/*! Returns how many bytes are used by the images of cached() widgets. */
+unsigned long Widget::cache_mem_used() {
+  return mem_used;
+}
+
+// Called by Group::draw_child() and Group::update_child() for a
+// cached() widget, with the drawing translated so 0,0 is the corner
+// of the widget. \a damage is what was on before the group changed it.
+// \a background_changed is true if the parent redrew its box. Returns
+// false if the widget must be drawn normally.
+bool fl_draw_cached(Widget& w, uchar damage, bool background_changed) {
+  if (!fl_trivial_transform() || w.w() <= 0 || w.h() <= 0) return false;
+  CacheEntry* e = (CacheEntry*)(w.get(cache_association));
+  if (!e) {
+    e = new CacheEntry;
+    e->image = 0;
+    e->prev = 0;
+    e->next = first_entry;
+    if (first_entry) first_entry->prev = e;
+    first_entry = e;
+    w.set(cache_association, e);
+  }
+  e->used = ++use_count;
+
+  if (e->image && (e->image->w() != w.w() || e->image->h() != w.h()))
+    free_image(e);
+  if (!e->image || e->generation != fl_display_list_generation ||
+      (background_changed && !w.box()->fills_rectangle()))
+    // not DAMAGE_EXPOSE, which would make draw_background() do nothing:
+    damage = DAMAGE_ALL;
+  else
+    damage &= ~DAMAGE_EXPOSE;
+
+  if (damage) {
+    if (!e->image) e->image = new Image(RGB32, w.w(), w.h());
+    mem_used -= e->image->mem_used();
+    // none of this goes into the window:
+    DisplayList* list = fl_display_list; fl_display_list = 0;
+    DamageRects* rects = fl_damage_rects; fl_damage_rects = 0;
+    {
+      GSave gsave;
+      e->image->make_current();
+      load_identity();
+      w.set_damage(damage);
+      // the image starts out as garbage, so put the parent's background
+      // in it where the box won't cover it:
+      if (damage == DAMAGE_ALL && !w.box()->fills_rectangle())
+	w.draw_background();
+      w.draw();
+    }
+    fl_display_list = list;
+    fl_damage_rects = rects;
+    mem_used += e->image->mem_used();
+    e->generation = fl_display_list_generation;
+    check_mem_usage(e);
+  }
+
+  // the image may be destroyed, so it can't be in a DisplayList:
+  if (fl_display_list) fl_display_list->abort();
+  Rectangle r(w.w(), w.h());
+  e->image->draw(r, r);
+  return true;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,209 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Cache of string widths for getwidth(). Each FontSize in the system
+// specific Font code has a pointer to one of these, and its getwidth()
+// calls fl_cached_width() with the function that really measures. The
+// layout done by measure() and wrap() asks for the same strings over
+// and over, and asking the system is slow, especially for Xft.
+
+#include <config.h>
+#include <fltk/draw.h>
+#include <fltk/utf.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+struct WidthEntry {
+  WidthEntry* hash_next;
+  WidthEntry* prev;	// LRU list, most recently used first
+  WidthEntry* next;
+  unsigned hash;
+  int n;
+  float width;
+  char text[1];		// n bytes are allocated
+};
+
+struct WidthCache {
+  WidthEntry** buckets;
+  unsigned nbuckets;	// always a power of 2
+  int count;
+  WidthEntry* first;
+  WidthEntry* last;
+};
+
+static int max_entries = 8192;
+enum {MAX_LENGTH = 256}; // longer strings are not remembered
+static unsigned long hits, misses;
+
+static unsigned hash_string(const char* text, int n) {
+  unsigned h = 2166136261U;
+  for (int i = 0; i < n; i++) h = (h ^ (uchar)text[i]) * 16777619U;
+  return h;
+}
+
+static void unlink(WidthCache* c, WidthEntry* e) {
+  if (e->prev) e->prev->next = e->next; else c->first = e->next;
+  if (e->next) e->next->prev = e->prev; else c->last = e->prev;
+}
+
+static void push(WidthCache* c, WidthEntry* e) {
+  e->prev = 0;
+  e->next = c->first;
+  if (c->first) c->first->prev = e; else c->last = e;
+  c->first = e;
+}
+
+static void remove_last(WidthCache* c) {
+  WidthEntry* e = c->last;
+  WidthEntry** p = &c->buckets[e->hash&(c->nbuckets-1)];
+  while (*p != e) p = &((*p)->hash_next);
+  *p = e->hash_next;
+  unlink(c, e);
+  free(e);
+  c->count--;
+}
+
+static void rehash(WidthCache* c, unsigned nbuckets) {
+  WidthEntry** b = (WidthEntry**)calloc(nbuckets, sizeof(WidthEntry*));
+  for (WidthEntry* e = c->first; e; e = e->next) {
+    WidthEntry** p = &b[e->hash&(nbuckets-1)];
+    e->hash_next = *p;
+    *p = e;
+  }
+  free(c->buckets);
+  c->buckets = b;
+  c->nbuckets = nbuckets;
+}
+
+/*!
+  Return the width of the text, using the cache pointed to by \a cache
+  (which is created if it is null) or by calling \a measure and
+  remembering the answer. Negative widths (errors) are not remembered.
+*/
+float fl_cached_width(WidthCache*& cache, const char* text, int n,
+		      float (*measure)(const char*, int)) {
+  if (n > MAX_LENGTH || max_entries <= 0) return measure(text, n);
+  WidthCache* c = cache;
+  if (!c) {
+    cache = c = (WidthCache*)calloc(1, sizeof(WidthCache));
+    rehash(c, 256);
+  }
+  unsigned hash = hash_string(text, n);
+  for (WidthEntry* e = c->buckets[hash&(c->nbuckets-1)]; e; e = e->hash_next) {
+    if (e->hash == hash && e->n == n && !memcmp(e->text, text, n)) {
+      if (e != c->first) {unlink(c, e); push(c, e);}
+      hits++;
+      return e->width;
+    }
+  }
+  misses++;
+  float width = measure(text, n);
+  if (width < 0) return width;
+  while (c->count >= max_entries) remove_last(c);
+  if (unsigned(c->count) >= c->nbuckets) rehash(c, 2*c->nbuckets);
+  WidthEntry* e = (WidthEntry*)malloc(sizeof(WidthEntry)+n);
+  e->hash = hash;
+  e->n = n;
+  e->width = width;
+  memcpy(e->text, text, n);
+  WidthEntry** p = &c->buckets[hash&(c->nbuckets-1)];
+  e->hash_next = *p;
+  *p = e;
+  push(c, e);
+  c->count++;
+  return width;
+}
+
+/*! Free a cache made by fl_cached_width(). */
+void fl_free_width_cache(WidthCache* c) {
+  if (!c) return;
+  while (c->last) remove_last(c);
+  free(c->buckets);
+  free(c);
+}
+
+/*! Return the bytes used by a cache made by fl_cached_width(). */
+unsigned long fl_width_cache_bytes(const WidthCache* c) {
+  if (!c) return 0;
+  unsigned long n = sizeof(WidthCache) + c->nbuckets*sizeof(WidthEntry*);
+  for (const WidthEntry* e = c->first; e; e = e->next)
+    n += sizeof(WidthEntry) + e->n;
+  return n;
+}
+
+/*!
+  Return the sum of \a advances for each character in the UTF-8 \a text,
+  or -1 if any character is 256 or greater. \a advances is a table of
+  the widths of the first 256 Unicode characters, made by the system
+  specific code for Font::fast_metrics().
+*/
+float fl_sum_advances(const float* advances, const char* text, int n) {
+  float w = 0;
+  const char* e = text+n;
+  for (const char* p = text; p < e;) {
+    uchar c = *(const uchar*)p;
+    if (c < 0x80) {
+      w += advances[c];
+      p++;
+    } else {
+      int len;
+      unsigned ucs = utf8decode(p, e, &len);
+      if (ucs > 255) return -1;
+      w += advances[ucs];
+      p += len;
+    }
+  }
+  return w;
+}
+
+/*!
+  Set how many string widths getwidth() remembers for each font and
+  size. The least-recently used ones are forgotten when this is
+  exceeded. The default is 8192, which is a few hundred K per font.
+  Zero turns the cache off. Strings longer than 256 bytes are always
+  measured.
+
+  A Browser with many thousands of items will lay out faster if this
+  is set larger than the number of items.
+*/
+void fltk::set_width_cache_size(int n) {
+  max_entries = n;
+}
+
+/*!
+  Return how many calls to getwidth() were answered from the cache.
+*/
+unsigned long fltk::width_cache_hits() {return hits;}
+
+/*!
+  Return how many calls to getwidth() had to measure the string.
+*/
+unsigned long fltk::width_cache_misses() {return misses;}
+
+//
+// End of "$Id$".
+//
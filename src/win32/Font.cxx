@@ -32,6 +32,22 @@
 #include <fltk/math.h>
 #include <fltk/utf.h>
 
+// Text can be drawn with DirectWrite, see direct2d.cxx. This needs the
+// headers from the Windows 7 SDK:
+#ifndef USE_DIRECT2D
+# if (defined(_MSC_VER) && _MSC_VER >= 1600) || defined(__MINGW64_VERSION_MAJOR)
+#  define USE_DIRECT2D 1
+# else
+#  define USE_DIRECT2D 0
+# endif
+#endif
+
+#if USE_DIRECT2D
+# include <d2d1.h>
+# include <dwrite.h>
+struct TextLayout; // in direct2d.cxx
+#endif
+
 using namespace fltk;
 
 // One of these is made for each combination of size + encoding:
@@ -39,9 +55,18 @@ struct FontSize {
   unsigned size;
   HFONT font;
   int charset;
-  int width[256];
+  float* advances; // for Font::fast_metrics()
   TEXTMETRICW metr;
   unsigned opengl_id;
+  WidthCache* widths; // for getwidth()
+#if USE_DIRECT2D
+  const char* name;
+  int attr;
+  IDWriteTextFormat* dwformat; // made when DirectWrite first draws it
+  TextLayout* layouts; // recently drawn strings, see direct2d.cxx
+  float* dwadvances; // like advances and widths, but for DirectWrite
+  WidthCache* dwwidths;
+#endif
   FontSize* next_all;
   FontSize(const char* fontname, int attr, int size, int charset);
   ~FontSize();
@@ -74,6 +99,8 @@ FL_API void fl_set_font_opengl_id(unsigned v) {current->opengl_id = v;}
 
 static FontSize* all_fonts;
 
+#include "direct2d.cxx"
+
 FontSize::FontSize(const char* name, int attr, int size, int charset) {
 
   // Open display, if not opened yet. So function pointers are set correctly
@@ -126,11 +153,29 @@ FontSize::FontSize(const char* name, int attr, int size, int charset) {
   all_fonts = this;
 
   opengl_id = 0;
+  widths = 0;
+  advances = 0;
+#if USE_DIRECT2D
+  this->name = name;
+  this->attr = attr;
+  dwformat = 0;
+  layouts = 0;
+  dwadvances = 0;
+  dwwidths = 0;
+#endif
 }
 
 FontSize::~FontSize() {
   if (this == current) current = 0;
   DeleteObject(font);
+  fl_free_width_cache(widths);
+  delete[] advances;
+#if USE_DIRECT2D
+  free_layouts(this);
+  if (dwformat) dwformat->Release();
+  fl_free_width_cache(dwwidths);
+  delete[] dwadvances;
+#endif
 }
 
 // Deallocate Win32 fonts on exit. Warning: it will crash if you try
@@ -271,7 +316,7 @@ float fltk::getdescent() { return float(current->metr.tmDescent); }
 
 #define WCBUFLEN 256
 
-float fltk::getwidth(const char* text, int n) {	
+static float measure_width(const char* text, int n) {
   HDC dc = getDC();
   SelectObject(dc, current->font);
   wchar_t localbuffer[WCBUFLEN];
@@ -288,7 +333,46 @@ float fltk::getwidth(const char* text, int n) {
   return (float)(size.cx);
 }
 
+float fltk::getwidth(const char* text, int n) {
+#if USE_DIRECT2D
+  if (direct2d() && dwrite_format(current)) {
+    if (Font::fast_metrics_) {
+      if (!current->dwadvances) {
+	float* a = current->dwadvances = new float[256];
+	for (unsigned c = 0; c < 256; c++) {
+	  char buf[2];
+	  int len = utf8encode(c, buf);
+	  a[c] = dwrite_width(buf, len);
+	}
+      }
+      float w = fl_sum_advances(current->dwadvances, text, n);
+      if (w >= 0) return w;
+    }
+    return fl_cached_width(current->dwwidths, text, n, dwrite_width);
+  }
+#endif
+  if (Font::fast_metrics_) {
+    if (!current->advances) {
+      float* a = current->advances = new float[256];
+      HDC dc = getDC();
+      SelectObject(dc, current->font);
+      for (unsigned c = 0; c < 256; c++) {
+	wchar_t ch = (wchar_t)c;
+	SIZE size; GetTextExtentPoint32W(dc, &ch, 1, &size);
+	a[c] = (float)size.cx;
+      }
+    }
+    float w = fl_sum_advances(current->advances, text, n);
+    if (w >= 0) return w;
+  }
+  return fl_cached_width(current->widths, text, n, measure_width);
+}
+
 void fltk::drawtext_transformed(const char *text, int n, float x, float y) {
+#if USE_DIRECT2D
+  if (d2d_drawtext(text, n, x, y)) return;
+#endif
+  fl_d2d_flush();
   SetTextColor(dc, current_xpixel);
   SelectObject(dc, current->font);
   wchar_t localbuffer[WCBUFLEN];
@@ -39,6 +39,8 @@ extern "C" {
 
 using namespace fltk;
 
+extern void fl_d2d_flush(); // in win32/direct2d.cxx
+
 static int syncnumber = 1;
 
 struct fltk::Picture {
@@ -234,7 +236,7 @@ static void convert(uchar* to, const uchar* from, PixelType type, int w) {
 
 void Image::setpixels(const uchar* buf, int y) {
   buffer();
-  flags &= ~COPIED;
+  buffer_changed();
   uchar* to = picture->data+y*picture->linedelta;
   convert(to, buf, pixeltype_, width());
 }
@@ -243,7 +245,7 @@ void Image::setpixels(const uchar* buf, const fltk::Rectangle& r, int linedelta)
 {
   if (r.empty()) return;
   buffer();
-  flags &= ~COPIED;
+  buffer_changed();
   uchar* to = picture->data+r.y()*picture->linedelta+r.x()*buffer_depth();
   // see if we can do it all at once:
   if (r.w() == picture->w && (r.h()==1 || linedelta == picture->linedelta)) {
@@ -271,8 +273,10 @@ void Image::fetch_if_needed() const {
 }
 
 void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
+  if (fl_display_list) {record_image(this, from, to); return;}
   fetch_if_needed();
   if (!picture) {fillrect(to); return;}
+  fl_d2d_flush();
   // unfortunately rotation does not work. Pick nearest scaled size:
   fltk::Rectangle R; fltk::transform(to,R);
   HDC tempdc = CreateCompatibleDC(dc);
@@ -292,6 +296,25 @@ void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
   DeleteDC(tempdc);
 }
 
+bool Image::draw_tiled(const fltk::Rectangle& r) const {
+  if (fl_display_list || r.empty()) return false;
+  fetch_if_needed();
+  if (!picture || !fills_rectangle()) return false;
+  fltk::Rectangle R; fltk::transform(r,R);
+  if (R.w() != r.w() || R.h() != r.h()) return false;
+  HBRUSH brush = CreatePatternBrush(picture->bitmap);
+  if (!brush) return false;
+  fl_d2d_flush();
+  POINT old; SetBrushOrgEx(dc, R.x(), R.y(), &old);
+  HGDIOBJ oldbrush = SelectObject(dc, brush);
+  PatBlt(dc, R.x(), R.y(), R.w(), R.h(), PATCOPY);
+  SelectObject(dc, oldbrush);
+  SetBrushOrgEx(dc, old.x, old.y, 0);
+  DeleteObject(brush);
+  picture->syncro = syncnumber;
+  return true;
+}
+
 void Image::setimage(const uchar* d, PixelType p, int w, int h, int ld) {
   setsize(w,h);
   setpixeltype(p);
@@ -305,6 +328,39 @@ void Image::make_current() {
 
 ////////////////////////////////////////////////////////////////
 
+// When drawing into the backbuffer of a window, which is a DIB
+// section, opaque pixels are converted right into it. The callback
+// is given the line of the DIB as its buffer, so often nothing is
+// copied. This is only done if the clip is a rectangle containing all
+// of r, which is already transformed:
+static bool draw_backbuffer(const uchar *buf, PixelType type,
+			    const fltk::Rectangle& r,
+			    int linedelta,
+			    DrawImageCallback cb, void* userdata)
+{
+  if (type != MONO && type != RGB && type != RGBx && type != RGB32)
+    return false;
+  const Window* window = Window::drawing_window();
+  CreatedWindow* i = window ? CreatedWindow::find(window) : 0;
+  if (!i || !i->backbuffer_bits || dc != i->bdc) return false;
+  fltk::Rectangle cr(r);
+  switch (intersect_with_clip(cr)) {
+  case 0: return true; // nothing visible
+  case 1: break;
+  default: return false; // the clip may not be a rectangle
+  }
+  if (cr.r() > i->backbuffer_w || cr.b() > i->backbuffer_h) return false;
+  fl_d2d_flush(); // finish any Direct2D and GDI drawing into it first
+  GdiFlush();
+  const int linesize = 4*i->backbuffer_w;
+  uchar* to = i->backbuffer_bits + r.y()*linesize + 4*r.x();
+  for (int y = 0; y < r.h(); y++, to += linesize) {
+    const uchar* from = buf ? buf+y*linedelta : cb(userdata, 0, y, r.w(), to);
+    convert(to, from, type, r.w());
+  }
+  return true;
+}
+
 // drawimage() calls this to see if a direct draw will work. Returns
 // true if successful, false if an Image must be used to emulate it.
 
@@ -313,6 +369,11 @@ static bool innards(const uchar *buf, PixelType type,
 		    int linedelta,
 		    DrawImageCallback cb, void* userdata)
 {
+  fl_d2d_flush();
+  {fltk::Rectangle r; transform(r1,r);
+  if (r.w() == r1.w() && r.h() == r1.h() &&
+      draw_backbuffer(buf, type, r, linedelta, cb, userdata)) return true;}
+
   // We can directly draw RGB32.
   // May be able to draw RGB and RGBx, not sure.
   if (!buf || type != RGB32) return false;
@@ -0,0 +1,314 @@
+//
+// "$Id$"
+//
+// Direct2D and DirectWrite drawing for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// This file does not compile independently, it is included by win32/Font.cxx
+
+// Text and fillrect() can be drawn by Direct2D, through a render target
+// bound to the current dc. BeginDraw() is done by the first of them and
+// EndDraw() only by fl_d2d_flush(), so a run of text and rectangles is
+// sent to the GPU as one batch. All GDI drawing calls fl_d2d_flush()
+// first (setpen() and setbrush() do it) so it is not put under them.
+//
+// The dlls are loaded when first needed, so fltk programs still run on
+// systems that don't have them. It is off for remote desktop sessions,
+// where there is usually no GPU and GDI is sent as drawing commands.
+
+extern int fl_clip_w, fl_clip_h; // in win32/run.cxx
+
+#if USE_DIRECT2D
+
+typedef HRESULT (WINAPI *pfD2D1CreateFactory)
+  (D2D1_FACTORY_TYPE, REFIID, const D2D1_FACTORY_OPTIONS*, void**);
+typedef HRESULT (WINAPI *pfDWriteCreateFactory)
+  (DWRITE_FACTORY_TYPE, REFIID, IUnknown**);
+
+static ID2D1Factory* d2d_factory;
+static IDWriteFactory* dwrite_factory;
+static ID2D1DCRenderTarget* d2d_target;
+static ID2D1SolidColorBrush* d2d_brush;
+static Color d2d_brush_color;
+static bool d2d_tried, d2d_ok;
+static int d2d_wanted = -1; // -1 until direct2d(bool) or the first use
+static bool d2d_drawing; // BeginDraw() has been done
+
+static bool make_target() {
+  // 96 dpi so a DIP is a pixel:
+  D2D1_RENDER_TARGET_PROPERTIES props = D2D1::RenderTargetProperties(
+    D2D1_RENDER_TARGET_TYPE_DEFAULT,
+    D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE),
+    96, 96);
+  if (FAILED(d2d_factory->CreateDCRenderTarget(&props, &d2d_target))) {
+    d2d_target = 0;
+    return false;
+  }
+  if (FAILED(d2d_target->CreateSolidColorBrush(D2D1::ColorF(0,0,0), &d2d_brush))) {
+    d2d_brush = 0;
+    d2d_target->Release(); d2d_target = 0;
+    return false;
+  }
+  d2d_brush_color = BLACK;
+  return true;
+}
+
+static void free_target() {
+  if (d2d_brush) {d2d_brush->Release(); d2d_brush = 0;}
+  if (d2d_target) {d2d_target->Release(); d2d_target = 0;}
+}
+
+static bool d2d_init() {
+  HMODULE d2d = __LoadLibraryW(L"d2d1.dll");
+  HMODULE dw = __LoadLibraryW(L"dwrite.dll");
+  if (!d2d || !dw) return false;
+  pfD2D1CreateFactory d2d_create =
+    (pfD2D1CreateFactory)GetProcAddress(d2d, "D2D1CreateFactory");
+  pfDWriteCreateFactory dwrite_create =
+    (pfDWriteCreateFactory)GetProcAddress(dw, "DWriteCreateFactory");
+  if (!d2d_create || !dwrite_create) return false;
+  if (FAILED(d2d_create(D2D1_FACTORY_TYPE_SINGLE_THREADED,
+			__uuidof(ID2D1Factory), 0, (void**)&d2d_factory))) {
+    d2d_factory = 0;
+    return false;
+  }
+  if (FAILED(dwrite_create(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory),
+			   (IUnknown**)&dwrite_factory))) {
+    dwrite_factory = 0;
+    return false;
+  }
+  return make_target();
+}
+
+/*!
+  Return true if text and fillrect() are drawn with Direct2D and
+  DirectWrite rather than GDI. This is true if Windows has them, unless
+  the program is running in a remote desktop session or direct2d(false)
+  was called.
+*/
+bool fltk::direct2d() {
+  if (d2d_wanted < 0) d2d_wanted = !GetSystemMetrics(SM_REMOTESESSION);
+  if (!d2d_wanted) return false;
+  if (!d2d_tried) {d2d_tried = true; d2d_ok = d2d_init();}
+  return d2d_ok;
+}
+
+/*!
+  Turn the use of Direct2D on or off. Widths returned by getwidth()
+  may change, so you should relayout() any windows after calling this.
+  This has no effect if Windows does not have Direct2D.
+*/
+void fltk::direct2d(bool v) {
+  fl_d2d_flush();
+  d2d_wanted = v;
+}
+
+// Start a batch of Direct2D drawing into dc. Returns false if GDI must
+// be used. The target ignores the clip of the dc, so it is copied,
+// which is not possible if it is not a rectangle:
+static bool d2d_begin() {
+  if (d2d_drawing) return true;
+  if (!direct2d()) return false;
+  if (!d2d_target && !make_target()) return false;
+  RECT box;
+  int type = GetClipBox(dc, &box);
+  if (type == COMPLEXREGION || type == ERROR) return false;
+  RECT all = {0, 0, fl_clip_w, fl_clip_h};
+  if (FAILED(d2d_target->BindDC(dc, &all))) return false;
+  d2d_target->BeginDraw();
+  d2d_target->PushAxisAlignedClip(
+    D2D1::RectF(float(box.left), float(box.top),
+		float(box.right), float(box.bottom)),
+    D2D1_ANTIALIAS_MODE_ALIASED);
+  d2d_drawing = true;
+  return true;
+}
+
+// Finish the Direct2D drawing, so GDI can draw on top of it:
+void fl_d2d_flush() {
+  if (!d2d_drawing) return;
+  d2d_drawing = false;
+  d2d_target->PopAxisAlignedClip();
+  // the device was lost, make a new target the next time:
+  if (d2d_target->EndDraw() == D2DERR_RECREATE_TARGET) free_target();
+}
+
+static void set_brush_color() {
+  Color color = getcolor();
+  if (color == d2d_brush_color) return;
+  d2d_brush_color = color;
+  uchar r,g,b; split_color(color, r,g,b);
+  d2d_brush->SetColor(D2D1::ColorF(r/255.0f, g/255.0f, b/255.0f));
+}
+
+// Used by fillrect() in place of GDI, the rectangle is transformed:
+bool fl_d2d_fillrect(int x, int y, int w, int h) {
+  if (!d2d_begin()) return false;
+  set_brush_color();
+  d2d_target->FillRectangle(D2D1::RectF(float(x), float(y),
+					float(x+w), float(y+h)), d2d_brush);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////
+// DirectWrite text:
+
+static IDWriteTextFormat* dwrite_format(FontSize* f) {
+  if (f->dwformat) return f->dwformat;
+  // DirectWrite does not map the characters of symbol fonts:
+  if (f->charset == SYMBOL_CHARSET || f->metr.tmCharSet == SYMBOL_CHARSET)
+    return 0;
+  wchar_t family[LF_FACESIZE];
+  int len = utf8towc(f->name, strlen(f->name), family, LF_FACESIZE-1);
+  family[len < LF_FACESIZE ? len : LF_FACESIZE-1] = 0;
+  IDWriteTextFormat* format;
+  if (FAILED(dwrite_factory->CreateTextFormat(
+	family, 0,
+	(f->attr&BOLD) ? DWRITE_FONT_WEIGHT_BOLD : DWRITE_FONT_WEIGHT_NORMAL,
+	(f->attr&ITALIC) ? DWRITE_FONT_STYLE_ITALIC : DWRITE_FONT_STYLE_NORMAL,
+	DWRITE_FONT_STRETCH_NORMAL, float(f->size), L"", &format)))
+    return 0;
+  format->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+  // put the baseline where GDI does, so getascent() is still right:
+  format->SetLineSpacing(DWRITE_LINE_SPACING_METHOD_UNIFORM,
+			 float(f->metr.tmHeight), float(f->metr.tmAscent));
+  return f->dwformat = format;
+}
+
+// The layouts of each FontSize are a small table indexed by a hash of
+// the text, a new string replaces the one in its slot:
+struct TextLayout {
+  unsigned hash;
+  int n;
+  char* text;
+  IDWriteTextLayout* layout;
+  float width;
+};
+
+enum {LAYOUTS = 256}; // power of 2
+enum {MAX_LAYOUT_LENGTH = 256}; // longer strings are not remembered
+
+static void free_layouts(FontSize* f) {
+  if (!f->layouts) return;
+  for (int i = 0; i < LAYOUTS; i++) {
+    TextLayout& t = f->layouts[i];
+    if (t.layout) t.layout->Release();
+    delete[] t.text;
+  }
+  delete[] f->layouts;
+  f->layouts = 0;
+}
+
+static IDWriteTextLayout* new_layout(const char* text, int n) {
+  enum {BUFLEN = 256};
+  wchar_t localbuffer[BUFLEN];
+  wchar_t* buffer = localbuffer;
+  wchar_t* mallocbuffer = 0;
+  int count = utf8towc(text, n, buffer, BUFLEN);
+  if (count >= BUFLEN) {
+    buffer = mallocbuffer = new wchar_t[count+1];
+    count = utf8towc(text, n, buffer, count+1);
+  }
+  IDWriteTextLayout* layout;
+  if (FAILED(dwrite_factory->CreateTextLayout(buffer, count,
+					      dwrite_format(current),
+					      1e6f, 1e6f, &layout)))
+    layout = 0;
+  delete[] mallocbuffer;
+  return layout;
+}
+
+static float layout_width(IDWriteTextLayout* layout) {
+  DWRITE_TEXT_METRICS m;
+  if (FAILED(layout->GetMetrics(&m))) return 0;
+  return m.widthIncludingTrailingWhitespace;
+}
+
+// Return the layout of the text in the current font, which the caller
+// must not Release(). Returns null for errors:
+static TextLayout* find_layout(const char* text, int n) {
+  if (n > MAX_LAYOUT_LENGTH) return 0;
+  unsigned hash = 2166136261u;
+  for (int i = 0; i < n; i++) hash = (hash^(uchar)text[i])*16777619u;
+  if (!current->layouts) {
+    current->layouts = new TextLayout[LAYOUTS];
+    memset(current->layouts, 0, LAYOUTS*sizeof(TextLayout));
+  }
+  TextLayout& t = current->layouts[hash&(LAYOUTS-1)];
+  if (t.layout && t.hash == hash && t.n == n && !memcmp(t.text, text, n))
+    return &t;
+  IDWriteTextLayout* layout = new_layout(text, n);
+  if (!layout) return 0;
+  if (t.layout) t.layout->Release();
+  if (!t.text || t.n < n) {delete[] t.text; t.text = new char[n ? n : 1];}
+  memcpy(t.text, text, n);
+  t.hash = hash;
+  t.n = n;
+  t.layout = layout;
+  t.width = layout_width(layout);
+  return &t;
+}
+
+// Measure function for the width cache, also makes the layout for
+// drawing the text, as it is probably going to be drawn next:
+static float dwrite_width(const char* text, int n) {
+  if (TextLayout* t = find_layout(text, n)) return t->width;
+  IDWriteTextLayout* layout = new_layout(text, n);
+  if (!layout) return 0;
+  float w = layout_width(layout);
+  layout->Release();
+  return w;
+}
+
+static bool d2d_drawtext(const char* text, int n, float x, float y) {
+  if (!direct2d() || !dwrite_format(current)) return false;
+  TextLayout* t = find_layout(text, n);
+  IDWriteTextLayout* layout = t ? t->layout : new_layout(text, n);
+  if (!layout) return false;
+  bool drawn = false;
+  if (d2d_begin()) {
+    set_brush_color();
+    // the same rounding as TextOutW:
+    float X = floorf(x+.5f);
+    float Y = floorf(y+.5f)-current->metr.tmAscent;
+    d2d_target->DrawTextLayout(D2D1::Point2F(X, Y), layout, d2d_brush);
+    drawn = true;
+  }
+  if (!t) layout->Release();
+  return drawn;
+}
+
+#else
+
+// Without the headers everything is drawn with GDI:
+bool fltk::direct2d() {return false;}
+void fltk::direct2d(bool) {}
+void fl_d2d_flush() {}
+bool fl_d2d_fillrect(int, int, int, int) {return false;}
+
+#endif
+
+//
+// End of "$Id$".
+//
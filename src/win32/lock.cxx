@@ -1,29 +1,62 @@
-#include <windows.h>
-#include <process.h>
+#include <fltk/Threads.h> // this includes <windows.h> and <process.h>
 
 // these pointers are in run.cxx:
 extern void (*fl_lock_function)();
 extern void (*fl_unlock_function)();
+extern void (*fl_share_lock_function)();
+extern void (*fl_unshare_lock_function)();
 static void init_function();
 static void (*init_or_lock_function)() = init_function;
 
+// See ../lock.cxx for how the critical section and rwlock work together:
 static CRITICAL_SECTION cs;
+static fltk::RWMutex rwlock;
+
+// How many lock() calls each thread has not unlocked. Only the thread
+// itself touches its count, so have_lock() can't see one belonging to
+// the thread that has the lock now:
+static DWORD depth_index;
+static inline LONG_PTR lock_depth() {return (LONG_PTR)TlsGetValue(depth_index);}
+static inline void lock_depth(LONG_PTR d) {TlsSetValue(depth_index, (void*)d);}
 
 static void unlock_function() {
+  LONG_PTR d = lock_depth()-1;
+  lock_depth(d);
+  if (!d) rwlock.unlock();
   LeaveCriticalSection(&cs);
 }
 
 static void lock_function() {
   EnterCriticalSection(&cs);
+  LONG_PTR d = lock_depth();
+  if (!d) rwlock.lock();
+  lock_depth(d+1);
+}
+
+static void share_lock_function() {
+  rwlock.unlock();
+  rwlock.read_lock();
+}
+
+static void unshare_lock_function() {
+  rwlock.read_unlock();
+  rwlock.lock();
+}
+
+static bool have_lock() {
+  return lock_depth() > 0;
 }
 
 static DWORD main_thread_id;
 
 static void init_function() {
   InitializeCriticalSection(&cs);
+  depth_index = TlsAlloc();
   lock_function();
   fl_lock_function = init_or_lock_function = lock_function;
   fl_unlock_function = unlock_function;
+  fl_share_lock_function = share_lock_function;
+  fl_unshare_lock_function = unshare_lock_function;
   main_thread_id = GetCurrentThreadId();
 }
 
@@ -31,6 +64,16 @@ void fltk::lock() {init_or_lock_function();}
 
 void fltk::unlock() {fl_unlock_function();}
 
+void fltk::lock_shared() {
+  if (init_or_lock_function == init_function || have_lock()) return;
+  rwlock.read_lock();
+}
+
+void fltk::unlock_shared() {
+  if (init_or_lock_function == init_function || have_lock()) return;
+  rwlock.read_unlock();
+}
+
 bool fltk::in_main_thread() {
   return init_or_lock_function == init_function || GetCurrentThreadId() == main_thread_id;
 }
@@ -39,6 +39,7 @@
 #include <fltk/filename.h>
 #include <fltk/utf.h>
 #include <fltk/Monitor.h>
+#include "../DamageRects.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -357,13 +358,41 @@ void fltk::remove_fd(int n, int events) {
 static void nothing() {}
 void (*fl_lock_function)() = nothing;
 void (*fl_unlock_function)() = nothing;
+// these are set by lock() so other threads can lock_shared() during flush():
+void (*fl_share_lock_function)() = nothing;
+void (*fl_unshare_lock_function)() = nothing;
+
+// Messages from fltk::awake() are queued by the main thread as the
+// WM_MAKEWAITRETURN messages arrive, so none of them are lost:
+static void** thread_messages;
+static int thread_messages_first, thread_messages_count, thread_messages_size;
+
+static void queue_thread_message(void* m) {
+  if (!m) return;
+  if (thread_messages_count >= thread_messages_size) {
+    int n = thread_messages_size ? 2*thread_messages_size : 64;
+    void** a = new void*[n];
+    for (int i = 0; i < thread_messages_count; i++)
+      a[i] = thread_messages[(thread_messages_first+i)%thread_messages_size];
+    delete[] thread_messages;
+    thread_messages = a;
+    thread_messages_first = 0;
+    thread_messages_size = n;
+  }
+  thread_messages[(thread_messages_first+thread_messages_count++)
+		  % thread_messages_size] = m;
+}
 
-static void* thread_message_;
+// CYGWIN with pthreads uses the pipe and queue in lock.cxx instead:
+#if !(defined(__CYGWIN__) && HAVE_PTHREAD)
 void* fltk::thread_message() {
-  void* r = thread_message_;
-  thread_message_ = 0;
+  if (!thread_messages_count) return 0;
+  void* r = thread_messages[thread_messages_first];
+  thread_messages_first = (thread_messages_first+1) % thread_messages_size;
+  thread_messages_count--;
   return r;
 }
+#endif
 
 // ready() is just like wait(0.0) except no callbacks are done:
 static inline int fl_ready() {
@@ -456,7 +485,7 @@ static inline int fl_wait(double time_to_wait) {
 #endif
     if (msg.message == WM_MAKEWAITRETURN) {
       // save any data from fltk::awake() call:
-      if (msg.wParam) thread_message_ = (void*)msg.wParam;
+      queue_thread_message((void*)msg.wParam);
       // WM_MAKEWAITRETURN is used by WndProc to try to make wait()
       // return so the main loop recovers and can flush the display. We
       // purposely do not dispatch this message, as the desired result
@@ -1719,7 +1748,7 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
 
   case WM_MAKEWAITRETURN:
     // save any data from fltk::awake() call:
-    if (wParam) thread_message_ = (void*)wParam;
+    queue_thread_message((void*)wParam);
     // This will be called if MakeWaitReturn fails because Stoopid Windows
     // called the WndProc directly. Instead do the best we can, which is
     // to flush the display.
@@ -2097,6 +2126,7 @@ void CreatedWindow::create(Window* window) {
 
   CreatedWindow* x = new CreatedWindow;
   x->backbuffer = 0;
+  x->backbuffer_bits = 0;
   x->overlay = false;
   x->window = window; window->i = x;
   x->region = 0;
@@ -2251,6 +2281,8 @@ void Window::label(const char *name,const char *iname) {
 const Window *Window::drawing_window_;
 int fl_clip_w, fl_clip_h;
 
+extern void fl_d2d_flush(); // in win32/direct2d.cxx
+
 /** The device context that is currently being drawn into. */
 HDC fltk::dc;
 
@@ -2276,6 +2308,7 @@ void Widget::make_current() const {
     widget = widget->parent();
   }
   const Window* window = (const Window*)widget;
+  fl_d2d_flush();
   Window::drawing_window_ = window;
   fl_clip_w = window->w();
   fl_clip_h = window->h();
@@ -2293,6 +2326,7 @@ namespace fltk {class Image;}
 fltk::Image* fl_current_Image;
 
 void fltk::draw_into(HBITMAP bitmap, int w, int h) {
+  fl_d2d_flush();
   if (!fl_bitmap_dc) {
     fl_bitmap_dc = CreateCompatibleDC(getDC());
     SetTextAlign(fl_bitmap_dc, TA_BASELINE|TA_LEFT);
@@ -2340,6 +2374,7 @@ void*Window::backbuffer() const {return i ? (void*)i->bdc:0;}
 
 void Window::flush() {
 
+  fl_d2d_flush();
   drawing_window_ = this;
   fl_clip_w = w();
   fl_clip_h = h();
@@ -2358,7 +2393,26 @@ void Window::flush() {
     if (eraseoverlay) damage &= ~DAMAGE_OVERLAY;
 
     if (!i->backbuffer) { // we need to create back buffer
-      i->backbuffer = CreateCompatibleBitmap(i->dc, w(), h());
+      // A 32-bit DIB section, so drawimage() can put the pixels right
+      // into it rather than copying them through GDI:
+      BITMAPINFO bmi;
+      memset(&bmi, 0, sizeof(BITMAPINFO));
+      bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+      bmi.bmiHeader.biWidth = w();
+      bmi.bmiHeader.biHeight = -h(); // top to bottom
+      bmi.bmiHeader.biPlanes = 1;
+      bmi.bmiHeader.biBitCount = 32;
+      bmi.bmiHeader.biCompression = BI_RGB;
+      void* bits = 0;
+      i->backbuffer = CreateDIBSection(i->dc, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+      if (i->backbuffer) {
+	i->backbuffer_bits = (uchar*)bits;
+	i->backbuffer_w = w();
+	i->backbuffer_h = h();
+      } else {
+	i->backbuffer = CreateCompatibleBitmap(i->dc, w(), h());
+	i->backbuffer_bits = 0;
+      }
       i->backbuffer_bad = true;
       i->bdc = CreateCompatibleDC(i->dc);
       SelectObject(i->bdc, i->backbuffer);
@@ -2366,6 +2420,12 @@ void Window::flush() {
       SetBkMode(i->bdc, TRANSPARENT);
     }
 
+    // If only children changed, remember their rectangles so only
+    // they are copied to the front:
+    DamageRects rects;
+    bool use_rects = sparse_update() && !eraseoverlay && !i->backbuffer_bad
+      && (damage & ~DAMAGE_EXPOSE) == DAMAGE_CHILD;
+
     // draw the back buffer if it needs anything:
     if (damage || i->backbuffer_bad) {
       // set the graphics context to draw into back buffer:
@@ -2381,27 +2441,43 @@ void Window::flush() {
       } else {
 	// draw all the changed widgets:
 	if (damage & ~DAMAGE_EXPOSE) {
+	  DamageRects* saved = fl_damage_rects;
+	  if (use_rects) fl_damage_rects = &rects;
 	  set_damage(damage & ~DAMAGE_EXPOSE);
 	  draw();
+	  fl_damage_rects = saved;
 	}
 	// draw for any expose events (if Xdbe is not being used this will
 	// only happen for redraw(x,y,w,h) calls):
 	if (i->region) {
 	  clip_region(i->region); i->region = 0;
 	  set_damage(DAMAGE_EXPOSE); draw();
-	  clip_region(0);
+	  // keep the clip for the copy if only children changed:
+	  if (!use_rects) clip_region(0);
 	}
       }
       i->backbuffer_bad = false;
       //fl_restore_clip(); // duplicate region into new dc (there is none)
     }
 
+    fl_d2d_flush(); // finish the drawing into the back buffer
     dc = i->dc;
 
     // Clip the copying of the pixmap to the damage area,
     // this makes it faster, especially if the damage area is small:
     if (!damage && !eraseoverlay) {
       clip_region(i->region); i->region = 0;
+    } else if (use_rects) {
+      // add the redrawn children to any expose region and clip to that:
+      HRGN r = CreateRectRgn(0, 0, 0, 0);
+      for (int n = 0; n < rects.n; n++) {
+	const Rectangle& q = rects.rect[n];
+	HRGN R = CreateRectRgn(q.x(), q.y(), q.r(), q.b());
+	CombineRgn(r, r, R, RGN_OR);
+	DeleteObject(R);
+      }
+      if (clip_region()) CombineRgn(r, r, clip_region(), RGN_OR);
+      clip_region(r);
     }
 
     // Copy the backbuffer to the window:
@@ -2444,6 +2520,7 @@ void Window::free_backbuffer() {
   i->bdc = 0;
   DeleteObject(i->backbuffer);
   i->backbuffer = 0;
+  i->backbuffer_bits = 0;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -137,11 +137,14 @@ static void load_dc_funcs()
 
 #endif /* USE_STOCK_BRUSH */
 
+extern void fl_d2d_flush(); // in win32/direct2d.cxx
+
 /** Set the current "pen" in the DC to match the most recent setcolor()
     and line_style() calls. This is stupid-expensive on Windows so
     we defer it until the pen is needed.
 */
 HPEN fltk::setpen() {
+  fl_d2d_flush(); // anything drawing with GDI calls this first
 #if USE_STOCK_BRUSH
   if (!lstyle && line_width_i <= 1) {
     if (!dc_funcs_init) load_dc_funcs();
@@ -186,6 +189,7 @@ static void free_brush()
     we defer it until the brush is needed.
 */
 HBRUSH fltk::setbrush() {
+  fl_d2d_flush();
 #if USE_STOCK_BRUSH
   if (!dc_funcs_init) load_dc_funcs();
   if (__SetDCBrushColor) {
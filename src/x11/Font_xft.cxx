@@ -60,7 +60,10 @@ struct FontSize {
   unsigned fonthash; // id of the actual glyph images
   unsigned opengl_id; // for OpenGL display lists
   unsigned texture; // for OpenGL display lists
+  WidthCache* widths; // for getwidth()
+  float* advances; // for Font::fast_metrics()
   XFontStruct* xfont;
+  unsigned lastused; // value of font_clock when last chosen by setfont()
   //~FontSize();
 };
 
@@ -70,6 +73,11 @@ struct IFont {
   int attribute_mask; // attributes that can still be turned on
   unsigned numsizes;
   FontSize* fontsizes;
+  // saved results of sizes() and encodings():
+  int* size_list;
+  int num_size_list;
+  const char** encoding_list;
+  int num_encoding_list;
 };
 
 // We store the attributes in neat blocks of 2^n:
@@ -85,12 +93,75 @@ const char* fltk::Font::system_name() {
 
 static FontSize* current;
 
+// The XftFonts are closed when more than Font::max_open_fonts() are
+// open, the FontSize is kept (with the widths and OpenGL ids) and the
+// font is opened again if it is used:
+static unsigned font_clock;
+static int num_open_fonts;
+static IFont** sized_fonts; // all fonts with any fontsizes
+static int num_sized_fonts;
+
+static void close_unused_fonts() {
+  const int max = fltk::Font::max_open_fonts_;
+  while (max > 0 && num_open_fonts > max) {
+    FontSize* oldest = 0;
+    for (int i = 0; i < num_sized_fonts; i++) {
+      IFont* font = sized_fonts[i];
+      for (unsigned j = 0; j < font->numsizes; j++) {
+	FontSize* f = font->fontsizes+j;
+	if (f->font && f != current &&
+	    (!oldest || font_clock-f->lastused > font_clock-oldest->lastused))
+	  oldest = f;
+      }
+    }
+    if (!oldest) return;
+    XftFontClose(xdisplay, oldest->font);
+    oldest->font = 0;
+    oldest->xfont = 0;
+    num_open_fonts--;
+  }
+}
+
+// For memory_report(). Xft also keeps the glyphs of each open font,
+// up to its max_glyph_memory, which cannot be found out:
+void fl_font_memory(unsigned long& count, unsigned long& bytes) {
+  count = num_open_fonts;
+  bytes = 0;
+  for (int i = 0; i < num_sized_fonts; i++) {
+    IFont* font = sized_fonts[i];
+    bytes += font->numsizes*sizeof(FontSize);
+    for (unsigned j = 0; j < font->numsizes; j++) {
+      FontSize* f = font->fontsizes+j;
+      bytes += fl_width_cache_bytes(f->widths);
+      if (f->advances) bytes += 256*sizeof(float);
+    }
+  }
+}
+
+/*! Returns how many fonts are open right now, each of which has
+  glyphs stored by the X server. This is only counted for Xft, and
+  is zero elsewhere. */
+int fltk::Font::open_fonts() {return num_open_fonts;}
+
 // API to OpenGL/gl_draw.cxx:
 FL_API unsigned fl_font_opengl_id() {return current->opengl_id;}
 FL_API unsigned fl_font_opengl_texture() {return current->texture;}
 FL_API void fl_set_font_opengl_id(unsigned v) {current->opengl_id = v;}
 FL_API void fl_set_font_opengl_texture(unsigned v) {current->texture = v;}
 
+static XftFont* fontopen(const char* name, int attributes, float size, bool core);
+
+// Make f the current one, opening it again if it was closed:
+static void use_fontsize(fltk::Font* font, FontSize* f) {
+  current = f;
+  f->lastused = ++font_clock;
+  if (!f->font) {
+    f->font = fontopen(font->name_, font->attributes_, f->minsize, false);
+    num_open_fonts++;
+    close_unused_fonts();
+  }
+}
+
 static XftFont* fontopen(const char* name, int attributes, float size, bool core) {
   open_display();
   int weight = XFT_WEIGHT_MEDIUM;
@@ -114,6 +185,10 @@ void fltk::setfont(fltk::Font* font, float size) {
   // Older Xft craps out with tiny sizes and returns null for the font
   if (size < 2) size = 2;
 #endif
+  if (Font::size_step_ > 0) {
+    float s = floorf(size/Font::size_step_+.5f)*Font::size_step_;
+    if (s > 0) size = s;
+  }
   current_size_ = size;
   if (font == current_font_
       && current->minsize <= size && current->maxsize >= size)
@@ -128,7 +203,7 @@ void fltk::setfont(fltk::Font* font, float size) {
     FontSize* f = array+c;
     if (size < f->minsize) b = c;
     else if (size > f->maxsize) a = c+1;
-    else {current = f; return;}
+    else {use_fontsize(font, f); return;}
   }
   // new font should now be inserted at a.
   // Ask Xft for the font:
@@ -142,16 +217,25 @@ void fltk::setfont(fltk::Font* font, float size) {
   if (a > 0 && fonthash == array[a-1].fonthash) {
     array[a-1].maxsize = size;
     XftFontClose(xdisplay, xftfont);
-    current = array+a-1;
+    use_fontsize(font, array+a-1);
     return;
   }
   if (a < n && fonthash == array[a].fonthash) {
     array[a].minsize = size;
     XftFontClose(xdisplay, xftfont);
-    current = array+a;
+    use_fontsize(font, array+a);
     return;
   }
   // insert the new entry into the list:
+  if (!n) {
+    static int sized_fonts_size;
+    if (num_sized_fonts >= sized_fonts_size) {
+      sized_fonts_size = sized_fonts_size ? 2*sized_fonts_size : 64;
+      sized_fonts = (IFont**)
+	realloc(sized_fonts, sized_fonts_size*sizeof(IFont*));
+    }
+    sized_fonts[num_sized_fonts++] = (IFont*)font;
+  }
   if (!(n&(n+1))) {
     unsigned m = 2*(n+1)-1;
     FontSize* newarray = new FontSize[m];
@@ -168,8 +252,14 @@ void fltk::setfont(fltk::Font* font, float size) {
   f->font = xftfont;
   f->fonthash = fonthash;
   f->opengl_id = 0;
+  f->texture = 0;
+  f->widths = 0;
+  f->advances = 0;
   f->xfont = 0; // figure this out later
+  f->lastused = ++font_clock;
   current = f;
+  num_open_fonts++;
+  close_unused_fonts();
 }
 
 #if 0 // this is never called!
@@ -231,7 +321,7 @@ float fltk::getdescent() { return current->font->descent; }
 // pain to track down!
 #define WCBUFLEN 256
 
-float fltk::getwidth(const char *str, int n) {
+static float measure_width(const char *str, int n) {
   XGlyphInfo i;
 #if 0
   XftTextExtentsUtf8(xdisplay, current->font, (XftChar8*)str, n, &i);
@@ -253,13 +343,28 @@ float fltk::getwidth(const char *str, int n) {
   return i.xOff;
 }
 
-////////////////////////////////////////////////////////////////
+float fltk::getwidth(const char *str, int n) {
+  if (Font::fast_metrics_) {
+    if (!current->advances) {
+      float* a = current->advances = new float[256];
+      for (unsigned c = 0; c < 256; c++) {
+	FT_UInt glyph = XftCharIndex(xdisplay, current->font, c);
+	XGlyphInfo i;
+	XftGlyphExtents(xdisplay, current->font, &glyph, 1, &i);
+	a[c] = i.xOff;
+      }
+    }
+    float w = fl_sum_advances(current->advances, str, n);
+    if (w >= 0) return w;
+  }
+  return fl_cached_width(current->widths, str, n, measure_width);
+}
 
-void fltk::drawtext_transformed(const char *str, int n, float x, float y) {
+////////////////////////////////////////////////////////////////
 
-  // Use fltk's color allocator, copy the results to match what
-  // XftCollorAllocValue returns:
-  XftColor color;
+// Use fltk's color allocator, copy the results to match what
+// XftCollorAllocValue returns. Also used by GlyphRun.cxx:
+void fl_xft_color(XftColor& color) {
 #if USE_CAIRO
   color.pixel = 0;
 #else
@@ -270,6 +375,51 @@ void fltk::drawtext_transformed(const char *str, int n, float x, float y) {
   color.color.green = g*0x101;
   color.color.blue  = b*0x101;
   color.color.alpha = 0xffff;
+}
+
+#if USE_CAIRO
+#include <cairo-ft.h>
+
+// Image::make_current() draws into memory with no Xft drawable, so
+// Cairo draws the glyphs instead, from the fontconfig pattern of the
+// same font, placed by the Xft advances so they match the measuring:
+static cairo_font_face_t* cairo_face;
+static XftFont* cairo_face_font; // what cairo_face was made for
+
+static void cairo_drawglyphs(const wchar_t* text, int n, float x, float y) {
+  XftFont* font = current->font;
+  if (font != cairo_face_font) {
+    if (cairo_face) cairo_font_face_destroy(cairo_face);
+    cairo_face = cairo_ft_font_face_create_for_pattern(font->pattern);
+    cairo_face_font = font;
+  }
+  double size;
+  if (FcPatternGetDouble(font->pattern, FC_PIXEL_SIZE, 0, &size) != FcResultMatch)
+    size = font->ascent+font->descent;
+  cairo_set_font_face(cr, cairo_face);
+  cairo_set_font_size(cr, size);
+  cairo_glyph_t localglyphs[WCBUFLEN];
+  cairo_glyph_t* glyphs = n > WCBUFLEN ? new cairo_glyph_t[n] : localglyphs;
+  double gx = floorf(x+.5f);
+  double gy = floorf(y+.5f);
+  for (int i = 0; i < n; i++) {
+    FT_UInt g = XftCharIndex(xdisplay, font, text[i]);
+    XGlyphInfo info;
+    XftGlyphExtents(xdisplay, font, &g, 1, &info);
+    glyphs[i].index = g;
+    glyphs[i].x = gx;
+    glyphs[i].y = gy;
+    gx += info.xOff;
+  }
+  cairo_show_glyphs(cr, glyphs, n);
+  if (glyphs != localglyphs) delete[] glyphs;
+}
+#endif
+
+void fltk::drawtext_transformed(const char *str, int n, float x, float y) {
+
+  XftColor color;
+  fl_xft_color(color);
 
 #if 0
   XftDrawStringUtf8(xftc, &color, current->font,
@@ -287,6 +437,12 @@ void fltk::drawtext_transformed(const char *str, int n, float x, float y) {
   // fix some lengths that cause older Xft to crash (!):
   if ((count&255)==253) buffer[count++] = ' ';
   if ((count&255)==254) buffer[count++] = ' ';
+  frame_counts_.glyphs += count;
+#if USE_CAIRO
+  if (!xwindow)
+    cairo_drawglyphs(buffer, count, x, y);
+  else
+#endif
   XftDrawString32(xftc, &color, current->font,
 		  int(floorf(x+.5f)), int(floorf(y+.5f)),
 		  (XftChar32*)buffer, count);
@@ -354,9 +510,10 @@ static int sort_function(const void *aa, const void *bb) {
   return a->attributes_ - b->attributes_;
 }}
 
-int fltk::list_fonts(fltk::Font**& arrayp) {
-  static fltk::Font** font_array = 0;
-  static int num_fonts = 0;
+static fltk::Font** font_array = 0;
+static int num_fonts = 0;
+
+static int make_font_list(fltk::Font**& arrayp) {
   if (font_array) { arrayp = font_array; return num_fonts; }
 
   // Make sure fontconfig is ready... is this necessary? The docs say it is
@@ -407,6 +564,8 @@ int fltk::list_fonts(fltk::Font**& arrayp) {
       newfont[j].attribute_mask = 3-j;
       newfont[j].numsizes = 0;
       newfont[j].fontsizes = 0;
+      newfont[j].size_list = 0;
+      newfont[j].encoding_list = 0;
     }
   }
   num_fonts = k;
@@ -419,6 +578,85 @@ int fltk::list_fonts(fltk::Font**& arrayp) {
   return num_fonts;
 }
 
+#if HAVE_PTHREAD
+#include <fltk/Threads.h>
+#include <fltk/trace.h>
+#include <fltk/run.h>
+
+// This only calls fontconfig, which is thread safe, so it can run while
+// the main thread opens the display and loads the theme:
+static fltk::ThreadPool::TaskId prefetch_task;
+static bool prefetching;
+
+static void prefetch_function(void*) {
+  fltk::Font** array;
+  make_font_list(array);
+}
+
+void fltk::prefetch_fonts() {
+  if (prefetching || font_array) return;
+  prefetching = true;
+  prefetch_task = ThreadPool::shared()->add(prefetch_function, 0);
+}
+
+// Callbacks waiting for list_fonts(done,arg):
+struct FontListCallback {
+  void (*cb)(void*);
+  void* arg;
+};
+static FontListCallback* font_list_callbacks;
+static int num_font_list_callbacks;
+
+// The main thread checks this often until the other thread is done:
+static void font_list_poll(void*) {
+  if (prefetching && !fltk::ThreadPool::shared()->done(prefetch_task)) {
+    fltk::repeat_timeout(.02f, font_list_poll);
+    return;
+  }
+  fltk::Font** array;
+  fltk::list_fonts(array);
+  // the callbacks may call list_fonts(done,arg) again:
+  FontListCallback* list = font_list_callbacks;
+  int n = num_font_list_callbacks;
+  font_list_callbacks = 0;
+  num_font_list_callbacks = 0;
+  for (int i = 0; i < n; i++) list[i].cb(list[i].arg);
+  delete[] list;
+}
+
+// Make the list in the other thread and call done from fltk::wait()
+// once it is ready, so a font chooser can come up without waiting:
+void fltk::list_fonts(void (*done)(void*), void* arg) {
+  if (font_array && !prefetching) {done(arg); return;}
+  prefetch_fonts();
+  if (ThreadPool::shared()->done(prefetch_task)) { // already finished
+    fltk::Font** array;
+    list_fonts(array);
+    done(arg);
+    return;
+  }
+  FontListCallback* list = new FontListCallback[num_font_list_callbacks+1];
+  for (int i = 0; i < num_font_list_callbacks; i++)
+    list[i] = font_list_callbacks[i];
+  list[num_font_list_callbacks].cb = done;
+  list[num_font_list_callbacks].arg = arg;
+  delete[] font_list_callbacks;
+  font_list_callbacks = list;
+  if (!num_font_list_callbacks++) fltk::add_timeout(.02f, font_list_poll);
+}
+#endif
+
+int fltk::list_fonts(fltk::Font**& arrayp) {
+#if HAVE_PTHREAD
+  if (prefetching) {
+    TraceScope trace(TRACE_STARTUP, "wait for font list");
+    fltk::ThreadPool::shared()->wait(prefetch_task);
+    prefetching = false;
+  }
+#endif
+  return make_font_list(arrayp);
+}
+
 ////////////////////////////////////////////////////////////////
 
 extern "C" {
@@ -430,17 +668,18 @@ static int int_sort(const void *aa, const void *bb) {
 // Return all the point sizes supported by this font:
 // Suprisingly enough Xft works exactly like fltk does and returns
 // the same list. Except there is no way to tell if the font is scalable.
+// The list is saved in the font so it is only asked for once.
 int fltk::Font::sizes(int*& sizep) {
+  IFont* font = (IFont*)this;
+  if (font->size_list) {
+    sizep = font->size_list;
+    return font->num_size_list;
+  }
   open_display();
   XftFontSet* fs = XftListFonts(xdisplay, xscreen,
 				XFT_FAMILY, XftTypeString, name_, (void*)0,
 				XFT_PIXEL_SIZE, (void*)0);
-  static int* array = 0;
-  static int array_size = 0;
-  if (fs->nfont >= array_size) {
-    delete[] array;
-    array = new int[array_size = fs->nfont+1];
-  }
+  int* array = new int[fs->nfont+1];
   int j = 0;
   for (int i = 0; i < fs->nfont; i++) {
     double v;
@@ -454,28 +693,27 @@ int fltk::Font::sizes(int*& sizep) {
     array[0] = 0; j = 1; // claim all fonts are scalable by putting a 0 in
   }
   XftFontSetDestroy(fs);
-  sizep = array;
+  font->size_list = sizep = array;
+  font->num_size_list = j;
   return j;
 }
 
 ////////////////////////////////////////////////////////////////
 // Return all the encodings for this font:
 
+// This is also saved in the font. The strings belong to the XftFontSet,
+// which is never destroyed for this reason.
 int fltk::Font::encodings(const char**& arrayp) {
-  open_display();
-  // we need to keep the previous return value around so the strings are
-  // not destroyed.
-  static XftFontSet* fs;
-  if (fs) XftFontSetDestroy(fs);
-  fs = XftListFonts(xdisplay, xscreen,
-		    XFT_FAMILY, XftTypeString, name_, (void*)0,
-		    XFT_ENCODING, (void*)0);
-  static const char** array = 0;
-  static int array_size = 0;
-  if (fs->nfont > array_size) {
-    delete[] array;
-    array = new const char*[array_size = fs->nfont];
+  IFont* font = (IFont*)this;
+  if (font->encoding_list) {
+    arrayp = font->encoding_list;
+    return font->num_encoding_list;
   }
+  open_display();
+  XftFontSet* fs = XftListFonts(xdisplay, xscreen,
+				XFT_FAMILY, XftTypeString, name_, (void*)0,
+				XFT_ENCODING, (void*)0);
+  const char** array = new const char*[fs->nfont+1];
   int j = 0;
   for (int i = 0; i < fs->nfont; i++) {
     char* v;
@@ -483,7 +721,8 @@ int fltk::Font::encodings(const char**& arrayp) {
       array[j++] = v;
     }
   }
-  arrayp = array;
+  font->encoding_list = arrayp = array;
+  font->num_encoding_list = j;
   return j;
 }
 
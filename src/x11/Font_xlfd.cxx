@@ -45,6 +45,7 @@ struct FontSize {
   XFontStruct* font;
   const char* encoding;
   FontSize(const char* xfontname, const char*);
+  FontSize(XFontStruct*, const char*);
   const char* name;
   unsigned minsize;	// smallest point size that should use this
   unsigned maxsize;	// largest point size that should use this
@@ -83,6 +84,19 @@ XFontStruct* fltk::xfont() {return current->font;}
 */
 const char* fltk::Font::current_name() {return current->name;}
 
+// FontSizes are never deleted, so these only go up:
+static unsigned long num_fontsizes, fontsize_bytes;
+
+static void count_fontsize(XFontStruct* font) {
+  num_fontsizes++;
+  fontsize_bytes += sizeof(FontSize) + sizeof(XFontStruct) +
+    font->n_properties*sizeof(XFontProp);
+  if (font->per_char)
+    fontsize_bytes += sizeof(XCharStruct) *
+      (font->max_char_or_byte2-font->min_char_or_byte2+1) *
+      (font->max_byte1-font->min_byte1+1);
+}
+
 FontSize::FontSize(const char* name, const char* nname) {
   this->name = nname ? nname : name;
   font = XLoadQueryFont(xdisplay, name);
@@ -92,6 +106,22 @@ FontSize::FontSize(const char* name, const char* nname) {
   }
   encoding = 0;
   opengl_id = 0;
+  count_fontsize(font);
+}
+
+// Use a font already loaded by prefetch_fonts():
+FontSize::FontSize(XFontStruct* font, const char* name) {
+  this->name = name;
+  this->font = font;
+  encoding = 0;
+  opengl_id = 0;
+  count_fontsize(font);
+}
+
+// For memory_report():
+void fl_font_memory(unsigned long& count, unsigned long& bytes) {
+  count = num_fontsizes;
+  bytes = fontsize_bytes;
 }
 
 #if 0 // this is never called!
@@ -430,6 +460,7 @@ void fltk::drawtext_transformed(const char *text, int n, float x, float y) {
   }
   int count;
   XChar2b* buffer = utf8to2b(text,n,&count);
+  frame_counts_.glyphs += buffer ? count : n;
   if (buffer) {
 #if !X_UTF8_FONT
     XDrawString16(xdisplay, xwindow, gc,
@@ -529,56 +560,27 @@ float fltk::getwidth(const char *text, int n) {
 //
 // Fltk uses pixelsize, not "pointsize".  This is what everybody wants!
 
-void fltk::setfont(Font* font, float psize) {
-  FontSize* f = current;
-  IFont* t = (IFont*)font;
-
-  // only integers supported right now (this can be improved):
-  psize = int(psize+.5);
-  unsigned size = unsigned(psize);
-
-  // See if the current font is correct:
-  if (font == current_font_ && psize == current_size_ &&
-      ((f && f->encoding && encoding_ && f->encoding == encoding_) ||
-	   (!encoding_ || !strcmp(f->encoding, encoding_))))
-    return;
-  current_font_ = font; current_size_ = psize;
-
-  // search the FontSize we have generated already:
-  for (f = t->first; f; f = f->next)
-    if (f->minsize <= size && f->maxsize >= size
-        && (f->encoding==encoding_ ||
- 	    !f->encoding ||
-		(!encoding_ || !strcmp(f->encoding, encoding_)))) {
-      goto DONE;
-    }
-
-  // run XListFonts if it has not been done yet:
-  if (!t->xlist) {
-    open_display();
-    t->xlist = XListFonts(xdisplay, t->system_name, 100, &(t->n));
-    if (!t->xlist || t->n<=0) {	// use variable if no matching font...
-      t->first = f = new FontSize("variable",0);
-      f->minsize = 0;
-      f->maxsize = 32767;
-      goto DONE;
-    }
-  }
-
-  // now search the XListFonts results:
-  {char* name = t->xlist[0];
-  unsigned ptsize = 0;	// best one found so far
-  char namebuffer[1024];	// holds scalable font name
-  bool found_encoding = false;
-  int m = t->n; if (m<0) m = -m;
-  char* nname = 0;
+// Pick the best of the n names from XListFonts for size and encoding.
+// Returns the name to load, which is put in namebuffer for a scalable
+// font. nname is set to the listed name, ptsize to the size it is, and
+// found_encoding to whether it is the right encoding:
+static const char* pick_font(char** xlist, int n, unsigned size,
+			     const char* encoding, char* namebuffer,
+			     char*& nname, unsigned& ptsize,
+			     bool& found_encoding)
+{
+  const char* name = xlist[0];
+  ptsize = 0;	// best one found so far
+  found_encoding = false;
+  int m = n; if (m<0) m = -m;
+  nname = 0;
 
   for (int n=0; n < m; n++) {
 
-    char* thisname = t->xlist[n];
+    char* thisname = xlist[n];
     // get the encoding field:
     const char* this_encoding = font_word(thisname, 13);
-    if (*this_encoding++ && !strcmp(this_encoding, encoding_)) {
+    if (*this_encoding++ && !strcmp(this_encoding, encoding)) {
       // forget any wrong encodings when we find a correct one:
       if (!found_encoding) ptsize = 0;
       found_encoding = true;
@@ -616,37 +618,297 @@ void fltk::setfont(Font* font, float psize) {
       ptsize = thissize;
     }
   }
+  return name;
+}
 
-  // If we didn't find an exact match, search the list to see if we already
-  // found this font:
-  if (ptsize != size || !found_encoding) {
-    for (f = t->first; f; f = f->next) {
-      if (f->minsize <= ptsize && f->maxsize >= ptsize &&
-	  (!found_encoding || !strcmp(f->encoding, encoding_))) {
-	if (f->minsize > size) f->minsize = size;
-	if (f->maxsize < size) f->maxsize = size;
-	goto DONE;
-      }
+// If we didn't find an exact match, search the list to see if we already
+// found this font. If so extend its range to size and return it:
+static FontSize* find_fontsize(IFont* t, unsigned size, unsigned ptsize,
+			       bool found_encoding, const char* encoding)
+{
+  if (ptsize == size && found_encoding) return 0;
+  for (FontSize* f = t->first; f; f = f->next) {
+    if (f->minsize <= ptsize && f->maxsize >= ptsize &&
+	(!found_encoding || !strcmp(f->encoding, encoding))) {
+      if (f->minsize > size) f->minsize = size;
+      if (f->maxsize < size) f->maxsize = size;
+      return f;
     }
   }
+  return 0;
+}
 
-  // okay, we definately have some name, make the font:
-  f = new FontSize(name,nname);
+// Add a new FontSize to t that will be used for size:
+static void add_fontsize(IFont* t, FontSize* f, unsigned size,
+			 unsigned ptsize, const char* encoding)
+{
   // we pretend it has the current encoding even if it does not, so that
   // it is quickly matched when searching for it again with the same
   // encoding:
-  f->encoding = encoding_;
+  f->encoding = encoding;
   if (ptsize < size) {f->minsize = ptsize; f->maxsize = size;}
   else {f->minsize = size; f->maxsize = ptsize;}
   f->next = t->first;
-  t->first = f;}
+  t->first = f;
+}
+
+#if HAVE_PTHREAD
+static bool prefetch_pending(IFont*, unsigned size);
+static FontSize* fallback_font(IFont*, unsigned size);
+#endif
+static bool using_fallback; // current is a stand-in for the one asked for
+
+void fltk::setfont(Font* font, float psize) {
+  FontSize* f = current;
+  IFont* t = (IFont*)font;
+
+  // only integers supported right now (this can be improved):
+  psize = int(psize+.5);
+  unsigned size = unsigned(psize);
+
+  // See if the current font is correct:
+  if (font == current_font_ && psize == current_size_ && !using_fallback &&
+      ((f && f->encoding && encoding_ && f->encoding == encoding_) ||
+	   (!encoding_ || !strcmp(f->encoding, encoding_))))
+    return;
+  current_font_ = font; current_size_ = psize;
+
+  // search the FontSize we have generated already:
+  for (f = t->first; f; f = f->next)
+    if (f->minsize <= size && f->maxsize >= size
+        && (f->encoding==encoding_ ||
+ 	    !f->encoding ||
+		(!encoding_ || !strcmp(f->encoding, encoding_)))) {
+      goto DONE;
+    }
+
+#if HAVE_PTHREAD
+  // draw with something close while prefetch_fonts() is loading it:
+  if (prefetch_pending(t, size)) {
+    f = fallback_font(t, size);
+    if (f != current) {current = f; font_gc = 0;}
+    using_fallback = true;
+    return;
+  }
+#endif
+
+  // run XListFonts if it has not been done yet:
+  if (!t->xlist) {
+    open_display();
+    t->xlist = XListFonts(xdisplay, t->system_name, 100, &(t->n));
+    if (!t->xlist || t->n<=0) {	// use variable if no matching font...
+      t->first = f = new FontSize("variable",0);
+      f->minsize = 0;
+      f->maxsize = 32767;
+      goto DONE;
+    }
+  }
+
+  // now search the XListFonts results:
+  {char namebuffer[1024];	// holds scalable font name
+  char* nname;
+  unsigned ptsize;
+  bool found_encoding;
+  const char* name = pick_font(t->xlist, t->n, size, encoding_, namebuffer,
+			       nname, ptsize, found_encoding);
+
+  f = find_fontsize(t, size, ptsize, found_encoding, encoding_);
+  if (f) goto DONE;
+
+  // okay, we definately have some name, make the font:
+  f = new FontSize(name,nname);
+  add_fontsize(t, f, size, ptsize, encoding_);}
  DONE:
+  using_fallback = false;
   if (f != current) {
     current = f;
     font_gc = 0;
   }
 }
 
+////////////////////////////////////////////////////////////////
+// prefetch_fonts(fonts, sizes, n) lists and loads fonts in a
+// ThreadPool::shared() task, on a second connection to the X server, so
+// the main thread does not wait for the large replies to XListFonts and
+// XQueryFont. One task at a time does every request in the queue, so
+// they go out one after another without the main thread having to wait
+// for any, and returns when it is empty. The Display is kept open for
+// the next task.
+// The main thread then loads the font by name with XLoadFont(), which
+// has no reply, and uses the XFontStruct from the other connection.
+// Until then setfont() of a pending font+size uses the closest font
+// that is already loaded, and the windows are laid out and drawn again
+// when the real ones arrive.
+
+#if HAVE_PTHREAD
+#include <fltk/Threads.h>
+#include <fltk/Window.h>
+#include <fltk/run.h>
+
+struct FontRequest {
+  FontRequest* next;	// in the main thread's list of pending ones
+  FontRequest* next_job; // in the queue for the task
+  IFont* font;
+  unsigned size;
+  const char* encoding;	// encoding_ when it was asked for
+  // set by the task, read by the main thread once finished is true:
+  char* name;		// name to load with XLoadFont
+  char* nname;		// the name XListFonts returned
+  unsigned ptsize;
+  bool found_encoding;
+  XFontStruct* info;	// 0 if the font could not be loaded
+  bool finished;
+};
+
+static FontRequest* pending;	// only used by the main thread
+static FontRequest* job_head;
+static FontRequest* job_tail;
+static Mutex* prefetch_mutex; // protects the queue, finished and running
+static bool prefetch_running;	// a task is emptying the queue
+static const char* prefetch_display_name;
+static Display* prefetch_display; // only used by the running task
+
+static bool prefetch_pending(IFont* t, unsigned size) {
+  for (FontRequest* r = pending; r; r = r->next)
+    if (r->font == t && r->size == size && r->encoding == encoding_) return true;
+  return false;
+}
+
+// The loaded size of the font nearest size, or the current one:
+static FontSize* fallback_font(IFont* t, unsigned size) {
+  FontSize* best = 0;
+  unsigned best_distance = 0;
+  for (FontSize* f = t->first; f; f = f->next) {
+    unsigned d = f->minsize > size ? f->minsize-size :
+      f->maxsize < size ? size-f->maxsize : 0;
+    if (!best || d < best_distance) {best = f; best_distance = d;}
+  }
+  if (best) return best;
+  if (current) return current;
+  static FontSize* fixed;
+  if (!fixed) {
+    fixed = new FontSize("fixed", 0);
+    fixed->minsize = fixed->maxsize = 0;
+    fixed->next = 0;
+  }
+  return fixed;
+}
+
+// The task: run XListFonts once for each IFont and XLoadQueryFont for
+// each request, on its own Display, until the queue is empty:
+static void prefetch_function(void*) {
+  if (!prefetch_display)
+    prefetch_display = XOpenDisplay(prefetch_display_name);
+  Display* display = prefetch_display;
+  IFont* listed = 0; char** xlist = 0; int n = 0;
+  prefetch_mutex->lock();
+  for (;;) {
+    FontRequest* r = job_head;
+    if (!r) break;
+    job_head = r->next_job;
+    if (!job_head) job_tail = 0;
+    prefetch_mutex->unlock();
+    if (display && r->font != listed) {
+      if (xlist) XFreeFontNames(xlist);
+      xlist = XListFonts(display, r->font->system_name, 100, &n);
+      listed = r->font;
+    }
+    if (display && xlist && n > 0) {
+      char namebuffer[1024];
+      char* nname;
+      const char* name = pick_font(xlist, n, r->size, r->encoding, namebuffer,
+				   nname, r->ptsize, r->found_encoding);
+      r->info = XLoadQueryFont(display, name);
+      if (r->info) {
+	// only the XFontStruct is wanted, the main thread loads it again:
+	XUnloadFont(display, r->info->fid);
+	XFlush(display);
+	r->name = newstring(name);
+	r->nname = newstring(nname ? nname : name);
+      }
+    }
+    prefetch_mutex->lock();
+    r->finished = true;
+  }
+  prefetch_running = false;
+  prefetch_mutex->unlock();
+  if (xlist) XFreeFontNames(xlist);
+}
+
+// The main thread checks this often until all the requests are done:
+static void prefetch_poll(void*) {
+  bool changed = false;
+  for (FontRequest** p = &pending; *p;) {
+    FontRequest* r = *p;
+    prefetch_mutex->lock();
+    bool finished = r->finished;
+    prefetch_mutex->unlock();
+    if (!finished) {p = &r->next; continue;}
+    *p = r->next;
+    if (r->info) {
+      // setfont() may have loaded it meanwhile, if the encoding changed:
+      FontSize* f = find_fontsize(r->font, r->size, r->ptsize,
+				  r->found_encoding, r->encoding);
+      if (f) {
+	XFreeFontInfo(0, r->info, 1);
+	delete[] r->nname;
+      } else {
+	r->info->fid = XLoadFont(xdisplay, r->name);
+	f = new FontSize(r->info, r->nname);
+	add_fontsize(r->font, f, r->size, r->ptsize, r->encoding);
+      }
+      delete[] r->name;
+    }
+    // if it failed setfont() now does it and prints the error
+    delete r;
+    changed = true;
+  }
+  if (pending) fltk::repeat_timeout(.02f, prefetch_poll);
+  if (!changed) return;
+  for (Window* w = Window::first(); w; w = w->next()) {
+    w->relayout();
+    w->redraw();
+  }
+}
+
+void fltk::prefetch_fonts(Font** fonts, const float* sizes, int count) {
+  open_display();
+  if (!prefetch_mutex) {
+    prefetch_display_name = newstring(DisplayString(xdisplay));
+    prefetch_mutex = new Mutex;
+  }
+  bool was_pending = pending != 0;
+  for (int i = 0; i < count; i++) {
+    IFont* t = (IFont*)(fonts[i]);
+    unsigned size = unsigned(int(sizes[i]+.5));
+    FontSize* f;
+    for (f = t->first; f; f = f->next)
+      if (f->minsize <= size && f->maxsize >= size &&
+	  (f->encoding==encoding_ || !f->encoding ||
+	   (!encoding_ || !strcmp(f->encoding, encoding_)))) break;
+    if (f || prefetch_pending(t, size)) continue;
+    FontRequest* r = new FontRequest;
+    memset((void*)r, 0, sizeof(*r));
+    r->font = t;
+    r->size = size;
+    r->encoding = encoding_;
+    r->next = pending;
+    pending = r;
+    prefetch_mutex->lock();
+    if (job_tail) job_tail->next_job = r; else job_head = r;
+    job_tail = r;
+    prefetch_mutex->unlock();
+  }
+  prefetch_mutex->lock();
+  bool start = job_head && !prefetch_running;
+  if (start) prefetch_running = true;
+  prefetch_mutex->unlock();
+  // if the pool can't start a thread this does them all right here:
+  if (start) ThreadPool::shared()->add(prefetch_function, 0);
+  if (pending && !was_pending) add_timeout(.02f, prefetch_poll);
+}
+#endif
+
 ////////////////////////////////////////////////////////////////
 
 // The predefined fonts that fltk has:
@@ -42,14 +42,19 @@
 
 #include <fltk/error.h>
 #include <fltk/math.h>
+#include <fltk/trace.h>
 #include "XColorMap.h"
 
 #if USE_XSHM
 # include <sys/ipc.h>
 # include <sys/shm.h>
 # include <X11/extensions/XShm.h>
+# include <string.h>
 static Bool use_xshm;
 static Bool use_xshm_pixmaps;
+// Images smaller than this are sent with XPutImage, as a segment for
+// each one would use up the system's limit on them:
+# define XSHM_MINIMUM 0x4000
 #endif
 
 // Xlib drawing code uses memcpy and getenv
@@ -688,6 +693,7 @@ extern bool fl_trivial_transform();
 
 ::Picture p;
 XWindow prevsource;
+static bool prevrepeat; // p repeats its source
 
 #define XRENDER_SAMPLING_BUG 1
 #define XRENDER_MASK_BROKEN 1
@@ -723,25 +729,29 @@ static void mrgb32_to_argb32(const uchar* from, uchar* to, int w) {
 }
 #endif
 
+// If area is not null the source repeats to fill all of it, rather
+// than just the to rectangle:
 void fl_xrender_draw_image(XWindow source, fltk::PixelType type,
                            const fltk::Rectangle& from,
-                           const fltk::Rectangle& to)
+                           const fltk::Rectangle& to,
+                           const fltk::Rectangle* area = 0)
 {
   XTransform xtransform;
   if (!fl_get_invert_matrix(xtransform)) return; // give up if we can't invert
   int x,y,r,b; // box to draw
+  const fltk::Rectangle& box = area ? *area : to;
   if (!fl_trivial_transform()) {
     float X,Y,R,B,tx,ty;
-    tx = to.x(); ty = to.y(); transform(tx, ty);
+    tx = box.x(); ty = box.y(); transform(tx, ty);
     X = R = tx; Y = B = ty;
-    tx = to.r(); ty = to.b(); transform(tx, ty);
+    tx = box.r(); ty = box.b(); transform(tx, ty);
     if (tx < X) X = tx; else R = tx;
     if (ty < Y) Y = ty; else B = ty;
     if (xtransform.matrix[0][1]||xtransform.matrix[1][0]) {
-      tx = to.x(); ty = to.b(); transform(tx, ty);
+      tx = box.x(); ty = box.b(); transform(tx, ty);
       if (tx < X) X = tx; else if (tx > R) R = tx;
       if (ty < Y) Y = ty; else if (ty > B) B = ty;
-      tx = to.r(); ty = to.y(); transform(tx, ty);
+      tx = box.r(); ty = box.y(); transform(tx, ty);
       if (tx < X) X = tx; else if (tx > R) R = tx;
       if (ty < Y) Y = ty; else if (ty > B) B = ty;
     }
@@ -750,8 +760,8 @@ void fl_xrender_draw_image(XWindow source, fltk::PixelType type,
     r = int(ceilf(R));
     b = int(ceilf(B));
   } else {
-    x = to.x(); y = to.y(); transform(x,y);
-    r = x+to.w(); b = y+to.h();
+    x = box.x(); y = box.y(); transform(x,y);
+    r = x+box.w(); b = y+box.h();
   }
   if (to.w() != from.w() || to.h() != from.h()) {
     const float scalex = float(from.w())/to.w();
@@ -778,6 +788,13 @@ void fl_xrender_draw_image(XWindow source, fltk::PixelType type,
     if (p) XRenderFreePicture(xdisplay, p);
     p = XRenderCreatePicture(xdisplay, source, fl_rgba_xrender_format, 0, 0);
     XRenderSetPictureFilter(xdisplay, p, "best", 0, 0);
+    prevrepeat = false;
+  }
+  if (prevrepeat != (area != 0)) {
+    prevrepeat = area != 0;
+    XRenderPictureAttributes attributes;
+    attributes.repeat = prevrepeat ? RepeatNormal : RepeatNone;
+    XRenderChangePicture(xdisplay, p, CPRepeat, &attributes);
   }
   XRenderSetPictureTransform(xdisplay, p, &xtransform);
   switch (type) {
@@ -840,12 +857,21 @@ static void mask_to_32(const uchar *from, uchar *to, int w) {
 
 #endif
 
+#include "Image_simd.cxx"
+
 static void figure_out_visual() {
 
   xpixel(BLACK); // make sure figure_out_visual in color.cxx is called
+  TraceScope trace(TRACE_STARTUP, "image formats");
 
 #if USE_XSHM
-  if (!getenv("NO_XSHM")) {int major, minor;
+  // Shared memory only works if the server is on this machine. A remote
+  // display (including one forwarded by ssh to localhost:n) has a host
+  // name before the colon. If this passes, the first XShmAttach() is
+  // also checked for an error.
+  const char* d = DisplayString(xdisplay);
+  bool local = d[0]==':' || d[0]=='/' || !strncmp(d, "unix:", 5);
+  if (local && !getenv("NO_XSHM")) {int major, minor;
   use_xshm = XShmQueryVersion(xdisplay, &major, &minor, &use_xshm_pixmaps);
   if (use_xshm_pixmaps)
     use_xshm_pixmaps = XShmPixmapFormat(xdisplay)==ZPixmap;
@@ -1000,6 +1026,7 @@ static void figure_out_visual() {
 	  i.bits_per_pixel, xvisual->red_mask,
 	  xvisual->green_mask, xvisual->blue_mask);
   }
+  install_simd_converters();
   //printf("Use xshm %d\n", use_xshm_pixmaps);
 }
 
@@ -1013,8 +1040,142 @@ static int xerror_handler(Display* d, XErrorEvent* e) {
   use_xshm_pixmaps = false;
   return 0;
 }
+
+static int attach_error_handler(Display* d, XErrorEvent* e) {
+  use_xshm = use_xshm_pixmaps = false;
+  return 0;
+}
+
+// Make a shared memory segment of n bytes and attach the server to it.
+// The first time this waits to see if the server gets an error, which
+// is the only way to tell if it can see our memory. If this fails
+// use_xshm is turned off and the caller must use XPutImage.
+static bool attach_xshm(XShmSegmentInfo& shminfo, unsigned long n) {
+  shminfo.shmaddr = 0;
+  shminfo.shmid = shmget(IPC_PRIVATE, n, IPC_CREAT|0600);
+  if (shminfo.shmid == -1) return false;
+  void* addr = shmat(shminfo.shmid, 0, 0);
+  if (addr != (void*)-1) {
+    shminfo.shmaddr = (char*)addr;
+    shminfo.readOnly = False;
+    static bool beenhere;
+    if (beenhere) {
+      if (XShmAttach(xdisplay, &shminfo)) return true;
+    } else {
+      beenhere = true;
+      int (*f)(Display*,XErrorEvent*) = XSetErrorHandler(attach_error_handler);
+      Bool attached = XShmAttach(xdisplay, &shminfo);
+      XSync(xdisplay, false);
+      XSetErrorHandler(f);
+      if (attached && use_xshm) return true;
+      if (attached) XShmDetach(xdisplay, &shminfo);
+    }
+    shmdt(shminfo.shmaddr);
+    shminfo.shmaddr = 0;
+  }
+  shmctl(shminfo.shmid, IPC_RMID, 0);
+  shminfo.shmid = -1;
+  use_xshm = use_xshm_pixmaps = false;
+  return false;
+}
+
+static void detach_xshm(XShmSegmentInfo& shminfo) {
+  if (!shminfo.shmaddr) return;
+  if (xdisplay) XShmDetach(xdisplay, &shminfo);
+  shmdt(shminfo.shmaddr);
+  shmctl(shminfo.shmid, IPC_RMID, 0);
+  shminfo.shmaddr = 0;
+  shminfo.shmid = -1;
+}
+
+// Send an XImage whose data is in the shared memory segment:
+static void put_xshm(XWindow d, GC gc, XImage& i, XShmSegmentInfo& shminfo,
+		     int x, int y, int w, int h) {
+  i.obdata = (char*)&shminfo;
+  XShmPutImage(xdisplay, d, gc, &i, 0, 0, x, y, w, h, False);
+  frame_counts_.image_bytes += (unsigned long)i.bytes_per_line*h;
+  i.obdata = 0;
+}
+#endif
+
+////////////////////////////////////////////////////////////////
+// Small images are packed into shared pixmaps of the same depth, in
+// rows from the top. Each gets a transparent border so scaled drawing
+// does not pick up its neighbors. The space of an image is not reused
+// when it is destroyed, the pixmap is freed when all of them are.
+
+enum {ATLAS_SIZE = 512};
+
+struct Atlas {
+  XWindow pixmap;
+  int depth;
+  int x, y, rowh;	// where the next one goes
+  int users;
+  Atlas* next;
+};
+
+static Atlas* atlases;
+
+static Atlas* atlas_alloc(int w, int h, int depth, int& X, int& Y) {
+  const int W = w+2;
+  const int H = h+2;
+  if (W > ATLAS_SIZE || H > ATLAS_SIZE) return 0;
+  Atlas* a;
+  for (a = atlases; a; a = a->next) {
+    if (a->depth != depth) continue;
+    int x = a->x, y = a->y, rowh = a->rowh;
+    if (x+W > ATLAS_SIZE) {y += rowh; x = 0; rowh = 0;}
+    if (y+H > ATLAS_SIZE) continue;
+    a->x = x; a->y = y; a->rowh = rowh;
+    break;
+  }
+  if (!a) {
+    a = new Atlas;
+    a->pixmap = XCreatePixmap(xdisplay, RootWindow(xdisplay,xscreen),
+			      ATLAS_SIZE, ATLAS_SIZE, depth);
+    GC gc = XCreateGC(xdisplay, a->pixmap, 0, 0);
+    XSetForeground(xdisplay, gc, 0);
+    XFillRectangle(xdisplay, a->pixmap, gc, 0, 0, ATLAS_SIZE, ATLAS_SIZE);
+    XFreeGC(xdisplay, gc);
+    a->depth = depth;
+    a->x = a->y = a->rowh = 0;
+    a->users = 0;
+    a->next = atlases;
+    atlases = a;
+  }
+  X = a->x+1;
+  Y = a->y+1;
+  a->x += W;
+  if (H > a->rowh) a->rowh = H;
+  a->users++;
+  return a;
+}
+
+// For memory_report():
+void fl_atlas_memory(unsigned long& count, unsigned long& bytes) {
+  count = bytes = 0;
+  for (Atlas* a = atlases; a; a = a->next) {
+    count++;
+    bytes += (unsigned long)ATLAS_SIZE*ATLAS_SIZE *
+      (a->depth > 16 ? 4 : a->depth > 8 ? 2 : 1);
+  }
+}
+
+#if USE_XFT
+extern XWindow prevsource;
 #endif
 
+static void atlas_release(Atlas* a) {
+  if (--a->users) return;
+  for (Atlas** p = &atlases; *p; p = &(*p)->next)
+    if (*p == a) {*p = a->next; break;}
+  if (xdisplay) XFreePixmap(xdisplay, a->pixmap);
+#if USE_XFT
+  if (prevsource == a->pixmap) prevsource = 0;
+#endif
+  delete a;
+}
+
 struct fltk::Picture {
   int w, h, linedelta;
   Bool draw_target; // whether the image is used with draw_into()
@@ -1022,12 +1183,15 @@ struct fltk::Picture {
   uchar* data;
   XWindow rgb;
 #if USE_XSHM
-  XShmSegmentInfo shminfo;
+  XShmSegmentInfo shminfo; // data is shared with the server if shmaddr
+  Bool shm_pixmap; // rgb is made from the shared data
   int syncro;
 #endif
   uchar* linebuffer;
   XWindow alpha;        // binary alpha for non-XRender
   char* alphabuffer;    // binary alpha local source
+  Atlas* atlas;		// rgb is shared with other images
+  int ax, ay;		// position in the atlas
 
   Picture(int w, int h, int depth, int ld, Bool draw_target=false) {
     this->w = w;
@@ -1036,43 +1200,47 @@ struct fltk::Picture {
     this->draw_target = draw_target;
     n = (ld*h+3)&-4;
     linebuffer = 0; alpha = 0; alphabuffer = 0;
+    atlas = 0; ax = ay = 0;
+    if (!draw_target && w <= Image::atlas_size() && h <= Image::atlas_size())
+      atlas = atlas_alloc(w, h, depth, ax, ay);
+    if (atlas) {
+#if USE_XSHM
+      shminfo.shmid = -1;
+      shminfo.shmaddr = 0;
+      shm_pixmap = false;
+      syncro = 0;
+#endif
+      rgb = atlas->pixmap;
+      data = (uchar*)(new U32[n/4]);
+      return;
+    }
 #if USE_XSHM
     syncro = 0;
-    if (use_xshm_pixmaps) {
-      shminfo.shmid = shmget(IPC_PRIVATE, n, IPC_CREAT|0777);
-      if (shminfo.shmid != -1) {
-        shminfo.shmaddr = (char*)shmat(shminfo.shmid, 0, 0);
-        if (shminfo.shmaddr) {
-          shminfo.readOnly = False;
-          if (XShmAttach(xdisplay, &shminfo)) {
-            data = (uchar*)shminfo.shmaddr;
-            static bool beenhere;
-            if (beenhere) {
-              rgb = XShmCreatePixmap(xdisplay, RootWindow(xdisplay,xscreen),
-                                     shminfo.shmaddr, &shminfo,
-                                     w, h, depth);
-              return;
-            }
-            beenhere = true;
-            // The first time, we will do an XSync and detect if it throws
-            // an error. This seems to be the only way to see if XShm is
-            // going to work, it won't work on remote displays but amazingly
-            // enough no api is provided to tell you that!
-            int (*f)(Display*,XErrorEvent*) = XSetErrorHandler(xerror_handler);
-            rgb = XShmCreatePixmap(xdisplay, RootWindow(xdisplay,xscreen),
-                                   shminfo.shmaddr, &shminfo,
-                                   w, h, depth);
-            XSync(xdisplay,false);
-            XSetErrorHandler(f);
-            if (use_xshm_pixmaps) return; // the xerror_handler did not get called!
-            // Okay, clean up all the failed stuff we created,
-            // and continue with non-Xshm code:
-            XShmDetach(xdisplay, &shminfo);
-          }
-          shmdt(shminfo.shmaddr);
-        }
-        shmctl(shminfo.shmid, IPC_RMID, 0);
+    shm_pixmap = false;
+    if (use_xshm && (use_xshm_pixmaps || n >= XSHM_MINIMUM) &&
+	attach_xshm(shminfo, n)) {
+      data = (uchar*)shminfo.shmaddr;
+      if (use_xshm_pixmaps) {
+	static bool beenhere;
+	// The first time, we will do an XSync and detect if it throws
+	// an error, as some servers that do Xshm can't make pixmaps.
+	int (*f)(Display*,XErrorEvent*) = 0;
+	if (!beenhere) f = XSetErrorHandler(xerror_handler);
+	rgb = XShmCreatePixmap(xdisplay, RootWindow(xdisplay,xscreen),
+			       shminfo.shmaddr, &shminfo,
+			       w, h, depth);
+	if (!beenhere) {
+	  beenhere = true;
+	  XSync(xdisplay,false);
+	  XSetErrorHandler(f);
+	}
+	if (use_xshm_pixmaps) {shm_pixmap = true; return;}
+	// the xerror_handler was called, rgb is not valid
       }
+      // otherwise XShmPutImage() is used to copy data to the pixmap:
+      rgb = XCreatePixmap(xdisplay, RootWindow(xdisplay,xscreen),
+			  w, h, depth);
+      return;
     }
     shminfo.shmid = -1;
     shminfo.shmaddr = 0;
@@ -1084,17 +1252,21 @@ struct fltk::Picture {
 
   Picture(int) { // special constructor for xbmImage
     linebuffer = 0; alpha = 0; alphabuffer = 0;
+    atlas = 0; ax = ay = 0;
 #if USE_XSHM
     shminfo.shmid = -1;
     shminfo.shmaddr = 0;
+    shm_pixmap = false;
+    syncro = 0;
 #endif
     data = 0;
     rgb = 0;
   }
 
+  // true if rgb shares the memory with data:
   bool xshm() const {
 #if USE_XSHM
-    return shminfo.shmaddr;
+    return shm_pixmap;
 #else
     return 0;
 #endif
@@ -1102,7 +1274,9 @@ struct fltk::Picture {
 
   void sync() {
 #if USE_XSHM
-    if (syncro == syncnumber) {++syncnumber; XSync(xdisplay,false);}
+    if (syncro == syncnumber) {
+      ++syncnumber; XSync(xdisplay,false); frame_counts_.round_trips++;
+    }
 #endif
   }
 
@@ -1112,14 +1286,11 @@ struct fltk::Picture {
     delete[] (U32*)linebuffer;
     if (xdisplay) {
       if (alpha) XFreePixmap(xdisplay, alpha);
-      if (rgb) XFreePixmap(xdisplay, rgb);
+      if (rgb && !atlas) XFreePixmap(xdisplay, rgb);
     }
+    if (atlas) atlas_release(atlas);
 #if USE_XSHM
-    if (shminfo.shmaddr) {
-      if (xdisplay) XShmDetach(xdisplay, &shminfo);
-      shmdt(shminfo.shmaddr); data = 0;
-      shmctl(shminfo.shmid, IPC_RMID, 0);
-    }
+    if (shminfo.shmaddr) {detach_xshm(shminfo); data = 0;}
 #endif
     delete[] (U32*)data;
   }
@@ -1175,6 +1346,108 @@ PixelType Image::buffer_pixeltype() const {
   return PixelType(bytes_per_pixel); // not really right...
 }
 
+////////////////////////////////////////////////////////////////
+// Scaling for the Xlib drawing code, which cannot scale. This works
+// on the converted pixels in a Picture, so BILINEAR and BOX are only
+// done for 32 bit pixels, which have 8 bits in each byte. The binary
+// alpha is always scaled with NEAREST.
+
+// Blend two 32 bit pixels, t is 0-256, two bytes at a time:
+static inline U32 blend(U32 p, U32 q, unsigned t) {
+  unsigned s = 256-t;
+  U32 rb = ((((p&0xff00ff)*s + (q&0xff00ff)*t)) >> 8) & 0xff00ff;
+  U32 ag = (((p>>8)&0xff00ff)*s + ((q>>8)&0xff00ff)*t) & 0xff00ff00;
+  return rb|ag;
+}
+
+// 16.16 position in the source of the center of pixel i of n, when
+// size source pixels are scaled to n, kept inside the source:
+static inline int sample_position(int i, int n, int size) {
+  int v = int((((long long)(2*i+1)*size)<<15)/n) - 0x8000;
+  if (v < 0) return 0;
+  if (v > (size-1)<<16) return (size-1)<<16;
+  return v;
+}
+
+// Scale the rectangle fr of a into all of b, which has the same pixel format:
+static void scale_picture(const Picture* a, const Rectangle& fr, Picture* b,
+			  int quality) {
+  const int w = b->w;
+  const int h = b->h;
+  const int bpp = bytes_per_pixel;
+  if (bpp != 4) quality = Image::NEAREST;
+  else if (quality == Image::BOX && (w > fr.w() || h > fr.h()))
+    quality = Image::BILINEAR;
+  for (int y = 0; y < h; y++) {
+    uchar* to = b->data+y*b->linedelta;
+    if (quality == Image::NEAREST) {
+      const uchar* from = a->data+(fr.y()+(2*y+1)*fr.h()/(2*h))*a->linedelta
+	+ fr.x()*bpp;
+      for (int x = 0; x < w; x++)
+	memcpy(to+x*bpp, from+(2*x+1)*fr.w()/(2*w)*bpp, bpp);
+    } else if (quality == Image::BILINEAR) {
+      int fy = sample_position(y, h, fr.h());
+      int y0 = fy>>16;
+      int y1 = y0+1 < fr.h() ? y0+1 : y0;
+      unsigned ty = (fy>>8)&255;
+      const U32* r0 = (const U32*)(a->data+(fr.y()+y0)*a->linedelta)+fr.x();
+      const U32* r1 = (const U32*)(a->data+(fr.y()+y1)*a->linedelta)+fr.x();
+      for (int x = 0; x < w; x++) {
+	int fx = sample_position(x, w, fr.w());
+	int x0 = fx>>16;
+	int x1 = x0+1 < fr.w() ? x0+1 : x0;
+	unsigned tx = (fx>>8)&255;
+	((U32*)to)[x] = blend(blend(r0[x0], r0[x1], tx),
+			      blend(r1[x0], r1[x1], tx), ty);
+      }
+    } else { // BOX
+      int y0 = y*fr.h()/h;
+      int y1 = (y+1)*fr.h()/h; if (y1 <= y0) y1 = y0+1;
+      for (int x = 0; x < w; x++) {
+	int x0 = x*fr.w()/w;
+	int x1 = (x+1)*fr.w()/w; if (x1 <= x0) x1 = x0+1;
+	U32 c0 = 0, c1 = 0, c2 = 0, c3 = 0; // sum of each byte
+	for (int sy = y0; sy < y1; sy++) {
+	  const U32* p = (const U32*)(a->data+(fr.y()+sy)*a->linedelta)+fr.x();
+	  for (int sx = x0; sx < x1; sx++) {
+	    U32 v = p[sx];
+	    c0 += v&255; c1 += (v>>8)&255; c2 += (v>>16)&255; c3 += v>>24;
+	  }
+	}
+	U32 n = (y1-y0)*(x1-x0);
+	((U32*)to)[x] = (c0/n) | ((c1/n)<<8) | ((c2/n)<<16) | ((c3/n)<<24);
+      }
+    }
+  }
+  if (a->alphabuffer && b->alphabuffer) {
+    const int ald = (a->w+7)>>3;
+    const int bld = (w+7)>>3;
+    memset(b->alphabuffer, 0, bld*h);
+    for (int y = 0; y < h; y++) {
+      const uchar* from = (const uchar*)a->alphabuffer
+	+ (fr.y()+(2*y+1)*fr.h()/(2*h))*ald;
+      uchar* to = (uchar*)b->alphabuffer+y*bld;
+      for (int x = 0; x < w; x++) {
+	int sx = fr.x()+(2*x+1)*fr.w()/(2*w);
+	if (from[sx>>3] & (1<<(sx&7))) to[x>>3] |= 1<<(x&7);
+      }
+    }
+  }
+}
+
+// The last few images made by scale_picture():
+struct ScaledImage {
+  const Image* image;
+  unsigned long serial;	// image->serial() when it was made
+  Rectangle from;
+  int quality;
+  Image* scaled;
+  unsigned long used;
+};
+enum {SCALED_IMAGES = 32, SCALED_MAX = 1024*1024}; // biggest one in pixels
+static ScaledImage scaled_images[SCALED_IMAGES];
+static unsigned long scaled_clock;
+
 unsigned long Image::mem_used() const {
   if (picture) return picture->n;
   return 0;
@@ -1214,7 +1487,7 @@ uchar* Image::buffer() {
 
 void Image::destroy() {
   if (!picture) return;
-  if (picture->n > memused_) memused_ -= picture->n; else memused_ = 0;
+  if (picture->n < memused_) memused_ -= picture->n; else memused_ = 0;
   delete picture;
   picture = 0;
   flags &= ~FETCHED;
@@ -1249,7 +1522,7 @@ uchar* Image::linebuffer(int y) {
 
 void Image::setpixels(const uchar* buf, int y) {
   buffer();
-  flags &= ~COPIED;
+  buffer_changed();
   uchar* to = picture->data+y*picture->linedelta;
   void (*conv)(const uchar *from,uchar *to,int w);
 #if USE_XFT
@@ -1269,7 +1542,7 @@ void Image::setpixels(const uchar* buf, const Rectangle& r, int linedelta)
 {
   if (r.empty()) return;
   buffer();
-  flags &= ~COPIED;
+  buffer_changed();
   uchar* to = picture->data+r.y()*picture->linedelta+r.x()*buffer_depth();
   void (*conv)(const uchar *from,uchar *to,int w);
 #if USE_XFT
@@ -1327,51 +1600,112 @@ void Image::fetch_if_needed() const {
   }
 }
 
+// Copy the buffer of an image to the server if it has changed:
+static void copy_picture(Picture* picture, int w, int h) {
+#if USE_XSHM
+  if (picture->xshm())
+    picture->syncro = syncnumber;
+  else
+#endif
+  if (picture->rgb) {
+#if USE_XFT
+    XImage& i = fl_rgba_xrender_format ? xrenderi : ::i;
+#endif
+    i.width = w;
+    i.height = h;
+    i.data = (char*)picture->data;
+    i.bytes_per_line = picture->linedelta;
+    static GC copygc;
+    if (!copygc) copygc = XCreateGC(xdisplay, picture->rgb, 0, 0);
+#if USE_XSHM
+    if (picture->shminfo.shmaddr) {
+      // data must not change until the server has copied it:
+      put_xshm(picture->rgb, copygc, i, picture->shminfo, 0, 0, w, h);
+      picture->syncro = syncnumber;
+    } else
+#endif
+    {XPutImage(xdisplay, picture->rgb, copygc, &i, 0,0,
+	       picture->ax, picture->ay, w, h);
+    frame_counts_.image_bytes += (unsigned long)i.bytes_per_line*h;}
+  }
+  if (picture->alpha)
+    XFreePixmap(xdisplay, picture->alpha);
+  if (picture->alphabuffer)
+    picture->alpha =
+      XCreateBitmapFromData(xdisplay, xwindow, picture->alphabuffer,
+                            (picture->w+7)&-8, h);
+  else
+    picture->alpha = 0;
+}
+
 void fl_restore_clip(); // in clip.cxx
 
-void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
+void Image::draw(const fltk::Rectangle& from0, const fltk::Rectangle& to0) const {
+  if (fl_display_list) {record_image(this, from0, to0); return;}
   fetch_if_needed();
-  if (!picture) {fillrect(to); return;}
+  if (!picture) {fillrect(to0); return;}
 
   if (!(flags & COPIED)) {
-#if USE_XSHM
-    if (picture->xshm())
-      picture->syncro = syncnumber;
-    else
-#endif
-    if (picture->rgb) {
-#if USE_XFT
-      XImage& i = fl_rgba_xrender_format ? xrenderi : ::i;
-#endif
-      i.width = w();
-      i.height = h();
-      i.data = (char*)picture->data;
-      i.bytes_per_line = picture->linedelta;
-      static GC copygc;
-      if (!copygc) copygc = XCreateGC(xdisplay, picture->rgb, 0, 0);
-      XPutImage(xdisplay, picture->rgb, copygc, &i, 0,0,0,0,w(),h());
-    }
-    if (picture->alpha)
-      XFreePixmap(xdisplay, picture->alpha);
-    if (picture->alphabuffer)
-      picture->alpha =
-        XCreateBitmapFromData(xdisplay, xwindow, picture->alphabuffer,
-                              (picture->w+7)&-8, h());
-    else
-      picture->alpha = 0;
+    copy_picture(picture, w(), h());
     ((Image*)this)->flags |= COPIED;
   }
+  Rectangle from(from0);
+  Rectangle to(to0);
+  if (picture->atlas &&
+      (from.x() < 0 || from.y() < 0 || from.r() > w() || from.b() > h())) {
+    // don't draw any of the neighbors in the atlas:
+    from.intersect(Rectangle(w(), h()));
+    if (from.empty() || from0.empty()) return;
+    to.set(to0.x()+(from.x()-from0.x())*to0.w()/from0.w(),
+	   to0.y()+(from.y()-from0.y())*to0.h()/from0.h(),
+	   from.w()*to0.w()/from0.w(), from.h()*to0.h()/from0.h());
+  }
 #if USE_XFT
   if (fl_rgba_xrender_format && picture->rgb && !picture->draw_target) {
-    fl_xrender_draw_image(picture->rgb, pixeltype_, from, to);
+    Rectangle source(from);
+    source.move(picture->ax, picture->ay);
+    fl_xrender_draw_image(picture->rgb, pixeltype_, source, to);
     return;
   }
 #endif
   // XLib version:
-  // unfortunately scaling does not work, so I just center and clip
-  // to the transformed rectangle.
   // This is the rectangle I want to fill:
   Rectangle r2; transform(to,r2);
+  // Xlib cannot scale, so draw a scaled copy instead:
+  if ((r2.w() != from.w() || r2.h() != from.h()) && picture->rgb &&
+      picture->data && !picture->draw_target && !from.empty() &&
+      r2.w() > 0 && r2.h() > 0 && r2.w()*r2.h() <= SCALED_MAX) {
+    ScaledImage* e = scaled_images; // the oldest one if none match
+    bool found = false;
+    for (ScaledImage* p = scaled_images; p < scaled_images+SCALED_IMAGES; p++) {
+      if (p->image == this && p->serial == serial_ && p->quality == scale_quality_
+	  && p->scaled && p->scaled->w() == r2.w() && p->scaled->h() == r2.h()
+	  && p->from.x() == from.x() && p->from.y() == from.y()
+	  && p->from.w() == from.w() && p->from.h() == from.h()) {
+	e = p; found = true; break;
+      }
+      if (p->used < e->used) e = p;
+    }
+    if (!found) {
+      delete e->scaled;
+      Image* s = new Image(r2.w(), r2.h());
+      s->setpixeltype(pixeltype_);
+      s->buffer();
+      picture->sync();
+      scale_picture(picture, from, s->picture, scale_quality_);
+      s->buffer_changed();
+      s->set_fetched();
+      e->image = this;
+      e->serial = serial_;
+      e->from = from;
+      e->quality = scale_quality_;
+      e->scaled = s;
+    }
+    e->used = ++scaled_clock;
+    e->scaled->draw(Rectangle(r2.w(), r2.h()), to);
+    return;
+  }
+  // otherwise just center and clip to the transformed rectangle.
   // Center the image in that rectangle:
   Rectangle r1(r2,from.w(),from.h());
   // now figure out what area we will draw:
@@ -1390,7 +1724,8 @@ void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
       XSetClipMask(xdisplay, gc, picture->alpha);
       XSetClipOrigin(xdisplay, gc, r1.x(), r1.y());
       XCopyArea(xdisplay, picture->rgb, xwindow, gc,
-                r.x()-r1.x(), r.y()-r1.y(), r.w(), r.h(), r.x(), r.y());
+                r.x()-r1.x()+picture->ax, r.y()-r1.y()+picture->ay,
+                r.w(), r.h(), r.x(), r.y());
       XSetClipOrigin(xdisplay, gc, 0, 0);
       fl_restore_clip();
     } else {
@@ -1404,10 +1739,52 @@ void Image::draw(const fltk::Rectangle& from, const fltk::Rectangle& to) const {
   } else if (picture->rgb) {
     // RGB picture with no alpha
     XCopyArea(xdisplay, picture->rgb, xwindow, gc,
-              r.x()-r1.x(), r.y()-r1.y(), r.w(), r.h(), r.x(), r.y());
+              r.x()-r1.x()+picture->ax, r.y()-r1.y()+picture->ay,
+              r.w(), r.h(), r.x(), r.y());
   }
 }
 
+bool Image::draw_tiled(const fltk::Rectangle& r) const {
+  if (fl_display_list || r.empty()) return false;
+  fetch_if_needed();
+  if (!picture || w() <= 0 || h() <= 0) return false;
+  // an image in an atlas has its neighbors around it:
+  if (picture->atlas || picture->draw_target) return false;
+  if (!(flags & COPIED)) {
+    copy_picture(picture, w(), h());
+    ((Image*)this)->flags |= COPIED;
+  }
+#if USE_XFT
+  if (fl_rgba_xrender_format && picture->rgb) {
+    fl_xrender_draw_image(picture->rgb, pixeltype_, Rectangle(w(), h()),
+			  Rectangle(r.x(), r.y(), w(), h()), &r);
+    return true;
+  }
+#endif
+  // Xlib can only tile unscaled images, and only with one of the
+  // pixmap or the bitmap:
+  Rectangle r2; transform(r, r2);
+  if (r2.w() != r.w() || r2.h() != r.h()) return false;
+  if (picture->rgb && picture->alpha) return false;
+  // the stipple is padded to a multiple of 8 wide:
+  if (!picture->rgb && (w()&7)) return false;
+  Rectangle cr(r2);
+  if (!intersect_with_clip(cr)) return true;
+  if (picture->rgb) {
+    XSetTile(xdisplay, gc, picture->rgb);
+    XSetFillStyle(xdisplay, gc, FillTiled);
+  } else if (picture->alpha) {
+    XSetStipple(xdisplay, gc, picture->alpha);
+    XSetFillStyle(xdisplay, gc, FillStippled);
+  } else {
+    return false;
+  }
+  XSetTSOrigin(xdisplay, gc, r2.x(), r2.y());
+  XFillRectangle(xdisplay, xwindow, gc, cr.x(), cr.y(), cr.w(), cr.h());
+  XSetFillStyle(xdisplay, gc, FillSolid);
+  return true;
+}
+
 void Image::setimage(const uchar* d, PixelType p, int w, int h, int ld) {
   setsize(w,h);
   setpixeltype(p);
@@ -1457,6 +1834,141 @@ bool xbmImage::direct_fetch() {
 #endif
 ////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////
+// ThreadPool threads help convert big images. The 32-bit converters have
+// no state, so a block of lines can be split into bands that are
+// converted at the same time. The 8 and 16 bit ones do error diffusion
+// from one pixel to the next and are always done by the main thread.
+// Only the main thread talks to the X server.
+
+extern int fl_drawimage_threads;	// in ../Image.cxx
+extern bool fl_drawimage_concurrent;
+
+#if HAVE_PTHREAD
+#include <fltk/Threads.h>
+#include <unistd.h>
+
+namespace {
+
+enum {MAX_BANDS = 16};
+
+struct Band {
+  const uchar* buf;	// first line, or null to call the callback
+  int y;		// first line passed to callback
+  int rows;
+  U32* to;
+  uchar* linebuf;	// for the callback
+};
+
+// what all the bands are doing:
+struct Job {
+  void (*conv)(const uchar *from, uchar *to, int w);
+  DrawImageCallback cb;
+  void* userdata;
+  int dx, w, linedelta, linesize;
+} job;
+
+Band bands[MAX_BANDS];
+int band_count, next_band, bands_done;
+SignalMutex* pool;
+ThreadPool::TaskId helpers[MAX_BANDS];
+
+void convert_band(const Band& b) {
+  const uchar* from = b.buf;
+  U32* to = b.to;
+  for (int k = 0; k < b.rows; k++) {
+    if (from) {
+      job.conv(from, (uchar*)to, job.w);
+      from += job.linedelta;
+    } else {
+      const uchar* ret = job.cb(job.userdata, job.dx, b.y+k, job.w, b.linebuf);
+      job.conv(ret, (uchar*)to, job.w);
+    }
+    to += job.linesize;
+  }
+}
+
+// Take bands until there are none left, called with pool locked:
+void do_bands() {
+  while (next_band < band_count) {
+    const Band& b = bands[next_band++];
+    pool->unlock();
+    convert_band(b);
+    pool->lock();
+    if (++bands_done == band_count) pool->signal();
+  }
+}
+
+// ThreadPool task helping the drawing thread:
+void helper(void*) {
+  pool->lock();
+  do_bands();
+  pool->unlock();
+}
+
+// How many threads to use for a w*h conversion, including this one:
+int convert_threads(int w, int h, bool callback) {
+  if (bytes_per_pixel != 4 || (long)w*h < 0x40000) return 1;
+  if (callback && !fl_drawimage_concurrent) return 1;
+  int n = fl_drawimage_threads;
+  if (n < 0) {
+    // one for each cpu after the first:
+    n = int(sysconf(_SC_NPROCESSORS_ONLN))-1;
+    if (n > 7) n = 7;
+  }
+  if (n > ThreadPool::shared()->threads()) n = ThreadPool::shared()->threads();
+  if (n >= MAX_BANDS) n = MAX_BANDS-1;
+  if (n <= 0) return 1;
+  if (!pool) pool = new SignalMutex;
+  return n+1;
+}
+
+// Convert h lines into to, split into n bands:
+void convert_lines(int n, const uchar* buf, int y, int h, U32* to, int linebufsize) {
+  static uchar* linebufs[MAX_BANDS];
+  static int linebuf_size;
+  if (!buf && linebufsize > linebuf_size) {
+    for (int b = 0; b < MAX_BANDS; b++) {
+      delete[] (U32*)linebufs[b];
+      linebufs[b] = (uchar*)(new U32[(linebufsize+3)/4]);
+    }
+    linebuf_size = linebufsize;
+  }
+  int rows = (h+n-1)/n;
+  int count = 0;
+  for (int j = 0; j < h; j += rows, count++) {
+    Band& b = bands[count];
+    b.buf = buf ? buf+j*job.linedelta : 0;
+    b.y = y+j;
+    b.rows = h-j < rows ? h-j : rows;
+    b.to = to+j*job.linesize;
+    b.linebuf = linebufs[count];
+  }
+  pool->lock();
+  band_count = count;
+  next_band = bands_done = 0;
+  pool->unlock();
+  // Helpers that don't start until this thread has done the rest
+  // would find nothing to do, so they are removed at the end:
+  for (int i = 1; i < count; i++)
+    helpers[i] = ThreadPool::shared()->add(helper, 0, ThreadPool::HIGH);
+  pool->lock();
+  do_bands();
+  while (bands_done < band_count) pool->wait();
+  pool->unlock();
+  for (int i = 1; i < count; i++) ThreadPool::shared()->remove(helpers[i]);
+}
+
+}
+#endif
+
+// Send an XImage through the socket to the current window:
+static void put_image(XImage& i, int x, int y, int w, int h) {
+  XPutImage(xdisplay, xwindow, gc, &i, 0, 0, x, y, w, h);
+  frame_counts_.image_bytes +=
+    (unsigned long)(i.bytes_per_line < 0 ? -i.bytes_per_line : i.bytes_per_line)*h;
+}
+
 // drawimage() calls this to see if a direct draw will work. Returns
 // true if successful, false if an Image must be used to emulate it.
 
@@ -1474,12 +1986,6 @@ static bool innards(const uchar *buf, PixelType type,
   if (fl_rgba_xrender_format && !fl_trivial_transform()) return false;
 #endif
 
-#if USE_XSHM
-  // use shared memory to send the image...
-  // For me at least this appears slower..
-  //  if (use_xshm_pixmaps) return false;
-#endif
-
   int dx,dy,x,y,w,h;
 
   // because scaling is not supported, I just draw the image centered:
@@ -1509,23 +2015,60 @@ static bool innards(const uchar *buf, PixelType type,
 
   if (!bytes_per_pixel) figure_out_visual();
   void (*conv)(const uchar *from, uchar *to, int w) = converter[type];
+  int linesize = ((w*bytes_per_pixel+scanline_add)&scanline_mask)/4;
+
+#if USE_XSHM
+  // Convert large images into a shared memory segment and send it all
+  // at once with XShmPutImage(), instead of through the socket:
+  static XShmSegmentInfo shminfo;
+  static unsigned long shm_size;
+  static int shm_syncro;
+  bool shared = false;
+  unsigned long bytes = linesize*4UL*h;
+  if (use_xshm && bytes >= XSHM_MINIMUM) {
+    // the server may still be reading the previous image:
+    if (shm_syncro == syncnumber) {
+      ++syncnumber; XSync(xdisplay, false); frame_counts_.round_trips++;
+    }
+    if (bytes > shm_size) {
+      if (shm_size) {detach_xshm(shminfo); shm_size = 0;}
+      if (attach_xshm(shminfo, bytes)) shm_size = bytes;
+    }
+    shared = shm_size != 0;
+  }
+# define PUT_BLOCK(Y,H) \
+  if (shared) put_xshm(xwindow, gc, i, shminfo, x, Y, w, H); \
+  else put_image(i, x, Y, w, H)
+#else
+  const bool shared = false;
+# define PUT_BLOCK(Y,H) put_image(i, x, Y, w, H)
+#endif
 
   // Direct-dump RGB or BGR data if it is already laid out correctly.
   // This assummes the server will ignore the 4th byte,
   // that it works when the image is not word-aligned,
   // and it works if bytes_per_line is negative.
   // This seems to all work on my XFree86 setup
-  if (buf && conv==direct_32 && !(linedelta&scanline_add)) {
+  if (buf && conv==direct_32 && !(linedelta&scanline_add) && !shared) {
     i.data = (char *)buf;
     i.bytes_per_line = linedelta;
-    XPutImage(xdisplay, xwindow, gc, &i, 0, 0, x, y, w, h);
+    put_image(i, x, y, w, h);
   } else {
     int blocking = h;
     static U32* buffer;	// our storage, always word aligned
     static long buffer_size;
-    int linesize = ((w*bytes_per_pixel+scanline_add)&scanline_mask)/4;
+    U32* storage;
+#if HAVE_PTHREAD
+    int threads = convert_threads(w, h, !buf);
+#else
+    const int threads = 1;
+#endif
+#if USE_XSHM
+    if (shared) storage = (U32*)shminfo.shmaddr; else
+#endif
     {int size = linesize*h;
-    const int MAXBUFFER = 0x40000; // 256k
+    // each thread converts its own 256k words of the buffer:
+    const int MAXBUFFER = 0x40000*threads;
     if (size > MAXBUFFER) {
       size = MAXBUFFER;
       blocking = MAXBUFFER/linesize;
@@ -1534,35 +2077,58 @@ static bool innards(const uchar *buf, PixelType type,
       delete[] buffer;
       buffer_size = size;
       buffer = new U32[size];
-    }}
-    i.data = (char *)buffer;
+    }
+    storage = buffer;}
+    i.data = (char *)storage;
     i.bytes_per_line = linesize*4;
+#if HAVE_PTHREAD
+    if (threads > 1) {
+      job.conv = conv;
+      job.cb = cb;
+      job.userdata = userdata;
+      job.dx = dx;
+      job.w = w;
+      job.linedelta = linedelta;
+      job.linesize = linesize;
+      for (int j = 0; j < h; ) {
+	int k = h-j < blocking ? h-j : blocking;
+	convert_lines(threads, buf, dy+j, k, storage, r1.w()*delta);
+	if (buf) buf += k*linedelta;
+	j += k;
+	PUT_BLOCK(y+j-k, k);
+      }
+    } else
+#endif
     if (buf) {
       for (int j=0; j<h; ) {
-	U32 *to = buffer;
+	U32 *to = storage;
 	int k;
 	for (k = 0; j<h && k<blocking; k++, j++) {
 	  conv(buf, (uchar*)to, w);
 	  buf += linedelta;
 	  to += linesize;
 	}
-        XPutImage(xdisplay, xwindow, gc, &i, 0, 0, x, y+j-k, w, k);
+        PUT_BLOCK(y+j-k, k);
       }
     } else {
       U32* linebuf = new U32[(r1.w()*delta+3)/4];
       for (int j=0; j<h; ) {
-	U32* to = buffer;
+	U32* to = storage;
 	int k;
 	for (k = 0; j<h && k<blocking; k++, j++) {
 	  const uchar* ret = cb(userdata, dx, dy+j, w, (uchar*)linebuf);
 	  conv(ret, (uchar*)to, w);
 	  to += linesize;
 	}
-        XPutImage(xdisplay, xwindow, gc, &i, 0, 0, x, y+j-k, w, k);
+        PUT_BLOCK(y+j-k, k);
       }
       delete[] linebuf;
     }
+#if USE_XSHM
+    if (shared) shm_syncro = syncnumber;
+#endif
   }
+#undef PUT_BLOCK
   return true;
 }
 
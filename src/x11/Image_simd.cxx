@@ -0,0 +1,449 @@
+//
+// "$Id$"
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+
+// Vector versions of the 32-bit converters in Image.cxx, which is the
+// only file that includes this. install_simd_converters() is called by
+// figure_out_visual() and replaces the entries in converter[] and
+// xrender_converter[] with these if the cpu can run them.
+//
+// These produce exactly the same pixels as the plain C versions. Like
+// them they work when from and to are the same buffer: the ones that
+// make the data bigger go backwards 16 pixels at a time, reading each
+// block before writing it, and do the leftover pixels at the start
+// with the C version.
+//
+// Only the 32-bit little-endian formats are done. The 8 and 16 bit
+// converters use error diffusion, which depends on the previous pixel
+// so it can't be done in parallel, and the alpha converters for non-
+// XRender servers build a bitmap one bit at a time.
+//
+// Setting NO_SIMD in the environment turns this off, so the speed can
+// be compared with test/drawbench.
+
+#if USE_SIMD && !WORDS_BIGENDIAN && defined(__GNUC__) && \
+    (defined(__i386__) || defined(__x86_64__))
+# define SIMD_X86 1
+# include <immintrin.h>
+# define SSSE3 __attribute__((target("ssse3")))
+# define AVX2 __attribute__((target("avx2")))
+#elif USE_SIMD && !WORDS_BIGENDIAN && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+# define SIMD_NEON 1
+# include <arm_neon.h>
+#endif
+
+#if SIMD_X86
+////////////////////////////////////////////////////////////////
+// SSSE3 (pshufb), 4 pixels per register:
+
+// Shuffle masks, 0x80 puts a zero in that byte:
+#define M3(a,b,c,d) /* 3 bytes to 4 */ \
+  (char)(a),(char)(b),(char)(c),(char)(d), \
+  (char)((a)<16?(a)+3:(a)),(char)((b)<16?(b)+3:(b)), \
+  (char)((c)<16?(c)+3:(c)),(char)((d)<16?(d)+3:(d)), \
+  (char)((a)<16?(a)+6:(a)),(char)((b)<16?(b)+6:(b)), \
+  (char)((c)<16?(c)+6:(c)),(char)((d)<16?(d)+6:(d)), \
+  (char)((a)<16?(a)+9:(a)),(char)((b)<16?(b)+9:(b)), \
+  (char)((c)<16?(c)+9:(c)),(char)((d)<16?(d)+9:(d))
+#define M4(a,b,c,d) /* 4 bytes to 4 */ \
+  (char)(a),(char)(b),(char)(c),(char)(d), \
+  (char)((a)+4),(char)((b)+4),(char)((c)+4),(char)((d)+4), \
+  (char)((a)+8),(char)((b)+8),(char)((c)+8),(char)((d)+8), \
+  (char)((a)+12),(char)((b)+12),(char)((c)+12),(char)((d)+12)
+
+static const char rgb_xrgb_mask[16]  __attribute__((aligned(16))) = {M3(2,1,0,0x80)};
+static const char rgb_rgbx_mask[16]  __attribute__((aligned(16))) = {M3(0x80,2,1,0)};
+static const char rgba_xrgb_mask[32] __attribute__((aligned(32))) = {M4(2,1,0,3),M4(2,1,0,3)};
+static const char rgba_rgbx_mask[32] __attribute__((aligned(32))) = {M4(3,2,1,0),M4(3,2,1,0)};
+static const char argb_rgbx_mask[32] __attribute__((aligned(32))) = {M4(3,0,1,2),M4(3,0,1,2)};
+static const char mono_masks[64] __attribute__((aligned(16))) = {
+  0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,
+  4,4,4,4,5,5,5,5,6,6,6,6,7,7,7,7,
+  8,8,8,8,9,9,9,9,10,10,10,10,11,11,11,11,
+  12,12,12,12,13,13,13,13,14,14,14,14,15,15,15,15};
+
+// Convert 16 pixels of 3 bytes to 4 bytes. Everything is read before
+// anything is written so this works backwards in the same buffer:
+SSSE3 static inline void rgb_block_ssse3(const uchar* from, uchar* to, __m128i m) {
+  __m128i a = _mm_loadu_si128((const __m128i*)from);
+  __m128i b = _mm_loadu_si128((const __m128i*)(from+16));
+  __m128i c = _mm_loadu_si128((const __m128i*)(from+32));
+  __m128i p0 = _mm_shuffle_epi8(a, m);
+  __m128i p1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), m);
+  __m128i p2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), m);
+  __m128i p3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), m);
+  _mm_storeu_si128((__m128i*)to, p0);
+  _mm_storeu_si128((__m128i*)(to+16), p1);
+  _mm_storeu_si128((__m128i*)(to+32), p2);
+  _mm_storeu_si128((__m128i*)(to+48), p3);
+}
+
+SSSE3 static void rgb_to_xrgb_ssse3(const uchar *from, uchar *to, int w) {
+  __m128i m = _mm_load_si128((const __m128i*)rgb_xrgb_mask);
+  int i = w;
+  while (i >= 16) {i -= 16; rgb_block_ssse3(from+3*i, to+4*i, m);}
+  if (i) rgb_to_xrgb(from, to, i);
+}
+
+SSSE3 static void rgb_to_rgbx_ssse3(const uchar *from, uchar *to, int w) {
+  __m128i m = _mm_load_si128((const __m128i*)rgb_rgbx_mask);
+  int i = w;
+  while (i >= 16) {i -= 16; rgb_block_ssse3(from+3*i, to+4*i, m);}
+  if (i) rgb_to_rgbx(from, to, i);
+}
+
+// Shuffle the bytes of each 4-byte pixel, going forwards:
+SSSE3 static inline void shuffle32_ssse3(const uchar* from, uchar* to, int w,
+					 const char* mask) {
+  __m128i m = _mm_load_si128((const __m128i*)mask);
+  int i = 0;
+  for (; i+4 <= w; i += 4)
+    _mm_storeu_si128((__m128i*)(to+4*i),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(from+4*i)), m));
+  for (; i < w; i++) {
+    uchar a = from[4*i+mask[0]], b = from[4*i+mask[1]];
+    uchar c = from[4*i+mask[2]], d = from[4*i+mask[3]];
+    to[4*i] = a; to[4*i+1] = b; to[4*i+2] = c; to[4*i+3] = d;
+  }
+}
+
+SSSE3 static void rgba_to_xrgb_ssse3(const uchar *from, uchar *to, int w) {
+  shuffle32_ssse3(from, to, w, rgba_xrgb_mask);
+}
+
+SSSE3 static void rgba_to_rgbx_ssse3(const uchar *from, uchar *to, int w) {
+  shuffle32_ssse3(from, to, w, rgba_rgbx_mask);
+}
+
+SSSE3 static void argb32_to_rgbx_ssse3(const uchar *from, uchar *to, int w) {
+  shuffle32_ssse3(from, to, w, argb_rgbx_mask);
+}
+
+// Each byte to 4 copies of it, xor'd with invert:
+SSSE3 static inline void mono_ssse3(const uchar* from, uchar* to, int w, int invert) {
+  __m128i m0 = _mm_load_si128((const __m128i*)mono_masks);
+  __m128i m1 = _mm_load_si128((const __m128i*)(mono_masks+16));
+  __m128i m2 = _mm_load_si128((const __m128i*)(mono_masks+32));
+  __m128i m3 = _mm_load_si128((const __m128i*)(mono_masks+48));
+  __m128i x = _mm_set1_epi32(invert);
+  int i = w;
+  while (i >= 16) {
+    i -= 16;
+    __m128i v = _mm_loadu_si128((const __m128i*)(from+i));
+    __m128i p0 = _mm_xor_si128(_mm_shuffle_epi8(v, m0), x);
+    __m128i p1 = _mm_xor_si128(_mm_shuffle_epi8(v, m1), x);
+    __m128i p2 = _mm_xor_si128(_mm_shuffle_epi8(v, m2), x);
+    __m128i p3 = _mm_xor_si128(_mm_shuffle_epi8(v, m3), x);
+    uchar* t = to+4*i;
+    _mm_storeu_si128((__m128i*)t, p0);
+    _mm_storeu_si128((__m128i*)(t+16), p1);
+    _mm_storeu_si128((__m128i*)(t+32), p2);
+    _mm_storeu_si128((__m128i*)(t+48), p3);
+  }
+  U32* t = (U32*)to+i;
+  from += i;
+  while (t > (U32*)to) *--t = (*--from * 0x1010101U) ^ invert;
+}
+
+SSSE3 static void mono_to_32_ssse3(const uchar *from, uchar *to, int w) {
+  mono_ssse3(from, to, w, 0);
+}
+
+#if USE_XFT
+SSSE3 static void mask_to_32_ssse3(const uchar *from, uchar *to, int w) {
+  mono_ssse3(from, to, w, -1);
+}
+
+// Multiply b,g,r by a and shift right 8, leave a alone. The pixels are
+// already in b,g,r,a memory order:
+SSSE3 static inline __m128i premultiply_sse2(__m128i p) {
+  const __m128i zero = _mm_setzero_si128();
+  // alpha lane multiplies by 256 so it comes out unchanged:
+  const __m128i keep = _mm_set_epi16(256,0,0,0,256,0,0,0);
+  const __m128i rgb = _mm_set_epi16(0,-1,-1,-1,0,-1,-1,-1);
+  __m128i lo = _mm_unpacklo_epi8(p, zero);
+  __m128i hi = _mm_unpackhi_epi8(p, zero);
+  __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+  __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+  alo = _mm_or_si128(_mm_and_si128(alo, rgb), keep);
+  ahi = _mm_or_si128(_mm_and_si128(ahi, rgb), keep);
+  lo = _mm_srli_epi16(_mm_mullo_epi16(lo, alo), 8);
+  hi = _mm_srli_epi16(_mm_mullo_epi16(hi, ahi), 8);
+  return _mm_packus_epi16(lo, hi);
+}
+
+#if XRENDER_MASK_BROKEN
+SSSE3 static void rgbm_to_argb32_ssse3(const uchar *from, uchar *to, int w) {
+  __m128i m = _mm_load_si128((const __m128i*)rgba_xrgb_mask);
+  int i = 0;
+  for (; i+4 <= w; i += 4) {
+    __m128i p = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(from+4*i)), m);
+    _mm_storeu_si128((__m128i*)(to+4*i), premultiply_sse2(p));
+  }
+  if (i < w) rgbm_to_argb32(from+4*i, to+4*i, w-i);
+}
+
+SSSE3 static void mrgb32_to_argb32_ssse3(const uchar *from, uchar *to, int w) {
+  int i = 0;
+  for (; i+4 <= w; i += 4) {
+    __m128i p = _mm_loadu_si128((const __m128i*)(from+4*i));
+    _mm_storeu_si128((__m128i*)(to+4*i), premultiply_sse2(p));
+  }
+  if (i < w) mrgb32_to_argb32(from+4*i, to+4*i, w-i);
+}
+#endif
+#endif
+
+////////////////////////////////////////////////////////////////
+// AVX2, 8 pixels per register. Only the ones that don't change size,
+// as vpshufb can't move bytes between the two halves:
+
+AVX2 static inline void shuffle32_avx2(const uchar* from, uchar* to, int w,
+				       const char* mask) {
+  __m256i m = _mm256_load_si256((const __m256i*)mask);
+  int i = 0;
+  for (; i+8 <= w; i += 8)
+    _mm256_storeu_si256((__m256i*)(to+4*i),
+      _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(from+4*i)), m));
+  if (i < w) shuffle32_ssse3(from+4*i, to+4*i, w-i, mask);
+}
+
+AVX2 static void rgba_to_xrgb_avx2(const uchar *from, uchar *to, int w) {
+  shuffle32_avx2(from, to, w, rgba_xrgb_mask);
+}
+
+AVX2 static void rgba_to_rgbx_avx2(const uchar *from, uchar *to, int w) {
+  shuffle32_avx2(from, to, w, rgba_rgbx_mask);
+}
+
+AVX2 static void argb32_to_rgbx_avx2(const uchar *from, uchar *to, int w) {
+  shuffle32_avx2(from, to, w, argb_rgbx_mask);
+}
+
+#if USE_XFT && XRENDER_MASK_BROKEN
+AVX2 static inline __m256i premultiply_avx2(__m256i p) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i keep = _mm256_set_epi16(256,0,0,0,256,0,0,0,256,0,0,0,256,0,0,0);
+  const __m256i rgb = _mm256_set_epi16(0,-1,-1,-1,0,-1,-1,-1,0,-1,-1,-1,0,-1,-1,-1);
+  __m256i lo = _mm256_unpacklo_epi8(p, zero);
+  __m256i hi = _mm256_unpackhi_epi8(p, zero);
+  __m256i alo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xff), 0xff);
+  __m256i ahi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xff), 0xff);
+  alo = _mm256_or_si256(_mm256_and_si256(alo, rgb), keep);
+  ahi = _mm256_or_si256(_mm256_and_si256(ahi, rgb), keep);
+  lo = _mm256_srli_epi16(_mm256_mullo_epi16(lo, alo), 8);
+  hi = _mm256_srli_epi16(_mm256_mullo_epi16(hi, ahi), 8);
+  return _mm256_packus_epi16(lo, hi); // unpack and pack are both per-half
+}
+
+AVX2 static void rgbm_to_argb32_avx2(const uchar *from, uchar *to, int w) {
+  __m256i m = _mm256_load_si256((const __m256i*)rgba_xrgb_mask);
+  int i = 0;
+  for (; i+8 <= w; i += 8) {
+    __m256i p = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(from+4*i)), m);
+    _mm256_storeu_si256((__m256i*)(to+4*i), premultiply_avx2(p));
+  }
+  if (i < w) rgbm_to_argb32_ssse3(from+4*i, to+4*i, w-i);
+}
+
+AVX2 static void mrgb32_to_argb32_avx2(const uchar *from, uchar *to, int w) {
+  int i = 0;
+  for (; i+8 <= w; i += 8) {
+    __m256i p = _mm256_loadu_si256((const __m256i*)(from+4*i));
+    _mm256_storeu_si256((__m256i*)(to+4*i), premultiply_avx2(p));
+  }
+  if (i < w) mrgb32_to_argb32_ssse3(from+4*i, to+4*i, w-i);
+}
+#endif
+
+#endif // SIMD_X86
+
+#if SIMD_NEON
+////////////////////////////////////////////////////////////////
+// NEON, 16 pixels at a time using the interleaving loads and stores:
+
+static void rgb_to_xrgb_neon(const uchar *from, uchar *to, int w) {
+  uint8x16_t zero = vdupq_n_u8(0);
+  int i = w;
+  while (i >= 16) {
+    i -= 16;
+    uint8x16x3_t s = vld3q_u8(from+3*i);
+    uint8x16x4_t d; d.val[0] = s.val[2]; d.val[1] = s.val[1];
+    d.val[2] = s.val[0]; d.val[3] = zero;
+    vst4q_u8(to+4*i, d);
+  }
+  if (i) rgb_to_xrgb(from, to, i);
+}
+
+static void rgb_to_rgbx_neon(const uchar *from, uchar *to, int w) {
+  uint8x16_t zero = vdupq_n_u8(0);
+  int i = w;
+  while (i >= 16) {
+    i -= 16;
+    uint8x16x3_t s = vld3q_u8(from+3*i);
+    uint8x16x4_t d; d.val[0] = zero; d.val[1] = s.val[2];
+    d.val[2] = s.val[1]; d.val[3] = s.val[0];
+    vst4q_u8(to+4*i, d);
+  }
+  if (i) rgb_to_rgbx(from, to, i);
+}
+
+// Reorder the bytes of 4-byte pixels, where d[j] = s[order[j]]:
+static inline void shuffle32_neon(const uchar* from, uchar* to, int w,
+				  int a, int b, int c, int d) {
+  int i = 0;
+  for (; i+16 <= w; i += 16) {
+    uint8x16x4_t s = vld4q_u8(from+4*i);
+    uint8x16x4_t t; t.val[0] = s.val[a]; t.val[1] = s.val[b];
+    t.val[2] = s.val[c]; t.val[3] = s.val[d];
+    vst4q_u8(to+4*i, t);
+  }
+  for (; i < w; i++) {
+    uchar p[4] = {from[4*i], from[4*i+1], from[4*i+2], from[4*i+3]};
+    to[4*i] = p[a]; to[4*i+1] = p[b]; to[4*i+2] = p[c]; to[4*i+3] = p[d];
+  }
+}
+
+static void rgba_to_xrgb_neon(const uchar *from, uchar *to, int w) {
+  shuffle32_neon(from, to, w, 2,1,0,3);
+}
+
+static void rgba_to_rgbx_neon(const uchar *from, uchar *to, int w) {
+  shuffle32_neon(from, to, w, 3,2,1,0);
+}
+
+static void argb32_to_rgbx_neon(const uchar *from, uchar *to, int w) {
+  shuffle32_neon(from, to, w, 3,0,1,2);
+}
+
+static inline void mono_neon(const uchar* from, uchar* to, int w, U32 invert) {
+  int i = w;
+  while (i >= 16) {
+    i -= 16;
+    uint8x16_t v = vld1q_u8(from+i);
+    if (invert) v = vmvnq_u8(v);
+    uint8x16x4_t d; d.val[0] = d.val[1] = d.val[2] = d.val[3] = v;
+    vst4q_u8(to+4*i, d);
+  }
+  U32* t = (U32*)to+i;
+  from += i;
+  while (t > (U32*)to) *--t = (*--from * 0x1010101U) ^ invert;
+}
+
+static void mono_to_32_neon(const uchar *from, uchar *to, int w) {
+  mono_neon(from, to, w, 0);
+}
+
+#if USE_XFT
+static void mask_to_32_neon(const uchar *from, uchar *to, int w) {
+  mono_neon(from, to, w, ~0U);
+}
+
+#if XRENDER_MASK_BROKEN
+// s is b,g,r,a planes:
+static inline void premultiply_neon(uint8x16x4_t& s) {
+  for (int j = 0; j < 3; j++) {
+    uint16x8_t lo = vmull_u8(vget_low_u8(s.val[j]), vget_low_u8(s.val[3]));
+    uint16x8_t hi = vmull_u8(vget_high_u8(s.val[j]), vget_high_u8(s.val[3]));
+    s.val[j] = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+  }
+}
+
+static void rgbm_to_argb32_neon(const uchar *from, uchar *to, int w) {
+  int i = 0;
+  for (; i+16 <= w; i += 16) {
+    uint8x16x4_t s = vld4q_u8(from+4*i);
+    uint8x16_t r = s.val[0]; s.val[0] = s.val[2]; s.val[2] = r;
+    premultiply_neon(s);
+    vst4q_u8(to+4*i, s);
+  }
+  if (i < w) rgbm_to_argb32(from+4*i, to+4*i, w-i);
+}
+
+static void mrgb32_to_argb32_neon(const uchar *from, uchar *to, int w) {
+  int i = 0;
+  for (; i+16 <= w; i += 16) {
+    uint8x16x4_t s = vld4q_u8(from+4*i);
+    premultiply_neon(s);
+    vst4q_u8(to+4*i, s);
+  }
+  if (i < w) mrgb32_to_argb32(from+4*i, to+4*i, w-i);
+}
+#endif
+#endif
+
+#endif // SIMD_NEON
+
+// Replace table entries that are plain C functions with vector ones:
+#define REPLACE(table, c, v) \
+  for (int n = 0; n < 9; n++) if (table[n] == c) table[n] = v
+
+static void install_simd_converters() {
+#if SIMD_X86 || SIMD_NEON
+  if (getenv("NO_SIMD")) return;
+#endif
+#if SIMD_X86
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("ssse3")) return;
+  bool avx2 = __builtin_cpu_supports("avx2");
+  REPLACE(converter, rgb_to_xrgb, rgb_to_xrgb_ssse3);
+  REPLACE(converter, rgb_to_rgbx, rgb_to_rgbx_ssse3);
+  REPLACE(converter, mono_to_32, mono_to_32_ssse3);
+  REPLACE(converter, rgba_to_xrgb, avx2 ? rgba_to_xrgb_avx2 : rgba_to_xrgb_ssse3);
+  REPLACE(converter, rgba_to_rgbx, avx2 ? rgba_to_rgbx_avx2 : rgba_to_rgbx_ssse3);
+  REPLACE(converter, argb32_to_rgbx, avx2 ? argb32_to_rgbx_avx2 : argb32_to_rgbx_ssse3);
+# if USE_XFT
+  REPLACE(xrender_converter, mask_to_32, mask_to_32_ssse3);
+  REPLACE(xrender_converter, mono_to_32, mono_to_32_ssse3);
+  REPLACE(xrender_converter, rgb_to_xrgb, rgb_to_xrgb_ssse3);
+  REPLACE(xrender_converter, rgba_to_xrgb, avx2 ? rgba_to_xrgb_avx2 : rgba_to_xrgb_ssse3);
+#  if XRENDER_MASK_BROKEN
+  REPLACE(xrender_converter, rgbm_to_argb32, avx2 ? rgbm_to_argb32_avx2 : rgbm_to_argb32_ssse3);
+  REPLACE(xrender_converter, mrgb32_to_argb32, avx2 ? mrgb32_to_argb32_avx2 : mrgb32_to_argb32_ssse3);
+#  endif
+# endif
+#elif SIMD_NEON
+  REPLACE(converter, rgb_to_xrgb, rgb_to_xrgb_neon);
+  REPLACE(converter, rgb_to_rgbx, rgb_to_rgbx_neon);
+  REPLACE(converter, mono_to_32, mono_to_32_neon);
+  REPLACE(converter, rgba_to_xrgb, rgba_to_xrgb_neon);
+  REPLACE(converter, rgba_to_rgbx, rgba_to_rgbx_neon);
+  REPLACE(converter, argb32_to_rgbx, argb32_to_rgbx_neon);
+# if USE_XFT
+  REPLACE(xrender_converter, mask_to_32, mask_to_32_neon);
+  REPLACE(xrender_converter, mono_to_32, mono_to_32_neon);
+  REPLACE(xrender_converter, rgb_to_xrgb, rgb_to_xrgb_neon);
+  REPLACE(xrender_converter, rgba_to_xrgb, rgba_to_xrgb_neon);
+#  if XRENDER_MASK_BROKEN
+  REPLACE(xrender_converter, rgbm_to_argb32, rgbm_to_argb32_neon);
+  REPLACE(xrender_converter, mrgb32_to_argb32, mrgb32_to_argb32_neon);
+#  endif
+# endif
+#endif
+}
+
+#undef REPLACE
+
+//
+// End of "$Id$".
+//
@@ -76,20 +76,59 @@ static int dnd_aware(XWindow xwindow) {
   return 0;
 }
 
+// The windows already asked by dnd_aware() during this drag, so each
+// only costs a round trip the first time the pointer is over it:
+enum {AWARE_CACHE = 64};
+static struct {XWindow window; int version;} aware_cache[AWARE_CACHE];
+static int aware_cached, aware_next;
+
+static int cached_dnd_aware(XWindow xwindow) {
+  for (int i = 0; i < aware_cached; i++)
+    if (aware_cache[i].window == xwindow) return aware_cache[i].version;
+  int version = dnd_aware(xwindow);
+  aware_cache[aware_next].window = xwindow;
+  aware_cache[aware_next].version = version;
+  aware_next = (aware_next+1)%AWARE_CACHE;
+  if (aware_cached < AWARE_CACHE) aware_cached++;
+  return version;
+}
+
 static bool drop_ok;
 static bool moved;
+// As the XDND spec asks, another XdndPosition is not sent until the
+// XdndStatus for the last one arrives, and not at all while the pointer
+// is inside the rectangle the target said it does not care about:
+static bool waiting_for_status;
+static XWindow status_window; // ignore status from earlier targets
+static int quiet_x, quiet_y, quiet_w, quiet_h;
 
 static bool grabfunc(int event) {
   if (event == RELEASE) pushed(0);
   else if (event == MOVE) moved = true;
   else if (!event && xevent.type == ClientMessage
-	   && xevent.xclient.message_type == XdndStatus) {
-    drop_ok = xevent.xclient.data.l[1] != 0;
-    if (drop_ok) dnd_action = xevent.xclient.data.l[3];
+	   && xevent.xclient.message_type == XdndStatus
+	   && XWindow(xevent.xclient.data.l[0]) == status_window) {
+    waiting_for_status = false;
+    long flags = xevent.xclient.data.l[1];
+    drop_ok = (flags&1) != 0;
+    if (drop_ok) dnd_action = xevent.xclient.data.l[4];
+    if (flags&2) {
+      quiet_w = quiet_h = 0;
+    } else {
+      unsigned long xy = xevent.xclient.data.l[2];
+      unsigned long wh = xevent.xclient.data.l[3];
+      quiet_x = short(xy>>16); quiet_y = short(xy&0xffff);
+      quiet_w = int((wh>>16)&0xffff); quiet_h = int(wh&0xffff);
+    }
   }
   return false;
 }
 
+static bool in_quiet_rectangle() {
+  return e_x_root >= quiet_x && e_x_root < quiet_x+quiet_w &&
+    e_y_root >= quiet_y && e_y_root < quiet_y+quiet_h;
+}
+
 extern bool (*fl_local_grab)(int); // in Fl.cxx
 
 // send an event to an fltk window belonging to this program:
@@ -136,6 +175,8 @@ bool fltk::dnd() {
   //  Cursor oldcursor = CURSOR_DEFAULT;
   drop_ok = true;
   moved = true;
+  waiting_for_status = false;
+  aware_cached = aware_next = 0;
 
   while (event_state(ANY_BUTTON)) {
 
@@ -147,12 +188,12 @@ bool fltk::dnd() {
       XQueryPointer(xdisplay, child, &root, &child,
 		    &e_x_root, &e_y_root, &dest_x, &dest_y, &junk3);
       if (!child) {
-	if (!new_window && (new_version = dnd_aware(root))) new_window = root;
+	if (!new_window && (new_version = cached_dnd_aware(root))) new_window = root;
 	break;
       }
       new_window = child;
       if ((new_local_window = find(child))) break;
-      if ((new_version = dnd_aware(new_window))) break;
+      if ((new_version = cached_dnd_aware(new_window))) break;
     }
 
     if (new_window != target_window) {
@@ -164,6 +205,10 @@ bool fltk::dnd() {
       }
       version = new_version;
       target_window = new_window;
+      status_window = new_window;
+      waiting_for_status = false;
+      quiet_w = quiet_h = 0;
+      moved = true;
       local_window = new_local_window;
       if (local_window) {
 	dnd_source_window = source_xwindow;
@@ -182,10 +227,16 @@ bool fltk::dnd() {
       dnd_action = action;
       drop_ok = local_handle(DND_DRAG, local_window);
     } else if (version) {
-      if (moved)
-	fl_sendClientMessage(target_window, XdndPosition, source_xwindow,
-			     0, (e_x_root<<16)|e_y_root, event_time,
-			     action);
+      // a move while waiting is sent when the status arrives:
+      if (moved && !waiting_for_status) {
+	if (!in_quiet_rectangle()) {
+	  fl_sendClientMessage(target_window, XdndPosition, source_xwindow,
+			       0, (e_x_root<<16)|e_y_root, event_time,
+			       action);
+	  waiting_for_status = true;
+	}
+	moved = false;
+      }
     } else {
 #if FAKE_DROP
       drop_ok = (types == local_source_types);
@@ -194,7 +245,7 @@ bool fltk::dnd() {
 #endif
     }
     source_window->cursor(drop_ok ? &fl_drop_ok_cursor : CURSOR_NO);
-    moved = false;
+    if (!version || local_window) moved = false;
     wait();
   }
 
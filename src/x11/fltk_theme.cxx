@@ -102,15 +102,20 @@ static void add_event_handler() {
   if (!done) {
     done = true;
     open_display();
-    Atom kde_atom = XInternAtom(xdisplay, "KDE_DESKTOP_WINDOW", false);
+    // one round trip for all of them:
+    static const char* names[] = {
+      "KDE_DESKTOP_WINDOW", "KDEChangeGeneral", /*"KDEChangeStyle",*/
+      "KDEChangePalette", "KIPC_COMM_ATOM"};
+    Atom atoms[4];
+    XInternAtoms(xdisplay, (char**)names, 4, false, atoms);
+    Atom kde_atom = atoms[0];
     long data = 1;
     XChangeProperty(xdisplay, message_window, kde_atom, kde_atom, 32,
 		    PropModeReplace, (unsigned char *)&data, 1);
 
-    ChangeGeneral = XInternAtom(xdisplay, "KDEChangeGeneral", false);
-    //ChangeStyle = XInternAtom(xdisplay, "KDEChangeStyle", false);
-    ChangePalette = XInternAtom(xdisplay, "KDEChangePalette", false);
-    KIPC = XInternAtom(xdisplay, "KIPC_COMM_ATOM", false);
+    ChangeGeneral = atoms[1];
+    ChangePalette = atoms[2];
+    KIPC = atoms[3];
     fltk::add_event_handler(x_event_handler);
   }
 }
@@ -31,16 +31,20 @@ static void (*init_or_lock_function)() = init_function;
 static void lock_function() {XLockDisplay(fltk::xdisplay);}
 static void unlock_function() {XUnlockDisplay(fltk::xdisplay);}
 
-static void* thread_message_;
 static void thread_awake_cb(int fd, void*) {
-  while (read(fd, &thread_message_, sizeof(void*)) > 0);
+  char buffer[64];
+  while (read(fd, buffer, sizeof(buffer)) > 0);
+  awake_queue_drained();
 }
 static int thread_filedes[2];
+static pthread_t main_thread_id;
 
 static void init_function() {
+  main_thread_id = pthread_self();
   XInitThreads();
   fltk::open_display();
   // Init threads communication pipe to let threads awake FLTK from wait
+  awake_queue_init();
   pipe(thread_filedes);
   fcntl(thread_filedes[0], F_SETFL, O_NONBLOCK);
   fltk::add_fd(thread_filedes[0], fltk::READ, thread_awake_cb);
@@ -53,12 +57,20 @@ void fltk::lock() {init_or_lock_function();}
 
 void fltk::unlock() {fl_unlock_function();}
 
+// XLockDisplay() is the only lock, so there is no shared version:
+void fltk::lock_shared() {lock();}
+
+void fltk::unlock_shared() {unlock();}
+
 void fltk::awake(void* msg) {
-  write(thread_filedes[1], &msg, sizeof(void*));
+  // only write to the pipe if the main thread has not been woken yet:
+  if (awake_queue_push(msg)) write(thread_filedes[1], "", 1);
 }
 
 void* fltk::thread_message() {
-  void* r = thread_message_;
-  thread_message_ = 0;
-  return r;
+  return awake_queue_pop();
+}
+
+bool fltk::in_main_thread() {
+  return init_or_lock_function == init_function || pthread_self() == main_thread_id;
 }
@@ -25,6 +25,7 @@
 //    http://www.fltk.org/str.php
 
 #include <fltk/string.h>
+#include <fltk/trace.h>
 
 #ifdef DEBUG
 #  include <stdio.h>
@@ -37,8 +38,91 @@
 #    undef Window
 #  endif // __sgi
 
+#if USE_XSHM
+# include <sys/ipc.h>
+# include <sys/shm.h>
+# include <X11/extensions/XShm.h>
+#endif
+
 using namespace fltk;
 
+#if USE_XSHM
+// A shared memory segment kept between calls, so reading the same
+// area every frame does not make a new one each time:
+static XShmSegmentInfo read_shminfo;
+static unsigned long read_shmsize;
+static int read_shm_ok = -1; // -1 if not tested yet
+
+static int read_shm_error;
+static int read_shm_handler(Display*, XErrorEvent*) {
+  read_shm_error = 1;
+  return 0;
+}
+
+// Make the segment at least n bytes, return false if it can't:
+static bool read_shm_reserve(unsigned long n) {
+  if (read_shm_ok < 0) read_shm_ok = XShmQueryExtension(xdisplay);
+  if (!read_shm_ok) return false;
+  if (n <= read_shmsize) return true;
+  if (read_shminfo.shmaddr) {
+    XShmDetach(xdisplay, &read_shminfo);
+    shmdt(read_shminfo.shmaddr);
+    read_shminfo.shmaddr = 0;
+    read_shmsize = 0;
+  }
+  n = (n+0xffff)&~0xffffUL;
+  read_shminfo.shmid = shmget(IPC_PRIVATE, n, IPC_CREAT|0600);
+  if (read_shminfo.shmid < 0) {read_shm_ok = 0; return false;}
+  read_shminfo.shmaddr = (char*)shmat(read_shminfo.shmid, 0, 0);
+  read_shminfo.readOnly = False;
+  read_shm_error = 0;
+  int (*f)(Display*, XErrorEvent*) = XSetErrorHandler(read_shm_handler);
+  if (read_shminfo.shmaddr != (char*)-1) {
+    XShmAttach(xdisplay, &read_shminfo);
+    XSync(xdisplay, False);
+  } else {
+    read_shm_error = 1;
+  }
+  XSetErrorHandler(f);
+  // removed now, so it goes away when the program exits:
+  shmctl(read_shminfo.shmid, IPC_RMID, 0);
+  if (read_shm_error) {
+    if (read_shminfo.shmaddr != (char*)-1) shmdt(read_shminfo.shmaddr);
+    read_shminfo.shmaddr = 0;
+    read_shm_ok = 0; // don't try again
+    return false;
+  }
+  read_shmsize = n;
+  return true;
+}
+
+// Read with XShmGetImage(), return null if that can't be done:
+static XImage* read_shm(int X, int Y, int w, int h) {
+  XImage* image = XShmCreateImage(xdisplay, xvisual->visual, xvisual->depth,
+				  ZPixmap, 0, &read_shminfo, w, h);
+  if (!image) return 0;
+  if (!read_shm_reserve((unsigned long)image->bytes_per_line*h)) {
+    XFree(image);
+    return 0;
+  }
+  image->data = read_shminfo.shmaddr;
+  image->obdata = (char*)&read_shminfo;
+  frame_counts_.round_trips++;
+  if (!XShmGetImage(xdisplay, xwindow, image, X, Y, AllPlanes)) {
+    XFree(image);
+    return 0;
+  }
+  return image;
+}
+#endif
+
+// Table to turn a value of 0..mask into 0..255:
+static uchar* make_table(unsigned mask) {
+  uchar* t = new uchar[mask+1];
+  for (unsigned v = 0; v <= mask; v++) t[v] = 255*v/mask;
+  return t;
+}
+
 uchar *				// O - Pixel buffer or NULL if failed
 fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 	PixelType type,		// Type of pixels to store (RGB and RGBA only now)
@@ -66,6 +150,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 		green_shift,
 		blue_mask,
 		blue_shift;
+  uchar		*red_table = 0,	// convert masked values to 0..255
+		*green_table = 0,
+		*blue_table = 0;
 
   //
   // Under X11 we have the option of the XGetImage() interface or SGI's
@@ -73,6 +160,8 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
   // us...
   //
 
+  bool shared = false; // image->data is read_shminfo
+
 #  ifdef __sgi
   if (XReadDisplayQueryExtension(xdisplay, &i, &i)) {
     image = XReadDisplay(xdisplay, xwindow, X, Y, w, h, 0, NULL);
@@ -81,8 +170,16 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
   image = 0;
 #  endif // __sgi
 
+#if USE_XSHM
+  if (!image) {
+    image = read_shm(X, Y, w, h);
+    if (image) shared = true;
+  }
+#endif
+
   if (!image) {
     image = XGetImage(xdisplay, xwindow, X, Y, w, h, AllPlanes, ZPixmap);
+    frame_counts_.round_trips++;
   }
 
   if (!image) return 0;
@@ -265,6 +362,31 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
       blue_shift ++;
     }
 
+    // The usual 24 bit color can be copied byte by byte:
+    if (image->bits_per_pixel == 32 && image->byte_order == LSBFirst &&
+	image->red_mask == 0xff0000 && image->green_mask == 0xff00 &&
+	image->blue_mask == 0xff) {
+      for (y = 0; y < image->height; y ++) {
+	pixel = (unsigned char *)(image->data + y * image->bytes_per_line);
+	line  = p + y * linedelta;
+	for (x = image->width; x > 0; x --, line += d, pixel += 4) {
+	  line[0] = pixel[2];
+	  line[1] = pixel[1];
+	  line[2] = pixel[0];
+	}
+      }
+      goto DONE;
+    }
+
+    // Tables, instead of a multiply and divide for each one. Use only
+    // the top 12 bits of very wide masks:
+    while (red_mask > 4095) {red_mask >>= 1; red_shift++;}
+    while (green_mask > 4095) {green_mask >>= 1; green_shift++;}
+    while (blue_mask > 4095) {blue_mask >>= 1; blue_shift++;}
+    red_table = make_table(red_mask);
+    green_table = make_table(green_mask);
+    blue_table = make_table(blue_mask);
+
     // Read the pixels and output an RGB image...
     for (y = 0; y < image->height; y ++) {
       pixel = (unsigned char *)(image->data + y * image->bytes_per_line);
@@ -277,9 +399,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 	       x --, line_ptr += d, pixel ++) {
 	    i = *pixel;
 
-	    line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	    line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	    line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	    line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	    line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	    line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 	  }
 	  break;
 
@@ -293,9 +415,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 	      i = ((pixel[1] << 8) | pixel[2]) & 4095;
 	    }
 
-	    line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	    line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	    line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	    line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	    line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	    line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 
 	    if (index_shift == 0) {
 	      index_shift = 4;
@@ -314,9 +436,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 		 x --, line_ptr += d, pixel += 2) {
 	      i = (pixel[1] << 8) | pixel[0];
 
-	      line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	      line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	      line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	      line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	      line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	      line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 	    }
 	  } else {
 	    // Big-endian...
@@ -325,9 +447,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 		 x --, line_ptr += d, pixel += 2) {
 	      i = (pixel[0] << 8) | pixel[1];
 
-	      line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	      line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	      line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	      line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	      line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	      line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 	    }
 	  }
 	  break;
@@ -340,9 +462,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 		 x --, line_ptr += d, pixel += 3) {
 	      i = (((pixel[2] << 8) | pixel[1]) << 8) | pixel[0];
 
-	      line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	      line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	      line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	      line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	      line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	      line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 	    }
 	  } else {
 	    // Big-endian...
@@ -351,9 +473,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 		 x --, line_ptr += d, pixel += 3) {
 	      i = (((pixel[0] << 8) | pixel[1]) << 8) | pixel[2];
 
-	      line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	      line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	      line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	      line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	      line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	      line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 	    }
 	  }
 	  break;
@@ -366,9 +488,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 		 x --, line_ptr += d, pixel += 4) {
 	      i = (((((pixel[3] << 8) | pixel[2]) << 8) | pixel[1]) << 8) | pixel[0];
 
-	      line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	      line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	      line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	      line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	      line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	      line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 	    }
 	  } else {
 	    // Big-endian...
@@ -377,9 +499,9 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
 		 x --, line_ptr += d, pixel += 4) {
 	      i = (((((pixel[0] << 8) | pixel[1]) << 8) | pixel[2]) << 8) | pixel[3];
 
-	      line_ptr[0] = 255 * ((i >> red_shift) & red_mask) / red_mask;
-	      line_ptr[1] = 255 * ((i >> green_shift) & green_mask) / green_mask;
-	      line_ptr[2] = 255 * ((i >> blue_shift) & blue_mask) / blue_mask;
+	      line_ptr[0] = red_table[(i >> red_shift) & red_mask];
+	      line_ptr[1] = green_table[(i >> green_shift) & green_mask];
+	      line_ptr[2] = blue_table[(i >> blue_shift) & blue_mask];
 	    }
 	  }
 	  break;
@@ -387,8 +509,13 @@ fltk::readimage(uchar *p,	// I - Pixel buffer or NULL to allocate
     }
   }
 
+  delete[] red_table;
+  delete[] green_table;
+  delete[] blue_table;
+ DONE:
   // Destroy the X image we've read and return the RGB(A) image...
-  XDestroyImage(image);
+  if (shared) XFree(image); // keep the shared memory
+  else XDestroyImage(image);
 
   return p;
 }
@@ -46,7 +46,9 @@
 #include <fltk/visual.h>
 #include <fltk/Font.h>
 #include <fltk/Browser.h>
+#include <fltk/Image.h>
 #include <fltk/utf.h>
+#include "../DamageRects.h"
 
 #include <X11/extensions/XInput.h>
 #include <X11/extensions/XI.h>
@@ -60,7 +62,13 @@
 using namespace fltk;
 
 ////////////////////////////////////////////////////////////////
-// interface to poll/select call:
+// interface to poll/epoll/kqueue/select call:
+
+#if USE_POLL
+# undef USE_EPOLL
+# undef USE_KQUEUE
+#endif
+#define USE_SELECT (!USE_POLL && !USE_EPOLL && !USE_KQUEUE)
 
 #if USE_POLL
 
@@ -69,6 +77,12 @@ static pollfd *pollfds = 0;
 
 #else
 
+#if USE_EPOLL
+#  include <sys/epoll.h>
+#elif USE_KQUEUE
+#  include <sys/types.h>
+#  include <sys/event.h>
+#else
 #if HAVE_SYS_SELECT_H
 #  include <sys/select.h>
 #endif /* HAVE_SYS_SELECT_H */
@@ -78,6 +92,7 @@ static pollfd *pollfds = 0;
 
 static fd_set fdsets[3];
 static int maxfd;
+#endif
 #define POLLIN 1
 #define POLLOUT 4
 #define POLLERR 8
@@ -90,11 +105,179 @@ static struct FD {
 #if !USE_POLL
   int fd;
   short events;
+#endif
+#if USE_EPOLL || USE_KQUEUE
+  int next;	// next entry for the same fd, or -1
 #endif
   void (*cb)(int, void*);
   void* arg;
 } *fd = 0;
 
+extern bool fl_recording;
+extern void fl_record_fd(int); // in EventReplay.cxx
+
+// Do the callback for fd[i], which is f:
+static inline void fd_callback(int i, int f) {
+  if (fl_recording && f != ConnectionNumber(xdisplay)) fl_record_fd(f);
+  fd[i].cb(f, fd[i].arg);
+}
+
+#if USE_EPOLL || USE_KQUEUE
+#include <fcntl.h>
+#include <errno.h>
+
+// The kernel remembers the set of file descriptors, so it only needs
+// to be told when the combined events wanted for an fd change:
+static int event_queue_fd = -1;
+#if USE_EPOLL
+typedef epoll_event ReadyEvent;
+#else
+typedef struct kevent ReadyEvent;
+#endif
+static ReadyEvent* ready_events;
+static int ready_events_size;
+
+static int event_queue() {
+  if (event_queue_fd < 0) {
+#if USE_EPOLL
+    event_queue_fd = epoll_create(64);
+#else
+    event_queue_fd = kqueue();
+#endif
+    if (event_queue_fd < 0) fatal("fltk: cannot create event queue");
+    fcntl(event_queue_fd, F_SETFD, FD_CLOEXEC);
+  }
+  if (ready_events_size < fd_array_size || !ready_events_size) {
+    ready_events_size = fd_array_size > 16 ? fd_array_size : 16;
+    ready_events = (ReadyEvent*)
+      realloc(ready_events, ready_events_size*sizeof(ReadyEvent));
+  }
+  return event_queue_fd;
+}
+
+// The first entry in fd[] for each file descriptor, or -1, so the
+// handlers for a ready fd are found without searching all of them:
+static int* fd_first;
+static int fd_first_size;
+static unsigned fd_changes; // incremented whenever fd[] is rearranged
+
+static inline int first_fd(int n) {
+  return n < fd_first_size ? fd_first[n] : -1;
+}
+
+// Put entry i at the start of the list for its fd:
+static void link_fd(int i) {
+  int n = fd[i].fd;
+  if (n >= fd_first_size) {
+    int size = fd_first_size ? 2*fd_first_size : 64;
+    while (size <= n) size *= 2;
+    fd_first = (int*)realloc(fd_first, size*sizeof(int));
+    for (int j = fd_first_size; j < size; j++) fd_first[j] = -1;
+    fd_first_size = size;
+  }
+  fd[i].next = fd_first[n];
+  fd_first[n] = i;
+}
+
+// Return all the events that add_fd() asked for on this fd:
+static int fd_events(int n) {
+  int e = 0;
+  for (int i = first_fd(n); i >= 0; i = fd[i].next) e |= fd[i].events;
+  return e;
+}
+
+// The kernel refuses to watch some fds, such as epoll with regular
+// files. select() says those are always ready, so they are kept in this
+// list and fl_wait() does their callbacks every time without waiting:
+static int* always_ready;
+static int num_always_ready, always_ready_size;
+
+static bool is_always_ready(int n) {
+  for (int i = 0; i < num_always_ready; i++)
+    if (always_ready[i] == n) return true;
+  return false;
+}
+
+static void set_always_ready(int n, bool v) {
+  for (int i = 0; i < num_always_ready; i++) if (always_ready[i] == n) {
+    if (!v) always_ready[i] = always_ready[--num_always_ready];
+    return;
+  }
+  if (!v) return;
+  if (num_always_ready >= always_ready_size) {
+    always_ready_size = always_ready_size ? 2*always_ready_size : 4;
+    always_ready = (int*)realloc(always_ready, always_ready_size*sizeof(int));
+  }
+  always_ready[num_always_ready++] = n;
+}
+
+static void update_event_queue(int n, int old_events, int new_events) {
+  if (old_events == new_events) return;
+  if (!new_events) set_always_ready(n, false);
+  else if (is_always_ready(n)) return;
+  int q = event_queue();
+  bool ok = true;
+#if USE_EPOLL
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  if (new_events & POLLIN) ev.events |= EPOLLIN;
+  if (new_events & POLLOUT) ev.events |= EPOLLOUT;
+  if (new_events & POLLERR) ev.events |= EPOLLPRI;
+  ev.data.fd = n;
+  if (!new_events) {
+    epoll_ctl(q, EPOLL_CTL_DEL, n, &ev);
+  } else if (!old_events) {
+    ok = epoll_ctl(q, EPOLL_CTL_ADD, n, &ev) == 0;
+  } else if (epoll_ctl(q, EPOLL_CTL_MOD, n, &ev) < 0) {
+    // the fd was closed and reopened without calling remove_fd():
+    ok = errno == ENOENT && epoll_ctl(q, EPOLL_CTL_ADD, n, &ev) == 0;
+  }
+#else
+  // kqueue has no filter for exceptions, they are reported as readable:
+  struct kevent kev[2];
+  int k = 0;
+  bool old_read = (old_events & (POLLIN|POLLERR)) != 0;
+  bool new_read = (new_events & (POLLIN|POLLERR)) != 0;
+  if (old_read != new_read)
+    EV_SET(&kev[k++], n, EVFILT_READ, new_read ? EV_ADD : EV_DELETE, 0, 0, 0);
+  if ((old_events ^ new_events) & POLLOUT)
+    EV_SET(&kev[k++], n, EVFILT_WRITE,
+	   (new_events & POLLOUT) ? EV_ADD : EV_DELETE, 0, 0, 0);
+  if (k && kevent(q, kev, k, 0, 0, 0) < 0 && new_events) ok = false;
+#endif
+  // a closed fd fails too, but then select() would fail as well:
+  if (!ok && errno != EBADF) set_always_ready(n, true);
+}
+
+// Do the callbacks for fd f that want any of the revents:
+static void dispatch_fd(int f, int revents) {
+  unsigned changes = fd_changes;
+  for (int i = first_fd(f); i >= 0; i = fd[i].next) {
+    if (fd[i].events & revents) fd_callback(i, f);
+    // stop if the callback added or removed handlers, as i is wrong now:
+    if (fd_changes != changes) break;
+  }
+}
+
+// Translate the i'th returned event to POLLIN/POLLOUT/POLLERR bits:
+static int ready_fd(int i, int& revents) {
+#if USE_EPOLL
+  unsigned e = ready_events[i].events;
+  revents = 0;
+  // like select(), report hangups and errors as readable and writable:
+  if (e & (EPOLLIN|EPOLLHUP|EPOLLERR)) revents |= POLLIN;
+  if (e & (EPOLLOUT|EPOLLERR)) revents |= POLLOUT;
+  if (e & EPOLLPRI) revents |= POLLERR;
+  return ready_events[i].data.fd;
+#else
+  ReadyEvent& e = ready_events[i];
+  revents = (e.filter == EVFILT_WRITE) ? POLLOUT : POLLIN;
+  if (e.flags & (EV_EOF|EV_ERROR)) revents |= POLLERR;
+  return int(e.ident);
+#endif
+}
+#endif
+
 ////////////////////////////////////////////////////////////////
 #if USE_XIM
 
@@ -104,9 +287,12 @@ static XFontSet fl_xim_fs = NULL;
 static char fl_is_over_the_spot = 0;
 static XRectangle status_area;
 
+static void fl_init_xim();
+
 static void fl_new_ic(XWindow xid)
 {
-  // Give up if this failed earlier:
+  fl_init_xim();
+  // Give up if this failed:
   if (!fl_xim_im)
     return;
 
@@ -201,10 +387,15 @@ static void fl_new_ic(XWindow xid)
   }
 }
 
+// This is slow with some input methods, so it is not done until one of
+// our windows gets the focus or a key is typed, rather than delaying
+// the first window:
 static void fl_init_xim()
 {
-  if (!xdisplay) return;
-  if (fl_xim_im) return;
+  static bool tried;
+  if (tried || !xdisplay) return;
+  tried = true;
+  TraceScope trace(TRACE_STARTUP, "XOpenIM");
 
   XSetLocaleModifiers("");
   fl_xim_im = XOpenIM(xdisplay, NULL, NULL, NULL);
@@ -320,6 +511,9 @@ void fl_set_spot(fltk::Font *f, Widget *w, int x, int y) {}
 */
 void fltk::add_fd(int n, int events, FileHandler cb, void *v) {
   remove_fd(n,events);
+#if USE_EPOLL || USE_KQUEUE
+  int old_events = fd_events(n);
+#endif
   int i = nfds++;
   if (i >= fd_array_size) {
     fd_array_size = 2*fd_array_size+1;
@@ -336,11 +530,17 @@ void fltk::add_fd(int n, int events, FileHandler cb, void *v) {
 #else
   fd[i].fd = n;
   fd[i].events = events;
+#if USE_EPOLL || USE_KQUEUE
+  link_fd(i);
+  fd_changes++;
+  update_event_queue(n, old_events, old_events|events);
+#else
   if (events & POLLIN) FD_SET(n, &fdsets[0]);
   if (events & POLLOUT) FD_SET(n, &fdsets[1]);
   if (events & POLLERR) FD_SET(n, &fdsets[2]);
   if (n > maxfd) maxfd = n;
 #endif
+#endif
 }
 
 /*! Same as add_fd(fd, READ, cb, v); */
@@ -357,7 +557,9 @@ void fltk::add_fd(int fd, FileHandler cb, void* v) {
 */
 void fltk::remove_fd(int n, int events) {
   int i,j;
-#if !USE_POLL
+#if USE_EPOLL || USE_KQUEUE
+  int old_events = fd_events(n);
+#elif USE_SELECT
   maxfd = 0;
 #endif
   for (i=j=0; i<nfds; i++) {
@@ -382,13 +584,19 @@ void fltk::remove_fd(int n, int events) {
       fd[j] = fd[i];
 #endif
     }
-#if !USE_POLL
+#if USE_SELECT
     if (fd[j].fd > maxfd) maxfd = fd[j].fd;
 #endif
     j++;
   }
   nfds = j;
-#if !USE_POLL
+#if USE_EPOLL || USE_KQUEUE
+  // entries have moved, so make the lists again:
+  for (i = 0; i < fd_first_size; i++) fd_first[i] = -1;
+  for (i = nfds; i--;) link_fd(i);
+  fd_changes++;
+  if (old_events) update_event_queue(n, old_events, fd_events(n));
+#elif USE_SELECT
   if (events & POLLIN) FD_CLR(n, &fdsets[0]);
   if (events & POLLOUT) FD_CLR(n, &fdsets[1]);
   if (events & POLLERR) FD_CLR(n, &fdsets[2]);
@@ -397,6 +605,9 @@ void fltk::remove_fd(int n, int events) {
 
 #if CONSOLIDATE_MOTION
 static Window* send_motion;
+extern bool fl_keep_motion_history;
+extern int fl_motion_history_count;
+extern void fl_add_motion_sample(unsigned long time);
 #endif
 static bool in_a_window; // true if in any of our windows, even destroyed ones
 static void do_queued_events(int, void*) {
@@ -411,6 +622,7 @@ static void do_queued_events(int, void*) {
   else if (send_motion == xmousewin) {
     send_motion = 0;
     handle(MOVE, xmousewin);
+    fl_motion_history_count = 0;
   }
 #endif
 }
@@ -419,6 +631,9 @@ static void do_queued_events(int, void*) {
 static void nothing() {}
 void (*fl_lock_function)() = nothing;
 void (*fl_unlock_function)() = nothing;
+// these are set by lock() so other threads can lock_shared() during flush():
+void (*fl_share_lock_function)() = nothing;
+void (*fl_unshare_lock_function)() = nothing;
 
 // Wait up to the given time for any events or sockets to become ready,
 // do the callbacks for the events and sockets:
@@ -429,17 +644,35 @@ static inline int fl_wait(float time_to_wait) {
   // so we must check for already-read events:
   if (xdisplay && XQLength(xdisplay)) {do_queued_events(0,0); return 1;}
 
-#if !USE_POLL
+#if USE_SELECT
   fd_set fdt[3];
   fdt[0] = fdsets[0];
   fdt[1] = fdsets[1];
   fdt[2] = fdsets[2];
+#elif USE_EPOLL || USE_KQUEUE
+  int q = event_queue();
+  if (num_always_ready) time_to_wait = 0;
 #endif
 
+  double trace_start = tracing() ? trace_time() : 0;
   fl_unlock_function();
 #if USE_POLL
   int n = ::poll(pollfds, nfds,
 		 (time_to_wait<2147483.648f) ? int(time_to_wait*1000+.5f) : -1);
+#elif USE_EPOLL
+  // round up, otherwise it spins for the last half millisecond of a timeout:
+  int n = ::epoll_wait(q, ready_events, ready_events_size,
+		 (time_to_wait<2147483.648f) ? int(time_to_wait*1000+.999f) : -1);
+#elif USE_KQUEUE
+  int n;
+  if (time_to_wait < 2147483.648f) {
+    timespec t;
+    t.tv_sec = int(time_to_wait);
+    t.tv_nsec = int(1000000000 * (time_to_wait-float(t.tv_sec)));
+    n = ::kevent(q, 0, 0, ready_events, ready_events_size, &t);
+  } else {
+    n = ::kevent(q, 0, 0, ready_events, ready_events_size, 0);
+  }
 #else
   int n;
   if (time_to_wait < 2147483.648f) {
@@ -452,29 +685,74 @@ static inline int fl_wait(float time_to_wait) {
   }
 #endif
   fl_lock_function();
-
+  if (tracing()) trace(TRACE_WAIT, "wait", 0, trace_start);
+
+#if USE_EPOLL || USE_KQUEUE
+  // Only the ready fd's are returned, and their handlers are found with
+  // fd_first[], so this does not depend on how many are being watched:
+  for (int r = 0; r < n; r++) {
+    int revents;
+    int f = ready_fd(r, revents);
+#if USE_KQUEUE
+    // read and write are returned separately, combine them into one call:
+    int s; for (s = 0; s < r; s++) {
+      int e; if (ready_fd(s, e) == f) break;
+    }
+    if (s < r) continue; // already done
+    for (s = r+1; s < n; s++) {
+      int e; if (ready_fd(s, e) == f) revents |= e;
+    }
+#endif
+    if (num_always_ready && is_always_ready(f)) continue;
+    dispatch_fd(f, revents);
+  }
+  // like select(), the fds the kernel can't watch are always readable
+  // and writable. Copy them as the callbacks may change the list:
+  int num_always = num_always_ready;
+  if (num_always) {
+    if (n < 0) n = 0;
+    int* always = new int[num_always];
+    memcpy(always, always_ready, num_always*sizeof(int));
+    for (int r = 0; r < num_always; r++) {
+      if (!is_always_ready(always[r])) continue;
+      n++;
+      dispatch_fd(always[r], POLLIN|POLLOUT);
+    }
+    delete[] always;
+  }
+#else
   if (n > 0) {
     for (int i=0; i<nfds; i++) {
 #if USE_POLL
-      if (pollfds[i].revents) fd[i].cb(pollfds[i].fd, fd[i].arg);
+      if (pollfds[i].revents) fd_callback(i, pollfds[i].fd);
 #else
       int f = fd[i].fd;
       short revents = 0;
       if (FD_ISSET(f,&fdt[0])) revents |= POLLIN;
       if (FD_ISSET(f,&fdt[1])) revents |= POLLOUT;
       if (FD_ISSET(f,&fdt[2])) revents |= POLLERR;
-      if (fd[i].events & revents) fd[i].cb(f, fd[i].arg);
+      if (fd[i].events & revents) fd_callback(i, f);
 #endif
     }
   }
+#endif
   return n;
 }
 
 // ready() is just like wait(0.0) except no callbacks are done:
 static inline int fl_ready() {
-  if (XQLength(xdisplay)) return 1;
+  if (xdisplay && XQLength(xdisplay)) return 1;
 #if USE_POLL
   return ::poll(pollfds, nfds, 0);
+#elif USE_EPOLL
+  if (num_always_ready) return num_always_ready;
+  return ::epoll_wait(event_queue(), ready_events, ready_events_size, 0);
+#elif USE_KQUEUE
+  if (num_always_ready) return num_always_ready;
+  timespec t;
+  t.tv_sec = 0;
+  t.tv_nsec = 0;
+  return ::kevent(event_queue(), 0, 0, ready_events, ready_events_size, &t);
 #else
   timeval t;
   t.tv_sec = 0;
@@ -550,6 +828,7 @@ static Atom WM_PROTOCOLS;
 static Atom FLTKChangeScheme;
 static Atom TARGETS;
 static Atom CLIPBOARD;
+static Atom INCR;
 Atom XdndAware;
 Atom XdndSelection;
 Atom XdndEnter;
@@ -569,6 +848,10 @@ static Atom _NET_WM_NAME;
 static Atom _NET_WM_ICON_NAME;
 static Atom _NET_WORKAREA;
 static Atom _NET_CURRENT_DESKTOP;
+static Atom _NET_WM_ICON;
+Atom fl_NET_WM_STATE;
+Atom fl_NET_WM_STATE_MAXIMIZED_VERT;
+Atom fl_NET_WM_STATE_MAXIMIZED_HORZ;
 Atom UTF8_STRING;
 
 extern "C" {
@@ -584,6 +867,14 @@ static int xerror_handler(Display* d, XErrorEvent* e) {
 }
 }
 
+// If FLTK_STARTUP_REPORT is set in the environment the TRACE_STARTUP
+// intervals are printed when the first window is mapped:
+static double startup_begin;
+static bool startup_report;
+
+// If FLTK_INPUT_LATENCY is set the latencies are printed on exit:
+static void latency_report() {write_latency_report(stderr);}
+
 /**
 Opens the display.  Does nothing if it is already open.  You should
 call this if you wish to do X calls and there is a chance that your
@@ -595,12 +886,27 @@ display.
 */
 void fltk::open_display() {
   if (xdisplay) return;
+  if (!startup_begin) {
+    startup_begin = trace_time();
+    if (getenv("FLTK_STARTUP_REPORT")) {
+      startup_report = true;
+      if (!tracing()) start_tracing();
+    }
+    if (getenv("FLTK_FLASH_REDRAWS")) flash_redraws();
+    if (getenv("FLTK_INPUT_LATENCY")) {
+      start_latency_measure();
+      atexit(latency_report);
+    }
+  }
+  TraceScope trace(TRACE_STARTUP, "open_display");
 
   setlocale(LC_CTYPE, "");
   XSetIOErrorHandler(io_error_handler);
   XSetErrorHandler(xerror_handler);
 
-  Display *d = XOpenDisplay(0);
+  Display *d;
+  {TraceScope t(TRACE_STARTUP, "XOpenDisplay");
+  d = XOpenDisplay(0);}
   if (!d) fatal("Can't open display \"%s\"",XDisplayName(0));
   open_display(d);
 }
@@ -615,7 +921,7 @@ void fltk::open_display(Display* d) {
   xdisplay = d;
   add_fd(ConnectionNumber(d), POLLIN, do_queued_events);
 
-#define MAX_ATOMS 30
+#define MAX_ATOMS 34
   Atom* atom_ptr[MAX_ATOMS];
   const char* names[MAX_ATOMS];
   int i = 0;
@@ -626,6 +932,7 @@ void fltk::open_display(Display* d) {
   atom(	FLTKChangeScheme	, "FLTKChangeScheme");
   atom(	TARGETS			, "TARGETS");
   atom(	CLIPBOARD		, "CLIPBOARD");
+  atom(	INCR			, "INCR");
   atom(	XdndAware		, "XdndAware");
   atom(	XdndSelection		, "XdndSelection");
   atom(	XdndEnter		, "XdndEnter");
@@ -645,10 +952,15 @@ void fltk::open_display(Display* d) {
   atom( _NET_WM_ICON_NAME	, "_NET_WM_ICON_NAME");
   atom(	_NET_WORKAREA		, "_NET_WORKAREA");
   atom(	_NET_CURRENT_DESKTOP	, "_NET_CURRENT_DESKTOP");
+  atom(	_NET_WM_ICON		, "_NET_WM_ICON");
+  atom(	fl_NET_WM_STATE		, "_NET_WM_STATE");
+  atom(	fl_NET_WM_STATE_MAXIMIZED_VERT, "_NET_WM_STATE_MAXIMIZED_VERT");
+  atom(	fl_NET_WM_STATE_MAXIMIZED_HORZ, "_NET_WM_STATE_MAXIMIZED_HORZ");
   atom( UTF8_STRING		, "UTF8_STRING");
 #undef atom
   Atom atoms[MAX_ATOMS];
-  XInternAtoms(d, (char**)names, i, 0, atoms);
+  {TraceScope t(TRACE_STARTUP, "XInternAtoms");
+  XInternAtoms(d, (char**)names, i, 0, atoms);}
   for (; i--;) *atom_ptr[i] = atoms[i];
 
   xscreen = DefaultScreen(d);
@@ -663,9 +975,7 @@ void fltk::open_display(Display* d) {
   templt.visualid = XVisualIDFromVisual(DefaultVisual(d, xscreen));
   xvisual = XGetVisualInfo(d, VisualIDMask, &templt, &num);
   xcolormap = DefaultColormap(d, xscreen);
-#if USE_XIM
-  fl_init_xim();
-#endif
+  // XIM is opened later by fl_init_xim()
 
 #if !USE_COLORMAP
   visual(RGB);
@@ -685,9 +995,33 @@ void fltk::close_display() {
   xdisplay = 0;
 }
 
+/**
+Returns how many seconds a round trip to the X server takes. This is
+measured with XSync() the first time it is called. It is a small
+fraction of a millisecond for a local display and may be tens of
+milliseconds for a remote one. Window::client_drawing() uses this.
+*/
+double fltk::display_latency() {
+  static double latency = -1;
+  if (latency < 0) {
+    open_display();
+    XSync(xdisplay, false); // so queued requests are not timed
+    // the fastest of a few is the one least disturbed by other work:
+    latency = 1e30;
+    for (int n = 0; n < 3; n++) {
+      double t = get_time_secs();
+      XSync(xdisplay, false);
+      t = get_time_secs()-t;
+      if (t < latency) latency = t;
+    }
+  }
+  return latency;
+}
+
 ////////////////////////////////////////////////////////////////
 
 static bool reload_info = true;
+static void watch_monitors();
 
 /*! \class fltk::Monitor
     Structure describing one of the monitors (screens) connected to
@@ -713,6 +1047,7 @@ const Monitor& Monitor::all() {
   if (reload_info) {
     reload_info = false;
     open_display();
+    watch_monitors();
     monitor.set(0, 0,
 		DisplayWidth(xdisplay, xscreen),
 		DisplayHeight(xdisplay, xscreen));
@@ -720,6 +1055,7 @@ const Monitor& Monitor::all() {
     // initially assume work area is entire monitor:
     monitor.work = monitor;
 
+    TraceScope trace(TRACE_STARTUP, "Monitor::all");
     // Try to get the work area from the X Desktop standard:
     // First find out what desktop we are on, as it allows the work area
     // to be different (however fltk will return whatever the first answer
@@ -773,18 +1109,143 @@ extern "C" {
 static Monitor* monitors = 0;
 static int num_monitors=0;
 
+// Monitor::find() looks up which monitor covers a point in a grid
+// made of all the monitors' edges, rather than searching the list.
+// grid_column and grid_row turn a position into a cell of the grid,
+// and each cell has the monitor covering it, or -1 if none does:
+static unsigned char* grid_column;
+static unsigned char* grid_row;
+static signed char* grid;
+static int grid_columns, grid_x, grid_y, grid_w, grid_h;
+
+static int compare_ints(const void* a, const void* b) {
+  return *(const int*)a - *(const int*)b;
+}
+
+// Sort and remove duplicates, return how many are left:
+static int unique_edges(int* e, int n) {
+  qsort(e, n, sizeof(int), compare_ints);
+  int j = 0;
+  for (int i = 0; i < n; i++) if (!j || e[i] != e[j-1]) e[j++] = e[i];
+  return j;
+}
+
+// Fill table[0..edges[n-1]-edges[0]) with the interval each position is in:
+static unsigned char* edge_table(const int* edges, int n) {
+  int size = edges[n-1]-edges[0];
+  unsigned char* table = new unsigned char[size > 0 ? size : 1];
+  for (int i = 0; i+1 < n; i++)
+    memset(table+edges[i]-edges[0], i, edges[i+1]-edges[i]);
+  return table;
+}
+
+static void build_grid() {
+  int xs[200], ys[200];
+  for (int i = 0; i < num_monitors; i++) {
+    xs[2*i] = monitors[i].x(); xs[2*i+1] = monitors[i].r();
+    ys[2*i] = monitors[i].y(); ys[2*i+1] = monitors[i].b();
+  }
+  int nx = unique_edges(xs, 2*num_monitors);
+  int ny = unique_edges(ys, 2*num_monitors);
+  grid_x = xs[0]; grid_w = xs[nx-1]-xs[0];
+  grid_y = ys[0]; grid_h = ys[ny-1]-ys[0];
+  grid_column = edge_table(xs, nx);
+  grid_row = edge_table(ys, ny);
+  grid_columns = nx-1;
+  grid = new signed char[(nx-1)*(ny-1)];
+  for (int r = 0; r+1 < ny; r++) for (int c = 0; c+1 < nx; c++) {
+    int i;
+    for (i = 0; i < num_monitors; i++) // the first one is the primary
+      if (monitors[i].contains(xs[c], ys[r])) break;
+    grid[r*(nx-1)+c] = i < num_monitors ? i : -1;
+  }
+}
+
+// Throw away everything so it is looked up again when next asked for:
+static void monitors_changed() {
+  reload_info = true;
+  if (num_monitors > 1) delete[] monitors;
+  monitors = 0;
+  num_monitors = 0;
+  delete[] grid_column; grid_column = 0;
+  delete[] grid_row; grid_row = 0;
+  delete[] grid; grid = 0;
+  grid_w = grid_h = 0;
+}
+
+#if USE_XRANDR
+extern "C" {
+#include <X11/extensions/Xrandr.h>
+}
+static int xrandr_event_base = -1;
+#endif
+
+// The first time the monitors are asked for, ask to be told when they
+// change. The root window gets a ConfigureNotify when its size changes,
+// a PropertyNotify when the window manager changes the work area, and
+// XRandR reports monitors being plugged in or rearranged:
+static XWindow monitor_root;
+
+static void watch_monitors() {
+  if (monitor_root) return;
+  monitor_root = RootWindow(xdisplay, xscreen);
+  XSelectInput(xdisplay, monitor_root, StructureNotifyMask|PropertyChangeMask);
+#if USE_XRANDR
+  int error_base;
+  if (XRRQueryExtension(xdisplay, &xrandr_event_base, &error_base))
+    XRRSelectInput(xdisplay, monitor_root, RRScreenChangeNotifyMask);
+  else
+    xrandr_event_base = -1;
+#endif
+}
+
+// Called by fltk::handle() for events on the root window, returns
+// false for ones that are not about the monitors, such as tablet events:
+static bool handle_root_event() {
+#if USE_XRANDR
+  if (xrandr_event_base >= 0 &&
+      xevent.type == xrandr_event_base + RRScreenChangeNotify) {
+    XRRUpdateConfiguration(&xevent); // fixes DisplayWidth(), etc
+    monitors_changed();
+    return true;
+  }
+#endif
+  switch (xevent.type) {
+  case ConfigureNotify: {
+#if USE_XRANDR
+    if (xrandr_event_base >= 0) {XRRUpdateConfiguration(&xevent); break;}
+#endif
+    Screen* screen = ScreenOfDisplay(xdisplay, xscreen);
+    screen->width = xevent.xconfigure.width;
+    screen->height = xevent.xconfigure.height;
+    break;}
+  case PropertyNotify:
+    if (xevent.xproperty.atom != _NET_WORKAREA &&
+	xevent.xproperty.atom != _NET_CURRENT_DESKTOP) return true;
+    break;
+  default:
+    return false;
+  }
+  monitors_changed();
+  return true;
+}
+
 /*! Return an array of all Monitors.
     p is set to point to a static array of Monitor structures describing
     all monitors connected to the system. If there is a "primary" monitor,
     it will be first in the list.
 
-    Subsequent calls will usually
-    return the same array, but if a signal comes in indicating a change
-    it will probably delete the old array and return a new one.
+    Subsequent calls return the same array until fltk sees the
+    monitors change, either from an XRandR notification (if fltk was
+    compiled with it), a change to the size of the root window, or the
+    window manager changing the work area. Then the old array is
+    deleted and a new one is returned by the next call, so don't keep
+    the pointer across calls to fltk::wait().
 */
 int Monitor::list(const Monitor** p) {
   if (!num_monitors) {
     open_display();
+    TraceScope trace(TRACE_STARTUP, "Monitor::list");
 #if USE_XINERAMA
 # if XINERAMA_VERSION > 1
     XRectangle* rects = 0; int count = 0;
@@ -844,6 +1305,7 @@ int Monitor::list(const Monitor** p) {
 #if USE_XINERAMA
   DONE:;
 #endif
+    if (num_monitors > 1) build_grid();
 #if 0
     printf("Got %d monitors:\n", num_monitors);
     for (int i=0; i < num_monitors; i++) {
@@ -859,13 +1321,23 @@ int Monitor::list(const Monitor** p) {
 }
 
 /*! Return a pointer to a Monitor structure describing the monitor
-    that contains or is closest to the given x,y, position.
+    that contains or is closest to the given x,y, position. This is
+    a table lookup for points on a monitor, so it is fast enough to
+    call on every mouse movement.
 */
 const Monitor& Monitor::find(int x, int y) {
   const Monitor* monitors;
   int count = list(&monitors);
   const Monitor* ret = monitors+0;
   if (count > 1) {
+    x -= grid_x;
+    y -= grid_y;
+    if (x >= 0 && x < grid_w && y >= 0 && y < grid_h) {
+      int i = grid[grid_row[y]*grid_columns+grid_column[x]];
+      if (i >= 0) return monitors[i];
+    }
+    x += grid_x;
+    y += grid_y;
     int r = 0;
     for (int i = 0; i < count; i++) {
       const Monitor& m = monitors[i];
@@ -1123,6 +1595,92 @@ static int selection_length[2];
 static int selection_buffer_length[2];
 bool fl_i_own_selection[2];
 
+// Selections bigger than a request can hold are sent with the ICCCM
+// INCR protocol: the requestor deletes the property each time it has
+// read a piece and a PropertyNotify makes us write the next one.
+struct IncrTransfer {
+  XWindow requestor;
+  Atom property;
+  Atom target;
+  char* data;		// copy of the selection, so copy() can change it
+  int length;
+  int sent;
+  IncrTransfer* next;
+};
+static IncrTransfer* incr_transfers;
+
+// Pieces are no bigger than this, even if the server allows more:
+static int incr_chunk_size() {
+  long n = XExtendedMaxRequestSize(xdisplay);
+  if (!n) n = XMaxRequestSize(xdisplay);
+  n = n*4 - 100;
+  return n > 256*1024 ? 256*1024 : int(n);
+}
+
+static void incr_send(IncrTransfer* t) {
+  int n = t->length - t->sent;
+  if (n > incr_chunk_size()) n = incr_chunk_size();
+  // the last piece written is zero length, which ends the transfer:
+  XChangeProperty(xdisplay, t->requestor, t->property, t->target, 8,
+		  PropModeReplace, (unsigned char*)(t->data+t->sent), n);
+  t->sent += n;
+  if (n) return;
+  for (IncrTransfer** p = &incr_transfers; *p; p = &(*p)->next)
+    if (*p == t) {*p = t->next; break;}
+  XSelectInput(xdisplay, t->requestor, 0);
+  delete[] t->data;
+  delete t;
+}
+
+// Receiving an INCR selection:
+static XWindow incr_window;	// zero if not receiving one
+static Atom incr_property;
+static long incr_event_mask;	// incr_window's mask before we added ours
+static unsigned char* paste_buffer;
+static long paste_length;
+static bool paste_oversize; // paste_buffer was malloc'd rather than from Xlib
+
+static void free_paste_buffer() {
+  if (paste_buffer) {
+    if (paste_oversize) free(paste_buffer); else XFree(paste_buffer);
+  }
+  paste_buffer = 0;
+  paste_length = 0;
+  paste_oversize = false;
+}
+
+// Append a piece returned by XGetWindowProperty, taking ownership of it:
+static void paste_append(unsigned char* portion, long n, unsigned long more) {
+  if (paste_oversize) {
+    paste_buffer = (unsigned char*)realloc(paste_buffer, paste_length+n+more+1);
+    memcpy(paste_buffer+paste_length, portion, n);
+    XFree(portion);
+  } else if (paste_buffer) { // move the first section to a bigger buffer
+    unsigned char* b = (unsigned char*)malloc(paste_length+n+more+1);
+    memcpy(b, paste_buffer, paste_length);
+    memcpy(b+paste_length, portion, n);
+    XFree(paste_buffer);
+    XFree(portion);
+    paste_buffer = b;
+    paste_oversize = true;
+  } else {	// Use the first section without moving the memory:
+    paste_buffer = portion;
+  }
+  paste_length += n;
+}
+
+static void paste_deliver(Atom actual) {
+  if (paste_oversize) paste_buffer[paste_length] = 0;
+  e_text = paste_buffer ? (char*)paste_buffer : "";
+  e_length = paste_length;
+  if (actual == texturilist && strncmp(e_text, "file://", 7) == 0) {
+    // to be consistent with windows implementation
+    e_text += 7; // skip leading file://
+    e_length -= 9; // skip trailing CR+LF
+  }
+  if (selection_requestor) selection_requestor->handle(PASTE);
+}
+
 /*!
   Change the current selection. The block of text is copied to an
   internal buffer by FLTK (be careful if doing this in response to an
@@ -1214,6 +1772,8 @@ static unsigned recent_keycode;
 static void set_event_xy(bool push) {
 #if CONSOLIDATE_MOTION
   send_motion = 0;
+  // a pending motion is replaced by this event, so forget its history:
+  if (xevent.type != MotionNotify) fl_motion_history_count = 0;
 #endif
   e_x_root = xevent.xbutton.x_root;
   e_x = xevent.xbutton.x;
@@ -1260,6 +1820,20 @@ static void set_stylus_data() {
   }
 }
 
+// Where a top-level window is on the root window. XGetWindowAttributes
+// would be two round trips for the size, XGetGeometry is one:
+static void get_root_rectangle(XWindow xid, int& X, int& Y, int& W, int& H) {
+  XWindow root, junk; int x, y; unsigned w, h, border, depth;
+  XGetGeometry(xdisplay, xid, &root, &x, &y, &w, &h, &border, &depth);
+  XTranslateCoordinates(xdisplay, xid, root, 0, 0, &X, &Y, &junk);
+  W = w; H = h;
+}
+
+#if USE_CAIRO
+static bool use_client_drawing(const Window*);
+static void send_client_buffer(CreatedWindow*, const Rectangle&);
+#endif
+
 /**
   Make FLTK act as though it just got the event stored in #xevent.
   You can use this to feed artifical X events to it, or to use your
@@ -1275,6 +1849,8 @@ static void set_stylus_data() {
 */
 bool fltk::handle()
 {
+  if (xevent.xany.window == monitor_root && monitor_root &&
+      handle_root_event()) return true;
   Window* window = find(xevent.xany.window);
   int event = 0;
 
@@ -1437,18 +2013,44 @@ bool fltk::handle()
     if (!window) break;
     if (window->parent()) break; // ignore child windows
     if (xevent.xconfigure.window != xid(window)) break; // ignore frontbuffer
+    if (startup_report && xevent.type == MapNotify) {
+      startup_report = false;
+      trace(TRACE_STARTUP, "first window mapped", window, startup_begin);
+      write_startup_report(stderr);
+    }
     if (CreatedWindow::find(window)->wait_for_expose) {
       if (xevent.type == ConfigureNotify) break; // ignore icons and wm bugs
       CreatedWindow::find(window)->wait_for_expose = false;
     }
     //if (!xevent.xconfigure.send_event) break; // ignore non-wm messages
 
-    // figure out where Window Manager really put window:
-    XWindowAttributes actual;
-    XGetWindowAttributes(xdisplay, xid(window), &actual);
-    XWindow junk; int X, Y, W = actual.width, H = actual.height;
-    XTranslateCoordinates(xdisplay, xid(window), actual.root,
-			  0, 0, &X, &Y, &junk);
+    // During an interactive resize many of these may be queued. Only the
+    // latest size matters, so skip to the last one rather than doing the
+    // round trips below for every one:
+    if (xevent.type == ConfigureNotify)
+      while (XCheckTypedWindowEvent(xdisplay, xid(window), ConfigureNotify,
+				    &xevent)) {}
+
+    // figure out where Window Manager really put window. A
+    // ConfigureNotify has the size, and if the window manager sent it
+    // then also the position on the root; only a real one from the
+    // server needs a round trip to get the position:
+    int X, Y, W, H;
+    if (xevent.type == ConfigureNotify) {
+      W = xevent.xconfigure.width;
+      H = xevent.xconfigure.height;
+      if (xevent.xconfigure.send_event) {
+	X = xevent.xconfigure.x;
+	Y = xevent.xconfigure.y;
+      } else {
+	XWindow junk;
+	XTranslateCoordinates(xdisplay, xid(window),
+			      RootWindow(xdisplay, xscreen),
+			      0, 0, &X, &Y, &junk);
+      }
+    } else {
+      get_root_rectangle(xid(window), X, Y, W, H);
+    }
     Rectangle& current = CreatedWindow::find(window)->current_size;
     if (X != current.x() || Y != current.y() || W != current.w() || H != current.h()) {
       window->resize(X, Y, W, H);
@@ -1483,11 +2085,8 @@ bool fltk::handle()
       CreatedWindow::find(w)->wait_for_expose = false;
       if (!w->parent() && (w->x()==USEDEFAULT || w->y()==USEDEFAULT)) {
 	// figure out where Window Manager really put window:
-	XWindowAttributes actual;
-	XGetWindowAttributes(xdisplay, xid(w), &actual);
-	XWindow junk; int X, Y, W = actual.width, H = actual.height;
-	XTranslateCoordinates(xdisplay, xid(w), actual.root,
-			      0, 0, &X, &Y, &junk);
+	int X, Y, W, H;
+	get_root_rectangle(xid(w), X, Y, W, H);
 	CreatedWindow::find(w)->current_size.set(X,Y,W,H);
 	window->x(X); window->y(Y);
 	// Turn on the user-specified position hint so MetaCity won't move it!!
@@ -1498,7 +2097,28 @@ bool fltk::handle()
     }}
     // Inside of Xexpose event is exactly the same as Rectangle structure,
     // so we pass a pointer.
-    CreatedWindow::find(window)->expose(*(Rectangle*)(&xevent.xexpose.x));
+    {CreatedWindow* x = CreatedWindow::find(window);
+#if USE_CAIRO
+    // a window drawn into its client_buffer is just sent it again:
+    if (x->client_buffer && xevent.type == Expose &&
+	x->client_buffer->w() == window->w() &&
+	x->client_buffer->h() == window->h() && use_client_drawing(window)) {
+      send_client_buffer(x, *(Rectangle*)(&xevent.xexpose.x));
+      return true;
+    }
+#endif
+    x->expose(*(Rectangle*)(&xevent.xexpose.x));
+    // Add any following exposes of the same window to the same region
+    // now, rather than going around the event loop for each of them.
+    // GraphicsExpose has the same layout as Expose:
+    while (XQLength(xdisplay)) {
+      XEvent next;
+      XPeekEvent(xdisplay, &next);
+      if (next.type != xevent.type ||
+	  next.xexpose.window != xevent.xexpose.window) break;
+      XNextEvent(xdisplay, &next);
+      x->expose(*(Rectangle*)(&next.xexpose.x));
+    }}
     return true;
 
   case UnmapNotify:
@@ -1543,6 +2163,10 @@ bool fltk::handle()
     set_event_xy(false);
     set_stylus_data();
 #if CONSOLIDATE_MOTION
+    if (fl_keep_motion_history) {
+      if (window != xmousewin) fl_motion_history_count = 0;
+      fl_add_motion_sample(event_time);
+    }
     send_motion = xmousewin = window;
     in_a_window = true;
     return false;
@@ -1595,6 +2219,7 @@ bool fltk::handle()
 
   case FocusIn:
 #if USE_XIM
+    fl_init_xim();
     if (fl_xim_ic) {
       XSetICValues(fl_xim_ic,
 		   XNClientWindow, xevent.xclient.window,
@@ -1824,8 +2449,11 @@ bool fltk::handle()
 
   case SelectionNotify: {
     if (!selection_requestor) return false;
-    static unsigned char* buffer;
-    if (buffer) {XFree(buffer); buffer = 0;}
+    free_paste_buffer();
+    if (incr_window) { // abandon an unfinished INCR transfer
+      XSelectInput(xdisplay, incr_window, incr_event_mask);
+      incr_window = 0;
+    }
     long read = 0;
     if (xevent.xselection.property) for (;;) {
       // The Xdnd code pastes 64K chunks together, possibly to avoid
@@ -1871,26 +2499,23 @@ bool fltk::handle()
       printf("selection notify of type %s\n",x);
       XFree(x);
 #endif
-      if (read) { // append to the accumulated buffer
-	buffer = (unsigned char*)realloc(buffer, read+count*format/8+remaining);
-	memcpy(buffer+read, portion, count*format/8);
+      if (actual == INCR) {
+	// Reading the property deleted it, which tells the owner to
+	// start. Each piece arrives as a PropertyNotify:
 	XFree(portion);
-      } else {	// Use the first section without moving the memory:
-	buffer = portion;
+	incr_window = xevent.xselection.requestor;
+	incr_property = xevent.xselection.property;
+	XWindowAttributes attr;
+	XGetWindowAttributes(xdisplay, incr_window, &attr);
+	incr_event_mask = attr.your_event_mask;
+	XSelectInput(xdisplay, incr_window, incr_event_mask|PropertyChangeMask);
+	return true;
       }
+      paste_append(portion, count*format/8, remaining);
       read += count*format/8;
 
       if (!remaining) {
-        e_text = buffer ? (char*)buffer : "";
-        e_length = read;
-
-        if (actual == texturilist && strncmp(e_text, "file://", 7) == 0) {
-          // to be consistent with windows implementation
-          e_text += 7; // skip leading file://
-          e_length -= 9; // skip trailing CR+LF
-        }
-
-        selection_requestor->handle(PASTE);
+	paste_deliver(actual);
         break; // exit for(;;)
       }
     }
@@ -1912,6 +2537,34 @@ bool fltk::handle()
     fl_i_own_selection[clipboard] = false;
     return true;}
 
+  case PropertyNotify: {
+    const XPropertyEvent& p = xevent.xproperty;
+    if (p.state == PropertyNewValue && p.window == incr_window &&
+	p.atom == incr_property) {
+      // the next piece of an INCR selection we are receiving:
+      Atom actual; int format; unsigned long count, remaining;
+      unsigned char* portion;
+      if (XGetWindowProperty(xdisplay, p.window, p.atom, 0, 0x1fffffff, 1, 0,
+			     &actual, &format, &count, &remaining, &portion))
+	return true;
+      long n = count*format/8;
+      if (n) {paste_append(portion, n, 0); return true;}
+      XFree(portion);
+      XSelectInput(xdisplay, incr_window, incr_event_mask);
+      incr_window = 0;
+      paste_deliver(actual);
+      return true;
+    }
+    if (p.state == PropertyDelete) {
+      // the requestor read the last piece of an INCR selection we sent:
+      for (IncrTransfer* t = incr_transfers; t; t = t->next)
+	if (t->requestor == p.window && t->property == p.atom) {
+	  incr_send(t);
+	  return true;
+	}
+    }
+    break;}
+
   case SelectionRequest: {
     XSelectionEvent e;
     e.type = SelectionNotify;
@@ -1941,10 +2594,28 @@ bool fltk::handle()
       // behave that insist on asking for XA_TEXT instead of UTF8_STRING
       // Does not change XA_STRING as that breaks xclipboard.
       if (e.target != XA_STRING) e.target = UTF8_STRING;
-      XChangeProperty(xdisplay, e.requestor, e.property,
-		      e.target, 8, 0,
-		      (unsigned char *)selection_buffer[clipboard],
-		      selection_length[clipboard]);
+      int length = selection_length[clipboard];
+      if (length > incr_chunk_size()) {
+	IncrTransfer* t = new IncrTransfer;
+	t->requestor = e.requestor;
+	t->property = e.property;
+	t->target = e.target;
+	t->data = new char[length];
+	memcpy(t->data, selection_buffer[clipboard], length);
+	t->length = length;
+	t->sent = 0;
+	t->next = incr_transfers;
+	incr_transfers = t;
+	XSelectInput(xdisplay, e.requestor, PropertyChangeMask);
+	long size = length;
+	XChangeProperty(xdisplay, e.requestor, e.property,
+			INCR, 32, 0, (unsigned char*)&size, 1);
+      } else {
+	XChangeProperty(xdisplay, e.requestor, e.property,
+			e.target, 8, 0,
+			(unsigned char *)selection_buffer[clipboard],
+			length);
+      }
     } else {
       e.property = 0;
     }
@@ -2044,7 +2715,10 @@ void CreatedWindow::create(Window* window,
   XSetWindowAttributes attr;
   attr.border_pixel = 0;
   attr.colormap = colormap;
-  attr.bit_gravity = 0; // StaticGravity;
+  // Keep the old contents when resized, so the window shows the last
+  // picture until the new size is drawn (see resize_throttle()), rather
+  // than being erased:
+  attr.bit_gravity = NorthWestGravity;
   int mask = CWBorderPixel|CWColormap|CWEventMask|CWBitGravity;
 
   int W = window->w();
@@ -2206,9 +2880,6 @@ void CreatedWindow::create(Window* window,
       // warning: this code assumes sizeof(unsigned)==4!
       unsigned* data = (unsigned*)(window->icon());
       unsigned size = data[0]*data[1]+2;
-      static Atom _NET_WM_ICON = 0;
-      if (!_NET_WM_ICON) _NET_WM_ICON =
-			   XInternAtom(xdisplay, "_NET_WM_ICON", 0);
       XChangeProperty(xdisplay, x->xid, _NET_WM_ICON,
 		      XA_CARDINAL, 32, PropModeReplace,
 		      (uchar*)data, size);
@@ -2225,6 +2896,7 @@ CreatedWindow* CreatedWindow::set_xid(Window* window, XWindow winxid) {
   CreatedWindow* x = new CreatedWindow;
   x->xid = winxid;
   x->backbuffer = 0;
+  x->backbuffer_w = x->backbuffer_h = 0;
   x->frontbuffer = 0;
   x->overlay = false;
   x->window = window; window->i = x;
@@ -2232,6 +2904,7 @@ CreatedWindow* CreatedWindow::set_xid(Window* window, XWindow winxid) {
   x->wait_for_expose = false;
   x->cursor = None;
   x->cursor_for = 0;
+  x->client_buffer = 0;
   x->next = CreatedWindow::first;
   CreatedWindow::first = x;
   return x;
@@ -2374,7 +3047,7 @@ GC fltk::gc;
 
 #if USE_CAIRO
 cairo_t* fltk::cr;
-static cairo_surface_t* surface;
+static cairo_surface_t* surface; // the xlib surface for xwindow
 #endif
 
 #if USE_XFT
@@ -2434,7 +3107,14 @@ cairo_surface_t* fltk::cairo_create_surface(Window* wi) {
   fltk::stop_drawing() so that it can destroy any temporary structures
   that were created by this.
 */
+#if USE_XFT && !USE_CAIRO
+extern void fl_flush_trapezoids(); // in path.cxx
+#endif
+
 void fltk::draw_into(XWindow window, int w, int h) {
+#if USE_XFT && !USE_CAIRO
+  fl_flush_trapezoids(); // they are drawn into the old xwindow
+#endif
   fl_current_Image = 0;
   fl_clip_w = w;
   fl_clip_h = h;
@@ -2448,6 +3128,11 @@ void fltk::draw_into(XWindow window, int w, int h) {
       cairo_surface_destroy(surface); surface = 0;
       xwindow = 0;
     }
+    // it may be drawing into an Image, see fl_draw_into_surface():
+    if (cr && cairo_get_target(cr) != surface) {
+      cairo_destroy(cr); cr = 0;
+      xwindow = 0;
+    }
   }
 #endif
 
@@ -2467,10 +3152,12 @@ void fltk::draw_into(XWindow window, int w, int h) {
 #endif
 
 #if USE_CAIRO
-    if (cr) {
+    if (surface) {
       cairo_xlib_surface_set_drawable(surface, window, w, h);
     } else {
       surface = cairo_xlib_surface_create(xdisplay, window, xvisual->visual, w, h);
+    }
+    if (!cr) {
       cr = cairo_create(surface);
       // emulate line_style(0):
       cairo_set_line_width(cr, 1);
@@ -2486,6 +3173,23 @@ void fltk::draw_into(XWindow window, int w, int h) {
   load_identity();
 }
 
+#if USE_CAIRO
+// Make the fltk drawing functions draw with Cairo into a surface in
+// this program's memory, for Image::make_current(). xwindow is zero
+// while this is done, so nothing is sent to the X server:
+void fl_draw_into_surface(cairo_surface_t* target, int w, int h) {
+  fl_current_Image = 0;
+  fl_clip_w = w;
+  fl_clip_h = h;
+  xwindow = 0;
+  if (cr) cairo_destroy(cr);
+  cr = cairo_create(target);
+  // emulate line_style(0):
+  cairo_set_line_width(cr, 1);
+  load_identity();
+}
+#endif
+
 /**
   Destroy any "graphics context" structures that point at this window
   or Pixmap. They will be recreated if you call draw_into() again.
@@ -2496,6 +3200,9 @@ void fltk::draw_into(XWindow window, int w, int h) {
 */
 void fltk::stop_drawing(XWindow window) {
   if (xwindow == window) {
+#if USE_XFT && !USE_CAIRO
+    fl_flush_trapezoids();
+#endif
     xwindow = 0;
 #if USE_CAIRO
     cairo_destroy(cr); cr = 0;
@@ -2536,6 +3243,175 @@ static bool can_xdbe() {
   return use_xdbe;
 }
 
+// While fltk::flush() draws all the windows their swaps are saved here
+// and done in one request, so all the windows change at the same time:
+static bool defer_swaps = false;
+static XdbeSwapInfo* deferred_swaps = 0;
+static int num_deferred_swaps = 0;
+static int deferred_swaps_size = 0;
+
+static void swap_buffers(XWindow frontbuffer) {
+  XdbeSwapInfo s;
+  s.swap_window = frontbuffer;
+  s.swap_action = XdbeUndefined;
+  if (!defer_swaps) {XdbeSwapBuffers(xdisplay, &s, 1); return;}
+  if (num_deferred_swaps >= deferred_swaps_size) {
+    deferred_swaps_size = 2*deferred_swaps_size+4;
+    deferred_swaps = (XdbeSwapInfo*)
+      realloc(deferred_swaps, deferred_swaps_size*sizeof(XdbeSwapInfo));
+  }
+  deferred_swaps[num_deferred_swaps++] = s;
+}
+
+#endif
+
+// Called by fltk::flush() around the loop drawing the windows, and
+// by anything that must draw on the front buffer in the middle of it:
+void fl_defer_swaps(bool defer) {
+#if USE_XDBE
+  if (num_deferred_swaps) {
+    XdbeSwapBuffers(xdisplay, deferred_swaps, num_deferred_swaps);
+    num_deferred_swaps = 0;
+  }
+  defer_swaps = defer;
+#endif
+}
+
+// Pixmaps used as back buffers are kept when a window is destroyed or
+// resized, and reused by the next window that fits in one, so popup
+// menus, tooltips, and resizing a window don't make a new one each
+// time. A pixmap is only reused if it is less than twice the area
+// needed, and the oldest is freed if there are more than POOL_SIZE.
+enum {POOL_SIZE = 4};
+static struct {Pixmap pixmap; int w, h;} pixmap_pool[POOL_SIZE];
+static int pool_count;
+
+static Pixmap get_backbuffer(XWindow frontbuffer, int w, int h, int& bw, int& bh) {
+  if (w < 1) w = 1;
+  if (h < 1) h = 1;
+  int best = -1;
+  for (int n = 0; n < pool_count; n++) {
+    long area = long(pixmap_pool[n].w)*pixmap_pool[n].h;
+    if (pixmap_pool[n].w >= w && pixmap_pool[n].h >= h && area <= 2L*w*h &&
+	(best < 0 || area < long(pixmap_pool[best].w)*pixmap_pool[best].h))
+      best = n;
+  }
+  if (best < 0) {
+    bw = w; bh = h;
+    return XCreatePixmap(xdisplay, frontbuffer, w, h, xvisual->depth);
+  }
+  Pixmap p = pixmap_pool[best].pixmap;
+  bw = pixmap_pool[best].w;
+  bh = pixmap_pool[best].h;
+  pool_count--;
+  memmove(pixmap_pool+best, pixmap_pool+best+1, (pool_count-best)*sizeof(*pixmap_pool));
+  return p;
+}
+
+static void release_backbuffer(Pixmap p, int w, int h) {
+  if (pool_count == POOL_SIZE) {
+    XFreePixmap(xdisplay, pixmap_pool[0].pixmap);
+    pool_count--;
+    memmove(pixmap_pool, pixmap_pool+1, pool_count*sizeof(*pixmap_pool));
+  }
+  pixmap_pool[pool_count].pixmap = p;
+  pixmap_pool[pool_count].w = w;
+  pixmap_pool[pool_count].h = h;
+  pool_count++;
+}
+
+static unsigned long pixmap_bytes(long w, long h, int depth) {
+  return w*h*(depth > 16 ? 4 : depth > 8 ? 2 : 1);
+}
+
+// For memory_report(), the back buffers of windows and the pool:
+void fl_backbuffer_memory(unsigned long& count, unsigned long& bytes) {
+  count = pool_count;
+  bytes = 0;
+  if (!xvisual) return;
+  for (int n = 0; n < pool_count; n++)
+    bytes += pixmap_bytes(pixmap_pool[n].w, pixmap_pool[n].h, xvisual->depth);
+  for (CreatedWindow* x = CreatedWindow::first; x; x = x->next) {
+    if (!x->backbuffer) continue;
+    count++;
+    if (x->backbuffer_w) // else it is an Xdbe buffer the size of the window
+      bytes += pixmap_bytes(x->backbuffer_w, x->backbuffer_h, xvisual->depth);
+    else if (x->window)
+      bytes += pixmap_bytes(x->window->w(), x->window->h(), xvisual->depth);
+  }
+}
+
+#if USE_CAIRO
+// Windows with AUTO_DRAWING use CLIENT_DRAWING if a round trip to the
+// server takes longer than this many seconds:
+#define CLIENT_LATENCY .003
+
+static bool use_client_drawing(const Window* window) {
+  switch (window->client_drawing()) {
+  case Window::CLIENT_DRAWING: return true;
+  case Window::AUTO_DRAWING: return display_latency() > CLIENT_LATENCY;
+  default: return false;
+  }
+}
+
+// Copy part of the client_buffer to the window, as one image:
+static void send_client_buffer(CreatedWindow* i, const Rectangle& r) {
+  Image* image = i->client_buffer;
+  Rectangle a(r);
+  a.intersect(Rectangle(image->w(), image->h()));
+  if (a.empty()) return;
+  draw_into(i->frontbuffer ? i->frontbuffer : i->xid, image->w(), image->h());
+  image->draw(a, a);
+}
+
+// Window::flush() for a double_buffer() window with client_drawing().
+// It is drawn with Cairo into an Image in this program's memory, and
+// only the area that changed is sent to the window:
+static void flush_client_buffer(Window* window, CreatedWindow* i,
+				unsigned char damage) {
+  int w = window->w();
+  int h = window->h();
+  Image*& image = i->client_buffer;
+  if (!image || image->w() != w || image->h() != h) {
+    delete image;
+    image = new Image(RGB32, w, h);
+    damage = DAMAGE_ALL;
+  }
+  Rectangle changed(0, 0, 0, 0);
+  if (damage & DAMAGE_ALL) {
+    image->make_current();
+    window->set_damage(DAMAGE_ALL);
+    window->draw();
+    changed.set(0, 0, w, h);
+  } else {
+    if (damage & ~DAMAGE_EXPOSE) {
+      image->make_current();
+      // if only children changed just their rectangles are sent:
+      DamageRects rects;
+      bool use_rects = (damage & ~DAMAGE_EXPOSE) == DAMAGE_CHILD;
+      DamageRects* saved = fl_damage_rects;
+      if (use_rects) fl_damage_rects = &rects;
+      window->set_damage(damage & ~DAMAGE_EXPOSE);
+      window->draw();
+      fl_damage_rects = saved;
+      if (!use_rects) changed.set(0, 0, w, h);
+      else for (int n = 0; n < rects.n; n++) changed.merge(rects.rect[n]);
+    }
+    // redraw(rectangle) will cause this to be executed:
+    if (i->region) {
+      XRectangle b;
+      XClipBox(i->region, &b);
+      changed.merge(Rectangle(b.x, b.y, b.width, b.height));
+      image->make_current();
+      clip_region(i->region); i->region = 0;
+      window->set_damage(DAMAGE_EXPOSE);
+      window->draw();
+      clip_region(0);
+    }
+  }
+  if (i->region) {XDestroyRegion(i->region); i->region = 0;}
+  send_client_buffer(i, changed);
+}
 #endif
 
 /**
@@ -2560,6 +3436,13 @@ void Window::flush() {
 
   if (this->double_buffer() || i->overlay) {  // double-buffer drawing
 
+#if USE_CAIRO
+    if (!i->overlay && !(damage & DAMAGE_OVERLAY) && use_client_drawing(this)) {
+      flush_client_buffer(this, i, damage);
+      return;
+    }
+#endif
+
     bool eraseoverlay = i->overlay || (damage&DAMAGE_OVERLAY);
     if (eraseoverlay) damage &= ~DAMAGE_OVERLAY;
 
@@ -2591,8 +3474,8 @@ void Window::flush() {
 	  XdbeAllocateBackBufferName(xdisplay, frontbuffer, XdbeUndefined);
       } else
 #endif
-	i->backbuffer =
-	  XCreatePixmap(xdisplay, frontbuffer, w(), h(), xvisual->depth);
+	i->backbuffer = get_backbuffer(frontbuffer, w(), h(),
+				       i->backbuffer_w, i->backbuffer_h);
       set_damage(DAMAGE_ALL); damage = DAMAGE_ALL;
       i->backbuffer_bad = false;
     } else if (i->backbuffer_bad) {
@@ -2601,6 +3484,12 @@ void Window::flush() {
       i->backbuffer_bad = false;
     }
 
+    // If only children changed, remember their rectangles so only
+    // they are copied to the front:
+    DamageRects rects;
+    bool use_rects = sparse_update() && !eraseoverlay &&
+      (damage & ~DAMAGE_EXPOSE) == DAMAGE_CHILD;
+
     // draw the back buffer if it needs anything:
     if (damage) {
       // set the graphics context to draw into back buffer:
@@ -2610,24 +3499,28 @@ void Window::flush() {
       } else {
 	// draw all the changed widgets:
 	if (damage & ~DAMAGE_EXPOSE) {
+	  DamageRects* saved = fl_damage_rects;
+	  if (use_rects) fl_damage_rects = &rects;
 	  set_damage(damage & ~DAMAGE_EXPOSE);
 	  draw();
+	  fl_damage_rects = saved;
 	}
 	// redraw(rectangle) will cause this to be executed:
 	if (i->region) {
 	  clip_region(i->region); i->region = 0;
 	  set_damage(DAMAGE_EXPOSE); draw();
 	  // keep the clip for the back->front copy if no other damage:
-	  if ((damage & ~DAMAGE_EXPOSE) || eraseoverlay) clip_region(0);
+	  if (((damage & ~DAMAGE_EXPOSE) && !use_rects) || eraseoverlay)
+	    clip_region(0);
 	}
       }
 #if USE_XDBE
       // use the faster Xdbe swap command for all normal redraw():
-      if (use_xdbe && !eraseoverlay && (damage&~DAMAGE_EXPOSE)) {
-	XdbeSwapInfo s;
-	s.swap_window = frontbuffer;
-	s.swap_action = XdbeUndefined;
-	XdbeSwapBuffers(xdisplay, &s, 1);
+      if (use_xdbe && !eraseoverlay && (damage&~DAMAGE_EXPOSE) && !use_rects) {
+#if USE_XFT && !USE_CAIRO
+	fl_flush_trapezoids();
+#endif
+	swap_buffers(frontbuffer);
 	// XDBE documentation claims back buffer is trashed, but I have
 	// not seen this:
 	// i->backbuffer_bad = true;
@@ -2635,6 +3528,18 @@ void Window::flush() {
       }
 #endif
       draw_into(frontbuffer, w(), h());
+      if (use_rects) {
+	// add the redrawn children to any expose region and clip to that:
+	Region r = XCreateRegion();
+	for (int n = 0; n < rects.n; n++) {
+	  XRectangle R;
+	  R.x = rects.rect[n].x(); R.y = rects.rect[n].y();
+	  R.width = rects.rect[n].w(); R.height = rects.rect[n].h();
+	  XUnionRectWithRegion(&R, r, r);
+	}
+	if (clip_region()) XUnionRegion(r, clip_region(), r);
+	clip_region(r);
+      }
     } else {
       // if damage is zero then expose events were done, just copy
       // the back buffer to the front:
@@ -2648,9 +3553,9 @@ void Window::flush() {
     // On Irix, at least, it is much slower unless you cut the rectangle
     // down to the clipped area. Seems to be a pretty bad implementation:
     Rectangle r(w(),h());
-    intersect_with_clip(r);
-    XCopyArea(xdisplay, i->backbuffer, frontbuffer, gc,
-	      r.x(), r.y(), r.w(), r.h(), r.x(), r.y());
+    if (intersect_with_clip(r))
+      XCopyArea(xdisplay, i->backbuffer, frontbuffer, gc,
+		r.x(), r.y(), r.w(), r.h(), r.x(), r.y());
     if (i->overlay) draw_overlay();
     clip_region(0);
 
@@ -2673,14 +3578,18 @@ void Window::flush() {
 }
 
 /*! Get rid of extra storage created by drawing when double_buffer() was
-  turned on. */
+  turned on. On X the last few back buffers are kept and reused by
+  other windows of about the same size. */
 void Window::free_backbuffer() {
-  if (!i || !i->backbuffer) return;
+  if (!i) return;
+  delete i->client_buffer;
+  i->client_buffer = 0;
+  if (!i->backbuffer) return;
   stop_drawing(i->backbuffer);
 #if USE_XDBE
   if (use_xdbe) return;
 #endif
-  XFreePixmap(xdisplay, i->backbuffer);
+  release_backbuffer(i->backbuffer, i->backbuffer_w, i->backbuffer_h);
   i->backbuffer = 0;
 }
 
@@ -2788,7 +3697,16 @@ void Window::system_layout() {
 	}
       } else
 #endif
-	free_backbuffer();
+      if (i->backbuffer) {
+	// keep the pixmap if the window still fits and uses most of it:
+	if (w > i->backbuffer_w || h > i->backbuffer_h ||
+	    2L*w*h < long(i->backbuffer_w)*i->backbuffer_h) {
+	  free_backbuffer();
+	} else {
+	  stop_drawing(i->backbuffer);
+	  i->backbuffer_bad = true;
+	}
+      }
     }
   }
 }
@@ -244,15 +244,34 @@ XColorMap& fl_xmap(uchar index, uchar r, uchar g, uchar b)
 
 ulong fltk::current_xpixel;
 
+#if USE_XFT
+// Used by fillpath(), other drawing ignores it:
+float fl_current_alpha = 1;
+extern void fl_flush_trapezoids(); // in path.cxx
+#endif
+
 void fltk::setcolor(Color i) {
+#if USE_XFT
+  fl_flush_trapezoids();
+  fl_current_alpha = 1;
+#endif
   current_color_ = i;
   current_xpixel = xpixel(i);
   XSetForeground(xdisplay, gc, current_xpixel);
 }
 
-// alpha color is not implemented on X
+// Only fillpath() blends with the alpha, using XRender. Repeating the
+// same color and alpha keeps the fills batched, see path.cxx:
 void fltk::setcolor_alpha(Color color, float alpha) {
+#if USE_XFT
+  if (alpha < 0) alpha = 0; else if (alpha > 1) alpha = 1;
+  if (alpha < 1 && alpha == fl_current_alpha && color == current_color_)
+    return;
   setcolor(color);
+  fl_current_alpha = alpha;
+#else
+  setcolor(color);
+#endif
 }
 
 #if USE_COLORMAP || USE_OVERLAY || USE_GL_OVERLAY
@@ -321,7 +340,24 @@ void fltk::line_style(int style, float width, const char* dashes) {
     }
     ndashes = p-buf;
   }
-  if (ndashes) XSetDashes(xdisplay, gc, 0, dashes, ndashes);
+  if (ndashes) {
+    // Xlib caches the other gc values and only sends changed ones, but
+    // XSetDashes is sent every time, so remember the last pattern:
+    static GC dashes_gc;
+    static char gc_dashes[16];
+    static int gc_ndashes;
+    if (gc != dashes_gc || ndashes != gc_ndashes ||
+	memcmp(dashes, gc_dashes, ndashes)) {
+      XSetDashes(xdisplay, gc, 0, dashes, ndashes);
+      if (ndashes <= int(sizeof(gc_dashes))) {
+	dashes_gc = gc;
+	gc_ndashes = ndashes;
+	memcpy(gc_dashes, dashes, ndashes);
+      } else {
+	dashes_gc = 0;
+      }
+    }
+  }
   static int Cap[4] = {CapButt, CapButt, CapRound, CapProjecting};
   static int Join[4] = {JoinMiter, JoinMiter, JoinRound, JoinBevel};
   XSetLineAttributes(xdisplay, gc, int(width+.5),
@@ -50,62 +50,96 @@ static xpmImage image_name(image_name_xpm);
 #include <config.h>
 using namespace fltk;
 
-bool xpmImage::fetch() {
-  return fetch(*this, data);
+// The colors of an xpm, indexed by the first character of each pixel,
+// or for 2 characters per pixel by the first and then the second:
+struct XpmColors {
+  const char* const* array; // what this was made from, if it is cached
+  int rows;		// lines of the array before the pixels
+  bool monochrome;
+  bool transparent;
+  U32 colors[256];	// ARGB32 colors
+  U32* byte1[256];	// prefix for 2-byte xpm
+};
+
+static void free_colors(XpmColors* m) {
+  for (int c=0; c<256; c++) delete[] m->byte1[c];
+  delete m;
 }
 
-bool xpmImage::fetch(Image& i, const char * const * array) {
-  int n, ncolors, chars_per_pixel, width, height;
+static inline int hexdigit(uchar c) {
+  if (c >= '0' && c <= '9') return c-'0';
+  if (c >= 'a' && c <= 'f') return c-'a'+10;
+  if (c >= 'A' && c <= 'F') return c-'A'+10;
+  return -1;
+}
 
+// Almost every xpm uses "#rrggbb" or "None", do those here rather
+// than with fltk::color(), which may ask the X server:
+static Color xpm_color(const uchar* p, int n) {
+  if (n == 7 && p[0] == '#') {
+    U32 v = 0;
+    int i;
+    for (i = 1; i < 7; i++) {
+      int d = hexdigit(p[i]);
+      if (d < 0) break;
+      v = (v<<4)|d;
+    }
+    if (i == 7) return v ? Color(v<<8) : BLACK;
+  }
+  if (n == 4 && !strncasecmp((const char*)p, "none", 4)) return NO_COLOR;
+  char buf[30];
+  if (n > 29) n = 29;
+  memcpy(buf, p, n);
+  buf[n] = 0;
+  return color(buf);
+}
+
+// Parse the colormap of an xpm, return null if it is bad:
+static XpmColors* parse_colors(const char* const* array) {
+  int n, ncolors, chars_per_pixel, width, height;
   n = sscanf(array[0], "%d %d %d %d", &width, &height, &ncolors, &chars_per_pixel);
-  if (n < 4 || (chars_per_pixel != 1 && chars_per_pixel != 2)) return false;
-  i.setsize(width, height);
-  if (width <= 0 || height <= 0) return false;
+  if (n < 4 || (chars_per_pixel != 1 && chars_per_pixel != 2)) return 0;
 
+  XpmColors* m = new XpmColors;
+  memset(m, 0, sizeof(XpmColors));
   // note that this array is unsigned char and skips the first line:
   const uchar*const* data = (const uchar*const*)(array+1);
-  bool monochrome = true;
-  bool transparent = false;
-
-  U32 colors[256]; // ARGB32 colors
-  U32* byte1[256]; // prefix for 2-byte xpm
+  m->monochrome = true;
 
   if (ncolors < 0) {	// fltk (non standard) compressed colormap
     ncolors = -ncolors;
-    chars_per_pixel = 1;
     const uchar *p = *data++;
     // if first color is ' ' it is transparent (put it later to make
     // it not be transparent):
     if (p[0] == ' ') {
-      colors[32] = 0;
+      m->colors[32] = 0;
       ncolors--;
-      monochrome = false;
-      transparent = true;
+      m->monochrome = false;
+      m->transparent = true;
       p += 4;
     }
     // read all the rest of the colors:
     for (int i=0; i < ncolors; i++) {
-      if (p[1]!=p[2] || p[1]!=p[3]) monochrome = false;
-      colors[p[0]] = 0xff000000 | (p[1]<<16) | (p[2]<<8) | (p[3]);
+      if (p[1]!=p[2] || p[1]!=p[3]) m->monochrome = false;
+      m->colors[p[0]] = 0xff000000 | (p[1]<<16) | (p[2]<<8) | (p[3]);
       p += 4;
     }
   } else {	// normal XPM colormap with names
-    if (chars_per_pixel>1) {
-      memset(byte1, 0, sizeof(byte1));
-      monochrome = false;
-    }
+    if (chars_per_pixel>1) m->monochrome = false;
     for (int i=0; i<ncolors; i++) {
       const uchar* p = *data++;
       // the first 1 or 2 characters are the color index:
       int index = *p++;
       U32* c; // where to store color
       if (chars_per_pixel>1) {
-	U32* subcolors = byte1[index];
-	if (!subcolors) subcolors = byte1[index] = new U32[256];
-        c = subcolors+*p;
-	index = (index<<8)+*p++;
+	U32* subcolors = m->byte1[index];
+	if (!subcolors) {
+	  subcolors = m->byte1[index] = new U32[256];
+	  memset(subcolors, 0, 256*sizeof(U32));
+	}
+        c = subcolors+*p++;
       } else {
-	c = colors+index;
+	c = m->colors+index;
       }
       // look for "c word", or last word if none:
       const uchar *previous_word = p;
@@ -118,29 +152,53 @@ bool xpmImage::fetch(Image& i, const char * const * array) {
 	while (*p && !isspace(*p)) p++;
 	if (what == 'c') break;
       }
-      Color C;
-      if (*p) {
-	char buf[30];
-	if (p-previous_word > 29) p = previous_word+29;
-	memcpy(buf, previous_word, p-previous_word);
-	buf[p-previous_word] = 0;
-	C = color(buf);
-      } else {
-	C = color((const char*)previous_word);
-      }
+      if (!*p) p = previous_word+strlen((const char*)previous_word);
+      Color C = xpm_color(previous_word, int(p-previous_word));
       if (C) {
         *c = 0xff000000 | (C>>8); // convert fltk color to ARGB32
         // test to see if rgb are different from each other:
-        if ((((C>>16)^C)|((C>>8)^C)) & 0xff00) monochrome=false;
+        if ((((C>>16)^C)|((C>>8)^C)) & 0xff00) m->monochrome=false;
       } else { // assume "None" or "#transparent" for any errors
         *c = 0;
-	monochrome = false;
-        transparent = true;
+	m->monochrome = false;
+        m->transparent = true;
       }
     }
   }
+  m->rows = int(data-(const uchar*const*)array);
+  return m;
+}
+
+// The colormaps of the last few xpmImage arrays, so several images
+// made from the same data, or one that is fetched again, only parse
+// it once:
+enum {CACHE_SIZE = 16};
+static XpmColors* color_cache[CACHE_SIZE];
+static int color_cache_next;
+
+static XpmColors* cached_colors(const char* const* array) {
+  int i;
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (color_cache[i] && color_cache[i]->array == array) return color_cache[i];
+  XpmColors* m = parse_colors(array);
+  if (!m) return 0;
+  m->array = array;
+  i = color_cache_next;
+  color_cache_next = (i+1)%CACHE_SIZE;
+  if (color_cache[i]) free_colors(color_cache[i]);
+  color_cache[i] = m;
+  return m;
+}
+
+static bool decode(Image& i, const char* const* array, const XpmColors* m) {
+  int width, height, ncolors, chars_per_pixel = 1;
+  sscanf(array[0], "%d %d %d %d", &width, &height, &ncolors, &chars_per_pixel);
+  i.setsize(width, height);
+  if (width <= 0 || height <= 0) return false;
+  const uchar*const* data = (const uchar*const*)(array+m->rows);
+  const U32* colors = m->colors;
 
-  if (monochrome) {
+  if (m->monochrome) {
     i.setpixeltype(MASK);
     for (int y=0; y<height; y++) {
       uchar* linebuf = i.linebuffer(y);
@@ -149,8 +207,8 @@ bool xpmImage::fetch(Image& i, const char * const * array) {
       i.setpixels(linebuf,y);
     }
   } else {
-    i.setpixeltype(transparent ? ARGB32 : RGB32);
-    if (chars_per_pixel==1) {
+    i.setpixeltype(m->transparent ? ARGB32 : RGB32);
+    if (chars_per_pixel==1 || ncolors < 0) {
       for (int y=0; y<height; y++) {
         U32* linebuf = (U32*)i.linebuffer(y);
         const uchar* p = data[y];
@@ -163,18 +221,33 @@ bool xpmImage::fetch(Image& i, const char * const * array) {
         U32* linebuf = (U32*)i.linebuffer(y);
         const uchar* p = data[y];
         for (int x=0; x<width; x++) {
-          U32* subcolors = byte1[*p++];
+          const U32* subcolors = m->byte1[*p++];
           linebuf[x] = subcolors ? subcolors[*p] : 0;
           p++;
         }
         i.setpixels((uchar*)linebuf,y);
       }
-      for (int c=0; c<256; c++) delete[] byte1[c];
     }
   }
   return true;
 }
 
+bool xpmImage::fetch() {
+  XpmColors* m = cached_colors(data);
+  if (!m) return false;
+  return decode(*this, data, m);
+}
+
+/*! Decode \a array into \a i. This does not use the cache that
+  fetch() does, as \a array may be temporary. */
+bool xpmImage::fetch(Image& i, const char * const * array) {
+  XpmColors* m = parse_colors(array);
+  if (!m) return false;
+  bool ret = decode(i, array, m);
+  free_colors(m);
+  return ret;
+}
+
 //
 // End of "$Id$".
 //
@@ -0,0 +1,267 @@
+// Benchmark of Browser and Menu with very many items. Each form of
+// item list is built with 10^4, 10^5 and 10^6 items (or -n counts) and
+// the common operations are timed. Prints one line per operation,
+// tab-separated so results can be compared by a script:
+//
+//	form	items	op	count	seconds	us/op
+//
+// Forms:
+//   items    Item widgets made by Menu::add()
+//   strings  a StringArray list()
+//   list     a custom List making recycled widgets with a WidgetPool
+//   menu     a PopupMenu with Item widgets
+//   tree     Item widgets in one open ItemGroup, after a few other items
+//
+// Operations:
+//   build    making the items (and the strings for the array)
+//   layout   the first Browser::layout(), which measures the items
+//   bottom   scrolling to the last item
+//   goto     goto_index() of scattered items
+//   prefix   find_prefix() as type-ahead does, for items near the end
+//   draw     drawing the Browser into an offscreen Image
+//   toggle   closing and opening the ItemGroup of the tree form
+//
+// Usage: browserbench [-n items]... [form...]
+// "make browser-bench" runs all of them. This needs a display for the
+// fonts, but nothing is shown on it (Xvfb works).
+
+#include <fltk/run.h>
+#include <fltk/Browser.h>
+#include <fltk/PopupMenu.h>
+#include <fltk/Item.h>
+#include <fltk/ItemGroup.h>
+#include <fltk/StringList.h>
+#include <fltk/WidgetPool.h>
+#include <fltk/Image.h>
+#include <fltk/draw.h>
+#include <fltk/damage.h>
+#include <fltk/trace.h>
+#include <fltk/x.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+enum {W = 300, H = 400, GOTOS = 1000, PREFIXES = 20, DRAWS = 50, TOGGLES = 100};
+
+static const char* form_name;
+static int items;
+static double start;
+
+static void begin() {start = trace_time();}
+
+static void end(const char* op, int count) {
+  double t = trace_time()-start;
+  printf("%s\t%d\t%s\t%d\t%.6f\t%.3f\n", form_name, items, op, count, t,
+	 count ? t*1e6/count : 0.0);
+  fflush(stdout);
+}
+
+static char** labels;
+
+static void make_labels() {
+  labels = new char*[items];
+  char buffer[32];
+  for (int i = 0; i < items; i++) {
+    sprintf(buffer, "Item %d", i);
+    labels[i] = strdup(buffer);
+  }
+}
+
+static void free_labels() {
+  for (int i = 0; i < items; i++) free(labels[i]);
+  delete[] labels;
+  labels = 0;
+}
+
+// Rows are numbered, the widgets are recycled:
+class NumberList : public List {
+  WidgetPool pool;
+public:
+  int n;
+  NumberList() : n(0) {}
+  int children(const Menu*, const int*, int level) {return level ? -1 : n;}
+  Widget* child(const Menu* menu, const int* indexes, int level) {
+    if (level || indexes[0] < 0 || indexes[0] >= n) return 0;
+    bool reused;
+    Widget* w = pool.get(menu, indexes, level, 0, &reused);
+    if (!reused) {
+      char buffer[32];
+      sprintf(buffer, "Item %d", indexes[0]);
+      w->copy_label(buffer);
+      w->w(0); w->h(0); // cause it to be measured
+    }
+    return w;
+  }
+  void visible_items(const Menu*, int n) {pool.capacity(n);}
+};
+
+// The operations that a Browser and a Menu have in common:
+static void menu_ops(Menu* menu) {
+  begin();
+  unsigned k = 12345;
+  for (int i = 0; i < GOTOS; i++) {
+    k = k*1103515245+12345;
+    menu->value(int((k>>8)%items));
+  }
+  end("goto", GOTOS);
+
+  begin();
+  char prefix[32];
+  for (int i = 0; i < PREFIXES; i++) {
+    sprintf(prefix, "Item %d", items-1-i);
+    if (menu->find_prefix(prefix) < 0) fprintf(stderr, "%s not found\n", prefix);
+  }
+  end("prefix", PREFIXES);
+}
+
+static void browser_ops(Browser* browser) {
+  browser->resize(0, 0, W, H);
+  begin();
+  browser->layout();
+  end("layout", 1);
+
+  begin();
+  browser->bottomline(items-1);
+  browser->layout();
+  end("bottom", 1);
+
+  menu_ops(browser);
+
+  Image image(RGB32, W, H);
+  {GSave gsave;
+  image.make_current();
+  begin();
+  for (int i = 0; i < DRAWS; i++) {
+    browser->topline((i*items)/DRAWS);
+    browser->layout();
+    browser->set_damage(DAMAGE_ALL);
+    browser->draw();
+  }
+  end("draw", DRAWS);}
+}
+
+static void test_items() {
+  Browser* browser = new Browser(0, 0, W, H);
+  browser->end();
+  begin();
+  for (int i = 0; i < items; i++) browser->add(labels[i]);
+  end("build", items);
+  browser_ops(browser);
+  delete browser;
+}
+
+static void test_strings() {
+  Browser* browser = new Browser(0, 0, W, H);
+  browser->end();
+  begin();
+  StringArray array((const char* const*)labels, items);
+  browser->list(&array);
+  end("build", items);
+  browser_ops(browser);
+  delete browser;
+}
+
+static void test_list() {
+  Browser* browser = new Browser(0, 0, W, H);
+  browser->end();
+  NumberList list;
+  begin();
+  list.n = items;
+  browser->list(&list);
+  end("build", items);
+  browser_ops(browser);
+  delete browser;
+}
+
+static void test_tree() {
+  Browser* browser = new Browser(0, 0, W, H);
+  begin();
+  for (int i = 0; i < 10; i++) new Item("Above");
+  ItemGroup* group = new ItemGroup("Folder");
+  for (int i = 0; i < items; i++) new Item(labels[i]);
+  group->end();
+  group->set_flag(OPENED);
+  browser->end();
+  end("build", items);
+  browser->resize(0, 0, W, H);
+  begin();
+  browser->layout();
+  end("layout", 1);
+
+  begin();
+  for (int i = 0; i < TOGGLES; i++) {
+    browser->goto_index(10);
+    browser->set_item_opened(i&1);
+    browser->layout();
+  }
+  end("toggle", TOGGLES);
+  delete browser;
+}
+
+static void test_menu() {
+  PopupMenu* menu = new PopupMenu(0, 0, W, 25);
+  menu->end();
+  begin();
+  for (int i = 0; i < items; i++) menu->add(labels[i]);
+  end("build", items);
+  menu_ops(menu);
+  delete menu;
+}
+
+struct Form {
+  const char* name;
+  void (*function)();
+};
+
+static const Form forms[] = {
+  {"items",	test_items},
+  {"strings",	test_strings},
+  {"list",	test_list},
+  {"menu",	test_menu},
+  {"tree",	test_tree},
+  {0}
+};
+
+int main(int argc, char** argv) {
+  int sizes[8]; int nsizes = 0;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-n") && i+1 < argc && nsizes < 8)
+      sizes[nsizes++] = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "Usage: %s [-n items]... [form...]\nForms:", argv[0]);
+      for (const Form* f = forms; f->name; f++) fprintf(stderr, " %s", f->name);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+  }
+  if (!nsizes) {
+    sizes[0] = 10000; sizes[1] = 100000; sizes[2] = 1000000;
+    nsizes = 3;
+  }
+  for (int j = i; j < argc; j++) {
+    const Form* f = forms;
+    while (f->name && strcmp(f->name, argv[j])) f++;
+    if (!f->name) {fprintf(stderr, "%s: no form called %s\n", argv[0], argv[j]); return 1;}
+  }
+
+  open_display();
+  printf("form\titems\top\tcount\tseconds\tus/op\n");
+  for (int s = 0; s < nsizes; s++) {
+    items = sizes[s] > 0 ? sizes[s] : 1;
+    make_labels();
+    for (const Form* f = forms; f->name; f++) {
+      if (i < argc) {
+	int j = i;
+	while (j < argc && strcmp(argv[j], f->name)) j++;
+	if (j >= argc) continue;
+      }
+      form_name = f->name;
+      f->function();
+    }
+    free_labels();
+  }
+  return 0;
+}
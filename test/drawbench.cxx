@@ -0,0 +1,220 @@
+// Benchmark of the drawing primitives, drawing offscreen into an Image
+// so it does not need a window to be mapped. Prints one line per test,
+// tab-separated, so the results from Xlib, Xft and Cairo builds can be
+// compared by a script:
+//
+//	test	ops	seconds	ops/sec
+//
+// Usage: drawbench [-t seconds] [-s size] [test...]
+// "make bench" runs all of them. The setpixels tests only measure the
+// conversion to the server's format, run with NO_SIMD set in the
+// environment to compare against the plain C converters.
+
+#include <config.h>
+#include <fltk/run.h>
+#include <fltk/draw.h>
+#include <fltk/Image.h>
+#include <fltk/Style.h>
+#include <fltk/trace.h>
+#include <fltk/x.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+static int S = 400; // size of the offscreen image
+static double duration = 1.0;
+
+enum {PATCH = 64};
+static uchar pixels[PATCH*PATCH*4];
+
+static void sync() {
+#if USE_X11
+  XSync(xdisplay, false);
+#elif defined(_WIN32)
+  GdiFlush();
+#endif
+}
+
+// Position for the i'th operation, so they don't all hit the same pixels:
+static int X(int i) {return (i*37)%(S-PATCH);}
+static int Y(int i) {return (i*91)%(S-PATCH);}
+
+static void do_fillrect(int i) {
+  setcolor(i&1 ? BLUE : RED);
+  fillrect(X(i), Y(i), 50, 50);
+}
+
+static void do_strokepath(int i) {
+  setcolor(i&1 ? BLACK : WHITE);
+  float x = X(i), y = Y(i);
+  newpath();
+  addvertex(x, y);
+  addvertex(x+50, y+10);
+  addvertex(x+30, y+50);
+  addcurve(x+20, y+40, x+10, y+30, x, y+50, x+5, y+20);
+  closepath();
+  strokepath();
+}
+
+static void do_fillpath(int i) {
+  setcolor(i&1 ? GREEN : YELLOW);
+  float x = X(i), y = Y(i);
+  newpath();
+  addvertex(x+25, y);
+  addvertex(x+40, y+50);
+  addvertex(x, y+18);
+  addvertex(x+50, y+18);
+  addvertex(x+10, y+50);
+  closepath();
+  addarc(x+30, y+30, 30, 30, 0, 360);
+  fillpath();
+}
+
+static void do_drawtext(int i) {
+  setcolor(BLACK);
+  setfont(HELVETICA, 12);
+  drawtext("The quick brown fox jumps over the lazy dog", X(i), Y(i)+12);
+}
+
+static PixelType drawimage_type;
+static void do_drawimage(int i) {
+  setcolor(BLACK); // used by MASK
+  drawimage(pixels, drawimage_type, Rectangle(X(i), Y(i), PATCH, PATCH));
+}
+
+// converts the pixels but does not draw them:
+static void do_setpixels(int i) {
+  static Image* image;
+  if (!image || image->pixeltype() != drawimage_type) {
+    delete image;
+    image = new Image(drawimage_type, PATCH, PATCH);
+  }
+  image->setpixels(pixels, Rectangle(PATCH, PATCH));
+}
+
+static void do_clip(int i) {
+  push_clip(X(i), Y(i), 50, 50);
+  push_clip(X(i)+10, Y(i)+10, 50, 50);
+  pop_clip();
+  pop_clip();
+}
+
+static void scroll_area(void*, const Rectangle& r) {
+  setcolor(GRAY75);
+  fillrect(r);
+}
+
+static void do_scrollrect(int i) {
+  scrollrect(Rectangle(0, 0, S, S), i&1 ? 3 : -3, 1, scroll_area, 0);
+}
+
+struct Test {
+  const char* name;
+  void (*function)(int);
+  PixelType type;
+};
+
+static const Test tests[] = {
+  {"fillrect",		do_fillrect},
+  {"strokepath",	do_strokepath},
+  {"fillpath",		do_fillpath},
+  {"drawtext",		do_drawtext},
+  {"drawimage_MASK",	do_drawimage, MASK},
+  {"drawimage_MONO",	do_drawimage, MONO},
+  {"drawimage_RGBx",	do_drawimage, RGBx},
+  {"drawimage_RGB",	do_drawimage, RGB},
+  {"drawimage_RGBA",	do_drawimage, RGBA},
+  {"drawimage_RGB32",	do_drawimage, RGB32},
+  {"drawimage_ARGB32",	do_drawimage, ARGB32},
+  {"drawimage_RGBM",	do_drawimage, RGBM},
+  {"drawimage_MRGB32",	do_drawimage, MRGB32},
+  {"setpixels_MASK",	do_setpixels, MASK},
+  {"setpixels_MONO",	do_setpixels, MONO},
+  {"setpixels_RGBx",	do_setpixels, RGBx},
+  {"setpixels_RGB",	do_setpixels, RGB},
+  {"setpixels_RGBA",	do_setpixels, RGBA},
+  {"setpixels_RGB32",	do_setpixels, RGB32},
+  {"setpixels_ARGB32",	do_setpixels, ARGB32},
+  {"setpixels_RGBM",	do_setpixels, RGBM},
+  {"setpixels_MRGB32",	do_setpixels, MRGB32},
+  {"push_clip",		do_clip},
+  {"scrollrect",	do_scrollrect},
+  {0}
+};
+
+static void run(const Test& t) {
+  drawimage_type = t.type;
+  // draw once first so fonts and colors are allocated:
+  t.function(0);
+  sync();
+  int ops = 0;
+  int batch = 16;
+  double start = trace_time();
+  double elapsed;
+  for (;;) {
+    for (int i = 0; i < batch; i++) t.function(ops+i);
+    ops += batch;
+    sync(); // so the server's time is counted
+    elapsed = trace_time()-start;
+    if (elapsed >= duration) break;
+    if (elapsed < duration/16) batch *= 2;
+  }
+  printf("%s\t%d\t%.6f\t%.1f\n", t.name, ops, elapsed, ops/elapsed);
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-t") && i+1 < argc) duration = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) S = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "Usage: %s [-t seconds] [-s size] [test...]\nTests:", argv[0]);
+      for (const Test* t = tests; t->name; t++) fprintf(stderr, " %s", t->name);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+  }
+  if (S < 2*PATCH) S = 2*PATCH;
+
+  // a pattern that is partly transparent, for the alpha types:
+  for (int y = 0; y < PATCH; y++) for (int x = 0; x < PATCH; x++) {
+    uchar* p = pixels+(y*PATCH+x)*4;
+    p[0] = x*4; p[1] = y*4; p[2] = (x^y)*4; p[3] = (x+y)*2;
+  }
+
+  open_display();
+  const char* backend =
+#if USE_CAIRO
+    "cairo";
+#elif USE_XFT
+    "xft";
+#elif USE_X11
+    "xlib";
+#elif defined(_WIN32)
+    "gdi";
+#else
+    "quartz";
+#endif
+  printf("# backend %s size %d\n", backend, S);
+  printf("test\tops\tseconds\tops/sec\n");
+
+  Image image(RGB32, S, S);
+  GSave gsave;
+  image.make_current();
+  setcolor(WHITE);
+  fillrect(0, 0, S, S);
+
+  int failed = 0;
+  if (i >= argc) {
+    for (const Test* t = tests; t->name; t++) run(*t);
+  } else for (; i < argc; i++) {
+    const Test* t = tests;
+    while (t->name && strcmp(t->name, argv[i])) t++;
+    if (t->name) run(*t);
+    else {fprintf(stderr, "%s: no test called %s\n", argv[0], argv[i]); failed = 1;}
+  }
+  return failed;
+}
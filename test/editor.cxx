@@ -48,6 +48,7 @@
 #include <fltk/ReturnButton.h>
 #include <fltk/TextBuffer.h>
 #include <fltk/TextEditor.h>
+#include <fltk/TextHighlighter.h>
 #include <fltk/MenuBuild.h>
 
 int                changed = 0;
@@ -57,7 +58,6 @@ fltk::TextBuffer     *textbuf = 0;
 
 
 // Syntax highlighting stuff...
-fltk::TextBuffer     *stylebuf = 0;
 fltk::TextDisplay::StyleTableEntry
                    styletable[] = {	// Style table
 		     { fltk::BLACK,           fltk::COURIER,        12 }, // A - Plain
@@ -158,10 +158,11 @@ extern "C" {
 }
 
 //
-// 'style_parse()' - Parse text and produce style data.
+// 'style_parse()' - Parse text and produce style data, returning
+//                   the style the next line starts with.
 //
 
-void
+char
 style_parse(const char *text,
             char       *style,
 	    int        length) {
@@ -289,127 +290,24 @@ style_parse(const char *text,
       if (current == 'B' || current == 'E') current = 'A';
     }
   }
-}
-
-
-//
-// 'style_init()' - Initialize the style buffer...
-//
-
-void
-style_init(void) {
-  char *style = new char[textbuf->length() + 1];
-  const char *text = textbuf->text();
-
-  memset(style, 'A', textbuf->length());
-  style[textbuf->length()] = '\0';
-
-  if (!stylebuf) stylebuf = new fltk::TextBuffer(textbuf->length());
-
-  style_parse(text, style, textbuf->length());
 
-  stylebuf->text(style);
-  delete[] style;
+  return current == 'C' || current == 'D' ? current : 'A';
 }
 
 
 //
-// 'style_unfinished_cb()' - Update unfinished styles.
+// 'style_lex()' - Style one line for the TextHighlighter.
 //
 
-void
-style_unfinished_cb(int, void*) {
-}
-
-
-//
-// 'style_update()' - Update the style buffer...
-//
-
-void
-style_update(int        pos,		// I - Position of update
-             int        nInserted,	// I - Number of inserted chars
-	     int        nDeleted,	// I - Number of deleted chars
-             int        /*nRestyled*/,	// I - Number of restyled chars
-	     const char * /*deletedText*/,// I - Text that was deleted
-             void       *cbArg) {	// I - Callback data
-  int	start,				// Start of text
-	end;				// End of text
-  char	last,				// Last style on line
-	*style,				// Style data
-	*text;				// Text data
-
-
-  // If this is just a selection change, just unselect the style buffer...
-  if (nInserted == 0 && nDeleted == 0) {
-    stylebuf->unselect();
-    return;
-  }
-
-  // Track changes in the text buffer...
-  if (nInserted > 0) {
-    // Insert characters into the style buffer...
-    style = new char[nInserted + 1];
-    memset(style, 'A', nInserted);
-    style[nInserted] = '\0';
-
-    stylebuf->replace(pos, pos + nDeleted, style);
-    delete[] style;
-  } else {
-    // Just delete characters in the style buffer...
-    stylebuf->remove(pos, pos + nDeleted);
-  }
-
-  // Select the area that was just updated to avoid unnecessary
-  // callbacks...
-  stylebuf->select(pos, pos + nInserted - nDeleted);
-
-  // Re-parse the changed region; we do this by parsing from the
-  // beginning of the previous line of the changed region to the end of
-  // the line of the changed region...  Then we check the last
-  // style character and keep updating if we have a multi-line
-  // comment character...
-  start = textbuf->line_start(pos);
-//  if (start > 0) start = textbuf->line_start(start - 1);
-  end   = textbuf->line_end(pos + nInserted);
-  text  = textbuf->text_range(start, end);
-  style = stylebuf->text_range(start, end);
-  if (start==end)
-    last = 0;
-  else
-    last  = style[end - start - 1];
-
-//  printf("start = %d, end = %d, text = \"%s\", style = \"%s\", last='%c'...\n",
-//         start, end, text, style, last);
-
-  style_parse(text, style, end - start);
-
-//  printf("new style = \"%s\", new last='%c'...\n",
-//         style, style[end - start - 1]);
-
-  stylebuf->replace(start, end, style);
-  ((fltk::TextEditor *)cbArg)->redisplay_range(start, end);
-
-  if (start==end || last != style[end - start - 1]) {
-//    printf("Recalculate the rest of the buffer style\n");
-    // Either the user deleted some text, or the last character
-    // on the line changed styles, so reparse the
-    // remainder of the buffer...
-    free(text);
-    free(style);
-
-    end   = textbuf->length();
-    text  = textbuf->text_range(start, end);
-    style = stylebuf->text_range(start, end);
-
-    style_parse(text, style, end - start);
-
-    stylebuf->replace(start, end, style);
-    ((fltk::TextEditor *)cbArg)->redisplay_range(start, end);
-  }
-
-  free(text);
-  free(style);
+int
+style_lex(const char *text,		// I - Text of the line
+          int        length,		// I - Length including the newline
+          char       *style,		// O - Style data
+          int        state,		// I - Style at the start of the line
+          void       *) {
+  if (!length) return state;
+  style[0] = state ? state : 'A';	// style_parse() starts with this
+  return style_parse(text, style, length);
 }
 
 
@@ -434,10 +332,12 @@ class EditorWindow : public fltk::Window {
     fltk::Button          *replace_cancel;
 
     fltk::TextEditor     *editor;
+    fltk::TextHighlighter *highlighter;
     char               search[256];
 };
 
 EditorWindow::EditorWindow(int w, int h, const char* t) : fltk::Window(w, h, t) {
+  highlighter = 0;
   replace_dlg = new fltk::Window(300, 105, "Replace");
   replace_dlg->begin();
     replace_find = new fltk::Input(80, 10, 210, 25, "Find:");
@@ -461,6 +361,7 @@ EditorWindow::EditorWindow(int w, int h, const char* t) : fltk::Window(w, h, t)
 }
 
 EditorWindow::~EditorWindow() {
+  delete highlighter;
   delete replace_dlg;
 }
 
@@ -675,24 +576,27 @@ void replall_cb(fltk::Widget*, void* v) {
 
   e->replace_dlg->hide();
 
-  e->editor->insert_position(0);
   int times = 0;
+  int pos = 0;
 
-  // Loop through the whole string
+  // Loop through the whole string, the display is updated once at the end
+  textbuf->begin_batch();
   for (int found = 1; found;) {
-    int pos = e->editor->insert_position();
     found = textbuf->search_forward(pos, find, &pos);
 
     if (found) {
-      // Found a match; update the position and replace text...
-      textbuf->select(pos, pos+strlen(find));
-      textbuf->remove_selection();
+      // Found a match; replace the text and continue after it...
+      textbuf->remove(pos, pos+strlen(find));
       textbuf->insert(pos, replace);
-      e->editor->insert_position(pos+strlen(replace));
-      e->editor->show_insert_position();
+      pos += strlen(replace);
       times++;
     }
   }
+  textbuf->end_batch();
+  if (times) {
+    e->editor->insert_position(pos);
+    e->editor->show_insert_position();
+  }
 
   if (times) fltk::message("Replaced %d occurrences.", times);
   else fltk::alert("No occurrences of \'%s\' found!", find);
@@ -766,9 +670,9 @@ fltk::Window* new_view() {
     build_menus(m,w);
     w->editor = new fltk::TextEditor(0, 21, 660, 379);
     w->editor->buffer(textbuf);
-    w->editor->highlight_data(stylebuf, styletable,
-      sizeof(styletable) / sizeof(styletable[0]),
-     'A', style_unfinished_cb, 0);
+    w->highlighter = new fltk::TextHighlighter(style_lex);
+    w->highlighter->attach(w->editor, styletable,
+      sizeof(styletable) / sizeof(styletable[0]));
     w->editor->textfont(fltk::COURIER);
   w->end();
   w->resizable(w->editor);
@@ -779,7 +683,6 @@ fltk::Window* new_view() {
   w->editor->cursor_style(fltk::TextDisplay::BLOCK_CURSOR);
   // w->editor->insert_mode(false);
 
-  textbuf->add_modify_callback(style_update, w->editor);
   textbuf->add_modify_callback(changed_cb, w);
   textbuf->call_modify_callbacks();
   num_windows++;
@@ -789,7 +692,7 @@ fltk::Window* new_view() {
 int main(int argc, char **argv) {
 
   textbuf = new fltk::TextBuffer(0);
-  style_init();
+  fltk::lock(); // so the highlighter can use a thread
 
   fltk::Window* window = new_view();
 
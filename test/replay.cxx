@@ -0,0 +1,86 @@
+// Records or plays back a session with a small window of widgets, to
+// measure how long events take so a change can be compared against an
+// older build:
+//
+//	replay -r session.txt		use the window, close it to stop
+//	replay [-s speed] session.txt	play it back and print the latencies
+//
+// With a speed of zero (the default) the events are sent as fast as
+// they can be handled. This needs a display (Xvfb works) but nothing
+// has to be done on it. "make replay-bench" plays back the file named
+// by $(SESSION).
+
+#include <fltk/run.h>
+#include <fltk/Window.h>
+#include <fltk/Button.h>
+#include <fltk/CheckButton.h>
+#include <fltk/Input.h>
+#include <fltk/Slider.h>
+#include <fltk/Browser.h>
+#include <fltk/EventReplay.h>
+#include <fltk/trace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace fltk;
+
+static Window* make_window() {
+  Window* w = new Window(320, 300, "replay");
+  w->begin();
+  new Input(60, 10, 250, 25, "Input:");
+  Slider* s = new Slider(60, 45, 250, 25, "Slider:");
+  s->align(ALIGN_LEFT);
+  new CheckButton(60, 80, 120, 25, "Check");
+  new Button(190, 80, 120, 25, "Button");
+  Browser* b = new Browser(10, 115, 300, 175);
+  char buffer[32];
+  for (int i = 0; i < 200; i++) {
+    sprintf(buffer, "Line %d", i);
+    b->add(buffer);
+  }
+  w->end();
+  w->resizable(b);
+  return w;
+}
+
+int main(int argc, char** argv) {
+  const char* record = 0;
+  float speed = 0;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-r") && i+1 < argc) record = argv[++i];
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) speed = float(atof(argv[++i]));
+    else break;
+  }
+  if (!record && i != argc-1) {
+    fprintf(stderr, "usage: %s -r file\n       %s [-s speed] file\n",
+	    argv[0], argv[0]);
+    return 1;
+  }
+
+  Window* window = make_window();
+  window->show();
+
+  if (record) {
+    if (!start_recording(record)) {perror(record); return 1;}
+    run();
+    stop_recording();
+    return 0;
+  }
+
+  EventReplay replay;
+  if (!replay.load(argv[i])) {
+    fprintf(stderr, "%s: not an event recording\n", argv[i]);
+    return 1;
+  }
+  // let the window get mapped before sending anything to it:
+  while (!window->visible()) wait();
+  flush();
+  replay.run(speed);
+  printf("events\t%d\nmissing\t%d\n", replay.replayed(), replay.missing());
+  printf("p50\t%g\np90\t%g\np99\t%g\nmax\t%g\n",
+	 replay.percentile(.5f), replay.percentile(.9f),
+	 replay.percentile(.99f), replay.percentile(1));
+  return replay.missing() != 0;
+}
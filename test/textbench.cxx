@@ -0,0 +1,379 @@
+// Benchmark of TextBuffer and TextDisplay on synthetic log files and
+// source code. Prints one line per test, tab-separated so results from
+// different storage backends and builds can be compared by a script:
+//
+//	corpus	test	ops	seconds	MB/sec	ops/sec	peak_rss_MB
+//
+// The TextBuffer tests (insert, remove, count_lines, skip_lines, search,
+// undo, insertfile, outputfile) do not need a display. The TextDisplay
+// tests (scroll, wrap_resize, styled_draw) draw into an offscreen Image
+// and need a display for the fonts (Xvfb works), and are skipped
+// without one.
+//
+// Usage: textbench [-m megabytes] [-p] [-f file] [test...]
+//   -m  size of each corpus, default 16. Use -m 1024 for 1GB files.
+//   -p  use the PIECE_TABLE storage instead of the gap buffer
+//   -f  temporary file for insertfile/outputfile, default textbench.tmp
+// "make text-bench" runs all of them.
+
+#include <config.h>
+#include <fltk/run.h>
+#include <fltk/TextBuffer.h>
+#include <fltk/TextDisplay.h>
+#include <fltk/Image.h>
+#include <fltk/draw.h>
+#include <fltk/damage.h>
+#include <fltk/trace.h>
+#include <fltk/x.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+using namespace fltk;
+
+static int megabytes = 16;
+static bool piece_table = false;
+static const char* tempfile = "textbench.tmp";
+
+static const char* corpus_name;
+static char* corpus;	// the text of the current corpus
+static int corpus_length;
+
+// Largest resident size so far, in megabytes:
+static double peak_rss() {
+#ifndef _WIN32
+  rusage r;
+  getrusage(RUSAGE_SELF, &r);
+# ifdef __APPLE__
+  return r.ru_maxrss/1048576.0;
+# else
+  return r.ru_maxrss/1024.0;
+# endif
+#else
+  return 0;
+#endif
+}
+
+static double start;
+
+static void report(const char* test, long ops, double bytes) {
+  double t = trace_time()-start;
+  if (t <= 0) t = 1e-9;
+  printf("%s\t%s\t%ld\t%.6f\t%.1f\t%.1f\t%.1f\n", corpus_name, test, ops, t,
+	 bytes/t/1048576, ops/t, peak_rss());
+  fflush(stdout);
+}
+
+static unsigned random_state = 1;
+static unsigned next_random() {
+  random_state = random_state*1103515245+12345;
+  return random_state>>8;
+}
+
+////////////////////////////////////////////////////////////////
+// Corpora:
+
+// Lines like a server log, all about the same length:
+static void make_log(char* p, int n) {
+  static const char* levels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+  char* e = p+n;
+  int i = 0;
+  while (p < e) {
+    char line[160];
+    int len = sprintf(line, "2026-10-14 12:%02d:%02d.%03d [%s] worker-%d: request %d "
+		      "took %d ms, status %d\n", (i/6000)%60, (i/100)%60, i%1000,
+		      levels[next_random()%4], i%16, i, next_random()%500,
+		      next_random()%4 ? 200 : 404);
+    if (len > e-p) len = int(e-p);
+    memcpy(p, line, len);
+    p += len;
+    i++;
+  }
+}
+
+// Something like C source, with indentation, short and long lines:
+static void make_source(char* p, int n) {
+  static const char* lines[] = {
+    "static int function_%d(const char* text, int length) {\n",
+    "  int count = 0; // how many were found\n",
+    "  for (int i = 0; i < length; i++) {\n",
+    "    if (text[i] == '\\n' && i+1 < length && text[i+1] != '#') count += %d;\n",
+    "    else if (text[i] == '\\t') {count = (count+8)&~7;}\n",
+    "  }\n",
+    "  /* A longer comment that goes past the edge of a narrow window so that\n"
+    "     wrapping has something to do, number %d */\n",
+    "  return count;\n",
+    "}\n",
+    "\n"
+  };
+  char* e = p+n;
+  int i = 0;
+  while (p < e) {
+    char line[256];
+    int len = sprintf(line, lines[i%10], i);
+    if (len > e-p) len = int(e-p);
+    memcpy(p, line, len);
+    p += len;
+    i++;
+  }
+}
+
+static TextBuffer* new_buffer() {
+  TextBuffer* b = new TextBuffer;
+  if (piece_table) b->storage(TextBuffer::PIECE_TABLE);
+  b->text(corpus);
+  return b;
+}
+
+////////////////////////////////////////////////////////////////
+// TextBuffer tests:
+
+enum {EDITS = 10000, LINE_OPS = 2000, SEARCHES = 20, UNDOS = 1000};
+
+static void test_insert() {
+  TextBuffer* b = new_buffer();
+  start = trace_time();
+  for (int i = 0; i < EDITS; i++)
+    b->insert(next_random()%(b->length()+1), "inserted text ");
+  report("insert", EDITS, EDITS*14.0);
+  delete b;
+}
+
+static void test_remove() {
+  TextBuffer* b = new_buffer();
+  start = trace_time();
+  for (int i = 0; i < EDITS; i++) {
+    int p = next_random()%(b->length()-20);
+    b->remove(p, p+14);
+  }
+  report("remove", EDITS, EDITS*14.0);
+  delete b;
+}
+
+static void test_count_lines() {
+  TextBuffer* b = new_buffer();
+  start = trace_time();
+  double bytes = 0;
+  for (int i = 0; i < LINE_OPS; i++) {
+    int p = next_random()%b->length();
+    int q = next_random()%b->length();
+    if (p > q) {int t = p; p = q; q = t;}
+    b->count_lines(p, q);
+    bytes += q-p;
+  }
+  report("count_lines", LINE_OPS, bytes);
+  delete b;
+}
+
+static void test_skip_lines() {
+  TextBuffer* b = new_buffer();
+  int lines = b->count_lines(0, b->length());
+  start = trace_time();
+  for (int i = 0; i < LINE_OPS; i++)
+    b->skip_lines(next_random()%(b->length()/2), next_random()%(lines/2+1));
+  report("skip_lines", LINE_OPS, 0);
+  delete b;
+}
+
+static void test_search() {
+  TextBuffer* b = new_buffer();
+  start = trace_time();
+  int found;
+  // not in the text, so the whole buffer is searched each time:
+  for (int i = 0; i < SEARCHES; i++)
+    b->search_forward(0, "not in the corpus", &found, i&1);
+  report("search", SEARCHES, double(SEARCHES)*b->length());
+  delete b;
+}
+
+static void test_undo() {
+  TextBuffer* b = new_buffer();
+  b->undo_limit(0x7fffffff);
+  for (int i = 0; i < UNDOS; i++) {
+    int p = next_random()%b->length();
+    if (i&1) b->remove(p, p+1 < b->length() ? p+1 : p);
+    else b->insert(p, "x");
+  }
+  start = trace_time();
+  int n = 0;
+  while (b->undoable() && n < UNDOS) {b->undo(); n++;}
+  report("undo", n, 0);
+  delete b;
+}
+
+static void test_files() {
+  TextBuffer* b = new_buffer();
+  start = trace_time();
+  if (b->outputfile(tempfile, 0, b->length())) {
+    fprintf(stderr, "Can't write %s\n", tempfile);
+    delete b;
+    return;
+  }
+  report("outputfile", 1, b->length());
+  delete b;
+  b = new TextBuffer;
+  if (piece_table) b->storage(TextBuffer::PIECE_TABLE);
+  start = trace_time();
+  b->insertfile(tempfile, 0);
+  report("insertfile", 1, b->length());
+  delete b;
+  remove(tempfile);
+}
+
+////////////////////////////////////////////////////////////////
+// TextDisplay tests:
+
+enum {W = 600, H = 400, SCROLLS = 200, RESIZES = 20, DRAWS = 50};
+
+static TextDisplay* new_display(TextBuffer* b) {
+  TextDisplay* d = new TextDisplay(0, 0, W, H);
+  d->end();
+  d->buffer(b);
+  d->layout();
+  return d;
+}
+
+static void draw_display(TextDisplay* d) {
+  d->layout();
+  d->set_damage(DAMAGE_ALL);
+  d->draw();
+}
+
+static void test_scroll() {
+  TextBuffer* b = new_buffer();
+  TextDisplay* d = new_display(b);
+  Image image(RGB32, W, H);
+  GSave gsave;
+  image.make_current();
+  int lines = b->count_lines(0, b->length());
+  start = trace_time();
+  for (int i = 0; i < SCROLLS; i++) {
+    d->scroll(int((double(i)*lines)/SCROLLS), 0);
+    draw_display(d);
+  }
+  report("scroll", SCROLLS, 0);
+  delete d;
+  delete b;
+}
+
+static void test_wrap_resize() {
+  TextBuffer* b = new_buffer();
+  TextDisplay* d = new_display(b);
+  d->wrap_mode(true);
+  d->layout();
+  start = trace_time();
+  for (int i = 0; i < RESIZES; i++) {
+    d->resize(0, 0, W-(i%4)*50, H);
+    d->layout();
+  }
+  report("wrap_resize", RESIZES, 0);
+  delete d;
+  delete b;
+}
+
+static void test_styled_draw() {
+  static TextDisplay::StyleTableEntry styles[] = {
+    {BLACK,	HELVETICA,	14},
+    {BLUE,	COURIER,	14},
+    {RED,	COURIER_BOLD,	14},
+    {DARK_GREEN,HELVETICA_ITALIC,14}
+  };
+  TextBuffer* b = new_buffer();
+  // style each word differently:
+  char* style = new char[corpus_length+1];
+  int s = 0;
+  for (int i = 0; i < corpus_length; i++) {
+    if (corpus[i] == ' ') s = (s+1)&3;
+    style[i] = 'A'+s;
+  }
+  style[corpus_length] = 0;
+  TextBuffer* sb = new TextBuffer;
+  sb->text(style);
+  delete[] style;
+  TextDisplay* d = new_display(b);
+  d->highlight_data(sb, styles, 4, 'A', 0, 0);
+  Image image(RGB32, W, H);
+  GSave gsave;
+  image.make_current();
+  int lines = b->count_lines(0, b->length());
+  start = trace_time();
+  for (int i = 0; i < DRAWS; i++) {
+    d->scroll(int((double(i)*lines)/DRAWS), 0);
+    draw_display(d);
+  }
+  report("styled_draw", DRAWS, 0);
+  delete d;
+  delete sb;
+  delete b;
+}
+
+////////////////////////////////////////////////////////////////
+
+struct Test {
+  const char* name;
+  void (*function)();
+  bool display;
+};
+
+static const Test tests[] = {
+  {"insert",		test_insert},
+  {"remove",		test_remove},
+  {"count_lines",	test_count_lines},
+  {"skip_lines",	test_skip_lines},
+  {"search",		test_search},
+  {"undo",		test_undo},
+  {"files",		test_files},
+  {"scroll",		test_scroll, true},
+  {"wrap_resize",	test_wrap_resize, true},
+  {"styled_draw",	test_styled_draw, true},
+  {0}
+};
+
+int main(int argc, char** argv) {
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-m") && i+1 < argc) megabytes = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p")) piece_table = true;
+    else if (!strcmp(argv[i], "-f") && i+1 < argc) tempfile = argv[++i];
+    else {
+      fprintf(stderr, "Usage: %s [-m megabytes] [-p] [-f file] [test...]\nTests:", argv[0]);
+      for (const Test* t = tests; t->name; t++) fprintf(stderr, " %s", t->name);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+  }
+  if (megabytes < 1) megabytes = 1;
+  if (megabytes > 2000) megabytes = 2000; // TextBuffer positions are ints
+
+  bool display = xdisplay || getenv("DISPLAY");
+  if (display) open_display();
+  else fprintf(stderr, "No display, the TextDisplay tests are skipped\n");
+
+  printf("# %s storage, %d MB corpora\n",
+	 piece_table ? "piece table" : "gap buffer", megabytes);
+  printf("corpus\ttest\tops\tseconds\tMB/sec\tops/sec\tpeak_rss_MB\n");
+
+  corpus_length = megabytes*1048576;
+  corpus = (char*)malloc(corpus_length+1);
+  for (int c = 0; c < 2; c++) {
+    corpus_name = c ? "source" : "log";
+    if (c) make_source(corpus, corpus_length);
+    else make_log(corpus, corpus_length);
+    corpus[corpus_length] = 0;
+    for (const Test* t = tests; t->name; t++) {
+      if (i < argc) {
+	int j = i;
+	while (j < argc && strcmp(argv[j], t->name)) j++;
+	if (j >= argc) continue;
+      }
+      if (t->display && !display) continue;
+      random_state = 1; // the same positions for every run
+      t->function();
+    }
+  }
+  free(corpus);
+  return 0;
+}
@@ -0,0 +1,270 @@
+// Benchmark and stress test of fltk::lock() and fltk::awake(). Worker
+// threads hammer the main thread the way a program that updates its
+// widgets from other threads does, and this prints one line per test,
+// tab-separated so builds can be compared by a script:
+//
+//	test	count	seconds	per_sec	mean_us	p99_us	max_us	lost
+//
+// awake:    each thread sends -n messages with awake(), the main thread
+//           reads them with thread_message(). lost is how many were
+//           thrown away because the queue was full.
+// lock:     each thread does -n lock()/unlock() pairs while the main
+//           thread loops in wait(). The times are how long lock() took.
+// redraw:   one thread changes a widget and calls redraw() and awake(),
+//           the time is until the main thread has drawn it and the
+//           server has finished. This needs a display (Xvfb works), and
+//           is skipped without one. It is also slow, about 100/second.
+//
+// Usage: threadbench [-t threads] [-n count] [test...]
+// "make thread-bench" runs all of them. To measure the XLockDisplay()
+// version in src/x11/lock.cxx, set USE_X11_MULTITHREADING to 1 in
+// config.h and rebuild the library; that version always needs a display.
+
+#include <config.h>
+#include <stdio.h>
+
+#if HAVE_PTHREAD
+#include <fltk/run.h>
+#include <fltk/Threads.h>
+#include <fltk/Window.h>
+#include <fltk/Widget.h>
+#include <fltk/draw.h>
+#include <fltk/trace.h>
+#include <fltk/x.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace fltk;
+
+static int threads = 4;
+static long count = 100000;
+
+static Mutex counter_mutex;
+static int finished;	// threads that are done
+
+static void thread_done() {
+  Guard guard(counter_mutex);
+  finished++;
+}
+
+static bool all_done() {
+  Guard guard(counter_mutex);
+  return finished >= threads;
+}
+
+static void start_threads(void* (*f)(void*)) {
+  finished = 0;
+  for (long i = 0; i < threads; i++) {
+    Thread t;
+    if (create_thread(t, f, (void*)i)) {
+      fprintf(stderr, "Can't make thread %ld\n", i);
+      exit(1);
+    }
+  }
+}
+
+static int compare(const void* a, const void* b) {
+  double d = *(const double*)a - *(const double*)b;
+  return d < 0 ? -1 : d > 0 ? 1 : 0;
+}
+
+// Times are in seconds, printed in microseconds:
+static void report(const char* name, long n, double seconds,
+		   double* times, long ntimes, long lost) {
+  double mean = 0, p99 = 0, max = 0;
+  if (ntimes) {
+    qsort(times, ntimes, sizeof(double), compare);
+    for (long i = 0; i < ntimes; i++) mean += times[i];
+    mean /= ntimes;
+    p99 = times[(ntimes-1)*99/100];
+    max = times[ntimes-1];
+  }
+  printf("%s\t%ld\t%.6f\t%.1f\t%.2f\t%.2f\t%.2f\t%ld\n", name, n, seconds,
+	 n/seconds, mean*1e6, p99*1e6, max*1e6, lost);
+  fflush(stdout);
+}
+
+////////////////////////////////////////////////////////////////
+
+static void* awake_thread(void*) {
+  for (long i = 0; i < count; i++) awake((void*)(i+1));
+  thread_done();
+  return 0;
+}
+
+static void test_awake() {
+  long received = 0;
+  double start = trace_time();
+  double end = start;
+  start_threads(awake_thread);
+  for (;;) {
+    bool done = all_done(); // check before reading the last ones
+    wait(.1);
+    long before = received;
+    while (thread_message()) received++;
+    if (received != before) end = trace_time();
+    if (done) break;
+  }
+  double elapsed = end-start;
+  report("awake", received, elapsed, 0, 0, threads*count-received);
+}
+
+////////////////////////////////////////////////////////////////
+
+static double* lock_times;
+
+static void* lock_thread(void* v) {
+  double* times = lock_times + long(v)*count;
+  for (long i = 0; i < count; i++) {
+    double t = trace_time();
+    lock();
+    times[i] = trace_time()-t;
+    unlock();
+  }
+  thread_done();
+  awake();
+  return 0;
+}
+
+static void test_lock() {
+  lock_times = new double[threads*count];
+  double start = trace_time();
+  start_threads(lock_thread);
+  while (!all_done()) wait(.01);
+  double elapsed = trace_time()-start;
+  report("lock", threads*count, elapsed, lock_times, threads*count, 0);
+  delete[] lock_times;
+}
+
+////////////////////////////////////////////////////////////////
+
+// Draws a different color for each update so the server really has
+// to change the pixels:
+class UpdateWidget : public Widget {
+public:
+  volatile double changed;	// trace_time() of the update
+  double drawn;			// value of changed when last drawn
+  int value;
+  UpdateWidget(int x, int y, int w, int h)
+    : Widget(x,y,w,h), changed(0), drawn(-1), value(0) {}
+  void draw() {
+    setcolor(value&1 ? BLUE : RED);
+    fillrect(Rectangle(w(), h()));
+    drawn = changed;
+  }
+};
+
+static UpdateWidget* update_widget;
+enum {REDRAWS = 200};
+
+static void* redraw_thread(void*) {
+  for (int i = 0; i < REDRAWS; i++) {
+    lock();
+    update_widget->value++;
+    update_widget->changed = trace_time();
+    update_widget->redraw();
+    awake();
+    unlock();
+    usleep(5000);
+  }
+  thread_done();
+  awake();
+  return 0;
+}
+
+static void test_redraw() {
+  if (!xdisplay && !getenv("DISPLAY")) {
+    fprintf(stderr, "redraw test skipped, there is no display\n");
+    return;
+  }
+  Window window(100, 100, "threadbench");
+  window.begin();
+  update_widget = new UpdateWidget(0, 0, 100, 100);
+  window.end();
+  window.show();
+  // wait for it to be mapped and drawn:
+  double limit = trace_time()+5;
+  while (update_widget->drawn < 0 && trace_time() < limit) wait(.1);
+  double* times = new double[REDRAWS];
+  long n = 0;
+  int saved_threads = threads;
+  threads = 1;
+  double start = trace_time();
+  start_threads(redraw_thread);
+  double last = update_widget->drawn;
+  while (!all_done()) {
+    wait(.1);
+    if (update_widget->drawn != last) {
+      last = update_widget->drawn;
+#if USE_X11
+      XSync(xdisplay, false); // until the server has drawn it
+#endif
+      if (n < REDRAWS) times[n++] = trace_time()-last;
+    }
+  }
+  double elapsed = trace_time()-start;
+  // updates drawn together with a later one are not lost, just merged:
+  report("redraw", n, elapsed, times, n, 0);
+  threads = saved_threads;
+  delete[] times;
+  window.hide();
+}
+
+////////////////////////////////////////////////////////////////
+
+struct Test {
+  const char* name;
+  void (*function)();
+};
+
+static const Test tests[] = {
+  {"awake",	test_awake},
+  {"lock",	test_lock},
+  {"redraw",	test_redraw},
+  {0}
+};
+
+int main(int argc, char** argv) {
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-t") && i+1 < argc) threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i+1 < argc) count = atol(argv[++i]);
+    else {
+      fprintf(stderr, "Usage: %s [-t threads] [-n count] [test...]\nTests:", argv[0]);
+      for (const Test* t = tests; t->name; t++) fprintf(stderr, " %s", t->name);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+  }
+  if (threads < 1) threads = 1;
+  if (count < 1) count = 1;
+
+  lock(); // the main thread must do this before other threads can
+  printf("# lock: %s, %d threads\n",
+#if USE_X11 && USE_X11_MULTITHREADING
+	 "XLockDisplay",
+#else
+	 "pthread",
+#endif
+	 threads);
+  printf("# test\tcount\tseconds\tper_sec\tmean_us\tp99_us\tmax_us\tlost\n");
+  for (const Test* t = tests; t->name; t++) {
+    if (i < argc) {
+      int j = i;
+      while (j < argc && strcmp(argv[j], t->name)) j++;
+      if (j >= argc) continue;
+    }
+    t->function();
+  }
+  return 0;
+}
+
+#else
+
+int main() {
+  fprintf(stderr, "threadbench needs pthreads\n");
+  return 1;
+}
+
+#endif